@@ -1,35 +1,32 @@
 #include "client_header.hpp"
 // input.hpp is already included transitively via client_header.hpp
 #include <algorithm>
-#include <unistd.h>      // read, close, sleep
-#include <sys/select.h>  // select, FD_SET, FD_ZERO, FD_ISSET
-#include <cerrno>        // errno, EINTR
+#include <unistd.h>      // read
 #include <fcntl.h>       // fcntl, F_GETFL, F_SETFL, O_NONBLOCK
 #include <termios.h>     // tcgetattr, tcsetattr, termios — raw terminal control
 
-#define DUPLICATED_USERNAME_ERROR "101"
-
 // ── Module-level state ───────────────────────────────────────────────────────
 static termios old_term;            // Original terminal settings (restored on exit)
 static int original_stdin_flags;    // Original stdin fcntl flags (for O_NONBLOCK cleanup)
 static std::string input_buffer{};  // Accumulates characters typed by the user
 static std::string username{};      // Display name prepended to the prompt
 
+// Everything shown during one loop iteration (echo, received messages, the
+// redrawn prompt) is collected here and written with a single flush.
+static std::string screen{};
+static bool prompt_overwritten{false}; // Messages shown this iteration: redraw the prompt
+
 // Forward declarations
 void restore_stdin();
 void setup_stdin();
-void handle_stdin(int sockfd, TcpClient* client);
+void handle_stdin(TcpClient* client);
 
 // ---------------------------------------------------------------------------
-// Constructor — creates the TCP socket
+// Constructor — nothing connects before start()
 // ---------------------------------------------------------------------------
-TcpClient::TcpClient(int _port, const char* _client_ip)
-    : client_ip(_client_ip), port(_port)
+TcpClient::TcpClient(int _port, const std::string& _server_ip)
+    : port(_port), server_ip(_server_ip)
 {
-    client_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (client_fd == -1) {
-        throw std::runtime_error("Socket creation failed");
-    }
 }
 
 // ---------------------------------------------------------------------------
@@ -60,152 +57,157 @@ int TcpClient::getInt(const std::string& prompt, int min, int max)
 }
 
 // ---------------------------------------------------------------------------
-// connect_and_authenticate
-// Establishes the TCP connection and performs the register/login handshake.
-// Returns 0 on success, -1 on failure.
+// enable_tls — TLS 1.3 only, server certificate always verified
 // ---------------------------------------------------------------------------
-int TcpClient::connect_and_authenticate(const char* server_ipv4_address)
+void TcpClient::enable_tls(const std::string& ca_file, const std::string& server_name)
 {
-    server_ip = server_ipv4_address;
-
-    // Validate the IP string before passing it to connect()
-    if (inet_addr(server_ipv4_address) == INADDR_NONE) {
-        std::cerr << "Invalid IP address: " << server_ipv4_address << std::endl;
-        close(client_fd);
-        client_fd = -1;
-        return -1;
-    }
+    tls_ctx = chatclient::EventLoop::make_tls_context(ca_file);
+    tls_server_name = server_name;
+}
 
-    // Fill in the server address structure
-    address_of_server.sin_family      = AF_INET;
-    address_of_server.sin_addr.s_addr = inet_addr(server_ipv4_address);
-    address_of_server.sin_port        = htons(port);
+// ---------------------------------------------------------------------------
+// show_line — one server message on the terminal
+// \r\033[K (carriage return + clear-to-end-of-line) overwrites the prompt
+// line once per iteration; run() redraws the prompt below the last message.
+// ---------------------------------------------------------------------------
+static void show_line(std::string_view text)
+{
+    if (!prompt_overwritten) screen += "\r\033[K";
+    prompt_overwritten = true;
+    screen.append(text.data(), text.size()).push_back('\n');
+}
 
-    if (connect(client_fd,
-                (struct sockaddr*)&address_of_server,
-                sizeof(address_of_server)) == -1)
-    {
-        // On failure: capture errno, recreate socket for a potential retry,
-        // then return the translated error
-        int err = errno;
-        close(client_fd);
-        client_fd = socket(AF_INET, SOCK_STREAM, 0); // fresh socket for retry
-        return verify_error_connection(err);
+static void show_message(const chatclient::Message& m)
+{
+    std::string line;
+    switch (m.kind) {
+    case chatclient::Message::Chat:
+        line.append(m.name).append(": ").append(m.text);
+        break;
+    case chatclient::Message::Channel:
+        line.append("[").append(m.channel).append("] ").append(m.name).append(": ").append(m.text);
+        break;
+    case chatclient::Message::Private:
+        line.append("[private] ").append(m.name).append(": ").append(m.text);
+        break;
+    default:
+        line.append(m.text); // Notices, and every v1 line as the server wrote it
+        break;
     }
+    show_line(line);
+}
 
-    // ── Auth mode selection ──────────────────────────────────────────────────
-    std::cout << "1. Register new account\n";
-    std::cout << "2. Login with existing account\n";
-    int choice = getInt("Choose an option (1 or 2): ", 1, 2);
-
-    AuthMode mode = (choice == 1) ? AuthMode::REGISTER : AuthMode::LOGIN;
-
-    // ── Credential collection with retry ────────────────────────────────────
-    UserCredentials creds;
-    int attempts = 0;
-    const int MAX_ATTEMPTS = 3;
-
-    while (attempts < MAX_ATTEMPTS) {
-        creds = get_user_credentials(mode);
-
-        if (creds.valid) break; // stop as soon as we have valid input
-
-        attempts++;
-        if (attempts < MAX_ATTEMPTS) {
-            std::cout << "\nPlease try again ("
-                      << (MAX_ATTEMPTS - attempts)
-                      << " attempts remaining)\n\n";
+// ---------------------------------------------------------------------------
+// start — one session for the credentials entered at the prompts
+// ---------------------------------------------------------------------------
+void TcpClient::start(const UserCredentials& creds, AuthMode mode)
+{
+    chatclient::Options opts;
+    opts.host             = server_ip;
+    opts.port             = static_cast<uint16_t>(port);
+    opts.username         = creds.username;
+    opts.password         = creds.password;
+    opts.register_account = mode == AuthMode::REGISTER;
+    opts.tls              = tls_ctx;
+    opts.server_name      = tls_server_name;
+    opts.backoff_min_ms   = 1000;
+
+    chatclient::Handlers h;
+    h.on_ready = [this, mode](chatclient::Session&, std::string_view) {
+        if (ready_once) {
+            show_line("✓ Reconnected!");
+            return;
         }
-    }
-
-    if (!creds.valid) {
-        std::cerr << "Too many failed attempts. Exiting.\n";
+        // First login: the terminal turns into the chat view
+        ready_once = true;
+        std::cout << (mode == AuthMode::REGISTER ? "\n✓ Authentication successful!\n" : "\n✓ Login successful!\n");
+        tcgetattr(STDIN_FILENO, &old_term);
+        setup_stdin(); // disable ICANON + ECHO; set stdin non-blocking
+        loop.watch(STDIN_FILENO, [this] { handle_stdin(this); });
+        screen.append(::username).append("> ");
+    };
+    h.on_message = [](chatclient::Session&, const chatclient::Message& m) { show_message(m); };
+    h.on_auth_failed = [this](chatclient::Session&, std::string_view reason) {
+        if (ready_once) restore_stdin();
+        std::cout << screen;
+        std::cerr << "\n✗ " << reason << "\n";
+        std::cerr << BOLD << RED << "\n[ERROR]: " << NC << "Authentication failed. Please restart the client and try again.\n";
         exit(1);
-    }
-
-    // ── Send credentials to server ───────────────────────────────────────────
-    std::string auth_msg = format_auth_message(creds, mode);
-    send(client_fd, auth_msg.c_str(), auth_msg.length(), 0);
-
-    // ── Read server response ─────────────────────────────────────────────────
-    char response[256]{};
-    ssize_t n = recv(client_fd, response, sizeof(response) - 1, 0);
-
-    if (n > 0) {
-        response[n] = '\0';
-
-        // "Registered" is 10 characters — check prefix to handle trailing newline
-        if (strncmp(response, "Registered", 10) == 0) {
-            std::cout << "\n✓ Authentication successful!\n";
-            username = creds.username; // store for use in the chat loop
-        }else if (strncmp(response, "Login successful", 16) == 0) {
-            std::cout << "\n✓ Login successful!\n";
-            username = creds.username; // store for use in the chat loop
+    };
+    h.on_disconnect = [this](chatclient::Session& s, std::string_view reason) {
+        const bool retrying = s.state() != chatclient::Session::State::Closed;
+        if (ready_once) {
+            show_line("Server disconnected.");
+            if (retrying) show_line("Reconnecting...");
+        } else {
+            std::cerr << "Failed to connect to " << server_ip << ":" << port << " - " << reason << "\n";
+            if (retrying) std::cout << "Retrying connection...\n";
         }
-        else if (strncmp(response, "[ERROR]: ", 9) == 0) {
-            system("clear");
-            std::cerr << "\n✗ " << response;
-            std::cerr <<  BOLD << RED << "\n[ERROR]: " << NC << "Authentication failed. Please restart the client and try again.\n";
+        if (!retrying) {
+            if (ready_once) restore_stdin();
+            std::cout << screen;
             exit(1);
         }
-    } else {
-        std::cerr << "No response from server\n";
-        return -1;
-    }
+    };
 
-    return 0;
+    username = creds.username;
+    session  = &loop.open(std::move(opts), std::move(h));
 }
 
 // ---------------------------------------------------------------------------
-// verify_error_connection — maps errno values to descriptive messages
+// run — the main I/O loop: the session's socket and stdin, one flush per
+// iteration
 // ---------------------------------------------------------------------------
-int TcpClient::verify_error_connection(int error_code)
+void TcpClient::run()
 {
-    switch (error_code) {
-        case ECONNREFUSED:
-            std::cerr << "Connection refused by server at "
-                      << server_ip << ":" << port << std::endl;
-            break;
-        case ETIMEDOUT:
-            std::cerr << "Connection timed out at "
-                      << server_ip << ":" << port << std::endl;
-            break;
-        case EHOSTUNREACH:
-            std::cerr << "No route to host "
-                      << server_ip << ":" << port << std::endl;
-            break;
-        case ENETUNREACH:
-            std::cerr << "Network unreachable for "
-                      << server_ip << ":" << port << std::endl;
-            break;
-        default:
-            std::cerr << "Failed to connect to " << server_ip << ":" << port
-                      << " - Error: " << strerror(error_code) << std::endl;
-            break;
+    while (true) {
+        loop.run_once(-1);
+
+        if (prompt_overwritten) screen.append(::username).append("> ").append(input_buffer);
+        prompt_overwritten = false;
+        if (!screen.empty()) {
+            std::cout << screen;
+            std::cout.flush();
+            screen.clear();
+        }
     }
-    return -1;
 }
 
 // ---------------------------------------------------------------------------
 // verify_command — handles slash-commands or sends regular chat messages
 // ---------------------------------------------------------------------------
-void TcpClient::verify_command(std::string *input_buffer, int sockfd)
+void TcpClient::verify_command(std::string *input_buffer)
 {
-    if (input_buffer->substr(0, 6) == "/clear") {
+    const commands::Match cmd = commands::lookup(*input_buffer);
+
+    if (cmd.id() == commands::Clear) {
         system("clear");
         input_buffer->clear();
     }
-    else if (input_buffer->substr(0, 5) == "/exit") {
+    else if (cmd.id() == commands::Exit) {
         restore_stdin();
         std::cout << "\nExiting chat client.\n";
-        close(sockfd);
         exit(0);
     }
-    else if (input_buffer->substr(0, 5) == "/help") {
+    else if (cmd.id() == commands::Help) {
         std::cout << "\nAvailable commands:\n";
-        std::cout << "  /clear - Clear the chat screen\n";
-        std::cout << "  /exit  - Exit the chat client\n";
-        std::cout << "  /help  - Show this help message\n";
+        std::cout << "  /clear           - Clear the chat screen\n";
+        std::cout << "  /exit            - Exit the chat client\n";
+        std::cout << "  /help            - Show this help message\n";
+        std::cout << "  /join #channel   - Join a channel and talk there\n";
+        std::cout << "  /part [#channel] - Leave a channel (default: the current one)\n";
+        std::cout << "  /channels        - List channels and their member counts\n";
+        std::cout << "  /history [n]     - Show the last n messages of the current channel\n";
+        std::cout << "  /history since <unix time> - ... or those sent since then\n";
+        std::cout << "  /msg <user> text - Send a private message to one user\n";
+        std::cout << "  /who [off]       - List who is online, then follow logins and logouts (off: stop)\n";
+        input_buffer->clear();
+    }
+    else if (cmd.entry && cmd.entry->where == commands::Server && cmd.id() != commands::Register &&
+             cmd.id() != commands::Login && cmd.id() != commands::Resume) {
+        // Channel commands, /msg and /who are executed by the server (which
+        // answers a missing argument with their usage)
+        session->send_command(*input_buffer);
         input_buffer->clear();
     }
     else if (!input_buffer->empty() && input_buffer->front() == '/') {
@@ -213,9 +215,9 @@ void TcpClient::verify_command(std::string *input_buffer, int sockfd)
         input_buffer->clear();
     }
     else {
-        // Regular chat message — send to server
-        input_buffer->append("\n");
-        send(sockfd, input_buffer->c_str(), input_buffer->size(), 0);
+        // Regular chat message — queued for the server (sent after the
+        // reconnect if the connection is down)
+        session->send_chat(*input_buffer);
         input_buffer->clear();
     }
 }
@@ -303,34 +305,6 @@ void TcpClient::trim(std::string& str)
     str.erase(str.find_last_not_of(" \t\n\r") + 1);
 }
 
-// ---------------------------------------------------------------------------
-// format_auth_message — builds the wire-protocol authentication string
-// ---------------------------------------------------------------------------
-std::string TcpClient::format_auth_message(const UserCredentials& creds, AuthMode mode)
-{
-    // Protocol format:
-    //   "/register <username>|<password>\n"  (cmd_type 2 on server)
-    //   "/login    <username>|<password>\n"  (cmd_type 1 on server)
-    if (mode == AuthMode::REGISTER)
-        return "/register " + creds.username + "|" + creds.password + "\n";
-    else
-        return "/login "    + creds.username + "|" + creds.password + "\n";
-}
-
-// ---------------------------------------------------------------------------
-// register_user — legacy error-triggered re-registration flow
-// ---------------------------------------------------------------------------
-void TcpClient::register_user(int server_socket, Errortype type)
-{
-    if (type == Errortype::Error_101)
-        std::cout << "[Error101] This username is already in use\n";
-
-    // register_username() returns "username|password" string
-    username = register_username();
-    std::string greeting = "/username " + username + "\n";
-    send(server_socket, greeting.c_str(), greeting.size(), 0);
-}
-
 // ---------------------------------------------------------------------------
 // register_username — standalone interactive prompt (legacy)
 // ---------------------------------------------------------------------------
@@ -386,99 +360,76 @@ std::string TcpClient::register_username()
 // ===========================================================================
 // main — entry point for the chat client
 // ===========================================================================
-int main()
+int main(int argc, char* argv[])
 {
     int port = 25565;
 
+    // TLS options: --tls, --ca-file PATH, --server-name NAME (either of the
+    // last two implies --tls)
+    bool use_tls = false;
+    std::string ca_file, server_name;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tls") {
+            use_tls = true;
+        } else if ((arg == "--ca-file" || arg == "--server-name") && i + 1 < argc) {
+            (arg == "--ca-file" ? ca_file : server_name) = argv[++i];
+            use_tls = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--tls] [--ca-file PATH] [--server-name NAME]\n";
+            return 1;
+        }
+    }
+
     // Prompt for the server IP, validated as an IPv4 address
     std::string server_ip = getString("Enter server ip address: ",
                                       false, true, StringType::IPV4);
 
-    // Construct client (creates socket); local IP is informational only
-    TcpClient client(port, server_ip.c_str());
-
-    // Retry connection until success (network may be temporarily unavailable)
-    while (true) {
-        int conn_result = client.connect_and_authenticate(server_ip.c_str());
-        if (conn_result == 0) break;
-        std::cout << "Retrying connection in 5 seconds...\n";
-        sleep(5);
-        continue;
+    TcpClient client(port, server_ip);
+    if (use_tls) {
+        try {
+            client.enable_tls(ca_file, server_name);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
     }
 
-    int sockfd = client.getClientFd();
-
-    // Save original terminal settings before switching to raw mode
-    tcgetattr(STDIN_FILENO, &old_term);
-    setup_stdin(); // disable ICANON + ECHO; set stdin non-blocking
+    // ── Auth mode selection ──────────────────────────────────────────────────
+    std::cout << "1. Register new account\n";
+    std::cout << "2. Login with existing account\n";
+    int choice = client.getInt("Choose an option (1 or 2): ", 1, 2);
 
-    fd_set read_fds;
-    int max_fd = std::max(STDIN_FILENO, sockfd); // needed by select()
+    AuthMode mode = (choice == 1) ? AuthMode::REGISTER : AuthMode::LOGIN;
 
-    // Authentication already succeeded inside connect_and_authenticate()
-    bool registered = true;
-    username = client.username;
+    // ── Credential collection with retry ────────────────────────────────────
+    UserCredentials creds;
+    int attempts = 0;
+    const int MAX_ATTEMPTS = 3;
 
-    // Show initial prompt
-    std::cout << username << "> ";
-    std::cout.flush();
+    while (attempts < MAX_ATTEMPTS) {
+        creds = client.get_user_credentials(mode);
 
-    std::string socket_buffer; // accumulates partial lines from the server
+        if (creds.valid) break; // stop as soon as we have valid input
 
-    // ── Main I/O loop ────────────────────────────────────────────────────────
-    while (true)
-    {
-        FD_ZERO(&read_fds);
-        FD_SET(STDIN_FILENO, &read_fds); // watch keyboard input
-        FD_SET(sockfd, &read_fds);       // watch server messages
-
-        // Block until either stdin or the socket is ready for reading
-        if (select(max_fd + 1, &read_fds, nullptr, nullptr, nullptr) < 0) {
-            if (errno == EINTR) continue; // signal interrupted select — retry
-            perror("select");
-            break;
+        attempts++;
+        if (attempts < MAX_ATTEMPTS) {
+            std::cout << "\nPlease try again ("
+                      << (MAX_ATTEMPTS - attempts)
+                      << " attempts remaining)\n\n";
         }
+    }
 
-        // ── Handle keyboard input ────────────────────────────────────────────
-        if (registered && FD_ISSET(STDIN_FILENO, &read_fds))
-            handle_stdin(sockfd, &client);
-
-        // ── Handle incoming server data ──────────────────────────────────────
-        if (FD_ISSET(sockfd, &read_fds))
-        {
-            char buf[1024]{};
-            ssize_t n = recv(sockfd, buf, sizeof(buf) - 1, 0);
-
-            if (n <= 0) {
-                // n == 0: server closed connection; n < 0: socket error
-                std::cout << "\nServer disconnected.\n";
-                restore_stdin();
-                close(sockfd);
-                return 0;
-            }
-
-            buf[n] = '\0';
-            socket_buffer.append(buf, n); // append to partial-message buffer
-
-            // Process all complete lines (delimited by '\n')
-            size_t pos;
-            while ((pos = socket_buffer.find('\n')) != std::string::npos)
-            {
-                std::string line = socket_buffer.substr(0, pos + 1);
-                socket_buffer.erase(0, pos + 1); // consume the processed line
-
-                // \r\033[K: carriage-return + clear-to-end-of-line (ANSI escape)
-                // This overwrites the current prompt line before printing the
-                // incoming message, then redraws the prompt + typed input below
-                std::cout << "\r\033[K" << line;
-                std::cout << username << "> " << input_buffer;
-                std::cout.flush();
-            }
-        }
+    if (!creds.valid) {
+        std::cerr << "Too many failed attempts. Exiting.\n";
+        return 1;
     }
 
-    restore_stdin();
-    close(sockfd);
+    // The session connects, authenticates and, whenever the connection
+    // drops, reconnects with backoff and resumes (token, else password).
+    username = creds.username;
+    client.start(creds, mode);
+    client.run();
     return 0;
 }
 
@@ -500,7 +451,7 @@ void setup_stdin()
     original_stdin_flags = fcntl(STDIN_FILENO, F_GETFL, 0);
 
     // O_NONBLOCK: read() on stdin returns immediately with EAGAIN if no data,
-    // allowing the select() loop to keep processing socket events without blocking
+    // allowing the event loop to keep processing socket events without blocking
     fcntl(STDIN_FILENO, F_SETFL, original_stdin_flags | O_NONBLOCK);
 
     termios new_term = old_term;
@@ -513,71 +464,77 @@ void setup_stdin()
 
 // ---------------------------------------------------------------------------
 // handle_stdin — reads raw keypresses and manages the input_buffer
-// Called each time select() signals stdin is ready for reading.
-// Because stdin is non-blocking (O_NONBLOCK), we drain ALL available
-// characters in a tight loop rather than reading just one per select wakeup.
+// Called each time the event loop sees stdin readable.
+// Because stdin is non-blocking (O_NONBLOCK), everything available is read
+// in chunks (a paste arrives in one or two reads); echo goes to `screen`,
+// which the loop writes out once.
 // ---------------------------------------------------------------------------
-void handle_stdin(int sockfd, TcpClient* client)
+void handle_stdin(TcpClient* client)
 {
-    char c;
+    char chunk[4096];
 
-    // Drain every character currently available on stdin.
+    // Drain everything currently available on stdin.
     // read() returns <= 0 when the buffer is empty (EAGAIN) or on error,
-    // at which point we stop and hand control back to the select() loop.
+    // at which point we stop and hand control back to the event loop.
     while (true)
     {
-        ssize_t r = read(STDIN_FILENO, &c, 1);
+        ssize_t r = read(STDIN_FILENO, chunk, sizeof(chunk));
         if (r <= 0) break; // EAGAIN (no more data) or unrecoverable error
 
-        // ── Enter / Return key: submit whatever is in the buffer ─────────────
-        if (c == '\n' || c == '\r')
+        for (ssize_t i = 0; i < r; ++i)
         {
-            if (!input_buffer.empty()) {
-                // Route the buffer through verify_command:
-                //   • slash-commands (/clear, /exit, /help) are handled locally
-                //   • unknown slash-commands print an error
-                //   • plain text is sent to the server as a chat message
-                client->verify_command(&input_buffer, sockfd);
-            }
+            const char c = chunk[i];
 
-            // Always redraw the prompt on a fresh line, even for empty Enter presses,
-            // so the terminal doesn't look broken after the user hits Enter
-            std::cout << "\n" << username << "> ";
-            std::cout.flush();
-            continue;
-        }
+            // ── Enter / Return key: submit whatever is in the buffer ─────────
+            if (c == '\n' || c == '\r')
+            {
+                if (!input_buffer.empty()) {
+                    // Route the buffer through verify_command:
+                    //   • slash-commands (/clear, /exit, /help) are handled locally
+                    //   • unknown slash-commands print an error
+                    //   • plain text is sent to the server as a chat message
+                    // Its own output must come after the echo so far.
+                    std::cout << screen;
+                    screen.clear();
+                    client->verify_command(&input_buffer);
+                }
+
+                // Always redraw the prompt on a fresh line, even for empty Enter presses,
+                // so the terminal doesn't look broken after the user hits Enter
+                screen.append("\n").append(username).append("> ");
+                continue;
+            }
 
-        // ── Backspace (127 = DEL on most terminals) or legacy \b ────────────
-        if (c == 127 || c == '\b')
-        {
-            if (!input_buffer.empty()) {
-                input_buffer.pop_back(); // remove last logical character
-
-                // Terminal sequence to visually erase the character:
-                //   \b   — move cursor one position left
-                //   ' '  — overwrite the character with a space
-                //   \b   — move cursor left again, ready for next input
-                std::cout << "\b \b";
-                std::cout.flush();
+            // ── Backspace (127 = DEL on most terminals) or legacy \b ────────
+            if (c == 127 || c == '\b')
+            {
+                if (!input_buffer.empty()) {
+                    input_buffer.pop_back(); // remove last logical character
+
+                    // Terminal sequence to visually erase the character:
+                    //   \b   — move cursor one position left
+                    //   ' '  — overwrite the character with a space
+                    //   \b   — move cursor left again, ready for next input
+                    screen += "\b \b";
+                }
+                // If buffer is already empty, silently ignore the backspace
+                // (no bell or error — keeps UX clean)
+                continue;
             }
-            // If buffer is already empty, silently ignore the backspace
-            // (no bell or error — keeps UX clean)
-            continue;
-        }
 
-        // ── Printable ASCII characters (0x20 space … 0x7E tilde) ────────────
-        // Rejects:
-        //   • control characters (0x00–0x1F): escape sequences, Ctrl+C, etc.
-        //   • DEL (0x7F): already handled above
-        //   • high bytes (0x80+): multi-byte UTF-8 sequences we don't support
-        if (c >= 32 && c < 127) {
-            input_buffer += c;  // append to logical buffer
-
-            // Manual echo: ECHO is disabled in raw mode (setup_stdin),
-            // so we must write each character ourselves to keep the
-            // display in sync with input_buffer
-            std::cout << c;
-            std::cout.flush();
+            // ── Printable ASCII characters (0x20 space … 0x7E tilde) ────────
+            // Rejects:
+            //   • control characters (0x00–0x1F): escape sequences, Ctrl+C, etc.
+            //   • DEL (0x7F): already handled above
+            //   • high bytes (0x80+): multi-byte UTF-8 sequences we don't support
+            if (c >= 32 && c < 127) {
+                input_buffer += c;  // append to logical buffer
+
+                // Manual echo: ECHO is disabled in raw mode (setup_stdin),
+                // so we must write each character ourselves to keep the
+                // display in sync with input_buffer
+                screen += c;
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,1825 @@
+// ============================================================================
+// bench_client — load generator speaking the real chat protocol.
+//
+// Opens many non-blocking connections from one thread, registers (or logs
+// in) every one with the same wire format as the interactive client, then
+// has `--senders` of them chat at a fixed aggregate `--rate`. Every message
+// carries its send time, so each copy delivered to the other sessions gives
+// one end-to-end fan-out latency sample (one process, one steady clock).
+//
+//   bench_client --clients 1000 --senders 20 --rate 200 --duration 10
+//
+// --replay plays a server traffic capture ([ADMIN] capture_file) back
+// instead: every captured connection is opened, and sends its records, at
+// the captured times (or --speed times faster). Credentials were masked
+// at capture, so logins are replayed as /register (then /login) with
+// --password, and chat records of 24+ bytes get a send time written over
+// their start, for the same latency samples. --server-pid adds the
+// server's CPU time; --save / --compare keep and diff the results of two
+// builds:
+//
+//   bench_client --replay peak.cap --speed 2 --server-pid 1234 --save base.txt
+//   bench_client --replay peak.cap --speed 2 --server-pid 5678 --compare base.txt
+//
+// --soak runs for hours instead: a steady population of --clients sessions
+// where --churn of them per second disconnect and log in again (one in ten
+// closing mid-login), a quarter join and leave extra channels and --rate
+// messages per second are broadcast. Every --sample seconds it scrapes the
+// server's /metrics for RSS, open fds and the sizes of its per-client
+// tables, takes the latency p99 of the interval, and at the end fails (exit
+// 1) if any of them drifted past its limit: the last samples against the
+// first ones after the warm-up:
+//
+//   bench_client --soak 4 --clients 200 --source-addrs 64 --save soak.csv
+//
+// The server limits connections per source address
+// ([NETWORK] max_connections_per_ip); against a loopback server
+// `--source-addrs N` spreads the sockets over 127.0.0.1 ... 127.0.0.N.
+// ============================================================================
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <capture_format.hpp>
+#include <commands.hpp>
+#include <protocol.hpp>
+#include <read_buffer.hpp>
+
+namespace {
+
+struct Options {
+    std::string host{"127.0.0.1"};
+    uint16_t port{25565};
+    size_t clients{100};         // Connections to open
+    size_t senders{10};          // Of those, how many send chat messages
+    double rate{100.0};          // Messages per second, all senders together
+    double duration{10.0};       // Seconds of load once every session is ready
+    double warmup{1.0};          // Leading seconds whose samples are dropped
+    std::string prefix{"bench"}; // Usernames are <prefix><index>
+    std::string password{"bench-password"};
+    bool v2{false};              // Speak protocol v2 instead of text lines
+    size_t connect_window{256};  // Connects in flight at once
+    unsigned source_addrs{1};    // Spread sources over 127.0.0.1..N
+    size_t message_size{32};     // Chat text bytes (padded)
+    std::string replay;          // Capture file to replay instead of generating load
+    double speed{1.0};           // Replay: captured time / this
+    long server_pid{0};          // Replay: report this process's CPU time
+    std::string save;            // Replay: write the results here
+    std::string compare;         // Replay: print deltas against these saved results
+    bool soak{false};            // Churn a steady population for `duration` and watch for drift
+    double churn{5.0};           // Soak: sessions closed (and reconnected) per second
+    uint16_t metrics_port{9464}; // Soak: the server's [ADMIN] metrics_port
+    double sample_interval{60.0}; // Soak: seconds between samples
+    double max_rss_mb{64.0};     // Soak: allowed growth over the baseline
+    uint64_t max_fds{32};
+    uint64_t max_table{0};       // 0 = max(32, clients / 20)
+    double max_p99_ratio{2.0};
+};
+
+void usage(const char* argv0)
+{
+    std::fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --host ADDR         server address (127.0.0.1)\n"
+        "  --port N            server port (25565)\n"
+        "  --clients N         connections to open (100)\n"
+        "  --senders N         connections that send messages (10)\n"
+        "  --rate N            messages per second, all senders together (100)\n"
+        "  --duration S        seconds of load (10)\n"
+        "  --warmup S          leading seconds excluded from latency (1)\n"
+        "  --size N            chat message size in bytes (32)\n"
+        "  --prefix NAME       username prefix (bench)\n"
+        "  --password PW       password for every account (bench-password)\n"
+        "  --v2                use the binary protocol v2\n"
+        "  --connect-window N  connection attempts in flight (256)\n"
+        "  --source-addrs N    bind sources to 127.0.0.1..127.0.0.N (1)\n"
+        "  --replay FILE       replay a server traffic capture instead\n"
+        "  --speed X           replay X times faster than captured (1)\n"
+        "  --server-pid PID    replay: report the server's CPU time\n"
+        "  --save FILE         replay: save the results\n"
+        "  --compare FILE      replay: print deltas against saved results\n"
+        "  --soak HOURS        churn the sessions for hours and fail on drift instead\n"
+        "  --churn N           soak: sessions closed and reconnected per second (5)\n"
+        "  --metrics-port N    soak: the server's metrics port (9464)\n"
+        "  --sample S          soak: seconds between samples (60)\n"
+        "  --max-rss-mb N      soak: allowed RSS growth (64)\n"
+        "  --max-fds N         soak: allowed open fd growth (32)\n"
+        "  --max-table N       soak: allowed growth of a table (max(32, clients/20))\n"
+        "  --max-p99 X         soak: allowed p99 latency factor, plus 1 ms (2)\n"
+        "  (--save FILE        soak: write the samples as CSV)\n",
+        argv0);
+}
+
+bool parse_options(int argc, char** argv, Options& o)
+{
+    bool warmup_set = false, sample_set = false, prefix_set = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        const char* v = nullptr;
+        if (a == "--v2") { o.v2 = true; continue; }
+        if (a == "-h" || a == "--help") return false;
+        if (!(v = value(a.c_str()))) return false;
+
+        if      (a == "--host")           o.host = v;
+        else if (a == "--port")           o.port = static_cast<uint16_t>(std::atoi(v));
+        else if (a == "--clients")        o.clients = std::strtoull(v, nullptr, 10);
+        else if (a == "--senders")        o.senders = std::strtoull(v, nullptr, 10);
+        else if (a == "--rate")           o.rate = std::atof(v);
+        else if (a == "--duration")       o.duration = std::atof(v);
+        else if (a == "--warmup")         { o.warmup = std::atof(v); warmup_set = true; }
+        else if (a == "--size")           o.message_size = std::strtoull(v, nullptr, 10);
+        else if (a == "--prefix")         { o.prefix = v; prefix_set = true; }
+        else if (a == "--password")       o.password = v;
+        else if (a == "--connect-window") o.connect_window = std::strtoull(v, nullptr, 10);
+        else if (a == "--source-addrs")   o.source_addrs = static_cast<unsigned>(std::atoi(v));
+        else if (a == "--replay")         o.replay = v;
+        else if (a == "--speed")          o.speed = std::atof(v);
+        else if (a == "--server-pid")     o.server_pid = std::atol(v);
+        else if (a == "--save")           o.save = v;
+        else if (a == "--compare")        o.compare = v;
+        else if (a == "--soak")           { o.soak = true; o.duration = std::atof(v) * 3600.0; }
+        else if (a == "--churn")          o.churn = std::atof(v);
+        else if (a == "--metrics-port")   o.metrics_port = static_cast<uint16_t>(std::atoi(v));
+        else if (a == "--sample")         { o.sample_interval = std::atof(v); sample_set = true; }
+        else if (a == "--max-rss-mb")     o.max_rss_mb = std::atof(v);
+        else if (a == "--max-fds")        o.max_fds = std::strtoull(v, nullptr, 10);
+        else if (a == "--max-table")      o.max_table = std::strtoull(v, nullptr, 10);
+        else if (a == "--max-p99")        o.max_p99_ratio = std::atof(v);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", a.c_str());
+            return false;
+        }
+    }
+    if (o.clients == 0 || o.rate <= 0 || o.duration <= 0 || o.speed <= 0) return false;
+    if (o.senders > o.clients) o.senders = o.clients;
+    if (o.connect_window == 0) o.connect_window = 1;
+    if (o.source_addrs == 0) o.source_addrs = 1;
+    if (o.message_size < 24) o.message_size = 24; // Room for the timestamp
+    if (o.soak) {
+        // Hours instead of seconds: the defaults scale down for short runs.
+        if (o.churn <= 0 || o.metrics_port == 0) return false;
+        if (!warmup_set) o.warmup = std::min(600.0, o.duration / 4);
+        if (!sample_set) o.sample_interval = std::min(60.0, std::max(1.0, o.duration / 20));
+        if (o.sample_interval < 1) o.sample_interval = 1;
+        if (!prefix_set) o.prefix = "soak";
+    }
+    return true;
+}
+
+uint64_t now_us()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+struct Percentiles {
+    uint32_t p50{0}, p99{0}, p999{0}, max{0};
+};
+
+Percentiles percentiles(const std::vector<uint32_t>& samples)
+{
+    Percentiles p;
+    if (samples.empty()) return p;
+    std::vector<uint32_t> sorted(samples);
+    auto pct = [&](double q) {
+        size_t k = static_cast<size_t>(q * (sorted.size() - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    };
+    p.p50  = pct(0.50);
+    p.p99  = pct(0.99);
+    p.p999 = pct(0.999);
+    p.max  = *std::max_element(sorted.begin(), sorted.end());
+    return p;
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+void on_sigint(int) { interrupted = 1; }
+
+// ----------------------------------------------------------------------------
+// One simulated user
+// ----------------------------------------------------------------------------
+struct Conn {
+    enum State { Idle, Connecting, Authenticating, Ready, Dead };
+
+    int fd{-1};
+    State state{Idle};
+    bool tried_login{false};  // "username already taken" → retry as /login
+    bool want_write{false};   // EPOLLOUT in the interest set
+    ReadBuffer in{4096};
+    std::string out;          // Bytes not accepted by the kernel yet
+    size_t out_offset{0};
+};
+
+class Bench {
+public:
+    explicit Bench(const Options& o) : opt(o), conns(o.clients) {}
+
+    int run();
+
+private:
+    // --- connection lifecycle ---
+    void start_connects();
+    void on_connected(size_t i);
+    void fail(size_t i, const char* why);
+    std::string username(size_t i) const { return opt.prefix + std::to_string(i); }
+    std::string auth_message(size_t i, bool login) const;
+
+    // --- I/O ---
+    void queue(size_t i, const std::string& bytes);
+    void flush(size_t i);
+    void on_readable(size_t i);
+    void on_record(size_t i, std::string_view text, bool notice);
+    void set_interest(size_t i, bool write);
+
+    // --- load ---
+    void send_due_messages(uint64_t now);
+    void report() const;
+
+    Options opt;
+    std::vector<Conn> conns;
+    int ep{-1};
+
+    size_t next_to_connect{0};
+    size_t connecting{0};
+    size_t connected{0};
+    size_t ready{0};
+    size_t failed{0};
+    size_t limit_rejections{0};
+
+    uint64_t t_start{0};
+    uint64_t t_all_connected{0};
+    uint64_t t_all_ready{0};
+    uint64_t t_load_start{0};
+    uint64_t t_load_end{0};
+    uint64_t next_send_us{0};
+    size_t next_sender{0};
+
+    uint64_t sent{0};             // Messages sent during the load phase
+    uint64_t sent_measured{0};    // Of those, after the warm-up
+    uint64_t delivered{0};        // Copies received
+    uint64_t delivered_in_window{0}; // Copies received during the load phase
+    std::vector<uint32_t> latency_us;
+    std::string padding;
+};
+
+std::string Bench::auth_message(size_t i, bool login) const
+{
+    const std::string name = username(i);
+    if (opt.v2) {
+        return protocol::make_named_frame(login ? protocol::Login : protocol::Register,
+                                          name, opt.password);
+    }
+    return (login ? "/login " : "/register ") + name + "|" + opt.password + "\n";
+}
+
+void Bench::set_interest(size_t i, bool write)
+{
+    Conn& c = conns[i];
+    if (c.want_write == write) return;
+    c.want_write = write;
+    epoll_event ev{};
+    ev.events   = EPOLLIN | (write ? EPOLLOUT : 0u);
+    ev.data.u64 = i;
+    epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void Bench::start_connects()
+{
+    while (next_to_connect < conns.size() && connecting < opt.connect_window) {
+        size_t i = next_to_connect++;
+        Conn& c  = conns[i];
+
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.fd == -1) { fail(i, strerror(errno)); continue; }
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (opt.source_addrs > 1) {
+            sockaddr_in src{};
+            src.sin_family      = AF_INET;
+            src.sin_addr.s_addr = htonl(0x7F000001u + static_cast<uint32_t>(i % opt.source_addrs));
+            bind(c.fd, reinterpret_cast<sockaddr*>(&src), sizeof(src));
+        }
+
+        sockaddr_in dst{};
+        dst.sin_family = AF_INET;
+        dst.sin_port   = htons(opt.port);
+        inet_pton(AF_INET, opt.host.c_str(), &dst.sin_addr);
+
+        if (connect(c.fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) == -1 && errno != EINPROGRESS) {
+            fail(i, strerror(errno));
+            continue;
+        }
+
+        c.state      = Conn::Connecting;
+        c.want_write = true;
+        epoll_event ev{};
+        ev.events   = EPOLLIN | EPOLLOUT;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+        ++connecting;
+    }
+}
+
+void Bench::on_connected(size_t i)
+{
+    Conn& c = conns[i];
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    --connecting;
+    if (err != 0) {
+        fail(i, strerror(err));
+        return;
+    }
+
+    if (++connected == conns.size() - failed) t_all_connected = now_us();
+    c.state = Conn::Authenticating;
+    set_interest(i, false);
+
+    std::string hello;
+    if (opt.v2) hello.assign(protocol::PREAMBLE, protocol::PREAMBLE_SIZE);
+    queue(i, hello + auth_message(i, false));
+}
+
+void Bench::fail(size_t i, const char* why)
+{
+    Conn& c = conns[i];
+    if (c.state == Conn::Dead) return;
+    if (c.state == Conn::Connecting) --connecting;
+    if (c.state == Conn::Ready) --ready;
+    if (failed < 5) std::fprintf(stderr, "connection %zu: %s\n", i, why);
+    if (c.fd != -1) close(c.fd);
+    c.fd    = -1;
+    c.state = Conn::Dead;
+    ++failed;
+}
+
+void Bench::queue(size_t i, const std::string& bytes)
+{
+    Conn& c = conns[i];
+    if (c.state == Conn::Dead) return;
+    if (c.out_offset == c.out.size()) {
+        c.out.clear();
+        c.out_offset = 0;
+    }
+    c.out.append(bytes);
+    flush(i);
+}
+
+void Bench::flush(size_t i)
+{
+    Conn& c = conns[i];
+    while (c.out_offset < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.out_offset, c.out.size() - c.out_offset, MSG_NOSIGNAL);
+        if (n > 0) { c.out_offset += static_cast<size_t>(n); continue; }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            set_interest(i, true);
+            return;
+        }
+        fail(i, n == 0 ? "send returned 0" : strerror(errno));
+        return;
+    }
+    set_interest(i, false);
+}
+
+void Bench::on_readable(size_t i)
+{
+    Conn& c = conns[i];
+    while (c.state != Conn::Dead) {
+        char* dst = c.in.write_ptr(65536);
+        ssize_t n = recv(c.fd, dst, c.in.writable(), 0);
+        if (n > 0) {
+            c.in.commit(static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) { fail(i, "closed by server"); return; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        fail(i, strerror(errno));
+        return;
+    }
+
+    // Same framing as the server: text lines or v2 frames.
+    std::string_view record;
+    while (c.state != Conn::Dead) {
+        if (!opt.v2) {
+            if (!c.in.next_line(record)) break;
+            while (!record.empty() && (record.back() == '\n' || record.back() == '\r')) record.remove_suffix(1);
+            on_record(i, record, c.state == Conn::Authenticating);
+            continue;
+        }
+
+        protocol::FrameHeader h;
+        if (!protocol::decode_header(c.in.view(), h)) break;
+        if (!c.in.take(protocol::HEADER_SIZE + h.length, record)) break;
+        std::string_view payload = record.substr(protocol::HEADER_SIZE);
+        std::string_view name, text;
+        if (h.type == protocol::Notice) {
+            on_record(i, payload, true);
+        } else if (h.type == protocol::Chat && protocol::split_named(payload, name, text)) {
+            on_record(i, text, false);
+        }
+    }
+}
+
+// One server record: an auth reply while authenticating, otherwise chat.
+void Bench::on_record(size_t i, std::string_view text, bool notice)
+{
+    Conn& c = conns[i];
+    if (c.state == Conn::Authenticating && notice) {
+        if (text.rfind("Registered", 0) == 0 || text.rfind("Login successful", 0) == 0) {
+            c.state = Conn::Ready;
+            if (++ready == conns.size() - failed) t_all_ready = now_us();
+        } else if (text.find("already taken") != std::string_view::npos && !c.tried_login) {
+            c.tried_login = true; // Account left over from an earlier run
+            queue(i, auth_message(i, true));
+        } else if (text.find("Connection limit") != std::string_view::npos) {
+            ++limit_rejections;
+            fail(i, "rejected by max_connections_per_ip (try --source-addrs)");
+        } else {
+            fail(i, std::string(text).c_str());
+        }
+        return;
+    }
+
+    // "<name>: bench <send_us> <padding>" (v1) or "bench <send_us> ..." (v2).
+    size_t mark = text.find("bench ");
+    if (mark == std::string_view::npos) return;
+    uint64_t sent_at = std::strtoull(std::string(text.substr(mark + 6, 20)).c_str(), nullptr, 10);
+    uint64_t now     = now_us();
+    ++delivered;
+    if (t_load_start && !t_load_end) ++delivered_in_window;
+    if (t_load_start && sent_at >= t_load_start + static_cast<uint64_t>(opt.warmup * 1e6) && now >= sent_at) {
+        latency_us.push_back(static_cast<uint32_t>(std::min<uint64_t>(now - sent_at, UINT32_MAX)));
+    }
+}
+
+void Bench::send_due_messages(uint64_t now)
+{
+    const double interval = 1e6 / opt.rate;
+    const uint64_t measure_from = t_load_start + static_cast<uint64_t>(opt.warmup * 1e6);
+
+    while (next_send_us <= now) {
+        // Round-robin over live senders (the first `senders` connections).
+        size_t tries = 0;
+        while (tries < opt.senders && conns[next_sender].state != Conn::Ready) {
+            next_sender = (next_sender + 1) % opt.senders;
+            ++tries;
+        }
+        if (tries == opt.senders) return; // Every sender is gone
+
+        char head[48];
+        int len = std::snprintf(head, sizeof(head), "bench %" PRIu64 " ", now);
+        std::string text(head, static_cast<size_t>(len));
+        if (text.size() < opt.message_size) text.append(padding, 0, opt.message_size - text.size());
+
+        queue(next_sender, opt.v2 ? protocol::make_frame(protocol::Chat, text) : text + "\n");
+        ++sent;
+        if (now >= measure_from) ++sent_measured;
+
+        next_sender   = (next_sender + 1) % opt.senders;
+        next_send_us += static_cast<uint64_t>(interval);
+        if (interval < 1.0) next_send_us += 1; // Never spin on a zero step
+    }
+}
+
+int Bench::run()
+{
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1) { std::perror("epoll_create1"); return 1; }
+    padding.assign(std::max<size_t>(opt.message_size, 64), 'x');
+
+    std::printf("bench_client: %zu clients, %zu senders, %.0f msg/s for %.1fs (%s) against %s:%u\n",
+                opt.clients, opt.senders, opt.rate, opt.duration, opt.v2 ? "v2" : "v1",
+                opt.host.c_str(), opt.port);
+
+    t_start = now_us();
+    std::vector<epoll_event> events(1024);
+    uint64_t grace_end = 0;
+
+    while (!interrupted)
+    {
+        start_connects();
+
+        uint64_t now = now_us();
+        const bool setup_done = ready + failed == conns.size() && next_to_connect == conns.size();
+        if (setup_done && !t_load_start) {
+            if (ready == 0) break;
+            if (!t_all_ready) t_all_ready = now;
+            t_load_start = next_send_us = now;
+            std::printf("all sessions ready, load running...\n");
+            std::fflush(stdout);
+        }
+        if (t_load_start && !t_load_end) {
+            if (now >= t_load_start + static_cast<uint64_t>(opt.duration * 1e6)) {
+                t_load_end = now;
+                grace_end  = now + 1000000; // Let in-flight messages arrive
+            } else {
+                send_due_messages(now);
+            }
+        }
+        if (t_load_end && now >= grace_end) break;
+
+        int timeout = 100;
+        if (t_load_start && !t_load_end) {
+            timeout = next_send_us > now ? static_cast<int>((next_send_us - now) / 1000) : 0;
+        }
+
+        int n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), timeout);
+        if (n < 0 && errno != EINTR) { std::perror("epoll_wait"); break; }
+
+        for (int k = 0; k < n; ++k) {
+            size_t i = static_cast<size_t>(events[k].data.u64);
+            Conn& c  = conns[i];
+            if (c.state == Conn::Dead) continue;
+            if (c.state == Conn::Connecting) {
+                if (events[k].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) on_connected(i);
+                continue;
+            }
+            if (events[k].events & EPOLLOUT) flush(i);
+            if (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) on_readable(i);
+        }
+    }
+
+    report();
+    for (Conn& c : conns) if (c.fd != -1) close(c.fd);
+    close(ep);
+    return failed == conns.size() ? 1 : 0;
+}
+
+void Bench::report() const
+{
+    auto secs = [](uint64_t a, uint64_t b) { return b > a ? (b - a) / 1e6 : 0.0; };
+
+    const double connect_s = secs(t_start, t_all_connected ? t_all_connected : t_all_ready);
+    const double auth_s    = secs(t_start, t_all_ready);
+    const double load_s    = secs(t_load_start, t_load_end ? t_load_end : now_us());
+
+    std::printf("\nconnections : %zu ok, %zu failed", connected, failed);
+    if (connect_s > 0) std::printf(", %.0f connects/s", connected / connect_s);
+    std::printf("\n");
+    if (limit_rejections) {
+        std::printf("              %zu refused by max_connections_per_ip\n", limit_rejections);
+    }
+    if (failed && opt.source_addrs == 1) {
+        std::printf("              (the server caps connections per source address; "
+                    "raise max_connections_per_ip or use --source-addrs)\n");
+    }
+    std::printf("sessions    : %zu authenticated after %.2fs", ready, auth_s);
+    if (auth_s > 0) std::printf(" (%.0f/s)", ready / auth_s);
+    std::printf("\n");
+
+    if (load_s <= 0) return;
+    const uint64_t receivers = ready > 0 ? ready - 1 : 0;
+    std::printf("load        : %.2fs, %" PRIu64 " messages sent (%.0f/s)\n", load_s, sent, sent / load_s);
+    std::printf("deliveries  : %" PRIu64 " received of ~%" PRIu64 " expected, %.0f/s during load\n",
+                delivered, sent * receivers, delivered_in_window / load_s);
+
+    if (latency_us.empty()) {
+        std::printf("latency     : no samples (warm-up longer than the run?)\n");
+        return;
+    }
+    const Percentiles p = percentiles(latency_us);
+    std::printf("latency us  : p50 %u  p99 %u  p99.9 %u  max %u  (%zu samples)\n",
+                p.p50, p.p99, p.p999, p.max, latency_us.size());
+}
+
+// ----------------------------------------------------------------------------
+// --replay: one captured connection per stream, fed at the captured times
+// ----------------------------------------------------------------------------
+
+// CPU seconds (user + system) used so far by `pid`, or -1.
+double process_cpu_seconds(long pid)
+{
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line)) return -1;
+    // Fields after the command name, which is parenthesized and may hold spaces.
+    const size_t close = line.rfind(')');
+    if (close == std::string::npos) return -1;
+    std::istringstream fields(line.substr(close + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+        if (i == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+    }
+    return static_cast<double>(utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+double own_cpu_seconds()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    auto secs = [](const timeval& tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+    return secs(ru.ru_utime) + secs(ru.ru_stime);
+}
+
+class Replay {
+public:
+    explicit Replay(const Options& o) : opt(o) {}
+
+    int run();
+
+private:
+    struct Event {
+        uint64_t at_us;   // Since the start of the capture
+        capture_format::Kind kind;
+        uint64_t stream;
+        std::string_view data;
+    };
+
+    struct Stream {
+        int fd{-1};
+        bool connecting{false};
+        bool dead{false};
+        bool started{false};      // First record seen (it decides the protocol)
+        bool v2{false};
+        bool closing{false};      // Captured close reached: close once `out` is sent
+        bool want_write{false};
+        bool auth_pending{false}; // Register/login sent, answer not back yet
+        bool login{false};        // ... and it was a /login
+        bool tried_other{false};  // Fell back from /register to /login (or back)
+        uint64_t history_before{0}; // Tags sent before this came from history (login, /join)
+        std::string name;         // From the captured auth record
+        std::string logged_in;    // Name the server accepted
+        ReadBuffer in{4096};
+        std::string out;
+        size_t out_offset{0};
+        std::vector<std::string_view> held; // Captured records due while auth_pending
+    };
+
+    bool load();
+    void dispatch(const Event& e, uint64_t now);
+    void open_stream(uint64_t id);
+    void send(uint64_t id, std::string bytes);
+    std::string rewrite(Stream& s, std::string_view record, uint64_t now);
+    std::string auth_record(const Stream& s, bool login) const;
+    void flush(uint64_t id);
+    void on_readable(uint64_t id);
+    void on_record(uint64_t id, std::string_view text, bool notice);
+    void auth_done(Stream& s, uint64_t id, bool ok);
+    void finish(uint64_t id, bool failed);
+    void set_interest(uint64_t id, bool write);
+    void report(double wall_s, double server_cpu, double own_cpu);
+
+    Options opt;
+    std::string file;
+    std::vector<Event> events;
+    std::map<uint64_t, Stream> streams;
+    int ep{-1};
+    size_t live{0};
+
+    uint64_t records_sent{0};
+    uint64_t bytes_sent{0};
+    uint64_t tagged{0};
+    uint64_t delivered{0};
+    uint64_t auth_failed{0};
+    uint64_t history_copies{0};  // Tagged copies replayed from history (no sample)
+    uint64_t resumes_skipped{0};
+    uint64_t failed{0};
+    uint64_t max_lag_us{0};      // Worst lateness of a record against its (scaled) capture time
+    std::vector<uint32_t> latency_us;
+};
+
+bool Replay::load()
+{
+    std::ifstream in(opt.replay, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "%s: %s\n", opt.replay.c_str(), strerror(errno));
+        return false;
+    }
+    file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    capture_format::Reader reader;
+    if (!reader.open(file)) {
+        std::fprintf(stderr, "%s: not a traffic capture\n", opt.replay.c_str());
+        return false;
+    }
+    capture_format::Record r;
+    uint64_t at = 0;
+    while (reader.next(r)) {
+        at += r.delta_us;
+        events.push_back(Event{at, r.kind, r.stream, r.data});
+    }
+    return true;
+}
+
+std::string Replay::auth_record(const Stream& s, bool login) const
+{
+    if (s.v2) return protocol::make_named_frame(login ? protocol::Login : protocol::Register, s.name, opt.password);
+    return (login ? "/login " : "/register ") + s.name + "|" + opt.password + "\n";
+}
+
+// The record as it goes out: credentials replaced, chat tagged with its
+// send time (same length), everything else as captured.
+std::string Replay::rewrite(Stream& s, std::string_view record, uint64_t now)
+{
+    std::string_view text = record;
+    size_t text_at = 0;
+    bool chat = false;
+
+    if (s.v2) {
+        protocol::FrameHeader h;
+        if (!protocol::decode_header(record, h)) return std::string(record); // The preamble
+        std::string_view payload = record.substr(protocol::HEADER_SIZE);
+        std::string_view name, rest;
+        if ((h.type == protocol::Register || h.type == protocol::Login) &&
+            protocol::split_named(payload, name, rest)) {
+            if (name == s.logged_in) return {}; // The captured retry of a fallback already done
+            s.name = std::string(name);
+            s.auth_pending = true;
+            s.login        = h.type == protocol::Login;
+            s.tried_other  = false;
+            return auth_record(s, s.login);
+        }
+        chat    = h.type == protocol::Chat;
+        text_at = protocol::HEADER_SIZE;
+        text    = payload; // A Command frame carries the same slash commands as a v1 line
+    } else {
+        chat = text.empty() || text[0] != '/';
+    }
+
+    const commands::Match cmd = commands::lookup(text);
+    if ((cmd.id() == commands::Login || cmd.id() == commands::Register) && cmd.has_arg) {
+        const size_t space = text.find(' ');
+        const size_t bar   = text.find('|');
+        if (bar != std::string_view::npos && bar > space) {
+            if (text.substr(space + 1, bar - space - 1) == s.logged_in) return {}; // See above
+            s.name = std::string(text.substr(space + 1, bar - space - 1));
+            s.auth_pending = true;
+            s.login        = text[1] == 'l';
+            s.tried_other  = false;
+            return auth_record(s, s.login);
+        }
+    }
+    if (cmd.id() == commands::Join && cmd.has_arg) s.history_before = now; // Its history is replayed on join
+    if (cmd.id() == commands::Resume && cmd.has_arg) {
+        ++resumes_skipped; // The token was masked and names no user
+        return {};
+    }
+
+    std::string out(record);
+    if (chat && text.size() >= 24) {
+        char head[32];
+        int len = std::snprintf(head, sizeof(head), "bench %" PRIu64 " ", now);
+        if (len > 0 && static_cast<size_t>(len) < text.size()) {
+            std::memcpy(&out[text_at], head, static_cast<size_t>(len));
+            ++tagged;
+        }
+    }
+    return out;
+}
+
+void Replay::set_interest(uint64_t id, bool write)
+{
+    Stream& s = streams[id];
+    if (s.want_write == write || s.fd == -1) return;
+    s.want_write = write;
+    epoll_event ev{};
+    ev.events   = EPOLLIN | (write ? EPOLLOUT : 0u);
+    ev.data.u64 = id;
+    epoll_ctl(ep, EPOLL_CTL_MOD, s.fd, &ev);
+}
+
+void Replay::open_stream(uint64_t id)
+{
+    Stream& s = streams[id];
+    s.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s.fd == -1) { finish(id, true); return; }
+    int one = 1;
+    setsockopt(s.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (opt.source_addrs > 1) {
+        sockaddr_in src{};
+        src.sin_family      = AF_INET;
+        src.sin_addr.s_addr = htonl(0x7F000001u + static_cast<uint32_t>(id % opt.source_addrs));
+        bind(s.fd, reinterpret_cast<sockaddr*>(&src), sizeof(src));
+    }
+
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_port   = htons(opt.port);
+    inet_pton(AF_INET, opt.host.c_str(), &dst.sin_addr);
+    if (connect(s.fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) == -1 && errno != EINPROGRESS) {
+        finish(id, true);
+        return;
+    }
+
+    s.connecting = true;
+    s.want_write = true;
+    epoll_event ev{};
+    ev.events   = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = id;
+    epoll_ctl(ep, EPOLL_CTL_ADD, s.fd, &ev);
+    ++live;
+}
+
+void Replay::send(uint64_t id, std::string bytes)
+{
+    Stream& s = streams[id];
+    if (s.dead || bytes.empty()) return;
+    if (s.out_offset == s.out.size()) {
+        s.out.clear();
+        s.out_offset = 0;
+    }
+    s.out += bytes;
+    ++records_sent;
+    bytes_sent += bytes.size();
+    if (!s.connecting) flush(id);
+}
+
+void Replay::dispatch(const Event& e, uint64_t now)
+{
+    if (e.kind == capture_format::Open) {
+        open_stream(e.stream);
+        return;
+    }
+    auto it = streams.find(e.stream);
+    if (it == streams.end() || it->second.dead) return; // Opened before the capture started
+    Stream& s = it->second;
+
+    if (e.kind == capture_format::Close) {
+        s.closing = true;
+        if (!s.connecting && s.out_offset == s.out.size() && s.held.empty()) finish(e.stream, false);
+        return;
+    }
+
+    if (!s.started) {
+        s.started = true;
+        s.v2 = !e.data.empty() && e.data[0] == protocol::PREAMBLE[0];
+    }
+    if (s.auth_pending) {
+        s.held.push_back(e.data); // Sent once the server has answered
+        return;
+    }
+    send(e.stream, rewrite(s, e.data, now));
+}
+
+void Replay::flush(uint64_t id)
+{
+    Stream& s = streams[id];
+    while (s.out_offset < s.out.size()) {
+        ssize_t n = ::send(s.fd, s.out.data() + s.out_offset, s.out.size() - s.out_offset, MSG_NOSIGNAL);
+        if (n > 0) { s.out_offset += static_cast<size_t>(n); continue; }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            set_interest(id, true);
+            return;
+        }
+        finish(id, true);
+        return;
+    }
+    set_interest(id, false);
+    if (s.closing && s.held.empty()) finish(id, false);
+}
+
+void Replay::on_readable(uint64_t id)
+{
+    Stream& s = streams[id];
+    while (!s.dead) {
+        char* dst = s.in.write_ptr(65536);
+        ssize_t n = recv(s.fd, dst, s.in.writable(), 0);
+        if (n > 0) {
+            s.in.commit(static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) { finish(id, !s.closing); return; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        finish(id, true);
+        return;
+    }
+
+    std::string_view record;
+    while (!s.dead) {
+        if (!s.v2) {
+            if (!s.in.next_line(record)) break;
+            while (!record.empty() && (record.back() == '\n' || record.back() == '\r')) record.remove_suffix(1);
+            on_record(id, record, s.auth_pending);
+            continue;
+        }
+        protocol::FrameHeader h;
+        if (!protocol::decode_header(s.in.view(), h)) break;
+        if (!s.in.take(protocol::HEADER_SIZE + h.length, record)) break;
+        std::string_view payload = record.substr(protocol::HEADER_SIZE);
+        std::string_view name, text;
+        if (h.type == protocol::Notice) {
+            on_record(id, payload, true);
+        } else if ((h.type == protocol::Chat || h.type == protocol::Private) &&
+                   protocol::split_named(payload, name, text)) {
+            on_record(id, text, false);
+        } else if (h.type == protocol::ChannelChat && protocol::split_named(payload, name, text) &&
+                   protocol::split_named(text, name, text)) {
+            on_record(id, text, false);
+        }
+    }
+}
+
+void Replay::on_record(uint64_t id, std::string_view text, bool notice)
+{
+    Stream& s = streams[id];
+    if (s.auth_pending && notice) {
+        if (text.rfind("Registered", 0) == 0 || text.rfind("Login successful", 0) == 0) {
+            auth_done(s, id, true);
+        } else if (text.find("already taken") != std::string_view::npos && !s.login && !s.tried_other) {
+            s.tried_other = s.login = true; // Registered by an earlier replay: log in instead
+            send(id, auth_record(s, true));
+        } else if (text.find("invalid username or password") != std::string_view::npos && s.login &&
+                   !s.tried_other) {
+            s.tried_other = true; // Unknown to this server: register it
+            s.login       = false;
+            send(id, auth_record(s, false));
+        } else if (text.rfind("Error", 0) == 0 || text.rfind("[ERROR]", 0) == 0) {
+            ++auth_failed;
+            auth_done(s, id, false);
+        }
+        return;
+    }
+
+    size_t mark = text.find("bench ");
+    if (mark == std::string_view::npos) return;
+    uint64_t sent_at = std::strtoull(std::string(text.substr(mark + 6, 20)).c_str(), nullptr, 10);
+    uint64_t now     = now_us();
+    ++delivered;
+    if (sent_at < s.history_before) {
+        ++history_copies; // Sent before this stream joined: not a delivery latency
+        return;
+    }
+    if (sent_at && now >= sent_at) {
+        latency_us.push_back(static_cast<uint32_t>(std::min<uint64_t>(now - sent_at, UINT32_MAX)));
+    }
+}
+
+// The server answered the stream's login: what it sent meanwhile goes out.
+void Replay::auth_done(Stream& s, uint64_t id, bool ok)
+{
+    // A refused login goes on unauthenticated, as it may have when captured.
+    const uint64_t now = now_us();
+    if (ok) {
+        s.history_before = now;
+        s.logged_in      = s.name;
+    }
+    s.auth_pending = false;
+    std::vector<std::string_view> held;
+    held.swap(s.held);
+    for (size_t k = 0; k < held.size(); ++k) {
+        if (s.auth_pending) {
+            // Another login among them: the rest waits for its answer.
+            s.held.insert(s.held.end(), held.begin() + static_cast<std::ptrdiff_t>(k), held.end());
+            break;
+        }
+        send(id, rewrite(s, held[k], now));
+    }
+    if (s.closing && s.held.empty() && !s.connecting && s.out_offset == s.out.size()) finish(id, false);
+}
+
+void Replay::finish(uint64_t id, bool failure)
+{
+    Stream& s = streams[id];
+    if (s.dead) return;
+    if (failure) ++failed;
+    if (s.fd != -1) {
+        close(s.fd);
+        --live;
+    }
+    s.fd   = -1;
+    s.dead = true;
+    s.out.clear();
+    s.held.clear();
+}
+
+int Replay::run()
+{
+    if (!load()) return 1;
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1) { std::perror("epoll_create1"); return 1; }
+
+    const uint64_t span_us = events.empty() ? 0 : events.back().at_us;
+    std::printf("bench_client: replaying %s (%zu records, %.1fs captured) at %.2fx against %s:%u\n",
+                opt.replay.c_str(), events.size(), span_us / 1e6, opt.speed, opt.host.c_str(), opt.port);
+    std::fflush(stdout);
+
+    const double server_cpu_start = opt.server_pid ? process_cpu_seconds(opt.server_pid) : -1;
+    const double own_cpu_start    = own_cpu_seconds();
+    const uint64_t t0 = now_us();
+    size_t next = 0;
+    uint64_t grace_end = 0;
+    std::vector<epoll_event> ready(1024);
+
+    while (!interrupted) {
+        const uint64_t now = now_us();
+        const uint64_t replay_at = static_cast<uint64_t>((now - t0) * opt.speed); // Position in the capture
+        while (next < events.size() && events[next].at_us <= replay_at) {
+            const uint64_t due = t0 + static_cast<uint64_t>(events[next].at_us / opt.speed);
+            if (now > due) max_lag_us = std::max(max_lag_us, now - due);
+            dispatch(events[next++], now);
+        }
+
+        if (next == events.size()) {
+            if (!grace_end) grace_end = now + 1000000; // Let the last answers arrive
+            if (live == 0 || now >= grace_end) break;
+        }
+
+        int timeout = 100;
+        if (next < events.size()) {
+            const uint64_t due = t0 + static_cast<uint64_t>(events[next].at_us / opt.speed);
+            timeout = due > now ? static_cast<int>(std::min<uint64_t>((due - now) / 1000, 100)) : 0;
+        }
+
+        int n = epoll_wait(ep, ready.data(), static_cast<int>(ready.size()), timeout);
+        if (n < 0 && errno != EINTR) { std::perror("epoll_wait"); break; }
+
+        for (int k = 0; k < n; ++k) {
+            const uint64_t id = ready[k].data.u64;
+            Stream& s = streams[id];
+            if (s.dead) continue;
+            if (s.connecting) {
+                if (!(ready[k].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) continue;
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    if (failed < 5) std::fprintf(stderr, "stream %" PRIu64 ": %s\n", id, strerror(err));
+                    finish(id, true);
+                    continue;
+                }
+                s.connecting = false;
+                flush(id); // What was due while connecting
+                continue;
+            }
+            if (ready[k].events & EPOLLOUT) flush(id);
+            if (!s.dead && (ready[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) on_readable(id);
+        }
+    }
+
+    const double wall_s     = (now_us() - t0) / 1e6;
+    const double server_cpu = opt.server_pid && server_cpu_start >= 0
+                                  ? process_cpu_seconds(opt.server_pid) - server_cpu_start : -1;
+    report(wall_s, server_cpu, own_cpu_seconds() - own_cpu_start);
+
+    for (auto& entry : streams) if (entry.second.fd != -1) close(entry.second.fd);
+    close(ep);
+    return failed == streams.size() && !streams.empty() ? 1 : 0;
+}
+
+void Replay::report(double wall_s, double server_cpu, double own_cpu)
+{
+    std::map<std::string, double> results;
+    results["streams"]        = static_cast<double>(streams.size());
+    results["records_sent"]   = static_cast<double>(records_sent);
+    results["bytes_sent"]     = static_cast<double>(bytes_sent);
+    results["wall_s"]         = wall_s;
+    results["max_lag_ms"]     = max_lag_us / 1000.0;
+    results["deliveries"]     = static_cast<double>(delivered);
+    results["client_cpu_s"]   = own_cpu;
+    if (server_cpu >= 0) {
+        results["server_cpu_s"] = server_cpu;
+        if (records_sent) results["server_cpu_us_per_record"] = server_cpu * 1e6 / records_sent;
+    }
+    if (!latency_us.empty()) {
+        const Percentiles p = percentiles(latency_us);
+        results["latency_p50_us"]  = p.p50;
+        results["latency_p99_us"]  = p.p99;
+        results["latency_p999_us"] = p.p999;
+        results["latency_max_us"]  = p.max;
+    }
+
+    std::printf("\nstreams     : %zu replayed, %" PRIu64 " failed, %" PRIu64 " logins refused",
+                streams.size(), failed, auth_failed);
+    if (resumes_skipped) std::printf(", %" PRIu64 " /resume skipped", resumes_skipped);
+    std::printf("\nrecords     : %" PRIu64 " sent (%" PRIu64 " bytes) in %.2fs, at most %.1f ms late\n",
+                records_sent, bytes_sent, wall_s, max_lag_us / 1000.0);
+    std::printf("deliveries  : %" PRIu64 " tagged copies received (%" PRIu64 " records tagged, %" PRIu64
+                " copies from history)\n", delivered, tagged, history_copies);
+    if (latency_us.empty()) {
+        std::printf("latency     : no samples (no chat of 24+ bytes in the capture?)\n");
+    } else {
+        std::printf("latency us  : p50 %.0f  p99 %.0f  p99.9 %.0f  max %.0f  (%zu samples)\n",
+                    results["latency_p50_us"], results["latency_p99_us"], results["latency_p999_us"],
+                    results["latency_max_us"], latency_us.size());
+    }
+    if (server_cpu >= 0) {
+        std::printf("server cpu  : %.2fs (%.0f%% of a core), %.1f us per record\n", server_cpu,
+                    wall_s > 0 ? 100.0 * server_cpu / wall_s : 0.0, results["server_cpu_us_per_record"]);
+    }
+    std::printf("client cpu  : %.2fs\n", own_cpu);
+
+    if (!opt.save.empty()) {
+        std::ofstream out(opt.save);
+        for (const auto& kv : results) out << kv.first << ' ' << kv.second << '\n';
+        if (out) std::printf("results saved to %s\n", opt.save.c_str());
+        else std::fprintf(stderr, "%s: could not write\n", opt.save.c_str());
+    }
+
+    if (!opt.compare.empty()) {
+        std::ifstream in(opt.compare);
+        if (!in) {
+            std::fprintf(stderr, "%s: %s\n", opt.compare.c_str(), strerror(errno));
+            return;
+        }
+        std::printf("\nagainst %s:\n", opt.compare.c_str());
+        std::string key;
+        double base = 0;
+        while (in >> key >> base) {
+            auto it = results.find(key);
+            if (it == results.end()) continue;
+            const double delta = base != 0 ? 100.0 * (it->second - base) / base : 0.0;
+            std::printf("  %-26s %12.1f -> %12.1f  (%+.1f%%)\n", key.c_str(), base, it->second, delta);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// --soak: a steady population churning for hours, watched for drift
+// ----------------------------------------------------------------------------
+
+// One scrape of the server's /metrics ([ADMIN] metrics_port).
+struct ServerSample {
+    double rss_mb{0};
+    uint64_t fds{0};
+    uint64_t connections{0};
+    std::map<std::string, uint64_t> tables; // tcpserver_table_entries, summed over reactors
+};
+
+// GET /metrics; false if the server didn't answer with the process metrics.
+bool scrape_metrics(const std::string& host, uint16_t port, ServerSample& out)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return false;
+    timeval timeout{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_port   = htons(port);
+    inet_pton(AF_INET, host.c_str(), &dst.sin_addr);
+    const std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    if (connect(fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) == -1 ||
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        close(fd);
+        return false;
+    }
+    std::string response;
+    char buf[16384];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) response.append(buf, static_cast<size_t>(n));
+    close(fd);
+
+    out = ServerSample{};
+    bool found = false;
+    std::istringstream lines(response);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const size_t space = line.rfind(' ');
+        if (space == std::string::npos) continue;
+        const std::string name = line.substr(0, space);
+        const double value     = std::atof(line.c_str() + space + 1);
+        if (name == "process_resident_memory_bytes") {
+            out.rss_mb = value / (1024.0 * 1024.0);
+            found = true;
+        } else if (name == "process_open_fds") {
+            out.fds = static_cast<uint64_t>(value);
+        } else if (name.rfind("tcpserver_connections{", 0) == 0) {
+            out.connections += static_cast<uint64_t>(value);
+        } else if (name.rfind("tcpserver_table_entries{", 0) == 0) {
+            size_t at = name.find("table=\"");
+            if (at == std::string::npos) continue;
+            at += 7;
+            out.tables[name.substr(at, name.find('"', at) - at)] += static_cast<uint64_t>(value);
+        }
+    }
+    return found;
+}
+
+class Soak {
+public:
+    explicit Soak(const Options& o) : opt(o), sessions(o.clients) {}
+
+    int run();
+
+private:
+    struct Session {
+        enum State { Idle, Connecting, Authenticating, Ready };
+
+        int fd{-1};
+        State state{Idle};
+        uint32_t generation{0};     // Per connection: events of a closed one are ignored
+        bool account{false};        // Exists on the server: log in instead of registering
+        bool tried_other{false};    // "already taken" → /login once
+        bool abandon{false};        // Close right after sending the login (churn mid-auth)
+        bool want_write{false};
+        uint64_t reconnect_at{0};   // Idle: connect again from then on
+        uint64_t part_at{0};        // Ready: leave the extra channel then (0 = not in one)
+        uint64_t history_before{0}; // Tags sent before this came from history (login, /join)
+        ReadBuffer in{4096};
+        std::string out;
+        size_t out_offset{0};
+    };
+
+    struct Row {
+        double at_s{0};
+        ServerSample server;
+        uint32_t p99_us{0};
+        size_t ready{0};
+    };
+
+    // One checked quantity of a Row and how far it may move from the baseline.
+    struct Check {
+        const char* name;
+        double (*value)(const Row&, const std::string&);
+        std::string table; // For the table checks
+        double limit;      // Allowed growth (p99: factor, see drifted())
+    };
+
+    std::string username(size_t i) const { return opt.prefix + std::to_string(i); }
+    std::string auth_message(size_t i, bool login) const;
+    std::string command(const std::string& text) const;
+
+    void connect_due(uint64_t now);
+    void connect(size_t i, uint64_t now);
+    void on_connected(size_t i, uint64_t now);
+    void drop(size_t i, uint64_t now, uint64_t reconnect_delay_us);
+    void queue(size_t i, const std::string& bytes);
+    void flush(size_t i, uint64_t now);
+    void on_readable(size_t i, uint64_t now);
+    void on_record(size_t i, std::string_view text, bool notice, uint64_t now);
+    void set_interest(size_t i, bool write);
+
+    void housekeeping(uint64_t now);
+    void churn(uint64_t now);
+    void send_due(uint64_t now);
+    void take_sample(uint64_t now);
+    std::vector<Check> checks() const;
+    double window(const Check& check, size_t from, size_t count) const;
+    bool drifted(const Check& check, double base, double value, std::string& why) const;
+    int verdict() const;
+
+    uint64_t random_us(uint64_t lo, uint64_t hi) { return lo + rng() % (hi - lo + 1); }
+
+    Options opt;
+    std::vector<Session> sessions;
+    std::mt19937_64 rng{1}; // Fixed seed: the same run twice churns alike
+    int ep{-1};
+    FILE* csv{nullptr};
+
+    uint64_t t_start{0};
+    uint64_t t_end{0};
+    uint64_t next_send_us{0};
+    uint64_t next_churn_us{0};
+    uint64_t next_sample_us{0};
+    uint64_t next_housekeeping_us{0};
+    size_t in_flight{0};            // Connecting or authenticating
+    size_t ready{0};
+
+    uint64_t sent{0};
+    uint64_t delivered{0};
+    uint64_t logins{0};
+    uint64_t churned{0};            // Sessions closed by the churn
+    uint64_t abandoned{0};          // ... of which right after sending the login
+    uint64_t relogin_races{0};      // "already logged in": the old session wasn't gone yet
+    uint64_t refused{0};            // Connection limit or other auth errors
+    uint64_t server_closes{0};      // Closed by the server (slow consumer, errors)
+    uint64_t scrape_failures{0};
+    std::vector<uint32_t> window_us; // Latencies since the last sample
+    std::vector<Row> rows;
+    std::string padding;
+};
+
+std::string Soak::auth_message(size_t i, bool login) const
+{
+    const std::string name = username(i);
+    if (opt.v2) {
+        return protocol::make_named_frame(login ? protocol::Login : protocol::Register,
+                                          name, opt.password);
+    }
+    return (login ? "/login " : "/register ") + name + "|" + opt.password + "\n";
+}
+
+std::string Soak::command(const std::string& text) const
+{
+    return opt.v2 ? protocol::make_frame(protocol::Command, text) : text + "\n";
+}
+
+void Soak::set_interest(size_t i, bool write)
+{
+    Session& s = sessions[i];
+    if (s.want_write == write) return;
+    s.want_write = write;
+    epoll_event ev{};
+    ev.events   = EPOLLIN | (write ? EPOLLOUT : 0u);
+    ev.data.u64 = (static_cast<uint64_t>(s.generation) << 32) | i;
+    epoll_ctl(ep, EPOLL_CTL_MOD, s.fd, &ev);
+}
+
+void Soak::connect_due(uint64_t now)
+{
+    for (size_t i = 0; i < sessions.size() && in_flight < opt.connect_window; ++i) {
+        if (sessions[i].state == Session::Idle && sessions[i].reconnect_at <= now) connect(i, now);
+    }
+}
+
+void Soak::connect(size_t i, uint64_t now)
+{
+    Session& s = sessions[i];
+    s.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s.fd == -1) {
+        s.reconnect_at = now + 1000000;
+        return;
+    }
+    int one = 1;
+    setsockopt(s.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (opt.source_addrs > 1) {
+        sockaddr_in src{};
+        src.sin_family      = AF_INET;
+        src.sin_addr.s_addr = htonl(0x7F000001u + static_cast<uint32_t>(i % opt.source_addrs));
+        bind(s.fd, reinterpret_cast<sockaddr*>(&src), sizeof(src));
+    }
+
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_port   = htons(opt.port);
+    inet_pton(AF_INET, opt.host.c_str(), &dst.sin_addr);
+
+    ++s.generation;
+    s.state      = Session::Connecting;
+    s.want_write = true;
+    ++in_flight;
+    if (::connect(s.fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) == -1 && errno != EINPROGRESS) {
+        drop(i, now, 1000000);
+        return;
+    }
+    epoll_event ev{};
+    ev.events   = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = (static_cast<uint64_t>(s.generation) << 32) | i;
+    epoll_ctl(ep, EPOLL_CTL_ADD, s.fd, &ev);
+}
+
+void Soak::on_connected(size_t i, uint64_t now)
+{
+    Session& s = sessions[i];
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+        drop(i, now, 1000000);
+        return;
+    }
+
+    s.state       = Session::Authenticating;
+    s.tried_other = false;
+    set_interest(i, false);
+
+    std::string hello;
+    if (opt.v2) hello.assign(protocol::PREAMBLE, protocol::PREAMBLE_SIZE);
+    queue(i, hello + auth_message(i, s.account));
+    if (s.abandon && s.state == Session::Authenticating) {
+        // The server gets the login and then the close, with the hash
+        // (or the username claim) possibly still in flight.
+        s.abandon = false;
+        ++abandoned;
+        drop(i, now, random_us(50000, 500000));
+    }
+}
+
+// Closes the current connection; the session connects again after the delay.
+void Soak::drop(size_t i, uint64_t now, uint64_t reconnect_delay_us)
+{
+    Session& s = sessions[i];
+    if (s.state == Session::Idle) return;
+    if (s.state == Session::Connecting || s.state == Session::Authenticating) --in_flight;
+    if (s.state == Session::Ready) --ready;
+    if (s.fd != -1) close(s.fd);
+    s.fd           = -1;
+    s.state        = Session::Idle;
+    s.want_write   = false;
+    s.part_at      = 0;
+    s.reconnect_at = now + reconnect_delay_us;
+    s.in.clear();
+    s.out.clear();
+    s.out_offset = 0;
+}
+
+void Soak::queue(size_t i, const std::string& bytes)
+{
+    Session& s = sessions[i];
+    if (s.state == Session::Idle) return;
+    if (s.out_offset == s.out.size()) {
+        s.out.clear();
+        s.out_offset = 0;
+    }
+    s.out.append(bytes);
+    flush(i, now_us());
+}
+
+void Soak::flush(size_t i, uint64_t now)
+{
+    Session& s = sessions[i];
+    while (s.out_offset < s.out.size()) {
+        ssize_t n = send(s.fd, s.out.data() + s.out_offset, s.out.size() - s.out_offset, MSG_NOSIGNAL);
+        if (n > 0) { s.out_offset += static_cast<size_t>(n); continue; }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            set_interest(i, true);
+            return;
+        }
+        ++server_closes;
+        drop(i, now, 1000000);
+        return;
+    }
+    set_interest(i, false);
+}
+
+void Soak::on_readable(size_t i, uint64_t now)
+{
+    Session& s = sessions[i];
+    const uint32_t generation = s.generation;
+    while (s.state != Session::Idle) {
+        char* dst = s.in.write_ptr(65536);
+        ssize_t n = recv(s.fd, dst, s.in.writable(), 0);
+        if (n > 0) {
+            s.in.commit(static_cast<size_t>(n));
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        ++server_closes;
+        drop(i, now, 1000000);
+        return;
+    }
+
+    // Same framing as Bench::on_readable(); a record may end the connection.
+    std::string_view record;
+    while (s.state != Session::Idle && s.generation == generation) {
+        if (!opt.v2) {
+            if (!s.in.next_line(record)) break;
+            while (!record.empty() && (record.back() == '\n' || record.back() == '\r')) record.remove_suffix(1);
+            on_record(i, record, s.state == Session::Authenticating, now);
+            continue;
+        }
+
+        protocol::FrameHeader h;
+        if (!protocol::decode_header(s.in.view(), h)) break;
+        if (!s.in.take(protocol::HEADER_SIZE + h.length, record)) break;
+        std::string_view payload = record.substr(protocol::HEADER_SIZE);
+        std::string_view name, text;
+        if (h.type == protocol::Notice) {
+            on_record(i, payload, true, now);
+        } else if (h.type == protocol::Chat && protocol::split_named(payload, name, text)) {
+            on_record(i, text, false, now);
+        }
+    }
+}
+
+void Soak::on_record(size_t i, std::string_view text, bool notice, uint64_t now)
+{
+    Session& s = sessions[i];
+    if (s.state == Session::Authenticating && notice) {
+        if (text.rfind("Registered", 0) == 0 || text.rfind("Login successful", 0) == 0) {
+            s.state   = Session::Ready;
+            s.account = true;
+            s.history_before = now;
+            --in_flight;
+            ++ready;
+            ++logins;
+            // A quarter of the sessions also join (and later leave) one of
+            // eight extra channels, so channels come and go as well.
+            if (i % 4 == 0) {
+                queue(i, command("/join #soak" + std::to_string(i / 4 % 8)));
+                s.part_at = now + random_us(2000000, 20000000);
+            }
+        } else if (text.find("already taken") != std::string_view::npos && !s.tried_other) {
+            s.tried_other = true; // Account left over from an earlier run
+            s.account     = true;
+            queue(i, auth_message(i, true));
+        } else if (text.find("already logged in") != std::string_view::npos) {
+            ++relogin_races; // The server hasn't seen the previous close yet
+            drop(i, now, random_us(100000, 300000));
+        } else {
+            if (refused < 5) std::fprintf(stderr, "session %zu: %.*s\n", i, int(text.size()), text.data());
+            ++refused;
+            drop(i, now, 1000000);
+        }
+        return;
+    }
+
+    // "<name>: bench <send_us> <padding>" (v1) or "bench <send_us> ..." (v2).
+    size_t mark = text.find("bench ");
+    if (mark == std::string_view::npos) return;
+    uint64_t sent_at = std::strtoull(std::string(text.substr(mark + 6, 20)).c_str(), nullptr, 10);
+    ++delivered;
+    if (sent_at >= s.history_before && now >= sent_at) {
+        window_us.push_back(static_cast<uint32_t>(std::min<uint64_t>(now - sent_at, UINT32_MAX)));
+    }
+}
+
+// Every 100 ms: reconnects due, extra channels left.
+void Soak::housekeeping(uint64_t now)
+{
+    connect_due(now);
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        Session& s = sessions[i];
+        if (s.state != Session::Ready || !s.part_at || s.part_at > now) continue;
+        s.part_at = 0;
+        queue(i, command("/part #soak" + std::to_string(i / 4 % 8)));
+    }
+}
+
+// One in ten churned sessions comes back only to close mid-login.
+void Soak::churn(uint64_t now)
+{
+    const double interval = 1e6 / opt.churn;
+    while (next_churn_us <= now) {
+        next_churn_us += std::max<uint64_t>(static_cast<uint64_t>(interval), 1);
+        for (int tries = 0; tries < 8; ++tries) {
+            const size_t i = rng() % sessions.size();
+            if (sessions[i].state != Session::Ready) continue;
+            sessions[i].abandon = rng() % 10 == 0;
+            ++churned;
+            drop(i, now, random_us(50000, 500000));
+            break;
+        }
+    }
+}
+
+void Soak::send_due(uint64_t now)
+{
+    const double interval = 1e6 / opt.rate;
+    while (next_send_us <= now) {
+        next_send_us += std::max<uint64_t>(static_cast<uint64_t>(interval), 1);
+        for (int tries = 0; tries < 8; ++tries) {
+            const size_t i = rng() % sessions.size();
+            if (sessions[i].state != Session::Ready) continue;
+
+            char head[48];
+            int len = std::snprintf(head, sizeof(head), "bench %" PRIu64 " ", now);
+            std::string text(head, static_cast<size_t>(len));
+            if (text.size() < opt.message_size) text.append(padding, 0, opt.message_size - text.size());
+            queue(i, opt.v2 ? protocol::make_frame(protocol::Chat, text) : text + "\n");
+            ++sent;
+            break;
+        }
+    }
+}
+
+void Soak::take_sample(uint64_t now)
+{
+    Row row;
+    row.at_s  = (now - t_start) / 1e6;
+    row.ready = ready;
+    row.p99_us = percentiles(window_us).p99;
+    window_us.clear();
+    if (!scrape_metrics(opt.host, opt.metrics_port, row.server)) {
+        ++scrape_failures;
+        std::fprintf(stderr, "[%7.0fs] no metrics from %s:%u (is [ADMIN] metrics_port set?)\n",
+                     row.at_s, opt.host.c_str(), opt.metrics_port);
+        return;
+    }
+
+    std::printf("[%7.0fs] rss %.1f MB  fds %" PRIu64 "  connections %" PRIu64 "  ready %zu  p99 %u us\n",
+                row.at_s, row.server.rss_mb, row.server.fds, row.server.connections, row.ready, row.p99_us);
+    std::printf("           tables");
+    for (const auto& table : row.server.tables) {
+        std::printf(" %s=%" PRIu64, table.first.c_str(), table.second);
+    }
+    std::printf("\n");
+
+    if (csv) {
+        if (rows.empty()) {
+            std::fprintf(csv, "seconds,rss_mb,fds,connections,ready,p99_us");
+            for (const auto& table : row.server.tables) std::fprintf(csv, ",%s", table.first.c_str());
+            std::fprintf(csv, "\n");
+        }
+        std::fprintf(csv, "%.0f,%.2f,%" PRIu64 ",%" PRIu64 ",%zu,%u", row.at_s, row.server.rss_mb,
+                     row.server.fds, row.server.connections, row.ready, row.p99_us);
+        for (const auto& table : row.server.tables) std::fprintf(csv, ",%" PRIu64, table.second);
+        std::fprintf(csv, "\n");
+        std::fflush(csv);
+    }
+
+    // The last three samples against the first three after the warm-up, as
+    // the verdict will compare them.
+    rows.push_back(row);
+    size_t first = 0;
+    while (first < rows.size() && rows[first].at_s < opt.warmup) ++first;
+    const size_t after = rows.size() - first;
+    if (after >= 2) {
+        const size_t count = std::min<size_t>(3, after / 2);
+        std::string why;
+        for (const Check& check : checks()) {
+            if (drifted(check, window(check, first, count), window(check, rows.size() - count, count), why)) {
+                std::printf("           drifting: %s\n", why.c_str());
+            }
+        }
+    }
+    std::fflush(stdout);
+}
+
+std::vector<Soak::Check> Soak::checks() const
+{
+    std::vector<Check> out;
+    out.push_back({"rss MB", [](const Row& r, const std::string&) { return r.server.rss_mb; }, "", opt.max_rss_mb});
+    out.push_back({"open fds", [](const Row& r, const std::string&) { return double(r.server.fds); }, "",
+                   double(opt.max_fds)});
+    const double table_limit = opt.max_table ? double(opt.max_table)
+                                             : std::max(32.0, double(opt.clients) / 20.0);
+    if (!rows.empty()) {
+        for (const auto& table : rows.front().server.tables) {
+            out.push_back({"table", [](const Row& r, const std::string& name) {
+                               auto it = r.server.tables.find(name);
+                               return it == r.server.tables.end() ? 0.0 : double(it->second);
+                           }, table.first, table_limit});
+        }
+    }
+    out.push_back({"p99 us", [](const Row& r, const std::string&) { return double(r.p99_us); }, "",
+                   opt.max_p99_ratio});
+    return out;
+}
+
+// A check over `count` rows from `from`: the floor of a size (transient
+// peaks like Argon2id's working memory don't count, a leak raises the
+// floor), the median of a p99.
+double Soak::window(const Check& check, size_t from, size_t count) const
+{
+    std::vector<double> values;
+    for (size_t k = from; k < from + count; ++k) values.push_back(check.value(rows[k], check.table));
+    std::sort(values.begin(), values.end());
+    return std::strcmp(check.name, "p99 us") == 0 ? values[values.size() / 2] : values.front();
+}
+
+// Sizes may grow by `limit`; the p99 may reach `limit` times the baseline
+// plus 1 ms (sub-millisecond p99s are noise, not drift).
+bool Soak::drifted(const Check& check, double base, double value, std::string& why) const
+{
+    char text[160];
+    const std::string name = check.table.empty() ? check.name : check.table + " entries";
+    if (std::strcmp(check.name, "p99 us") == 0) {
+        if (value <= base * check.limit + 1000.0) return false;
+        std::snprintf(text, sizeof(text), "%s %.0f -> %.0f (over %.1fx + 1 ms)", name.c_str(), base, value,
+                      check.limit);
+    } else {
+        if (value - base <= check.limit) return false;
+        std::snprintf(text, sizeof(text), "%s %.1f -> %.1f (+%.1f, limit +%.1f)", name.c_str(), base, value,
+                      value - base, check.limit);
+    }
+    why = text;
+    return true;
+}
+
+int Soak::verdict() const
+{
+    std::printf("\nsessions    : %zu of %zu ready at the end, %" PRIu64 " logins, %" PRIu64 " churned (%" PRIu64
+                " mid-login), %" PRIu64 " relogin races, %" PRIu64 " refused, %" PRIu64 " closed by the server\n",
+                ready, sessions.size(), logins, churned, abandoned, relogin_races, refused, server_closes);
+    std::printf("messages    : %" PRIu64 " sent, %" PRIu64 " copies received\n", sent, delivered);
+    if (scrape_failures) std::printf("metrics     : %" PRIu64 " scrapes failed\n", scrape_failures);
+
+    size_t first = 0;
+    while (first < rows.size() && rows[first].at_s < opt.warmup) ++first;
+    const size_t after = rows.size() - first;
+    if (after < 2) {
+        std::printf("verdict     : no verdict, the run ended before two samples after the %.0fs warm-up\n",
+                    opt.warmup);
+        return 1;
+    }
+
+    // Up to three samples at each end, so one unlucky sample mid-churn
+    // doesn't decide.
+    const size_t count = std::min<size_t>(3, after / 2);
+    bool failed = false;
+    for (const Check& check : checks()) {
+        std::string why;
+        if (drifted(check, window(check, first, count), window(check, rows.size() - count, count), why)) {
+            std::printf("DRIFT       : %s\n", why.c_str());
+            failed = true;
+        }
+    }
+    std::printf("verdict     : %s (baseline at %.0fs, %zu samples after it)\n", failed ? "FAIL" : "pass",
+                rows[first].at_s, after);
+    return failed ? 1 : 0;
+}
+
+int Soak::run()
+{
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1) { std::perror("epoll_create1"); return 1; }
+    padding.assign(std::max<size_t>(opt.message_size, 64), 'x');
+    if (!opt.save.empty() && !(csv = std::fopen(opt.save.c_str(), "w"))) {
+        std::fprintf(stderr, "%s: %s\n", opt.save.c_str(), strerror(errno));
+        return 1;
+    }
+
+    std::printf("bench_client --soak: %zu sessions, %.1f reconnects/s, %.0f msg/s for %.1fh (%s) against %s:%u, "
+                "metrics on port %u\n", opt.clients, opt.churn, opt.rate, opt.duration / 3600.0,
+                opt.v2 ? "v2" : "v1", opt.host.c_str(), opt.port, opt.metrics_port);
+    std::printf("sampling every %.0fs, baseline after %.0fs of warm-up\n", opt.sample_interval, opt.warmup);
+    std::fflush(stdout);
+
+    t_start = now_us();
+    t_end   = t_start + static_cast<uint64_t>(opt.duration * 1e6);
+    next_send_us = next_churn_us = next_housekeeping_us = t_start;
+    next_sample_us = t_start + static_cast<uint64_t>(opt.sample_interval * 1e6);
+    std::vector<epoll_event> events(1024);
+
+    while (!interrupted) {
+        uint64_t now = now_us();
+        if (now >= t_end) break;
+        if (now >= next_housekeeping_us) {
+            housekeeping(now);
+            next_housekeeping_us = now + 100000;
+        }
+        churn(now);
+        send_due(now);
+        if (now >= next_sample_us) {
+            take_sample(now);
+            next_sample_us += static_cast<uint64_t>(opt.sample_interval * 1e6);
+        }
+
+        const uint64_t next = std::min({next_send_us, next_churn_us, next_housekeeping_us});
+        const int timeout = next > now ? static_cast<int>(std::min<uint64_t>((next - now) / 1000, 100)) : 0;
+        int n = epoll_wait(ep, events.data(), static_cast<int>(events.size()), timeout);
+        if (n < 0 && errno != EINTR) { std::perror("epoll_wait"); break; }
+
+        now = now_us();
+        for (int k = 0; k < n; ++k) {
+            const size_t i = static_cast<size_t>(events[k].data.u64 & 0xffffffffu);
+            Session& s    = sessions[i];
+            if (s.state == Session::Idle || s.generation != events[k].data.u64 >> 32) continue;
+            if (s.state == Session::Connecting) {
+                if (events[k].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) on_connected(i, now);
+                continue;
+            }
+            if (events[k].events & EPOLLOUT) flush(i, now);
+            if (s.state != Session::Idle && (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                on_readable(i, now);
+            }
+        }
+    }
+
+    const int result = verdict();
+    for (Session& s : sessions) if (s.fd != -1) close(s.fd);
+    close(ep);
+    if (csv) std::fclose(csv);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, on_sigint);
+
+    if (!opt.replay.empty()) {
+        Replay replay(opt);
+        return replay.run();
+    }
+    if (opt.soak) {
+        Soak soak(opt);
+        return soak.run();
+    }
+    Bench bench(opt);
+    return bench.run();
+}
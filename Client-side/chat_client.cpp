@@ -0,0 +1,736 @@
+#include "chat_client.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include "../common/compression.hpp"
+#include "../common/protocol.hpp"
+
+namespace chatclient {
+
+namespace {
+
+constexpr size_t READ_CHUNK = 65536;
+
+uint64_t steady_ms()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+bool starts_with(std::string_view s, std::string_view prefix)
+{
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+// The server's answers to /register, /login and /resume.
+bool is_auth_success(std::string_view text)
+{
+    return starts_with(text, "Registered ") || starts_with(text, "Login successful") ||
+           starts_with(text, "Resumed session");
+}
+
+// "Error: server busy, retry after 5s" (overload control): 5000; 0 when
+// the text carries no hint.
+int parse_retry_after_ms(std::string_view text)
+{
+    const size_t at = text.find("retry after ");
+    if (at == std::string_view::npos) return 0;
+    int seconds = 0;
+    for (size_t i = at + 12; i < text.size() && text[i] >= '0' && text[i] <= '9' && seconds < 3600; ++i) {
+        seconds = seconds * 10 + (text[i] - '0');
+    }
+    return seconds * 1000;
+}
+
+// What the interactive client has always shown for a failed TLS step.
+std::string tls_failure(SSL* tls)
+{
+    const long verify = SSL_get_verify_result(tls);
+    if (verify != X509_V_OK) return X509_verify_cert_error_string(verify);
+    char reason[256] = "connection closed";
+    if (unsigned long code = ERR_get_error()) ERR_error_string_n(code, reason, sizeof(reason));
+    return reason;
+}
+
+} // namespace
+
+// ============================================================================
+// Session
+// ============================================================================
+
+Session::Session(EventLoop& loop, Options _opts, Handlers _handlers, uint64_t _id)
+    : owner(loop), opts(std::move(_opts)), handlers(std::move(_handlers)), id(_id),
+      v1_only(!opts.protocol_v2), token(opts.session_token), inbound(READ_CHUNK)
+{
+}
+
+Session::~Session()
+{
+    drop_connection();
+}
+
+bool Session::send_chat(std::string_view text)
+{
+    return queue(protocol::Chat, text);
+}
+
+bool Session::send_command(std::string_view command)
+{
+    return queue(protocol::Command, command);
+}
+
+void Session::close()
+{
+    if (st == State::Closed) return;
+    drop_connection();
+    st = State::Closed;
+    owner.closed.push_back(id);
+}
+
+// Before the session is ready the protocol isn't known yet: keep the text
+// and encode it in become_ready().
+bool Session::queue(uint8_t type, std::string_view text)
+{
+    if (st == State::Closed) return false;
+    if (st != State::Ready) {
+        queued.emplace_back(type, std::string(text));
+        return true;
+    }
+    encode(type, text);
+    owner.mark_dirty(*this);
+    return true;
+}
+
+void Session::encode(uint8_t type, std::string_view text)
+{
+    if (!v2) {
+        out.append(text.data(), text.size()).push_back('\n');
+        return;
+    }
+    if (text.size() > protocol::MAX_PAYLOAD) text = text.substr(0, protocol::MAX_PAYLOAD);
+    protocol::append_header(out, type, text.size());
+    out.append(text.data(), text.size());
+}
+
+void Session::start_connect()
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host.c_str(), &addr.sin_addr) != 1) {
+        fail("invalid server address " + opts.host, false);
+        return;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        fail(std::string("socket: ") + strerror(errno), true);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    owner.by_fd[fd] = id;
+    set_deadline(owner.now_ms + static_cast<uint64_t>(opts.connect_timeout_ms));
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        connected();
+        return;
+    }
+    if (errno != EINPROGRESS) {
+        fail(std::string("connect: ") + strerror(errno), true);
+        return;
+    }
+    st = State::Connecting;
+    update_interest();
+}
+
+void Session::connected()
+{
+    if (!opts.tls) {
+        begin_session();
+        return;
+    }
+
+    tls = SSL_new(opts.tls);
+    if (!tls || SSL_set_fd(tls, fd) != 1) {
+        fail("TLS session setup failed", false);
+        return;
+    }
+    // The certificate must name what we connected to.
+    X509_VERIFY_PARAM* param = SSL_get0_param(tls);
+    if (!opts.server_name.empty()) {
+        SSL_set_tlsext_host_name(tls, opts.server_name.c_str());
+        X509_VERIFY_PARAM_set1_host(param, opts.server_name.c_str(), 0);
+    } else {
+        X509_VERIFY_PARAM_set1_ip_asc(param, opts.host.c_str());
+    }
+    SSL_set_mode(tls, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    st = State::Handshake;
+    advance_handshake();
+}
+
+void Session::advance_handshake()
+{
+    ERR_clear_error();
+    const int rc = SSL_connect(tls);
+    if (rc == 1) {
+        tls_want_write = false;
+        begin_session();
+        return;
+    }
+    const int err = SSL_get_error(tls, rc);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+        tls_want_write = err == SSL_ERROR_WANT_WRITE;
+        update_interest();
+        return;
+    }
+    // A certificate the server shouldn't have won't change on a retry.
+    const bool verify_failed = SSL_get_verify_result(tls) != X509_V_OK;
+    fail("TLS handshake failed: " + tls_failure(tls), !verify_failed);
+}
+
+// Connected (and encrypted): offer v2, or authenticate right away in v1.
+void Session::begin_session()
+{
+    inbound.clear();
+    out.clear();
+    out_sent = 0;
+    if (!v1_only) {
+        out.assign(protocol::PREAMBLE, protocol::PREAMBLE_SIZE);
+        st = State::Negotiating;
+        set_deadline(owner.now_ms + static_cast<uint64_t>(opts.hello_timeout_ms));
+    } else {
+        v2 = false;
+        send_auth();
+    }
+    flush();
+}
+
+void Session::send_auth()
+{
+    st = State::Authenticating;
+    set_deadline(owner.now_ms + static_cast<uint64_t>(opts.connect_timeout_ms));
+
+    resuming = !token.empty();
+    if (resuming) {
+        encode(protocol::Command, "/resume " + token);
+        return;
+    }
+    if (opts.username.empty() || opts.password.empty()) {
+        fail("no credentials to authenticate with", false);
+        return;
+    }
+
+    const bool reg = opts.register_account && !authed_once && !registered_maybe;
+    reregistering  = reg && register_sent;
+    register_sent |= reg;
+    if (v2) {
+        out += protocol::make_named_frame(reg ? protocol::Register : protocol::Login, opts.username, opts.password);
+    } else {
+        out.append(reg ? "/register " : "/login ").append(opts.username).append("|");
+        out.append(opts.password).push_back('\n');
+    }
+}
+
+void Session::become_ready(std::string_view reply)
+{
+    st          = State::Ready;
+    authed_once = true;
+    backoff_ms  = 0;
+    set_deadline(0);
+    for (const auto& [type, text] : queued) encode(type, text);
+    queued.clear();
+    owner.mark_dirty(*this);
+    if (handlers.on_ready) handlers.on_ready(*this, reply);
+}
+
+void Session::on_event(uint32_t events)
+{
+    if (st == State::Connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            fail(std::string("connect: ") + strerror(err), true);
+            return;
+        }
+        if (events & EPOLLOUT) connected();
+        return;
+    }
+    if (st == State::Handshake) {
+        advance_handshake();
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) read_input();
+    if (st != State::Closed && st != State::Backoff && (events & EPOLLOUT)) flush();
+}
+
+void Session::on_timer()
+{
+    switch (st) {
+    case State::Backoff:
+        start_connect();
+        break;
+    case State::Negotiating:
+        // Silence after the preamble: a v1-only server. It may have taken
+        // the preamble as part of a line, so start over on a new connection.
+        v1_only = true;
+        drop_connection();
+        start_connect();
+        break;
+    case State::Connecting:
+    case State::Handshake:
+    case State::Authenticating:
+        fail("timed out", true);
+        break;
+    default:
+        break;
+    }
+}
+
+void Session::read_input()
+{
+    bool closed = false;
+    while (true) {
+        char* dst = inbound.write_ptr(READ_CHUNK);
+        ssize_t n;
+        if (tls) {
+            size_t got = 0;
+            ERR_clear_error();
+            if (SSL_read_ex(tls, dst, READ_CHUNK, &got) == 1) {
+                n = static_cast<ssize_t>(got);
+            } else {
+                const int err = SSL_get_error(tls, 0);
+                if (err == SSL_ERROR_WANT_READ) break;
+                if (err == SSL_ERROR_WANT_WRITE) {
+                    tls_want_write = true;
+                    break;
+                }
+                n = err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+            }
+        } else {
+            n = recv(fd, dst, READ_CHUNK, 0);
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        }
+        if (n <= 0) {
+            closed = true;
+            break;
+        }
+        inbound.commit(static_cast<size_t>(n));
+        if (static_cast<size_t>(n) < READ_CHUNK && !tls) break; // Drained
+    }
+
+    // Frame everything that arrived before acting on the close: the last
+    // reply often comes with it.
+    if (v2 || st == State::Negotiating) {
+        protocol::FrameHeader header;
+        std::string_view frame;
+        while (st != State::Closed && st != State::Backoff && protocol::decode_header(inbound.view(), header) &&
+               inbound.take(protocol::HEADER_SIZE + header.length, frame)) {
+            handle_frame(header.type, frame.substr(protocol::HEADER_SIZE));
+        }
+    } else {
+        std::string_view record;
+        while (st != State::Closed && st != State::Backoff && inbound.next_line(record)) {
+            std::string_view line = record.substr(0, record.size() - 1);
+            Message msg;
+            msg.kind = Message::Line;
+            msg.text = line;
+            handle_notice(line, msg);
+        }
+    }
+
+    if (closed && st != State::Closed && st != State::Backoff) {
+        fail(st == State::Ready ? "connection closed by the server" : "connection closed during login", true);
+        return;
+    }
+    if (st != State::Closed && st != State::Backoff) update_interest();
+}
+
+void Session::handle_frame(uint8_t type, std::string_view payload)
+{
+    if (st == State::Negotiating) {
+        if (type != protocol::Hello || payload.empty() ||
+            payload[0] != static_cast<char>(protocol::Version::V2)) {
+            v1_only = true; // Not a v2 server after all
+            drop_connection();
+            start_connect();
+            return;
+        }
+        v2 = true;
+        // Hello's second byte: what the server offers
+        if (opts.compression && payload.size() > 1 && (static_cast<uint8_t>(payload[1]) & protocol::CAP_DEFLATE)) {
+            const char wanted = static_cast<char>(protocol::CAP_DEFLATE);
+            out += protocol::make_frame(protocol::Capabilities, std::string_view(&wanted, 1));
+            deflate = true;
+        }
+        send_auth();
+        flush();
+        return;
+    }
+
+    Message msg;
+    switch (type) {
+    case protocol::Chat:
+        if (!protocol::split_named(payload, msg.name, msg.text)) return;
+        msg.kind = Message::Chat;
+        break;
+    case protocol::ChannelChat:
+        if (!protocol::split_named(payload, msg.channel, msg.name) ||
+            !protocol::split_named(msg.name, msg.name, msg.text)) {
+            return;
+        }
+        msg.kind = Message::Channel;
+        break;
+    case protocol::Private:
+        if (!protocol::split_named(payload, msg.name, msg.text)) return;
+        msg.kind = Message::Private;
+        break;
+    case protocol::Notice:
+        msg.kind = Message::Notice;
+        msg.text = payload;
+        handle_notice(payload, msg);
+        return;
+    case protocol::Compressed:
+        if (deflate) handle_compressed(payload);
+        return;
+    default:
+        return; // Hello again or a type this library doesn't know
+    }
+    if (st == State::Ready && handlers.on_message) handlers.on_message(*this, msg);
+}
+
+// The frames packed in one Compressed frame, dispatched in order. A frame
+// that doesn't inflate, or doesn't hold whole frames, ends the connection:
+// what follows can't be trusted to line up either.
+void Session::handle_compressed(std::string_view payload)
+{
+    inflated.clear();
+    if (!compression::inflate(payload, inflated, protocol::MAX_INFLATED)) {
+        fail("corrupt compressed frame", true);
+        return;
+    }
+
+    std::string_view rest(inflated); // Never nested: stays put while dispatching
+    protocol::FrameHeader header;
+    while (st != State::Closed && st != State::Backoff && !rest.empty()) {
+        if (!protocol::decode_header(rest, header) || rest.size() < protocol::HEADER_SIZE + header.length ||
+            header.type == protocol::Compressed) {
+            fail("corrupt compressed frame", true);
+            return;
+        }
+        handle_frame(header.type, rest.substr(protocol::HEADER_SIZE, header.length));
+        rest.remove_prefix(protocol::HEADER_SIZE + header.length);
+    }
+}
+
+// Status lines drive the login; once ready they are ordinary messages
+// (v1 delivers everything as lines, so chat passes through here too).
+void Session::handle_notice(std::string_view text, const Message& msg)
+{
+    const std::string_view session = protocol::SESSION_NOTICE;
+    if (starts_with(text, session)) {
+        token.assign(text.substr(session.size()));
+        return;
+    }
+    if (st == State::Ready) {
+        if (handlers.on_message) handlers.on_message(*this, msg);
+        return;
+    }
+    if (st != State::Authenticating) return;
+
+    if (is_auth_success(text)) {
+        become_ready(text);
+        return;
+    }
+    // Refused before the credentials were even looked at: try again later
+    // (a resume keeps its token for that).
+    if (starts_with(text, "Error: server busy") || starts_with(text, "Error: server is draining") ||
+        starts_with(text, "[ERROR]: Connection limit")) {
+        fail(text, true);
+        return;
+    }
+    if (resuming) {
+        // Expired token (or the server restarted with a new key): the password.
+        token.clear();
+        send_auth();
+        flush();
+        return;
+    }
+    if (reregistering && starts_with(text, "Error: username already taken")) {
+        // The earlier /register went through but its reply was lost
+        registered_maybe = true;
+        send_auth();
+        flush();
+        return;
+    }
+    // The server hasn't noticed yet that our previous connection is gone.
+    const bool own_ghost = (authed_once || register_sent) && starts_with(text, "Error: user already logged in");
+    if (own_ghost) {
+        fail(text, true);
+        return;
+    }
+    // The credentials themselves were refused.
+    const std::string reason(text);
+    drop_connection();
+    st = State::Closed;
+    owner.closed.push_back(id);
+    if (handlers.on_auth_failed) handlers.on_auth_failed(*this, reason);
+}
+
+void Session::flush()
+{
+    while (out_sent < out.size()) {
+        ssize_t n;
+        if (tls) {
+            size_t written = 0;
+            ERR_clear_error();
+            if (SSL_write_ex(tls, out.data() + out_sent, out.size() - out_sent, &written) == 1) {
+                n = static_cast<ssize_t>(written);
+            } else {
+                const int err = SSL_get_error(tls, 0);
+                if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
+                    tls_want_write = err == SSL_ERROR_WANT_WRITE;
+                    break;
+                }
+                fail("send failed", true);
+                return;
+            }
+        } else {
+            n = send(fd, out.data() + out_sent, out.size() - out_sent, MSG_NOSIGNAL);
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n == -1) {
+                fail(std::string("send: ") + strerror(errno), true);
+                return;
+            }
+        }
+        out_sent += static_cast<size_t>(n);
+    }
+    if (out_sent == out.size()) {
+        out.clear();
+        out_sent = 0;
+    }
+    update_interest();
+}
+
+void Session::fail(std::string_view reason, bool retry)
+{
+    const std::string why(reason); // May point into the buffers dropped below
+    drop_connection();
+
+    if (retry && opts.reconnect) {
+        st = State::Backoff;
+        backoff_ms = backoff_ms ? std::min(backoff_ms * 2, opts.backoff_max_ms) : opts.backoff_min_ms;
+        // ±25% so sessions dropped together don't all come back together
+        static std::minstd_rand jitter(static_cast<unsigned>(steady_ms()));
+        const int spread = std::max(1, backoff_ms / 2);
+        int delay        = backoff_ms - backoff_ms / 4 + static_cast<int>(jitter() % static_cast<unsigned>(spread));
+        // An overloaded server says when to come back: not before, and
+        // spread over the next quarter of that so its clients don't return
+        // in one wave.
+        const int retry_after_ms = parse_retry_after_ms(why);
+        if (retry_after_ms > delay) {
+            delay = retry_after_ms + static_cast<int>(jitter() % static_cast<unsigned>(std::max(1, retry_after_ms / 4)));
+        }
+        set_deadline(owner.now_ms + static_cast<uint64_t>(delay));
+    } else {
+        st = State::Closed;
+        owner.closed.push_back(id);
+    }
+    if (handlers.on_disconnect) handlers.on_disconnect(*this, why);
+}
+
+void Session::drop_connection()
+{
+    if (tls) {
+        SSL_free(tls);
+        tls = nullptr;
+    }
+    if (fd != -1) {
+        owner.by_fd.erase(fd);
+        ::close(fd); // Also removes it from epoll
+        fd = -1;
+    }
+    armed          = 0;
+    tls_want_write = false;
+    v2             = false;
+    deflate        = false;
+    inbound.clear();
+    out.clear();
+    out_sent = 0;
+    set_deadline(0);
+}
+
+void Session::set_deadline(uint64_t at_ms)
+{
+    deadline_ms = at_ms;
+    if (at_ms) owner.schedule(*this);
+}
+
+void Session::update_interest()
+{
+    if (fd == -1) return;
+    uint32_t events = EPOLLIN;
+    if (st == State::Connecting || tls_want_write || out_sent < out.size()) events |= EPOLLOUT;
+    if (events == armed) return;
+    owner.arm(fd, events, armed == 0);
+    armed = events;
+}
+
+// ============================================================================
+// EventLoop
+// ============================================================================
+
+EventLoop::EventLoop()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) throw std::runtime_error(std::string("epoll_create1: ") + strerror(errno));
+    now_ms = steady_ms();
+}
+
+EventLoop::~EventLoop()
+{
+    by_id.clear(); // Sessions close their sockets first
+    ::close(epoll_fd);
+}
+
+Session& EventLoop::open(Options opts, Handlers handlers)
+{
+    const uint64_t sid = next_id++;
+    std::unique_ptr<Session> s(new Session(*this, std::move(opts), std::move(handlers), sid));
+    Session& ref = *s;
+    by_id.emplace(sid, std::move(s));
+    ref.set_deadline(now_ms); // Connects on the next iteration
+    return ref;
+}
+
+void EventLoop::watch(int fd, std::function<void()> on_readable)
+{
+    const bool add = watched.find(fd) == watched.end();
+    watched[fd] = std::move(on_readable);
+    if (add) arm(fd, EPOLLIN, true);
+}
+
+void EventLoop::unwatch(int fd)
+{
+    if (watched.erase(fd)) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void EventLoop::arm(int fd, uint32_t events, bool add)
+{
+    epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+}
+
+// Entries are never removed: a popped one whose session is gone or has
+// another deadline by now is simply skipped.
+void EventLoop::schedule(Session& s)
+{
+    timers.emplace_back(s.deadline_ms, s.id);
+    std::push_heap(timers.begin(), timers.end(), std::greater<>());
+}
+
+void EventLoop::mark_dirty(Session& s)
+{
+    dirty.push_back(s.id);
+}
+
+void EventLoop::run_once(int timeout_ms)
+{
+    now_ms = steady_ms();
+    if (!timers.empty()) {
+        const uint64_t first = timers.front().first;
+        const int until = first <= now_ms ? 0 : static_cast<int>(std::min<uint64_t>(first - now_ms, 60000));
+        if (timeout_ms < 0 || until < timeout_ms) timeout_ms = until;
+    }
+    if (!dirty.empty()) timeout_ms = 0;
+
+    epoll_event events[256];
+    const int n = epoll_wait(epoll_fd, events, 256, timeout_ms);
+    now_ms = steady_ms();
+
+    for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        auto app = watched.find(fd);
+        if (app != watched.end()) {
+            std::function<void()> fn = app->second; // May unwatch itself
+            fn();
+            continue;
+        }
+        auto owner_it = by_fd.find(fd);
+        if (owner_it == by_fd.end()) continue; // Closed earlier in this batch
+        by_id[owner_it->second]->on_event(events[i].events);
+    }
+
+    while (!timers.empty() && timers.front().first <= now_ms) {
+        const auto [when, sid] = timers.front();
+        std::pop_heap(timers.begin(), timers.end(), std::greater<>());
+        timers.pop_back();
+        auto it = by_id.find(sid);
+        if (it == by_id.end() || it->second->deadline_ms != when) continue;
+        it->second->deadline_ms = 0;
+        it->second->on_timer();
+    }
+
+    // Pipelined output: one write per session per iteration.
+    std::vector<uint64_t> flushing;
+    flushing.swap(dirty);
+    for (uint64_t sid : flushing) {
+        auto it = by_id.find(sid);
+        if (it != by_id.end() && it->second->st == Session::State::Ready) it->second->flush();
+    }
+
+    reap();
+}
+
+void EventLoop::reap()
+{
+    std::vector<uint64_t> gone;
+    gone.swap(closed);
+    for (uint64_t sid : gone) by_id.erase(sid);
+}
+
+void EventLoop::run()
+{
+    running = true;
+    while (running && !by_id.empty()) run_once(-1);
+}
+
+SSL_CTX* EventLoop::make_tls_context(const std::string& ca_file)
+{
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx) throw std::runtime_error("TLS initialisation failed");
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS); // Kernel records when available
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+
+    const int loaded = ca_file.empty() ? SSL_CTX_set_default_verify_paths(ctx)
+                                       : SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), nullptr);
+    if (loaded != 1) {
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("Cannot load CA certificates" + (ca_file.empty() ? "" : " from " + ca_file));
+    }
+    return ctx;
+}
+
+} // namespace chatclient
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <openssl/ssl.h>
+#include "../common/read_buffer.hpp"
+
+// ============================================================================
+// libchatclient — non-interactive chat sessions driven by one event loop.
+//
+// An EventLoop (epoll, one thread) runs any number of Sessions. A session
+// connects, does the TLS handshake if asked to, negotiates protocol v2 (or
+// falls back to v1), authenticates and then reports what the server sends
+// through its Handlers. Everything is non-blocking and nothing prompts,
+// prints or exits: bots and bridges keep thousands of sessions in one
+// process, and the interactive `client` is a thin layer on top.
+//
+//   chatclient::EventLoop loop;
+//   chatclient::Options o;
+//   o.username = "bot"; o.password = "secret12";
+//   chatclient::Handlers h;
+//   h.on_message = [](chatclient::Session& s, const chatclient::Message& m) {
+//       if (m.text == "ping") s.send_chat("pong");
+//   };
+//   loop.open(o, h);
+//   loop.run();
+//
+// Sends are pipelined: send_chat()/send_command() only append to the
+// session's output, which goes out in one write per loop iteration (and
+// waits for authentication if the session isn't ready yet). A session that
+// loses its connection reconnects with exponential backoff and resumes
+// with its session token (falling back to the password), then flushes what
+// was queued meanwhile. Output already handed to a dead socket is lost.
+//
+// Not thread-safe: use a loop and its sessions from the thread in run().
+// ============================================================================
+namespace chatclient {
+
+class EventLoop;
+
+struct Options {
+    std::string host{"127.0.0.1"};  // Numeric IPv4 address of the server
+    uint16_t port{25565};
+    std::string username;
+    std::string password;           // Kept for re-authentication after a reconnect
+    bool register_account{false};   // First auth is /register instead of /login
+    std::string session_token;      // Tried (/resume) before the password
+    bool protocol_v2{true};         // Offer v2; false speaks v1 lines only
+    bool compression{true};         // v2: accept Compressed frames if the server offers them
+    int hello_timeout_ms{2000};     // No v2 Hello by then: reconnect speaking v1
+    int connect_timeout_ms{10000};  // Connect + TLS + negotiation + auth
+    bool reconnect{true};           // After a dropped connection (not after refused credentials)
+    int backoff_min_ms{500};        // First retry delay; doubles up to backoff_max_ms
+    int backoff_max_ms{30000};
+    SSL_CTX* tls{nullptr};          // Non-owning (see make_tls_context()); null = plaintext
+    std::string server_name;        // Certificate name to check (empty: `host` as an IP)
+};
+
+// One message from the server. The views are valid during the callback.
+struct Message {
+    enum Kind {
+        Chat,     // `name` said `text` in the main channel
+        Channel,  // ... in `channel`
+        Private,  // /msg from `name`
+        Notice,   // Server status or error line in `text`
+        Line      // v1: the raw line in `text` (without the newline)
+    };
+    Kind kind{Line};
+    std::string_view channel;
+    std::string_view name;
+    std::string_view text;
+};
+
+class Session;
+
+struct Handlers {
+    // Authenticated (again, after a reconnect): `reply` is the server's
+    // confirmation ("Login successful for ...", "Resumed session for ...").
+    std::function<void(Session&, std::string_view reply)> on_ready;
+    std::function<void(Session&, const Message&)> on_message;
+    // The server refused the credentials; the session is closed.
+    std::function<void(Session&, std::string_view reason)> on_auth_failed;
+    // The connection failed or dropped; a reconnect follows if enabled.
+    std::function<void(Session&, std::string_view reason)> on_disconnect;
+};
+
+class Session {
+public:
+    enum class State { Backoff, Connecting, Handshake, Negotiating, Authenticating, Ready, Closed };
+
+    // Queue one chat message / slash command ("/join #x") for the server.
+    // False once the session is closed.
+    bool send_chat(std::string_view text);
+    bool send_command(std::string_view command);
+
+    // Closes the connection for good; the loop drops the session after the
+    // current callback returns.
+    void close();
+
+    State state() const { return st; }
+    bool ready() const { return st == State::Ready; }
+    bool protocol_v2() const { return v2; }
+    bool compressed() const { return deflate; }
+    const Options& options() const { return opts; }
+    const std::string& session_token() const { return token; }
+    EventLoop& loop() { return owner; }
+
+    void* user_data{nullptr}; // For the application
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    ~Session();
+
+private:
+    friend class EventLoop;
+    Session(EventLoop& loop, Options opts, Handlers handlers, uint64_t id);
+
+    // Connection steps, in order.
+    void start_connect();
+    void on_event(uint32_t events);
+    void on_timer();
+    void connected();
+    void advance_handshake();
+    void begin_session();
+    void send_auth();
+    void become_ready(std::string_view reply);
+
+    // Input: reads everything available, then frames and dispatches it.
+    void read_input();
+    void handle_frame(uint8_t type, std::string_view payload);
+    void handle_compressed(std::string_view payload);
+    void handle_notice(std::string_view text, const Message& msg);
+
+    // Output.
+    bool queue(uint8_t type, std::string_view text);
+    void encode(uint8_t type, std::string_view text);
+    void flush();
+
+    void fail(std::string_view reason, bool retry);
+    void drop_connection();
+    void set_deadline(uint64_t at_ms);
+    void update_interest();
+
+    EventLoop& owner;
+    Options opts;
+    Handlers handlers;
+    uint64_t id;
+
+    State st{State::Backoff};
+    int fd{-1};
+    SSL* tls{nullptr};
+    bool v2{false};                 // This connection speaks v2
+    bool deflate{false};            // ... and asked for Compressed frames
+    bool v1_only{false};            // The server ignored the preamble: v1 from now on
+    bool resuming{false};           // The /resume in flight, not the password
+    bool authed_once{false};        // Register only the first time
+    bool register_sent{false};      // A /register went out (its reply may have been lost)
+    bool reregistering{false};      // This connection repeats it
+    bool registered_maybe{false};   // The repeat found the name taken: log in instead
+    bool tls_want_write{false};     // The TLS layer needs to write before it can go on
+    uint32_t armed{0};              // Events registered with epoll
+    int backoff_ms{0};
+    uint64_t deadline_ms{0};        // Timer of the current state (0 = none)
+    std::string token;
+    ReadBuffer inbound;
+    std::string out;                // Bytes for the socket (preamble, auth, queued sends)
+    std::string inflated;           // Frames unpacked from one Compressed frame
+    size_t out_sent{0};
+    std::vector<std::pair<uint8_t, std::string>> queued; // Sends made before ready: (frame type, text)
+};
+
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Starts a session (it connects from the next iteration). The reference
+    // stays valid until the session is closed and its callback returned.
+    Session& open(Options opts, Handlers handlers);
+
+    // Calls `on_readable` whenever `fd` (not owned) is readable, e.g. stdin.
+    void watch(int fd, std::function<void()> on_readable);
+    void unwatch(int fd);
+
+    // One iteration: waits up to `timeout_ms` (-1: until something happens),
+    // dispatches, flushes every session's output.
+    void run_once(int timeout_ms);
+
+    // Iterates until stop() or until no session is left.
+    void run();
+    void stop() { running = false; }
+
+    size_t sessions() const { return by_id.size(); }
+
+    // A TLS 1.3 client context verifying the server against `ca_file`
+    // (empty: the system trust store). Throws std::runtime_error. Free with
+    // SSL_CTX_free() once no session uses it.
+    static SSL_CTX* make_tls_context(const std::string& ca_file);
+
+private:
+    friend class Session;
+
+    void arm(int fd, uint32_t events, bool add);
+    void schedule(Session& s);
+    void mark_dirty(Session& s);
+    void reap();
+
+    int epoll_fd{-1};
+    bool running{false};
+    uint64_t now_ms{0};                                      // Steady clock, per iteration
+    uint64_t next_id{1};
+
+    std::unordered_map<uint64_t, std::unique_ptr<Session>> by_id;
+    std::unordered_map<int, uint64_t> by_fd;                 // Socket → session id
+    std::unordered_map<int, std::function<void()>> watched;  // Application fds
+    std::vector<std::pair<uint64_t, uint64_t>> timers;       // Min-heap of (deadline, session id)
+    std::vector<uint64_t> dirty;                             // Sessions with output to flush
+    std::vector<uint64_t> closed;                            // Sessions to drop after dispatch
+};
+
+} // namespace chatclient
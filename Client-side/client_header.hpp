@@ -1,23 +1,14 @@
 #pragma once
 
 #include <iostream>
-#include <netinet/in.h>  // sockaddr_in
-#include <sys/socket.h>  // socket, connect, send, recv
-#include <unistd.h>      // close
-#include <arpa/inet.h>   // inet_addr, htons
-#include <cstring>       // memset, strerror, strlen
+#include <cstring>       // strlen
 #include <string>
 #include <algorithm>
 #include <limits>        // std::numeric_limits (used in getInt and clearInput)
 #include <stdexcept>     // std::runtime_error
+#include <openssl/ssl.h> // TLS 1.3 to the server (--tls)
 #include "../common/input.hpp"
-
-#define BUFFER_SIZE 1024
-
-// Protocol-level error codes returned by the server
-enum class Errortype {
-    Error_101  // Duplicate username
-};
+#include "chat_client.hpp" // Connection, protocol and reconnects (libchatclient)
 
 // Controls which authentication flow to use when connecting
 enum class AuthMode {
@@ -32,13 +23,19 @@ struct UserCredentials {
     bool valid{false};  // true only if validate_credentials() passed
 };
 
+// The interactive front end: prompts, then one libchatclient session whose
+// messages are rendered on the terminal.
 class TcpClient {
 private:
-    int client_fd{-1};           // Socket file descriptor (-1 = not created/closed)
-    std::string client_ip;       // Local IP the client is bound from (informational)
     int port{};                  // Target server port
-    std::string server_ip{};     // Target server IP (stored for error messages)
-    sockaddr_in address_of_server{}; // Resolved server address struct for connect()
+    std::string server_ip{};     // Target server IP (numeric IPv4)
+
+    SSL_CTX* tls_ctx{nullptr};   // Set by enable_tls(); null = plaintext
+    std::string tls_server_name; // Name checked in the certificate (empty: the server IP)
+
+    chatclient::EventLoop loop;  // Drives the session and stdin
+    chatclient::Session* session{nullptr}; // Set by start()
+    bool ready_once{false};      // Authenticated at least once (later: reconnects)
 
     // Flushes cin state after invalid input to avoid infinite error loops
     void clearInput() {
@@ -48,24 +45,31 @@ private:
 
 public:
     std::string username{};      // Authenticated username (set after successful auth)
-    char buffer[BUFFER_SIZE]{};  // Reusable recv buffer
+
+    // Speaks TLS 1.3 to the server from the next connect on. The server
+    // certificate must chain to `ca_file` (empty: the system trust store)
+    // and match `server_name` (empty: the IP address connected to).
+    // Throws std::runtime_error if the CA certificates can't be loaded.
+    void enable_tls(const std::string& ca_file, const std::string& server_name);
+
+    // Opens the session: connects, negotiates the protocol and authenticates
+    // with `creds` (reconnecting with backoff until the server answers).
+    void start(const UserCredentials& creds, AuthMode mode);
+
+    // Runs the chat until /exit or refused credentials (both exit).
+    void run();
 
     /*
     - This function do the verifications on the commands send by the client in other words everything with "/" at the buffer
     - If the command is not recognized it will send an error message to the client and ignore the command
-    - If the command is recognized it will execute the corresponding action (for now we only have the /username command to set the username of the client)
+    - If the command is recognized it will execute the corresponding action (local ones like /clear and /exit, or channel commands forwarded to the server: /join, /part, /channels, /history, /msg, /who)
     @param command the command send by the client
-    @param sockfd the socket file descriptor
     */
-    void verify_command(std::string *input_buffer, int sockfd);
+    void verify_command(std::string *input_buffer);
 
     // Prompts for username and password; validates and returns a UserCredentials struct
     UserCredentials get_user_credentials(AuthMode mode);
 
-    // Formats credentials into the wire protocol string:
-    // "/register username|password\n" or "/login username|password\n"
-    std::string format_auth_message(const UserCredentials& creds, AuthMode mode);
-
     // In-place trim of leading/trailing whitespace from a string
     void trim(std::string& str);
 
@@ -74,10 +78,7 @@ public:
                               const std::string& password,
                               AuthMode mode);
 
-    // Legacy handler: re-prompts for username when server returns a duplicate error
-    void register_user(int server_socket, Errortype type);
-
-    // Legacy interactive username+password prompt (used by register_user)
+    // Legacy interactive username+password prompt
     std::string register_username();
 
     // Safe integer input with optional min/max bounds
@@ -85,23 +86,13 @@ public:
                int min = std::numeric_limits<int>::min(),
                int max = std::numeric_limits<int>::max());
 
-    // Constructor: creates the TCP socket; throws on failure
-    TcpClient(int _port, const char* client_ip = "127.0.0.1");
-
-    // Translates errno codes from connect() into human-readable error messages
-    int verify_error_connection(int error_code);
-
-    // Connects to the server and runs the full register/login handshake.
-    // Returns 0 on success, -1 on failure.
-    int connect_and_authenticate(const char* server_ipv4_address = "127.0.0.1");
+    TcpClient(int _port, const std::string& _server_ip);
 
-    const char* getClientIp() const { return client_ip.c_str(); }
-    int getClientFd()         const { return client_fd; }
+    const char* getServerIp() const { return server_ip.c_str(); }
     int getPort()             const { return port; }
 
-    // Closes the socket if still open
+    // Sessions hold their own reference to the TLS context
     ~TcpClient() {
-        if (client_fd >= 0)
-            close(client_fd);
+        if (tls_ctx) SSL_CTX_free(tls_ctx);
     }
 };
@@ -1,41 +1,206 @@
 #include <csignal>       // std::signal
 #include <cstdlib>       // EXIT_FAILURE
 #include <iostream>      // std::cout, std::cerr
-#include <ifaddrs.h>     // getifaddrs(), freeifaddrs()
-#include <arpa/inet.h>   // inet_ntop()
 #include <cstring>       // memset(), strerror()
+#include <fcntl.h>       // pipe2(), fcntl() — upgrade self-pipe, listener dup
+#include <sodium.h>      // sodium_init() — before the Argon2id benchmark
+#include <sys/sysinfo.h> // sysinfo() — RAM the Argon2id cost must fit in
+#include <unistd.h>      // read(), write(), getpid()
+#include <algorithm>     // std::max
+#include <map>           // inherited listeners by address
 #include <atomic>        // std::atomic
 #include <memory>        // std::unique_ptr
+#include <mutex>         // std::mutex — one hot upgrade at a time
+#include <thread>        // std::thread — one per extra reactor
+#include <vector>        // reactor instances / worker threads
 #include "common/Logger/logger.hpp"
 #include "server-header.hpp"
+#include "admin_server.hpp"
+#include "live_config.hpp"
+#include "handoff.hpp"
+#include "cpu_affinity.hpp"
+#include "password_hash.hpp"
+
+// The one configuration file; re-read on SIGHUP.
+constexpr const char* CONFIG_FILE = "/etc/tcpserver/Config_file.ini";
+
+// Hot upgrade: how long the successor may take to load its config (the
+// reactors keep serving meanwhile), then to adopt the clients (they are
+// paused meanwhile, not disconnected).
+constexpr int UPGRADE_READY_TIMEOUT_MS   = 30000;
+constexpr int UPGRADE_ADOPTED_TIMEOUT_MS = 60000;
 
 // Global atomic pointer so the signal handler can safely reach the server
 // instance without relying on globals with non-trivial construction/destruction
 // order, or on locking (which isn't signal-safe).
 std::atomic<TcpServer*> g_server_instance{nullptr};
 
+// Same idea for multi-reactor mode ([NETWORK] worker_threads > 1): the group
+// fans the stop request out to every reactor's atomic flag.
+std::atomic<ReactorGroup*> g_reactor_group{nullptr};
+
+// Reached by the SIGHUP handler; the reload itself runs on reactor 0.
+std::atomic<LiveConfig*> g_live_config{nullptr};
+
+// Set by SIGTERM/SIGINT: a hot upgrade that fails afterwards must not
+// resume the loops.
+std::atomic<bool> g_stop_requested{false};
+
+// SIGUSR2 self-pipe: the handler writes one byte, UpgradeWatcher reads it.
+int g_upgrade_pipe[2] = {-1, -1};
+
 // Async-signal-safe handler: ONLY publishes the intent to stop.
 // No maps, no close(), no logging — just an atomic store inside requestShutdown().
 // Anything more (I/O, allocation, mutexes) would be undefined behavior inside
 // a signal handler.
 void handle_shutdown_signal(int signum) {
     if (signum == SIGTERM || signum == SIGINT) {
+        g_stop_requested.store(true);
         TcpServer* server = g_server_instance.load();
         if (server) {
             server->requestShutdown(); // only does SERVER_IS_RUNNING.store(false)
         }
+        ReactorGroup* group = g_reactor_group.load();
+        if (group) {
+            group->requestShutdown(); // same atomic store, once per reactor
+        }
+    }
+}
+
+// Async-signal-safe as well: only flags the reload (`systemctl reload`).
+void handle_reload_signal(int) {
+    LiveConfig* live = g_live_config.load();
+    if (live) {
+        live->requestReload();
+    }
+}
+
+// SIGUSR2 (hot upgrade): write() is async-signal-safe; everything else
+// happens on the UpgradeWatcher thread.
+void handle_upgrade_signal(int) {
+    if (g_upgrade_pipe[1] >= 0) {
+        const char cmd = 'U';
+        ssize_t ignored = write(g_upgrade_pipe[1], &cmd, 1);
+        (void)ignored;
     }
 }
 
+// Everything main() sets up for the reactors.
+struct ServerContext {
+    const ServerConfig& config;
+    Logger& logger;
+    CryptoPool& crypto;
+    CredentialStore& credentials;
+    const SessionTokens& sessions;
+    LiveConfig& live;
+    const TlsContext* tls;                     // [TLS] enabled, or null: plaintext listener
+    ChatLog* chat_log;                         // [HISTORY] log_dir, or null: no /history
+    TrafficCapture* capture;                   // [ADMIN] capture_file (idle while empty)
+    Cluster* cluster;                          // [CLUSTER] node_id, or null: stand-alone
+    std::vector<ListenEndpoint> endpoints;     // [NETWORK] listen_address
+    std::vector<int> listeners;                // Inherited; empty = bind the endpoints
+    std::vector<handoff::ClientState> adopted; // Received from the predecessor
+    int upgrade_fd{-1};                        // Socketpair to the predecessor, or -1
+    std::vector<int> reactor_cpus{};           // [PROCESS] reactor_cpus; empty = unpinned
+};
+
+// ---------------------------------------------------------------------------
+// UpgradeWatcher: SIGUSR2 → hot upgrade (see handoff.hpp). The thread does
+// the slow part — start the successor, wait until it has loaded its config
+// — while the reactors keep serving, then pauses them. Once run() has
+// returned, the loop thread calls complete() to hand the clients over.
+// ---------------------------------------------------------------------------
+class UpgradeWatcher {
+public:
+    UpgradeWatcher(ServerContext& _ctx, std::vector<TcpServer*> _servers)
+        : ctx(_ctx), servers(std::move(_servers)), thread([this] { loop(); })
+    {
+    }
+
+    ~UpgradeWatcher()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        const char cmd = 'Q';
+        ssize_t ignored = write(g_upgrade_pipe[1], &cmd, 1);
+        (void)ignored;
+        thread.join();
+    }
+
+    // True: the successor owns every client now and this process should
+    // exit. False: the handoff failed and the loops may resume.
+    bool complete(std::unique_ptr<AdminServer>& admin);
+
+private:
+    void loop();
+
+    ServerContext& ctx;
+    std::vector<TcpServer*> servers;
+    handoff::Successor successor;
+    std::mutex lock;  // Guards successor and stopping
+    bool stopping{false};
+    std::thread thread;
+};
+
+// Forward declaration — defined below main.
+// The listening sockets of each of `count` reactors: the inherited ones
+// matched to the endpoints by address, or bound here. Throws on a bind
+// failure, before any reactor exists.
+std::vector<std::vector<int>> open_listeners(ServerContext& ctx, size_t count);
+
+// Forward declaration — defined below main.
+// "10.0.0.5:25565, [::]:25565": every address `servers` listen on, for logs.
+std::string listening_on(const std::vector<TcpServer*>& servers);
+
+// Forward declaration — defined below main.
+// Starts the loopback metrics endpoint ([ADMIN] metrics_port) over
+// `servers`; returns null when disabled or when the port can't be bound.
+std::unique_ptr<AdminServer> start_admin_server(const ServerConfig& config, Logger& logger,
+                                                const std::vector<const TcpServer*>& servers);
+
+// Forward declaration — defined below main.
+// Opens the operator socket ([ADMIN] admin_socket) and attaches `servers`
+// to it; returns null when disabled or when it can't be bound.
+std::unique_ptr<AdminChannel> start_admin_channel(const ServerConfig& config, Logger& logger,
+                                                  const std::vector<TcpServer*>& servers);
+
+// Forward declaration — defined below main.
+// Parses the [PROCESS] CPU list `key` = `text` into `cpus`; logs and
+// returns false when it is malformed or names CPUs this process can't use.
+bool load_cpu_list(const char* key, const std::string& text, Logger& logger, std::vector<int>& cpus);
+
+// Forward declaration — defined below main.
+// Sets the Argon2id cost of new hashes from [PROCESS] argon2_*: measured
+// on this host unless fixed by the config. Runs before the crypto workers.
+void configure_password_cost(const ServerConfig& config, Logger& logger);
+
+// Forward declaration — defined below main.
+// Builds a reactor around its `listeners` (see open_listeners()) and
+// applies the config.
+std::unique_ptr<TcpServer> make_server(ServerContext& ctx, std::vector<int> listeners);
+
+// Forward declaration — defined below main.
+// Successor only: registers the received clients round-robin on `servers`,
+// then tells the predecessor and systemd that this process took over.
+void adopt_clients(ServerContext& ctx, const std::vector<TcpServer*>& servers);
+
 // Forward declaration — defined below main.
-// Checks whether `ip` is bound to any local network interface on this host.
-bool isLocalIP(const std::string& ip);
+// Runs `config.workerThreads` reactors, each with its own SO_REUSEPORT
+// listeners, and blocks until all of them have stopped.
+int run_reactor_group(ServerContext& ctx);
 
 int main()
 {
+    // Inherited sockets come through the environment, which must be
+    // read (and cleared) before any thread starts.
+    std::vector<int> listeners = handoff::systemd_listen_fds();
+    const int upgrade_fd       = handoff::upgrade_socket();
+
     // Load runtime settings (address, port, paths, etc.) from the .ini file.
     ServerConfig config;
-    if (!config.Load("/etc/tcpserver/Config_file.ini")) {
+    if (!config.Load(CONFIG_FILE)) {
         std::cerr << "Failed to load configuration file." << std::endl;
         return EXIT_FAILURE;
     }
@@ -44,36 +209,256 @@ int main()
     // get recorded (journald + optional file sink).
     Logger logger(config);
 
-    if (isLocalIP(config.address))
+    std::vector<ListenEndpoint> endpoints;
+    std::string listen_error;
+    if (ListenEndpoint::parse_list(config.address, static_cast<uint16_t>(config.port), endpoints, listen_error)) {
+        for (const ListenEndpoint& e : endpoints) {
+            if (e.reactor >= config.workerThreads) {
+                listen_error = e.name + " is pinned to reactor " + std::to_string(e.reactor) +
+                               " of " + std::to_string(config.workerThreads) + " (worker_threads)";
+                break;
+            }
+        }
+    }
+    if (!listen_error.empty()) {
+        logger.Write_log("[NETWORK] listen_address: " + listen_error, Logger::Error);
+        return EXIT_FAILURE;
+    }
+    if (!config.unixSocket.empty()) {
+        ListenEndpoint local;
+        if (!ListenEndpoint::parse_unix(config.unixSocket, local, listen_error)) {
+            logger.Write_log("[NETWORK] unix_socket: " + listen_error, Logger::Error);
+            return EXIT_FAILURE;
+        }
+        endpoints.push_back(std::move(local));
+    }
+    std::unordered_map<uint32_t, std::string> local_peers;
+    if (!TcpServer::parse_local_peers(config.unixSocketUsers, local_peers, listen_error)) {
+        logger.Write_log("[NETWORK] unix_socket_users: " + listen_error, Logger::Error);
+        return EXIT_FAILURE;
+    }
+    if (!config.unixSocket.empty() && local_peers.empty()) {
+        logger.Write_log("[NETWORK] unix_socket " + config.unixSocket +
+                             ": unix_socket_users is empty, every connection to it will be refused",
+                         Logger::Warn);
+    }
+
+    // Thread placement is settled before the first worker thread starts.
+    std::vector<int> reactor_cpus;
+    std::vector<int> crypto_cpus;
+    if (!load_cpu_list("reactor_cpus", config.reactorCpus, logger, reactor_cpus) ||
+        !load_cpu_list("crypto_cpus", config.cryptoCpus, logger, crypto_cpus)) {
+        return EXIT_FAILURE;
+    }
+    if (!crypto_cpus.empty()) {
+        logger.Write_log("Crypto workers pinned to CPUs " + config.cryptoCpus, Logger::Info);
+    }
+
+    configure_password_cost(config, logger);
+
+    // One Argon2id pool shared by every reactor. It is shut down explicitly
+    // before the servers go away, because its workers post into their mailboxes.
+    CryptoPool crypto(static_cast<size_t>(config.cryptoThreads),
+                      static_cast<size_t>(config.cryptoQueueLimit), crypto_cpus);
+
+    // One token key for every reactor, so a token resumes on any of them.
+    SessionTokens sessions;
+    std::string session_error;
+    if (!sessions.init(config.sessionKeyPath, static_cast<uint32_t>(config.sessionTokenTtl), session_error)) {
+        logger.Write_log("Session tokens: " + session_error, Logger::Warn);
+    }
+
+    // Hot-upgrade successor: the config is good, so take the sockets over.
+    // The predecessor is paused from here on and no longer writes the user
+    // DB, which is why it is only loaded below.
+    std::vector<handoff::ClientState> adopted;
+    if (upgrade_fd >= 0) {
+        std::string error = "predecessor gone";
+        if (!handoff::acknowledge(upgrade_fd, handoff::READY) ||
+            !handoff::receive(upgrade_fd, listeners, adopted, error)) {
+            logger.Write_log("Hot upgrade aborted: " + error, Logger::Error);
+            return EXIT_FAILURE;
+        }
+        logger.Write_log("Hot upgrade: received " + std::to_string(listeners.size()) + " listeners and " +
+                         std::to_string(adopted.size()) + " clients", Logger::Info);
+    }
+
+    // The user DB is parsed exactly once here; every reactor then answers
+    // lookups from the shared in-memory index.
+    CredentialStore::Options db_options;
+    db_options.fsync_interval_ms = config.journalFsyncMs;
+    db_options.compact_records   = static_cast<size_t>(config.journalCompactRecords);
+    std::string db_path = config.DatabasePath;
+    if (config.databaseFormat == "binary") {
+        db_options.format      = CredentialStore::Format::Binary;
+        db_options.import_from = config.DatabasePath;
+        db_path                = config.binaryDatabasePath;
+    }
+    CredentialStore credentials(db_path, db_options);
+    if (!credentials.load()) {
+        logger.Write_log("Credential DB " + db_path +
+                         " is corrupt; starting with an empty index", Logger::Error);
+    } else {
+        logger.Write_log("Loaded " + std::to_string(credentials.size()) +
+                         " accounts from " + db_path, Logger::Info);
+    }
+
+    // One TLS context for every reactor's listener. A bad certificate stops
+    // the start: falling back to plaintext would expose the passwords.
+    std::unique_ptr<TlsContext> tls;
+    if (config.tlsEnabled) {
+        try {
+            tls = std::make_unique<TlsContext>(config.tlsCertificate, config.tlsPrivateKey,
+                                               config.ktls || config.requireKtls,
+                                               config.requireKtls);
+        } catch (const std::exception& e) {
+            logger.Write_log(std::string("TLS: ") + e.what(), Logger::Error);
+            return EXIT_FAILURE;
+        }
+        logger.Write_log("TLS 1.3 enabled with " + config.tlsCertificate + " (kTLS " +
+                         (config.requireKtls ? "required" : config.ktls ? "preferred" : "off") + ")",
+                         Logger::Info);
+        if (config.ioBackend == "io_uring" && !config.requireKtls) {
+            logger.Write_log("TLS with io_uring: connections not fully offloaded to the kernel are closed",
+                             Logger::Warn);
+        }
+    }
+
+    // One chat log for every reactor. Like the user DB it is opened only
+    // once a hot-upgrade predecessor has handed it over (flushed, paused).
+    std::unique_ptr<ChatLog> chat_log;
+    if (!config.chatLogDir.empty()) {
+        ChatLog::Options log_options;
+        log_options.directory         = config.chatLogDir;
+        log_options.segment_bytes     = static_cast<size_t>(config.chatLogSegmentBytes);
+        log_options.max_segments      = static_cast<size_t>(config.chatLogSegments);
+        log_options.index_bytes       = static_cast<size_t>(config.chatLogIndexBytes);
+        log_options.flush_interval_ms = config.chatLogFlushMs;
+        log_options.max_scan_bytes    = static_cast<size_t>(config.chatLogScanBytes);
+        chat_log = std::make_unique<ChatLog>(log_options);
+        std::string error;
+        if (chat_log->open(error)) {
+            logger.Write_log("Chat log " + config.chatLogDir + ": " + std::to_string(chat_log->messages()) +
+                             " messages in " + std::to_string(chat_log->segment_count()) + " segments",
+                             Logger::Info);
+        } else {
+            logger.Write_log("Chat log disabled: " + error, Logger::Error);
+            chat_log.reset();
+        }
+    }
+
+    // Peer links to the other nodes; relayed messages reach the chat log too.
+    std::unique_ptr<Cluster> cluster;
+    if (config.clusterNodeId > 0) {
+        Cluster::Options cluster_options;
+        cluster_options.node_id = static_cast<uint32_t>(config.clusterNodeId);
+        cluster_options.secret  = config.clusterSecret;
+        std::string error;
+        if (!Cluster::parse_endpoint(config.clusterListen, cluster_options.listen_host, cluster_options.listen_port)) {
+            error = "bad listen address '" + config.clusterListen + "' (expected <host>:<port>)";
+        } else {
+            Cluster::parse_peers(config.clusterPeers, cluster_options.peers, error);
+        }
+        if (!error.empty()) {
+            logger.Write_log("[CLUSTER] " + error, Logger::Error);
+            return EXIT_FAILURE;
+        }
+        if (config.clusterSecret.empty()) {
+            logger.Write_log("[CLUSTER] secret is empty: peer links are not authenticated", Logger::Warn);
+        }
+        cluster = std::make_unique<Cluster>(std::move(cluster_options), &logger, chat_log.get());
+        try {
+            cluster->start();
+        } catch (const std::exception& e) {
+            logger.Write_log(std::string("Cluster disabled: ") + e.what(), Logger::Error);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Off until [ADMIN] capture_file names a file (now or on a reload).
+    TrafficCapture capture(&logger);
+    capture.set_path(config.captureFile);
+
+    LiveConfig live(CONFIG_FILE, config);
+    ServerContext ctx{config, logger, crypto, credentials, sessions, live, tls.get(), chat_log.get(), &capture,
+                      cluster.get(), std::move(endpoints),
+                      std::move(listeners), std::move(adopted), upgrade_fd, std::move(reactor_cpus)};
+
+    // SIGUSR2 reaches UpgradeWatcher through this pipe; only the write end
+    // is non-blocking (a full pipe already holds a pending request).
+    if (pipe2(g_upgrade_pipe, O_CLOEXEC) == 0) {
+        fcntl(g_upgrade_pipe[1], F_SETFL, O_NONBLOCK);
+    }
+
+    // An inherited listener was bound by whoever passed it on: the address
+    // check only applies when binding here.
+    const ListenEndpoint* foreign = nullptr;
+    for (const ListenEndpoint& e : ctx.endpoints) {
+        if (ctx.listeners.empty() && !foreign && !e.is_local()) foreign = &e;
+    }
+    const bool can_listen = !foreign;
+
+    if (can_listen && config.workerThreads > 1)
+    {
+        std::signal(SIGPIPE, SIG_IGN); // ignore broken pipe (same as single-loop mode)
+        return run_reactor_group(ctx);
+    }
+    else if (can_listen)
     {
         // Server owns its own lifetime via unique_ptr; raw pointer is only
         // exposed to the signal handler through the atomic global.
-        std::unique_ptr<TcpServer> server =
-            std::make_unique<TcpServer>(
-                config.port,
-                config.address.c_str(),
-                &logger
-            );
+        std::unique_ptr<TcpServer> server = make_server(ctx, std::move(open_listeners(ctx, 1)[0]));
+        server->attach_cluster(ctx.cluster);
+        adopt_clients(ctx, {server.get()});
 
         // Publish pointer BEFORE registering handlers, so a signal arriving
         // right after std::signal() can never see a null/stale pointer.
         g_server_instance.store(server.get());
+        g_live_config.store(&live);
+        UpgradeWatcher upgrades(ctx, {server.get()});
 
         std::signal(SIGTERM, handle_shutdown_signal); // systemd stop
         std::signal(SIGINT,  handle_shutdown_signal); // Ctrl+C
+        std::signal(SIGHUP,  handle_reload_signal);   // systemd reload
+        std::signal(SIGUSR2, handle_upgrade_signal);  // hot upgrade
         std::signal(SIGPIPE, SIG_IGN);                // ignore broken pipe (avoid default terminate on write to closed socket)
 
-        logger.Write_log("Server started on " + config.address + ":" + std::to_string(config.port), Logger::Info);
+        logger.Write_log("Server started on " + listening_on({server.get()}), Logger::Info);
+        std::unique_ptr<AdminServer> admin = start_admin_server(config, logger, {server.get()});
+        std::unique_ptr<AdminChannel> operator_channel = start_admin_channel(config, logger, {server.get()});
+
+        // Pinned only now: the helper threads started above keep the
+        // process-wide mask. An SO_INCOMING_CPU hint is pointless with one
+        // listener, and is skipped.
+        const int cpu = affinity::pick(ctx.reactor_cpus, 0);
+        if (cpu >= 0) {
+            affinity::pin_current_thread(cpu);
+            logger.Write_log("Reactor 0 pinned to " + affinity::describe(cpu), Logger::Info);
+        }
 
         // Blocks until the atomic flag flips (via signal or internal logic);
-        // all teardown (epoll, fds, clients) now happens inside run().
-        server->run();
+        // all teardown (epoll, fds, clients) now happens inside run(). A
+        // hot upgrade returns early with the clients kept for the handoff.
+        bool handed_off = false;
+        while (true) {
+            server->run();
+            if (!server->handoff_requested()) break;
+            handed_off = upgrades.complete(admin);
+            if (handed_off || g_stop_requested.load()) break;
+            server->resume_after_handoff();
+        }
+        if (admin) admin->stop();
+        if (operator_channel) operator_channel->stop();
+        crypto.shutdown(); // No worker may post into the mailbox past this point
+        if (cluster) cluster->stop();
 
         // Unpublish before the unique_ptr destroys the instance, so a signal
         // arriving during destruction can never dereference a dangling pointer.
         g_server_instance.store(nullptr);
+        g_live_config.store(nullptr);
 
-        logger.Write_log("Server stopped gracefully.", Logger::Info);
+        logger.Write_log(handed_off ? "Server handed over to its successor." : "Server stopped gracefully.",
+                         Logger::Info);
         return 0;
     }
     else
@@ -81,48 +466,420 @@ int main()
         // Fail fast: refuse to start if the configured address isn't actually
         // reachable on this host (avoids silent bind failures later).
         std::cerr << BOLD << RED << "[ERROR]:" << NC
-                  << " The specified listen address (" << config.address
+                  << " The specified listen address (" << foreign->name
                   << ") is not assigned to any local network interface on this machine."
                      " Please use a valid local IP address." << std::endl;
-        logger.Write_log("Invalid listen address: " + config.address, Logger::Error);
+        logger.Write_log("Invalid listen address: " + foreign->name, Logger::Error);
         return EXIT_FAILURE;
     }
 }
 
 // ---------------------------------------------------------------------------
-// isLocalIP: checks whether the given IP is assigned to a local interface.
-// Iterates all network interfaces via getifaddrs() and compares IPv4
-// addresses only (IPv6 interfaces are skipped).
+// run_reactor_group: multi-reactor mode. Worker 0 runs on the main thread,
+// the rest on their own threads; each owns a TcpServer (listener + epoll +
+// clients) and they cooperate only through the ReactorGroup mailboxes.
 // ---------------------------------------------------------------------------
-bool isLocalIP(const std::string& ip)
+int run_reactor_group(ServerContext& ctx)
 {
-    struct ifaddrs *ifaddr, *ifa;
+    const ServerConfig& config = ctx.config;
+    Logger& logger             = ctx.logger;
+    const size_t workers       = static_cast<size_t>(config.workerThreads);
+    ReactorGroup group(workers);
+
+    // Bind every listener up front so a failure aborts before any thread starts.
+    std::vector<std::vector<int>> listeners = open_listeners(ctx, workers);
+    std::vector<std::unique_ptr<TcpServer>> servers;
+    std::vector<TcpServer*> reactors;
+    servers.reserve(workers);
+    for (size_t id = 0; id < workers; ++id) {
+        servers.push_back(make_server(ctx, std::move(listeners[id])));
+        servers.back()->attach_group(&group, id);
+        servers.back()->attach_cluster(ctx.cluster); // After the group: its mailbox
+        reactors.push_back(servers.back().get());
+    }
+    adopt_clients(ctx, reactors); // After attach: names go into their owners' shards
+
+    // Reactor N runs on reactor_cpus[N]. Listeners shared by several
+    // reactors (fewer inherited than reactors) keep the last CPU set.
+    std::vector<int> cpus(workers, -1);
+    for (size_t id = 0; id < workers; ++id) {
+        cpus[id] = affinity::pick(ctx.reactor_cpus, id);
+        if (cpus[id] < 0) continue;
+        std::string placement = "Reactor " + std::to_string(id) + " pinned to " + affinity::describe(cpus[id]);
+        if (config.incomingCpu) {
+            for (int fd : servers[id]->listeners()) {
+                if (ListenEndpoint::family(fd) == AF_UNIX) continue; // No RX queue to follow
+                placement += affinity::set_incoming_cpu(fd, cpus[id])
+                                 ? ", SO_INCOMING_CPU set on " + ListenEndpoint::bound_name(fd)
+                                 : ", SO_INCOMING_CPU failed on " + ListenEndpoint::bound_name(fd) + ": " +
+                                       strerror(errno);
+            }
+        }
+        logger.Write_log(placement, Logger::Info);
+    }
+
+    // Publish before installing handlers (see single-loop path in main()).
+    g_reactor_group.store(&group);
+    g_live_config.store(&ctx.live);
+    UpgradeWatcher upgrades(ctx, reactors);
+    std::signal(SIGTERM, handle_shutdown_signal); // systemd stop
+    std::signal(SIGINT,  handle_shutdown_signal); // Ctrl+C
+    std::signal(SIGHUP,  handle_reload_signal);   // systemd reload
+    std::signal(SIGUSR2, handle_upgrade_signal);  // hot upgrade
+
+    logger.Write_log("Server started on " + listening_on(reactors) + " with " + std::to_string(workers) +
+                     " reactors", Logger::Info);
+
+    std::unique_ptr<AdminServer> admin =
+        start_admin_server(config, logger, std::vector<const TcpServer*>(reactors.begin(), reactors.end()));
+    std::unique_ptr<AdminChannel> operator_channel = start_admin_channel(config, logger, reactors);
+
+    bool handed_off = false;
+    while (true) {
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (size_t id = 1; id < workers; ++id) {
+            // Pinned before run() allocates anything (see cpu_affinity.hpp).
+            threads.emplace_back([&servers, &cpus, id] {
+                affinity::pin_current_thread(cpus[id]);
+                servers[id]->run();
+            });
+        }
+
+        // Only now for the main thread, so the helpers started above
+        // (upgrade watcher, admin endpoint) aren't confined with it.
+        affinity::pin_current_thread(cpus[0]);
+        servers[0]->run(); // Blocks until the stop flag flips
+        for (std::thread& t : threads) t.join();
+
+        if (!servers[0]->handoff_requested()) break;
+        handed_off = upgrades.complete(admin);
+        if (handed_off || g_stop_requested.load()) break;
+        for (TcpServer* s : reactors) s->resume_after_handoff();
+    }
+    if (admin) admin->stop();
+    if (operator_channel) operator_channel->stop();
+    ctx.crypto.shutdown(); // No worker may post into a mailbox past this point
+    if (ctx.cluster) ctx.cluster->stop();
+
+    // Unpublish before the servers (and the group) are destroyed.
+    g_reactor_group.store(nullptr);
+    g_live_config.store(nullptr);
+
+    logger.Write_log(handed_off ? "Server handed over to its successor." : "Server stopped gracefully.",
+                     Logger::Info);
+    return 0;
+}
 
-    // Populates a linked list of all local interfaces (IPv4, IPv6, etc.).
-    if (getifaddrs(&ifaddr) == -1) {
-        perror("getifaddrs");
+bool load_cpu_list(const char* key, const std::string& text, Logger& logger, std::vector<int>& cpus)
+{
+    std::string error;
+    if (!affinity::parse_cpu_list(text, cpus, error)) {
+        logger.Write_log(std::string("[PROCESS] ") + key + ": " + error, Logger::Error);
+        return false;
+    }
+    const std::string missing = affinity::unusable(cpus);
+    if (!missing.empty()) {
+        logger.Write_log(std::string("[PROCESS] ") + key + ": CPUs " + missing +
+                         " are offline or outside this process's cpuset", Logger::Error);
         return false;
     }
+    return true;
+}
 
-    bool found = false;
+// A quarter of the RAM is the most crypto_threads hashes may take at once;
+// past that, a login burst on a small VM would push the host into swap.
+void configure_password_cost(const ServerConfig& config, Logger& logger)
+{
+    if (config.argon2TargetMs == 0 && config.argon2Opslimit == 0) {
+        logger.Write_log("Password hashing: " + password::describe_cost() + " (interactive preset)",
+                         Logger::Info);
+        return;
+    }
+    if (sodium_init() < 0) {
+        logger.Write_log("libsodium initialization failed; keeping " + password::describe_cost(), Logger::Error);
+        return;
+    }
 
-    for (ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next)
-    {
-        if (!ifa->ifa_addr) continue; // Some interfaces have a null address entry
+    size_t memlimit = size_t(config.argon2MemoryMb) << 20;
+    struct sysinfo si{};
+    if (sysinfo(&si) == 0) {
+        const uint64_t share = uint64_t(si.totalram) * si.mem_unit / 4 / size_t(config.cryptoThreads);
+        if (share < memlimit) {
+            memlimit = std::max<size_t>(size_t(share) & ~size_t((1u << 20) - 1), size_t(8) << 20);
+            logger.Write_log("Password hashing: argon2_memory_mb lowered to " + std::to_string(memlimit >> 20) +
+                             " MiB so " + std::to_string(config.cryptoThreads) + " hashes fit in RAM",
+                             Logger::Warn);
+        }
+    }
 
-        if (ifa->ifa_addr->sa_family == AF_INET) // Only compare IPv4 addresses
-        {
-            char addr[INET_ADDRSTRLEN];
-            void* in_addr = &((struct sockaddr_in*)ifa->ifa_addr)->sin_addr;
-            inet_ntop(AF_INET, in_addr, addr, INET_ADDRSTRLEN); // Binary → dotted-decimal string
+    if (config.argon2Opslimit > 0) {
+        password::set_cost({static_cast<unsigned long long>(config.argon2Opslimit), memlimit});
+        logger.Write_log("Password hashing: " + password::describe_cost() + " (fixed)", Logger::Info);
+        return;
+    }
 
-            if (ip == addr) {
-                found = true;
-                break;
+    double measured_ms = 0;
+    try {
+        password::set_cost(password::calibrate(config.argon2TargetMs, memlimit, measured_ms));
+    } catch (const std::exception& e) {
+        logger.Write_log(std::string("Password hashing: calibration failed (") + e.what() + "); keeping " +
+                             password::describe_cost(), Logger::Warn);
+        return;
+    }
+    logger.Write_log("Password hashing: " + password::describe_cost() + ", " +
+                         std::to_string(static_cast<int>(measured_ms + 0.5)) + " ms per hash (target " +
+                         std::to_string(config.argon2TargetMs) + " ms)",
+                     Logger::Info);
+}
+
+// ---------------------------------------------------------------------------
+// open_listeners: without inherited sockets, every endpoint is bound by each
+// reactor (SO_REUSEPORT when there are several), or only by the one it is
+// pinned to. Inherited sockets are grouped by the address they are bound
+// to: a pinned address goes to its reactor; otherwise they are handed out
+// one per reactor, and when there are fewer than reactors the extra
+// reactors share them (each epoll instance watches the same queue and
+// accept() simply races). Sockets beyond that are closed, which drops what
+// they had queued. listen_address doesn't add to inherited sockets: systemd
+// or the predecessor decided what is bound.
+// ---------------------------------------------------------------------------
+std::vector<std::vector<int>> open_listeners(ServerContext& ctx, size_t count)
+{
+    std::vector<std::vector<int>> out(count);
+
+    if (ctx.listeners.empty()) {
+        try {
+            for (const ListenEndpoint& e : ctx.endpoints) {
+                for (size_t id = 0; id < count; ++id) {
+                    if (e.reactor >= 0 && static_cast<size_t>(e.reactor) != id) continue;
+                    out[id].push_back(e.open(ctx.config.maxConnections, e.reactor < 0 && count > 1));
+                }
             }
+        } catch (...) {
+            for (const std::vector<int>& fds : out) for (int fd : fds) close(fd);
+            throw;
         }
+        return out;
     }
 
-    freeifaddrs(ifaddr); // Always free the list, regardless of match result
-    return found;
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<int>> by_address;
+    for (int fd : ctx.listeners) {
+        const std::string name = ListenEndpoint::bound_name(fd);
+        if (by_address.find(name) == by_address.end()) order.push_back(name);
+        by_address[name].push_back(fd);
+    }
+    ctx.listeners.clear();
+
+    size_t closed = 0;
+    for (const std::string& name : order) {
+        std::vector<int>& fds = by_address[name];
+        int pinned = -1;
+        for (const ListenEndpoint& e : ctx.endpoints) {
+            if (e.name == name && e.reactor >= 0 && static_cast<size_t>(e.reactor) < count) pinned = e.reactor;
+        }
+
+        const size_t kept = pinned >= 0 ? 1 : std::min(fds.size(), count);
+        if (pinned >= 0) {
+            out[static_cast<size_t>(pinned)].push_back(fds[0]);
+        } else {
+            for (size_t id = 0; id < count; ++id) {
+                out[id].push_back(id < fds.size() ? fds[id]
+                                                  : fcntl(fds[id % fds.size()], F_DUPFD_CLOEXEC, 0));
+            }
+        }
+        for (size_t i = kept; i < fds.size(); ++i) close(fds[i]);
+        closed += fds.size() - kept;
+    }
+    if (closed) {
+        ctx.logger.Write_log("Closing " + std::to_string(closed) + " inherited listeners beyond worker_threads",
+                             Logger::Warn);
+    }
+    return out;
+}
+
+std::string listening_on(const std::vector<TcpServer*>& servers)
+{
+    std::vector<std::string> names;
+    for (const TcpServer* s : servers) {
+        for (int fd : s->listeners()) {
+            const std::string name = ListenEndpoint::bound_name(fd);
+            if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        }
+    }
+    std::string out;
+    for (const std::string& name : names) out += (out.empty() ? "" : ", ") + name;
+    return out.empty() ? "no address" : out;
+}
+
+std::unique_ptr<TcpServer> make_server(ServerContext& ctx, std::vector<int> listeners)
+{
+    const ServerConfig& config = ctx.config;
+    std::unique_ptr<TcpServer> server = std::make_unique<TcpServer>(std::move(listeners), &ctx.logger);
+
+    server->attach_crypto_pool(&ctx.crypto);
+    server->set_password_rehash(config.argon2Rehash);
+    server->attach_credential_store(&ctx.credentials);
+    server->attach_session_tokens(&ctx.sessions);
+    server->attach_live_config(&ctx.live);
+    server->attach_tls(ctx.tls);
+    server->attach_chat_log(ctx.chat_log);
+    server->attach_traffic_capture(ctx.capture);
+    server->set_listen_backlog(config.maxConnections);
+    server->set_socket_tuning(SocketTuning::from_config(config));
+    server->set_max_connections_per_ip(static_cast<uint16_t>(config.maxConnectionsPerIp));
+    server->set_local_peers(config.unixSocketUsers);
+    server->set_idle_timeout(config.timeout);
+    server->set_event_backend(config.ioBackend == "io_uring" ? TcpServer::EventBackend::IoUring
+                                                             : TcpServer::EventBackend::Epoll);
+    server->set_edge_triggered(config.edgeTriggered);
+    server->set_epoll_batch_size(config.epollBatchSize);
+    server->set_write_coalescing(config.writeCoalescing, config.coalesceMaxDelayMs, config.tcpCork);
+    server->set_rate_limits(config.maxMessagesPerSec, config.maxBytesPerSec, config.rateLimitBurst);
+    server->set_record_budget(config.recordsPerIteration);
+    server->set_history(config.historyMessages, config.historyMaxBytes, config.historyGlobal);
+    server->set_history_query_limit(config.chatLogQueryMax);
+    server->set_compression(config.compression, config.compressionMinBytes, config.compressionLevel);
+    server->set_max_input_buffer(config.maxInputBuffer);
+    server->set_memory_budgets(config.inputMemoryBudgetMb, config.outputMemoryBudgetMb);
+    server->set_recv_arena(config.recvArenaMb, config.recvHugePages);
+    server->set_slow_consumer_policy(TcpServer::parse_slow_consumer_policy(config.slowConsumerPolicy),
+                                     config.slowConsumerQueueBytes, config.slowConsumerMaxDelayMs);
+    server->set_overload_control(config.overloadLagMs, config.overloadRejectLagMs, config.overloadRetryAfterS);
+    return server;
+}
+
+void adopt_clients(ServerContext& ctx, const std::vector<TcpServer*>& servers)
+{
+    for (size_t i = 0; i < ctx.adopted.size(); ++i) {
+        servers[i % servers.size()]->adopt_client(std::move(ctx.adopted[i]));
+    }
+
+    if (ctx.upgrade_fd >= 0) {
+        if (!handoff::acknowledge(ctx.upgrade_fd, handoff::ADOPTED)) {
+            ctx.logger.Write_log("Hot upgrade: predecessor gone before the handover", Logger::Warn);
+        }
+        close(ctx.upgrade_fd);
+        ctx.upgrade_fd = -1;
+        ctx.logger.Write_log("Hot upgrade: took over " + std::to_string(ctx.adopted.size()) + " clients",
+                             Logger::Info);
+        handoff::notify_systemd("MAINPID=" + std::to_string(getpid()) + "\nREADY=1");
+    } else {
+        handoff::notify_systemd("READY=1");
+    }
+    ctx.adopted.clear();
+}
+
+void UpgradeWatcher::loop()
+{
+    while (true) {
+        char cmd = 0;
+        ssize_t n = read(g_upgrade_pipe[0], &cmd, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n != 1) return;
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping || cmd == 'Q') return;
+        if (successor.active()) continue; // Already under way
+
+        // The ring owns its recv buffers and in-flight sends; there is no
+        // consistent point to export them.
+        if (ctx.config.ioBackend == "io_uring") {
+            ctx.logger.Write_log("Hot upgrade needs io_backend = epoll; ignoring SIGUSR2", Logger::Warn);
+            continue;
+        }
+
+        ctx.logger.Write_log("Hot upgrade: starting the successor", Logger::Info);
+        std::string error;
+        if (!successor.spawn(error) || !successor.wait_ready(UPGRADE_READY_TIMEOUT_MS, error)) {
+            ctx.logger.Write_log("Hot upgrade failed: " + error, Logger::Error);
+            successor.abandon();
+            continue;
+        }
+        for (TcpServer* s : servers) s->requestHandoff();
+    }
+}
+
+bool UpgradeWatcher::complete(std::unique_ptr<AdminServer>& admin)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!successor.active()) return false;
+
+    // Frees metrics_port for the successor.
+    if (admin) {
+        admin->stop();
+        admin.reset();
+    }
+
+    for (TcpServer* s : servers) s->drain_for_handoff(ctx.logger);
+    if (ctx.chat_log) ctx.chat_log->flush(); // The successor opens it next
+    std::vector<int> listeners;
+    std::vector<handoff::ClientState> clients;
+    for (TcpServer* s : servers) {
+        for (int fd : s->listeners()) listeners.push_back(fd);
+        for (handoff::ClientState& c : s->export_clients()) clients.push_back(std::move(c));
+    }
+
+    std::string error;
+    if (!successor.transfer(listeners, clients, error) ||
+        !successor.wait_adopted(UPGRADE_ADOPTED_TIMEOUT_MS, error)) {
+        ctx.logger.Write_log("Hot upgrade failed (" + error + "); resuming", Logger::Error);
+        successor.abandon();
+        admin = start_admin_server(ctx.config, ctx.logger,
+                                   std::vector<const TcpServer*>(servers.begin(), servers.end()));
+        return false;
+    }
+
+    ctx.logger.Write_log("Hot upgrade: " + std::to_string(clients.size()) + " clients handed to pid " +
+                         std::to_string(successor.pid()), Logger::Info);
+    successor.release();
+    for (TcpServer* s : servers) s->release_clients();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// start_admin_server: a bind failure (port taken...) is logged and the
+// server keeps running without metrics rather than refusing to start.
+// ---------------------------------------------------------------------------
+std::unique_ptr<AdminServer> start_admin_server(const ServerConfig& config, Logger& logger,
+                                                const std::vector<const TcpServer*>& servers)
+{
+    if (config.metricsPort == 0) return nullptr;
+
+    std::vector<const metrics::ReactorMetrics*> sources;
+    for (const TcpServer* s : servers) sources.push_back(&s->stats());
+
+    try {
+        auto admin = std::make_unique<AdminServer>(static_cast<uint16_t>(config.metricsPort),
+                                                   std::move(sources), &logger);
+        logger.Write_log("Metrics on http://127.0.0.1:" + std::to_string(config.metricsPort) +
+                         "/metrics", Logger::Info);
+        return admin;
+    } catch (const std::exception& e) {
+        logger.Write_log(std::string("Metrics endpoint disabled: ") + e.what(), Logger::Warn);
+        return nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// start_admin_channel: like the metrics endpoint, optional — a server that
+// can't create its socket (missing runtime directory...) still starts.
+// After a hot upgrade the successor binds a fresh socket at the same path
+// once it owns the clients; the predecessor then leaves that file alone.
+// ---------------------------------------------------------------------------
+std::unique_ptr<AdminChannel> start_admin_channel(const ServerConfig& config, Logger& logger,
+                                                  const std::vector<TcpServer*>& servers)
+{
+    if (config.adminSocket.empty()) return nullptr;
+
+    try {
+        auto channel = std::make_unique<AdminChannel>(config.adminSocket, &logger);
+        for (TcpServer* s : servers) s->attach_admin_channel(channel.get());
+        logger.Write_log("Admin commands on unix:" + config.adminSocket, Logger::Info);
+        return channel;
+    } catch (const std::exception& e) {
+        logger.Write_log(std::string("Admin channel disabled: ") + e.what(), Logger::Warn);
+        return nullptr;
+    }
 }
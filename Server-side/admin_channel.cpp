@@ -0,0 +1,368 @@
+#include "admin_channel.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "common/Logger/logger.hpp"
+#include "mailbox.hpp"
+
+#define ADMIN_MAX_SESSIONS 8        // Operator connections served at once
+#define ADMIN_LINE_MAX 1024         // Longer command lines close the session
+#define ADMIN_REPLY_TIMEOUT_MS 1000 // Wait for the reactors' answers
+#define ADMIN_DEFAULT_ROWS 20       // clients / top-senders / ips without a count
+#define ADMIN_MAX_ROWS 10000
+
+namespace {
+
+const char* const HELP =
+    "stats              connections, sessions and buffers per reactor\n"
+    "clients [n]        the first n connections of each reactor\n"
+    "top-senders [n]    the n clients that sent the most messages\n"
+    "ips [n]            the n addresses with the most connections\n"
+    "kick <user>        end the session of <user>\n"
+    "drain [on|off]     refuse new connections (on) or accept them again\n"
+    "help               this text\n";
+
+// Whole buffer, or false if the peer went away (the session is dropped).
+bool send_all(int fd, const std::string& bytes)
+{
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+        ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// "clients 50" → 50; a missing count is `fallback`; false on junk.
+bool parse_count(const std::string& arg, size_t fallback, size_t& out)
+{
+    if (arg.empty()) {
+        out = fallback;
+        return true;
+    }
+    size_t n = 0;
+    for (char c : arg) {
+        if (c < '0' || c > '9') return false;
+        n = n * 10 + static_cast<size_t>(c - '0');
+        if (n > ADMIN_MAX_ROWS) n = ADMIN_MAX_ROWS;
+    }
+    out = n ? n : fallback;
+    return true;
+}
+
+std::string duration(uint64_t seconds)
+{
+    std::ostringstream out;
+    if (seconds >= 86400) out << seconds / 86400 << "d";
+    if (seconds >= 3600) out << (seconds / 3600) % 24 << "h";
+    if (seconds >= 60) out << (seconds / 60) % 60 << "m";
+    out << seconds % 60 << "s";
+    return out.str();
+}
+
+void client_table(std::ostringstream& out, const std::vector<AdminQuery::ClientRow>& rows)
+{
+    out << std::left << std::setw(4) << "R" << std::setw(7) << "FD" << std::setw(24) << "PEER" << std::setw(20)
+        << "USER" << std::setw(14) << "CHANNEL" << std::setw(6) << "PROTO" << std::setw(10) << "AGE"
+        << std::setw(10) << "IDLE" << std::setw(10) << "QUEUED" << "MSGS\n";
+    for (const AdminQuery::ClientRow& r : rows) {
+        out << std::left << std::setw(4) << r.reactor << std::setw(7) << r.fd << std::setw(24) << r.peer
+            << std::setw(20) << (r.user.empty() ? "-" : r.user) << std::setw(14)
+            << (r.channel.empty() ? "-" : r.channel) << std::setw(6)
+            << (std::string(r.protocol) + (r.tls ? "+t" : "")) << std::setw(10) << duration(r.connected_s)
+            << std::setw(10) << duration(r.idle_ms / 1000) << std::setw(10) << r.queued_bytes << r.messages
+            << "\n";
+    }
+}
+
+} // namespace
+
+void AdminQuery::answer(Part&& part)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        parts.push_back(std::move(part));
+    }
+    answered.notify_all();
+}
+
+std::vector<AdminQuery::Part> AdminQuery::wait(size_t reactors, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    answered.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return parts.size() >= reactors; });
+    std::vector<Part> out = std::move(parts);
+    parts.clear();
+    std::sort(out.begin(), out.end(), [](const Part& a, const Part& b) { return a.reactor < b.reactor; });
+    return out;
+}
+
+AdminChannel::AdminChannel(std::string _path, Logger* _logger)
+    : path(std::move(_path)), logger(_logger)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("admin socket path '" + path + "' is empty or too long");
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd == -1) {
+        throw std::runtime_error(std::string("admin socket: ") + strerror(errno));
+    }
+
+    // A socket file left by a crashed run (or by the predecessor of a hot
+    // upgrade, which keeps serving its already bound socket) is replaced.
+    struct stat st{};
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+
+    // 0660 before listen(): until then nobody can connect, whatever mode
+    // bind() gave the file (umask is process-wide, so it is left alone).
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || chmod(path.c_str(), 0660) == -1 ||
+        listen(listen_fd, ADMIN_MAX_SESSIONS) == -1) {
+        int err = errno;
+        close(listen_fd);
+        throw std::runtime_error("admin socket " + path + ": " + strerror(err));
+    }
+    if (stat(path.c_str(), &st) == 0) inode = st.st_ino;
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        int err = errno;
+        close(listen_fd);
+        unlink(path.c_str());
+        throw std::runtime_error(std::string("admin eventfd: ") + strerror(err));
+    }
+
+    worker = std::thread([this] { serve(); });
+}
+
+AdminChannel::~AdminChannel()
+{
+    stop();
+}
+
+void AdminChannel::add_reactor(Mailbox* inbox)
+{
+    std::lock_guard<std::mutex> lock(reactors_mtx);
+    reactors.push_back(inbox);
+}
+
+void AdminChannel::stop()
+{
+    if (!worker.joinable()) return;
+    running.store(false);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    worker.join();
+
+    for (Session& s : sessions) close(s.fd);
+    sessions.clear();
+    close(listen_fd);
+    close(wake_fd);
+
+    // After a hot upgrade the path belongs to the successor's socket.
+    struct stat st{};
+    if (stat(path.c_str(), &st) == 0 && st.st_ino == inode) unlink(path.c_str());
+}
+
+void AdminChannel::serve()
+{
+    std::vector<pollfd> fds;
+    while (running.load())
+    {
+        fds.clear();
+        fds.push_back({wake_fd, POLLIN, 0});
+        fds.push_back({listen_fd, static_cast<short>(sessions.size() < ADMIN_MAX_SESSIONS ? POLLIN : 0), 0});
+        for (const Session& s : sessions) fds.push_back({s.fd, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            if (logger) logger->Write_log("Admin channel poll failed: " + std::string(strerror(errno)), Logger::Error);
+            return;
+        }
+        if (fds[0].revents) return; // stop()
+
+        // Sessions first: `fds` indexes them as they were before accepting.
+        for (size_t i = sessions.size(); i-- > 0;) {
+            if (!fds[i + 2].revents) continue;
+            Session& s = sessions[i];
+            char buf[512];
+            ssize_t n = recv(s.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            bool keep = n > 0 || (n == -1 && (errno == EAGAIN || errno == EINTR));
+            if (n > 0) s.input.append(buf, static_cast<size_t>(n));
+
+            size_t eol;
+            while (keep && (eol = s.input.find('\n')) != std::string::npos) {
+                std::string line = s.input.substr(0, eol);
+                s.input.erase(0, eol + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                keep = line != "quit" && line != "exit" && send_all(s.fd, execute(line));
+            }
+            if (keep && s.input.size() > ADMIN_LINE_MAX) keep = false;
+            if (!keep) {
+                close(s.fd);
+                sessions.erase(sessions.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd == -1) continue;
+            // An operator tool that stops reading can't pin this thread.
+            timeval timeout{ADMIN_REPLY_TIMEOUT_MS / 1000, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            sessions.push_back(Session{fd, {}});
+        }
+    }
+}
+
+std::vector<AdminQuery::Part> AdminChannel::ask(const std::shared_ptr<AdminQuery>& q)
+{
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(reactors_mtx);
+        for (Mailbox* inbox : reactors) {
+            auto* msg  = new MailboxMessage;
+            msg->type  = MailboxMessage::AdminQuery;
+            msg->query = q;
+            inbox->push(msg);
+        }
+        count = reactors.size();
+    }
+    return q->wait(count, ADMIN_REPLY_TIMEOUT_MS);
+}
+
+std::string AdminChannel::execute(const std::string& line)
+{
+    std::istringstream words(line);
+    std::string command, arg, extra;
+    words >> command >> arg >> extra;
+
+    auto q = std::make_shared<AdminQuery>();
+    if (command == "help") {
+        return std::string(HELP) + "OK\n";
+    } else if (command == "stats") {
+        q->kind = AdminQuery::Stats;
+    } else if (command == "clients" || command == "top-senders" || command == "ips") {
+        q->kind = command == "clients" ? AdminQuery::Clients
+                  : command == "ips"   ? AdminQuery::Ips
+                                       : AdminQuery::TopSenders;
+        if (!parse_count(arg, ADMIN_DEFAULT_ROWS, q->limit)) return "ERR bad count '" + arg + "'\n";
+    } else if (command == "kick") {
+        if (arg.empty()) return "ERR usage: kick <user>\n";
+        q->kind = AdminQuery::Kick;
+        q->user = arg;
+    } else if (command == "drain") {
+        if (!arg.empty() && arg != "on" && arg != "off") return "ERR usage: drain [on|off]\n";
+        q->kind  = AdminQuery::Drain;
+        q->drain = arg != "off";
+    } else {
+        return "ERR unknown command '" + command + "' (try help)\n";
+    }
+    if (!extra.empty()) return "ERR too many arguments\n";
+
+    size_t expected = 0;
+    {
+        std::lock_guard<std::mutex> lock(reactors_mtx);
+        expected = reactors.size();
+    }
+    std::vector<AdminQuery::Part> parts = ask(q);
+
+    std::ostringstream out;
+    if (q->kind == AdminQuery::Stats) {
+        AdminQuery::Part total;
+        out << std::left << std::setw(9) << "REACTOR" << std::setw(9) << "CLIENTS" << std::setw(10) << "SESSIONS"
+            << std::setw(9) << "PENDING" << std::setw(6) << "V2" << std::setw(8) << "SHARD" << std::setw(12)
+            << "QUEUED" << std::setw(12) << "INPUT" << std::setw(11) << "ACCEPTED" << std::setw(11) << "MESSAGES"
+            << "STATE\n";
+        for (const AdminQuery::Part& p : parts) {
+            out << std::left << std::setw(9) << p.reactor << std::setw(9) << p.clients << std::setw(10)
+                << p.sessions << std::setw(9) << p.pending_auth << std::setw(6) << p.v2_clients << std::setw(8)
+                << p.shard_names << std::setw(12) << p.queued_bytes << std::setw(12) << p.input_bytes
+                << std::setw(11) << p.accepted << std::setw(11) << p.messages
+                << (p.draining ? "draining" : "serving") << "\n";
+            total.clients += p.clients;
+            total.sessions += p.sessions;
+            total.pending_auth += p.pending_auth;
+            total.v2_clients += p.v2_clients;
+            total.shard_names += p.shard_names;
+            total.queued_bytes += p.queued_bytes;
+            total.input_bytes += p.input_bytes;
+            total.accepted += p.accepted;
+            total.messages += p.messages;
+        }
+        if (parts.size() > 1) {
+            out << std::left << std::setw(9) << "all" << std::setw(9) << total.clients << std::setw(10)
+                << total.sessions << std::setw(9) << total.pending_auth << std::setw(6) << total.v2_clients
+                << std::setw(8) << total.shard_names << std::setw(12) << total.queued_bytes << std::setw(12)
+                << total.input_bytes << std::setw(11) << total.accepted << total.messages << "\n";
+        }
+    } else if (q->kind == AdminQuery::Clients || q->kind == AdminQuery::TopSenders) {
+        std::vector<AdminQuery::ClientRow> rows;
+        for (AdminQuery::Part& p : parts) {
+            for (AdminQuery::ClientRow& r : p.rows) rows.push_back(std::move(r));
+        }
+        if (q->kind == AdminQuery::TopSenders) {
+            std::sort(rows.begin(), rows.end(), [](const AdminQuery::ClientRow& a, const AdminQuery::ClientRow& b) {
+                return a.messages > b.messages;
+            });
+            if (rows.size() > q->limit) rows.resize(q->limit);
+        }
+        client_table(out, rows);
+    } else if (q->kind == AdminQuery::Ips) {
+        std::unordered_map<IpKey, size_t, IpKeyHash> merged;
+        for (const AdminQuery::Part& p : parts) {
+            for (const auto& ip : p.ips) merged[ip.first] += ip.second;
+        }
+        std::vector<std::pair<IpKey, size_t>> ips(merged.begin(), merged.end());
+        const size_t shown = std::min(ips.size(), q->limit);
+        std::partial_sort(ips.begin(), ips.begin() + static_cast<std::ptrdiff_t>(shown), ips.end(),
+                          [](const auto& a, const auto& b) { return a.second > b.second; });
+        out << std::left << std::setw(40) << "ADDRESS" << "CONNECTIONS\n";
+        for (size_t i = 0; i < shown; ++i) {
+            out << std::left << std::setw(40) << ips[i].first.to_string() << ips[i].second << "\n";
+        }
+    } else if (q->kind == AdminQuery::Kick) {
+        size_t kicked = 0;
+        for (const AdminQuery::Part& p : parts) kicked += p.kicked;
+        if (kicked == 0 && parts.size() == expected) return "ERR " + q->user + " is not online here\n";
+        out << "kicked " << q->user << " (" << kicked << " session" << (kicked == 1 ? "" : "s") << ")\n";
+        if (logger) logger->Write_log("Admin: kicked " + q->user, Logger::Warn);
+    } else {
+        size_t clients = 0;
+        for (const AdminQuery::Part& p : parts) clients += p.clients;
+        out << (q->drain ? "draining: new connections are refused, " : "serving: new connections are accepted, ")
+            << clients << " connected\n";
+        if (logger) {
+            logger->Write_log(q->drain ? "Admin: draining, new connections refused" : "Admin: accepting connections again",
+                              Logger::Warn);
+        }
+    }
+
+    if (parts.size() < expected) {
+        return out.str() + "ERR " + std::to_string(expected - parts.size()) + " of " + std::to_string(expected) +
+               " reactors did not answer in time\n";
+    }
+    return out.str() + "OK\n";
+}
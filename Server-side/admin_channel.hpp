@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "ip_key.hpp"
+
+class Logger;
+class Mailbox;
+
+// ============================================================================
+// AdminQuery — one operator command, fanned out to every reactor as a
+// MailboxMessage::AdminQuery. Each reactor answers it on its own loop
+// thread, between two batches of events, from its `clients`, `usernames`
+// and counters (TcpServer::answer_admin_query()), so nothing is shared
+// with the loops and no reactor pays for introspection until somebody
+// asks. Row limits are applied by the reactors, so `top-senders 10` over
+// 100k connections copies ten rows per reactor, not 100k. (`ips` takes
+// every address, as binary keys: one peer's connections are spread over
+// the reactors by SO_REUSEPORT.)
+// ============================================================================
+struct AdminQuery {
+    enum Kind {
+        Stats,      // Counts per reactor
+        Clients,    // First `limit` connections of each reactor
+        TopSenders, // The `limit` clients that sent the most chat messages
+        Ips,        // The `limit` peer addresses with the most connections, process-wide
+        Kick,       // Disconnect the session of `user`
+        Drain       // Refuse (`drain`) or accept again new connections
+    };
+
+    // One connection, as the reactor saw it when it answered.
+    struct ClientRow {
+        size_t reactor{0};
+        int fd{-1};
+        std::string peer;          // "address:port"
+        std::string user;          // Empty before /login or /register
+        std::string channel;       // Current channel, if any
+        const char* protocol{"?"}; // "v1", "v2" or "?" (not negotiated yet)
+        bool tls{false};
+        uint64_t connected_s{0};   // Age of the connection
+        uint64_t idle_ms{0};       // Since the last received bytes
+        size_t queued_bytes{0};    // Output not taken by the kernel yet
+        uint64_t messages{0};      // Chat and /msg messages sent by it
+    };
+
+    // One reactor's answer.
+    struct Part {
+        size_t reactor{0};
+        size_t clients{0};       // Connections
+        size_t sessions{0};      // ... logged in
+        size_t pending_auth{0};  // ... waiting for Argon2id or a claim
+        size_t v2_clients{0};
+        size_t shard_names{0};   // Online names this reactor's shard holds
+        size_t queued_bytes{0};  // Output queued to its clients
+        size_t input_bytes{0};   // Read buffer capacity held
+        uint64_t accepted{0};    // Since start
+        uint64_t messages{0};    // Chat messages routed since start
+        bool draining{false};
+        size_t kicked{0};        // Kick: sessions ended
+        std::vector<ClientRow> rows;
+        std::vector<std::pair<IpKey, uint16_t>> ips; // Ips: every peer address, connections
+    };
+
+    Kind kind{Stats};
+    std::string user;  // Kick
+    bool drain{false}; // Drain: on or off
+    size_t limit{0};   // Clients, TopSenders, Ips
+
+    // Called once by each reactor, on its own thread.
+    void answer(Part&& part);
+
+    // The answers of up to `reactors` reactors, after waiting at most
+    // `timeout_ms` for the missing ones (a reactor paused by a hot
+    // upgrade answers late, and that answer is dropped).
+    std::vector<Part> wait(size_t reactors, int timeout_ms);
+
+private:
+    std::mutex mtx;
+    std::condition_variable answered;
+    std::vector<Part> parts;
+};
+
+// ============================================================================
+// AdminChannel — operator commands on a Unix socket ([ADMIN] admin_socket).
+//
+//   $ socat - UNIX-CONNECT:/run/tcpserver/admin.sock
+//   stats | clients [n] | top-senders [n] | ips [n] | kick <user> |
+//   drain [on|off] | help
+//
+// One line per command; every answer ends with a line "OK" or "ERR
+// <reason>". A small thread accepts the sockets and parses the lines (a
+// handful of operator sessions at a time); the data comes from the
+// reactors, through their mailboxes (see AdminQuery). The socket is
+// created 0660 and, like the rest of the runtime directory, is meant for
+// the service user and its group only.
+// ============================================================================
+class AdminChannel {
+public:
+    // Binds `path` (replacing a stale socket file) and starts serving.
+    // Throws std::runtime_error if it can't be bound.
+    AdminChannel(std::string path, Logger* logger);
+
+    // Stops the thread there and then (see stop()).
+    ~AdminChannel();
+
+    AdminChannel(const AdminChannel&) = delete;
+    AdminChannel& operator=(const AdminChannel&) = delete;
+
+    // Registers one reactor's mailbox (TcpServer::attach_admin_channel()).
+    void add_reactor(Mailbox* inbox);
+
+    // Closes every session, joins the thread and removes the socket file
+    // (unless a successor has already bound a new one there). Call before
+    // the reactors' mailboxes go away. Idempotent.
+    void stop();
+
+private:
+    struct Session {
+        int fd{-1};
+        std::string input; // Bytes after the last complete line
+    };
+
+    // Thread body: poll(listener, wake, sessions) → accept / read lines.
+    void serve();
+
+    // Runs one command line and returns the whole answer.
+    std::string execute(const std::string& line);
+
+    // Posts `q` to every reactor and waits for their parts.
+    std::vector<AdminQuery::Part> ask(const std::shared_ptr<AdminQuery>& q);
+
+    std::string path;
+    uint64_t inode{0};                // Of the socket file we bound (see stop())
+    int listen_fd{-1};
+    int wake_fd{-1};                  // eventfd: stop() → serve() returns
+    std::mutex reactors_mtx;          // Guards `reactors`
+    std::vector<Mailbox*> reactors;
+    std::vector<Session> sessions;
+    Logger* logger{nullptr};          // Non-owning, may be null
+    std::atomic<bool> running{true};
+    std::thread worker;
+};
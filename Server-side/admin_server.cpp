@@ -0,0 +1,133 @@
+#include "admin_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "common/Logger/logger.hpp"
+
+#define ADMIN_REQUEST_MAX 4096   // Larger requests are refused
+#define ADMIN_READ_TIMEOUT_MS 1000
+
+AdminServer::AdminServer(uint16_t port, std::vector<const metrics::ReactorMetrics*> reactors,
+                         Logger* _logger)
+    : sources(std::move(reactors)), logger(_logger)
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        throw std::runtime_error(std::string("admin socket: ") + strerror(errno));
+    }
+
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Never reachable from outside
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+        listen(listen_fd, 16) == -1) {
+        int err = errno;
+        close(listen_fd);
+        throw std::runtime_error("admin socket 127.0.0.1:" + std::to_string(port) + ": " + strerror(err));
+    }
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        int err = errno;
+        close(listen_fd);
+        throw std::runtime_error(std::string("admin eventfd: ") + strerror(err));
+    }
+
+    worker = std::thread([this] { serve(); });
+}
+
+AdminServer::~AdminServer()
+{
+    stop();
+}
+
+void AdminServer::stop()
+{
+    if (!worker.joinable()) return;
+    running.store(false);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    worker.join();
+    close(listen_fd);
+    close(wake_fd);
+}
+
+void AdminServer::serve()
+{
+    while (running.load())
+    {
+        pollfd fds[2] = {{listen_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            if (logger) logger->Write_log("Admin socket poll failed: " + std::string(strerror(errno)), Logger::Error);
+            return;
+        }
+        if (fds[1].revents) return; // stop()
+
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) continue;
+
+        // A scraper that stops reading can't pin this thread either.
+        timeval timeout{ADMIN_READ_TIMEOUT_MS / 1000, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle_connection(fd);
+        close(fd);
+    }
+}
+
+// Minimal HTTP/1.0: read up to the end of the headers, answer, close.
+void AdminServer::handle_connection(int fd)
+{
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.find("\n\n") == std::string::npos) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, ADMIN_READ_TIMEOUT_MS) <= 0) return; // Slow or silent client
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+        if (request.size() > ADMIN_REQUEST_MAX) return;
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+        body = metrics::render_prometheus(sources);
+    } else {
+        status = "404 Not Found";
+        body   = "Only GET /metrics is served here.\n";
+    }
+
+    std::string response = "HTTP/1.0 " + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "metrics.hpp"
+
+class Logger;
+
+// ============================================================================
+// AdminServer — loopback-only HTTP endpoint for operators.
+//
+// GET /metrics answers with every reactor's metrics in Prometheus text
+// format. It runs on its own thread and only ever reads the reactors'
+// relaxed counters, so a scrape never stalls an event loop. The socket is
+// bound to 127.0.0.1 whatever listen_address says; requests are served one
+// at a time with a short read timeout (this is for a local scraper, not
+// for the internet).
+// ============================================================================
+class AdminServer {
+public:
+    // Binds 127.0.0.1:`port` and starts serving. `reactors` must outlive
+    // the server. Throws std::runtime_error if the port can't be bound.
+    AdminServer(uint16_t port, std::vector<const metrics::ReactorMetrics*> reactors, Logger* logger);
+
+    // Stops the thread and closes the socket (see stop()).
+    ~AdminServer();
+
+    AdminServer(const AdminServer&) = delete;
+    AdminServer& operator=(const AdminServer&) = delete;
+
+    // Wakes the thread, joins it and closes the sockets. Idempotent.
+    void stop();
+
+private:
+    // Thread body: poll(listener, wake) → accept → handle_connection.
+    void serve();
+
+    // Reads one request and writes one response, then the caller closes.
+    void handle_connection(int fd);
+
+    int listen_fd{-1};
+    int wake_fd{-1};                  // eventfd: stop() → serve() returns
+    std::vector<const metrics::ReactorMetrics*> sources;
+    Logger* logger{nullptr};          // Non-owning, may be null
+    std::atomic<bool> running{true};
+    std::thread worker;
+};
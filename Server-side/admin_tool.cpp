@@ -0,0 +1,325 @@
+// ============================================================================
+// tcpserver-admin — offline bulk import and export of user accounts.
+//
+//   tcpserver-admin import [--threads N] [--format json|binary] <users.csv|users.json> <credential DB>
+//   tcpserver-admin export [--format json|binary] <credential DB> <out.json>
+//
+// import takes plaintext accounts, hashes them with Argon2id on every core
+// (exactly as /register would) and writes the credential store once at the
+// end, instead of one /register round trip, one serial hash and one journal
+// line per user. Input is either CSV (username,password[,ip_source], an
+// optional "username,..." header, RFC 4180 quoting) or JSON in the DB's
+// own schema: {"users": [{"username": ..., "password": ..., "IP_source": ...}]}
+// with the password in plaintext. Names that are invalid, repeated or
+// already in the store are skipped and counted. The report gives the
+// measured wall-clock rate of each phase and of the whole run.
+//
+// export writes the store (either format) as a JSON snapshot in the
+// schema above, with the hashes. Stop the server first: the store is not
+// meant to be shared between processes.
+// ============================================================================
+
+#include <sodium.h>
+#include <sys/sysinfo.h> // sysinfo() — RAM available for Argon2id workers
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "credential_store.hpp"
+#include "password_hash.hpp"
+#include <protocol.hpp>
+
+namespace {
+
+using Clock  = std::chrono::steady_clock;
+using Record = CredentialStore::UserRecord;
+
+// Argon2id scratch memory per worker (MEMLIMIT_INTERACTIVE).
+constexpr size_t HASH_MEMORY = 64u << 20;
+
+int usage(const char* argv0)
+{
+    std::cerr << "usage: " << argv0 << " import [--threads N] [--format json|binary] <users.csv|users.json> <credential DB>\n"
+              << "       " << argv0 << " export [--format json|binary] <credential DB> <out.json>\n";
+    return EXIT_FAILURE;
+}
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string rate(size_t count, double seconds)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(seconds < 10 ? 2 : 1) << seconds << " s";
+    if (seconds > 0) out << ", " << static_cast<uint64_t>(count / seconds) << " users/s";
+    return out.str();
+}
+
+// Same rules as a /login or /register line: the name travels with a
+// one-byte length, '|' separates it from the password, and the line parser
+// trims surrounding whitespace.
+bool valid_account(const Record& rec)
+{
+    const std::string& name = rec.username;
+    if (name.empty() || name.size() > protocol::MAX_NAME || rec.password_hash.empty()) return false;
+    if (std::isspace(static_cast<unsigned char>(name.front())) ||
+        std::isspace(static_cast<unsigned char>(name.back()))) {
+        return false;
+    }
+    for (unsigned char c : name) {
+        if (c == '|' || c < 0x20 || c == 0x7f) return false;
+    }
+    return rec.password_hash.find_first_of("\r\n") == std::string::npos;
+}
+
+// Splits one CSV line into fields ("" inside quotes is a literal quote).
+// False on an unterminated quote.
+bool split_csv(const std::string& line, std::vector<std::string>& fields)
+{
+    fields.assign(1, std::string());
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted) {
+            if (c != '"') fields.back() += c;
+            else if (i + 1 < line.size() && line[i + 1] == '"') fields.back() += line[++i];
+            else quoted = false;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else {
+            fields.back() += c;
+        }
+    }
+    return !quoted;
+}
+
+bool read_csv(const std::string& path, const std::function<void(Record&&)>& sink, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        error = "cannot open";
+        return false;
+    }
+    std::string line;
+    std::vector<std::string> fields;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (number == 1 && line.compare(0, 9, "username,") == 0) continue; // Header
+        if (!split_csv(line, fields) || fields.size() < 2 || fields.size() > 3) {
+            error = "line " + std::to_string(number) + ": expected username,password[,ip_source]";
+            return false;
+        }
+        sink(Record{std::move(fields[0]), std::move(fields[1]), fields.size() > 2 ? std::move(fields[2]) : "", ""});
+    }
+    return true;
+}
+
+// Worker count: every core, unless RAM can't hold one Argon2id each.
+unsigned hash_threads(unsigned requested)
+{
+    unsigned threads = requested ? requested : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    struct sysinfo si{};
+    if (requested == 0 && sysinfo(&si) == 0) {
+        const uint64_t available = uint64_t(si.freeram + si.bufferram) * si.mem_unit;
+        const uint64_t fit       = available / 2 / HASH_MEMORY; // Leave half for everything else
+        if (fit >= 1 && fit < threads) {
+            std::cerr << "Using " << fit << " of " << threads << " cores: each hash needs "
+                      << (HASH_MEMORY >> 20) << " MiB\n";
+            threads = static_cast<unsigned>(fit);
+        }
+    }
+    return threads;
+}
+
+// Hashes every password in place on `threads` workers, replacing the
+// plaintext (which is wiped) by the encoded hash. Progress goes to stderr.
+size_t hash_all(std::vector<Record>& accounts, unsigned threads)
+{
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::atomic<size_t> failed{0};
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < accounts.size();) {
+                std::string& secret = accounts[i].password_hash;
+                try {
+                    std::string encoded = password::hash(secret);
+                    sodium_memzero(&secret[0], secret.size());
+                    secret = std::move(encoded);
+                } catch (const std::exception&) {
+                    sodium_memzero(&secret[0], secret.size());
+                    secret.clear(); // Dropped before the write
+                    failed.fetch_add(1, std::memory_order_relaxed);
+                }
+                done.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const Clock::time_point start = Clock::now();
+    while (done.load() < accounts.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const size_t n = done.load();
+        std::cerr << "\rHashed " << n << "/" << accounts.size() << " (" << rate(n, seconds_since(start)) << ")"
+                  << std::flush;
+    }
+    for (std::thread& w : workers) w.join();
+    if (!accounts.empty()) std::cerr << "\n";
+    return failed.load();
+}
+
+std::string utc_now()
+{
+    std::time_t t = std::time(nullptr);
+    std::tm tm_struct{};
+    gmtime_r(&t, &tm_struct);
+    std::ostringstream out;
+    out << std::put_time(&tm_struct, "%Y-%m-%dT%H:%M:%SZ"); // Same format as /register
+    return out.str();
+}
+
+bool ends_with(const std::string& s, const char* suffix)
+{
+    const size_t n = std::char_traits<char>::length(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+int import_users(const std::string& input, const std::string& db_path, CredentialStore::Options options,
+                 unsigned requested_threads)
+{
+    CredentialStore target(db_path, options);
+    if (!target.load() && options.format == CredentialStore::Format::Binary) return EXIT_FAILURE;
+
+    // 1. Read and validate; nothing is hashed for an account that would be skipped.
+    const Clock::time_point start = Clock::now();
+    std::vector<Record> accounts;
+    std::unordered_set<std::string> names;
+    size_t invalid = 0, repeated = 0, present = 0;
+    auto take = [&](Record&& rec) {
+        if (!valid_account(rec)) ++invalid;
+        else if (target.contains(rec.username)) ++present;
+        else if (!names.insert(rec.username).second) ++repeated;
+        else return accounts.push_back(std::move(rec));
+        if (!rec.password_hash.empty()) sodium_memzero(&rec.password_hash[0], rec.password_hash.size());
+    };
+    std::string error;
+    uint64_t ignored_seq = 0;
+    const bool parsed = ends_with(input, ".csv") ? read_csv(input, take, error)
+                                                 : CredentialStore::read_snapshot(input, ignored_seq, take, error);
+    names.clear();
+    if (!parsed) {
+        std::cerr << input << ": " << error << "\n";
+        for (Record& rec : accounts) sodium_memzero(&rec.password_hash[0], rec.password_hash.size());
+        return EXIT_FAILURE;
+    }
+    const double read_s = seconds_since(start);
+    std::cout << "Read " << accounts.size() + invalid + repeated + present << " accounts from " << input << " ("
+              << rate(accounts.size(), read_s) << "): " << accounts.size() << " to import, " << invalid
+              << " invalid, " << repeated << " repeated, " << present << " already in " << db_path << "\n";
+
+    // 2. Hash on every core.
+    const unsigned threads = hash_threads(requested_threads);
+    const Clock::time_point hash_start = Clock::now();
+    const size_t failed = hash_all(accounts, threads);
+    const double hash_s = seconds_since(hash_start);
+    std::cout << "Hashed " << accounts.size() - failed << " passwords on " << threads << (threads == 1 ? " thread (" : " threads (")
+              << password::describe_cost() << "): " << rate(accounts.size(), hash_s) << "\n";
+    if (failed) std::cerr << failed << " hashes failed (out of memory?) and are not imported\n";
+
+    // 3. One write of the store.
+    const std::string created = utc_now();
+    std::vector<Record> ready;
+    ready.reserve(accounts.size() - failed);
+    for (Record& rec : accounts) {
+        if (rec.password_hash.empty()) continue;
+        rec.created_at = created;
+        ready.push_back(std::move(rec));
+    }
+    std::vector<Record>().swap(accounts);
+    const size_t batch        = ready.size();
+    const Clock::time_point write_start = Clock::now();
+    bool durable              = false;
+    const size_t imported     = target.bulk_import(std::move(ready), durable);
+    const double write_s      = seconds_since(write_start);
+    if (!durable) {
+        std::cerr << db_path << ": write failed; nothing of this import is durable\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Wrote " << imported << " accounts to " << db_path << " (" << rate(imported, write_s) << ")";
+    if (imported < batch) std::cout << "; " << batch - imported << " skipped (fields too long)";
+    std::cout << "\n";
+
+    const double total_s = seconds_since(start);
+    std::cout << "Imported " << imported << " accounts in " << rate(imported, total_s) << " end to end\n";
+    return EXIT_SUCCESS;
+}
+
+int export_users(const std::string& db_path, const std::string& out_path, CredentialStore::Options options)
+{
+    const Clock::time_point start = Clock::now();
+    CredentialStore source(db_path, options);
+    if (!source.load()) {
+        std::cerr << db_path << ": unreadable credential DB\n";
+        return EXIT_FAILURE;
+    }
+    if (!source.export_json(out_path)) {
+        std::cerr << out_path << ": write failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Exported " << source.size() << " accounts to " << out_path << " ("
+              << rate(source.size(), seconds_since(start)) << ")\n";
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) return usage(argv[0]);
+    const std::string command = argv[1];
+
+    CredentialStore::Options options;
+    unsigned threads = 0;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--format" && i + 1 < argc) {
+            const std::string format = argv[++i];
+            if (format != "json" && format != "binary") return usage(argv[0]);
+            options.format = format == "binary" ? CredentialStore::Format::Binary : CredentialStore::Format::Json;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return usage(argv[0]);
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2) return usage(argv[0]);
+
+    if (sodium_init() < 0) {
+        std::cerr << "libsodium initialization failed\n";
+        return EXIT_FAILURE;
+    }
+    if (command == "import") return import_users(paths[0], paths[1], options, threads);
+    if (command == "export") return export_users(paths[0], paths[1], options);
+    return usage(argv[0]);
+}
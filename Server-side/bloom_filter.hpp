@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// ============================================================================
+// BloomFilter — "definitely not present" answers for username lookups.
+//
+// Sized for `capacity` keys at 10 bits per key with 7 probes (~1% false
+// positives). Bit positions come from one seeded 64-bit hash split into
+// two halves (double hashing); the seed is per process, so crafted names
+// can't be aimed at false positives. Bits live in atomic words: add() may
+// run while other threads call maybe_contains() without any lock.
+// Never shrinks or forgets; CredentialStore rebuilds a larger one when the
+// key count outgrows the capacity.
+// ============================================================================
+class BloomFilter {
+public:
+    BloomFilter(size_t capacity, uint64_t seed)
+        : keys(capacity ? capacity : 1), hash_seed(seed)
+    {
+        size_t bits = 64;
+        while (bits < keys * BITS_PER_KEY) bits <<= 1;
+        bit_mask = bits - 1;
+        words.reset(new std::atomic<uint64_t>[bits / 64]()); // Value-initialized: all zero
+    }
+
+    size_t capacity() const noexcept { return keys; }
+
+    void add(std::string_view key) noexcept
+    {
+        uint64_t h1, h2;
+        hashes(key, h1, h2);
+        for (unsigned i = 0; i < PROBES; ++i) {
+            const uint64_t bit = (h1 + i * h2) & bit_mask;
+            words[bit >> 6].fetch_or(uint64_t{1} << (bit & 63), std::memory_order_release);
+        }
+    }
+
+    // False: the key was never add()ed. True: it probably was.
+    bool maybe_contains(std::string_view key) const noexcept
+    {
+        uint64_t h1, h2;
+        hashes(key, h1, h2);
+        for (unsigned i = 0; i < PROBES; ++i) {
+            const uint64_t bit = (h1 + i * h2) & bit_mask;
+            if (!(words[bit >> 6].load(std::memory_order_acquire) & (uint64_t{1} << (bit & 63)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t   BITS_PER_KEY = 10;
+    static constexpr unsigned PROBES       = 7;
+
+    // Seeded FNV-1a, then the splitmix64 finalizer so both halves are well mixed.
+    void hashes(std::string_view key, uint64_t& h1, uint64_t& h2) const noexcept
+    {
+        uint64_t h = 14695981039346656037ull ^ hash_seed;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        h1 = h & 0xffffffffu;
+        h2 = (h >> 32) | 1; // Odd step: the probes never collapse onto one bit
+    }
+
+    size_t keys;
+    uint64_t hash_seed;
+    uint64_t bit_mask{0};
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+};
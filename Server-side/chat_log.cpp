@@ -0,0 +1,662 @@
+#include "chat_log.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr char     MAGIC[8]     = {'T', 'C', 'P', 'C', 'H', 'L', 'O', 'G'};
+constexpr uint32_t VERSION      = 1;
+constexpr size_t   HEADER_SIZE  = 64;        // Segment header; record 0 starts here
+constexpr size_t   PAGE         = 4096;
+constexpr size_t   MIN_SEGMENT  = 1u << 20;  // Room for a few dozen maximum-size messages
+constexpr size_t   QUEUE_LIMIT  = 16u << 20; // Encoded bytes waiting for the writer
+
+struct SegmentHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t first_seq;
+    int64_t  created_ms;
+    char     reserved[32];
+};
+static_assert(sizeof(SegmentHeader) == HEADER_SIZE, "segment header layout changed");
+
+// Starts every .idx file; the entries follow. A file without it (or of
+// another version) is ignored and the index rebuilt by scanning.
+constexpr char     INDEX_MAGIC[8] = {'T', 'C', 'P', 'C', 'H', 'I', 'D', 'X'};
+constexpr uint32_t INDEX_VERSION  = 2; // 2: a channel filter per entry
+
+struct IndexHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t{7}; }
+
+int64_t unix_ms_now()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+std::string segment_name(uint64_t first_seq, const char* ext)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu%s", static_cast<unsigned long long>(first_seq), ext);
+    return name;
+}
+
+// "<20 digits>.log" → first seq.
+bool parse_segment_name(const char* name, uint64_t& first_seq)
+{
+    if (std::strlen(name) != 24 || std::strcmp(name + 20, ".log") != 0) return false;
+    first_seq = 0;
+    for (int i = 0; i < 20; ++i) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        first_seq = first_seq * 10 + static_cast<uint64_t>(name[i] - '0');
+    }
+    return first_seq > 0;
+}
+
+std::string index_path(const std::string& segment_path)
+{
+    return segment_path.substr(0, segment_path.size() - 4) + ".idx";
+}
+
+} // namespace
+
+struct ChatLog::Record {
+    uint32_t size;        // Header + payload, padded to 8
+    uint32_t checksum;    // FNV-1a over the record after this field
+    uint64_t seq;
+    int64_t  unix_ms;
+    uint16_t channel_len;
+    uint16_t author_len;
+    uint32_t text_len;
+    // channel, author, text follow
+
+    const char* payload() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+static uint32_t record_checksum(const char* record, size_t size)
+{
+    uint32_t h = 2166136261u; // FNV-1a 32
+    for (size_t i = 8; i < size; ++i) {
+        h ^= static_cast<unsigned char>(record[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void ChatLog::ChannelFilter::add(std::string_view channel)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a 64
+    for (char ch : channel) {
+        h ^= static_cast<unsigned char>(ch);
+        h *= 1099511628211ull;
+    }
+    for (int shift : {0, 21, 42}) {
+        const unsigned bit = static_cast<unsigned>(h >> shift) & 255;
+        bits[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+}
+
+ChatLog::Segment::~Segment()
+{
+    if (base) munmap(base, mapped);
+    if (fd != -1) ::close(fd);
+}
+
+ChatLog::ChatLog(Options opts)
+    : options(std::move(opts))
+{
+    static_assert(sizeof(Record) == 32, "record header layout changed");
+    options.segment_bytes = std::max(options.segment_bytes, MIN_SEGMENT) & ~(PAGE - 1);
+    if (options.index_bytes < 256) options.index_bytes = 256;
+    if (options.flush_interval_ms < 1) options.flush_interval_ms = 1;
+}
+
+ChatLog::~ChatLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (background.joinable()) background.join(); // Writes the rest of the queue
+}
+
+// ============================================================================
+// Recovery
+// ============================================================================
+
+bool ChatLog::open(std::string& error)
+{
+    if (mkdir(options.directory.c_str(), 0750) == -1 && errno != EEXIST) {
+        error = options.directory + ": " + strerror(errno);
+        return false;
+    }
+    DIR* dir = opendir(options.directory.c_str());
+    if (!dir) {
+        error = options.directory + ": " + strerror(errno);
+        return false;
+    }
+    std::vector<uint64_t> found;
+    while (dirent* entry = readdir(dir)) {
+        uint64_t first_seq;
+        if (parse_segment_name(entry->d_name, first_seq)) found.push_back(first_seq);
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end());
+
+    for (size_t i = 0; i < found.size(); ++i) {
+        const std::string path = options.directory + "/" + segment_name(found[i], ".log");
+        if (!load_segment(path, found[i], i + 1 == found.size(), error)) return false;
+    }
+
+    if (segments.empty() || !segments.back()->active) {
+        const uint64_t first = segments.empty() ? 1 : segments.back()->first_seq; // Replaces an unwritten newest file
+        if (!segments.empty()) segments.pop_back();
+        if (!create_segment(first, error)) return false;
+    }
+
+    const Segment& active = *segments.back();
+    next_seq  = active.last_seq ? active.last_seq + 1 : active.first_seq;
+    unindexed = active.index.empty() ? 0 : active.end - active.index.back().offset;
+    for (const auto& s : segments) last_ms = std::max(last_ms, s->last_ms);
+    while (options.max_segments && segments.size() > options.max_segments) {
+        unlink(segments.front()->path.c_str());
+        unlink(index_path(segments.front()->path).c_str());
+        segments.pop_front();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        opened = true;
+    }
+    background = std::thread([this] { background_loop(); });
+    return true;
+}
+
+// Sealed segments are trusted up to their size and indexed from their
+// .idx file; the newest is scanned record by record, because a crash can
+// leave a torn batch at its end.
+bool ChatLog::load_segment(const std::string& path, uint64_t first_seq, bool newest, std::string& error)
+{
+    auto s       = std::make_unique<Segment>();
+    s->first_seq = first_seq;
+    s->path      = path;
+    s->fd        = ::open(path.c_str(), (newest ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    struct stat st{};
+    if (s->fd == -1 || fstat(s->fd, &st) == -1) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+
+    SegmentHeader header{};
+    const size_t size = static_cast<size_t>(st.st_size);
+    if (size < HEADER_SIZE || pread(s->fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        if (newest) { // Created, but the crash came before its header
+            unlink(path.c_str());
+            segments.push_back(std::move(s)); // Inactive: open() recreates it
+            return true;
+        }
+        error = path + ": not a chat log segment";
+        return false;
+    }
+    if (header.version != VERSION || header.first_seq != first_seq) {
+        error = path + ": unsupported segment version or mismatched name";
+        return false;
+    }
+
+    if (newest) {
+        s->mapped = std::max(size, options.segment_bytes);
+        if (int rc = posix_fallocate(s->fd, 0, static_cast<off_t>(s->mapped))) {
+            error = path + ": " + strerror(rc);
+            return false;
+        }
+    } else {
+        s->mapped = size;
+    }
+    void* base = mmap(nullptr, s->mapped, newest ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, s->fd, 0);
+    if (base == MAP_FAILED) {
+        error = path + ": mmap: " + strerror(errno);
+        return false;
+    }
+    s->base   = static_cast<char*>(base);
+    s->active = newest;
+
+    // Sealed: resume the scan at the last index entry. Newest (or an index
+    // that doesn't fit the segment): scan everything and rebuild the index.
+    bool indexed = false;
+    if (!newest) {
+        const std::string idx = index_path(path);
+        int ifd               = ::open(idx.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat ist{};
+        IndexHeader ih{};
+        if (ifd != -1 && fstat(ifd, &ist) == 0 && static_cast<size_t>(ist.st_size) > sizeof(ih) &&
+            (static_cast<size_t>(ist.st_size) - sizeof(ih)) % sizeof(IndexEntry) == 0 &&
+            pread(ifd, &ih, sizeof(ih), 0) == static_cast<ssize_t>(sizeof(ih)) &&
+            std::memcmp(ih.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && ih.version == INDEX_VERSION &&
+            ih.entry_size == sizeof(IndexEntry)) {
+            s->index.resize((static_cast<size_t>(ist.st_size) - sizeof(ih)) / sizeof(IndexEntry));
+            const ssize_t want = static_cast<ssize_t>(s->index.size() * sizeof(IndexEntry));
+            indexed = pread(ifd, s->index.data(), static_cast<size_t>(want), sizeof(ih)) == want &&
+                      s->index.front().offset == HEADER_SIZE && s->index.back().offset < size;
+        }
+        if (ifd != -1) ::close(ifd);
+    }
+    if (indexed) {
+        const IndexEntry& tail = s->index.back();
+        s->first_ms = s->index.front().unix_ms;
+        s->end      = tail.offset;
+        s->last_seq = tail.seq - 1;
+        scan(*s, tail.offset, tail.seq, size, 0);
+    } else {
+        s->index.clear();
+        s->end = HEADER_SIZE;
+        scan(*s, HEADER_SIZE, first_seq, newest ? s->mapped : size, options.index_bytes);
+    }
+    for (const IndexEntry& e : s->index) s->channels.merge(e.channels);
+
+    if (!newest && s->last_seq == 0) {
+        // Sealed with no record left: nothing to keep.
+        unlink(path.c_str());
+        unlink(index_path(path).c_str());
+        return true;
+    }
+    segments.push_back(std::move(s));
+    return true;
+}
+
+// Extends `s` over the valid records from `from` (whose seq must be
+// `seq`) up to `limit`; stops at the first torn or foreign record.
+// index_bytes > 0 adds sparse index entries on the way; either way each
+// record's channel goes into the filter of the block it lands in.
+void ChatLog::scan(Segment& s, size_t from, uint64_t seq, size_t limit, size_t index_bytes)
+{
+    size_t since_entry = 0;
+    for (size_t off = from; off + sizeof(Record) <= limit;) {
+        Record r;
+        std::memcpy(&r, s.base + off, sizeof(r));
+        if (r.size < sizeof(Record) || r.size % 8 != 0 || r.size > limit - off || r.seq != seq ||
+            sizeof(Record) + r.channel_len + r.author_len + size_t{r.text_len} > r.size ||
+            record_checksum(s.base + off, r.size) != r.checksum) {
+            break;
+        }
+        if (index_bytes && (s.index.empty() || since_entry >= index_bytes)) {
+            s.index.push_back({r.seq, r.unix_ms, off});
+            since_entry = 0;
+        }
+        if (!s.index.empty()) s.index.back().channels.add(std::string_view(s.base + off + sizeof(Record), r.channel_len));
+        if (s.last_seq == 0) s.first_ms = r.unix_ms;
+        s.last_seq = r.seq;
+        s.last_ms  = r.unix_ms;
+        since_entry += r.size;
+        off += r.size;
+        s.end = off;
+        ++seq;
+    }
+}
+
+// A new, preallocated active segment whose first record will be `first_seq`.
+bool ChatLog::create_segment(uint64_t first_seq, std::string& error)
+{
+    auto s       = std::make_unique<Segment>();
+    s->first_seq = first_seq;
+    s->path      = options.directory + "/" + segment_name(first_seq, ".log");
+    s->fd        = ::open(s->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (s->fd == -1) {
+        error = s->path + ": " + strerror(errno);
+        return false;
+    }
+    if (int rc = posix_fallocate(s->fd, 0, static_cast<off_t>(options.segment_bytes))) {
+        error = s->path + ": " + strerror(rc);
+        unlink(s->path.c_str());
+        return false;
+    }
+    s->mapped = options.segment_bytes;
+    void* base = mmap(nullptr, s->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (base == MAP_FAILED) {
+        error = s->path + ": mmap: " + strerror(errno);
+        unlink(s->path.c_str());
+        return false;
+    }
+    s->base   = static_cast<char*>(base);
+    s->active = true;
+    s->end    = HEADER_SIZE;
+
+    SegmentHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.header_size = HEADER_SIZE;
+    header.first_seq   = first_seq;
+    header.created_ms  = unix_ms_now();
+    std::memcpy(s->base, &header, sizeof(header));
+    msync(s->base, PAGE, MS_SYNC);
+
+    // The new name must survive a crash too.
+    int dfd = ::open(options.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd != -1) {
+        fsync(dfd);
+        ::close(dfd);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(segments_mtx);
+    segments.push_back(std::move(s));
+    return true;
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+bool ChatLog::append(std::string_view channel, std::string_view author, std::string_view text)
+{
+    if (channel.size() > UINT16_MAX || author.size() > UINT16_MAX || text.size() > QUEUE_LIMIT) return false;
+
+    Record r{};
+    r.size        = static_cast<uint32_t>(align8(sizeof(Record) + channel.size() + author.size() + text.size()));
+    r.unix_ms     = unix_ms_now();
+    r.channel_len = static_cast<uint16_t>(channel.size());
+    r.author_len  = static_cast<uint16_t>(author.size());
+    r.text_len    = static_cast<uint32_t>(text.size());
+    static constexpr char PADDING[8] = {};
+
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    if (!opened || stopping || queue.size() + r.size > QUEUE_LIMIT) return false;
+    queue.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    queue.append(channel.data(), channel.size());
+    queue.append(author.data(), author.size());
+    queue.append(text.data(), text.size());
+    queue.append(PADDING, r.size - (sizeof(Record) + channel.size() + author.size() + text.size()));
+    return true;
+}
+
+void ChatLog::flush()
+{
+    std::lock_guard<std::mutex> writer(write_mtx);
+    std::string batch;
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        batch.swap(queue);
+    }
+    if (!batch.empty()) write_batch(batch);
+}
+
+// The queue is taken under write_mtx, so batches reach the segment in the
+// order they were queued.
+void ChatLog::background_loop()
+{
+    std::string batch;
+    while (true) {
+        bool done;
+        {
+            std::unique_lock<std::mutex> lock(queue_mtx);
+            wake.wait_for(lock, std::chrono::milliseconds(options.flush_interval_ms), [this] { return stopping; });
+        }
+        std::lock_guard<std::mutex> writer(write_mtx);
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            batch.swap(queue);
+            done = stopping;
+        }
+        if (!batch.empty()) write_batch(batch);
+        batch.clear(); // Keeps its capacity for the next swap
+        if (done) return;
+    }
+}
+
+// Copies records into the mapping past the published end, syncs them and
+// only then publishes, so a reader sees whole, durable records. Seq,
+// timestamp and checksum are filled in here, off the event loops.
+void ChatLog::write_batch(const std::string& batch)
+{
+    if (broken && !rotate()) return; // Still no segment to write to: dropped
+
+    Segment* s       = segments.back().get(); // Only this thread changes the deque
+    size_t end       = s->end;
+    int64_t first_ms = -1;                    // Of the first record this batch put in `s`
+    std::vector<IndexEntry> added;
+    ChannelFilter tail;                       // Channels added to the published last block
+
+    auto publish = [&] {
+        if (end == s->end) return;
+        const size_t from = s->end & ~(PAGE - 1);
+        msync(s->base + from, end - from, MS_SYNC);
+        std::unique_lock<std::shared_mutex> lock(segments_mtx);
+        if (s->last_seq == 0) s->first_ms = first_ms;
+        s->end      = end;
+        s->last_seq = next_seq - 1;
+        s->last_ms  = last_ms;
+        if (!s->index.empty()) s->index.back().channels.merge(tail);
+        s->channels.merge(tail);
+        for (const IndexEntry& e : added) s->channels.merge(e.channels);
+        s->index.insert(s->index.end(), added.begin(), added.end());
+        tail = {};
+    };
+
+    for (size_t off = 0; off < batch.size();) {
+        Record in;
+        std::memcpy(&in, batch.data() + off, sizeof(in));
+        if (in.size > options.segment_bytes - HEADER_SIZE) { // Can't fit any segment
+            off += in.size;
+            continue;
+        }
+        if (end + in.size > s->mapped) {
+            publish();
+            if (!rotate()) {
+                std::cerr << "Chat log: dropped " << (batch.size() - off) << " bytes of messages" << std::endl;
+                return;
+            }
+            s        = segments.back().get();
+            end      = s->end;
+            first_ms = -1;
+            added.clear();
+        }
+
+        char* out = s->base + end;
+        std::memcpy(out, batch.data() + off, in.size);
+        in.seq     = next_seq++;
+        in.unix_ms = std::max(in.unix_ms, last_ms); // The index needs non-decreasing times
+        last_ms    = in.unix_ms;
+        std::memcpy(out, &in, sizeof(in));
+        in.checksum = record_checksum(out, in.size);
+        std::memcpy(out, &in, sizeof(in));
+
+        if (first_ms < 0) first_ms = in.unix_ms;
+        if ((s->index.empty() && added.empty()) || unindexed >= options.index_bytes) {
+            added.push_back({in.seq, in.unix_ms, end});
+            unindexed = 0;
+        }
+        (added.empty() ? tail : added.back().channels).add(std::string_view(out + sizeof(Record), in.channel_len));
+        unindexed += in.size;
+        end += in.size;
+        off += in.size;
+    }
+    publish();
+}
+
+// Seals the active segment (if any is left) and starts the next one, then
+// drops the oldest past max_segments. On failure the log is `broken`
+// until a later batch manages to create a segment.
+bool ChatLog::rotate()
+{
+    if (!segments.empty() && segments.back()->active) seal(*segments.back());
+
+    std::string error;
+    if (!create_segment(next_seq, error)) {
+        if (!broken) std::cerr << "Chat log: " << error << std::endl;
+        broken = true;
+        return false;
+    }
+    broken    = false;
+    unindexed = 0;
+
+    while (options.max_segments && segments.size() > options.max_segments) {
+        std::unique_ptr<Segment> oldest;
+        {
+            std::unique_lock<std::shared_mutex> lock(segments_mtx);
+            oldest = std::move(segments.front());
+            segments.pop_front();
+        }
+        unlink(oldest->path.c_str());
+        unlink(index_path(oldest->path).c_str());
+    }
+    return true;
+}
+
+// Trims the file to its records (readers never look past `end`, so the
+// mapping may stay longer) and writes the index next to it.
+void ChatLog::seal(Segment& s)
+{
+    if (ftruncate(s.fd, static_cast<off_t>(s.end)) == -1) {
+        std::cerr << "Chat log: truncating " << s.path << ": " << strerror(errno) << std::endl;
+    }
+    fdatasync(s.fd);
+    s.active = false;
+
+    const std::string idx = index_path(s.path);
+    const std::string tmp = idx + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1) return; // Rebuilt by a scan on the next start
+    IndexHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version     = INDEX_VERSION;
+    header.entry_size  = sizeof(IndexEntry);
+    const size_t bytes = s.index.size() * sizeof(IndexEntry);
+    const bool ok = write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+                    write(fd, s.index.data(), bytes) == static_cast<ssize_t>(bytes) && fdatasync(fd) == 0;
+    ::close(fd);
+    if (!ok || rename(tmp.c_str(), idx.c_str()) == -1) unlink(tmp.c_str());
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+const ChatLog::Record* ChatLog::record_at(const Segment& s, size_t offset)
+{
+    if (offset + sizeof(Record) > s.end) return nullptr;
+    const auto* r = reinterpret_cast<const Record*>(s.base + offset);
+    if (r->size < sizeof(Record) || r->size > s.end - offset) return nullptr;
+    return r;
+}
+
+ChatLog::Message ChatLog::view(const Record& r)
+{
+    const char* p = r.payload();
+    return {r.seq, r.unix_ms,
+            std::string_view(p, r.channel_len),
+            std::string_view(p + r.channel_len, r.author_len),
+            std::string_view(p + r.channel_len + r.author_len, r.text_len)};
+}
+
+static bool in_channel(const ChatLog::Message& m, std::string_view channel)
+{
+    return m.channel == channel;
+}
+
+// Index blocks newest first, skipping those (and whole segments) whose
+// filter rules the channel out; inside a block the records are walked
+// forward and its matches taken from the back.
+size_t ChatLog::last(std::string_view channel, size_t n, const Visitor& fn) const
+{
+    ChannelFilter probe;
+    probe.add(channel);
+    std::shared_lock<std::shared_mutex> lock(segments_mtx);
+    std::vector<const Record*> hits; // Newest first
+    std::vector<const Record*> block;
+    size_t budget = options.max_scan_bytes;
+
+    for (auto seg = segments.rbegin(); seg != segments.rend() && hits.size() < n && budget; ++seg) {
+        const Segment& s = **seg;
+        if (!s.channels.covers(probe)) continue;
+        for (size_t b = s.index.size(); b-- > 0 && hits.size() < n && budget;) {
+            if (!s.index[b].channels.covers(probe)) continue;
+            const size_t stop = b + 1 < s.index.size() ? s.index[b + 1].offset : s.end;
+            block.clear();
+            for (size_t off = s.index[b].offset; off < stop;) {
+                const Record* r = record_at(s, off);
+                if (!r) break;
+                if (in_channel(view(*r), channel)) block.push_back(r);
+                off += r->size;
+            }
+            budget -= std::min(budget, stop - s.index[b].offset);
+            for (auto it = block.rbegin(); it != block.rend() && hits.size() < n; ++it) hits.push_back(*it);
+        }
+    }
+
+    for (auto it = hits.rbegin(); it != hits.rend(); ++it) fn(view(**it));
+    return hits.size();
+}
+
+// Times never decrease along the log, so the first block that can hold a
+// match is the one before the first index entry at or past `unix_ms`.
+// From there the blocks are taken in order, skipping those whose filter
+// rules the channel out.
+size_t ChatLog::since(std::string_view channel, int64_t unix_ms, size_t max, const Visitor& fn) const
+{
+    ChannelFilter probe;
+    probe.add(channel);
+    std::shared_lock<std::shared_mutex> lock(segments_mtx);
+    size_t count = 0;
+    size_t budget = options.max_scan_bytes;
+
+    for (const auto& seg : segments) {
+        const Segment& s = *seg;
+        if (s.last_seq == 0 || s.last_ms < unix_ms || s.index.empty() || !s.channels.covers(probe)) continue;
+
+        auto first = std::lower_bound(s.index.begin(), s.index.end(), unix_ms,
+                                      [](const IndexEntry& e, int64_t ms) { return e.unix_ms < ms; });
+        if (first != s.index.begin()) --first;
+
+        for (size_t b = static_cast<size_t>(first - s.index.begin()); b < s.index.size() && count < max && budget; ++b) {
+            if (!s.index[b].channels.covers(probe)) continue;
+            const size_t stop = b + 1 < s.index.size() ? s.index[b + 1].offset : s.end;
+            size_t off = s.index[b].offset;
+            while (off < stop && count < max) {
+                const Record* r = record_at(s, off);
+                if (!r) break;
+                const Message m = view(*r);
+                if (m.unix_ms >= unix_ms && in_channel(m, channel)) {
+                    fn(m);
+                    ++count;
+                }
+                off += r->size;
+            }
+            budget -= std::min(budget, off - s.index[b].offset);
+        }
+        if (count == max || !budget) break;
+    }
+    return count;
+}
+
+uint64_t ChatLog::messages() const
+{
+    std::shared_lock<std::shared_mutex> lock(segments_mtx);
+    uint64_t total = 0;
+    for (const auto& s : segments) {
+        if (s->last_seq) total += s->last_seq - s->first_seq + 1;
+    }
+    return total;
+}
+
+size_t ChatLog::segment_count() const
+{
+    std::shared_lock<std::shared_mutex> lock(segments_mtx);
+    return segments.size();
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// ChatLog — durable chat history ([HISTORY] log_dir), queried by /history.
+//
+// Every broadcast is appended to a segment file in the log directory:
+//
+//   <first_seq>.log   64-byte header, then records, each 8-byte aligned:
+//                     size, checksum (FNV-1a), seq, unix ms, channel,
+//                     author, text
+//   <first_seq>.idx   sparse index: (seq, unix ms, offset) of the first
+//                     record at or past every `index_bytes` of the segment,
+//                     and a Bloom filter of the channels in that block
+//
+// Segments are preallocated to `segment_bytes` and mmap'd; the newest one
+// is written through its mapping, older ones are read-only maps trimmed
+// to their records. Queries read the records in place: /history <n> walks
+// the index blocks from the end, /history since <time> binary-searches
+// them by timestamp. Blocks (and whole segments) whose filter rules the
+// channel out are skipped unread, and one query reads at most
+// `max_scan_bytes` of records, so a quiet channel costs index lookups,
+// not a pass over the log.
+//
+// append() only copies the record into a queue. A background thread moves
+// the queue into the segment every `flush_interval_ms`, msync()s it and
+// then publishes the new end and index entries, so readers never see a
+// partial record. A full segment is sealed (trimmed, its index written)
+// and a new one started; past `max_segments` the oldest is deleted.
+// After a crash, open() keeps the valid prefix of the newest segment.
+//
+// Thread-safe: reactors append and query concurrently; one process owns
+// the directory at a time (a hot upgrade hands it over after flush()).
+// ============================================================================
+class ChatLog {
+public:
+    struct Options {
+        std::string directory;
+        size_t segment_bytes{16u << 20}; // Segment file size
+        size_t max_segments{32};         // Oldest deleted past this (0 = keep all)
+        size_t index_bytes{4096};        // Log bytes per sparse index entry
+        int flush_interval_ms{50};       // Max time an appended message waits for disk
+        size_t max_scan_bytes{4u << 20}; // Record bytes one query may read
+    };
+
+    // One logged message, as stored. The views point into the mapping and
+    // are valid only inside the query callback.
+    struct Message {
+        uint64_t seq;
+        int64_t unix_ms;
+        std::string_view channel;
+        std::string_view author;
+        std::string_view text;
+    };
+    using Visitor = std::function<void(const Message&)>;
+
+    explicit ChatLog(Options opts);
+
+    // Writes what is queued and stops the background thread.
+    ~ChatLog();
+
+    ChatLog(const ChatLog&) = delete;
+    ChatLog& operator=(const ChatLog&) = delete;
+
+    // Creates the directory if needed, recovers the segments and starts
+    // the writer. False (with a reason in `error`) if the log can't be used.
+    bool open(std::string& error);
+
+    // Queues one message with the current time. False if the queue is full
+    // (the disk can't keep up) or the log isn't open; the message is then
+    // not logged.
+    bool append(std::string_view channel, std::string_view author, std::string_view text);
+
+    // Writes and syncs everything queued so far before returning.
+    void flush();
+
+    // Calls fn for the last `n` messages of `channel`, oldest first.
+    // Returns how many there were. Older messages are not searched once
+    // `max_scan_bytes` of records have been read.
+    size_t last(std::string_view channel, size_t n, const Visitor& fn) const;
+
+    // Calls fn for up to `max` messages of `channel` sent at or after
+    // `unix_ms`, oldest first. Returns how many there were. Stops early
+    // once `max_scan_bytes` of records have been read.
+    size_t since(std::string_view channel, int64_t unix_ms, size_t max, const Visitor& fn) const;
+
+    const std::string& directory() const { return options.directory; }
+
+    // Messages on disk (across every segment) and segment count.
+    uint64_t messages() const;
+    size_t segment_count() const;
+
+private:
+    struct Record;
+
+    // The channels a run of records may hold: a 256-bit Bloom filter, three
+    // bits per name. It has no false negatives, so a run whose filter
+    // doesn't cover a channel's probe holds none of its messages.
+    struct ChannelFilter {
+        uint64_t bits[4]{};
+
+        void add(std::string_view channel);
+        void merge(const ChannelFilter& other)
+        {
+            for (size_t i = 0; i < 4; ++i) bits[i] |= other.bits[i];
+        }
+        // `probe` is a filter holding just the channel looked for.
+        bool covers(const ChannelFilter& probe) const
+        {
+            for (size_t i = 0; i < 4; ++i) {
+                if ((bits[i] & probe.bits[i]) != probe.bits[i]) return false;
+            }
+            return true;
+        }
+    };
+
+    struct IndexEntry {
+        uint64_t seq;
+        int64_t unix_ms;
+        uint64_t offset;
+        ChannelFilter channels{};     // Of the records up to the next entry
+    };
+    struct Segment {
+        uint64_t first_seq{0};
+        std::string path;               // <dir>/<first_seq>.log
+        int fd{-1};
+        char* base{nullptr};
+        size_t mapped{0};               // Mapping length (capacity if active)
+        bool active{false};             // Written through the mapping
+        // Published under `segments_mtx`; readers look only below `end`.
+        size_t end{0};
+        uint64_t last_seq{0};           // 0: no record yet
+        int64_t first_ms{0};
+        int64_t last_ms{0};
+        std::vector<IndexEntry> index;
+        ChannelFilter channels{};       // Every block's filter merged
+        ~Segment();
+    };
+
+    // open() helpers.
+    bool load_segment(const std::string& path, uint64_t first_seq, bool newest, std::string& error);
+    bool create_segment(uint64_t first_seq, std::string& error);
+    static void scan(Segment& s, size_t from, uint64_t seq, size_t limit, size_t index_bytes);
+
+    // Writer side: moves `batch` into the active segment (serialized by write_mtx).
+    void write_batch(const std::string& batch);
+    bool rotate();
+    void seal(Segment& s);
+    void background_loop();
+
+    // Reader side: the record at `offset` of `s`, or null past its end.
+    static const Record* record_at(const Segment& s, size_t offset);
+    static Message view(const Record& r);
+
+    Options options;
+
+    mutable std::shared_mutex segments_mtx; // Readers shared; publish / rotate exclusive
+    std::deque<std::unique_ptr<Segment>> segments; // Oldest first; the last one is active
+
+    std::mutex write_mtx;                   // One writer: background thread or flush()
+    uint64_t next_seq{1};                   // Writer: seq of the next record written
+    int64_t last_ms{0};                     // Writer: keeps timestamps non-decreasing
+    size_t unindexed{0};                    // Writer: bytes since the last index entry
+    bool broken{false};                     // Writer: segment I/O failed; appends dropped
+
+    std::mutex queue_mtx;                   // Guards queue, stopping, opened
+    std::condition_variable wake;
+    std::string queue;                      // Encoded records waiting for the writer
+    bool stopping{false};
+    bool opened{false};
+    std::thread background;
+};
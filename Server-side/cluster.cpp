@@ -0,0 +1,951 @@
+#include "cluster.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "chat_log.hpp"
+#include "server-header.hpp" // TcpServer::encode_chat
+#include "common/Logger/logger.hpp"
+
+namespace {
+
+constexpr uint32_t PROTOCOL_VERSION   = 1;
+constexpr size_t   FRAME_HEADER       = 5;         // u32 length (type + payload), u8 type
+constexpr size_t   MAX_FRAME          = 16u << 20; // Larger frames end the link
+constexpr size_t   RELAY_FRAME_BYTES  = 1u << 20;  // Batches are split past this
+constexpr size_t   OUTBOX_LIMIT       = 32u << 20; // Unacked relay bytes kept for resends
+constexpr size_t   LINK_BUFFER_LIMIT  = 64u << 20; // Unsent bytes before a peer counts as stuck
+constexpr uint64_t REDIAL_MS          = 1000;
+constexpr uint64_t HANDSHAKE_MS       = 5000;
+constexpr int      TICK_MS            = 250;
+constexpr size_t   NONCE_BYTES        = 32;
+
+enum FrameType : uint8_t {
+    Hello    = 1, // u32 version, u32 node id, u64 epoch, nonce
+    Auth     = 2, // crypto_auth(peer nonce | own id | own epoch)
+    Relay    = 3, // u32 count, then per message: u64 seq, u16 channel, u16 author, u32 text, bytes
+    Ack      = 4, // u64 highest seq delivered
+    Presence = 5  // u32 count, then per entry: u8 op, u8 length, name
+};
+enum PresenceOp : uint8_t { Offline = 0, Online = 1, Reset = 2 };
+
+uint64_t now_ms()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+void put_u8(std::string& out, uint8_t v) { out.push_back(static_cast<char>(v)); }
+void put_u16(std::string& out, uint16_t v) { out.append(reinterpret_cast<const char*>(&v), 2); }
+void put_u32(std::string& out, uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); }
+void put_u64(std::string& out, uint64_t v) { out.append(reinterpret_cast<const char*>(&v), 8); }
+
+// Bounds-checked little-endian reader over one frame payload.
+struct Reader {
+    std::string_view in;
+    bool ok{true};
+
+    template <typename T>
+    T get()
+    {
+        T v{};
+        if (in.size() < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        std::memcpy(&v, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return v;
+    }
+
+    std::string_view bytes(size_t n)
+    {
+        if (in.size() < n) {
+            ok = false;
+            return {};
+        }
+        std::string_view v = in.substr(0, n);
+        in.remove_prefix(n);
+        return v;
+    }
+};
+
+} // namespace
+
+struct Cluster::Link {
+    int fd{-1};
+    uint32_t peer_id{0};        // Expected (outbound) or announced in HELLO
+    bool outbound{false};
+    bool connecting{false};     // Non-blocking connect() still running
+    bool hello_seen{false};
+    bool authed{false};         // Past the handshake: relays and presence flow
+    bool dead{false};           // Closed at the end of the loop round
+    bool writing{false};        // EPOLLOUT armed
+    const char* why{""};        // Reason for `dead`
+    uint64_t opened_ms{0};
+    uint64_t peer_epoch{0};
+    unsigned char nonce[NONCE_BYTES]{};
+    unsigned char peer_nonce[NONCE_BYTES]{};
+    std::string in;
+    std::string out;
+};
+
+struct Cluster::PeerState {
+    Peer cfg;
+    int link_fd{-1};            // The authenticated link, if up
+    int dialing_fd{-1};         // Outbound link not authenticated yet
+    uint64_t next_dial_ms{0};
+    uint64_t sent{0};           // Our highest seq written to the link
+    uint64_t acked{0};          // Our highest seq it acknowledged
+    uint64_t known_epoch{0};    // Its epoch last time: same → flap, other → restart
+    uint64_t recv_epoch{0};     // De-duplication of its relays
+    uint64_t recv_high{0};
+};
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+bool Cluster::parse_endpoint(const std::string& text, std::string& host, uint16_t& port)
+{
+    const size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) return false;
+    unsigned long value = 0;
+    for (size_t i = colon + 1; i < text.size(); ++i) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        value = value * 10 + static_cast<unsigned long>(text[i] - '0');
+        if (value > 65535) return false;
+    }
+    if (value == 0) return false;
+    host = text.substr(0, colon);
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+bool Cluster::parse_peers(const std::string& text, std::vector<Peer>& out, std::string& error)
+{
+    out.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        std::string item = text.substr(start, comma - start);
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        start = comma + 1;
+        if (item.empty()) continue;
+
+        Peer p;
+        const size_t at = item.find('@');
+        unsigned long id = 0;
+        bool valid = at != std::string::npos && at > 0 && at <= 9;
+        for (size_t i = 0; valid && i < at; ++i) {
+            valid = item[i] >= '0' && item[i] <= '9';
+            id = id * 10 + static_cast<unsigned long>(item[i] - '0');
+        }
+        if (!valid || id == 0 || id > UINT32_MAX || !parse_endpoint(item.substr(at + 1), p.host, p.port)) {
+            error = "bad peer '" + item + "' (expected <id>@<host>:<port>)";
+            return false;
+        }
+        p.id = static_cast<uint32_t>(id);
+        for (const Peer& other : out) {
+            if (other.id == p.id) {
+                error = "node " + std::to_string(p.id) + " listed twice";
+                return false;
+            }
+        }
+        out.push_back(std::move(p));
+    }
+    return true;
+}
+
+// ============================================================================
+// Lifecycle
+// ============================================================================
+
+Cluster::Cluster(Options opts, Logger* _logger, ChatLog* _chat_log)
+    : options(std::move(opts)), logger(_logger), chat_log(_chat_log)
+{
+    randombytes_buf(&epoch, sizeof(epoch));
+    crypto_generichash(key, sizeof(key), reinterpret_cast<const unsigned char*>(options.secret.data()),
+                       options.secret.size(), nullptr, 0);
+    for (const Peer& p : options.peers) {
+        if (p.id == options.node_id) continue;
+        auto state = std::make_unique<PeerState>();
+        state->cfg = p;
+        peer_states.push_back(std::move(state));
+    }
+}
+
+Cluster::~Cluster()
+{
+    stop();
+    sodium_memzero(key, sizeof(key));
+}
+
+void Cluster::start()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd == -1 || wake_fd == -1) {
+        throw std::runtime_error(std::string("cluster event loop: ") + strerror(errno));
+    }
+    watch(wake_fd, EPOLLIN);
+    running.store(true);
+    worker = std::thread([this] { run(); });
+}
+
+void Cluster::stop()
+{
+    if (!worker.joinable()) return;
+    running.store(false);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    worker.join();
+
+    for (auto& [fd, link] : links) ::close(fd);
+    links.clear();
+    if (listen_fd != -1) ::close(listen_fd);
+    ::close(wake_fd);
+    ::close(epoll_fd);
+    listen_fd = wake_fd = epoll_fd = -1;
+}
+
+void Cluster::add_reactor(Mailbox* reactor)
+{
+    std::lock_guard<std::mutex> lock(reactors_mtx);
+    reactors.push_back(reactor);
+}
+
+// ============================================================================
+// Reactor side
+// ============================================================================
+
+// Only the push that finds the queue empty pays for the eventfd write.
+void Cluster::relay(const std::string& channel, std::string_view author, std::string_view text)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(request_mtx);
+        wake = requests.empty();
+        requests.push_back({Request::Relay, channel, std::string(author), std::string(text), {}});
+    }
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void Cluster::presence(const std::string& name, bool online)
+{
+    {
+        std::lock_guard<std::mutex> lock(local_mtx);
+        if (online) {
+            ++local_online[name];
+        } else {
+            auto it = local_online.find(name);
+            if (it != local_online.end() && --it->second == 0) local_online.erase(it);
+        }
+    }
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(request_mtx);
+        wake = requests.empty();
+        requests.push_back({online ? Request::Online : Request::Offline, {}, name, {}, {}});
+    }
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+bool Cluster::online_elsewhere(const std::string& name) const
+{
+    std::shared_lock<std::shared_mutex> lock(remote_mtx);
+    return remote_online.count(name) > 0;
+}
+
+void Cluster::set_peers(std::vector<Peer> peers)
+{
+    {
+        std::lock_guard<std::mutex> lock(request_mtx);
+        requests.push_back({Request::Peers, {}, {}, {}, std::move(peers)});
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// ============================================================================
+// Link thread
+// ============================================================================
+
+void Cluster::watch(int fd, uint32_t events)
+{
+    epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1 && errno == ENOENT) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+Cluster::PeerState* Cluster::peer(uint32_t id)
+{
+    for (auto& p : peer_states) {
+        if (p->cfg.id == id) return p.get();
+    }
+    return nullptr;
+}
+
+void Cluster::run()
+{
+    epoll_event events[64];
+    while (running.load()) {
+        tick(now_ms());
+        int n = epoll_wait(epoll_fd, events, 64, TICK_MS);
+        if (n == -1 && errno != EINTR) {
+            if (logger) logger->Write_log("Cluster: epoll_wait failed: " + std::string(strerror(errno)), Logger::Error);
+            return;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wake_fd) {
+                uint64_t count;
+                ssize_t ignored = read(wake_fd, &count, sizeof(count));
+                (void)ignored;
+                continue;
+            }
+            if (fd == listen_fd) {
+                accept_links();
+                continue;
+            }
+            auto it = links.find(fd);
+            if (it == links.end() || it->second->dead) continue;
+            Link& link = *it->second;
+            if (events[i].events & EPOLLOUT) on_writable(link);
+            if (!link.dead && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) on_readable(link);
+        }
+
+        drain_requests();
+        send_relays();
+
+        // Closed links go only here, so no handler ever holds a dangling one.
+        for (auto it = links.begin(); it != links.end();) {
+            Link& link = *it->second;
+            if (!link.dead) {
+                ++it;
+                continue;
+            }
+            PeerState* p = link.peer_id ? peer(link.peer_id) : nullptr;
+            if (p && p->link_fd == link.fd) {
+                p->link_fd = -1;
+                forget_node(link.peer_id);
+                if (logger) {
+                    logger->Write_log("Cluster: link to node " + std::to_string(link.peer_id) + " down (" +
+                                      link.why + ")", Logger::Warn);
+                }
+            }
+            if (p && p->dialing_fd == link.fd) p->dialing_fd = -1;
+            if (p && link.outbound) p->next_dial_ms = now_ms() + REDIAL_MS;
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, link.fd, nullptr);
+            ::close(link.fd);
+            it = links.erase(it);
+        }
+    }
+}
+
+// Periodic work: (re)bind, dial, handshake timeouts, outbox trimming.
+void Cluster::tick(uint64_t now)
+{
+    if (listen_fd == -1 && now >= next_listen_ms && !try_listen()) next_listen_ms = now + REDIAL_MS;
+
+    for (auto& p : peer_states) {
+        // The lower id dials; the higher one only accepts.
+        if (p->cfg.id > options.node_id && p->link_fd == -1 && p->dialing_fd == -1 && now >= p->next_dial_ms) {
+            dial(*p, now);
+        }
+    }
+    for (auto& [fd, link] : links) {
+        if (!link->authed && now - link->opened_ms > HANDSHAKE_MS) close_link(fd, "handshake timeout");
+    }
+
+    // Everything every known peer has acknowledged, and whatever is past the cap.
+    uint64_t floor = next_seq - 1;
+    for (auto& p : peer_states) {
+        if (p->known_epoch) floor = std::min(floor, p->acked);
+    }
+    while (!outbox.empty() && (outbox.front().seq <= floor || outbox_bytes > OUTBOX_LIMIT)) {
+        outbox_bytes -= outbox.front().entry.size();
+        outbox.pop_front();
+    }
+}
+
+bool Cluster::try_listen()
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(options.listen_port);
+    if (inet_pton(AF_INET, options.listen_host.c_str(), &addr.sin_addr) != 1) {
+        if (logger) logger->Write_log("Cluster: listen address " + options.listen_host + " is not an IPv4 address",
+                                      Logger::Error);
+        next_listen_ms = UINT64_MAX; // Not worth retrying
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (fd == -1 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(fd, 64) == -1) {
+        // EADDRINUSE right after a hot upgrade: the predecessor lets go shortly.
+        if (fd != -1) ::close(fd);
+        return false;
+    }
+    listen_fd = fd;
+    watch(listen_fd, EPOLLIN);
+    if (logger) {
+        logger->Write_log("Cluster: node " + std::to_string(options.node_id) + " accepting peers on " +
+                          options.listen_host + ":" + std::to_string(options.listen_port), Logger::Info);
+    }
+    return true;
+}
+
+void Cluster::accept_links()
+{
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) return;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        auto link       = std::make_unique<Link>();
+        link->fd        = fd;
+        link->opened_ms = now_ms();
+        randombytes_buf(link->nonce, sizeof(link->nonce));
+        Link& ref = *link;
+        links[fd] = std::move(link);
+        watch(fd, EPOLLIN);
+
+        std::string hello;
+        put_u32(hello, PROTOCOL_VERSION);
+        put_u32(hello, options.node_id);
+        put_u64(hello, epoch);
+        hello.append(reinterpret_cast<const char*>(ref.nonce), NONCE_BYTES);
+        send_frame(ref, Hello, hello);
+    }
+}
+
+void Cluster::dial(PeerState& p, uint64_t now)
+{
+    p.next_dial_ms = now + REDIAL_MS;
+
+    addrinfo hints{};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found   = nullptr;
+    if (getaddrinfo(p.cfg.host.c_str(), std::to_string(p.cfg.port).c_str(), &hints, &found) != 0 || !found) return;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    const bool started = fd != -1 && (connect(fd, found->ai_addr, found->ai_addrlen) == 0 || errno == EINPROGRESS);
+    freeaddrinfo(found);
+    if (!started) {
+        if (fd != -1) ::close(fd);
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    auto link        = std::make_unique<Link>();
+    link->fd         = fd;
+    link->peer_id    = p.cfg.id;
+    link->outbound   = true;
+    link->connecting = true;
+    link->opened_ms  = now;
+    randombytes_buf(link->nonce, sizeof(link->nonce));
+    links[fd]    = std::move(link);
+    p.dialing_fd = fd;
+    watch(fd, EPOLLIN | EPOLLOUT);
+}
+
+void Cluster::close_link(int fd, const char* why)
+{
+    auto it = links.find(fd);
+    if (it == links.end() || it->second->dead) return;
+    it->second->dead = true;
+    it->second->why  = why;
+}
+
+void Cluster::on_writable(Link& link)
+{
+    if (link.connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(link.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            close_link(link.fd, "connect failed");
+            return;
+        }
+        link.connecting = false;
+        std::string hello;
+        put_u32(hello, PROTOCOL_VERSION);
+        put_u32(hello, options.node_id);
+        put_u64(hello, epoch);
+        hello.append(reinterpret_cast<const char*>(link.nonce), NONCE_BYTES);
+        send_frame(link, Hello, hello);
+        return;
+    }
+    flush_link(link);
+}
+
+void Cluster::on_readable(Link& link)
+{
+    if (link.connecting) return; // EPOLLERR on a failed connect: on_writable reports it
+
+    char buf[65536];
+    while (true) {
+        ssize_t n = recv(link.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            link.in.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) {
+            close_link(link.fd, "closed by peer");
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close_link(link.fd, "receive error");
+        return;
+    }
+
+    size_t used = 0;
+    while (link.in.size() - used >= FRAME_HEADER) {
+        uint32_t length;
+        std::memcpy(&length, link.in.data() + used, 4);
+        if (length == 0 || length > MAX_FRAME) {
+            close_link(link.fd, "bad frame");
+            return;
+        }
+        if (link.in.size() - used < 4 + size_t{length}) break;
+        const uint8_t type = static_cast<uint8_t>(link.in[used + 4]);
+        std::string_view payload(link.in.data() + used + FRAME_HEADER, length - 1);
+        if (!handle_frame(link, type, payload)) {
+            close_link(link.fd, "protocol error");
+            return;
+        }
+        used += 4 + length;
+    }
+    link.in.erase(0, used);
+}
+
+// Returns false to drop the link.
+bool Cluster::handle_frame(Link& link, uint8_t type, std::string_view payload)
+{
+    Reader r{payload};
+
+    if (type == Hello) {
+        const uint32_t version = r.get<uint32_t>();
+        const uint32_t id      = r.get<uint32_t>();
+        const uint64_t remote  = r.get<uint64_t>();
+        std::string_view nonce = r.bytes(NONCE_BYTES);
+        if (!r.ok || link.hello_seen || version != PROTOCOL_VERSION || id == options.node_id || !peer(id) ||
+            (link.outbound && id != link.peer_id)) {
+            return false;
+        }
+        link.hello_seen = true;
+        link.peer_id    = id;
+        link.peer_epoch = remote;
+        std::memcpy(link.peer_nonce, nonce.data(), NONCE_BYTES);
+
+        if (options.secret.empty()) {
+            link_up(link);
+            return true;
+        }
+        std::string msg(reinterpret_cast<const char*>(link.peer_nonce), NONCE_BYTES);
+        put_u32(msg, options.node_id);
+        put_u64(msg, epoch);
+        unsigned char tag[crypto_auth_BYTES];
+        crypto_auth(tag, reinterpret_cast<const unsigned char*>(msg.data()), msg.size(), key);
+        send_frame(link, Auth, std::string_view(reinterpret_cast<const char*>(tag), sizeof(tag)));
+        return true;
+    }
+
+    if (type == Auth) {
+        std::string_view tag = r.bytes(crypto_auth_BYTES);
+        if (!r.ok || !link.hello_seen || link.authed || options.secret.empty()) return false;
+        std::string msg(reinterpret_cast<const char*>(link.nonce), NONCE_BYTES);
+        put_u32(msg, link.peer_id);
+        put_u64(msg, link.peer_epoch);
+        if (crypto_auth_verify(reinterpret_cast<const unsigned char*>(tag.data()),
+                               reinterpret_cast<const unsigned char*>(msg.data()), msg.size(), key) != 0) {
+            if (logger) logger->Write_log("Cluster: node " + std::to_string(link.peer_id) +
+                                          " failed authentication (check [CLUSTER] secret)", Logger::Error);
+            return false;
+        }
+        link_up(link);
+        return true;
+    }
+
+    if (!link.authed) return false;
+    PeerState* p = peer(link.peer_id);
+    if (!p) return false;
+
+    switch (type) {
+    case Relay: {
+        const uint32_t count = r.get<uint32_t>();
+        for (uint32_t i = 0; i < count && r.ok; ++i) {
+            const uint64_t seq         = r.get<uint64_t>();
+            const uint16_t channel_len = r.get<uint16_t>();
+            const uint16_t author_len  = r.get<uint16_t>();
+            const uint32_t text_len    = r.get<uint32_t>();
+            std::string_view channel   = r.bytes(channel_len);
+            std::string_view author    = r.bytes(author_len);
+            std::string_view text      = r.bytes(text_len);
+            if (!r.ok) break;
+            if (seq <= p->recv_high) continue; // Resent after a reconnect: already delivered
+            p->recv_high = seq;
+            deliver(link.peer_id, channel, author, text);
+        }
+        std::string ack;
+        put_u64(ack, p->recv_high);
+        send_frame(link, Ack, ack);
+        return r.ok;
+    }
+    case Ack: {
+        const uint64_t seq = r.get<uint64_t>();
+        if (r.ok && seq > p->acked && seq < next_seq) p->acked = seq;
+        return r.ok;
+    }
+    case Presence: {
+        const uint32_t count = r.get<uint32_t>();
+        for (uint32_t i = 0; i < count && r.ok; ++i) {
+            const uint8_t op  = r.get<uint8_t>();
+            const uint8_t len = r.get<uint8_t>();
+            std::string_view name = r.bytes(len);
+            if (!r.ok) break;
+            if (op == Reset) forget_node(link.peer_id);
+            else             remote_presence(link.peer_id, name, op == Online);
+        }
+        return r.ok;
+    }
+    default:
+        return false;
+    }
+}
+
+// Handshake done: this becomes the peer's link (replacing an older one),
+// relays resume where the peer left off and presence is resynchronized.
+void Cluster::link_up(Link& link)
+{
+    PeerState* p = peer(link.peer_id);
+    link.authed  = true;
+    if (p->link_fd != -1 && p->link_fd != link.fd) close_link(p->link_fd, "replaced");
+    if (p->dialing_fd == link.fd) p->dialing_fd = -1;
+    p->link_fd = link.fd;
+
+    if (p->known_epoch != link.peer_epoch) {
+        // A fresh process: it only gets what is sent from now on.
+        p->sent = p->acked = next_seq - 1;
+        p->known_epoch     = link.peer_epoch;
+    } else {
+        p->sent = p->acked; // Same process after a flap: resend what it may have missed
+    }
+    if (p->recv_epoch != link.peer_epoch) {
+        p->recv_epoch = link.peer_epoch;
+        p->recv_high  = 0;
+    }
+
+    if (logger) {
+        logger->Write_log("Cluster: link to node " + std::to_string(link.peer_id) + " up (" +
+                          (link.outbound ? "dialed" : "accepted") +
+                          (options.secret.empty() ? ", unauthenticated)" : ")"), Logger::Info);
+    }
+    send_presence_snapshot(link);
+}
+
+void Cluster::send_frame(Link& link, uint8_t type, std::string_view payload)
+{
+    if (link.dead) return;
+    put_u32(link.out, static_cast<uint32_t>(payload.size() + 1));
+    put_u8(link.out, type);
+    link.out.append(payload.data(), payload.size());
+    if (link.out.size() > LINK_BUFFER_LIMIT) {
+        close_link(link.fd, "peer not reading");
+        return;
+    }
+    if (!link.connecting) flush_link(link);
+}
+
+void Cluster::flush_link(Link& link)
+{
+    size_t sent = 0;
+    while (sent < link.out.size()) {
+        ssize_t n = send(link.fd, link.out.data() + sent, link.out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_link(link.fd, "send error");
+        return;
+    }
+    link.out.erase(0, sent);
+
+    const bool want = !link.out.empty();
+    if (want != link.writing) {
+        link.writing = want;
+        watch(link.fd, want ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
+}
+
+// Turns queued reactor requests into outbox entries and presence deltas.
+void Cluster::drain_requests()
+{
+    std::vector<Request> batch;
+    {
+        std::lock_guard<std::mutex> lock(request_mtx);
+        batch.swap(requests);
+    }
+    if (batch.empty()) return;
+
+    std::string deltas;
+    uint32_t delta_count = 0;
+    for (Request& req : batch) {
+        switch (req.kind) {
+        case Request::Relay: {
+            if (req.channel.size() > UINT16_MAX || req.author.size() > UINT16_MAX) break;
+            Outgoing out{next_seq++, {}};
+            put_u64(out.entry, out.seq);
+            put_u16(out.entry, static_cast<uint16_t>(req.channel.size()));
+            put_u16(out.entry, static_cast<uint16_t>(req.author.size()));
+            put_u32(out.entry, static_cast<uint32_t>(req.text.size()));
+            out.entry += req.channel;
+            out.entry += req.author;
+            out.entry += req.text;
+            outbox_bytes += out.entry.size();
+            outbox.push_back(std::move(out));
+            break;
+        }
+        case Request::Online:
+        case Request::Offline:
+            if (req.author.size() > 255) break;
+            put_u8(deltas, req.kind == Request::Online ? Online : Offline);
+            put_u8(deltas, static_cast<uint8_t>(req.author.size()));
+            deltas += req.author;
+            ++delta_count;
+            break;
+        case Request::Peers: {
+            std::vector<std::unique_ptr<PeerState>> kept;
+            for (const Peer& cfg : req.peers) {
+                if (cfg.id == options.node_id) continue;
+                auto it = std::find_if(peer_states.begin(), peer_states.end(),
+                                       [&](const auto& p) { return p && p->cfg.id == cfg.id; });
+                if (it != peer_states.end()) {
+                    (*it)->cfg = cfg; // New address: used at the next dial
+                    kept.push_back(std::move(*it));
+                } else {
+                    auto state = std::make_unique<PeerState>();
+                    state->cfg = cfg;
+                    kept.push_back(std::move(state));
+                    if (logger) logger->Write_log("Cluster: node " + std::to_string(cfg.id) + " added", Logger::Info);
+                }
+            }
+            for (auto& gone : peer_states) {
+                if (!gone) continue;
+                if (gone->link_fd != -1) close_link(gone->link_fd, "removed from peers");
+                if (gone->dialing_fd != -1) close_link(gone->dialing_fd, "removed from peers");
+                forget_node(gone->cfg.id);
+                if (logger) logger->Write_log("Cluster: node " + std::to_string(gone->cfg.id) + " removed", Logger::Info);
+            }
+            peer_states = std::move(kept);
+            break;
+        }
+        }
+    }
+
+    if (delta_count) {
+        std::string frame;
+        put_u32(frame, delta_count);
+        frame += deltas;
+        for (auto& [fd, link] : links) {
+            if (link->authed) send_frame(*link, Presence, frame);
+        }
+    }
+}
+
+// One RELAY frame (or a few, past RELAY_FRAME_BYTES) per peer with every
+// message it hasn't been sent yet.
+void Cluster::send_relays()
+{
+    if (outbox.empty()) return;
+    const uint64_t first = outbox.front().seq;
+    const uint64_t last  = outbox.back().seq;
+
+    for (auto& p : peer_states) {
+        if (p->link_fd == -1 || p->sent >= last) continue;
+        auto it = links.find(p->link_fd);
+        if (it == links.end() || it->second->dead) continue;
+        if (p->sent + 1 < first) {
+            if (logger) logger->Write_log("Cluster: node " + std::to_string(p->cfg.id) + " missed " +
+                                          std::to_string(first - p->sent - 1) + " messages (outbox full)",
+                                          Logger::Warn);
+            p->sent = first - 1;
+        }
+
+        std::string frame;
+        uint32_t count = 0;
+        auto flush = [&] {
+            std::memcpy(&frame[0], &count, 4);
+            send_frame(*it->second, Relay, frame);
+            frame.clear();
+            count = 0;
+        };
+        for (size_t i = static_cast<size_t>(p->sent + 1 - first); i < outbox.size(); ++i) {
+            if (frame.empty()) put_u32(frame, 0); // Count, patched in flush()
+            frame += outbox[i].entry;
+            ++count;
+            if (frame.size() >= RELAY_FRAME_BYTES) flush();
+        }
+        if (count) flush();
+        p->sent = last;
+    }
+}
+
+// Reset, then every local user Online. Split past RELAY_FRAME_BYTES like
+// the relays, so a large node stays under the peer's MAX_FRAME; only the
+// first frame carries the Reset.
+void Cluster::send_presence_snapshot(Link& link)
+{
+    std::vector<std::string> frames(1);
+    uint32_t count = 1;
+    put_u32(frames.back(), 0); // Count, patched when the frame is full
+    put_u8(frames.back(), Reset);
+    put_u8(frames.back(), 0);
+    {
+        std::lock_guard<std::mutex> lock(local_mtx);
+        for (const auto& [name, sessions] : local_online) {
+            if (name.size() > 255) continue;
+            if (frames.back().size() >= RELAY_FRAME_BYTES) {
+                std::memcpy(&frames.back()[0], &count, 4);
+                frames.emplace_back();
+                put_u32(frames.back(), 0);
+                count = 0;
+            }
+            put_u8(frames.back(), Online);
+            put_u8(frames.back(), static_cast<uint8_t>(name.size()));
+            frames.back() += name;
+            ++count;
+        }
+    }
+    std::memcpy(&frames.back()[0], &count, 4);
+    for (const std::string& frame : frames) send_frame(link, Presence, frame);
+}
+
+// Encodes once, like a local broadcast, and hands the same buffers to
+// every reactor.
+void Cluster::deliver(uint32_t origin, std::string_view channel, std::string_view author, std::string_view text)
+{
+    (void)origin;
+    if (!channel.empty() && channel[0] == '@') {
+        // A /msg to a user of this node: the first reactor routes it like
+        // one of its own (shard, then the session's reactor).
+        std::lock_guard<std::mutex> lock(reactors_mtx);
+        if (reactors.empty()) return;
+        auto* msg     = new MailboxMessage;
+        msg->type     = MailboxMessage::DirectMessage;
+        msg->username = std::string(channel.substr(1));
+        msg->author   = std::string(author);
+        msg->text     = std::string(text);
+        reactors.front()->push(msg);
+        return;
+    }
+
+    const std::string name(channel);
+    SharedPayload line, frame, deflated;
+    TcpServer::encode_chat(name, author, text, /*with_frame=*/true, line, frame, deflated);
+    if (chat_log) chat_log->append(name, author, text);
+
+    std::lock_guard<std::mutex> lock(reactors_mtx);
+    for (Mailbox* box : reactors) {
+        auto* msg     = new MailboxMessage;
+        msg->type     = MailboxMessage::Broadcast;
+        msg->channel  = name;
+        msg->payload  = line;
+        msg->frame    = frame;
+        msg->deflated = deflated;
+        box->push(msg);
+    }
+}
+
+// A remote login of a name that is online here too was a race between two
+// nodes: the lower node id keeps its session.
+void Cluster::remote_presence(uint32_t node, std::string_view name, bool online)
+{
+    const std::string key(name);
+    {
+        std::unique_lock<std::shared_mutex> lock(remote_mtx);
+        std::vector<uint32_t>& nodes = remote_online[key];
+        auto at = std::find(nodes.begin(), nodes.end(), node);
+        if (online && at == nodes.end()) {
+            nodes.push_back(node);
+            node_users[node].insert(key);
+        } else if (!online && at != nodes.end()) {
+            nodes.erase(at);
+            node_users[node].erase(key);
+        }
+        if (nodes.empty()) remote_online.erase(key);
+    }
+
+    if (online && node < options.node_id) {
+        bool here;
+        {
+            std::lock_guard<std::mutex> lock(local_mtx);
+            here = local_online.count(key) > 0;
+        }
+        if (here) kick_local(key);
+    }
+}
+
+void Cluster::forget_node(uint32_t node)
+{
+    std::unique_lock<std::shared_mutex> lock(remote_mtx);
+    auto users = node_users.find(node);
+    if (users == node_users.end()) return;
+    for (const std::string& name : users->second) {
+        auto it = remote_online.find(name);
+        if (it == remote_online.end()) continue;
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), node), it->second.end());
+        if (it->second.empty()) remote_online.erase(it);
+    }
+    node_users.erase(users);
+}
+
+void Cluster::kick_local(const std::string& name)
+{
+    if (logger) logger->Write_log("Cluster: " + name + " is logged in on a lower node too; ending the session here",
+                                  Logger::Warn);
+    std::lock_guard<std::mutex> lock(reactors_mtx);
+    for (Mailbox* box : reactors) {
+        auto* msg     = new MailboxMessage;
+        msg->type     = MailboxMessage::KickUser;
+        msg->username = name;
+        box->push(msg);
+    }
+}
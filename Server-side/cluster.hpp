@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sodium.h>
+#include "mailbox.hpp"
+
+class Logger;
+class ChatLog;
+
+// ============================================================================
+// Cluster — several server processes acting as one chat ([CLUSTER]).
+//
+// Every node lists the others in `peers` (static membership, reloadable).
+// Each pair of nodes keeps one persistent TCP link, dialed by the node with
+// the lower id and re-dialed within a second after it drops. Links start
+// with HELLO (id, process epoch, nonce) and, with a shared `secret`, an
+// HMAC challenge both ways; nothing else is accepted before that.
+//
+// Relay: a chat message broadcast on one node is queued here and sent to
+// each peer inside one RELAY frame per loop round (a batch for every
+// message queued meanwhile). Peers fan it out to their reactors as a
+// Broadcast mailbox message, exactly as the local ReactorGroup does.
+// Messages carry a per-node sequence number; receivers acknowledge the
+// highest one they delivered and drop anything at or below it, and senders
+// keep unacknowledged messages to resend after a reconnect. A link flap
+// thus loses and duplicates nothing (within OUTBOX_LIMIT bytes); a peer
+// that restarted gets only what was sent after it came back.
+//
+// Presence: each node announces its local logins and logouts, and a full
+// snapshot whenever a link comes up. A login for a name online on another
+// node is refused, like a duplicate login on this one. Two logins racing
+// on different nodes are settled when the announcements cross: the node
+// with the lower id keeps its session, the other disconnects its own. A
+// node whose link drops is forgotten until it reconnects.
+//
+// Wire format (little-endian): u32 length, u8 type, payload.
+// Runs on its own thread; every public method is thread-safe.
+// ============================================================================
+class Cluster {
+public:
+    struct Peer {
+        uint32_t id{0};
+        std::string host;
+        uint16_t port{0};
+    };
+
+    struct Options {
+        uint32_t node_id{0};     // This node (non-zero, unique in the cluster)
+        std::string listen_host; // Numeric IPv4 address for peer links
+        uint16_t listen_port{0};
+        std::vector<Peer> peers; // The other nodes
+        std::string secret;      // Shared by every node; empty = links unauthenticated
+    };
+
+    // "<id>@<host>:<port>, ..." → peers. False (with a reason) on bad syntax.
+    static bool parse_peers(const std::string& text, std::vector<Peer>& out, std::string& error);
+
+    // "<host>:<port>". False on bad syntax.
+    static bool parse_endpoint(const std::string& text, std::string& host, uint16_t& port);
+
+    // Nothing runs before start(). `chat_log` (may be null) also gets the
+    // messages relayed from peers.
+    Cluster(Options opts, Logger* logger, ChatLog* chat_log);
+
+    // Stops the thread (see stop()).
+    ~Cluster();
+
+    Cluster(const Cluster&) = delete;
+    Cluster& operator=(const Cluster&) = delete;
+
+    // Starts the link thread. Throws std::runtime_error if it can't set up
+    // its event loop; a listen port still held (hot upgrade) is retried.
+    void start();
+
+    // Closes every link and joins the thread. Call before the reactors'
+    // mailboxes go away. Idempotent.
+    void stop();
+
+    // Delivers relayed messages (and kicks) to `reactor` from now on.
+    void add_reactor(Mailbox* reactor);
+
+    // A message broadcast on this node, to relay to every peer. A
+    // `channel` of "@<name>" is a /msg to that user, wherever it is online.
+    void relay(const std::string& channel, std::string_view author, std::string_view text);
+
+    // A session of `name` started (online) or ended on this node.
+    void presence(const std::string& name, bool online);
+
+    // True if `name` is logged in on another node.
+    bool online_elsewhere(const std::string& name) const;
+
+    // Replaces the peer list (SIGHUP): links to removed nodes are closed,
+    // new ones dialed.
+    void set_peers(std::vector<Peer> peers);
+
+    uint32_t node_id() const { return options.node_id; }
+
+private:
+    struct Link;
+    struct PeerState;
+
+    // Thread body and its steps.
+    void run();
+    void drain_requests();
+    void tick(uint64_t now_ms);
+    bool try_listen();
+    void accept_links();
+    void dial(PeerState& p, uint64_t now_ms);
+    void on_readable(Link& link);
+    void on_writable(Link& link);
+    bool handle_frame(Link& link, uint8_t type, std::string_view payload);
+    void link_up(Link& link);
+    void close_link(int fd, const char* why);
+    void send_frame(Link& link, uint8_t type, std::string_view payload);
+    void flush_link(Link& link);
+    void send_relays();
+    void send_presence_snapshot(Link& link);
+    void deliver(uint32_t origin, std::string_view channel, std::string_view author, std::string_view text);
+    void remote_presence(uint32_t node, std::string_view name, bool online);
+    void forget_node(uint32_t node);
+    void kick_local(const std::string& name);
+    void watch(int fd, uint32_t events);
+
+    PeerState* peer(uint32_t id);
+
+    Options options;
+    Logger* logger;
+    ChatLog* chat_log;
+    uint64_t epoch{0};                       // Random per process: tells restarts from flaps
+    unsigned char key[crypto_auth_KEYBYTES]{}; // From `secret`
+
+    int epoll_fd{-1};
+    int wake_fd{-1};                         // eventfd: requests queued / stop()
+    int listen_fd{-1};
+    uint64_t next_listen_ms{0};
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    // Requests from the reactors, drained by the thread.
+    struct Request {
+        enum Kind { Relay, Online, Offline, Peers } kind;
+        std::string channel, author, text; // Relay; `author` is the name for Online/Offline
+        std::vector<Peer> peers;           // Peers
+    };
+    std::mutex request_mtx;
+    std::vector<Request> requests;
+
+    std::mutex reactors_mtx;
+    std::vector<Mailbox*> reactors;
+
+    // Sessions on this node (name → count), for snapshots and conflicts.
+    std::mutex local_mtx;
+    std::unordered_map<std::string, uint32_t> local_online;
+
+    // Sessions on other nodes, read by online_elsewhere().
+    mutable std::shared_mutex remote_mtx;
+    std::unordered_map<std::string, std::vector<uint32_t>> remote_online; // name → nodes
+    std::unordered_map<uint32_t, std::unordered_set<std::string>> node_users;
+
+    // Thread-only state.
+    std::unordered_map<int, std::unique_ptr<Link>> links; // fd → link
+    std::vector<std::unique_ptr<PeerState>> peer_states;
+    struct Outgoing {
+        uint64_t seq;
+        std::string entry; // Encoded RELAY entry
+    };
+    std::deque<Outgoing> outbox; // Sent or about to be, not yet acked by every peer
+    size_t outbox_bytes{0};
+    uint64_t next_seq{1};
+};
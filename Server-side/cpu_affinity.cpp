@@ -0,0 +1,112 @@
+#include "cpu_affinity.hpp"
+
+#include <dirent.h>      // opendir() — /sys/devices/system/cpu/cpuN/nodeM
+#include <pthread.h>     // pthread_setaffinity_np()
+#include <sched.h>       // cpu_set_t, sched_getaffinity()
+#include <sys/socket.h>  // setsockopt(SO_INCOMING_CPU)
+#include <cerrno>
+#include <cstdlib>       // strtol()
+#include <cstring>       // strncmp()
+
+namespace affinity {
+
+namespace {
+
+// Reads a non-negative number at `p`; false if there is none or it is
+// outside what a cpu_set_t holds.
+bool read_cpu(const char*& p, int& cpu)
+{
+    if (*p < '0' || *p > '9') return false;
+    char* end = nullptr;
+    const long v = std::strtol(p, &end, 10);
+    if (v >= CPU_SETSIZE) return false;
+    cpu = static_cast<int>(v);
+    p   = end;
+    return true;
+}
+
+} // namespace
+
+bool parse_cpu_list(const std::string& text, std::vector<int>& cpus, std::string& error)
+{
+    cpus.clear();
+    const char* p = text.c_str();
+    while (*p == ' ') ++p;
+    if (!*p) return true;
+
+    while (true) {
+        int first = 0;
+        int last  = 0;
+        if (!read_cpu(p, first)) break;
+        last = first;
+        if (*p == '-') {
+            ++p;
+            if (!read_cpu(p, last) || last < first) break;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+
+        while (*p == ' ') ++p;
+        if (!*p) return true;
+        if (*p++ != ',') break;
+        while (*p == ' ') ++p;
+    }
+    error = "bad CPU list '" + text + "' (expected e.g. 0-3,8)";
+    cpus.clear();
+    return false;
+}
+
+std::string unusable(const std::vector<int>& cpus)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+    std::string out;
+    for (int cpu : cpus) {
+        if (CPU_ISSET(cpu, &allowed)) continue;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpu);
+    }
+    return out;
+}
+
+bool pin_current_thread(int cpu)
+{
+    if (cpu < 0) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int numa_node(int cpu)
+{
+    const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = opendir(dir.c_str());
+    if (!d) return -1;
+
+    int node = -1;
+    while (const dirent* e = readdir(d)) {
+        if (std::strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            node = std::atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+bool set_incoming_cpu(int fd, int cpu)
+{
+    return setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == 0;
+}
+
+std::string describe(int cpu)
+{
+    if (cpu < 0) return "any CPU";
+    const int node = numa_node(cpu);
+    return "CPU " + std::to_string(cpu) +
+           (node >= 0 ? " (NUMA node " + std::to_string(node) + ")" : std::string());
+}
+
+} // namespace affinity
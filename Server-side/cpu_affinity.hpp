@@ -0,0 +1,51 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// affinity — thread placement for [PROCESS] reactor_cpus / crypto_cpus.
+//
+// A pinned thread stays on its core, so its caches stay warm and the
+// scheduler can't move it to the other socket. Memory follows for free:
+// Linux places a page on the NUMA node of the thread that first touches
+// it, and everything a reactor owns (client slabs, read buffers, write
+// queues, the io_uring ring and its buffers) is allocated lazily on its
+// own thread once run() started. That is why the threads pin themselves
+// first thing, before any allocation, instead of being pinned from outside.
+// ============================================================================
+namespace affinity {
+
+// Parses a cpuset list such as "0-3,8,10-11" into CPU numbers, in the
+// order written. Empty text gives an empty list. False (with `error` set)
+// on bad syntax.
+bool parse_cpu_list(const std::string& text, std::vector<int>& cpus, std::string& error);
+
+// Of `cpus`, the ones this process may not run on (outside its cpuset or
+// offline), as a list for the log; empty when all are usable.
+std::string unusable(const std::vector<int>& cpus);
+
+// The CPU for thread `index` of a pool: round robin over `cpus`, -1 when
+// the list is empty (unpinned).
+inline int pick(const std::vector<int>& cpus, size_t index)
+{
+    return cpus.empty() ? -1 : cpus[index % cpus.size()];
+}
+
+// Pins the calling thread to `cpu` (no-op for -1). False on failure.
+bool pin_current_thread(int cpu);
+
+// NUMA node of `cpu` according to sysfs, -1 when unknown.
+int numa_node(int cpu);
+
+// SO_INCOMING_CPU on listener `fd`: with SO_REUSEPORT the kernel prefers
+// the listener whose CPU received the SYN, so a reactor pinned to the core
+// serving a NIC RX queue accepts the connections steered to that queue.
+bool set_incoming_cpu(int fd, int cpu);
+
+// "CPU 3 (NUMA node 0)" — for the log.
+std::string describe(int cpu);
+
+} // namespace affinity
@@ -0,0 +1,742 @@
+#include "credential_store.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Filter size for an empty or small store (names, ~1.2 KiB of bits).
+static constexpr size_t FILTER_MIN_CAPACITY = 1024;
+
+// Snapshot bytes per account, roughly (an Argon2id hash is ~100 of them):
+// sizes the index before a snapshot is streamed in, so it isn't rehashed
+// (and briefly doubled) a dozen times on the way.
+static constexpr size_t SNAPSHOT_BYTES_PER_RECORD = 192;
+
+// Read-ahead for snapshot streaming, and the write batch of write_snapshot().
+static constexpr size_t SNAPSHOT_IO_CHUNK = 1 << 20;
+
+namespace {
+
+// SAX handler for a snapshot: {"journal_seq": S, "users": [{...}, ...]}.
+// Each "users" entry is collected into one UserRecord and handed to the
+// sink as soon as its object closes, so the DOM of the whole file is never
+// built. Unknown keys, nesting and non-string fields are skipped.
+class SnapshotReader : public nlohmann::json_sax<nlohmann::json> {
+public:
+    using Record = CredentialStore::UserRecord;
+    using Sink   = std::function<void(Record&&)>;
+
+    explicit SnapshotReader(const Sink& _sink) : sink(_sink) {}
+
+    uint64_t seq{0};
+    std::string error;
+
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t v) override
+    {
+        if (depth == 1 && top_key == "journal_seq" && v > 0) seq = static_cast<uint64_t>(v);
+        return scalar();
+    }
+    bool number_unsigned(number_unsigned_t v) override
+    {
+        if (depth == 1 && top_key == "journal_seq") seq = v;
+        return scalar();
+    }
+    bool number_float(number_float_t, const string_t&) override { return scalar(); }
+    bool string(string_t& v) override
+    {
+        if (depth == 3 && in_record && field) *field = std::move(v);
+        return scalar();
+    }
+    bool binary(binary_t&) override { return scalar(); }
+
+    bool start_object(std::size_t) override
+    {
+        if (depth == 2 && in_users) {
+            in_record = true;
+            current   = Record{};
+        }
+        field = nullptr;
+        ++depth;
+        return true;
+    }
+    bool key(string_t& k) override
+    {
+        if (depth == 1) top_key = k;
+        if (depth == 3 && in_record) field = field_for(k);
+        return true;
+    }
+    bool end_object() override
+    {
+        --depth;
+        if (depth == 2 && in_record) {
+            in_record = false;
+            sink(std::move(current));
+        }
+        return true;
+    }
+    bool start_array(std::size_t) override
+    {
+        if (depth == 1 && top_key == "users") in_users = true;
+        field = nullptr;
+        ++depth;
+        return true;
+    }
+    bool end_array() override
+    {
+        --depth;
+        if (depth == 1) in_users = false;
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override
+    {
+        error = e.what();
+        return false;
+    }
+
+private:
+    // A value at record level consumed its key.
+    bool scalar()
+    {
+        if (depth == 3) field = nullptr;
+        return true;
+    }
+
+    std::string* field_for(const std::string& k)
+    {
+        if (k == "username")   return &current.username;
+        if (k == "password")   return &current.password_hash;
+        if (k == "IP_source")  return &current.ip_source;
+        if (k == "created_at") return &current.created_at;
+        return nullptr;
+    }
+
+    const Sink& sink;
+    int depth{0};                  // Containers currently open
+    std::string top_key;           // Last key of the top-level object
+    bool in_users{false};          // Inside the top-level "users" array
+    bool in_record{false};         // Inside one of its objects
+    std::string* field{nullptr};   // Member of `current` the next string goes to
+    Record current;
+};
+
+// Writes all of `bytes` to `fd`. False (errno set) on failure.
+bool write_all(int fd, const std::string& bytes)
+{
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// Journal of the compaction in progress: the live journal is renamed here so
+// new appends can continue in a fresh file while the snapshot is written.
+static std::string compacting_path(const std::string& journal_path)
+{
+    return journal_path + ".compacting";
+}
+
+CredentialStore::CredentialStore(std::string _path)
+    : CredentialStore(std::move(_path), Options{})
+{
+}
+
+CredentialStore::CredentialStore(std::string _path, Options opts)
+    : path(std::move(_path)),
+      journal_path(path + ".journal"),
+      options(opts)
+{
+    if (options.fsync_interval_ms < 1) options.fsync_interval_ms = 1;
+    if (options.compact_records < 1)   options.compact_records   = 1;
+
+    std::random_device rd;
+    filter_seed = (uint64_t{rd()} << 32) | rd();
+}
+
+CredentialStore::~CredentialStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(bg_mtx);
+        stopping = true;
+    }
+    bg_wake.notify_all();
+    if (background.joinable()) background.join();
+
+    std::lock_guard<std::mutex> lock(journal_mtx);
+    if (journal_fd != -1) {
+        if (journal_dirty) fdatasync(journal_fd); // Nothing acknowledged may be lost
+        ::close(journal_fd);
+        journal_fd = -1;
+    }
+}
+
+// Skips nameless entries; a later duplicate of a name keeps the first record
+// (the one the old linear scans would have matched).
+bool CredentialStore::insert_locked(UserRecord&& rec)
+{
+    if (rec.username.empty() || index.count(rec.username)) return false;
+    index.emplace(rec.username, records.size());
+    records.push_back(std::move(rec));
+    if (filter.load(std::memory_order_relaxed)) filter_add_locked(records.back().username);
+    return true;
+}
+
+void CredentialStore::filter_add_locked(std::string_view username)
+{
+    const size_t count = options.format == Format::Binary ? (mapped ? mapped->size() : 0) : records.size();
+    if (count > filters.back()->capacity()) {
+        rebuild_filter_locked(filters.back()->capacity() * 2); // Includes `username`
+        return;
+    }
+    filters.back()->add(username);
+}
+
+void CredentialStore::rebuild_filter_locked(size_t capacity)
+{
+    auto fresh = std::make_unique<BloomFilter>(capacity, filter_seed);
+    if (options.format == Format::Binary) {
+        for (size_t i = 0; mapped && i < mapped->size(); ++i) fresh->add(mapped->record(i).name());
+    } else {
+        for (const UserRecord& rec : records) fresh->add(rec.username);
+    }
+    filter.store(fresh.get(), std::memory_order_release);
+    filters.push_back(std::move(fresh));
+}
+
+bool CredentialStore::maybe_exists(std::string_view username) const
+{
+    const BloomFilter* f = filter.load(std::memory_order_acquire);
+    return !f || f->maybe_contains(username);
+}
+
+// Recovery: snapshot first, then any interrupted compaction's journal, then
+// the live journal — each applying only records newer than the snapshot.
+bool CredentialStore::load()
+{
+    if (options.format == Format::Binary) return load_binary();
+
+    bool snapshot_ok = true;
+    uint64_t snapshot_seq = 0;
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        records.clear();
+        index.clear();
+        struct stat st{};
+        if (::stat(path.c_str(), &st) == 0) {
+            records.reserve(static_cast<size_t>(st.st_size) / SNAPSHOT_BYTES_PER_RECORD);
+            index.reserve(static_cast<size_t>(st.st_size) / SNAPSHOT_BYTES_PER_RECORD);
+        }
+
+        std::string error;
+        if (!read_snapshot(path, snapshot_seq, [this](UserRecord&& rec) { insert_locked(std::move(rec)); },
+                           error)) {
+            std::cerr << "JSON parse error: " << error << std::endl;
+            // Like an unparsable file before: nothing of it is used.
+            records.clear();
+            index.clear();
+            snapshot_seq = 0;
+            snapshot_ok  = false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(journal_mtx);
+        last_seq        = snapshot_seq;
+        journal_records = 0;
+    }
+    replay_journal(compacting_path(journal_path), snapshot_seq);
+    replay_journal(journal_path, snapshot_seq);
+
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        rebuild_filter_locked(std::max(FILTER_MIN_CAPACITY, 2 * records.size()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(journal_mtx);
+        if (journal_fd == -1) {
+            journal_fd = ::open(journal_path.c_str(),
+                                O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+            if (journal_fd == -1) {
+                std::cerr << "Failed to open credential journal " << journal_path
+                          << ": " << strerror(errno) << std::endl;
+            }
+        }
+    }
+
+    if (!background.joinable()) {
+        background = std::thread([this] { background_loop(); });
+    }
+    return snapshot_ok;
+}
+
+// Streams instead of parsing into a DOM: a snapshot of millions of
+// accounts never exists in memory twice, and the index is filled while the
+// file is still being read.
+bool CredentialStore::read_snapshot(const std::string& file, uint64_t& seq,
+                                    const std::function<void(UserRecord&&)>& sink, std::string& error)
+{
+    seq = 0;
+    std::vector<char> read_ahead(SNAPSHOT_IO_CHUNK);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(read_ahead.data(), static_cast<std::streamsize>(read_ahead.size()));
+    in.open(file, std::ios::binary);
+    if (!in.is_open()) return true; // Missing: an empty DB
+
+    SnapshotReader reader(sink);
+    if (!nlohmann::json::sax_parse(in, &reader)) {
+        error = reader.error;
+        return false;
+    }
+    seq = reader.seq;
+    return true;
+}
+
+// One JSON object per line. Parsing stops at the first bad line: with
+// O_APPEND writes that can only be a torn tail left by a crash.
+off_t CredentialStore::scan_journal(const std::string& file,
+                                    const std::function<void(uint64_t, bool, UserRecord&&)>& sink)
+{
+    using json = nlohmann::json;
+
+    std::ifstream in(file);
+    if (!in.is_open()) return -1;
+
+    off_t good_end = 0; // Byte offset just past the last intact record
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || in.eof()) {
+            // A final line without '\n' was never completely written.
+            if (!line.empty()) return good_end;
+            good_end += 1;
+            continue;
+        }
+
+        json rec = json::parse(line, nullptr, false);
+        if (rec.is_discarded() || !rec.is_object()) return good_end;
+        good_end += static_cast<off_t>(line.size()) + 1;
+
+        sink(rec.value("seq", uint64_t{0}), rec.value("rehash", false), UserRecord{rec.value("username", ""),
+                                                       rec.value("password", ""),
+                                                       rec.value("IP_source", ""),
+                                                       rec.value("created_at", "")});
+    }
+    return -1;
+}
+
+// The torn tail is cut off, so the next append starts on a clean line.
+void CredentialStore::replay_journal(const std::string& file, uint64_t after_seq)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    std::lock_guard<std::mutex> jlock(journal_mtx);
+
+    const bool live = file == journal_path;
+    const off_t good_end = scan_journal(file, [&](uint64_t seq, bool rehash, UserRecord&& rec) {
+        if (live) journal_records++;
+        if (seq <= after_seq) return; // Already contained in the snapshot
+        if (seq > last_seq) last_seq = seq;
+        if (!rehash) {
+            insert_locked(std::move(rec));
+            return;
+        }
+        auto it = index.find(rec.username);
+        if (it != index.end() && !rec.password_hash.empty()) {
+            records[it->second].password_hash = std::move(rec.password_hash);
+        }
+    });
+
+    if (good_end >= 0) {
+        std::cerr << "Credential journal " << file
+                  << ": dropping torn/corrupt tail record" << std::endl;
+        if (::truncate(file.c_str(), good_end) != 0) {
+            std::cerr << "Credential journal truncate failed: " << strerror(errno) << std::endl;
+        }
+    }
+}
+
+// The mapped file is created (or validated) here; a binary store that
+// didn't exist yet takes over the accounts of the JSON DB it replaces.
+bool CredentialStore::load_binary()
+{
+    const bool existed = ::access(path.c_str(), F_OK) == 0;
+
+    auto file = std::make_unique<MappedCredentialFile>();
+    std::string error;
+    if (!file->open(path, error)) {
+        std::cerr << "Credential DB " << error << std::endl;
+        return false;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        mapped = std::move(file);
+        rebuild_filter_locked(std::max(FILTER_MIN_CAPACITY, 2 * mapped->size()));
+    }
+
+    if (!existed && !options.import_from.empty() && ::access(options.import_from.c_str(), F_OK) == 0) {
+        size_t imported = 0;
+        size_t read     = 0;
+        if (!import_json(options.import_from, imported, read)) {
+            std::cerr << "Credential DB " << options.import_from << " unreadable; imported what came before the error"
+                      << std::endl;
+        }
+        compact(); // Durable before the JSON DB stops being the source of truth
+        std::cout << "Imported " << imported << " accounts from " << options.import_from
+                  << " into " << path << std::endl;
+    }
+
+    if (!background.joinable()) {
+        background = std::thread([this] { background_loop(); });
+    }
+    return true;
+}
+
+bool CredentialStore::contains(const std::string& username) const
+{
+    if (!maybe_exists(username)) return false;
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    if (options.format == Format::Binary) return mapped && mapped->find(username);
+    return index.count(username) > 0;
+}
+
+bool CredentialStore::find_hash(const std::string& username, std::string& out) const
+{
+    if (!maybe_exists(username)) return false;
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    if (options.format == Format::Binary) {
+        const MappedCredentialFile::Record* rec = mapped ? mapped->find(username) : nullptr;
+        if (!rec) return false;
+        out.assign(rec->hash());
+        return !out.empty();
+    }
+    auto it = index.find(username);
+    if (it == index.end()) return false;
+    out = records[it->second].password_hash;
+    return !out.empty();
+}
+
+size_t CredentialStore::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    if (options.format == Format::Binary) return mapped ? mapped->size() : 0;
+    return records.size();
+}
+
+std::vector<CredentialStore::UserRecord> CredentialStore::all_records() const
+{
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    if (options.format != Format::Binary) return records;
+
+    std::vector<UserRecord> out;
+    if (!mapped) return out;
+    out.reserve(mapped->size());
+    for (size_t i = 0; i < mapped->size(); ++i) {
+        const MappedCredentialFile::Record& rec = mapped->record(i);
+        out.push_back(UserRecord{std::string(rec.name()), std::string(rec.hash()),
+                                 std::string(rec.ip()), std::string(rec.created())});
+    }
+    return out;
+}
+
+bool CredentialStore::export_json(const std::string& out_path) const
+{
+    return write_snapshot(all_records(), 0, out_path);
+}
+
+// The index only keeps the record once its journal line was written, so
+// memory and disk never disagree about who exists. The fdatasync itself is
+// batched by the background thread (group commit).
+bool CredentialStore::add(const std::string& username, const std::string& password_hash,
+                          const std::string& ip_source)
+{
+    // UTC timestamp for consistency across hosts/timezones.
+    auto now = std::chrono::system_clock::now();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    std::tm tm_struct{};
+    gmtime_r(&t, &tm_struct); // Thread-safe UTC conversion
+    std::ostringstream datetime_ss;
+    datetime_ss << std::put_time(&tm_struct, "%Y-%m-%dT%H:%M:%SZ"); // ISO-8601 UTC
+
+    return append_record(UserRecord{username, password_hash, ip_source, datetime_ss.str()});
+}
+
+bool CredentialStore::replace_hash(const std::string& username, const std::string& old_hash,
+                                   const std::string& new_hash)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (options.format == Format::Binary) {
+        // In place, like append(); the background msync() makes it durable.
+        const MappedCredentialFile::Record* rec = mapped ? mapped->find(username) : nullptr;
+        return rec && rec->hash() == old_hash && mapped->replace_hash(username, new_hash);
+    }
+
+    auto it = index.find(username);
+    if (it == index.end() || records[it->second].password_hash != old_hash) return false;
+    if (!write_journal_locked(UserRecord{username, new_hash, "", ""}, true)) return false;
+    records[it->second].password_hash = new_hash;
+    return true;
+}
+
+bool CredentialStore::import_record(const UserRecord& rec)
+{
+    return append_record(UserRecord(rec));
+}
+
+// Same recovery order as load(), but each record goes straight into this
+// store: the source is never indexed, and its files are left untouched.
+bool CredentialStore::import_json(const std::string& json_path, size_t& imported, size_t& read)
+{
+    imported = read = 0;
+    auto take = [&](UserRecord&& rec) {
+        if (rec.username.empty()) return; // Skipped by a JSON load too
+        ++read;
+        imported += append_record(std::move(rec)) ? 1 : 0;
+    };
+
+    uint64_t snapshot_seq = 0;
+    std::string error;
+    const bool ok = read_snapshot(json_path, snapshot_seq, take, error);
+    if (!ok) std::cerr << "JSON parse error: " << error << std::endl;
+
+    const std::string journal = json_path + ".journal";
+    for (const std::string& file : {compacting_path(journal), journal}) {
+        scan_journal(file, [&](uint64_t seq, bool rehash, UserRecord&& rec) {
+            if (ok && seq <= snapshot_seq) return;
+            std::string current;
+            if (!rehash) take(std::move(rec));
+            else if (find_hash(rec.username, current)) replace_hash(rec.username, current, rec.password_hash);
+        });
+    }
+    return ok;
+}
+
+// The records skip the journal: the snapshot written at the end (which
+// holds everything up to last_seq, and now them too) is what makes them
+// durable, in one sequential write instead of a line and a compaction
+// per thousand accounts.
+size_t CredentialStore::bulk_import(std::vector<UserRecord>&& recs, bool& durable)
+{
+    size_t added = 0;
+    if (options.format == Format::Binary) {
+        for (UserRecord& rec : recs) added += append_record(std::move(rec)) ? 1 : 0;
+    } else {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        records.reserve(records.size() + recs.size());
+        index.reserve(index.size() + recs.size());
+        for (UserRecord& rec : recs) added += insert_locked(std::move(rec)) ? 1 : 0;
+    }
+    recs.clear();
+    durable = compact();
+    return added;
+}
+
+bool CredentialStore::append_record(UserRecord&& rec)
+{
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (options.format == Format::Binary) {
+        // In place; the background thread's msync() makes it durable.
+        if (!mapped || !mapped->append(rec.username, rec.password_hash, rec.ip_source, rec.created_at)) {
+            return false;
+        }
+        filter_add_locked(rec.username);
+        return true;
+    }
+    if (index.count(rec.username) || !write_journal_locked(rec, false)) return false;
+
+    insert_locked(std::move(rec));
+    return true;
+}
+
+bool CredentialStore::write_journal_locked(const UserRecord& rec, bool rehash)
+{
+    std::lock_guard<std::mutex> jlock(journal_mtx);
+    if (journal_fd == -1) return false;
+
+    nlohmann::json line;
+    line["seq"]      = last_seq + 1;
+    line["username"] = rec.username;
+    line["password"] = rec.password_hash;
+    if (rehash) {
+        line["rehash"] = true; // Older builds skip it: the name already exists
+    } else {
+        line["IP_source"]  = rec.ip_source;
+        line["created_at"] = rec.created_at;
+    }
+    const std::string bytes = line.dump() + "\n";
+
+    // O_APPEND + a single write() keeps each record contiguous.
+    ssize_t n = ::write(journal_fd, bytes.data(), bytes.size());
+    if (n != static_cast<ssize_t>(bytes.size())) {
+        std::cerr << "Credential journal append failed: " << strerror(errno) << std::endl;
+        // A short write leaves a torn line that recovery will stop at; cut it off.
+        if (n > 0 && ftruncate(journal_fd, lseek(journal_fd, 0, SEEK_END) - n) != 0) {
+            std::cerr << "Credential journal truncate failed: " << strerror(errno) << std::endl;
+        }
+        return false;
+    }
+
+    last_seq++;
+    journal_records++;
+    journal_dirty = true;
+    return true;
+}
+
+// Rotates the journal, then writes the snapshot from a copy taken at the
+// rotation point, so neither readers nor add() wait for the serialization.
+bool CredentialStore::compact()
+{
+    if (options.format == Format::Binary) {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        return mapped && mapped->sync();
+    }
+
+    std::vector<UserRecord> snapshot;
+    uint64_t snapshot_seq;
+
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx); // Freezes `records` vs add()
+        std::lock_guard<std::mutex> jlock(journal_mtx);
+        if (journal_fd == -1) return false;
+
+        // 1. Move the live journal aside and start a fresh one. If an earlier
+        //    compaction left its rotated journal behind, keep that file (it may
+        //    hold records no snapshot has yet) and only retry the snapshot;
+        //    the live journal is then skipped by seq on replay.
+        if (journal_dirty) fdatasync(journal_fd);
+        journal_dirty = false;
+        if (::access(compacting_path(journal_path).c_str(), F_OK) != 0) {
+            if (std::rename(journal_path.c_str(), compacting_path(journal_path).c_str()) != 0) {
+                std::cerr << "Failed to rotate credential journal: " << strerror(errno) << std::endl;
+                return false;
+            }
+            ::close(journal_fd);
+            journal_fd = ::open(journal_path.c_str(),
+                                O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+            if (journal_fd == -1) {
+                std::cerr << "Failed to reopen credential journal: " << strerror(errno) << std::endl;
+            }
+            journal_records = 0;
+        }
+
+        // 2. Everything up to last_seq is in `records` right now.
+        snapshot     = records;
+        snapshot_seq = last_seq;
+    }
+
+    // 3. Durable snapshot, then the rotated journal is redundant.
+    if (!write_snapshot(snapshot, snapshot_seq, path)) return false; // .compacting is replayed next start
+    std::remove(compacting_path(journal_path).c_str());
+    return true;
+}
+
+// Atomic: write to temp, fsync, then rename over the original (crash-safe).
+bool CredentialStore::write_snapshot(const std::vector<UserRecord>& snapshot, uint64_t seq,
+                                     const std::string& target)
+{
+    using json = nlohmann::json;
+
+    const std::string tmp_path = target + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1) {
+        std::cerr << "Failed to open temp credentials file for writing" << std::endl;
+        return false;
+    }
+
+    // Serialized one record at a time, in batches of SNAPSHOT_IO_CHUNK:
+    // the bytes are the compact dump() of the whole document (keys in the
+    // same sorted order), without building its DOM first.
+    std::string bytes = "{\"journal_seq\":" + std::to_string(seq) + ",\"users\":[";
+    bytes.reserve(SNAPSHOT_IO_CHUNK + 4096);
+    bool ok = true;
+    for (size_t i = 0; ok && i < snapshot.size(); ++i) {
+        const UserRecord& rec = snapshot[i];
+        json user;
+        user["username"]   = rec.username;
+        user["password"]   = rec.password_hash;
+        user["IP_source"]  = rec.ip_source;
+        user["created_at"] = rec.created_at;
+        if (i) bytes += ',';
+        bytes += user.dump();
+        if (bytes.size() >= SNAPSHOT_IO_CHUNK) {
+            ok = write_all(fd, bytes);
+            bytes.clear();
+        }
+    }
+    bytes += "]}";
+    if (!ok || !write_all(fd, bytes)) {
+        std::cerr << "Failed to write credentials snapshot: " << strerror(errno) << std::endl;
+        ::close(fd);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    fsync(fd); // Data must be durable before the rename makes it visible
+    ::close(fd);
+
+    // rename() is atomic on POSIX: reader never sees a half-written file.
+    if (std::rename(tmp_path.c_str(), target.c_str()) != 0) {
+        std::cerr << "Failed to rename temp credentials file: " << strerror(errno) << std::endl;
+        std::remove(tmp_path.c_str()); // Clean up the orphan temp on failure
+        return false;
+    }
+    return true;
+}
+
+// Group commit: every interval, one fdatasync covers all appends since the
+// last one. The fd is dup()ed so add() never waits behind the sync itself.
+void CredentialStore::background_loop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(bg_mtx);
+            if (bg_wake.wait_for(lock, std::chrono::milliseconds(options.fsync_interval_ms),
+                                 [this] { return stopping; })) {
+                return; // Destructor performs the final sync
+            }
+        }
+
+        if (options.format == Format::Binary) {
+            // Shared lock: lookups go on, only a concurrent append waits.
+            std::shared_lock<std::shared_mutex> lock(mtx);
+            if (mapped && mapped->dirty()) mapped->sync();
+            continue;
+        }
+
+        int sync_fd = -1;
+        bool want_compact = false;
+        {
+            std::lock_guard<std::mutex> jlock(journal_mtx);
+            if (journal_dirty && journal_fd != -1) {
+                sync_fd = ::dup(journal_fd);
+                journal_dirty = false;
+            }
+            want_compact = journal_records >= options.compact_records;
+        }
+
+        if (sync_fd != -1) {
+            fdatasync(sync_fd);
+            ::close(sync_fd);
+        }
+        if (want_compact) compact();
+    }
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "mapped_credentials.hpp"
+#include "bloom_filter.hpp"
+
+// ============================================================================
+// CredentialStore — the user DB, parsed ONCE at startup into a hash index.
+// Before this, every /login and /register re-opened and DOM-parsed the whole
+// credentials.json, so auth cost grew linearly with the user count.
+// Lookups are O(1) average.
+//
+// Persistence is snapshot + append-only journal:
+//   <path>          JSON snapshot ({"users": [...], "journal_seq": S})
+//   <path>.journal  one JSON record per line, each with a increasing "seq"
+// add() appends one line (O(1) I/O per signup) instead of rewriting the DB.
+// A background thread fdatasync()s the journal in batches and, once it grows
+// past the configured size, compacts it into a fresh snapshot. Recovery
+// loads the snapshot and replays journal records with seq > S; a torn last
+// line from a crash is ignored. Snapshots are still written temp + rename,
+// so the file is never seen half-written.
+//
+// Options::format = Binary swaps all of that for a MappedCredentialFile at
+// <path>: no parse at startup, lookups straight from the mmap'd hash index,
+// appends in place and msync()ed by the same background thread. A binary
+// store that doesn't exist yet is seeded from Options::import_from (a JSON
+// DB) on first load(); export_json() writes the JSON format back.
+//
+// JSON snapshots are read with a SAX parser, record by record, straight
+// into the index (or, for an import, into the binary file): no DOM of the
+// whole file, so startup memory stays close to the index itself.
+//
+// Both formats keep a BloomFilter of every name in front of the index:
+// contains()/find_hash() of a name that was never registered (most
+// /register attempts, username-probing floods) return without taking the
+// lock or touching the index.
+// Thread-safe: reactors read concurrently, writers take an exclusive lock.
+// ============================================================================
+class CredentialStore {
+public:
+    // One persisted account (same fields as the JSON "users" entries).
+    struct UserRecord {
+        std::string username;
+        std::string password_hash; // Encoded Argon2id string (salt + params inside)
+        std::string ip_source;     // Address the account registered from
+        std::string created_at;    // ISO-8601 UTC
+    };
+
+    // On-disk format ([DATABASE] format).
+    enum class Format { Json, Binary };
+
+    // Storage tuning ([DATABASE] section of the config).
+    struct Options {
+        Format format{Format::Json};
+        int fsync_interval_ms{50};    // Max time an appended record waits for fdatasync/msync
+        size_t compact_records{1000}; // Journal length that triggers a snapshot (JSON)
+        std::string import_from;      // Binary: JSON DB that seeds a missing file
+    };
+
+    // Binds the store to `path`; nothing is read until load().
+    explicit CredentialStore(std::string path);
+    CredentialStore(std::string path, Options opts);
+
+    // Flushes the journal and stops the background thread.
+    ~CredentialStore();
+
+    CredentialStore(const CredentialStore&) = delete;
+    CredentialStore& operator=(const CredentialStore&) = delete;
+
+    // Recovers snapshot + journal into the index, opens the journal for
+    // appending and starts the background flusher/compactor. A missing file
+    // is an empty DB. Returns false if the snapshot exists but could not be
+    // parsed (the store then starts empty).
+    bool load();
+
+    // O(1): true if `username` has an account.
+    bool contains(const std::string& username) const;
+
+    // O(1): copies the stored hash of `username` into `out`. False if unknown.
+    bool find_hash(const std::string& username, std::string& out) const;
+
+    // Inserts a new account and appends it to the journal before returning
+    // (durable on disk within fsync_interval_ms). Fails, leaving the index
+    // untouched, if the name exists or the append failed.
+    bool add(const std::string& username, const std::string& password_hash,
+             const std::string& ip_source);
+
+    // Swaps the hash of `username` for `new_hash` (a login rehashed it at
+    // the current Argon2id cost), journaled like add(). Compare-and-swap:
+    // false, changing nothing, if the account is gone or its hash is no
+    // longer `old_hash` (another session rehashed it first), or if the
+    // append failed.
+    bool replace_hash(const std::string& username, const std::string& old_hash,
+                      const std::string& new_hash);
+
+    // add() for a record that already has its timestamp (imports).
+    bool import_record(const UserRecord& rec);
+
+    // Streams every account of the JSON store at `json_path` (snapshot,
+    // then journal) into this one, as import_record() does; the source
+    // files are only read. `read` counts the accounts found, `imported`
+    // those added. False if the snapshot couldn't be parsed (the accounts
+    // before the error, and the journal, are imported anyway).
+    bool import_json(const std::string& json_path, size_t& imported, size_t& read);
+
+    // Adds every record of `recs` (already hashed, timestamps set) in one
+    // pass, then writes one snapshot (JSON) or syncs the file (binary):
+    // no journal line per account. Names that exist are skipped. Returns
+    // how many were added; `durable` is false if the final write failed.
+    size_t bulk_import(std::vector<UserRecord>&& recs, bool& durable);
+
+    // Passes each account of snapshot `file` ({"users": [...]}) to `sink`
+    // as it is parsed and sets `seq` to its journal_seq. A missing file is
+    // empty. False (with `error`) on a parse error, after the records
+    // before it were passed. Also reads user lists in the same schema.
+    static bool read_snapshot(const std::string& file, uint64_t& seq,
+                              const std::function<void(UserRecord&&)>& sink, std::string& error);
+
+    // Copy of every account, in insertion order.
+    std::vector<UserRecord> all_records() const;
+
+    // Writes every account to `out_path` as a JSON snapshot that a JSON
+    // store loads as-is (temp + fsync + rename). False on I/O errors.
+    bool export_json(const std::string& out_path) const;
+
+    // Writes a snapshot now and empties the journal (normally done in the
+    // background; binary stores just sync). Returns false if the snapshot
+    // could not be written.
+    bool compact();
+
+    // Number of accounts currently indexed.
+    size_t size() const;
+
+    // File this store loads from and persists to.
+    const std::string& getPath() const { return path; }
+
+private:
+    // Applies every well-formed record of `file` with seq > `after_seq`.
+    void replay_journal(const std::string& file, uint64_t after_seq);
+
+    // Passes (seq, rehash, record) for each line of journal `file` to
+    // `sink`; `rehash` lines carry only the name and its new hash (see
+    // replace_hash()). Returns the offset past the last intact line if a
+    // torn one follows it, otherwise -1.
+    static off_t scan_journal(const std::string& file,
+                              const std::function<void(uint64_t, bool, UserRecord&&)>& sink);
+
+    // Index insert shared by load/replay/add. Caller holds the exclusive lock.
+    bool insert_locked(UserRecord&& rec);
+
+    // Journal append + index insert (JSON) or in-place append (binary).
+    bool append_record(UserRecord&& rec);
+
+    // Writes one journal line for `rec` (a rehash line when `rehash`).
+    // Caller holds the exclusive lock.
+    bool write_journal_locked(const UserRecord& rec, bool rehash);
+
+    // Binary format: maps the file, seeding it from import_from if new.
+    bool load_binary();
+
+    // Adds a freshly inserted name to the filter, first rebuilding it at
+    // twice the capacity if the store outgrew it. Caller holds the exclusive lock.
+    void filter_add_locked(std::string_view username);
+
+    // Replaces the filter with one sized for `capacity` holding every name.
+    // Caller holds the exclusive lock.
+    void rebuild_filter_locked(size_t capacity);
+
+    // Lock-free negative check; true if `username` may exist.
+    bool maybe_exists(std::string_view username) const;
+
+    // Writes `snapshot` with journal_seq = `seq` to `target` (temp + fsync + rename).
+    static bool write_snapshot(const std::vector<UserRecord>& snapshot, uint64_t seq,
+                               const std::string& target);
+
+    // Background thread body: periodic fdatasync + size-triggered compaction.
+    void background_loop();
+
+    std::string path;                                 // Snapshot file
+    std::string journal_path;                         // <path>.journal
+    Options options;
+
+    mutable std::shared_mutex mtx;                    // Readers shared, writers exclusive
+    std::vector<UserRecord> records;                  // Snapshot + journal order
+    std::unordered_map<std::string, size_t> index;    // username → position in `records`
+    std::unique_ptr<MappedCredentialFile> mapped;     // Binary format (guarded by mtx)
+
+    // Readers load `filter` without the lock. A rebuilt filter replaces it,
+    // and the old ones stay in `filters` until destruction so a reader that
+    // just loaded the pointer never touches freed memory (the sizes double,
+    // so all of them together cost at most twice the current one).
+    std::atomic<const BloomFilter*> filter{nullptr};
+    std::vector<std::unique_ptr<BloomFilter>> filters; // Guarded by mtx; current one last
+    uint64_t filter_seed{0};
+
+    std::mutex journal_mtx;                           // Guards journal_fd and the counters below
+    int journal_fd{-1};                               // O_APPEND handle on journal_path
+    uint64_t last_seq{0};                             // Highest seq written or recovered
+    size_t journal_records{0};                        // Lines in the current journal
+    bool journal_dirty{false};                        // Appended since the last fdatasync
+
+    std::mutex bg_mtx;                                // Guards `stopping` for the condvar
+    std::condition_variable bg_wake;                  // Shortens the wait on shutdown
+    bool stopping{false};
+    std::thread background;                           // Flusher + compactor
+};
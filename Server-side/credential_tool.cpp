@@ -0,0 +1,85 @@
+// ============================================================================
+// tcpserver-credentials — converts the user DB between its two formats.
+//
+//   tcpserver-credentials import <credentials.json> <credentials.db>
+//   tcpserver-credentials export <credentials.db> <credentials.json>
+//
+// import reads a JSON store (snapshot + journal) into a binary one, creating
+// it if needed and skipping names it already has. export writes a binary
+// store back as a JSON snapshot the JSON format loads unchanged. Stop the
+// server first: neither store is meant to be shared between processes.
+// ============================================================================
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "credential_store.hpp"
+
+namespace {
+
+int usage(const char* argv0)
+{
+    std::cerr << "usage: " << argv0 << " import <credentials.json> <credentials.db>\n"
+              << "       " << argv0 << " export <credentials.db> <credentials.json>\n";
+    return EXIT_FAILURE;
+}
+
+CredentialStore::Options binary_options()
+{
+    CredentialStore::Options options;
+    options.format = CredentialStore::Format::Binary;
+    return options;
+}
+
+int import_json(const std::string& json_path, const std::string& db_path)
+{
+    CredentialStore target(db_path, binary_options());
+    if (!target.load()) return EXIT_FAILURE; // Reason already printed
+
+    // Streamed: the JSON store is never loaded as a whole.
+    size_t imported = 0;
+    size_t read     = 0;
+    const bool parsed = target.import_json(json_path, imported, read);
+    if (!target.compact()) {
+        std::cerr << db_path << ": sync failed\n";
+        return EXIT_FAILURE;
+    }
+    if (!parsed) {
+        std::cerr << json_path << ": unreadable JSON credential DB (" << imported
+                  << " accounts before the error imported)\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Imported " << imported << " of " << read << " accounts into " << db_path;
+    if (imported < read) {
+        std::cout << " (" << read - imported << " skipped: already present or fields too long)";
+    }
+    std::cout << "\n";
+    return EXIT_SUCCESS;
+}
+
+int export_json(const std::string& db_path, const std::string& json_path)
+{
+    CredentialStore source(db_path, binary_options());
+    if (!source.load()) return EXIT_FAILURE;
+
+    if (!source.export_json(json_path)) {
+        std::cerr << json_path << ": write failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Exported " << source.size() << " accounts to " << json_path << "\n";
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 4) return usage(argv[0]);
+
+    const std::string command = argv[1];
+    if (command == "import") return import_json(argv[2], argv[3]);
+    if (command == "export") return export_json(argv[2], argv[3]);
+    return usage(argv[0]);
+}
@@ -0,0 +1,125 @@
+#include "crypto_pool.hpp"
+#include "server-header.hpp"
+#include "cpu_affinity.hpp"
+#include "password_hash.hpp"
+
+// Spawns the workers immediately; they sleep on `ready` until work arrives.
+// Each pins itself before its first job, so Argon2id's 64 MiB scratch area
+// comes from the worker's own NUMA node.
+CryptoPool::CryptoPool(size_t threads, size_t max_queued, const std::vector<int>& cpus)
+    : max_jobs(max_queued)
+{
+    if (threads == 0) threads = 1;
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        const int cpu = affinity::pick(cpus, i);
+        workers.emplace_back([this, cpu] {
+            affinity::pin_current_thread(cpu);
+            worker_loop();
+        });
+    }
+}
+
+CryptoPool::~CryptoPool()
+{
+    shutdown();
+}
+
+// Bounded enqueue: refusing is cheaper than letting a login storm queue
+// minutes of Argon2id work (and their plaintext passwords) in memory.
+bool CryptoPool::submit(Job&& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping || jobs.size() >= max_jobs) return false;
+        jobs.push_back(std::move(job));
+    }
+    ready.notify_one();
+    return true;
+}
+
+// Queued jobs are discarded (their clients are being disconnected anyway);
+// in-flight ones finish and post into mailboxes that are still alive.
+void CryptoPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping && workers.empty()) return;
+        stopping = true;
+        for (Job& job : jobs) sodium_memzero(&job.password[0], job.password.size());
+        jobs.clear();
+    }
+    ready.notify_all();
+
+    for (std::thread& t : workers) {
+        if (t.joinable()) t.join();
+    }
+    workers.clear();
+}
+
+// Does the actual Argon2id work and wipes the plaintext afterwards.
+void CryptoPool::execute(Job& job, MailboxMessage& out)
+{
+    out.type      = MailboxMessage::AuthComplete;
+    out.origin_fd = job.fd;
+    out.conn_id   = job.conn_id;
+    out.username  = job.username;
+
+    try {
+        if (job.kind == Job::Hash) {
+            out.password_hash = TcpServer::hash_password(job.password);
+            out.ok            = true;
+        } else {
+            out.ok = !job.stored_hash.empty() &&
+                     TcpServer::verify_password(job.password, job.stored_hash);
+            job.upgrade = out.ok && job.rehash && password::needs_rehash(job.stored_hash);
+        }
+    } catch (const std::exception&) {
+        out.ok = false; // hash_password throws only under memory pressure
+    }
+
+    if (job.upgrade) return; // rehash() still needs the password
+    if (!job.password.empty()) sodium_memzero(&job.password[0], job.password.size());
+}
+
+MailboxMessage* CryptoPool::rehash(Job& job)
+{
+    MailboxMessage* out = nullptr;
+    try {
+        out                = new MailboxMessage;
+        out->type          = MailboxMessage::PasswordRehashed;
+        out->username      = job.username;
+        out->password_hash = TcpServer::hash_password(job.password);
+        out->stored_hash   = std::move(job.stored_hash);
+    } catch (const std::exception&) {
+        delete out; // The old hash keeps working; the next login retries
+        out = nullptr;
+    }
+    job.upgrade = false;
+    if (!job.password.empty()) sodium_memzero(&job.password[0], job.password.size());
+    return out;
+}
+
+// Each worker handles one job at a time; the result envelope is owned by
+// the receiving reactor from the moment it is pushed.
+void CryptoPool::worker_loop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        auto* msg = new MailboxMessage;
+        execute(job, *msg);
+        job.reply->push(msg);
+        if (job.upgrade) {
+            if (MailboxMessage* rehashed = rehash(job)) job.reply->push(rehashed);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mailbox.hpp"
+
+// ============================================================================
+// CryptoPool — bounded worker pool for Argon2id hashing/verification.
+// crypto_pwhash_* costs tens of milliseconds and 64 MiB per call, so doing it
+// inside process_message() froze every connected user. Reactors submit a Job
+// and keep serving; the result comes back as an AuthComplete message on the
+// submitting reactor's mailbox (whose eventfd wakes its epoll_wait()).
+// One pool per process, shared by every reactor.
+// ============================================================================
+class CryptoPool {
+public:
+    // One unit of Argon2id work plus the address to deliver the answer to.
+    struct Job {
+        enum Kind {
+            Hash,   // Produce a new encoded hash for `password` (/register)
+            Verify  // Check `password` against `stored_hash` (/login)
+        };
+
+        Kind kind{Verify};
+        std::string username{};    // Echoed back so the reactor can finish the flow
+        std::string password{};    // Plaintext — wiped right after use
+        std::string stored_hash{}; // Verify only
+        Mailbox* reply{nullptr};   // Submitting reactor's mailbox
+        int fd{-1};                // Client fd on that reactor
+        uint64_t conn_id{0};       // Detects a client that went away meanwhile
+        bool rehash{false};        // Verify only: upgrade `stored_hash` once it verified
+        bool upgrade{false};       // Set by execute(): it did, at another cost (see rehash())
+    };
+
+    // Starts `threads` workers; at most `max_queued` jobs wait at any time.
+    // Worker N pins itself to affinity::pick(cpus, N) ([PROCESS] crypto_cpus).
+    CryptoPool(size_t threads, size_t max_queued, const std::vector<int>& cpus = {});
+
+    // Stops the workers (see shutdown()).
+    ~CryptoPool();
+
+    CryptoPool(const CryptoPool&) = delete;
+    CryptoPool& operator=(const CryptoPool&) = delete;
+
+    // Queues `job`. Returns false without queueing when the pool is saturated
+    // (or stopping) — the caller should tell the client to retry later.
+    bool submit(Job&& job);
+
+    // Drops jobs that haven't started, waits for running ones and joins the
+    // workers. Call before the reactors (and their mailboxes) are destroyed.
+    // Idempotent.
+    void shutdown();
+
+    // Runs `job` on the calling thread and fills `out` as an AuthComplete
+    // message (ok + password_hash). Also used for inline execution when a
+    // server runs without a pool.
+    static void execute(Job& job, MailboxMessage& out);
+
+    // After an execute() that set `upgrade`: hashes the password again at
+    // the current cost and wipes it. The PasswordRehashed message for the
+    // reactor, or null if hashing failed. Workers run it right after
+    // posting the AuthComplete, so the login never waits for it.
+    static MailboxMessage* rehash(Job& job);
+
+private:
+    // Worker thread body: pop → execute → post the result to job.reply.
+    void worker_loop();
+
+    std::mutex mtx;                 // Guards `jobs` and `stopping`
+    std::condition_variable ready;  // Signalled on submit() and shutdown()
+    std::deque<Job> jobs;           // Pending work (bounded by max_jobs)
+    size_t max_jobs;                // Backpressure limit for submit()
+    bool stopping{false};           // true → workers exit, submit() refuses
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+// std::max
+#include <algorithm>
+// std::unique_ptr — objects never move while registered
+#include <memory>
+// Slot array and free list
+#include <vector>
+
+// ============================================================================
+// FdTable — per-connection objects indexed directly by socket fd.
+//
+// The kernel always hands out the lowest free descriptor, so live fds are
+// small, dense integers and a plain vector of slots replaces the hash map:
+// a lookup is one bounds check and one load. Each object sits in its own
+// allocation and keeps its address while registered (intrusive timers link
+// into it). Released objects go to a bounded free list; the next insert()
+// reuses one after T::recycle(), which resets it but keeps the buffers it
+// owns, so steady connection churn doesn't touch the allocator.
+// ============================================================================
+template <typename T>
+class FdTable {
+public:
+    explicit FdTable(size_t pool_limit = 1024) : max_pooled(pool_limit) {}
+
+    // The object registered at `fd`, or nullptr.
+    T* find(int fd) const
+    {
+        return fd >= 0 && static_cast<size_t>(fd) < slots.size() ? slots[fd].get() : nullptr;
+    }
+
+    // Registers a fresh object at `fd` (which must be free) and returns it.
+    T& insert(int fd)
+    {
+        if (static_cast<size_t>(fd) >= slots.size()) {
+            slots.resize(std::max(static_cast<size_t>(fd) + 1, slots.size() * 2));
+        }
+
+        std::unique_ptr<T>& slot = slots[fd];
+        if (!pool.empty()) {
+            slot = std::move(pool.back());
+            pool.pop_back();
+        } else {
+            slot = std::make_unique<T>();
+        }
+        ++count;
+        return *slot;
+    }
+
+    // Unregisters `fd`; its object is recycled into the pool (or freed).
+    void erase(int fd)
+    {
+        if (!find(fd)) return;
+        std::unique_ptr<T> obj = std::move(slots[fd]);
+        --count;
+        if (pool.size() < max_pooled) {
+            obj->recycle();
+            pool.push_back(std::move(obj));
+        }
+    }
+
+    // Calls f(fd, object) for every registered object, in fd order.
+    // `f` must not insert or erase.
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (size_t fd = 0; fd < slots.size(); ++fd) {
+            if (slots[fd]) f(static_cast<int>(fd), *slots[fd]);
+        }
+    }
+
+    size_t size()  const { return count; }
+    bool   empty() const { return count == 0; }
+
+private:
+    std::vector<std::unique_ptr<T>> slots; // Index = fd; null = free
+    std::vector<std::unique_ptr<T>> pool;  // Recycled objects ready for reuse
+    size_t max_pooled;                     // Free-list bound
+    size_t count{0};                       // Registered objects
+};
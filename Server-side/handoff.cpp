@@ -0,0 +1,427 @@
+#include "handoff.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+extern char** environ;
+
+namespace handoff {
+
+namespace {
+
+constexpr const char* UPGRADE_ENV  = "TCPSERVER_UPGRADE_FD";
+constexpr int SD_LISTEN_FDS_START  = 3;
+constexpr size_t FDS_PER_MESSAGE   = 250; // SCM_MAX_FD is 253
+constexpr uint64_t MAX_STATE_BYTES = uint64_t{1} << 32;
+constexpr int IO_TIMEOUT_S         = 30;  // One side stuck must not hang the other
+
+bool write_exact(int fd, const char* in, size_t len)
+{
+    while (len) {
+        ssize_t n = ::send(fd, in, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        in += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool read_exact(int fd, char* out, size_t len)
+{
+    while (len) {
+        ssize_t n = ::recv(fd, out, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        out += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void set_timeouts(int fd)
+{
+    timeval tv{};
+    tv.tv_sec = IO_TIMEOUT_S;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void put_u32(std::string& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_u64(std::string& out, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void put_str(std::string& out, const std::string& s)
+{
+    put_u32(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+// Bounds-checked reader over the received state.
+struct Reader {
+    const char* p;
+    const char* end;
+
+    bool u8(uint8_t& v)
+    {
+        if (end - p < 1) return false;
+        v = static_cast<uint8_t>(*p++);
+        return true;
+    }
+
+    bool u32(uint32_t& v)
+    {
+        if (end - p < 4) return false;
+        v = 0;
+        for (int i = 0; i < 4; ++i) v |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        p += 4;
+        return true;
+    }
+
+    bool str(std::string& s)
+    {
+        uint32_t len;
+        if (!u32(len) || static_cast<size_t>(end - p) < len) return false;
+        s.assign(p, len);
+        p += len;
+        return true;
+    }
+};
+
+uint32_t get_u32(const char* p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+uint64_t get_u64(const char* p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+bool send_fds(int sock, const int* fds, size_t count)
+{
+    char tag = 'F';
+    iovec iov{&tag, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = control.size();
+
+    cmsghdr* cmsg   = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * count);
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+
+    while (true) {
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        return n == 1;
+    }
+}
+
+// One 'F' byte and the fds riding on it (exactly one byte is read, so the
+// ancillary data can't be merged with the next message).
+bool recv_fds(int sock, std::vector<int>& out)
+{
+    char tag = 0;
+    iovec iov{&tag, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * FDS_PER_MESSAGE));
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1) return false;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const size_t first = out.size();
+        out.resize(first + count);
+        std::memcpy(out.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+    }
+    return tag == 'F' && !(msg.msg_flags & MSG_CTRUNC);
+}
+
+} // namespace
+
+std::vector<int> systemd_listen_fds()
+{
+    std::vector<int> fds;
+    const char* pid   = std::getenv("LISTEN_PID");
+    const char* count = std::getenv("LISTEN_FDS");
+    if (pid && count && std::strtol(pid, nullptr, 10) == static_cast<long>(getpid())) {
+        long n = std::strtol(count, nullptr, 10);
+        for (long i = 0; i < n && i < 64; ++i) {
+            int fd = SD_LISTEN_FDS_START + static_cast<int>(i);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fds.push_back(fd);
+        }
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    return fds;
+}
+
+void notify_systemd(const std::string& state)
+{
+    const char* path = std::getenv("NOTIFY_SOCKET");
+    if (!path || !*path) return;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const size_t len = std::strlen(path);
+    if (len >= sizeof(addr.sun_path)) return;
+    std::memcpy(addr.sun_path, path, len);
+    if (addr.sun_path[0] == '@') addr.sun_path[0] = '\0'; // Abstract namespace
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    sendto(fd, state.data(), state.size(), MSG_NOSIGNAL, reinterpret_cast<sockaddr*>(&addr),
+           static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len));
+    close(fd);
+}
+
+int upgrade_socket()
+{
+    const char* value = std::getenv(UPGRADE_ENV);
+    int fd = value ? static_cast<int>(std::strtol(value, nullptr, 10)) : -1;
+    unsetenv(UPGRADE_ENV);
+    if (fd < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) return -1;
+    set_timeouts(fd);
+    return fd;
+}
+
+bool acknowledge(int sock, char what)
+{
+    return write_exact(sock, &what, 1);
+}
+
+bool receive(int sock, std::vector<int>& listeners, std::vector<ClientState>& clients,
+             std::string& error)
+{
+    auto fail = [&](const char* why, std::vector<int>& fds) {
+        for (int fd : fds) close(fd);
+        error = why;
+        return false;
+    };
+
+    std::vector<int> fds;
+    char header[9];
+    if (!read_exact(sock, header, sizeof(header)) || header[0] != 'H') {
+        return fail("no handoff header", fds);
+    }
+    const size_t listener_count = get_u32(header + 1);
+    const size_t client_count   = get_u32(header + 5);
+
+    while (fds.size() < listener_count + client_count) {
+        if (!recv_fds(sock, fds)) return fail("file descriptors lost in transfer", fds);
+    }
+    if (fds.size() != listener_count + client_count) return fail("unexpected file descriptors", fds);
+
+    char state_header[9];
+    if (!read_exact(sock, state_header, sizeof(state_header)) || state_header[0] != 'S') {
+        return fail("no client state", fds);
+    }
+    const uint64_t length = get_u64(state_header + 1);
+    if (length > MAX_STATE_BYTES) return fail("client state too large", fds);
+    std::string state(static_cast<size_t>(length), '\0');
+    if (!read_exact(sock, state.data(), state.size())) return fail("client state truncated", fds);
+
+    std::vector<ClientState> parsed(client_count);
+    Reader in{state.data(), state.data() + state.size()};
+    for (size_t i = 0; i < client_count; ++i) {
+        ClientState& c = parsed[i];
+        uint32_t channel_count;
+        if (!in.str(c.username) || !in.u8(c.protocol) || !in.u32(channel_count)) {
+            return fail("client state corrupt", fds);
+        }
+        c.capabilities = c.protocol >> 4; // Packed with the version (see below)
+        c.protocol &= 0x0F;
+        for (uint32_t j = 0; j < channel_count; ++j) {
+            std::string name;
+            if (!in.str(name)) return fail("client state corrupt", fds);
+            c.channels.push_back(std::move(name));
+        }
+        if (!in.str(c.unread) || !in.str(c.unsent)) return fail("client state corrupt", fds);
+        c.fd = fds[listener_count + i];
+    }
+
+    listeners.assign(fds.begin(), fds.begin() + static_cast<std::ptrdiff_t>(listener_count));
+    clients = std::move(parsed);
+    return true;
+}
+
+Successor::~Successor()
+{
+    if (sock >= 0) close(sock);
+}
+
+bool Successor::spawn(std::string& error)
+{
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        error = std::string("readlink(/proc/self/exe): ") + strerror(errno);
+        return false;
+    }
+    // A deploy replaced the file: exec the new one at the same path.
+    std::string exe(path, static_cast<size_t>(len));
+    const std::string deleted = " (deleted)";
+    if (exe.size() > deleted.size() && exe.compare(exe.size() - deleted.size(), deleted.size(), deleted) == 0) {
+        exe.resize(exe.size() - deleted.size());
+    }
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1) {
+        error = std::string("socketpair: ") + strerror(errno);
+        return false;
+    }
+
+    // Everything the child needs is built before fork(): in a threaded
+    // process only async-signal-safe calls may follow it.
+    const std::string prefix = std::string(UPGRADE_ENV) + "=";
+    std::string fd_var = prefix + std::to_string(pair[1]);
+    std::vector<char*> envp;
+    for (char** e = environ; *e; ++e) {
+        if (std::strncmp(*e, prefix.c_str(), prefix.size()) != 0) envp.push_back(*e);
+    }
+    envp.push_back(fd_var.data());
+    envp.push_back(nullptr);
+    char* argv[] = {exe.data(), nullptr};
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        error = std::string("fork: ") + strerror(errno);
+        close(pair[0]);
+        close(pair[1]);
+        return false;
+    }
+    if (pid == 0) {
+        fcntl(pair[1], F_SETFD, 0); // Survives the exec
+        execve(exe.c_str(), argv, envp.data());
+        _exit(127);
+    }
+
+    close(pair[1]);
+    sock  = pair[0];
+    child = pid;
+    set_timeouts(sock);
+    return true;
+}
+
+bool Successor::wait_for(char what, int timeout_ms, std::string& error)
+{
+    pollfd p{sock, POLLIN, 0};
+    int ready;
+    do {
+        ready = poll(&p, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready == 0) {
+        error = "timed out";
+        return false;
+    }
+
+    char got = 0;
+    if (ready < 0 || !read_exact(sock, &got, 1)) {
+        error = "successor exited";
+        return false;
+    }
+    if (got != what) {
+        error = "unexpected reply";
+        return false;
+    }
+    return true;
+}
+
+bool Successor::transfer(const std::vector<int>& listeners, const std::vector<ClientState>& clients,
+                         std::string& error)
+{
+    std::string header(1, 'H');
+    put_u32(header, static_cast<uint32_t>(listeners.size()));
+    put_u32(header, static_cast<uint32_t>(clients.size()));
+    if (!write_exact(sock, header.data(), header.size())) {
+        error = "successor stopped reading";
+        return false;
+    }
+
+    std::vector<int> fds(listeners);
+    for (const ClientState& c : clients) fds.push_back(c.fd);
+    for (size_t i = 0; i < fds.size(); i += FDS_PER_MESSAGE) {
+        size_t count = fds.size() - i < FDS_PER_MESSAGE ? fds.size() - i : FDS_PER_MESSAGE;
+        if (!send_fds(sock, fds.data() + i, count)) {
+            error = std::string("sendmsg(SCM_RIGHTS): ") + strerror(errno);
+            return false;
+        }
+    }
+
+    std::string state;
+    for (const ClientState& c : clients) {
+        put_str(state, c.username);
+        // Capabilities in the high nibble: a predecessor that predates them
+        // sends 0 there, so its state still parses.
+        state.push_back(static_cast<char>(c.protocol | (c.capabilities << 4)));
+        put_u32(state, static_cast<uint32_t>(c.channels.size()));
+        for (const std::string& name : c.channels) put_str(state, name);
+        put_str(state, c.unread);
+        put_str(state, c.unsent);
+    }
+    std::string state_header(1, 'S');
+    put_u64(state_header, state.size());
+    if (!write_exact(sock, state_header.data(), state_header.size()) ||
+        !write_exact(sock, state.data(), state.size())) {
+        error = "successor stopped reading";
+        return false;
+    }
+    return true;
+}
+
+void Successor::abandon()
+{
+    if (child > 0) {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    release();
+}
+
+void Successor::release()
+{
+    if (sock >= 0) close(sock);
+    sock  = -1;
+    child = -1;
+}
+
+} // namespace handoff
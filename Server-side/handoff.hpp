@@ -0,0 +1,113 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Process handoff — restarts and deploys without dropping connections.
+//
+// Two ways for a starting server to get its listening socket(s) without
+// binding them itself:
+//
+//  * systemd socket activation (tcpserver.socket): systemd_listen_fds()
+//    takes the sockets passed in LISTEN_FDS. They outlive the service, so a
+//    restart only queues new connections in the kernel for a moment.
+//
+//  * Hot upgrade (SIGUSR2): the running server starts its successor — the
+//    binary now installed at its own path — with one end of a socketpair in
+//    TCPSERVER_UPGRADE_FD. Once the successor has loaded its config it
+//    answers READY; the old server pauses its loops and sends the
+//    listeners, every client socket (SCM_RIGHTS) and each client's state:
+//    username, channels, input not processed yet, output not written yet.
+//    The successor adopts them and answers ADOPTED, then the old process
+//    closes its copies and exits. Clients see a pause, not a disconnect.
+//    Until ADOPTED arrives nothing is lost: a successor that fails or times
+//    out is killed and the old server resumes.
+//
+// Wire format on the socketpair (all integers little-endian):
+//   successor → server: 'R' (READY), later 'A' (ADOPTED)
+//   server → successor: 'H' u32 listeners u32 clients,
+//                       'F' + SCM_RIGHTS with up to FDS_PER_MESSAGE fds (repeated;
+//                           listeners first, then clients in order),
+//                       'S' u64 length, then `length` bytes of client state.
+// ============================================================================
+namespace handoff {
+
+// What a client socket carries across the handoff besides its fd.
+struct ClientState {
+    int fd{-1};
+    std::string username;              // Empty: not logged in
+    uint8_t protocol{0};               // protocol::Version
+    uint8_t capabilities{0};           // protocol::CAP_* the client negotiated
+    std::vector<std::string> channels; // Joined channels, current one last
+    std::string unread;                // Received, not processed yet
+    std::string unsent;                // Queued for the client, not written yet
+};
+
+constexpr char READY   = 'R';
+constexpr char ADOPTED = 'A';
+
+// Listening sockets passed by systemd (LISTEN_PID/LISTEN_FDS, from fd 3),
+// made close-on-exec; empty when not socket-activated. Clears the
+// variables so a successor doesn't see them. Call before starting threads.
+std::vector<int> systemd_listen_fds();
+
+// sd_notify(3) without libsystemd: sends `state` (e.g. "READY=1") to
+// $NOTIFY_SOCKET. No-op when not started by systemd with Type=notify.
+void notify_systemd(const std::string& state);
+
+// The socketpair end of a successor started by Successor::spawn(), or -1
+// for a normal start. Clears TCPSERVER_UPGRADE_FD. Call before threads.
+int upgrade_socket();
+
+// Successor side: receives the listeners and the clients after READY.
+// Every fd arrives non-blocking (shared file status) and close-on-exec.
+bool receive(int sock, std::vector<int>& listeners, std::vector<ClientState>& clients,
+             std::string& error);
+
+// Successor side: sends READY or ADOPTED.
+bool acknowledge(int sock, char what);
+
+// Running server side of one hot upgrade.
+class Successor {
+public:
+    Successor() = default;
+    ~Successor();
+
+    Successor(const Successor&) = delete;
+    Successor& operator=(const Successor&) = delete;
+
+    // Starts the binary at this process's own path (the one installed now,
+    // not the image that is running).
+    bool spawn(std::string& error);
+
+    // Waits for READY / ADOPTED. False on timeout, EOF (the successor
+    // exited) or any other byte.
+    bool wait_ready(int timeout_ms, std::string& error) { return wait_for(READY, timeout_ms, error); }
+    bool wait_adopted(int timeout_ms, std::string& error) { return wait_for(ADOPTED, timeout_ms, error); }
+
+    // Sends the listeners and the clients (whose `fd` fields are ignored in
+    // favour of their order).
+    bool transfer(const std::vector<int>& listeners, const std::vector<ClientState>& clients,
+                  std::string& error);
+
+    // After a failure: kills and reaps the successor.
+    void abandon();
+
+    // After ADOPTED: forgets the successor, which now runs on its own.
+    void release();
+
+    bool active() const { return child > 0; }
+    pid_t pid() const { return child; }
+
+private:
+    bool wait_for(char what, int timeout_ms, std::string& error);
+
+    pid_t child{-1};
+    int sock{-1};
+};
+
+} // namespace handoff
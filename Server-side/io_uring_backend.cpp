@@ -0,0 +1,278 @@
+#include "io_uring_backend.hpp"
+#include "recv_arena.hpp"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* p)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       const void* arg, size_t argsz)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                                    arg, argsz));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+[[noreturn]] void fail(const char* what)
+{
+    throw std::runtime_error(std::string(what) + ": " + strerror(errno));
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries, unsigned buffers, unsigned buffer_size, bool huge_pages)
+{
+    // Cheapest task-run mode first; older kernels reject the newer flags.
+    io_uring_params params{};
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN |
+                   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    ring_fd = sys_io_uring_setup(entries, &params);
+    if (ring_fd < 0 && errno == EINVAL) {
+        params = io_uring_params{};
+        ring_fd = sys_io_uring_setup(entries, &params);
+    }
+    if (ring_fd < 0) fail("io_uring_setup");
+
+    // Everything below is required by the event loop (5.19+ kernels).
+    const unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & needed) != needed) {
+        ::close(ring_fd);
+        errno = ENOSYS;
+        fail("io_uring features");
+    }
+
+    // SQ and CQ rings share one mapping (IORING_FEAT_SINGLE_MMAP).
+    sq_map_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (cq_len > sq_map_len) sq_map_len = cq_len;
+
+    sq_ptr = mmap(nullptr, sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        sq_ptr = nullptr;
+        ::close(ring_fd);
+        fail("mmap(SQ ring)");
+    }
+    sqes_map_len = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_mem = mmap(nullptr, sqes_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring_fd, IORING_OFF_SQES);
+    if (sqe_mem == MAP_FAILED) {
+        munmap(sq_ptr, sq_map_len);
+        ::close(ring_fd);
+        fail("mmap(SQEs)");
+    }
+    sqes = static_cast<io_uring_sqe*>(sqe_mem);
+
+    char* sq = static_cast<char*>(sq_ptr);
+    sq_head    = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail    = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array   = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask    = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sqe_tail = sqe_submitted = *sq_tail;
+
+    char* cq = sq;
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes    = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Provided buffers: the kernel picks one per recv completion, so idle
+    // connections don't pin a receive buffer each. Every completion reads
+    // one, so the area goes on a huge page when there is one.
+    buffer_count = buffers;
+    buffer_len   = buffer_size;
+    buf_ring_len = buffers * sizeof(io_uring_buf);
+    void* br = mmap(nullptr, buf_ring_len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    buffer_area_len = size_t(buffers) * buffer_size;
+    bool huge  = false;
+    void* area = map_buffer_area(buffer_area_len, huge_pages, huge);
+    if (br == MAP_FAILED || area == MAP_FAILED) {
+        if (br != MAP_FAILED) munmap(br, buf_ring_len);
+        if (area != MAP_FAILED) munmap(area, buffer_area_len);
+        munmap(sqes, sqes_map_len);
+        munmap(sq_ptr, sq_map_len);
+        ::close(ring_fd);
+        fail("mmap(buffer ring)");
+    }
+    buf_ring    = static_cast<io_uring_buf_ring*>(br);
+    buffer_base = static_cast<char*>(area);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr    = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = buffers;
+    reg.bgid         = 0;
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int saved = errno;
+        munmap(buf_ring, buf_ring_len);
+        munmap(buffer_base, buffer_area_len);
+        munmap(sqes, sqes_map_len);
+        munmap(sq_ptr, sq_map_len);
+        ::close(ring_fd);
+        errno = saved;
+        fail("IORING_REGISTER_PBUF_RING");
+    }
+
+    for (unsigned bid = 0; bid < buffers; ++bid) recycle_buffer(static_cast<uint16_t>(bid));
+}
+
+// Closing the ring fd cancels whatever is still in flight.
+IoUring::~IoUring()
+{
+    if (ring_fd != -1) ::close(ring_fd);
+    if (buf_ring)    munmap(buf_ring, buf_ring_len);
+    if (buffer_base) munmap(buffer_base, buffer_area_len);
+    if (sqes)        munmap(sqes, sqes_map_len);
+    if (sq_ptr)      munmap(sq_ptr, sq_map_len);
+}
+
+// Returns a zeroed SQE; when the SQ is full the pending batch is pushed first.
+io_uring_sqe* IoUring::next_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries) {
+        submit();
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sqe_tail - head >= sq_entries) {
+            // Kernel still holds them all (SUBMIT_ALL hit an error): wait a tick.
+            sys_io_uring_enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+    }
+
+    unsigned idx = sqe_tail & sq_mask;
+    io_uring_sqe* sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    ++sqe_tail;
+    return sqe;
+}
+
+void IoUring::prep_accept_multishot(int listen_fd, uint64_t user_data)
+{
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = listen_fd;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data    = user_data;
+}
+
+void IoUring::prep_cancel(uint64_t target, uint64_t user_data)
+{
+    io_uring_sqe* sqe      = next_sqe();
+    sqe->opcode            = IORING_OP_ASYNC_CANCEL;
+    sqe->fd                = -1;
+    sqe->addr              = target;
+    sqe->cancel_flags      = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data         = user_data;
+}
+
+void IoUring::prep_recv_multishot(int fd, uint64_t user_data)
+{
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_poll(int fd, unsigned mask, uint64_t user_data)
+{
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode       = IORING_OP_POLL_ADD;
+    sqe->fd           = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data    = user_data;
+}
+
+void IoUring::prep_poll_multishot(int fd, unsigned mask, uint64_t user_data)
+{
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode       = IORING_OP_POLL_ADD;
+    sqe->fd           = fd;
+    sqe->len          = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = mask;
+    sqe->user_data    = user_data;
+}
+
+void IoUring::prep_send(int fd, const void* data, size_t len, uint64_t user_data, bool link)
+{
+    io_uring_sqe* sqe = next_sqe();
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = fd;
+    sqe->addr      = reinterpret_cast<uint64_t>(data);
+    sqe->len       = static_cast<uint32_t>(len);
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->flags     = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = user_data;
+}
+
+// Publishes the locally filled SQEs to the kernel-visible tail.
+bool IoUring::submit()
+{
+    if (sqe_tail == __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) return true;
+
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    sqe_submitted = sqe_tail;
+    // Count from the kernel's head: entries it refused last time are retried.
+    unsigned pending = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    while (true) {
+        int r = sys_io_uring_enter(ring_fd, pending, 0, 0, nullptr, 0);
+        if (r >= 0) return true;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EBUSY) return true; // Retried on the next enter
+        return false;
+    }
+}
+
+bool IoUring::submit_and_wait(int timeout_ms)
+{
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+    sqe_submitted = sqe_tail;
+    unsigned pending = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+    __kernel_timespec ts{};
+    ts.tv_sec  = timeout_ms / 1000;
+    ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int r = sys_io_uring_enter(ring_fd, pending, 1,
+                               IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (r >= 0) return true;
+    return errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY;
+}
+
+// Hands buffer `bid` back to the kernel (group 0). Slots are indexed from
+// the ring base: in C++ the uapi header's flexible `bufs` member lands at
+// offset 8 instead of 0, which would shift every entry off the ABI layout.
+void IoUring::recycle_buffer(uint16_t bid)
+{
+    io_uring_buf* slot = reinterpret_cast<io_uring_buf*>(buf_ring) + (buf_tail & (buffer_count - 1));
+    slot->addr = reinterpret_cast<uint64_t>(buffer_base + size_t(bid) * buffer_len);
+    slot->len  = buffer_len;
+    slot->bid  = bid;
+    ++buf_tail;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
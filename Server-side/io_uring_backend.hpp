@@ -0,0 +1,123 @@
+#pragma once
+
+// io_uring ABI: io_uring_params, io_uring_sqe/cqe, IORING_* flags
+#include <linux/io_uring.h>
+// uint64_t, uint32_t, uint16_t
+#include <cstdint>
+// size_t
+#include <cstddef>
+
+// ============================================================================
+// IoUring — minimal io_uring driver on the raw syscalls (no liburing).
+//
+// Wraps exactly what the reactor needs: one submission/completion ring pair,
+// one provided-buffer ring for multishot recv, and prep helpers for the ops
+// TcpServer issues (multishot accept/recv/poll, send). SQEs are batched: they
+// are only handed to the kernel by submit_and_wait(), once per loop
+// iteration, so a whole broadcast costs one io_uring_enter().
+// Single-threaded: owned and driven by one reactor.
+// ============================================================================
+class IoUring {
+public:
+    // Sets up a ring with `entries` SQ slots (CQ is twice that) and a buffer
+    // ring of `buffers` × `buffer_size` bytes in group 0 (`buffers` must be a
+    // power of two), on huge pages if `huge_pages` and the pool has one to
+    // spare (see map_buffer_area()). Throws std::runtime_error if io_uring
+    // is unavailable.
+    IoUring(unsigned entries, unsigned buffers, unsigned buffer_size, bool huge_pages = false);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Multishot accept on `listen_fd`; accepted sockets are non-blocking.
+    void prep_accept_multishot(int listen_fd, uint64_t user_data);
+
+    // Cancels every request tagged `target` (IORING_ASYNC_CANCEL_ALL);
+    // they complete with -ECANCELED.
+    void prep_cancel(uint64_t target, uint64_t user_data);
+
+    // Multishot recv on `fd` into the provided buffer ring.
+    void prep_recv_multishot(int fd, uint64_t user_data);
+
+    // One-shot poll for `mask` on `fd` (completes once it is ready).
+    void prep_poll(int fd, unsigned mask, uint64_t user_data);
+
+    // Multishot poll for `mask` (POLLIN...) on `fd`.
+    void prep_poll_multishot(int fd, unsigned mask, uint64_t user_data);
+
+    // Sends `len` bytes (MSG_WAITALL: short only on error). `link` chains
+    // the next SQE behind this one, so queued payloads go out in order.
+    void prep_send(int fd, const void* data, size_t len, uint64_t user_data, bool link);
+
+    // Pushes pending SQEs and waits up to `timeout_ms` for one completion.
+    // Returns false only on a hard io_uring_enter() error (errno set).
+    bool submit_and_wait(int timeout_ms);
+
+    // Pushes pending SQEs without waiting.
+    bool submit();
+
+    // Calls fn(const io_uring_cqe&) for every available completion, then
+    // releases them all to the kernel. Returns how many were handled.
+    template <typename Fn>
+    unsigned for_each_cqe(Fn&& fn)
+    {
+        // Shared indices are used with GCC atomic builtins (acquire/release).
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned seen = 0;
+        while (head != tail) {
+            fn(cqes[head & cq_mask]);
+            ++head;
+            ++seen;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return seen;
+    }
+
+    // Provided buffer `bid` (from a recv CQE) and its return to the ring.
+    const char* buffer(uint16_t bid) const { return buffer_base + size_t(bid) * buffer_len; }
+    void recycle_buffer(uint16_t bid);
+
+    // Buffer id carried by a recv CQE, or -1 if none was selected.
+    static int cqe_buffer(const io_uring_cqe& cqe)
+    {
+        return (cqe.flags & IORING_CQE_F_BUFFER) ? int(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    }
+
+    // True if the CQE's multishot request stays armed.
+    static bool cqe_more(const io_uring_cqe& cqe) { return cqe.flags & IORING_CQE_F_MORE; }
+
+private:
+    io_uring_sqe* next_sqe(); // Flushes to the kernel if the SQ is full
+
+    int ring_fd{-1};
+
+    // Submission queue (shared with the kernel)
+    void* sq_ptr{nullptr};
+    size_t sq_map_len{0};
+    unsigned* sq_head{nullptr};
+    unsigned* sq_tail{nullptr};
+    unsigned* sq_array{nullptr};
+    unsigned sq_mask{0};
+    unsigned sq_entries{0};
+    io_uring_sqe* sqes{nullptr};
+    size_t sqes_map_len{0};
+    unsigned sqe_tail{0};      // Local tail: SQEs filled but not yet published
+    unsigned sqe_submitted{0}; // Published tail
+
+    // Completion queue (same mapping as the SQ ring)
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned cq_mask{0};
+    io_uring_cqe* cqes{nullptr};
+
+    // Provided buffer ring (group 0)
+    io_uring_buf_ring* buf_ring{nullptr};
+    size_t buf_ring_len{0};
+    char* buffer_base{nullptr};
+    size_t buffer_area_len{0};
+    unsigned buffer_count{0};
+    unsigned buffer_len{0};
+    uint16_t buf_tail{0};
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+// uint64_t — the two halves of the 128-bit key
+#include <cstdint>
+// memcpy()
+#include <cstring>
+// size_t / std::hash
+#include <functional>
+// sockaddr, sockaddr_in, sockaddr_in6, AF_INET, AF_INET6
+#include <netinet/in.h>
+#include <sys/socket.h>
+// inet_ntop() — printable form for logs
+#include <arpa/inet.h>
+// std::string
+#include <string>
+
+// ============================================================================
+// IpKey — a peer address as a fixed 16-byte value, usable as a hash key.
+// IPv4 peers are stored in their IPv4-mapped IPv6 form (::ffff:a.b.c.d), so
+// one map serves both families and the same host always gets the same key
+// whichever socket family accepted it. Comparing two keys is two integer
+// compares — no string formatting on the accept path.
+// ============================================================================
+struct IpKey {
+    uint64_t hi{0}; // Bytes 0..7 of the IPv6 (or mapped IPv4) address
+    uint64_t lo{0}; // Bytes 8..15
+
+    // Builds the key from an accept()/getpeername() result. Unknown families
+    // all collapse to the zero key.
+    static IpKey from_sockaddr(const sockaddr* sa)
+    {
+        unsigned char bytes[16] = {0};
+        if (sa->sa_family == AF_INET) {
+            const auto* in4 = reinterpret_cast<const sockaddr_in*>(sa);
+            bytes[10] = 0xff;
+            bytes[11] = 0xff;
+            std::memcpy(bytes + 12, &in4->sin_addr.s_addr, 4);
+        } else if (sa->sa_family == AF_INET6) {
+            const auto* in6 = reinterpret_cast<const sockaddr_in6*>(sa);
+            std::memcpy(bytes, &in6->sin6_addr, 16);
+        }
+
+        IpKey key;
+        std::memcpy(&key.hi, bytes, 8);
+        std::memcpy(&key.lo, bytes + 8, 8);
+        return key;
+    }
+
+    // Printable address: dotted quad for (mapped) IPv4, RFC 5952 for IPv6.
+    // Only formatted when needed (logs, the user DB), never stored.
+    std::string to_string() const
+    {
+        char text[INET6_ADDRSTRLEN];
+        return format(text);
+    }
+
+    // Same, into a caller's buffer (the accept path logs without allocating).
+    const char* format(char (&text)[INET6_ADDRSTRLEN]) const
+    {
+        unsigned char bytes[16];
+        std::memcpy(bytes, &hi, 8);
+        std::memcpy(bytes + 8, &lo, 8);
+
+        text[0] = '\0';
+        static const unsigned char mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        if (std::memcmp(bytes, mapped, sizeof(mapped)) == 0) {
+            inet_ntop(AF_INET, bytes + 12, text, INET6_ADDRSTRLEN);
+        } else {
+            inet_ntop(AF_INET6, bytes, text, INET6_ADDRSTRLEN);
+        }
+        return text;
+    }
+
+    bool operator==(const IpKey& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const IpKey& other) const { return !(*this == other); }
+};
+
+// Hash for unordered containers keyed by IpKey.
+struct IpKeyHash {
+    size_t operator()(const IpKey& key) const noexcept
+    {
+        // 64-bit mix of both halves (splitmix64 finaliser on hi ^ rotated lo).
+        uint64_t x = key.hi ^ ((key.lo << 29) | (key.lo >> 35));
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
+};
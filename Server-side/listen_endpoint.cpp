@@ -0,0 +1,254 @@
+#include "listen_endpoint.hpp"
+#include "ip_key.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ifaddrs.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::string trim(const std::string& s)
+{
+    const size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos) return {};
+    return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+}
+
+// Digits only, at most `max`; false otherwise.
+bool parse_number(const std::string& text, unsigned long max, unsigned long& value)
+{
+    if (text.empty()) return false;
+    value = 0;
+    for (char ch : text) {
+        if (ch < '0' || ch > '9') return false;
+        value = value * 10 + static_cast<unsigned long>(ch - '0');
+        if (value > max) return false;
+    }
+    return true;
+}
+
+// One entry (trimmed, not empty) into `e`.
+bool parse_entry(const std::string& entry, uint16_t default_port, ListenEndpoint& e)
+{
+    std::string host = entry;
+    unsigned long number = 0;
+
+    const size_t at = host.rfind('@');
+    if (at != std::string::npos) {
+        if (!parse_number(host.substr(at + 1), 1024, number)) return false;
+        e.reactor = static_cast<int>(number);
+        host.erase(at);
+    }
+
+    unsigned long port = default_port;
+    if (!host.empty() && host[0] == '[') {
+        const size_t close = host.find(']');
+        if (close == std::string::npos) return false;
+        const std::string rest = host.substr(close + 1);
+        if (!rest.empty() && (rest[0] != ':' || !parse_number(rest.substr(1), 65535, port))) return false;
+        host = host.substr(1, close - 1);
+    } else if (std::count(host.begin(), host.end(), ':') == 1) {
+        const size_t colon = host.find(':');
+        if (!parse_number(host.substr(colon + 1), 65535, port)) return false;
+        host.erase(colon);
+    }
+    if (host.empty() || port == 0) return false;
+
+    // Numeric only: a listener never waits for DNS. Takes "fe80::1%eth0".
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_NUMERICHOST | AI_PASSIVE;
+    addrinfo* result  = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) return false;
+    std::memcpy(&e.address, result->ai_addr, result->ai_addrlen);
+    e.length = result->ai_addrlen;
+    freeaddrinfo(result);
+
+    if (e.address.ss_family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6*>(&e.address)->sin6_port = htons(static_cast<uint16_t>(port));
+    } else {
+        reinterpret_cast<sockaddr_in*>(&e.address)->sin_port = htons(static_cast<uint16_t>(port));
+    }
+    e.name = ListenEndpoint::format(reinterpret_cast<const sockaddr*>(&e.address));
+    return true;
+}
+
+} // namespace
+
+bool ListenEndpoint::parse_list(const std::string& list, uint16_t default_port,
+                                std::vector<ListenEndpoint>& out, std::string& error)
+{
+    out.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        const std::string item = trim(list.substr(start, comma - start));
+        start = comma + 1;
+        if (item.empty()) continue;
+
+        ListenEndpoint e;
+        if (!parse_entry(item, default_port, e)) {
+            error = "bad entry '" + item + "' (expected <address>[:<port>][@<reactor>], IPv6 as [<address>]:<port>)";
+            return false;
+        }
+        for (const ListenEndpoint& other : out) {
+            if (other.name == e.name) {
+                error = e.name + " listed twice";
+                return false;
+            }
+        }
+        out.push_back(std::move(e));
+    }
+    if (out.empty()) {
+        error = "no address to listen on";
+        return false;
+    }
+    return true;
+}
+
+bool ListenEndpoint::parse_unix(const std::string& path, ListenEndpoint& out, std::string& error)
+{
+    sockaddr_un un{};
+    if (path.empty() || path[0] != '/' || path.size() >= sizeof(un.sun_path)) {
+        error = "'" + path + "' is not an absolute path of at most " + std::to_string(sizeof(un.sun_path) - 1) +
+                " bytes";
+        return false;
+    }
+    un.sun_family = AF_UNIX;
+    std::memcpy(un.sun_path, path.data(), path.size());
+
+    out = ListenEndpoint{};
+    std::memcpy(&out.address, &un, sizeof(un));
+    out.length  = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+    out.reactor = 0;
+    out.name    = format(reinterpret_cast<const sockaddr*>(&out.address));
+    return true;
+}
+
+// Compared as IpKeys: one binary compare for both families, and an IPv4
+// interface address matches itself whichever family lists it.
+bool ListenEndpoint::is_local() const
+{
+    if (address.ss_family == AF_UNIX) return true;
+    const IpKey wanted = IpKey::from_sockaddr(reinterpret_cast<const sockaddr*>(&address));
+    const IpKey any4   = [] {
+        sockaddr_in in4{};
+        in4.sin_family = AF_INET;
+        return IpKey::from_sockaddr(reinterpret_cast<const sockaddr*>(&in4));
+    }();
+    if (wanted == IpKey{} || wanted == any4) return true; // "::" or "0.0.0.0"
+
+    ifaddrs* ifaddr = nullptr;
+    if (getifaddrs(&ifaddr) == -1) return false;
+    bool found = false;
+    for (ifaddrs* ifa = ifaddr; ifa && !found; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr) continue; // Some interfaces have no address
+        const int family = ifa->ifa_addr->sa_family;
+        if (family != AF_INET && family != AF_INET6) continue;
+        found = IpKey::from_sockaddr(ifa->ifa_addr) == wanted;
+    }
+    freeifaddrs(ifaddr);
+    return found;
+}
+
+int ListenEndpoint::open(int backlog, bool reuse_port) const
+{
+    const int family = address.ss_family;
+    int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        throw std::runtime_error("Socket creation failed for " + name + ": " + strerror(errno));
+    }
+
+    int opt = 1;
+    if (family == AF_UNIX) {
+        // The file a previous run left behind; anything but a socket is kept
+        // (and bind() then fails).
+        const char* path = reinterpret_cast<const sockaddr_un*>(&address)->sun_path;
+        struct stat st{};
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&address), length) == -1 || chmod(path, 0666) == -1 ||
+            listen(fd, backlog) == -1) {
+            const int err = errno;
+            close(fd);
+            throw std::runtime_error("Listen on " + name + " failed: " + strerror(err));
+        }
+        return fd;
+    }
+
+    // SO_REUSEADDR: allows fast rebind after restart (skips TIME_WAIT block).
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // SO_REUSEPORT: each reactor binds its own listener to the same address;
+    // the kernel load-balances incoming connections between them.
+    if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        const int err = errno;
+        close(fd);
+        throw std::runtime_error(std::string("setsockopt(SO_REUSEPORT) failed: ") + strerror(err));
+    }
+
+    // "::" stays IPv6 only, so "0.0.0.0" can be listed beside it.
+    if (family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt)) < 0) {
+        const int err = errno;
+        close(fd);
+        throw std::runtime_error(std::string("setsockopt(IPV6_V6ONLY) failed: ") + strerror(err));
+    }
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), length) == -1) {
+        const int err = errno;
+        close(fd);
+        throw std::runtime_error("Bind to " + name + " failed: " + strerror(err));
+    }
+    if (listen(fd, backlog) == -1) {
+        const int err = errno;
+        close(fd);
+        throw std::runtime_error("Listen on " + name + " failed: " + strerror(err));
+    }
+    return fd;
+}
+
+std::string ListenEndpoint::bound_name(int fd)
+{
+    sockaddr_storage bound{};
+    socklen_t len = sizeof(bound);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &len) == -1) return "?";
+    return format(reinterpret_cast<const sockaddr*>(&bound));
+}
+
+int ListenEndpoint::family(int fd)
+{
+    sockaddr_storage bound{};
+    socklen_t len = sizeof(bound);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &len) == -1) return AF_UNSPEC;
+    return bound.ss_family;
+}
+
+std::string ListenEndpoint::format(const sockaddr* sa)
+{
+    char text[INET6_ADDRSTRLEN];
+    if (sa->sa_family == AF_INET6) {
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(sa);
+        inet_ntop(AF_INET6, &in6->sin6_addr, text, sizeof(text));
+        return "[" + std::string(text) + "]:" + std::to_string(ntohs(in6->sin6_port));
+    }
+    if (sa->sa_family == AF_INET) {
+        const auto* in4 = reinterpret_cast<const sockaddr_in*>(sa);
+        inet_ntop(AF_INET, &in4->sin_addr, text, sizeof(text));
+        return std::string(text) + ":" + std::to_string(ntohs(in4->sin_port));
+    }
+    if (sa->sa_family == AF_UNIX) {
+        const auto* un = reinterpret_cast<const sockaddr_un*>(sa);
+        return "unix:" + std::string(un->sun_path, strnlen(un->sun_path, sizeof(un->sun_path)));
+    }
+    return "?";
+}
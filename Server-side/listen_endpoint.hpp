@@ -0,0 +1,67 @@
+#pragma once
+
+// sockaddr_storage, socklen_t
+#include <sys/socket.h>
+// uint16_t
+#include <cstdint>
+// std::string — entries, names for logs
+#include <string>
+// std::vector — the parsed list
+#include <vector>
+
+// ============================================================================
+// ListenEndpoint — one entry of [NETWORK] listen_address.
+//
+// The key is a comma-separated list, so one server listens on several NIC
+// addresses and on both families at once:
+//
+//   listen_address = 10.0.0.5@0, 10.0.1.5@1, [2001:db8::5]:25566, ::1
+//
+// An entry is an address with an optional ":port" (an IPv6 address needs
+// brackets to take one), listen_port by default, and an optional
+// "@<reactor>". Without it every reactor binds the address with
+// SO_REUSEPORT and the kernel spreads its connections over all of them;
+// with it only that reactor listens there, so the traffic of one NIC stays
+// on the core that serves its interrupts. IPv6 listeners are IPV6_V6ONLY:
+// dual stack is "0.0.0.0, ::" (two sockets), and since IpKey stores IPv4
+// in its mapped form, the per-IP accounting is one map for both.
+//
+// [NETWORK] unix_socket adds one more endpoint: an AF_UNIX path, always
+// served by reactor 0 (named "unix:<path>").
+// ============================================================================
+struct ListenEndpoint {
+    sockaddr_storage address{};
+    socklen_t length{0};
+    int reactor{-1};  // The only reactor listening here (-1 = every reactor)
+    std::string name; // "10.0.0.5:25565" / "[::1]:25565" / "unix:/run/x.sock", as bound_name() gives it
+
+    // Parses the whole list. False with `error` set on a malformed or
+    // duplicate entry, or an empty list.
+    static bool parse_list(const std::string& list, uint16_t default_port,
+                           std::vector<ListenEndpoint>& out, std::string& error);
+
+    // The unix_socket endpoint for `path` (absolute, fits sun_path). False
+    // with `error` set otherwise.
+    static bool parse_unix(const std::string& path, ListenEndpoint& out, std::string& error);
+
+    // Whether the address belongs to a local interface (a wildcard, or a
+    // unix path, always does): binding anything else would fail, or never
+    // see traffic.
+    bool is_local() const;
+
+    // A non-blocking listening socket bound to the address (SO_REUSEADDR,
+    // SO_REUSEPORT when `reuse_port`). A unix path replaces a stale socket
+    // file and is made connectable by everyone: SO_PEERCRED is the check.
+    // Throws std::runtime_error.
+    int open(int backlog, bool reuse_port) const;
+
+    // Address family `fd` is bound to (AF_UNSPEC if it has none).
+    static int family(int fd);
+
+    // "addr:port" of the address `fd` is bound to ("?" if it has none):
+    // matches inherited listeners to their entries, and names them in logs.
+    static std::string bound_name(int fd);
+
+    // Same, for an address.
+    static std::string format(const sockaddr* sa);
+};
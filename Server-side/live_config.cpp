@@ -0,0 +1,89 @@
+#include "live_config.hpp"
+
+LiveConfig::LiveConfig(std::string path, const ServerConfig& initial)
+    : file(std::move(path)),
+      current(std::make_shared<const ServerConfig>(initial))
+{
+}
+
+std::shared_ptr<const ServerConfig> LiveConfig::snapshot() const
+{
+    return std::atomic_load(&current);
+}
+
+bool LiveConfig::reload_if_requested(Logger& log)
+{
+    if (!reload_pending.load(std::memory_order_relaxed)) return false;
+    reload_pending.store(false, std::memory_order_relaxed);
+
+    auto fresh = std::make_shared<ServerConfig>();
+    if (!fresh->Load(file.c_str())) {
+        log.Write_log("Config reload: could not read " + file + "; keeping the current settings",
+                      Logger::Error);
+        return false;
+    }
+
+    // Fixed for the lifetime of the process: keep the running value.
+    const std::shared_ptr<const ServerConfig> old = snapshot();
+    std::string pinned;
+    auto keep = [&](auto ServerConfig::*field, const char* key) {
+        if ((*fresh).*field != (*old).*field) {
+            (*fresh).*field = (*old).*field;
+            pinned.append(pinned.empty() ? "" : ", ").append(key);
+        }
+    };
+    keep(&ServerConfig::address, "listen_address");
+    keep(&ServerConfig::port, "listen_port");
+    keep(&ServerConfig::unixSocket, "unix_socket");
+    keep(&ServerConfig::workerThreads, "worker_threads");
+    keep(&ServerConfig::ioBackend, "io_backend");
+    keep(&ServerConfig::edgeTriggered, "edge_triggered");
+    keep(&ServerConfig::epollBatchSize, "epoll_batch_size");
+    keep(&ServerConfig::recvArenaMb, "recv_arena_mb");
+    keep(&ServerConfig::recvHugePages, "recv_huge_pages");
+    keep(&ServerConfig::writeCoalescing, "write_coalescing");
+    keep(&ServerConfig::tcpCork, "tcp_cork");
+    keep(&ServerConfig::DatabasePath, "DatabasePath");
+    keep(&ServerConfig::databaseFormat, "format");
+    keep(&ServerConfig::binaryDatabasePath, "BinaryDatabasePath");
+    keep(&ServerConfig::journalFsyncMs, "journal_fsync_ms");
+    keep(&ServerConfig::journalCompactRecords, "journal_compact_records");
+    keep(&ServerConfig::cryptoThreads, "crypto_threads");
+    keep(&ServerConfig::cryptoQueueLimit, "crypto_queue_limit");
+    keep(&ServerConfig::argon2TargetMs, "argon2_target_ms");
+    keep(&ServerConfig::argon2MemoryMb, "argon2_memory_mb");
+    keep(&ServerConfig::argon2Opslimit, "argon2_opslimit");
+    keep(&ServerConfig::reactorCpus, "reactor_cpus");
+    keep(&ServerConfig::cryptoCpus, "crypto_cpus");
+    keep(&ServerConfig::incomingCpu, "incoming_cpu");
+    keep(&ServerConfig::sessionTokenTtl, "session_token_ttl");
+    keep(&ServerConfig::sessionKeyPath, "session_key_path");
+    keep(&ServerConfig::metricsPort, "metrics_port");
+    keep(&ServerConfig::adminSocket, "admin_socket");
+    keep(&ServerConfig::chatLogDir, "log_dir");
+    keep(&ServerConfig::chatLogSegmentBytes, "log_segment_bytes");
+    keep(&ServerConfig::chatLogSegments, "log_segments");
+    keep(&ServerConfig::chatLogIndexBytes, "log_index_bytes");
+    keep(&ServerConfig::chatLogFlushMs, "log_flush_ms");
+    keep(&ServerConfig::chatLogScanBytes, "log_query_scan_bytes");
+    keep(&ServerConfig::clusterNodeId, "[CLUSTER] node_id");
+    keep(&ServerConfig::clusterListen, "listen");
+    keep(&ServerConfig::clusterSecret, "secret");
+    keep(&ServerConfig::tlsEnabled, "[TLS] enabled");
+    keep(&ServerConfig::tlsCertificate, "certificate");
+    keep(&ServerConfig::tlsPrivateKey, "private_key");
+    keep(&ServerConfig::ktls, "ktls");
+    keep(&ServerConfig::requireKtls, "require_ktls");
+    keep(&ServerConfig::logAsync, "async_logging");
+    keep(&ServerConfig::logQueueSize, "log_queue_size");
+    keep(&ServerConfig::PidFilePath, "PidFilePath");
+    if (!pinned.empty()) {
+        log.Write_log("Config reload: " + pinned + " changed; restart the server to apply", Logger::Warn);
+    }
+
+    log.Reconfigure(*fresh);
+    std::atomic_store(&current, std::shared_ptr<const ServerConfig>(std::move(fresh)));
+    gen.fetch_add(1, std::memory_order_release);
+    log.Write_log("Configuration reloaded from " + file, Logger::Info);
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "common/config/Configuration.hpp"
+#include "common/Logger/logger.hpp"
+
+// ============================================================================
+// LiveConfig — the process's one ServerConfig, re-read on SIGHUP.
+//
+// The signal handler only calls requestReload() (an atomic store, like
+// TcpServer::requestShutdown()). Reactor 0 calls reload_if_requested() once
+// per loop iteration; on a pending request it parses the file in normal
+// context, publishes the new config as an immutable snapshot and bumps
+// generation(). Every reactor compares generation() with the one it last
+// applied (one relaxed load per iteration, no lock) and copies the new
+// values into its own fields, so the hot paths keep reading plain members.
+//
+// Settings that can't change under a running server (addresses, thread
+// counts, backends, storage) keep their old value in the snapshot, with a
+// warning that they need a restart.
+// ============================================================================
+class LiveConfig {
+public:
+    // `initial` was already loaded from `path` by main().
+    LiveConfig(std::string path, const ServerConfig& initial);
+
+    LiveConfig(const LiveConfig&) = delete;
+    LiveConfig& operator=(const LiveConfig&) = delete;
+
+    // Async-signal-safe: only sets a flag.
+    void requestReload() noexcept { reload_pending.store(true, std::memory_order_relaxed); }
+
+    // Re-reads the file if requestReload() was called since the last time,
+    // applies the [LOGS] settings to `log` and publishes the new snapshot.
+    // A file that fails to parse keeps the current config. Returns true if
+    // a new generation was published. Call from one loop thread only.
+    bool reload_if_requested(Logger& log);
+
+    // Bumped by every published reload.
+    uint64_t generation() const noexcept { return gen.load(std::memory_order_acquire); }
+
+    // The current settings (never null).
+    std::shared_ptr<const ServerConfig> snapshot() const;
+
+    const std::string& path() const { return file; }
+
+private:
+    std::string file;
+    std::shared_ptr<const ServerConfig> current; // Swapped with std::atomic_store
+    std::atomic<uint64_t> gen{0};
+    std::atomic<bool> reload_pending{false};
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+// std::atomic — lock-free queue links and the wake-up flag
+#include <atomic>
+// std::shared_ptr — refcounted payloads shared between reactors
+#include <memory>
+// std::string — usernames carried by claim/release messages
+#include <string>
+// std::vector — presence batches (names joined / left)
+#include <vector>
+// std::runtime_error — eventfd creation failure
+#include <stdexcept>
+// eventfd() — per-mailbox wake-up handle registered in the reactor's epoll
+#include <sys/eventfd.h>
+// read(), write(), close()
+#include <unistd.h>
+// uint64_t — eventfd counter and connection ids
+#include <cstdint>
+// strerror()
+#include <cstring>
+#include <cerrno>
+
+struct AdminQuery; // admin_channel.hpp
+
+// One immutable, refcounted message body. A broadcast allocates it once and
+// every recipient (on any reactor) holds a pointer to the same bytes.
+using SharedPayload = std::shared_ptr<const std::string>;
+
+// ============================================================================
+// MailboxMessage — one cross-reactor request/notification.
+// Allocated by the sender, owned by the receiving reactor once popped.
+// ============================================================================
+struct MailboxMessage {
+    enum Type {
+        Broadcast,       // Fan `payload` out to the local members of `channel`
+        ClaimUsername,   // Ask the owning shard to reserve `username`
+        ClaimResult,     // Owner's answer to a claim (`ok`)
+        ReleaseUsername, // Free `username` in the owning shard
+        AuthComplete,    // CryptoPool finished the Argon2id step (`ok`, `password_hash`)
+        PasswordRehashed, // A verified login's hash redone at the current cost (`password_hash`)
+        KickUser,        // Cluster: `username` won a login race on another node
+        DirectMessage,   // /msg: `text` from `author` to `username` (see route_direct())
+        DirectFailed,    // /msg target not online: tell `origin_fd` (`conn_id`) about `username`
+        AdminQuery,      // Operator command: answer `query` (see admin_channel.hpp)
+        PresenceDelta    // Sessions bound (`joined`) and ended (`left`) on the origin during one iteration
+    };
+
+    Type type{Broadcast};
+    size_t origin_worker{0};  // Reactor that sent the message (reply address)
+    int origin_fd{-1};        // Client fd on the origin reactor (claims / auth results)
+    uint64_t conn_id{0};      // Guards against fd reuse while a claim is in flight
+    bool ok{false};           // ClaimResult / AuthComplete verdict; DirectMessage: routed by the shard
+    std::string username{};   // Claim/release target
+    std::string channel{};    // Broadcast target channel
+    SharedPayload payload{};  // Broadcast body (shared, never copied)
+    SharedPayload frame{};    // Same broadcast encoded for protocol v2 clients
+    SharedPayload deflated{}; // `frame` as a Compressed frame, or null (see encode_chat())
+    std::string password_hash{}; // AuthComplete of a Hash job / PasswordRehashed: the new encoded hash
+    std::string stored_hash{};   // PasswordRehashed: the hash it replaces
+    std::string author{};     // DirectMessage sender
+    std::string text{};       // DirectMessage body
+    std::shared_ptr<::AdminQuery> query{}; // AdminQuery: shared with the AdminChannel thread
+    std::vector<std::string> joined{}; // PresenceDelta
+    std::vector<std::string> left{};
+
+    std::atomic<MailboxMessage*> next{nullptr}; // Intrusive queue link
+};
+
+// ============================================================================
+// Mailbox — lock-free multi-producer / single-consumer queue (Vyukov's
+// intrusive MPSC) paired with an eventfd so the owning reactor can sleep in
+// epoll_wait() and still be woken by pushes from other threads.
+// push() is safe from any thread; pop()/begin_drain() only from the owner.
+// ============================================================================
+class Mailbox {
+public:
+    Mailbox() : head(&stub), tail(&stub)
+    {
+        efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd == -1) {
+            throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+        }
+    }
+
+    // Frees any messages nobody consumed (e.g. posted during shutdown).
+    ~Mailbox()
+    {
+        while (MailboxMessage* m = pop()) delete m;
+        if (efd != -1) ::close(efd);
+    }
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    // Enqueues `msg` (ownership moves to the mailbox). Only the first push
+    // after a drain pays for the eventfd write; later ones ride along.
+    void push(MailboxMessage* msg)
+    {
+        enqueue(msg);
+        if (!wake_pending.exchange(true, std::memory_order_acq_rel)) {
+            uint64_t one = 1;
+            ssize_t r = ::write(efd, &one, sizeof(one));
+            (void)r; // Counter overflow is impossible in practice; nothing to do on error
+        }
+    }
+
+    // Consumer side: acknowledges the eventfd wake-up. Must be called BEFORE
+    // popping so that a push racing with the drain triggers a new wake-up.
+    void begin_drain()
+    {
+        uint64_t value;
+        ssize_t r = ::read(efd, &value, sizeof(value));
+        (void)r; // EAGAIN just means another drain already consumed it
+        wake_pending.exchange(false, std::memory_order_acq_rel);
+    }
+
+    // Returns the oldest message, or nullptr if empty (or a producer is
+    // mid-push — its own wake-up will bring us back). Caller owns the result.
+    MailboxMessage* pop()
+    {
+        MailboxMessage* t    = tail;
+        MailboxMessage* next = t->next.load(std::memory_order_acquire);
+
+        if (t == &stub) {
+            if (!next) return nullptr;
+            tail = next;
+            t    = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return t;
+        }
+        if (t != head.load(std::memory_order_acquire)) return nullptr;
+
+        // `t` is the last real node: park the stub behind it so it can detach.
+        enqueue(&stub);
+        next = t->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return t;
+        }
+        return nullptr;
+    }
+
+    // eventfd to register (EPOLLIN) in the owning reactor's epoll set.
+    int fd() const { return efd; }
+
+private:
+    void enqueue(MailboxMessage* msg)
+    {
+        msg->next.store(nullptr, std::memory_order_relaxed);
+        MailboxMessage* prev = head.exchange(msg, std::memory_order_acq_rel);
+        prev->next.store(msg, std::memory_order_release);
+    }
+
+    std::atomic<MailboxMessage*> head;        // Producers swap themselves in here
+    MailboxMessage* tail;                     // Consumer-only read position
+    MailboxMessage stub{};                    // Sentinel so the queue is never empty
+    std::atomic<bool> wake_pending{false};    // true → eventfd already signalled
+    int efd{-1};                              // Wake-up handle
+};
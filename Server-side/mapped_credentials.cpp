@@ -0,0 +1,334 @@
+#include "mapped_credentials.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr char     MAGIC[8]         = {'T', 'C', 'P', 'C', 'R', 'E', 'D', '\0'};
+constexpr uint32_t VERSION          = 1;
+constexpr size_t   PAGE             = 4096;
+constexpr uint64_t INITIAL_CAPACITY = 1024; // Records in a new file (512 KiB)
+
+size_t page_align(size_t n) { return (n + PAGE - 1) & ~(PAGE - 1); }
+
+} // namespace
+
+struct MappedCredentialFile::Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;    // sizeof(Record) when written
+    uint64_t capacity;       // Record slots in the file
+    uint64_t count;          // Records appended
+    uint64_t synced;         // Records covered by the last sync()
+    uint64_t index_slots;    // Power of two, >= 2 * capacity
+    uint64_t records_offset; // Byte offset of record 0
+};
+static_assert(sizeof(MappedCredentialFile::Record) % 8 == 0, "records must stay aligned");
+
+MappedCredentialFile::~MappedCredentialFile()
+{
+    if (base && unsynced) sync();
+    unmap();
+}
+
+MappedCredentialFile::Header* MappedCredentialFile::header() const
+{
+    return reinterpret_cast<Header*>(base);
+}
+
+uint32_t* MappedCredentialFile::index() const
+{
+    return reinterpret_cast<uint32_t*>(base + PAGE);
+}
+
+MappedCredentialFile::Record* MappedCredentialFile::records() const
+{
+    return reinterpret_cast<Record*>(base + header()->records_offset);
+}
+
+size_t MappedCredentialFile::size() const
+{
+    return base ? static_cast<size_t>(header()->count) : 0;
+}
+
+const MappedCredentialFile::Record& MappedCredentialFile::record(size_t i) const
+{
+    return records()[i];
+}
+
+uint64_t MappedCredentialFile::hash_name(std::string_view name)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a 64
+    for (unsigned char c : name) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Lengths plus everything after the checksum field.
+uint32_t MappedCredentialFile::checksum(const Record& r)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&r);
+    uint32_t h = 2166136261u; // FNV-1a 32
+    auto mix = [&h](const unsigned char* p, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 16777619u;
+        }
+    };
+    mix(bytes, offsetof(Record, checksum));
+    mix(bytes + offsetof(Record, username), sizeof(Record) - offsetof(Record, username));
+    return h;
+}
+
+bool MappedCredentialFile::fits(std::string_view username, std::string_view password_hash,
+                                std::string_view ip_source, std::string_view created_at)
+{
+    return !username.empty() && username.size() <= NAME_MAX_BYTES &&
+           password_hash.size() <= HASH_MAX_BYTES && ip_source.size() <= IP_MAX_BYTES &&
+           created_at.size() <= CREATED_MAX_BYTES;
+}
+
+bool MappedCredentialFile::open(const std::string& _path, std::string& error)
+{
+    unmap();
+    path = _path;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd == -1 && errno == ENOENT) {
+        if (!build(path + ".tmp", INITIAL_CAPACITY, 0, error)) return false;
+        fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    }
+    if (fd == -1) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    if (!map_file(error)) {
+        unmap();
+        return false;
+    }
+
+    // Unclean stop: keep the intact prefix of what was appended since the
+    // last sync() and index exactly that.
+    Header* h = header();
+    if (h->synced < h->count) {
+        uint64_t good = h->synced;
+        while (good < h->count && records()[good].name_len != 0 &&
+               records()[good].checksum == checksum(records()[good])) {
+            ++good;
+        }
+        if (good < h->count) {
+            std::cerr << "Credential DB " << path << ": dropping " << (h->count - good)
+                      << " torn record(s)" << std::endl;
+        }
+        h->count = good;
+        rebuild_index();
+        sync();
+    }
+    return true;
+}
+
+bool MappedCredentialFile::map_file(std::string& error)
+{
+    struct stat st{};
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < PAGE) {
+        error = path + ": not a credential DB (too small)";
+        return false;
+    }
+
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        error = path + ": mmap: " + strerror(errno);
+        return false;
+    }
+    base   = static_cast<char*>(p);
+    mapped = static_cast<size_t>(st.st_size);
+
+    const Header* h = header();
+    const uint64_t slots = h->index_slots;
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + ": not a credential DB (bad magic)";
+        return false;
+    }
+    if (h->version != VERSION || h->record_size != sizeof(Record)) {
+        error = path + ": unsupported credential DB version";
+        return false;
+    }
+    if (slots == 0 || (slots & (slots - 1)) != 0 || slots < 2 * h->capacity || h->count > h->capacity ||
+        h->synced > h->count || h->records_offset < PAGE + slots * sizeof(uint32_t) ||
+        h->records_offset + h->capacity * sizeof(Record) > mapped) {
+        error = path + ": corrupt credential DB header";
+        return false;
+    }
+    return true;
+}
+
+void MappedCredentialFile::unmap()
+{
+    if (base) munmap(base, mapped);
+    if (fd != -1) ::close(fd);
+    base   = nullptr;
+    mapped = 0;
+    fd     = -1;
+}
+
+bool MappedCredentialFile::build(const std::string& file, uint64_t capacity, uint64_t count,
+                                 std::string& error)
+{
+    uint64_t slots = 1;
+    while (slots < 2 * capacity) slots <<= 1;
+    const size_t records_offset = page_align(PAGE + slots * sizeof(uint32_t));
+    const size_t bytes          = records_offset + capacity * sizeof(Record);
+
+    int out = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (out == -1) {
+        error = file + ": " + strerror(errno);
+        return false;
+    }
+    if (ftruncate(out, static_cast<off_t>(bytes)) == -1) {
+        error = file + ": " + strerror(errno);
+        ::close(out);
+        std::remove(file.c_str());
+        return false;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, out, 0);
+    if (p == MAP_FAILED) {
+        error = file + ": mmap: " + strerror(errno);
+        ::close(out);
+        std::remove(file.c_str());
+        return false;
+    }
+
+    // The new file is built with this object's helpers pointed at it.
+    char* old_base      = base;
+    size_t old_mapped   = mapped;
+    const Record* source = base ? records() : nullptr;
+
+    base   = static_cast<char*>(p);
+    mapped = bytes;
+    Header* h = header();
+    std::memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    h->version        = VERSION;
+    h->record_size    = sizeof(Record);
+    h->capacity       = capacity;
+    h->count          = count;
+    h->synced         = count;
+    h->index_slots    = slots;
+    h->records_offset = records_offset;
+    if (count) std::memcpy(records(), source, count * sizeof(Record));
+    rebuild_index();
+
+    const bool flushed = msync(base, bytes, MS_SYNC) == 0 && fsync(out) == 0;
+    munmap(base, bytes);
+    ::close(out);
+    base   = old_base;
+    mapped = old_mapped;
+
+    if (!flushed || std::rename(file.c_str(), path.c_str()) != 0) {
+        error = file + ": " + strerror(errno);
+        std::remove(file.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MappedCredentialFile::rebuild_index()
+{
+    std::memset(index(), 0, header()->index_slots * sizeof(uint32_t));
+    for (uint64_t i = 0; i < header()->count; ++i) index_insert(static_cast<uint32_t>(i));
+}
+
+void MappedCredentialFile::index_insert(uint32_t record_no)
+{
+    const uint64_t mask = header()->index_slots - 1;
+    uint64_t slot = hash_name(records()[record_no].name()) & mask;
+    while (index()[slot] != 0) slot = (slot + 1) & mask;
+    index()[slot] = record_no + 1;
+}
+
+const MappedCredentialFile::Record* MappedCredentialFile::find(std::string_view username) const
+{
+    if (!base) return nullptr;
+    const Header* h    = header();
+    const uint64_t mask = h->index_slots - 1;
+    for (uint64_t slot = hash_name(username) & mask; index()[slot] != 0; slot = (slot + 1) & mask) {
+        const uint32_t n = index()[slot] - 1;
+        if (n < h->count && records()[n].name() == username) return &records()[n];
+    }
+    return nullptr;
+}
+
+bool MappedCredentialFile::append(std::string_view username, std::string_view password_hash,
+                                  std::string_view ip_source, std::string_view created_at)
+{
+    if (!base || !fits(username, password_hash, ip_source, created_at) || find(username)) return false;
+
+    if (header()->count == header()->capacity) {
+        // Full: rebuild at twice the size next to it, then switch over.
+        std::string error;
+        const uint64_t capacity = header()->capacity * 2;
+        if (!sync() || !build(path + ".tmp", capacity, header()->count, error)) {
+            std::cerr << "Credential DB grow failed: " << error << std::endl;
+            return false;
+        }
+        unmap();
+        fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd == -1 || !map_file(error)) {
+            std::cerr << "Credential DB reopen failed: " << (fd == -1 ? strerror(errno) : error) << std::endl;
+            unmap();
+            return false;
+        }
+    }
+
+    Header* h = header();
+    Record& r = records()[h->count];
+    std::memset(&r, 0, sizeof(r));
+    r.name_len    = static_cast<uint8_t>(username.size());
+    r.hash_len    = static_cast<uint8_t>(password_hash.size());
+    r.ip_len      = static_cast<uint8_t>(ip_source.size());
+    r.created_len = static_cast<uint8_t>(created_at.size());
+    std::memcpy(r.username, username.data(), username.size());
+    std::memcpy(r.password_hash, password_hash.data(), password_hash.size());
+    std::memcpy(r.ip_source, ip_source.data(), ip_source.size());
+    std::memcpy(r.created_at, created_at.data(), created_at.size());
+    r.checksum = checksum(r);
+
+    // Record, then index, then count: a reader of the file never follows
+    // the count onto a half-written record.
+    index_insert(static_cast<uint32_t>(h->count));
+    h->count++;
+    unsynced = true;
+    return true;
+}
+
+bool MappedCredentialFile::replace_hash(std::string_view username, std::string_view password_hash)
+{
+    Record* r = const_cast<Record*>(find(username)); // find() is const only for readers
+    if (!r || password_hash.size() > HASH_MAX_BYTES) return false;
+
+    std::memset(r->password_hash, 0, sizeof(r->password_hash));
+    std::memcpy(r->password_hash, password_hash.data(), password_hash.size());
+    r->hash_len = static_cast<uint8_t>(password_hash.size());
+    r->checksum = checksum(*r);
+    unsynced    = true;
+    return true;
+}
+
+bool MappedCredentialFile::sync()
+{
+    if (!base) return false;
+    if (msync(base, mapped, MS_SYNC) != 0) return false;
+    header()->synced = header()->count;
+    if (msync(base, PAGE, MS_SYNC) != 0) return false;
+    unsynced = false;
+    return true;
+}
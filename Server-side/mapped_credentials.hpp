@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ============================================================================
+// MappedCredentialFile — binary user DB ([DATABASE] format = binary).
+//
+// The whole file is mmap'd; opening it validates a header and nothing is
+// parsed. Layout (little-endian, host layout):
+//
+//   [0, 4096)            Header
+//   [4096, records)      open-addressing index: index_slots × uint32_t,
+//                        each 0 (empty) or record number + 1, linear probing,
+//                        at most half full
+//   [records, end)       capacity × Record (512 bytes each), append-only
+//
+// append() writes the record, then its index slot, then bumps the header's
+// count, all in place. sync() msyncs and records how many records are known
+// durable (Header::synced); after an unclean stop, open() checks the
+// records past that point by checksum, cuts a torn tail and rebuilds the
+// index. A full file is rebuilt at twice the capacity into <path>.tmp and
+// renamed over the original, so growth costs O(1) amortized per append.
+//
+// Not thread-safe: CredentialStore serializes access.
+// ============================================================================
+class MappedCredentialFile {
+public:
+    static constexpr size_t NAME_MAX_BYTES    = 255;
+    static constexpr size_t HASH_MAX_BYTES    = 127; // crypto_pwhash_STRBYTES - 1
+    static constexpr size_t IP_MAX_BYTES      = 63;
+    static constexpr size_t CREATED_MAX_BYTES = 31;
+
+    // One account, fixed size. Strings are length-prefixed and NUL-padded.
+    struct Record {
+        uint8_t  name_len;
+        uint8_t  hash_len;
+        uint8_t  ip_len;
+        uint8_t  created_len;
+        uint32_t checksum;                      // FNV-1a over everything below
+        char     username[NAME_MAX_BYTES + 1];
+        char     password_hash[HASH_MAX_BYTES + 1];
+        char     ip_source[IP_MAX_BYTES + 1];
+        char     created_at[CREATED_MAX_BYTES + 1];
+        char     reserved[24];
+
+        std::string_view name() const { return {username, name_len}; }
+        std::string_view hash() const { return {password_hash, hash_len}; }
+        std::string_view ip() const { return {ip_source, ip_len}; }
+        std::string_view created() const { return {created_at, created_len}; }
+    };
+    static_assert(sizeof(Record) == 512, "on-disk record layout changed");
+
+    MappedCredentialFile() = default;
+    ~MappedCredentialFile();
+
+    MappedCredentialFile(const MappedCredentialFile&) = delete;
+    MappedCredentialFile& operator=(const MappedCredentialFile&) = delete;
+
+    // Maps `path`, creating an empty DB if it doesn't exist. False (with a
+    // reason in `error`) if the file isn't a DB of this version.
+    bool open(const std::string& path, std::string& error);
+
+    // O(1) average: the record of `username`, or null. Valid until the next
+    // append().
+    const Record* find(std::string_view username) const;
+
+    // Adds a record in place. False if the name exists, a field is too long
+    // for its slot, or the file could not grow.
+    bool append(std::string_view username, std::string_view password_hash,
+                std::string_view ip_source, std::string_view created_at);
+
+    // Overwrites the hash of `username` in place (a login rehashed it).
+    // False if the name is unknown or the hash too long for its slot. The
+    // record sits inside one page, which reaches the disk as a whole on
+    // the next sync().
+    bool replace_hash(std::string_view username, std::string_view password_hash);
+
+    // Records in insertion order: record(0) ... record(size() - 1).
+    size_t size() const;
+    const Record& record(size_t i) const;
+
+    // True once append() wrote something sync() hasn't flushed yet.
+    bool dirty() const { return unsynced; }
+
+    // msync()s the mapping and marks every record durable.
+    bool sync();
+
+    // True if the fields fit a Record.
+    static bool fits(std::string_view username, std::string_view password_hash,
+                     std::string_view ip_source, std::string_view created_at);
+
+private:
+    struct Header;
+
+    Header* header() const;
+    uint32_t* index() const;
+    Record* records() const;
+
+    // Maps the open fd (its current size) and checks the header.
+    bool map_file(std::string& error);
+    void unmap();
+
+    // Creates `file` with room for `capacity` records, holding the first
+    // `count` records of this DB (if any), then renames it into place.
+    bool build(const std::string& file, uint64_t capacity, uint64_t count, std::string& error);
+
+    // Empties the index and re-inserts records [0, count).
+    void rebuild_index();
+    void index_insert(uint32_t record_no);
+
+    static uint64_t hash_name(std::string_view name);
+    static uint32_t checksum(const Record& r);
+
+    std::string path;
+    int fd{-1};
+    char* base{nullptr};    // Start of the mapping
+    size_t mapped{0};       // Mapping length
+    bool unsynced{false};   // See dirty()
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+// std::atomic — the process-wide total, updated by every reactor
+#include <atomic>
+// int64_t
+#include <cstdint>
+// size_t
+#include <cstddef>
+
+// ============================================================================
+// MemoryBudget — a process-wide byte budget shared by every reactor
+// ([NETWORK] input_memory_budget_mb, output_memory_budget_mb).
+//
+// Reactors don't touch the shared total per recv() or per queued payload:
+// each charges its own Share, which publishes to the total only once it
+// drifted by SLACK bytes. The total is therefore exact to within
+// SLACK × reactors, plenty for a limit in megabytes, and the hot path
+// stays a plain add on reactor-local memory.
+// ============================================================================
+class MemoryBudget {
+public:
+    static constexpr int64_t SLACK = 64 * 1024;
+
+    // 0 = unlimited (usage is still accounted). Any thread.
+    void set_limit(size_t bytes) noexcept { cap.store(bytes, std::memory_order_relaxed); }
+    size_t limit() const noexcept { return cap.load(std::memory_order_relaxed); }
+
+    // Bytes charged by every reactor, as last published.
+    int64_t used() const noexcept { return total.load(std::memory_order_relaxed); }
+
+    // The limit is set and reached.
+    bool exhausted() const noexcept
+    {
+        const size_t l = limit();
+        return l != 0 && used() >= static_cast<int64_t>(l);
+    }
+
+    // One reactor's part of the budget. Single writer.
+    class Share {
+    public:
+        explicit Share(MemoryBudget& budget) noexcept : owner(budget) {}
+        ~Share() { publish(); }
+
+        Share(const Share&) = delete;
+        Share& operator=(const Share&) = delete;
+
+        // Charges (n > 0) or credits (n < 0) `n` bytes.
+        void add(int64_t n) noexcept
+        {
+            pending += n;
+            if (pending >= SLACK || pending <= -SLACK) publish();
+        }
+
+        void publish() noexcept
+        {
+            if (pending) owner.total.fetch_add(pending, std::memory_order_relaxed);
+            pending = 0;
+        }
+
+    private:
+        MemoryBudget& owner;
+        int64_t pending{0}; // Not yet in owner.total
+    };
+
+private:
+    std::atomic<size_t> cap{0};
+    std::atomic<int64_t> total{0};
+};
@@ -0,0 +1,99 @@
+#include "message_history.hpp"
+
+void MessageHistory::configure(size_t _capacity, size_t _max_bytes, bool global)
+{
+    if (global != global_scope || _capacity == 0) {
+        rings.clear();
+        age.clear();
+        total_bytes    = 0;
+        total_messages = 0;
+    }
+    global_scope = global;
+    max_bytes    = _max_bytes;
+
+    if (_capacity != capacity) {
+        // Keep the newest entries that still fit, in order.
+        for (auto& [name, r] : rings) {
+            while (r.count > _capacity) pop_oldest(r);
+            std::vector<Entry> slots(_capacity);
+            for (size_t i = 0; i < r.count; ++i) slots[i] = std::move(r.slots[(r.head + i) % r.slots.size()]);
+            r.slots = std::move(slots);
+            r.head  = 0;
+        }
+        capacity = _capacity;
+        compact_age();
+    }
+
+    enforce_cap(nullptr);
+}
+
+void MessageHistory::record(const std::string& channel, const SharedPayload& line, const SharedPayload& frame)
+{
+    if (!capacity) return;
+
+    const std::string& key = global_scope ? global_key() : channel;
+    auto it = rings.find(key);
+    if (it == rings.end()) {
+        it = rings.emplace(key, Ring{}).first;
+        it->second.name = key;
+        it->second.slots.resize(capacity);
+    }
+    Ring& r = it->second;
+
+    if (r.count == capacity) pop_oldest(r); // Its age item goes stale
+    Entry& slot = r.slots[(r.head + r.count) % capacity];
+    slot.line  = line;
+    slot.frame = frame;
+    slot.seq   = next_seq++;
+    ++r.count;
+    ++r.refs;
+    total_bytes += entry_bytes(slot);
+    ++total_messages;
+    age.push_back({&r, slot.seq});
+
+    enforce_cap(&r);
+    if (age.size() > 2 * total_messages + 64) compact_age();
+}
+
+void MessageHistory::enforce_cap(const Ring* keep)
+{
+    while (total_bytes > max_bytes && !age.empty()) {
+        const Age oldest = age.front();
+        Ring& victim     = *oldest.ring;
+        const bool live  = victim.count && victim.slots[victim.head].seq == oldest.seq;
+        if (live && &victim == keep && victim.count == 1) break; // The message just recorded
+        age.pop_front();
+        if (live) pop_oldest(victim);
+        release_ref(oldest.ring);
+    }
+}
+
+void MessageHistory::pop_oldest(Ring& r)
+{
+    Entry& e = r.slots[r.head];
+    total_bytes -= entry_bytes(e);
+    --total_messages;
+    e.line.reset(); // The recipients' queues keep their own references
+    e.frame.reset();
+    r.head = (r.head + 1) % r.slots.size();
+    --r.count;
+}
+
+void MessageHistory::compact_age()
+{
+    std::deque<Age> live;
+    for (const Age& a : age) {
+        const Ring& r = *a.ring;
+        if (r.count && a.seq >= r.slots[r.head].seq) live.push_back(a);
+        else release_ref(a.ring);
+    }
+    age.swap(live);
+}
+
+void MessageHistory::release_ref(Ring* r)
+{
+    if (--r->refs == 0) {
+        const std::string name = r->name; // Erasing destroys the key
+        rings.erase(name);
+    }
+}
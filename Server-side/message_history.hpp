@@ -0,0 +1,114 @@
+#pragma once
+
+// size_t / uint64_t — ring positions, sequence numbers, byte counts
+#include <cstddef>
+#include <cstdint>
+// std::deque — global age order used by the byte cap
+#include <deque>
+// std::string — channel names (ring keys)
+#include <string>
+// Channel → ring
+#include <unordered_map>
+// std::vector — ring slots
+#include <vector>
+// SharedPayload — the refcounted broadcast buffers
+#include "mailbox.hpp"
+
+// ============================================================================
+// MessageHistory — the most recent chat messages, replayed to a client
+// right after it logs in (and, per channel, when it joins one).
+//
+// Entries are the refcounted payloads the broadcast already built for
+// fan-out (the v1 line and the v2 frame): recording is two refcount bumps,
+// and a replay pushes the same references onto the client's write queue,
+// so no message is ever copied for history. In a ReactorGroup every reactor
+// keeps its own history of the same shared buffers.
+//
+// One fixed-capacity ring per channel (or a single ring in global scope)
+// holds the last `capacity` messages. Once the rings together reference
+// more than `max_bytes`, the oldest message of any ring is evicted first.
+// Single-threaded: owned by one reactor.
+// ============================================================================
+class MessageHistory {
+public:
+    struct Entry {
+        SharedPayload line;  // v1 encoding
+        SharedPayload frame; // v2 encoding
+        uint64_t seq{0};     // Recording order across all rings
+    };
+
+    // `capacity` messages per ring (0 disables history and drops it all),
+    // `max_bytes` for every ring together. `global`: one ring for all
+    // channels. Shrinking evicts at once; changing the scope clears.
+    void configure(size_t capacity, size_t max_bytes, bool global);
+
+    bool enabled() const { return capacity > 0; }
+    bool global() const { return global_scope; }
+
+    // Appends one broadcast of `channel` (both encodings must be set).
+    void record(const std::string& channel, const SharedPayload& line, const SharedPayload& frame);
+
+    // Calls fn(const Entry&) for each kept message of `channel` (every
+    // channel in global scope), oldest first.
+    template <typename Fn>
+    void replay(const std::string& channel, Fn&& fn) const
+    {
+        auto it = rings.find(global_scope ? global_key() : channel);
+        if (it == rings.end()) return;
+        const Ring& r = it->second;
+        for (size_t i = 0; i < r.count; ++i) fn(r.slots[(r.head + i) % r.slots.size()]);
+    }
+
+    size_t bytes() const { return total_bytes; }       // Referenced payload bytes
+    size_t messages() const { return total_messages; } // Entries kept
+
+private:
+    struct Ring {
+        std::string name;         // Key in `rings`
+        std::vector<Entry> slots; // `capacity` entries, used circularly
+        size_t head{0};           // Oldest entry
+        size_t count{0};
+        size_t refs{0};           // Items in `age` pointing here
+    };
+
+    // Evicts the oldest messages until the byte cap holds again, but never
+    // the last one of `keep` (a message bigger than the cap is still kept).
+    void enforce_cap(const Ring* keep);
+
+    // Drops the oldest entry of `r` (its item in `age` goes stale).
+    void pop_oldest(Ring& r);
+
+    // Removes items of `age` whose entry was already overwritten.
+    void compact_age();
+
+    // Forgets `r` once `age` no longer points at it (it is then empty).
+    void release_ref(Ring* r);
+
+    // The one ring's key in global scope.
+    static const std::string& global_key()
+    {
+        static const std::string key;
+        return key;
+    }
+
+    static size_t entry_bytes(const Entry& e) { return e.line->size() + e.frame->size(); }
+
+    size_t capacity{0};
+    size_t max_bytes{0};
+    bool global_scope{false};
+    uint64_t next_seq{1};
+    size_t total_bytes{0};
+    size_t total_messages{0};
+
+    // Node-based: Ring addresses stay valid while `age` refers to them.
+    std::unordered_map<std::string, Ring> rings;
+
+    // Every recorded message, oldest first, for the byte cap. An entry
+    // overwritten by its own ring leaves a stale item here; they are
+    // skipped at the front and compacted once they outnumber live ones.
+    struct Age {
+        Ring* ring;
+        uint64_t seq;
+    };
+    std::deque<Age> age;
+};
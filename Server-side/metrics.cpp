@@ -0,0 +1,302 @@
+#include "metrics.hpp"
+
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace metrics {
+
+const char* reason_name(DisconnectReason reason)
+{
+    switch (reason) {
+        case DisconnectReason::PeerClosed:    return "peer_closed";
+        case DisconnectReason::RecvError:     return "recv_error";
+        case DisconnectReason::SendError:     return "send_error";
+        case DisconnectReason::IdleTimeout:   return "idle_timeout";
+        case DisconnectReason::ProtocolError: return "protocol_error";
+        case DisconnectReason::TlsError:      return "tls_error";
+        case DisconnectReason::Shutdown:      return "shutdown";
+        case DisconnectReason::LoggedInElsewhere: return "logged_in_elsewhere";
+        case DisconnectReason::InputOverflow: return "input_overflow";
+        case DisconnectReason::MemoryPressure: return "memory_pressure";
+        case DisconnectReason::SlowConsumer:  return "slow_consumer";
+        case DisconnectReason::Kicked:        return "kicked";
+        case DisconnectReason::Count:         break;
+    }
+    return "unknown";
+}
+
+const char* table_name(Table table)
+{
+    switch (table) {
+        case Table::Clients:          return "clients";
+        case Table::Users:            return "users";
+        case Table::Usernames:        return "usernames";
+        case Table::ConnectionsPerIp: return "connections_per_ip";
+        case Table::Channels:         return "channels";
+        case Table::Presence:         return "presence";
+        case Table::OrphanedSends:    return "orphaned_sends";
+        case Table::Count:            break;
+    }
+    return "unknown";
+}
+
+namespace {
+
+// Buckets summed over every reactor.
+struct Merged {
+    uint64_t buckets[Histogram::BUCKETS] = {0};
+    uint64_t sum{0};
+    uint64_t count{0};
+};
+
+Merged merge(const std::vector<const ReactorMetrics*>& reactors, Histogram ReactorMetrics::*member)
+{
+    Merged m;
+    for (const ReactorMetrics* r : reactors) {
+        const Histogram& h = r->*member;
+        for (unsigned i = 0; i < Histogram::BUCKETS; ++i) {
+            uint64_t n = h.bucket(i);
+            m.buckets[i] += n;
+            m.count      += n;
+        }
+        m.sum += h.sum();
+    }
+    return m;
+}
+
+void header(std::string& out, const char* name, const char* type, const char* help)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, const char* value)
+{
+    out.append(name);
+    if (!labels.empty()) out.append("{").append(labels).append("}");
+    out.append(" ").append(value).append("\n");
+}
+
+// Counts stay exact integers; only scaled values go through %g.
+void sample(std::string& out, const std::string& name, const std::string& labels, uint64_t value)
+{
+    sample(out, name, labels, std::to_string(value).c_str());
+}
+
+void sample(std::string& out, const std::string& name, const std::string& labels, double value)
+{
+    char num[32];
+    std::snprintf(num, sizeof(num), "%.9g", value);
+    sample(out, name, labels, num);
+}
+
+void counter(std::string& out, const char* name, const char* help,
+             const std::vector<const ReactorMetrics*>& reactors, Counter ReactorMetrics::*member)
+{
+    uint64_t total = 0;
+    for (const ReactorMetrics* r : reactors) total += (r->*member).value();
+    header(out, name, "counter", help);
+    sample(out, name, "", total);
+}
+
+// One sample per reactor, labelled with its index.
+void gauge(std::string& out, const char* name, const char* help,
+           const std::vector<const ReactorMetrics*>& reactors, Gauge ReactorMetrics::*member)
+{
+    header(out, name, "gauge", help);
+    for (size_t i = 0; i < reactors.size(); ++i) {
+        std::string labels = "reactor=\"" + std::to_string(i) + "\"";
+        sample(out, name, labels, std::to_string((reactors[i]->*member).value()).c_str());
+    }
+}
+
+// Cumulative `le` buckets at 2^k - 1 for k = 0..max_k (exact bucket edges,
+// bounds inclusive as Prometheus defines them), scaled to the export unit.
+void histogram(std::string& out, const char* name, const char* help,
+               const std::vector<const ReactorMetrics*>& reactors,
+               Histogram ReactorMetrics::*member, unsigned max_k, double scale)
+{
+    const Merged m = merge(reactors, member);
+    header(out, name, "histogram", help);
+
+    const std::string base(name);
+    uint64_t cumulative = 0;
+    unsigned next       = 0; // First bucket not yet added
+    for (unsigned k = 0; k <= max_k; ++k) {
+        // 2^k is always a bucket edge, so whole buckets add up exactly.
+        const uint64_t limit = (uint64_t(1) << k) - 1; // Largest value counted
+        while (next + 1 < Histogram::BUCKETS && Histogram::lower_bound(next + 1) <= limit + 1) {
+            cumulative += m.buckets[next++];
+        }
+        char labels[48];
+        std::snprintf(labels, sizeof(labels), "le=\"%.9g\"", static_cast<double>(limit) * scale);
+        sample(out, base + "_bucket", labels, cumulative);
+    }
+    sample(out, base + "_bucket", "le=\"+Inf\"", m.count);
+    sample(out, base + "_sum", "", static_cast<double>(m.sum) * scale);
+    sample(out, base + "_count", "", m.count);
+}
+
+// Resident set of this process, from /proc/self/statm (0 if unreadable).
+uint64_t resident_bytes()
+{
+    unsigned long long size = 0, resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    if (std::fscanf(statm, "%llu %llu", &size, &resident) != 2) resident = 0;
+    std::fclose(statm);
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Descriptors open in this process (the scan's own included, as in
+// Prometheus' process collector).
+uint64_t open_fds()
+{
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) return 0;
+    uint64_t n = 0;
+    while (const dirent* e = readdir(dir)) {
+        if (e->d_name[0] != '.') ++n;
+    }
+    closedir(dir);
+    return n;
+}
+
+} // namespace
+
+std::string render_prometheus(const std::vector<const ReactorMetrics*>& reactors)
+{
+    std::string out;
+    out.reserve(16384);
+
+    histogram(out, "tcpserver_loop_iteration_seconds",
+              "Time spent handling one batch of ready events.",
+              reactors, &ReactorMetrics::loop_iteration_us, 26, 1e-6);
+    histogram(out, "tcpserver_auth_latency_seconds",
+              "Time from /login or /register to its answer (Argon2id included).",
+              reactors, &ReactorMetrics::auth_latency_us, 26, 1e-6);
+    histogram(out, "tcpserver_output_queue_delay_seconds",
+              "Time queued output waited for the socket (millisecond resolution).",
+              reactors, &ReactorMetrics::queue_delay_us, 26, 1e-6);
+    histogram(out, "tcpserver_broadcast_fanout",
+              "Local recipients per delivered chat message.",
+              reactors, &ReactorMetrics::fanout, 17, 1.0);
+
+    counter(out, "tcpserver_received_bytes_total", "Bytes read from client sockets.",
+            reactors, &ReactorMetrics::recv_bytes);
+    counter(out, "tcpserver_sent_bytes_total", "Bytes written to client sockets.",
+            reactors, &ReactorMetrics::send_bytes);
+    counter(out, "tcpserver_messages_routed_total", "Chat messages accepted for delivery.",
+            reactors, &ReactorMetrics::messages_routed);
+    counter(out, "tcpserver_auth_success_total", "Successful logins and registrations.",
+            reactors, &ReactorMetrics::auth_ok);
+    counter(out, "tcpserver_auth_failure_total", "Rejected logins and registrations.",
+            reactors, &ReactorMetrics::auth_failed);
+    counter(out, "tcpserver_sessions_resumed_total", "Sessions resumed with a token instead of a password.",
+            reactors, &ReactorMetrics::sessions_resumed);
+    counter(out, "tcpserver_local_logins_total", "Logins on the unix socket, authenticated by the peer's uid.",
+            reactors, &ReactorMetrics::local_logins);
+    counter(out, "tcpserver_password_rehashes_total", "Stored password hashes upgraded to the current Argon2id cost.",
+            reactors, &ReactorMetrics::password_rehashes);
+    counter(out, "tcpserver_send_errors_total", "Hard errors writing to a socket.",
+            reactors, &ReactorMetrics::send_errors);
+    counter(out, "tcpserver_connections_accepted_total", "Connections admitted.",
+            reactors, &ReactorMetrics::accepted);
+    counter(out, "tcpserver_connections_rejected_total", "Connections refused by the per-IP limit.",
+            reactors, &ReactorMetrics::rejected);
+    counter(out, "tcpserver_connections_memory_refused_total",
+            "Connections refused while a memory budget was exhausted.",
+            reactors, &ReactorMetrics::memory_refused);
+    counter(out, "tcpserver_connections_drain_refused_total",
+            "Connections refused while draining (admin channel `drain on`).",
+            reactors, &ReactorMetrics::drain_refused);
+    counter(out, "tcpserver_overload_refused_total",
+            "Connections and logins refused with a retry-after while the event loop lagged.",
+            reactors, &ReactorMetrics::overload_refused);
+    counter(out, "tcpserver_auth_deferred_total", "Logins held back while the event loop lagged.",
+            reactors, &ReactorMetrics::auth_deferred);
+    counter(out, "tcpserver_accept_paused_total", "Times overload control stopped accepting connections.",
+            reactors, &ReactorMetrics::accept_paused);
+    counter(out, "tcpserver_input_paused_total", "Times a client's reading stopped at its input buffer limit.",
+            reactors, &ReactorMetrics::input_paused);
+    counter(out, "tcpserver_read_buffers_released_total", "Grown read buffers returned to the heap once drained.",
+            reactors, &ReactorMetrics::read_buffers_released);
+    counter(out, "tcpserver_rate_limit_deferred_total", "Times a client's input was held over the rate limit.",
+            reactors, &ReactorMetrics::rate_deferred);
+    counter(out, "tcpserver_rate_limit_dropped_total", "Records dropped by the per-connection rate limit.",
+            reactors, &ReactorMetrics::rate_dropped);
+    counter(out, "tcpserver_record_budget_exhausted_total",
+            "Times a client used up its per-iteration record budget.",
+            reactors, &ReactorMetrics::budget_exhausted);
+    counter(out, "tcpserver_tls_handshakes_total", "Completed TLS handshakes.",
+            reactors, &ReactorMetrics::tls_handshakes);
+    counter(out, "tcpserver_ktls_tx_total", "TLS connections whose sends the kernel encrypts (kTLS).",
+            reactors, &ReactorMetrics::ktls_tx);
+    counter(out, "tcpserver_ktls_rx_total", "TLS connections whose receives the kernel decrypts (kTLS).",
+            reactors, &ReactorMetrics::ktls_rx);
+
+    header(out, "tcpserver_disconnects_total", "counter", "Closed connections by reason.");
+    for (unsigned r = 0; r < static_cast<unsigned>(DisconnectReason::Count); ++r) {
+        uint64_t total = 0;
+        for (const ReactorMetrics* m : reactors) total += m->disconnects[r].value();
+        std::string labels = std::string("reason=\"") + reason_name(static_cast<DisconnectReason>(r)) + "\"";
+        sample(out, "tcpserver_disconnects_total", labels, total);
+    }
+
+    counter(out, "tcpserver_history_replayed_total", "Past messages replayed to clients on login or join.",
+            reactors, &ReactorMetrics::history_replayed);
+    counter(out, "tcpserver_direct_delivered_total", "Private messages (/msg) queued to their recipient.",
+            reactors, &ReactorMetrics::direct_delivered);
+    counter(out, "tcpserver_direct_failed_total", "Private messages (/msg) refused because the recipient was offline.",
+            reactors, &ReactorMetrics::direct_failed);
+    counter(out, "tcpserver_presence_deltas_total", "Presence deltas (/who) published to subscribers.",
+            reactors, &ReactorMetrics::presence_deltas);
+    counter(out, "tcpserver_deflated_frames_total", "Compressed frames (protocol v2 DEFLATE) queued to clients.",
+            reactors, &ReactorMetrics::deflated_frames);
+    counter(out, "tcpserver_deflate_saved_bytes_total", "Bytes compression saved over the plain frames.",
+            reactors, &ReactorMetrics::deflate_saved_bytes);
+    counter(out, "tcpserver_slow_consumer_dropped_total",
+            "Channel messages dropped from the queues of clients that read too slowly.",
+            reactors, &ReactorMetrics::slow_consumer_dropped);
+    counter(out, "tcpserver_chat_log_appended_total", "Messages queued for the on-disk chat log.",
+            reactors, &ReactorMetrics::chat_log_appended);
+    counter(out, "tcpserver_chat_log_dropped_total", "Messages not logged because the chat log writer fell behind.",
+            reactors, &ReactorMetrics::chat_log_dropped);
+
+    gauge(out, "tcpserver_loop_lag_microseconds", "Smoothed event-loop lag, per reactor.",
+          reactors, &ReactorMetrics::loop_lag_us);
+    gauge(out, "tcpserver_overload_stage",
+          "Overload control: 0 normal, 1 accept paused and logins held, 2 rejecting, per reactor.",
+          reactors, &ReactorMetrics::overload_stage);
+    gauge(out, "tcpserver_connections", "Connected clients per reactor.",
+          reactors, &ReactorMetrics::connections);
+    gauge(out, "tcpserver_history_bytes", "Payload bytes held by the message history, per reactor.",
+          reactors, &ReactorMetrics::history_bytes);
+    gauge(out, "tcpserver_input_buffer_bytes", "Read buffer memory held by connected clients, per reactor.",
+          reactors, &ReactorMetrics::input_buffer_bytes);
+    gauge(out, "tcpserver_output_queue_bytes", "Bytes queued to clients and not yet sent, per reactor.",
+          reactors, &ReactorMetrics::output_queue_bytes);
+    gauge(out, "tcpserver_recv_chunks_leased", "Receive arena chunks held by clients with partial input, per reactor.",
+          reactors, &ReactorMetrics::recv_chunks_leased);
+    gauge(out, "tcpserver_recv_arena_bytes", "Receive arena memory mapped, per reactor.",
+          reactors, &ReactorMetrics::recv_arena_bytes);
+
+    header(out, "tcpserver_table_entries", "gauge", "Entries of the reactor's connection and session tables.");
+    for (size_t i = 0; i < reactors.size(); ++i) {
+        for (unsigned t = 0; t < static_cast<unsigned>(Table::Count); ++t) {
+            std::string labels = "reactor=\"" + std::to_string(i) + "\",table=\"" +
+                                 table_name(static_cast<Table>(t)) + "\"";
+            sample(out, "tcpserver_table_entries", labels, std::to_string(reactors[i]->tables[t].value()).c_str());
+        }
+    }
+
+    // Standard process metrics, so a soak run reads everything from here.
+    header(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+    sample(out, "process_resident_memory_bytes", "", resident_bytes());
+    header(out, "process_open_fds", "gauge", "Number of open file descriptors.");
+    sample(out, "process_open_fds", "", open_fds());
+    return out;
+}
+
+} // namespace metrics
@@ -0,0 +1,190 @@
+#pragma once
+
+// std::atomic — counters read by the admin thread while a reactor writes them
+#include <atomic>
+// uint64_t
+#include <cstdint>
+// size_t
+#include <cstddef>
+// std::string — rendered exposition text
+#include <string>
+// Reactor list handed to render_prometheus()
+#include <vector>
+
+// ============================================================================
+// Event-loop metrics.
+//
+// Every reactor owns one ReactorMetrics and is its only writer, so a record
+// is a relaxed load + store of a cache-resident word: no lock prefix, no
+// shared cache line between reactors. The admin thread reads them with
+// relaxed loads at scrape time and sums over reactors; a scrape may see an
+// increment a few nanoseconds late, never a torn value.
+// ============================================================================
+namespace metrics {
+
+// Monotonic counter. Single writer (the owning reactor).
+class Counter {
+public:
+    void add(uint64_t n = 1) noexcept { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t value() const noexcept { return v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> v{0};
+};
+
+// Point-in-time value. Single writer.
+class Gauge {
+public:
+    void set(int64_t n) noexcept { v.store(n, std::memory_order_relaxed); }
+    void add(int64_t n) noexcept { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    int64_t value() const noexcept { return v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> v{0};
+};
+
+// HDR-style log-linear histogram of non-negative integers (microseconds,
+// recipients...). Values below 16 get exact buckets; above that every
+// power of two is split into 8 sub-buckets, i.e. at most 12.5% relative
+// error, up to 2^40. Recording is a count-leading-zeros and one counter
+// bump. Single writer.
+class Histogram {
+public:
+    static constexpr unsigned SUB_BITS = 3;
+    static constexpr unsigned SUB      = 1u << SUB_BITS;   // Sub-buckets per power of two
+    static constexpr unsigned MAX_EXP  = 40;               // Larger values share the last bucket
+    static constexpr unsigned BUCKETS  = (MAX_EXP - SUB_BITS + 1) * SUB + SUB;
+
+    void record(uint64_t value) noexcept
+    {
+        buckets[index_of(value)].add();
+        total.add(value);
+    }
+
+    // Bucket holding `value` (bucket i covers [lower_bound(i), lower_bound(i+1))).
+    static unsigned index_of(uint64_t value) noexcept
+    {
+        if (value < 2 * SUB) return static_cast<unsigned>(value);
+        unsigned msb   = 63u - static_cast<unsigned>(__builtin_clzll(value));
+        if (msb > MAX_EXP) return BUCKETS - 1;
+        unsigned shift = msb - SUB_BITS;
+        return (shift + 1) * SUB + static_cast<unsigned>((value >> shift) & (SUB - 1));
+    }
+
+    // Smallest value that lands in bucket `i`.
+    static uint64_t lower_bound(unsigned i) noexcept
+    {
+        if (i < 2 * SUB) return i;
+        unsigned shift = i / SUB - 1;
+        return static_cast<uint64_t>(SUB + i % SUB) << shift;
+    }
+
+    uint64_t bucket(unsigned i) const noexcept { return buckets[i].value(); }
+    uint64_t sum() const noexcept { return total.value(); }
+
+private:
+    Counter buckets[BUCKETS];
+    Counter total; // Sum of recorded values
+};
+
+// Why a connection was closed (disconnect_client()).
+enum class DisconnectReason : unsigned {
+    PeerClosed,    // EOF from the client
+    RecvError,     // recv() / RECV completion failed
+    SendError,     // Hard error writing to the socket
+    IdleTimeout,   // connection_timeout expired
+    ProtocolError, // Bad v2 preamble or oversized frame
+    TlsError,      // Failed TLS handshake or record, or kTLS required but unavailable
+    Shutdown,      // Server stopping
+    LoggedInElsewhere, // Lost a cluster login race (same name on a lower node)
+    InputOverflow, // v1 line longer than max_input_buffer, or more input than that buffered
+    MemoryPressure, // Shed while an input/output memory budget was exhausted
+    SlowConsumer,  // Over slow_consumer_queue_bytes / _max_delay_ms with nothing left to drop
+    Kicked,        // Ended by an operator (admin channel `kick`)
+    Count
+};
+
+const char* reason_name(DisconnectReason reason);
+
+// Per-reactor containers whose sizes are exported: under a steady load they
+// stay flat, so one that keeps growing is a leak (a teardown path that
+// forgets it). Sampled by TcpServer::sample_tables().
+enum class Table : unsigned {
+    Clients,          // `clients` (connections)
+    Users,            // `users` (interned names)
+    Usernames,        // `usernames` (this reactor's shard of online names)
+    ConnectionsPerIp, // `connections_per_ip`
+    Channels,         // `channels`
+    Presence,         // `presence` (/who)
+    OrphanedSends,    // io_uring: payloads of closed sockets still in the kernel
+    Count
+};
+
+const char* table_name(Table table);
+
+// Everything one reactor records.
+struct ReactorMetrics {
+    Histogram loop_iteration_us; // From epoll_wait()/io_uring_enter() return to the next wait
+    Counter recv_bytes;
+    Counter send_bytes;
+    Counter messages_routed;     // Chat messages accepted from local senders
+    Histogram fanout;            // Local recipients per delivered broadcast
+    Histogram auth_latency_us;   // /login or /register start → result applied
+    Counter auth_ok;
+    Counter auth_failed;
+    Counter sessions_resumed;    // Successful /resume (no Argon2id)
+    Counter local_logins;        // Logins on the unix socket, vouched for by SO_PEERCRED
+    Counter password_rehashes;   // Stored hashes moved to the current Argon2id cost
+    Counter send_errors;         // Hard socket write errors
+    Counter accepted;            // Connections admitted
+    Counter rejected;            // Connections refused by the per-IP cap
+    Counter memory_refused;      // ... refused while a memory budget was exhausted
+    Counter drain_refused;       // ... refused while draining (admin channel)
+    Counter overload_refused;    // ... or logins refused with a retry-after by overload control
+    Counter auth_deferred;       // Logins held back while the loop lagged
+    Counter accept_paused;       // Times overload control stopped accepting
+    Gauge loop_lag_us;           // Smoothed event-loop lag (see TcpServer::set_overload_control())
+    Gauge overload_stage;        // 0 normal, 1 accept paused + logins held, 2 rejecting
+    Counter rate_deferred;       // Clients held back a loop iteration by the rate limit
+    Counter rate_dropped;        // Records dropped by the rate limit
+    Counter budget_exhausted;    // Clients sent to the back of the line by the record budget
+    Counter tls_handshakes;      // Completed TLS handshakes
+    Counter ktls_tx;             // ... whose sends the kernel encrypts
+    Counter ktls_rx;             // ... whose receives the kernel decrypts
+    Counter history_replayed;    // Past messages queued to clients on login / join
+    Counter direct_delivered;    // /msg messages queued to a local recipient
+    Counter direct_failed;       // ... whose recipient was not online
+    Counter presence_deltas;     // Numbered presence deltas sent to /who subscribers
+    Counter deflated_frames;     // Compressed frames queued to clients
+    Counter deflate_saved_bytes; // Bytes those saved over the plain frames
+    Gauge history_bytes;         // Payload bytes referenced by the history rings
+    Gauge input_buffer_bytes;    // Read buffer capacity held by connected clients
+    Gauge output_queue_bytes;    // Bytes queued to clients, not yet taken by the kernel
+    Histogram queue_delay_us;    // Time a queued payload waited for the kernel (loop-clock ms × 1000)
+    Counter slow_consumer_dropped; // Channel messages the slow-consumer policy dropped
+    Counter input_paused;        // Times a client's reading stopped at max_input_buffer
+    Counter read_buffers_released; // Grown read buffers returned to the heap once drained
+    Gauge recv_chunks_leased;    // Receive arena chunks held by clients with partial input
+    Gauge recv_arena_bytes;      // Receive arena memory mapped
+    Counter chat_log_appended;   // Broadcasts queued for the on-disk chat log
+    Counter chat_log_dropped;    // ... refused because its writer fell behind
+    Gauge connections;           // Currently registered clients
+    Counter disconnects[static_cast<unsigned>(DisconnectReason::Count)];
+    Gauge tables[static_cast<unsigned>(Table::Count)]; // Entries per Table
+
+    void disconnected(DisconnectReason reason) noexcept
+    {
+        disconnects[static_cast<unsigned>(reason)].add();
+    }
+
+    void table(Table t, size_t entries) noexcept
+    {
+        tables[static_cast<unsigned>(t)].set(static_cast<int64_t>(entries));
+    }
+};
+
+// Prometheus text exposition (format 0.0.4) of the sum over `reactors`.
+// Latencies are exported in seconds, as Prometheus expects.
+std::string render_prometheus(const std::vector<const ReactorMetrics*>& reactors);
+
+} // namespace metrics
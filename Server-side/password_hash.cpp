@@ -0,0 +1,105 @@
+#include "password_hash.hpp"
+
+#include <sodium.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace password {
+
+namespace {
+
+// Calibration never goes below this much memory per hash: under it,
+// Argon2id loses most of its resistance to GPU cracking, and a host that
+// slow should be given a higher latency target instead.
+constexpr size_t MIN_CALIBRATED_MEMLIMIT = 8u << 20;
+
+// Nor above this many passes; past it, memory is the better knob.
+constexpr unsigned long long MAX_CALIBRATED_OPSLIMIT = 10;
+
+// Starts at the "interactive" preset: tuned for login latency, not for
+// the strongest resistance to offline attacks. Written once at startup.
+Cost current{crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE};
+
+// Fastest of a few hashes at `c` (the first one also faults the memory in).
+double time_hash_ms(const Cost& c)
+{
+    char encoded[crypto_pwhash_STRBYTES];
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        if (crypto_pwhash_str(encoded, "calibration", 11, c.opslimit, c.memlimit) != 0) {
+            throw std::runtime_error("Password hashing failed (out of memory?)");
+        }
+        const double ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+} // namespace
+
+Cost interactive()
+{
+    return Cost{crypto_pwhash_OPSLIMIT_INTERACTIVE, crypto_pwhash_MEMLIMIT_INTERACTIVE};
+}
+
+void set_cost(const Cost& cost)
+{
+    current = cost;
+}
+
+Cost cost()
+{
+    return current;
+}
+
+// Argon2id time is close to linear in both passes and memory, so one
+// timed pass is enough to pick the number of passes.
+Cost calibrate(double target_ms, size_t max_memlimit, double& measured_ms)
+{
+    Cost c{crypto_pwhash_OPSLIMIT_MIN, std::max<size_t>(max_memlimit & ~size_t((1u << 20) - 1),
+                                                        MIN_CALIBRATED_MEMLIMIT)};
+    double pass_ms = time_hash_ms(c);
+    while (pass_ms > target_ms && c.memlimit / 2 >= MIN_CALIBRATED_MEMLIMIT) {
+        c.memlimit /= 2;
+        pass_ms = time_hash_ms(c);
+    }
+
+    const double passes = pass_ms > 0 ? target_ms / pass_ms : 1;
+    c.opslimit = std::clamp(static_cast<unsigned long long>(passes), crypto_pwhash_OPSLIMIT_MIN,
+                            MAX_CALIBRATED_OPSLIMIT);
+    measured_ms = c.opslimit == crypto_pwhash_OPSLIMIT_MIN ? pass_ms : time_hash_ms(c);
+    return c;
+}
+
+std::string hash(const std::string& plaintext)
+{
+    char encoded[crypto_pwhash_STRBYTES];
+    if (crypto_pwhash_str(encoded, plaintext.c_str(), plaintext.size(), current.opslimit, current.memlimit) != 0) {
+        // Typically fails only under extreme memory pressure.
+        throw std::runtime_error("Password hashing failed (out of memory?)");
+    }
+    return std::string(encoded);
+}
+
+bool verify(const std::string& plaintext, const std::string& encoded)
+{
+    return crypto_pwhash_str_verify(encoded.c_str(), plaintext.c_str(), plaintext.size()) == 0;
+}
+
+// 1 means "different parameters", -1 "not a string it can parse"; both
+// get a fresh hash.
+bool needs_rehash(const std::string& encoded)
+{
+    return crypto_pwhash_str_needs_rehash(encoded.c_str(), current.opslimit, current.memlimit) != 0;
+}
+
+std::string describe_cost()
+{
+    return "Argon2id, opslimit " + std::to_string(current.opslimit) + ", " +
+           std::to_string(current.memlimit >> 20) + " MiB";
+}
+
+} // namespace password
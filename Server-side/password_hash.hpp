@@ -0,0 +1,59 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+#include <string>
+
+// ============================================================================
+// password — Argon2id (libsodium crypto_pwhash_str) for the user DB.
+//
+// Shared by the server (through TcpServer::hash_password/verify_password,
+// on the CryptoPool workers) and the offline tools, so an account created
+// by a bulk import is hashed exactly like one created by /register.
+// Thread-safe; sodium_init() must have run.
+//
+// The cost of new hashes is process-wide. It starts at libsodium's
+// "interactive" preset; the server replaces it at startup by one measured
+// on this host ([PROCESS] argon2_target_ms, argon2_memory_mb). Hashes
+// stored under another cost still verify (their parameters are encoded in
+// them), and needs_rehash() tells which ones to upgrade, or downgrade,
+// after a successful login.
+// ============================================================================
+namespace password {
+
+struct Cost {
+    unsigned long long opslimit; // Passes over the memory
+    size_t memlimit;             // Bytes per hash
+};
+
+// libsodium's interactive preset: 2 passes, 64 MiB.
+Cost interactive();
+
+// Cost of hash() from now on. Call before the first hash() runs (it is
+// not synchronized with running ones).
+void set_cost(const Cost& cost);
+Cost cost();
+
+// Benchmarks Argon2id on the calling thread and returns the largest cost
+// whose hash takes about `target_ms`: memory `max_memlimit` (halved, down
+// to 8 MiB, while a single pass is already too slow), then as many passes
+// as fit. `measured_ms` is the time one hash at that cost took. Takes a
+// few times `target_ms`.
+Cost calibrate(double target_ms, size_t max_memlimit, double& measured_ms);
+
+// Self-describing encoded hash of `plaintext` (algorithm, parameters and
+// salt included). Throws std::runtime_error when libsodium can't get the
+// memory.
+std::string hash(const std::string& plaintext);
+
+// Constant-time check of `plaintext` against `encoded`.
+bool verify(const std::string& plaintext, const std::string& encoded);
+
+// True if `encoded` wasn't made with cost() (or isn't an Argon2id hash
+// libsodium can reproduce): a login that verified it should store a new one.
+bool needs_rehash(const std::string& encoded);
+
+// "Argon2id, opslimit 2, 64 MiB" — the cost of hash(), for logs and tools.
+std::string describe_cost();
+
+} // namespace password
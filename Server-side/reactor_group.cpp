@@ -0,0 +1,66 @@
+#include "reactor_group.hpp"
+#include "server-header.hpp"
+
+// Builds the mailboxes up front; the vector is never resized afterwards, so
+// worker threads can index it without synchronization.
+ReactorGroup::ReactorGroup(size_t workers)
+    : servers(workers, nullptr)
+{
+    mailboxes.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        mailboxes.push_back(std::make_unique<Mailbox>());
+    }
+}
+
+// Stores the non-owning worker pointer used by requestShutdown().
+void ReactorGroup::attach(size_t id, TcpServer* server)
+{
+    servers[id] = server;
+}
+
+// One allocation per remote worker for the envelope; the payload itself is
+// only refcounted, so cost stays O(workers), not O(workers × message size).
+void ReactorGroup::broadcast(size_t origin, const std::string& channel,
+                             const SharedPayload& payload, const SharedPayload& frame,
+                             const SharedPayload& deflated)
+{
+    for (size_t worker = 0; worker < mailboxes.size(); ++worker) {
+        if (worker == origin) continue;
+
+        auto* msg          = new MailboxMessage;
+        msg->type          = MailboxMessage::Broadcast;
+        msg->origin_worker = origin;
+        msg->channel       = channel;
+        msg->payload       = payload;
+        msg->frame         = frame;
+        msg->deflated      = deflated;
+        mailboxes[worker]->push(msg);
+    }
+}
+
+void ReactorGroup::channel_joined(const std::string& channel)
+{
+    std::lock_guard<std::mutex> lock(directory_lock);
+    ++directory[channel];
+}
+
+void ReactorGroup::channel_left(const std::string& channel)
+{
+    std::lock_guard<std::mutex> lock(directory_lock);
+    auto it = directory.find(channel);
+    if (it != directory.end() && --it->second == 0) directory.erase(it);
+}
+
+std::vector<std::pair<std::string, size_t>> ReactorGroup::channel_list() const
+{
+    std::lock_guard<std::mutex> lock(directory_lock);
+    return {directory.begin(), directory.end()};
+}
+
+// Called from the signal handler: atomic stores only, no allocation/locks.
+void ReactorGroup::requestShutdown() noexcept
+{
+    for (TcpServer* server : servers) {
+        if (server) server->requestShutdown();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>   // std::hash — username → owning shard
+#include <map>          // Sorted channel directory
+#include <mutex>        // Guards the channel directory (join/part/list only)
+#include <utility>      // std::pair
+#include "mailbox.hpp"
+
+class TcpServer;
+
+// ============================================================================
+// ReactorGroup — glue between N independent TcpServer event loops
+// ([NETWORK] worker_threads > 1). Each worker owns its listener
+// (SO_REUSEPORT), epoll instance and slice of clients; the only shared
+// structures are the per-worker lock-free mailboxes below.
+//
+// Username uniqueness is sharded: every name hashes to exactly one owning
+// worker, and only that worker's thread ever touches its shard. Claims and
+// releases from other workers travel as mailbox messages, so no global lock
+// is needed on the message path. The one lock guards the channel directory,
+// which only /join, /part and /channels touch.
+// ============================================================================
+class ReactorGroup {
+public:
+    // Creates one mailbox per worker. Servers are attached afterwards.
+    explicit ReactorGroup(size_t workers);
+
+    // Number of reactors in the group.
+    size_t size() const { return mailboxes.size(); }
+
+    // Registers `server` as worker `id` (called once per worker before run()).
+    void attach(size_t id, TcpServer* server);
+
+    // The reactor attached as `worker`.
+    TcpServer* server(size_t worker) const { return servers[worker]; }
+
+    // Mailbox owned by `worker` (its eventfd is polled by that reactor).
+    Mailbox& mailbox(size_t worker) { return *mailboxes[worker]; }
+
+    // Worker whose shard holds `username`.
+    size_t owner_of(const std::string& username) const
+    {
+        return std::hash<std::string>{}(username) % mailboxes.size();
+    }
+
+    // Hands `msg` to `worker` (ownership moves to the receiving mailbox).
+    void post(size_t worker, MailboxMessage* msg) { mailboxes[worker]->push(msg); }
+
+    // Posts `payload` (v1 line), `frame` (v2 encoding) and `deflated` (its
+    // Compressed frame, may be null) for `channel` to every worker except
+    // `origin`; the bytes are shared.
+    void broadcast(size_t origin, const std::string& channel, const SharedPayload& payload,
+                   const SharedPayload& frame, const SharedPayload& deflated);
+
+    // Network-wide member counts per channel, for /channels. Each worker
+    // keeps its own member index; this only sums them up.
+    void channel_joined(const std::string& channel);
+    void channel_left(const std::string& channel);
+    std::vector<std::pair<std::string, size_t>> channel_list() const;
+
+    // Async-signal-safe: only flips each attached server's atomic run flag.
+    void requestShutdown() noexcept;
+
+private:
+    std::vector<std::unique_ptr<Mailbox>> mailboxes; // Indexed by worker id
+    std::vector<TcpServer*> servers;                 // Non-owning, indexed by worker id
+
+    mutable std::mutex directory_lock;
+    std::map<std::string, size_t> directory;         // Channel → members on all workers
+};
@@ -0,0 +1,141 @@
+#include "recv_arena.hpp"
+
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+namespace {
+
+constexpr size_t CHUNKS_PER_SLAB = RecvArena::SLAB_SIZE / RecvArena::CHUNK_SIZE;
+
+// Anonymous read-write memory at `addr` (MAP_FIXED when given), either from
+// the huge page pool or as regular pages with THP asked for.
+void* map_area(void* addr, size_t len, bool huge, bool& got_huge)
+{
+    const int fixed = addr ? MAP_FIXED : 0;
+    got_huge = false;
+    if (huge && len % RecvArena::SLAB_SIZE == 0) {
+        void* p = mmap(addr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB | fixed, -1, 0);
+        if (p != MAP_FAILED) {
+            got_huge = true;
+            return p;
+        }
+        // The pool is empty (vm.nr_hugepages) or there is none: fall back.
+    }
+    void* p = mmap(addr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | fixed, -1, 0);
+    if (p != MAP_FAILED && len >= RecvArena::SLAB_SIZE) madvise(p, len, MADV_HUGEPAGE);
+    return p;
+}
+
+} // namespace
+
+void* map_buffer_area(size_t len, bool huge, bool& got_huge)
+{
+    return map_area(nullptr, len, huge, got_huge);
+}
+
+RecvArena::RecvArena(size_t max_bytes, bool huge_pages)
+    : ChunkSource(CHUNK_SIZE), want_huge(huge_pages)
+{
+    const size_t count = max_bytes / SLAB_SIZE + (max_bytes % SLAB_SIZE ? 1 : 0);
+    slabs.resize(count ? count : 1);
+
+    // Address space only; one extra slab to align the start to a huge page.
+    reserved_len = (slabs.size() + 1) * SLAB_SIZE;
+    void* p = mmap(nullptr, reserved_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error(std::string("mmap(receive arena) failed: ") + strerror(errno));
+    }
+    reserved = static_cast<char*>(p);
+    const uintptr_t start = reinterpret_cast<uintptr_t>(reserved);
+    base = reinterpret_cast<char*>((start + SLAB_SIZE - 1) & ~uintptr_t(SLAB_SIZE - 1));
+
+    // Mapped now to learn whether huge pages are there. Its pages are only
+    // faulted in by the first recv(), on the reactor's own thread.
+    map_slab(0);
+}
+
+RecvArena::~RecvArena()
+{
+    if (reserved) munmap(reserved, reserved_len);
+}
+
+char* RecvArena::lease()
+{
+    for (size_t i = lowest; i < slabs.size(); ++i) {
+        Slab& s = slabs[i];
+        if (!s.mapped && !map_slab(i)) {
+            lowest = i;
+            return nullptr;
+        }
+        if (s.free.empty()) continue;
+
+        lowest = i;
+        if (spare == static_cast<long>(i)) spare = -1;
+        const uint32_t index = s.free.back();
+        s.free.pop_back();
+        ++s.used;
+        ++in_use;
+        return base + i * SLAB_SIZE + size_t(index) * CHUNK_SIZE;
+    }
+    lowest = slabs.size();
+    return nullptr;
+}
+
+void RecvArena::give_back(char* chunk)
+{
+    const size_t offset = static_cast<size_t>(chunk - base);
+    const size_t i      = offset / SLAB_SIZE;
+    Slab& s             = slabs[i];
+    s.free.push_back(static_cast<uint32_t>((offset % SLAB_SIZE) / CHUNK_SIZE));
+    --s.used;
+    --in_use;
+    if (i < lowest) lowest = i;
+    if (s.used) return;
+
+    // Two empty slabs: keep the lower one, the next leases go there anyway.
+    if (spare < 0) {
+        spare = static_cast<long>(i);
+    } else {
+        const size_t other = static_cast<size_t>(spare);
+        spare = static_cast<long>(other < i ? other : i);
+        unmap_slab(other < i ? i : other);
+    }
+}
+
+bool RecvArena::map_slab(size_t index)
+{
+    Slab& s = slabs[index];
+    bool huge = false;
+    if (map_area(base + index * SLAB_SIZE, SLAB_SIZE, want_huge, huge) == MAP_FAILED) return false;
+    hugetlb  = huge;
+    s.mapped = true;
+    s.used   = 0;
+    s.free.clear();
+    s.free.reserve(CHUNKS_PER_SLAB);
+    for (size_t c = CHUNKS_PER_SLAB; c-- > 0;) s.free.push_back(static_cast<uint32_t>(c)); // Chunk 0 first
+    ++mapped;
+    return true;
+}
+
+void RecvArena::unmap_slab(size_t index)
+{
+    Slab& s = slabs[index];
+    // Back to reserved address space; the pages go back to the kernel.
+    mmap(base + index * SLAB_SIZE, SLAB_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+         -1, 0);
+    s.mapped = false;
+    std::vector<uint32_t>().swap(s.free);
+    --mapped;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// uint32_t — chunk indices
+#include <cstdint>
+// size_t
+#include <cstddef>
+// std::vector — per-slab free lists
+#include <vector>
+// ChunkSource — what client read buffers borrow from
+#include <read_buffer.hpp>
+
+// ============================================================================
+// RecvArena — fixed-size receive chunks for the reactor's client read
+// buffers ([NETWORK] recv_arena_mb, recv_huge_pages).
+//
+// A client only holds a chunk while it has unframed input: the first recv()
+// borrows one, and it goes back once framing consumed everything (see
+// TcpServer::settle_read_buffer()), so 100k idle connections hold no
+// receive memory at all. Input that outgrows a chunk (a v1 line or v2
+// frame longer than CHUNK_SIZE) moves to a heap buffer of its own.
+//
+// Chunks are carved from 2 MiB slabs in one reserved address range, each
+// mapped with MAP_HUGETLB when huge pages are asked for and available
+// (transparent huge pages otherwise), so the receive path of thousands of
+// connections touches a handful of TLB entries. Leases prefer the lowest
+// slab with a free chunk; a slab that empties is unmapped, except for one
+// kept as a spare against churn. Pages are faulted in by the first recv()
+// into them, on the reactor's thread, so they come from its NUMA node.
+// Single-threaded: owned by one reactor.
+// ============================================================================
+class RecvArena final : public ChunkSource {
+public:
+    static constexpr size_t SLAB_SIZE  = 2 * 1024 * 1024;
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    // Reserves (without committing) room for `max_bytes`, rounded up to
+    // whole slabs. Throws std::runtime_error if the range can't be reserved.
+    RecvArena(size_t max_bytes, bool huge_pages);
+    ~RecvArena() override;
+
+    RecvArena(const RecvArena&) = delete;
+    RecvArena& operator=(const RecvArena&) = delete;
+
+    char* lease() override;
+    void give_back(char* chunk) override;
+
+    size_t leased() const { return in_use; }
+    size_t mapped_bytes() const { return mapped * SLAB_SIZE; }
+
+    // Slabs come from the huge page pool: false when it was empty (or
+    // huge pages weren't asked for), and THP was used instead.
+    bool huge_pages() const { return hugetlb; }
+
+private:
+    struct Slab {
+        std::vector<uint32_t> free; // Chunk indices within the slab
+        uint32_t used{0};
+        bool mapped{false};
+    };
+
+    bool map_slab(size_t index);
+    void unmap_slab(size_t index);
+
+    char* base{nullptr};       // Reserved range, SLAB_SIZE-aligned
+    size_t reserved_len{0};    // Whole mapping, alignment slack included
+    char* reserved{nullptr};
+    std::vector<Slab> slabs;
+    size_t lowest{0};          // No free chunk in slabs below this one
+    long spare{-1};            // The one empty slab kept mapped, or -1
+    size_t in_use{0};          // Chunks leased
+    size_t mapped{0};          // Slabs mapped
+    bool want_huge{false};
+    bool hugetlb{false};
+};
+
+// Maps `len` bytes of anonymous memory, from the huge page pool when
+// `huge` is set and `len` is a whole number of huge pages (THP otherwise).
+// `got_huge` tells which. MAP_FAILED on failure; release with munmap().
+void* map_buffer_area(size_t len, bool huge, bool& got_huge);
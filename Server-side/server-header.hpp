@@ -2,7 +2,7 @@
 
 // std::atomic<bool> — async-signal-safe flag
 #include <atomic>   
-// libsodium: crypto primitives (Argon2id hashing + future encryption)
+// libsodium: crypto primitives (Argon2id hashing)
 #include <sodium.h>
 // The logging system
 #include "common/Logger/logger.hpp"
@@ -30,14 +30,74 @@
 #include <csignal>
 // errno — error codes from system calls
 #include <cerrno>
-// fd → Client map (O(1) average lookup by socket fd)
+// fd → Client map, online user-id → worker shard (O(1) average lookups)
 #include <unordered_map>
-// Active username set for O(1) duplicate detection
-#include <unordered_set>
+// Per-client outbound write queue (FIFO of pending chunks)
+#include <deque>
+// std::shared_ptr — refcounted, immutable broadcast payloads
+#include <memory>
+// writev(), struct iovec — gather-writes of queued payload slices
+#include <sys/uio.h>
+// TCP_CORK — optional corking around coalesced flushes
+#include <netinet/tcp.h>
 // std::string — usernames, IPs, buffers, JSON fields
 #include <string>
-// nlohmann/json: header-only JSON library for credential persistence
-#include <nlohmann/json.hpp>
+// std::vector — channel member lists, joined-channel lists
+#include <vector>
+
+// Cross-reactor mailboxes + username sharding for worker_threads > 1
+#include "reactor_group.hpp"
+// Off-loop Argon2id hashing/verification
+#include "crypto_pool.hpp"
+// coro::Task / coro::Completion — the auth flow as one coroutine per client
+#include "task.hpp"
+// In-memory, write-through user DB index
+#include "credential_store.hpp"
+// Binary peer-address key for the per-IP connection counters
+#include "ip_key.hpp"
+#include "listen_endpoint.hpp"
+// Dense fd-indexed connection registry with pooled objects
+#include "fd_table.hpp"
+// Interned usernames addressed by compact UserIds
+#include "user_table.hpp"
+// Per-reactor counters and latency histograms (scraped by the AdminServer)
+#include "metrics.hpp"
+// io_uring completion backend ([NETWORK] io_backend = io_uring)
+#include "io_uring_backend.hpp"
+// POLLIN — mailbox eventfd poll in the io_uring backend
+#include <poll.h>
+// Hierarchical timer wheel for idle timeouts (and future per-client deadlines)
+#include "timer_wheel.hpp"
+// Per-connection inbound rate limits
+#include "token_bucket.hpp"
+// MAC'd session tokens for /resume
+#include "session_tokens.hpp"
+// SIGHUP-reloadable configuration snapshot
+#include "live_config.hpp"
+// Client state carried across a hot-upgrade handoff
+#include "handoff.hpp"
+// [NETWORK] socket options for the listener and accepted sockets
+#include "socket_tuning.hpp"
+// TLS handshake in userspace, records in the kernel (kTLS)
+#include "tls.hpp"
+// Recent broadcasts replayed on login / join
+#include "message_history.hpp"
+// Durable history for /history
+#include "chat_log.hpp"
+// Inbound traffic recording ([ADMIN] capture_file)
+#include "traffic_capture.hpp"
+// Peer links: relayed broadcasts, cluster-wide presence
+#include "cluster.hpp"
+// Process-wide input/output buffer budgets
+#include "memory_budget.hpp"
+// RecvArena — receive chunks leased to clients with partial input
+#include "recv_arena.hpp"
+// Operator commands on a Unix socket, answered by the reactors
+#include "admin_channel.hpp"
+// Per-client compacting receive buffer with in-place string_view framing
+#include <read_buffer.hpp>
+// Wire protocol v2: negotiation preamble, frame header, frame builders
+#include <protocol.hpp>
 
 // Shared utilities: bufferEndsWith, trimBuffer, isBufferEmpty,
 // parse_credentials, getString, getInt, etc.
@@ -45,9 +105,25 @@
 
 #define BUFFER_SIZE 1024                // Max bytes consumed per recv() call
 #define DUPLICATED_USERNAME_ERROR "101" // Protocol error code: username already taken
-#define MAX_EVENTS 10                   // Max events returned per epoll_wait() call
-#define MAX_CONNECTIONS_PER_IP 5        // Anti connection-flood per host
-#define CREDENTIALS_PATH "/var/lib/tcpserver/credentials.json" // On-disk JSON user DB
+#define DEFAULT_EPOLL_BATCH 256         // Default max events returned per epoll_wait() call
+#define URING_ENTRIES 4096              // io_uring SQ size (CQ is twice that)
+#define URING_BUFFERS 512               // Provided recv buffers per reactor (power of two)
+#define URING_BUFFER_SIZE 4096          // Bytes per provided recv buffer
+#define MAX_LINKED_SENDS 16             // Payloads per linked SEND chain
+#define TIMER_TICK_MS 100               // Timer wheel resolution (ms)
+#define MAX_WRITEV_SLICES 64            // Max queued payloads gathered per writev() call
+#define DEFAULT_COALESCE_DELAY_MS 2     // Longest a coalesced write waits for the end of a batch
+#define MAX_RATE_RETRY_MS 100           // Longest a rate-limited record waits for its retry
+#define DEFAULT_RECORD_BUDGET 32        // Records handled per client per loop iteration
+#define OVERLOAD_TICK_MS 100            // Longest loop wait while overloaded or holding logins
+#define DEFERRED_AUTH_BATCH 16          // Held logins resumed per iteration once the lag is back to normal
+#define TABLE_SAMPLE_MS 1000            // Interval of the table size gauges (tcpserver_table_entries)
+#define DEFAULT_CHANNEL "#general"      // Joined automatically after /login or /register
+#define MAX_CHANNELS_PER_CLIENT 16      // Channels one session may be in at once
+#define MAX_CHANNEL_NAME 32             // Bytes, including the leading '#'
+#define SMALL_READ_BUFFER (4 * BUFFER_SIZE) // Kept across reuse and drains; grows even under memory pressure
+#define OUTPUT_SHED_FLOOR 65536         // Queued bytes a client may hold before memory pressure sheds it
+#define CREDENTIALS_PATH "/var/lib/tcpserver/credentials.json" // Default on-disk JSON user DB
 
 
 // ============================================================================
@@ -57,52 +133,84 @@
 // ============================================================================
 class TcpServer {
 public:
-    // Creates the listening socket, sets SO_REUSEADDR, binds to
-    // ipv4_address:_port, and calls listen(). Throws on failure.
-    TcpServer(int _port = 25565, const char* ipv4_address = "127.0.0.1", Logger* _logger = nullptr);
+    // One immutable, refcounted message body (see mailbox.hpp). A broadcast
+    // allocates it once and every recipient's write_queue points at it.
+    using SharedPayload = ::SharedPayload;
+
+    // Takes over sockets that already listen, of either family: bound by
+    // ListenEndpoint::open() ([NETWORK] listen_address), or inherited from
+    // systemd socket activation or a hot-upgrade handoff. A reactor may
+    // have none, when every address is pinned to other reactors.
+    explicit TcpServer(std::vector<int> listeners, Logger* _logger = nullptr);
 
     // Closes all client fds, the epoll fd, and the server fd
     ~TcpServer();
 
     // Verifies a plaintext password against an Argon2id hash from the DB.
     // Uses crypto_pwhash_str_verify — never compares plaintext directly.
-    bool verify_password(const std::string& password, const std::string& stored_hash);
+    // Static (stateless) so CryptoPool workers can call it off-loop.
+    static bool verify_password(const std::string& password, const std::string& stored_hash);
 
     // Hashes a plaintext password with Argon2id (interactive cost parameters).
     // Returns the encoded hash string (includes salt, algorithm, params).
-    std::string hash_password(const std::string& password);
+    static std::string hash_password(const std::string& password);
 
-    // Guarantees all `length` bytes of `buff` are sent to `fd`.
-    // Loops on send() to handle partial writes. Returns 0 on success, -1 on error.
+    // Delivers all `length` bytes of `buff` to `fd` without ever blocking.
+    // Writes directly while the kernel accepts data; whatever is left after
+    // EAGAIN goes to the client's write_queue and EPOLLOUT is armed so run()
+    // resumes the write later. Returns 0 on success/queued, -1 on hard error.
     int sendAll(int fd, const char* buff, int length);
 
     // Convenience wrapper to send a std::string fully.
     int sendAll(int fd, const std::string& data);
 
+    // Zero-copy variant for fan-out: if the bytes can't all go out now, the
+    // queue keeps a reference to `payload` (plus an offset) instead of a copy.
+    // `droppable` (channel chat) lets the slow-consumer policy drop it
+    // while it waits.
+    int sendAll(int fd, const SharedPayload& payload, bool droppable = false);
+
     // Sets O_NONBLOCK on `fd` via fcntl.
     void set_NonBlocking(int fd);
 
-    // Creates the epoll instance and registers server_fd (EPOLLIN|EPOLLET).
+    // Creates the epoll instance and registers the listeners (EPOLLIN|EPOLLET).
     void initialize_epoll();
 
     // Registers `fd` with epoll under the given event mask.
     void add_to_epoll(int fd, uint32_t events);
 
+    // Replaces the event mask of an already registered `fd`.
+    void modify_epoll(int fd, uint32_t events);
+
     // Deregisters `fd` from epoll monitoring.
     void remove_from_epoll(int fd);
 
-    // Accepts pending connections on server_fd (ET-safe loop).
-    void handle_new_connection(Logger* logger);
+    // Writes as much of `fd`'s write_queue as the socket accepts, gathering
+    // up to MAX_WRITEV_SLICES queued payloads per writev(). Disarms EPOLLOUT
+    // once the queue is empty. Returns false on a hard send error.
+    bool flush_write_queue(int fd);
+
+    // Accepts pending connections on `listen_fd` (ET-safe loop).
+    void handle_new_connection(int listen_fd, Logger* logger);
 
-    // Appends a new user with hashed password + timestamp. Atomic write.
-    // Returns true on success.
+    // Appends a new user with hashed password + timestamp through the
+    // CredentialStore (write-through, atomic on disk). Returns true on success.
     bool save_credentials(const std::string& username,
                           const std::string& password,
                           const std::string& ip_addr);
 
-    // Returns true if username already exists in the persistent store.
+    // Appends a user whose password is already hashed (the CryptoPool path).
+    bool persist_user(const std::string& username,
+                      const std::string& password_hash,
+                      const std::string& ip_addr);
+
+    // Returns true if username already exists in the persistent store (O(1)).
     bool username_exists_in_db(const std::string& username);
 
+    // Fetches the stored Argon2id hash of `username` into `out`.
+    // Returns false if the user (or the DB) doesn't exist. No crypto work.
+    bool lookup_password_hash(const std::string& username, std::string& out);
+
     // Searches for matching username + password. Returns true if found.
     bool verify_credentials(const std::string& username,
                             const std::string& password);
@@ -112,33 +220,368 @@ public:
     void run();
 
     // Accessors — read-only introspection of server state.
-    int getServerFd() const { return server_fd; }
-    int getPort()     const { return port; }
+    const std::vector<int>& listeners() const { return listen_fds; }
+
+    // Joins a multi-reactor group as worker `id`. Must be called before run().
+    // Without a group the server behaves as the classic single event loop.
+    void attach_group(ReactorGroup* _group, size_t id);
+
+    // Routes Argon2id work to `pool` (non-owning; must outlive run()).
+    // Without a pool the hashing runs inline on the loop, as before.
+    void attach_crypto_pool(CryptoPool* pool) { crypto = pool; }
+
+    // After a login verified, re-hash the password in the background when
+    // its stored hash has another Argon2id cost than the current one
+    // ([PROCESS] argon2_rehash). Reloadable.
+    void set_password_rehash(bool on) { rehash_on_login = on; }
+
+    // Uses `db` (non-owning, already load()ed, shared by every reactor) as
+    // the user DB. Without one, CREDENTIALS_PATH is loaded on first use.
+    void attach_credential_store(CredentialStore* db) { store = db; }
+
+    // Issues a session token after every successful auth and accepts them
+    // in /resume (non-owning, shared by every reactor). Without one, /resume
+    // is refused and clients log in with their password as before.
+    void attach_session_tokens(const SessionTokens* tokens) { sessions = tokens; }
+
+    // Follows `cfg` (non-owning, shared by every reactor): each reactor
+    // applies a newly published config at the top of its next loop
+    // iteration, and reactor 0 performs reloads requested via SIGHUP.
+    // Only the tunables below marked "reloadable" change live.
+    void attach_live_config(LiveConfig* cfg) { live = cfg; }
+
+    // Speaks TLS on this listener (non-owning, may be shared by several
+    // listeners; see tls.hpp). Every accepted socket does the handshake
+    // before its first byte is read; once the kernel has the keys the
+    // connection is handled like a plaintext one. Without a context the
+    // listener stays plaintext. Must be called before run().
+    void attach_tls(const TlsContext* ctx) { tls_context = ctx; }
+
+    // Appends every broadcast to `log` and answers /history from it
+    // (non-owning, already open()ed, shared by every reactor). Without
+    // one, /history is refused.
+    void attach_chat_log(ChatLog* log) { chat_log = log; }
+
+    // Records the input of connections accepted while `c` captures
+    // (non-owning, shared by every reactor). apply_config() passes it the
+    // reloaded [ADMIN] capture_file.
+    void attach_traffic_capture(TrafficCapture* c) { capture = c; }
+
+    // Relays every broadcast to the other nodes of `c` and refuses logins
+    // of names online there (non-owning, shared by every reactor); relayed
+    // messages and kicks arrive in this reactor's mailbox. Must be called
+    // before run().
+    void attach_cluster(Cluster* c)
+    {
+        cluster = c;
+        if (cluster) cluster->add_reactor(&inbox());
+    }
+
+    // Answers the operator commands of `a` (non-owning, shared by every
+    // reactor) from this reactor's loop; they arrive in its mailbox.
+    void attach_admin_channel(AdminChannel* a)
+    {
+        if (a) a->add_reactor(&inbox());
+    }
+
+    // The encodings of one chat message: the v1 line and, if `with_frame`,
+    // the v2 frame, plus that frame as a Compressed frame when it's big
+    // enough and some client anywhere in the process negotiated compression
+    // (otherwise `deflated` is null). DEFAULT_CHANNEL keeps the historical
+    // "name: text" format. Also used by Cluster for relayed messages.
+    static void encode_chat(const std::string& channel, std::string_view name, std::string_view text,
+                            bool with_frame, SharedPayload& line, SharedPayload& frame,
+                            SharedPayload& deflated);
+
+    // Protocol v2 compression ([NETWORK] compression, compression_min_bytes,
+    // compression_level): offered in Hello when `enabled`; for the clients
+    // that accept it, broadcast frames of at least `min_bytes` and batches
+    // of history go out as raw DEFLATE, compressed once per broadcast.
+    // Process-wide (encode_chat() is shared by every reactor and the
+    // cluster thread). Reloadable; clients keep what they negotiated.
+    static void set_compression(bool enabled, int min_bytes, int level);
+
+    // Anti connection-flood cap: accepted sockets per peer address on this
+    // reactor ([NETWORK] max_connections_per_ip, at least 1).
+    // Reloadable.
+    void set_max_connections_per_ip(uint16_t limit) { max_connections_per_ip = limit ? limit : 1; }
+
+    // Who may connect to the unix socket ([NETWORK] unix_socket_users,
+    // "<uid or user>:<account>, ...") and which account each uid logs in
+    // as. Reloadable: a malformed list keeps the previous one (logged).
+    void set_local_peers(const std::string& list);
+
+    // Parses that list (system user names resolved here). False with
+    // `error` set on a malformed entry or an unknown user.
+    static bool parse_local_peers(const std::string& list, std::unordered_map<uint32_t, std::string>& out,
+                                  std::string& error);
+
+    // Pending-connection queue of the listening socket ([NETWORK]
+    // max_connections). Reloadable: listen() is simply called again.
+    void set_listen_backlog(int backlog);
+
+    // Longest unframed input one connection may buffer ([NETWORK]
+    // max_input_buffer, at least one whole v2 frame). A v1 line that
+    // doesn't fit closes the connection; a client whose complete records
+    // wait for the rate limit or the record budget with the buffer full
+    // isn't read from (epoll) until they got their turn, so TCP flow
+    // control holds the rest back. io_uring can't pause its multishot
+    // receive: there the connection is closed. Reloadable.
+    void set_max_input_buffer(int bytes);
+
+    // Process-wide memory budgets ([NETWORK] input_memory_budget_mb,
+    // output_memory_budget_mb; 0 = unlimited) over the read buffers and
+    // the write queues of every connection. Input exhausted: accepted
+    // sockets are closed right away and a client whose read buffer would
+    // have to grow past SMALL_READ_BUFFER is disconnected. Output
+    // exhausted: a client holding more than OUTPUT_SHED_FLOOR queued bytes
+    // gets nothing more and is disconnected at the end of the iteration.
+    // Either way the connections that hold the memory go first, and the
+    // rest keep working. Shared by every reactor. Reloadable.
+    static void set_memory_budgets(int input_mb, int output_mb);
+
+    // Receive chunks for the client read buffers ([NETWORK] recv_arena_mb,
+    // recv_huge_pages; see recv_arena.hpp): a client only holds one while
+    // it has unframed input. `huge_pages` also backs the io_uring provided
+    // buffers with a huge page. 0 MiB = every client keeps a heap buffer.
+    // Must be called before run() and before clients are added.
+    void set_recv_arena(int megabytes, bool huge_pages);
+
+    // What happens to a client that doesn't read its output ([NETWORK]
+    // slow_consumer_policy, slow_consumer_queue_bytes,
+    // slow_consumer_max_delay_ms): it is a slow consumer once it has more
+    // than `queue_bytes` queued, or its oldest queued byte waited longer
+    // than `max_delay_ms` (0 disables either test). Checked whenever
+    // something is queued to it. Drop removes its oldest channel messages
+    // until half of `queue_bytes` is left and none is older than
+    // `max_delay_ms`; Coalesce does the same and puts one notice saying how
+    // many were skipped in their place. Replies, notices, private messages
+    // and history are never dropped: a client still over a limit after
+    // that (and any client under Disconnect) is disconnected at the end of
+    // the iteration. Reloadable.
+    enum class SlowConsumerPolicy { Disconnect, Drop, Coalesce };
+    void set_slow_consumer_policy(SlowConsumerPolicy policy, int queue_bytes, int max_delay_ms);
+
+    // Overload control ([NETWORK] overload_lag_ms, overload_reject_lag_ms,
+    // overload_retry_after_s). The loop measures its lag after every
+    // iteration: the time that batch took (an event that arrived just
+    // after the wake-up waited that long) plus how late the wait itself
+    // returned, smoothed (1/4 weight per iteration). Past `lag_ms` it stops
+    // accepting and holds new /login and /register requests back before
+    // any Argon2id work; past `reject_lag_ms` it accepts again, but only
+    // to refuse connections and logins with "Error: server busy, retry
+    // after <retry_after_s>s". Each stage ends once the lag is back under
+    // half its threshold; held logins then resume, a few per iteration.
+    // `lag_ms` 0 disables it. Reloadable.
+    void set_overload_control(int lag_ms, int reject_lag_ms, int retry_after_s);
+
+    // [NETWORK] slow_consumer_policy: "disconnect", "drop" or "coalesce".
+    static SlowConsumerPolicy parse_slow_consumer_policy(const std::string& name);
+
+    // Socket profile ([NETWORK] tcp_nodelay, socket_*_buffer, tcp_defer_accept,
+    // tcp_notsent_lowat, busy_poll_us), set on the listener and inherited by
+    // accepted sockets. Refused options and the effective values are logged.
+    // Reloadable: applies to connections accepted afterwards.
+    void set_socket_tuning(const SocketTuning& t);
+
+    // Event loop implementation. IoUring falls back to Epoll if the ring
+    // can't be set up. Must be called before run().
+    enum class EventBackend { Epoll, IoUring };
+    void set_event_backend(EventBackend b) { backend = b; }
+
+    // Closes clients that send nothing for `seconds` ([NETWORK]
+    // connection_timeout). 0 disables it. Reloadable: connected clients are
+    // re-timed against the new value.
+    void set_idle_timeout(int seconds);
+
+    // Registers client sockets edge-triggered ([NETWORK] edge_triggered):
+    // fewer wakeups and no EPOLL_CTL_MOD around EPOLLOUT, since write
+    // interest stays armed permanently. Must be called before run().
+    void set_edge_triggered(bool on) { edge_triggered = on; }
+
+    // Max events taken per epoll_wait() ([NETWORK] epoll_batch_size, at
+    // least 1). Must be called before run().
+    void set_epoll_batch_size(int n) { epoll_batch = n > 0 ? n : 1; }
+
+    // Write coalescing ([NETWORK] write_coalescing): sends only queue their
+    // payload, and every dirty client is flushed with one writev() after the
+    // whole epoll batch was processed — or earlier once the batch has run for
+    // `max_delay_ms`. `cork` wraps each flush in TCP_CORK. epoll backend
+    // only (io_uring already batches its SENDs). Must be called before run()
+    // (only `max_delay_ms` is reloadable).
+    void set_write_coalescing(bool on, int max_delay_ms, bool cork)
+    {
+        coalesce_writes       = on;
+        coalesce_max_delay_ms = max_delay_ms > 0 ? uint64_t(max_delay_ms) : 0;
+        cork_writes           = cork;
+    }
+
+    // Per-connection inbound limits ([NETWORK] max_messages_per_sec,
+    // max_bytes_per_sec, rate_limit_burst): two token buckets, refilled from
+    // the loop clock and charged for every framed record, allowing bursts of
+    // `burst_seconds` worth. A record over the limit stays buffered until
+    // the next loop iteration; if the buckets are still short by then it is
+    // dropped, with a notice to the client and a warning in the log.
+    // 0 disables a limit. Reloadable.
+    void set_rate_limits(int messages_per_sec, int bytes_per_sec, int burst_seconds);
+
+    // Fair scheduling ([NETWORK] records_per_iteration): a client has at
+    // most `records` of its buffered records handled per loop iteration;
+    // the rest waits on a ready list and gets the next turn after the other
+    // ready clients, round-robin. 0 = unlimited. Reloadable.
+    void set_record_budget(int records);
+
+    // Message history ([HISTORY] messages, max_bytes, scope): the last
+    // `messages` broadcasts of each channel (or of all of them, `global`)
+    // are kept by reference and queued to a client after its login, and
+    // after each /join in channel scope. Reloadable; a new scope starts
+    // from an empty history.
+    void set_history(int messages, int max_bytes, bool global);
+
+    // Most messages one /history query returns ([HISTORY] log_query_max,
+    // at least 1). Reloadable.
+    void set_history_query_limit(int limit) { history_query_max = limit > 0 ? size_t(limit) : 1; }
+
+    // Monotonic clock in milliseconds (the timer wheel's time base).
+    static uint64_t monotonic_ms();
+
+    // Same clock in microseconds (latency metrics).
+    static uint64_t monotonic_us();
+
+    // Wall clock in seconds since the epoch (session token expiry, which
+    // must survive a restart).
+    static uint64_t unix_seconds();
+
+    // This reactor's metrics. Written only by the loop thread; safe to read
+    // from any thread (see metrics.hpp).
+    const metrics::ReactorMetrics& stats() const { return loop_stats; }
+
+    // One entry of a client's write queue.
+    struct Outbound {
+        SharedPayload payload;
+        uint64_t queued_ms{0};  // Loop time it was queued (time in queue)
+        bool droppable{false};  // Channel chat: the slow-consumer policy may drop it
+    };
+
+    // What an authenticate() task waits for: admission after an overload
+    // hold, its username claim, the Argon2id verdict (with the new hash of
+    // a /register).
+    struct AuthStep {
+        bool ok{false};
+        std::string password_hash{};
+    };
+    using AuthWait = coro::Completion<AuthStep>;
 
     // Per-client state stored in the clients map
     struct Client {
         int fd{};                  // Socket file descriptor
-        std::string ip_address{};  // Client's dotted-decimal IPv4 address
+        uint64_t conn_id{};        // Unique per accepted connection (fds get reused)
+        IpKey ip_key{};            // Peer address in binary form (to_string() for logs)
         int port{};                // Client's ephemeral source port
-        std::string username{};    // Set after /register or /login; empty until then
-        std::string read_buffer{}; // Accumulates recv() chunks until '\n' is seen
+        UserId user_id{NO_USER};   // Interned name, set after /register or /login
+        protocol::Version protocol{protocol::Version::Unknown}; // Picked from the first bytes
+        bool deflate{false};       // v2 client accepted CAP_DEFLATE (Compressed frames)
+        std::vector<std::string> channels{}; // Joined channels; chat goes to back()
+        std::vector<uint32_t> channel_slots{}; // Position in each one's members, as channels[i]
+        ReadBuffer read_buffer{};  // recv() lands here; records are framed in place
+        size_t input_charged{0};   // read_buffer capacity charged to the input budget
+        bool input_paused{false};  // max_input_buffer reached with records waiting: not read from
+        std::deque<Outbound> write_queue{}; // Payloads not yet accepted by the kernel
+        size_t write_offset{0};    // Bytes of write_queue.front() already sent
+        size_t queued_bytes{0};    // Unsent bytes in write_queue (charged to the output budget)
+        bool shed{false};          // Output memory pressure or slow consumer: listed in shed_clients
+        bool slow_consumer{false}; // ... shed by the slow-consumer policy
+        std::weak_ptr<const std::string> drop_notice{}; // Coalesce: the last "message(s) dropped" notice queued
+        uint64_t drop_notice_count{0}; // ... and the count it carries
+        bool epollout_armed{false}; // true while EPOLLOUT is in the fd's epoll mask
+        bool flush_pending{false};  // Coalescing: listed in dirty_clients
+        uint16_t sends_in_flight{0}; // io_uring: SENDs of the current chain not completed yet
+        bool send_scheduled{false};  // io_uring: queued in ring_send_ready
+        bool auth_pending{false};  // "Pending auth": claim or Argon2id result not back yet
+        coro::Task auth_task{};    // The authenticate() of the attempt (frame kept until the next one)
+        AuthWait* auth_wait{nullptr}; // What auth_task is suspended on, in its frame (null: not suspended)
+        uint64_t auth_started_us{0}; // monotonic_us() at begin_auth() (auth latency)
+        uint64_t last_activity_ms{0}; // monotonic_ms() of the last received bytes
+        uint64_t connected_ms{0};  // monotonic_ms() at accept (or adoption by a hot upgrade)
+        uint64_t messages_sent{0}; // Chat and /msg messages from this connection (admin channel)
+        bool presence_sub{false};  // /who: listed in presence_subscribers, gets presence deltas
+        uint32_t presence_slot{0}; // ... at this index
+        bool auth_deferred{false}; // Overload: auth_task listed in deferred_auths, not claimed yet
+        uint64_t capture_stream{0}; // TrafficCapture stream of its input, 0 = not captured
+        TimerWheel::Timer idle_timer{}; // Armed while idle_timeout_ms != 0
+        TokenBucket msg_tokens{};  // Inbound records (set_rate_limits())
+        TokenBucket byte_tokens{}; // Inbound bytes
+        bool rate_deferred{false}; // Over the limit: listed in throttled_clients
+        uint32_t rate_dropped{0};  // Records dropped by the current retry pass
+        bool backlogged{false};    // Record budget used up: listed in backlog_clients
+        SSL* tls{nullptr};         // TLS session until the kernel took both directions over
+        bool tls_handshaking{false}; // Nothing is read or written before it completes
+        bool tls_user_tx{false};   // No send offload: the write queue goes out via SSL_write()
+        bool ktls_rx{false};       // Kernel decrypts: a control record (close_notify) fails recv() with EIO
+        bool local_peer{false};    // Accepted on the unix socket: no per-IP cap, no rate limits
+        uint32_t peer_uid{0};      // ... and its SO_PEERCRED uid, which stands in for the password
+
+        // Back to a freshly accepted state for reuse by the FdTable pool.
+        // Keeps the allocations of the read buffer (unless a big frame
+        // grew it, or it is an arena chunk), the write queue and the
+        // channel list.
+        void recycle()
+        {
+            ReadBuffer rb = std::move(read_buffer);
+            std::deque<Outbound> wq = std::move(write_queue);
+            std::vector<std::string> ch = std::move(channels);
+            std::vector<uint32_t> slots = std::move(channel_slots);
+            *this = Client{};
+
+            rb.clear();
+            if (rb.borrowed() || rb.capacity() > SMALL_READ_BUFFER) rb.release_if_empty();
+            wq.clear();
+            ch.clear();
+            slots.clear();
+            read_buffer   = std::move(rb);
+            write_queue   = std::move(wq);
+            channels      = std::move(ch);
+            channel_slots = std::move(slots);
+        }
     };
 
-    // All currently authenticated usernames (online session uniqueness).
-    // Separate from `clients` so lookup-by-username stays O(1) without
-    // scanning the fd map.
-    std::unordered_set<std::string> usernames;
+    // Every username interned on this reactor (sessions and shard entries),
+    // each stored once as its cached "name: " chat prefix.
+    UserTable users;
+
+    // All currently authenticated users (online session uniqueness), as
+    // ids into `users`. Separate from `clients` so lookup-by-username stays
+    // O(1) without scanning the fd map. In a ReactorGroup this is this
+    // worker's shard: the names hashed to it, whichever worker their
+    // session lives on. The value is that worker, for /msg routing.
+    std::unordered_map<UserId, size_t> usernames;
+
+    // Local sessions by user id (an index into `users`): the fd, or -1.
+    // A /msg to a user on this reactor costs one lookup here.
+    std::vector<int> session_fds;
 
-    // Returns true if `username` is currently online.
+    // Returns true if `username` is currently online (in this worker's
+    // shard, or on another node of the cluster).
     bool IsDuplicated_Username(const std::string& username);
 
-    // Full client teardown: removes from epoll, closes fd, frees username, erases.
-    void disconnect_client(int client_fd);
+    // Full client teardown: removes from epoll, closes fd, frees username,
+    // erases. `reason` is counted in the disconnect metrics.
+    void disconnect_client(int client_fd, metrics::DisconnectReason reason);
 
-    // Primary client registry: maps socket fd → Client struct.
+    // Journal fields of a log line about connection `fd` (see Logger::Event):
+    // its address, formatted into `ip`, and its username once logged in.
+    Logger::Event client_event(const char* name, int fd, char (&ip)[INET6_ADDRSTRLEN]);
+
+    // See set_recv_arena(); null = heap read buffers. Declared before
+    // `clients`, whose read buffers give their chunks back on destruction.
+    std::unique_ptr<RecvArena> recv_arena;
+    bool recv_huge_pages{false};
+
+    // Primary client registry: socket fd → Client, a dense slot table with
+    // pooled Client objects (see fd_table.hpp).
     // Public because process_message/run() and external callers may need
     // direct fd-keyed access (e.g., broadcasting, admin commands).
-    std::unordered_map<int, Client> clients;
+    FdTable<Client> clients;
 
     // Disconnects every entry currently in `clients` (used on shutdown).
     void shutdownActiveClients();
@@ -151,20 +594,488 @@ public:
     // Actual cleanup (fds, maps, logging) happens later in run(), never here.
     void requestShutdown() noexcept { SERVER_IS_RUNNING.store(false); }
 
+    // Hot upgrade (see handoff.hpp). requestHandoff() stops the loop like
+    // requestShutdown(), but run() then returns with every connection
+    // intact for export_clients(). If the successor fails,
+    // resume_after_handoff() lets run() be called again. epoll backend only.
+    void requestHandoff() noexcept
+    {
+        keep_clients.store(true);
+        SERVER_IS_RUNNING.store(false);
+    }
+    bool handoff_requested() const { return keep_clients.load(); }
+    void resume_after_handoff()
+    {
+        keep_clients.store(false);
+        SERVER_IS_RUNNING.store(true);
+    }
+
+    // After run() returned for a handoff: delivers what other reactors (and
+    // the CryptoPool) still had queued for this one. Call on every reactor
+    // before exporting any of them.
+    void drain_for_handoff(Logger& log) { drain_mailbox(log); }
+
+    // Snapshot of every client; the sockets stay open and owned by this
+    // server. A login still in flight is exported logged out, with an
+    // error notice queued asking the client to retry. TLS connections are
+    // only exported once the kernel holds their whole record state; one
+    // still handshaking or partly in userspace is left out, and
+    // release_clients() closes it.
+    std::vector<handoff::ClientState> export_clients() const;
+
+    // After the successor adopted the clients: closes this process's copy
+    // of each socket without shutting the connection down.
+    void release_clients();
+
+    // Successor side, before run(): registers a client received in a
+    // handoff. In a group the username goes into the owning worker's shard,
+    // so every reactor must be attached first. The loop starts watching it
+    // (and processes the input it brought along) once run() starts.
+    void adopt_client(handoff::ClientState&& state);
+
 private:
     Logger* logger{nullptr}; // Non-owning pointer to the logger instance (may be null)
 
     // Processes one complete (newline-terminated) message for a given fd.
     // Dispatches to login/register handling or chat broadcast.
     // Returns false if the client was disconnected during processing.
-    bool process_message(int fd, const std::string& raw, Logger& log);
+    // `raw` points into the client's read_buffer and is only valid for the call.
+    bool process_message(int fd, std::string_view raw, Logger& log);
+
+    // v2 counterpart of process_message() for one complete frame; the
+    // payload needs no delimiter parsing. Same return contract.
+    bool process_frame(int fd, const protocol::FrameHeader& header,
+                       std::string_view payload, Logger& log);
+
+    // Starts /login or /register for parsed credentials (either protocol).
+    void begin_auth(int fd, temp_user_credentials&& creds, Logger& log);
+
+    // /resume <token>: checks the MAC and expiry, then continues like a
+    // /login whose password already verified (cmd_type 3).
+    void resume_session(int fd, std::string_view token, Logger& log);
+
+    // Successful auth of `fd` as `name`: binds the session, joins the
+    // default channel, sends `reply` and a fresh session token.
+    void bind_session(int fd, const std::string& name, std::string_view reply);
+
+    // Relays `text` from `fd`'s user to the other members of their current
+    // channel, encoded once per protocol in use (v1 line, v2 frame).
+    void broadcast_chat(int fd, std::string_view text, Logger& log);
+
+    // /join, /part, /channels, /history and /resume. Returns false if
+    // `text` is none of them.
+    bool handle_command(int fd, std::string_view text, Logger& log);
+
+    // Subscribes `fd` to `name` (made its current channel). `announce`
+    // sends the confirmation notice.
+    void join_channel(int fd, std::string name, bool announce);
+
+    // Unsubscribes `fd` from `name` (empty = current channel).
+    void part_channel(int fd, std::string name);
+
+    // Drops `fd` from every channel index it is in (disconnect).
+    void leave_all_channels(Client& c);
+
+    // Takes `c` off presence_subscribers (swap-and-pop at its slot).
+    void unsubscribe_presence(Client& c);
+
+    // Removes c.channels[i] from c and its member from that channel's
+    // index: swap-and-pop at the slot `c` recorded, so the cost doesn't
+    // depend on the channel's size.
+    void leave_channel_at(Client& c, size_t i);
+
+    // Replies with every channel and its member count.
+    void send_channel_list(int fd);
+
+    // /history [n] | /history since <unix time>: messages of the current
+    // channel from the chat log, in the client's protocol, in one write.
+    void send_log_history(int fd, std::string_view arg);
+
+    // /msg <user> <text>: one private message, delivered straight to the
+    // recipient's session here or routed through its shard (see
+    // route_direct()). Offline recipients get the sender an error.
+    void send_direct(int fd, std::string_view arg, Logger& log);
+
+    // Next hop of a DirectMessage (owned by the callee): the local session,
+    // the worker the shard says holds it, another cluster node, or a
+    // DirectFailed back to the sender.
+    void route_direct(MailboxMessage* msg, Logger& log);
+
+    // Queues `text` from `author` to the local session of `name`; false if
+    // there is none.
+    bool deliver_direct(const std::string& name, std::string_view author, std::string_view text, Logger& log);
+
+    // Where `fd`'s session is indexed in `session_fds`.
+    void index_session(const Client& c, int fd);
+
+    // Queues the kept history of `channel` (all of it in global scope) to
+    // `fd` by reference, in the client's protocol.
+    void replay_history(int fd, const std::string& channel);
+
+    // Sends one status/error line (no trailing newline) in the client's
+    // protocol: "text\n" for v1, a Notice frame for v2.
+    int send_notice(int fd, std::string_view text);
+
+    // Reserves `name` for `fd` in its owning shard. Answers synchronously
+    // when this worker owns the shard, otherwise posts a ClaimUsername
+    // message and the answer arrives via drain_mailbox().
+    void claim_username(int fd, const std::string& name);
+
+    // Frees `name` in its owning shard (locally or via a ReleaseUsername message).
+    void release_username(const std::string& name);
+
+    // This worker's shard: adds `name` to `usernames` (false if already
+    // online) as a session of `worker` / removes it again.
+    bool shard_claim(const std::string& name, size_t worker);
+    void shard_release(const std::string& name);
+
+    // Registers a freshly accepted, non-blocking socket (per-IP cap, Client
+    // entry, idle timer, read interest). Returns false if it was rejected.
+    bool register_client(int new_fd, const sockaddr_storage& client_addr, Logger* logger);
+
+    // Continues the TLS handshake of `fd`; once done, moves the directions
+    // the kernel accepted to kTLS and starts normal I/O. Returns false if
+    // the client was disconnected (failure, or kTLS required but missing).
+    bool advance_tls_handshake(int fd, Logger& log);
+
+    // Counts a direct send's result (bytes or error); false if it failed.
+    bool account_send(ssize_t sent);
+
+    // Auth latency + outcome of the attempt started in begin_auth().
+    void record_auth(const Client& c, bool ok);
+
+    // Drops `written` bytes from the front of the client's write_queue.
+    void retire_written(Client& c, size_t written);
+
+    // Every append to a write_queue: accounts `payload` (less `offset`
+    // bytes already sent, only for an empty queue) against the output
+    // budget. False, with the client marked for shedding, if it is over
+    // OUTPUT_SHED_FLOOR while the budget is exhausted.
+    bool push_output(Client& c, SharedPayload payload, size_t offset = 0, bool droppable = false);
+
+    // Takes `bytes` that left the write queue off the output budget.
+    void credit_output(Client& c, size_t bytes);
+
+    // Whether `c` is over a slow-consumer limit (set_slow_consumer_policy()).
+    bool slow_consumer(const Client& c) const;
+
+    // Applies the slow-consumer policy to `c` (see set_slow_consumer_policy()).
+    void relieve_slow_consumer(Client& c);
+
+    // Whether `c` may receive `want` more bytes into its read buffer: no
+    // growth needed, a small buffer, or input budget left.
+    bool input_growth_allowed(const Client& c, size_t want) const;
+
+    // After framing: returns a drained read buffer that grew past
+    // SMALL_READ_BUFFER to the heap, and charges the capacity change.
+    void settle_read_buffer(Client& c);
+
+    // Takes `c`'s buffers off both budgets (it is going away).
+    void release_memory(Client& c);
+
+    // After a backlog or throttle pass over `fd`: reading resumes for a
+    // paused client none of whose records wait any more.
+    void continue_input(int fd, Logger& log);
+
+    // Disconnects every client shed since the last call.
+    void process_shed(Logger& log);
+
+    // Asks epoll for EPOLLOUT on a client with queued data. Level-triggered
+    // mode only; edge-triggered clients are always registered for it.
+    void arm_epollout(Client& c);
+
+    // Coalescing: appends `payload` to the client's queue and lists the
+    // client for the next flush_dirty_clients() (unless it is waiting for
+    // EPOLLOUT anyway).
+    void queue_coalesced(Client& c, SharedPayload payload, bool droppable = false);
+
+    // Writes out every client queued since the last call, one writev() run
+    // each (corked if asked); leftovers wait for EPOLLOUT as usual.
+    void flush_dirty_clients(Logger& log);
+
+    // epoll backend: the readiness loop and its per-client read path.
+    void run_epoll(Logger& log);
+    void handle_client_readable(int fd, Logger& log);
+
+    // Splits the client's read_buffer into records for process_message()
+    // (v1) or frames for process_frame() (v2), negotiating the protocol on
+    // the connection's first bytes.
+    // `retry` is the throttled pass (process_throttled()): records still
+    // over the rate limit are dropped instead of deferred.
+    void frame_client_input(int fd, Logger& log, bool retry = false);
+
+    // Rate-limit verdict for one complete record of `bytes` (charges the
+    // buckets when it passes).
+    enum class Admission { Process, Defer, Drop };
+    Admission admit_record(Client& c, size_t bytes, bool retry);
+
+    // Puts a client that used up its record budget on backlog_clients (once).
+    void schedule_backlog(Client& c);
+
+    // Gives every client listed in backlog_due another record budget.
+    void process_backlog(Logger& log);
+
+    // Retries every client deferred during the previous iteration
+    // (throttled_due), then reports what had to be dropped.
+    void process_throttled(Logger& log);
+
+    // Wait cap for epoll_wait()/io_uring_enter(): the next timer, or the
+    // rate-limit retry while clients are throttled; 0 while a backlog waits.
+    int loop_timeout_ms() const;
+
+    // io_uring backend. Operations are told apart by the top byte of the
+    // SQE user_data; the rest identifies the connection (see ring_key()).
+    enum RingOp : uint8_t { RingAccept = 1, RingRecv, RingSend, RingMailbox, RingHandshake, RingCancel };
+    static uint64_t ring_key(const Client& c);
+    static uint64_t ring_tag(RingOp op, const Client& c);
+    static uint64_t accept_tag(size_t listener); // RingAccept of listen_fds[listener]
+    void run_uring(Logger& log);
+    void handle_completion(const io_uring_cqe& cqe, Logger& log);
+    void queue_ring_send(Client& c, SharedPayload payload, bool droppable = false);
+    void submit_ring_sends();
+
+    // What a TimerWheel::Timer of a client is for (Timer::kind).
+    enum TimerKind : uint32_t {
+        IdleTimer = 1 // connection_timeout without input
+    };
+
+    // Fires due timers: evicts clients idle past the timeout, and re-arms the
+    // ones that were active since (activity only stamps last_activity_ms, so
+    // the per-message cost is one store, not a wheel operation).
+    void process_timers(Logger& log);
+
+    // Loop start: clients already in `clients` (adopted in a handoff, or
+    // kept across one that failed) are registered with epoll/the ring like
+    // fresh connections, and input/output they carry is dealt with.
+    void watch_existing_clients(Logger& log);
+
+    // Top of every loop iteration: reactor 0 performs a pending SIGHUP
+    // reload, then every reactor applies a newly published config.
+    // Two atomic loads when nothing changed.
+    void poll_config(Logger& log);
+
+    // Copies the reloadable settings of `cfg` into this reactor.
+    void apply_config(const ServerConfig& cfg);
+
+    // Disconnects the local session of `name` (MailboxMessage::KickUser).
+    void kick_user(const std::string& name, Logger& log);
+
+    // The whole /login, /register or /resume of `fd`: overload hold, shard
+    // claim, Argon2id on the CryptoPool (inline without one), then the
+    // session. Suspends at each wait; owned by Client::auth_task.
+    coro::Task authenticate(int fd, temp_user_credentials creds, Logger& log);
+
+    // Delivers `step` to the authenticate() task of `fd` and resumes it
+    // right here. False if no task of that connection waits (it
+    // disconnected, and `conn_id` tells a reused fd apart).
+    bool resume_auth(int fd, uint64_t conn_id, AuthStep step);
+
+    // The claim for `fd` was decided; a stale granted claim is given back.
+    void on_claim_result(int fd, uint64_t conn_id, const std::string& name, bool ok);
+
+    // The Argon2id result for `msg->origin_fd` is back; a stale one
+    // releases the claim its task held.
+    void on_auth_complete(const MailboxMessage& msg);
+
+    // Stores the hash a crypto worker redid for a verified login, unless
+    // the account changed meanwhile.
+    void on_password_rehashed(const MailboxMessage& msg, Logger& log);
+
+    // User DB in use: the attached store, or the lazily loaded `own_store`.
+    CredentialStore& credentials();
+
+    // Mailbox this reactor drains: the group's slot or `own_inbox`.
+    Mailbox& inbox() { return group ? group->mailbox(worker_id) : *own_inbox; }
+
+    // Sends `line` (v1 clients), `frame` (v2 clients) or `deflated` (v2
+    // clients with compression, when not null) to every local member of
+    // `channel` except `except_fd`; drops dead peers. `frame` may be null
+    // when no v2 client is connected.
+    void broadcast_local(int except_fd, const std::string& channel, const SharedPayload& line,
+                         const SharedPayload& frame, const SharedPayload& deflated, Logger& log);
+
+    // Queues `frames` (complete v2 frames) to `c`, in Compressed frames if
+    // it negotiated compression and they are worth it.
+    void send_frames(Client& c, std::string frames);
+
+    // Consumes every pending cross-reactor message (eventfd became readable).
+    void drain_mailbox(Logger& log);
+
+    // Presence (/who). Every reactor keeps its own view of who is online
+    // in the process: its sessions, plus those of the other reactors as
+    // their PresenceDelta batches arrive. Changes are only collected while
+    // the loop runs; process_presence() turns them, once per iteration,
+    // into one delta per reactor for the peers and numbered deltas for the
+    // local subscribers, so a login storm costs O(changes) per iteration
+    // instead of a full list per login.
+    //
+    // A session of `name` bound here (+1) or ended (-1).
+    void presence_changed(const std::string& name, int delta);
+
+    // Counts `delta` against `name` in this reactor's view.
+    void presence_apply(const std::string& name, int delta);
+
+    // /who [off]: the online list at the current presence version, and a
+    // subscription to the deltas after it (or the end of that subscription).
+    void send_presence(int fd, std::string_view arg);
+
+    // End of iteration: posts the local changes to the peers, announces
+    // the names whose state changed, forgets the ones gone offline.
+    void process_presence(Logger& log);
+
+    // End of iteration: folds `busy_us` (this batch) and `late_us` (wake-up
+    // past the requested timeout) into the lag, moves between overload
+    // stages, and resumes or refuses held logins (set_overload_control()).
+    void process_overload(uint64_t busy_us, uint64_t late_us, Logger& log);
+
+    // End of iteration, every TABLE_SAMPLE_MS: copies the sizes of the
+    // per-client tables into loop_stats (metrics::Table).
+    void sample_tables();
+
+    // Stops or restarts accepting (listener out of epoll / accept cancelled).
+    void pause_accept(bool paused);
+
+    // "Error: server busy, retry after <n>s" to `fd`, whose pending login
+    // is dropped.
+    void refuse_auth(Client& c);
+
+    // Fills this reactor's part of an admin channel command (and kicks or
+    // drains for the ones that act), then hands it back.
+    void answer_admin_query(AdminQuery& q, Logger& log);
+
+    ReactorGroup* group{nullptr}; // Non-owning; nullptr in single-reactor mode
+    CryptoPool* crypto{nullptr};  // Non-owning; nullptr → Argon2id runs inline
+    bool rehash_on_login{true};   // See set_password_rehash()
+    std::unique_ptr<Mailbox> own_inbox{std::make_unique<Mailbox>()}; // Completions when not in a group
+    CredentialStore* store{nullptr};           // Non-owning; see attach_credential_store()
+    std::unique_ptr<CredentialStore> own_store; // Fallback when nothing was attached
+    const SessionTokens* sessions{nullptr};    // Non-owning; see attach_session_tokens()
+    LiveConfig* live{nullptr};                 // Non-owning; see attach_live_config()
+    const TlsContext* tls_context{nullptr};    // Non-owning; see attach_tls()
+    uint64_t config_generation{0};             // live->generation() last applied
+    int listen_backlog{100};                   // See set_listen_backlog()
+    SocketTuning socket_tuning;                // See set_socket_tuning()
+    bool tuning_applied{false};                // socket_tuning is set on the listener
+    bool tuning_reported{false};               // First accepted socket's options logged
+    std::unique_ptr<Logger> own_logger;        // run() without attach_logger(): console-only fallback
+    size_t worker_id{0};          // This reactor's index inside `group`
+
+    // Open connections per peer address, maintained on accept and in
+    // disconnect_client(), so the per-IP cap costs O(1) instead of a scan
+    // of `clients`. Entries are erased when they drop to zero.
+    std::unordered_map<IpKey, uint16_t, IpKeyHash> connections_per_ip;
+    uint16_t max_connections_per_ip{5};
+    std::unordered_map<uint32_t, std::string> local_peers; // set_local_peers(): uid → account
+    size_t v2_clients{0}; // Local clients speaking protocol v2
+    bool draining{false}; // Admin channel `drain on`: new connections are refused
+
+    // Overload control (set_overload_control()).
+    uint64_t overload_lag_us{0};        // Stage 1 threshold (0 = off)
+    uint64_t overload_reject_lag_us{0}; // Stage 2 threshold
+    int overload_retry_after_s{5};
+    uint64_t loop_lag_us{0};            // Smoothed lag
+    int overload_stage{0};
+    bool accept_paused{false};          // Listener out of epoll / accept cancelled
+    std::vector<bool> accept_armed;     // io_uring: a multishot accept is outstanding, per listener
+    struct DeferredAuth {
+        int fd;
+        uint64_t conn_id;
+        uint64_t since_ms;
+    };
+    std::deque<DeferredAuth> deferred_auths; // Logins held back, oldest first
+
+    // authenticate() tasks whose client disconnected while the task ran
+    // (a send error inside it): freed once the batch is over.
+    std::vector<coro::Task> retired_auth_tasks;
+
+    // Presence view (see presence_changed()): sessions per name, across the
+    // reactors. `announced` is the state the last delta published;
+    // `touched` lists the entry in presence_touched until the next
+    // process_presence(). Each entry holds a reference in `users`.
+    struct PresenceEntry {
+        int sessions{0};
+        bool announced{false};
+        bool touched{false};
+    };
+    std::unordered_map<UserId, PresenceEntry> presence;
+    std::vector<UserId> presence_touched;
+    std::vector<std::string> presence_joined; // Local changes of this iteration, for the peers
+    std::vector<std::string> presence_left;
+    std::vector<int> presence_subscribers;     // Clients with presence_sub
+    uint64_t presence_version{0};              // Of the last delta sent (per reactor)
+
+    // set_compression(), shared by every reactor.
+    static inline std::atomic<bool> compress_offered{false};
+    static inline std::atomic<size_t> compress_min_bytes{512};
+    static inline std::atomic<int> compress_level{1};
+    static inline std::atomic<int64_t> deflate_clients{0}; // Clients with `deflate`, all reactors
+
+    // set_memory_budgets(), shared by every reactor; each charges its Share.
+    static inline MemoryBudget input_memory;
+    static inline MemoryBudget output_memory;
+    MemoryBudget::Share input_share{input_memory};
+    MemoryBudget::Share output_share{output_memory};
+    size_t max_input_buffer{65536};        // See set_max_input_buffer()
+    std::vector<int> shed_clients;         // Marked by push_output() this iteration
+    SlowConsumerPolicy slow_policy{SlowConsumerPolicy::Coalesce}; // See set_slow_consumer_policy()
+    size_t slow_queue_bytes{1048576};      // 0 = no byte limit
+    uint64_t slow_max_delay_ms{30000};     // 0 = no time limit
+
+    // Subscription index: channel → fds of its local members, stored
+    // contiguously so a broadcast walks one small array instead of the
+    // whole `clients` map. Removal is swap-and-pop (order is irrelevant).
+    struct Channel {
+        std::vector<int> members;
+    };
+    std::unordered_map<std::string, Channel> channels;
+    MessageHistory history; // See set_history()
+    ChatLog* chat_log{nullptr};  // Non-owning; see attach_chat_log()
+    TrafficCapture* capture{nullptr}; // Non-owning; see attach_traffic_capture()
+    Cluster* cluster{nullptr};   // Non-owning; see attach_cluster()
+    size_t history_query_max{200};
+
+    EventBackend backend{EventBackend::Epoll};
+    bool edge_triggered{false};            // EPOLLET client registration (epoll backend)
+    int epoll_batch{DEFAULT_EPOLL_BATCH};  // epoll_wait() maxevents
+    bool coalesce_writes{false};           // Defer sends to the end of the batch
+    uint64_t coalesce_max_delay_ms{DEFAULT_COALESCE_DELAY_MS}; // Mid-batch flush deadline
+    bool cork_writes{false};               // TCP_CORK around each coalesced flush
+    std::vector<int> dirty_clients;        // Clients with coalesced, unflushed data
+    uint64_t rate_messages{0};             // Records/s per client (0 = unlimited)
+    uint64_t rate_bytes{0};                // Bytes/s per client (0 = unlimited)
+    uint64_t rate_message_burst{0};        // Bucket capacities
+    uint64_t rate_byte_burst{0};
+    int rate_retry_ms{MAX_RATE_RETRY_MS};  // Wait before a throttled client's retry
+    std::vector<int> throttled_clients;    // Deferred this iteration
+    std::vector<int> throttled_due;        // Deferred last iteration: retried now
+    unsigned record_budget{DEFAULT_RECORD_BUDGET}; // Records per client per iteration
+    std::vector<int> backlog_clients;      // Out of budget this iteration
+    std::vector<int> backlog_due;          // Out of budget last iteration: served now
+    std::unique_ptr<IoUring> uring;        // Set while run() drives io_uring
+    std::vector<int> ring_send_ready;      // Clients with data for the next SEND batch
+
+    // Write queues of clients disconnected while SENDs still pointed into
+    // them, kept alive (by ring_key) until those SENDs complete.
+    struct OrphanedSends {
+        std::deque<Outbound> queue;
+        uint16_t in_flight{0};
+    };
+    std::unordered_map<uint64_t, OrphanedSends> orphaned_sends;
+
+    TimerWheel timers{TIMER_TICK_MS, monotonic_ms()}; // Per-client deadlines
+    std::vector<TimerWheel::Timer*> expired_timers;  // Reused batch for process_timers()
+    std::vector<std::pair<int, uint64_t>> expired_clients; // ... as (fd, conn_id) of their owners
+    uint64_t idle_timeout_ms{0};  // 0 = idle clients are never evicted
+    uint64_t loop_now_ms{0};      // monotonic_ms() sampled after each epoll_wait()
+    metrics::ReactorMetrics loop_stats; // See stats()
+    uint64_t tables_sampled_ms{0};      // loop_now_ms of the last sample_tables()
+    uint64_t next_conn_id{1};     // Source for Client::conn_id
 
     // Loop control. atomic<bool> so a signal handler can store(false) safely
     // without touching non-signal-safe structures (maps, fds, streams).
     std::atomic<bool> SERVER_IS_RUNNING{true};
+    std::atomic<bool> keep_clients{false}; // See requestHandoff()
 
-    char buffer[BUFFER_SIZE]{};   // Reusable recv() scratch buffer (reset each call)
-    int server_fd{-1};            // The listening socket fd (-1 = invalid/closed)
+    std::vector<int> listen_fds;  // Listening sockets, IPv4 and IPv6 (see ListenEndpoint)
     int epoll_fd{-1};             // The epoll instance fd (-1 = invalid/closed)
-    int port{};                   // Port this server is bound to
 };
@@ -7,20 +7,27 @@
 #include <chrono>
 #include <iomanip>
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <pwd.h>        // getpwnam_r() — unix_socket_users by user name
+#include "tracepoints.hpp"
+#include "compression.hpp"
+#include "password_hash.hpp"
 
 // ============================================================================
-// Constructor — builds and arms the listening socket end-to-end.
-// Performs, in order: libsodium init, signal setup, socket creation,
-// non-blocking + reuse-addr config, bind, and listen.
-// Throws std::runtime_error on any unrecoverable failure.
+// Constructor — process-wide setup around sockets that already listen:
+// bound by ListenEndpoint::open(), or inherited (systemd socket activation,
+// a hot-upgrade predecessor). libsodium init and SIGPIPE are idempotent, so
+// every reactor runs them.
 // ============================================================================
-TcpServer::TcpServer(int _port, const char* ipv4_address, Logger* _logger)
+TcpServer::TcpServer(std::vector<int> listeners, Logger* _logger)
 {
     logger = _logger; // Store non-owning logger pointer (may be null)
 
     // Initialize libsodium ONCE for the whole process lifetime.
     // Must succeed before any crypto_pwhash_* call is used later.
     if (sodium_init() < 0) {
+        for (int fd : listeners) close(fd);
         throw std::runtime_error("libsodium initialization failed");
     }
 
@@ -29,48 +36,14 @@ TcpServer::TcpServer(int _port, const char* ipv4_address, Logger* _logger)
     // the process by default; we prefer to handle it via the EPIPE errno.
     signal(SIGPIPE, SIG_IGN);
 
-    std::cout << "Starting TCP server on " << ipv4_address << ":" << _port << "...\n";
-    port = _port;
-
-    // Create an IPv4 TCP stream socket.
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
-        throw std::runtime_error(std::string("Socket creation failed: ") + strerror(errno));
-    }
-
-    // Non-blocking is mandatory for epoll-driven accept().
-    set_NonBlocking(server_fd);
-
-    // SO_REUSEADDR: allows fast rebind after restart (skips TIME_WAIT block).
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        // Non-fatal: server can still run, just may fail to rebind quickly.
-        std::cerr << "setsockopt(SO_REUSEADDR) failed: " << strerror(errno) << std::endl;
-    }
-
-    sockaddr_in address{};
-    address.sin_family = AF_INET;
-    address.sin_port   = htons(port); // Host → network byte order
-
-    // inet_pton: validates the address and is IPv6-ready (vs deprecated inet_addr).
-    if (inet_pton(AF_INET, ipv4_address, &address.sin_addr) != 1) {
-        close(server_fd);
-        throw std::runtime_error("Invalid IPv4 address");
-    }
-
-    // Bind the socket to the chosen address:port.
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        close(server_fd);
-        throw std::runtime_error(std::string("Bind failed: ") + strerror(errno));
-    }
-
-    // Start listening; backlog of 100 pending connections.
-    if (listen(server_fd, 100) == -1) {
-        close(server_fd);
-        throw std::runtime_error(std::string("Listen failed: ") + strerror(errno));
+    listen_fds = std::move(listeners);
+    accept_armed.assign(listen_fds.size(), false);
+    for (int fd : listen_fds) {
+        // Non-blocking is mandatory for epoll-driven accept().
+        set_NonBlocking(fd);
+        std::cout << "Server is listening on " << ListenEndpoint::bound_name(fd) << " (fd " << fd << ")"
+                  << std::endl;
     }
-
-    std::cout << "Server is listening on " << ipv4_address << ":" << port << std::endl;
 }
 
 // ============================================================================
@@ -88,10 +61,9 @@ TcpServer::~TcpServer()
     if (epoll_fd != -1) {
         if (::close(epoll_fd) == 0) epoll_fd = -1;
     }
-    // Then close the listening socket itself.
-    if (server_fd != -1) {
-        if (::close(server_fd) == 0) server_fd = -1;
-    }
+    // Then close the listening sockets themselves.
+    for (int fd : listen_fds) ::close(fd);
+    listen_fds.clear();
 }
 
 
@@ -99,35 +71,18 @@ TcpServer::~TcpServer()
 // Cryptography (Argon2id via libsodium)
 // ============================================================================
 
-// Hashes a plaintext password using Argon2id with "interactive" cost params
-// (tuned for low-latency login flows, not for offline attacker resistance
-// maximization). The returned string is self-describing (contains salt +
-// algorithm + parameters), so no separate salt storage is needed.
+// Argon2id lives in password_hash.cpp, shared with the offline tools. The
+// returned string is self-describing (contains salt + algorithm +
+// parameters), so no separate salt storage is needed.
 std::string TcpServer::hash_password(const std::string& password)
 {
-    char hash[crypto_pwhash_STRBYTES]; // Output buffer for encoded hash
-
-    // crypto_pwhash_str produces a self-describing hash (algo+salt+params+digest).
-    if (crypto_pwhash_str(
-            hash,
-            password.c_str(),
-            password.size(),
-            crypto_pwhash_OPSLIMIT_INTERACTIVE,   // CPU cost
-            crypto_pwhash_MEMLIMIT_INTERACTIVE) != 0) { // RAM cost
-        // Typically fails only under extreme memory pressure.
-        throw std::runtime_error("Password hashing failed (out of memory?)");
-    }
-    return std::string(hash);
+    return password::hash(password);
 }
 
-// Verifies a plaintext password against a previously stored Argon2id hash.
 // Uses libsodium's built-in constant-time comparison to avoid timing attacks.
 bool TcpServer::verify_password(const std::string& password, const std::string& stored_hash)
 {
-    return crypto_pwhash_str_verify(
-        stored_hash.c_str(),
-        password.c_str(),
-        password.size()) == 0;
+    return password::verify(password, stored_hash);
 }
 
 // ============================================================================
@@ -146,35 +101,119 @@ void TcpServer::set_NonBlocking(int fd)
     }
 }
 
-// Sends the full buffer, looping until all `length` bytes go out or an
-// unrecoverable error occurs. Handles partial writes and EINTR transparently.
-// Returns 0 on full success, -1 on failure (peer gone, buffer full, etc.).
-int TcpServer::sendAll(int fd, const char* buff, int length)
+// Writes directly to the socket until done or EAGAIN. Returns the number of
+// bytes the kernel accepted, or -1 on a hard error. Never blocks.
+static ssize_t send_nonblocking(int fd, const char* buff, size_t length)
 {
-    int total = 0;
+    size_t total = 0;
     // Loop until every byte is written (send may return fewer bytes than asked).
     while (total < length) {
         ssize_t n = send(fd, buff + total, length - total, 0);
         if (n == -1) {
-            if (errno == EINTR) continue;             // Interrupted, retry
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Socket buffer full. For a robust server this should queue the
-                // remainder and watch EPOLLOUT. Here we signal failure to caller.
-                return -1;
+            if (errno == EINTR) continue;                         // Interrupted, retry
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {        // Socket buffer full
+                TRACE_3(send_eagain, fd, total, length - total);
+                break;
             }
-            return -1; // Hard error
+            return -1;                                            // Hard error
         }
-        total += static_cast<int>(n);
+        total += static_cast<size_t>(n);
+        if (total < length) TRACE_3(send_partial, fd, total, length - total);
+    }
+    return static_cast<ssize_t>(total);
+}
+
+// Sends the buffer without ever blocking the event loop. Bytes the kernel
+// refuses (EAGAIN) are copied into a payload on the client's write_queue and
+// EPOLLOUT is armed; run() then resumes the write via flush_write_queue().
+// Returns 0 on full send or successful queueing, -1 on a hard error.
+int TcpServer::sendAll(int fd, const char* buff, int length)
+{
+    Client* client = clients.find(fd);
+
+    // io_uring: everything goes through the queue and out in the next batch.
+    if (uring && client) {
+        queue_ring_send(*client, std::make_shared<const std::string>(buff, length));
+        return 0;
+    }
+
+    // Coalescing: written out once the current batch is done. A TLS client
+    // still handshaking, or without send offload, always queues.
+    if (client && (coalesce_writes || client->tls_handshaking || client->tls_user_tx)) {
+        queue_coalesced(*client, std::make_shared<const std::string>(buff, length));
+        return 0;
+    }
+
+    // Something is already waiting: writing now would reorder the stream.
+    if (client && !client->write_queue.empty()) {
+        push_output(*client, std::make_shared<const std::string>(buff, length));
+        return 0;
     }
+
+    ssize_t sent = send_nonblocking(fd, buff, static_cast<size_t>(length));
+    if (!account_send(sent)) return -1;
+    if (sent == length) return 0;
+
+    // Unregistered fds (e.g. rejected at accept) have no queue — the
+    // remainder is simply dropped.
+    if (!client) return -1;
+
+    Client& c = *client;
+    if (push_output(c, std::make_shared<const std::string>(buff + sent, length - sent))) arm_epollout(c);
     return 0;
 }
 
+// Feeds one send_nonblocking() result into the metrics; false on a hard error.
+bool TcpServer::account_send(ssize_t sent)
+{
+    if (sent == -1) {
+        loop_stats.send_errors.add();
+        return false;
+    }
+    loop_stats.send_bytes.add(static_cast<uint64_t>(sent));
+    return true;
+}
+
 // Convenience overload for std::string payloads — delegates to the raw-buffer version.
 int TcpServer::sendAll(int fd, const std::string& data)
 {
     return sendAll(fd, data.c_str(), static_cast<int>(data.size()));
 }
 
+// Fan-out overload: same contract as the raw version, but a partially sent
+// payload is queued by reference (refcount bump), never copied.
+int TcpServer::sendAll(int fd, const SharedPayload& payload, bool droppable)
+{
+    Client* client = clients.find(fd);
+    if (!client) {
+        return send_nonblocking(fd, payload->data(), payload->size()) ==
+               static_cast<ssize_t>(payload->size()) ? 0 : -1;
+    }
+
+    Client& c = *client;
+    if (uring) {
+        queue_ring_send(c, payload, droppable);
+        return 0;
+    }
+    if (coalesce_writes || c.tls_handshaking || c.tls_user_tx) {
+        queue_coalesced(c, payload, droppable);
+        return 0;
+    }
+    if (!c.write_queue.empty()) {
+        push_output(c, payload, 0, droppable); // Keep ordering behind pending data
+        return 0;
+    }
+
+    ssize_t sent = send_nonblocking(fd, payload->data(), payload->size());
+    if (!account_send(sent)) return -1;
+    if (static_cast<size_t>(sent) == payload->size()) return 0;
+
+    // The queue was empty, so this payload becomes its front: the offset
+    // records how much of it the kernel already took.
+    if (push_output(c, payload, static_cast<size_t>(sent), droppable)) arm_epollout(c);
+    return 0;
+}
+
 // ============================================================================
 // Epoll Subsystem Control
 // ============================================================================
@@ -183,18 +222,20 @@ int TcpServer::sendAll(int fd, const std::string& data)
 // first monitored fd. Must be called once before run()'s event loop starts.
 void TcpServer::initialize_epoll()
 {
-    epoll_fd = epoll_create1(0);
+    if (epoll_fd != -1) close(epoll_fd); // run() again after a failed handoff
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC); // Not inherited by a hot-upgrade successor
     if (epoll_fd == -1) {
         throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
     }
 
-    struct epoll_event ev{};
-    ev.events  = EPOLLIN | EPOLLET; // Edge-triggered listener (must drain accept queue)
-    ev.data.fd = server_fd;
-
-    // Register the listening socket as the first monitored fd.
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) == -1) {
-        throw std::runtime_error(std::string("epoll_ctl server_fd: ") + strerror(errno));
+    // Register the listening sockets as the first monitored fds.
+    for (int fd : listen_fds) {
+        struct epoll_event ev{};
+        ev.events  = EPOLLIN | EPOLLET; // Edge-triggered listener (must drain accept queue)
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            throw std::runtime_error(std::string("epoll_ctl listener: ") + strerror(errno));
+        }
     }
 
     std::cout << "Epoll subsystem initialized cleanly\n";
@@ -213,6 +254,19 @@ void TcpServer::add_to_epoll(int fd, uint32_t events)
     }
 }
 
+// Changes the interest mask of an fd that is already registered
+// (used to arm/disarm EPOLLOUT around the write queue).
+void TcpServer::modify_epoll(int fd, uint32_t events)
+{
+    struct epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        perror("epoll_ctl: mod");
+    }
+}
+
 // Unregisters an fd from epoll (e.g., right before closing it).
 void TcpServer::remove_from_epoll(int fd)
 {
@@ -222,6 +276,419 @@ void TcpServer::remove_from_epoll(int fd)
     }
 }
 
+// Drains the client's write_queue into the socket, called from run() when
+// EPOLLOUT fires. Each writev() gathers up to MAX_WRITEV_SLICES queued
+// payloads straight from their shared buffers. Stops at EAGAIN (EPOLLOUT
+// stays armed); once everything is out, EPOLLOUT is disarmed (level-triggered
+// mode; edge-triggered clients keep it and only wake on a new edge).
+bool TcpServer::flush_write_queue(int fd)
+{
+    Client* client = clients.find(fd);
+    if (!client) return true;
+    Client& c = *client;
+    if (c.tls_handshaking) return true; // Queued output waits for the keys
+
+    // No send offload: each payload becomes one record via SSL_write().
+    while (c.tls_user_tx && !c.write_queue.empty()) {
+        const SharedPayload& p = c.write_queue.front().payload;
+        size_t n = 0;
+        const tls::Io io = tls::write(c.tls, p->data() + c.write_offset, p->size() - c.write_offset, n);
+        if (io == tls::Io::WantWrite || io == tls::Io::WantRead) return true;
+        if (io != tls::Io::Ok) {
+            loop_stats.send_errors.add();
+            return false;
+        }
+        retire_written(c, n);
+        loop_stats.send_bytes.add(static_cast<uint64_t>(n));
+    }
+
+    struct iovec iov[MAX_WRITEV_SLICES];
+
+    while (!c.write_queue.empty()) {
+        // Gather the head of the queue; the first slice skips what was sent.
+        int iovcnt      = 0;
+        size_t gathered = 0;
+        for (auto q = c.write_queue.begin();
+             q != c.write_queue.end() && iovcnt < MAX_WRITEV_SLICES; ++q, ++iovcnt) {
+            size_t skip = (iovcnt == 0) ? c.write_offset : 0;
+            iov[iovcnt].iov_base = const_cast<char*>(q->payload->data()) + skip;
+            iov[iovcnt].iov_len  = q->payload->size() - skip;
+            gathered += iov[iovcnt].iov_len;
+        }
+
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n == -1) {
+            if (errno == EINTR) continue;                             // Retry
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {            // Still full
+                TRACE_3(send_eagain, fd, 0, gathered);
+                return true;
+            }
+            loop_stats.send_errors.add();
+            return false;                                             // Hard error
+        }
+        if (static_cast<size_t>(n) < gathered) TRACE_3(send_partial, fd, n, gathered - n);
+
+        retire_written(c, static_cast<size_t>(n));
+        loop_stats.send_bytes.add(static_cast<uint64_t>(n));
+    }
+
+    // Queue drained — back to read-only interest (none while input is paused).
+    if (c.epollout_armed) {
+        modify_epoll(fd, c.input_paused ? 0u : uint32_t(EPOLLIN));
+        c.epollout_armed = false;
+    }
+    return true;
+}
+
+void TcpServer::arm_epollout(Client& c)
+{
+    if (edge_triggered || c.epollout_armed) return;
+    modify_epoll(c.fd, c.input_paused ? EPOLLOUT : EPOLLIN | EPOLLOUT);
+    c.epollout_armed = true;
+}
+
+void TcpServer::queue_coalesced(Client& c, SharedPayload payload, bool droppable)
+{
+    // Data left over from the last flush waits for EPOLLOUT (or the end of
+    // the handshake), which writes this too: a writev() now would only
+    // meet a full socket again. Slow readers cost nothing per batch.
+    const bool waiting = !c.write_queue.empty() && !c.flush_pending;
+    if (!push_output(c, std::move(payload), 0, droppable) || waiting) return;
+    if (!c.flush_pending) {
+        c.flush_pending = true;
+        dirty_clients.push_back(c.fd);
+    }
+}
+
+// One pass over the clients that got data since the last flush. A client
+// that disconnected meanwhile (or whose fd was reused by a fresh
+// connection) no longer has flush_pending set and is skipped.
+void TcpServer::flush_dirty_clients(Logger& log)
+{
+    for (int fd : dirty_clients) {
+        Client* client = clients.find(fd);
+        if (!client || !client->flush_pending) continue;
+        client->flush_pending = false;
+
+        // Holding the cork makes the kernel pack successive writev() runs
+        // of a long queue into full segments; releasing it pushes the tail.
+        const int on = 1, off = 0;
+        if (cork_writes) setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+        bool ok = flush_write_queue(fd);
+        if (cork_writes) setsockopt(fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+
+        if (!ok) {
+            char ip[INET6_ADDRSTRLEN];
+            log.Write_log(Logger::Warn, client_event("send_error", fd, ip),
+                          "Disconnected client fd=", fd, " due to send error");
+            disconnect_client(fd, metrics::DisconnectReason::SendError);
+            continue;
+        }
+        // Socket full: the rest goes out on EPOLLOUT.
+        if (!client->write_queue.empty()) arm_epollout(*client);
+    }
+    dirty_clients.clear();
+}
+
+// Retires fully written payloads; remembers the offset into the next one.
+void TcpServer::retire_written(Client& c, size_t written)
+{
+    credit_output(c, written < c.queued_bytes ? written : c.queued_bytes);
+
+    while (written > 0 && !c.write_queue.empty()) {
+        size_t remaining = c.write_queue.front().payload->size() - c.write_offset;
+        if (written < remaining) {
+            c.write_offset += written;
+            break;
+        }
+        written -= remaining;
+        loop_stats.queue_delay_us.record((loop_now_ms - c.write_queue.front().queued_ms) * 1000);
+        c.write_queue.pop_front(); // Drops this recipient's reference
+        c.write_offset = 0;
+    }
+}
+
+bool TcpServer::push_output(Client& c, SharedPayload payload, size_t offset, bool droppable)
+{
+    if (c.shed) return false; // Going away: nothing more for it
+    if (c.queued_bytes > OUTPUT_SHED_FLOOR && output_memory.exhausted()) {
+        c.shed = true;
+        shed_clients.push_back(c.fd);
+        return false;
+    }
+
+    const size_t bytes = payload->size() - offset;
+    if (c.write_queue.empty()) c.write_offset = offset;
+    c.write_queue.push_back(Outbound{std::move(payload), loop_now_ms, droppable});
+    c.queued_bytes += bytes;
+    output_share.add(static_cast<int64_t>(bytes));
+    loop_stats.output_queue_bytes.add(static_cast<int64_t>(bytes));
+
+    if (slow_consumer(c)) relieve_slow_consumer(c);
+    return !c.shed;
+}
+
+void TcpServer::credit_output(Client& c, size_t bytes)
+{
+    c.queued_bytes -= bytes;
+    output_share.add(-static_cast<int64_t>(bytes));
+    loop_stats.output_queue_bytes.add(-static_cast<int64_t>(bytes));
+}
+
+// Entries at the front of the queue the kernel may still be reading (SENDs
+// in flight, a partly written payload, an SSL_write() to be retried): they
+// can't be dropped, and don't count for the time limit.
+static size_t pinned_entries(const TcpServer::Client& c)
+{
+    size_t keep = c.sends_in_flight;
+    if (keep == 0 && (c.write_offset > 0 || c.tls_user_tx)) keep = 1;
+    return keep < c.write_queue.size() ? keep : c.write_queue.size();
+}
+
+bool TcpServer::slow_consumer(const Client& c) const
+{
+    if (slow_queue_bytes && c.queued_bytes > slow_queue_bytes) return true;
+    if (!slow_max_delay_ms) return false;
+    const size_t oldest = pinned_entries(c);
+    return oldest < c.write_queue.size() &&
+           loop_now_ms - c.write_queue[oldest].queued_ms > slow_max_delay_ms;
+}
+
+// One pass over the queue, oldest first: droppable entries go while the
+// queue is over half the byte limit or they are past the time limit; the
+// rest keeps its order.
+void TcpServer::relieve_slow_consumer(Client& c)
+{
+    if (slow_policy != SlowConsumerPolicy::Disconnect) {
+        const size_t keep = pinned_entries(c);
+        const size_t low = slow_queue_bytes / 2;
+        size_t left = c.queued_bytes, dropped = 0, gap = 0;
+        auto out = c.write_queue.begin() + static_cast<std::ptrdiff_t>(keep);
+        for (auto in = out; in != c.write_queue.end(); ++in) {
+            const bool stale = slow_max_delay_ms && loop_now_ms - in->queued_ms > slow_max_delay_ms;
+            const bool heavy = slow_queue_bytes && left > low;
+            if (in->droppable && (stale || heavy)) {
+                if (dropped++ == 0) gap = static_cast<size_t>(out - c.write_queue.begin());
+                left -= in->payload->size();
+                continue;
+            }
+            if (out != in) *out = std::move(*in);
+            ++out;
+        }
+        c.write_queue.erase(out, c.write_queue.end());
+        credit_output(c, c.queued_bytes - left);
+
+        if (dropped) {
+            loop_stats.slow_consumer_dropped.add(dropped);
+            if (slow_policy == SlowConsumerPolicy::Coalesce) {
+                // Where the skipped messages were, so the client sees the gap.
+                // A notice of an earlier pass right next to it (and not
+                // being written yet) takes the total instead, so a reader
+                // relieved on every push gets one growing notice rather
+                // than one line per pass.
+                const SharedPayload last = c.drop_notice.lock();
+                size_t at = c.write_queue.size();
+                if (last && gap > keep && c.write_queue[gap - 1].payload == last) at = gap - 1;
+                else if (last && gap < c.write_queue.size() && c.write_queue[gap].payload == last) at = gap;
+                const bool merged = at < c.write_queue.size();
+                const uint64_t total = (merged ? c.drop_notice_count : 0) + dropped;
+
+                const std::string text = "Error: connection too slow, " + std::to_string(total) +
+                                         " message(s) dropped";
+                SharedPayload note = std::make_shared<const std::string>(
+                    c.protocol == protocol::Version::V2 ? protocol::make_frame(protocol::Notice, text)
+                                                        : text + "\n");
+                c.drop_notice       = note;
+                c.drop_notice_count = total;
+                c.queued_bytes += note->size();
+                output_share.add(static_cast<int64_t>(note->size()));
+                loop_stats.output_queue_bytes.add(static_cast<int64_t>(note->size()));
+                if (merged) {
+                    credit_output(c, c.write_queue[at].payload->size());
+                    c.write_queue[at].payload = std::move(note); // Keeps its age
+                } else {
+                    c.write_queue.insert(c.write_queue.begin() + static_cast<std::ptrdiff_t>(gap),
+                                         Outbound{std::move(note), loop_now_ms, false});
+                }
+            }
+        }
+        if (!slow_consumer(c)) return;
+    }
+
+    // Disconnect, or nothing droppable was left: only what must arrive is
+    // queued and it still doesn't drain.
+    c.shed          = true;
+    c.slow_consumer = true;
+    shed_clients.push_back(c.fd);
+}
+
+TcpServer::SlowConsumerPolicy TcpServer::parse_slow_consumer_policy(const std::string& name)
+{
+    if (name == "disconnect") return SlowConsumerPolicy::Disconnect;
+    if (name == "drop") return SlowConsumerPolicy::Drop;
+    return SlowConsumerPolicy::Coalesce;
+}
+
+void TcpServer::set_slow_consumer_policy(SlowConsumerPolicy policy, int queue_bytes, int max_delay_ms)
+{
+    slow_policy       = policy;
+    slow_queue_bytes  = queue_bytes > 0 ? size_t(queue_bytes) : 0;
+    slow_max_delay_ms = max_delay_ms > 0 ? uint64_t(max_delay_ms) : 0;
+}
+
+void TcpServer::set_overload_control(int lag_ms, int reject_lag_ms, int retry_after_s)
+{
+    overload_lag_us        = lag_ms > 0 ? uint64_t(lag_ms) * 1000 : 0;
+    overload_reject_lag_us = std::max(overload_lag_us, reject_lag_ms > 0 ? uint64_t(reject_lag_ms) * 1000 : 0);
+    overload_retry_after_s = std::max(retry_after_s, 1);
+}
+
+void TcpServer::sample_tables()
+{
+    if (loop_now_ms - tables_sampled_ms < TABLE_SAMPLE_MS) return;
+    tables_sampled_ms = loop_now_ms;
+
+    using metrics::Table;
+    loop_stats.table(Table::Clients, clients.size());
+    loop_stats.table(Table::Users, users.size());
+    loop_stats.table(Table::Usernames, usernames.size());
+    loop_stats.table(Table::ConnectionsPerIp, connections_per_ip.size());
+    loop_stats.table(Table::Channels, channels.size());
+    loop_stats.table(Table::Presence, presence.size());
+    loop_stats.table(Table::OrphanedSends, orphaned_sends.size());
+}
+
+// Hysteresis: a stage is entered at its threshold and left under half of
+// it, so a loop hovering around one doesn't flap between pausing and
+// accepting.
+void TcpServer::process_overload(uint64_t busy_us, uint64_t late_us, Logger& log)
+{
+    loop_lag_us = loop_lag_us - loop_lag_us / 4 + (busy_us + late_us) / 4;
+    loop_stats.loop_lag_us.set(static_cast<int64_t>(loop_lag_us));
+
+    int stage = overload_stage;
+    if (!overload_lag_us)                                            stage = 0;
+    else if (stage < 2 && loop_lag_us >= overload_reject_lag_us)     stage = 2;
+    else if (stage < 1 && loop_lag_us >= overload_lag_us)            stage = 1;
+    else if (stage == 2 && loop_lag_us < overload_reject_lag_us / 2) stage = loop_lag_us >= overload_lag_us / 2;
+    else if (stage == 1 && loop_lag_us < overload_lag_us / 2)        stage = 0;
+
+    if (stage != overload_stage) {
+        static const char* const what[] = {"accepting and authenticating normally",
+                                           "accept paused, new logins held back",
+                                           "refusing new connections and logins with a retry-after"};
+        log.Write_log("Reactor " + std::to_string(worker_id) + " loop lag " + std::to_string(loop_lag_us / 1000) +
+                          " ms: " + what[stage],
+                      stage > overload_stage ? Logger::Warn : Logger::Info);
+        overload_stage = stage;
+        loop_stats.overload_stage.set(stage);
+        pause_accept(stage == 1);
+    }
+
+    // Held logins: refused once rejecting (or after waiting the retry-after
+    // out), resumed in small batches once the loop has caught up.
+    const uint64_t max_wait_ms = uint64_t(overload_retry_after_s) * 1000;
+    size_t resumed = 0;
+    while (!deferred_auths.empty()) {
+        const DeferredAuth held = deferred_auths.front();
+        Client* c               = clients.find(held.fd);
+        if (c && (c->conn_id != held.conn_id || !c->auth_deferred)) c = nullptr;
+
+        if (c && stage == 1 && loop_now_ms - held.since_ms < max_wait_ms) break;
+        if (c && stage == 0 && resumed == DEFERRED_AUTH_BATCH) break;
+        deferred_auths.pop_front();
+        if (!c) continue; // Disconnected while held
+
+        c->auth_deferred = false;
+        if (stage == 0) ++resumed;
+        resume_auth(held.fd, held.conn_id, {stage == 0, {}}); // Claims, or refuses
+    }
+}
+
+void TcpServer::pause_accept(bool paused)
+{
+    if (paused == accept_paused) return;
+    accept_paused = paused;
+    if (paused) loop_stats.accept_paused.add();
+
+    for (size_t i = 0; i < listen_fds.size(); ++i) {
+        if (uring) {
+            // A cancelled multishot accept completes without IORING_CQE_F_MORE;
+            // handle_completion() re-arms it only while not paused.
+            if (paused) uring->prep_cancel(accept_tag(i), static_cast<uint64_t>(RingCancel) << 56);
+            else if (!accept_armed[i]) uring->prep_accept_multishot(listen_fds[i], accept_tag(i));
+            accept_armed[i] = true;
+            continue;
+        }
+        // Connections keep queueing in the listen backlog meanwhile; adding the
+        // edge-triggered listener back reports them at once.
+        if (paused) remove_from_epoll(listen_fds[i]);
+        else        add_to_epoll(listen_fds[i], EPOLLIN | EPOLLET);
+    }
+}
+
+void TcpServer::refuse_auth(Client& c)
+{
+    c.auth_pending  = false;
+    c.auth_deferred = false;
+    send_notice(c.fd, "Error: server busy, retry after " + std::to_string(overload_retry_after_s) + "s");
+    loop_stats.overload_refused.add();
+}
+
+// The clients that held the most queued memory when the output budget ran
+// out, and slow consumers the policy gave up on. Disconnected here rather
+// than in push_output(), whose callers may be walking a channel's member
+// list.
+void TcpServer::process_shed(Logger& log)
+{
+    for (int fd : shed_clients) {
+        Client* client = clients.find(fd);
+        if (!client || !client->shed) continue; // Gone (or fd reused)
+        log.Write_log(std::string(client->slow_consumer ? "Slow consumer" : "Memory pressure") +
+                      ": disconnecting fd=" + std::to_string(fd) + " with " +
+                      std::to_string(client->queued_bytes) + " bytes queued", Logger::Warn);
+        disconnect_client(fd, client->slow_consumer ? metrics::DisconnectReason::SlowConsumer
+                                                    : metrics::DisconnectReason::MemoryPressure);
+    }
+    shed_clients.clear();
+}
+
+bool TcpServer::input_growth_allowed(const Client& c, size_t want) const
+{
+    return c.read_buffer.fits(want) || c.read_buffer.capacity() < SMALL_READ_BUFFER ||
+           !input_memory.exhausted();
+}
+
+void TcpServer::settle_read_buffer(Client& c)
+{
+    ReadBuffer& rb = c.read_buffer;
+    if (rb.empty() && rb.borrowed()) {
+        rb.release_if_empty(); // The chunk is only held while input is partial
+    } else if (rb.empty() && rb.capacity() > (recv_arena ? 0 : SMALL_READ_BUFFER)) {
+        rb.release_if_empty();
+        loop_stats.read_buffers_released.add();
+    }
+    if (recv_arena) {
+        loop_stats.recv_chunks_leased.set(static_cast<int64_t>(recv_arena->leased()));
+        loop_stats.recv_arena_bytes.set(static_cast<int64_t>(recv_arena->mapped_bytes()));
+    }
+    const int64_t delta = static_cast<int64_t>(rb.capacity()) - static_cast<int64_t>(c.input_charged);
+    if (delta == 0) return;
+    c.input_charged = rb.capacity();
+    input_share.add(delta);
+    loop_stats.input_buffer_bytes.add(delta);
+}
+
+void TcpServer::release_memory(Client& c)
+{
+    input_share.add(-static_cast<int64_t>(c.input_charged));
+    loop_stats.input_buffer_bytes.add(-static_cast<int64_t>(c.input_charged));
+    output_share.add(-static_cast<int64_t>(c.queued_bytes));
+    loop_stats.output_queue_bytes.add(-static_cast<int64_t>(c.queued_bytes));
+    c.input_charged = 0;
+    c.queued_bytes  = 0;
+}
+
 // ============================================================================
 // Connection Demultiplexing & Identification
 // ============================================================================
@@ -229,23 +696,93 @@ void TcpServer::remove_from_epoll(int fd)
 // O(1) check whether a username is currently online (in the active set).
 bool TcpServer::IsDuplicated_Username(const std::string& username)
 {
-    return usernames.count(username) > 0;
+    UserId id = users.find(username);
+    if (id != NO_USER && usernames.count(id) > 0) return true;
+    return cluster && cluster->online_elsewhere(username);
+}
+
+Logger::Event TcpServer::client_event(const char* name, int fd, char (&ip)[INET6_ADDRSTRLEN])
+{
+    Logger::Event event{name, fd};
+    ip[0] = '\0';
+    if (const Client* c = clients.find(fd)) {
+        if (c->local_peer) {
+            std::snprintf(ip, INET6_ADDRSTRLEN, "uid %u", c->peer_uid);
+            event.client_ip = ip;
+        } else {
+            event.client_ip = c->ip_key.format(ip);
+        }
+        if (c->user_id != NO_USER) event.username = users.name(c->user_id);
+    }
+    return event;
 }
 
 // Fully tears down one client: stops epoll monitoring, closes the socket,
 // frees its username slot (if authenticated), and removes it from `clients`.
-void TcpServer::disconnect_client(int client_fd)
+void TcpServer::disconnect_client(int client_fd, metrics::DisconnectReason reason)
 {
-    remove_from_epoll(client_fd); // Stop monitoring first
+    Client* client = clients.find(client_fd);
+    TRACE_3(disconnect, client_fd, static_cast<unsigned>(reason), metrics::reason_name(reason));
+    if (client && client->capture_stream) capture->close_stream(client->capture_stream);
+
+    if (uring) {
+        // Shutting the socket down completes its in-flight recv/sends (their
+        // CQEs are then ignored). Payloads those sends still point into are
+        // parked until the kernel has let go of them.
+        if (client && client->sends_in_flight > 0) {
+            OrphanedSends& parked = orphaned_sends[ring_key(*client)];
+            parked.queue     = std::move(client->write_queue);
+            parked.in_flight = client->sends_in_flight;
+        }
+        shutdown(client_fd, SHUT_RDWR);
+    } else {
+        // Coalesced data still waiting for the end of the batch (e.g. the
+        // idle-timeout notice): last best-effort write, as an immediate
+        // send would have done.
+        if (client && client->flush_pending) flush_write_queue(client_fd);
+        remove_from_epoll(client_fd); // Stop monitoring first
+    }
+    if (client && client->tls) {
+        SSL_free(client->tls);    // No close_notify: the socket goes away anyway
+        client->tls = nullptr;
+    }
     close(client_fd);             // Release the OS socket
 
     // Erase from registry and free the username slot if it was authenticated.
-    auto it = clients.find(client_fd);
-    if (it != clients.end()) {
-        if (!it->second.username.empty()) {
-            usernames.erase(it->second.username);
+    // A claim still in flight is released by on_claim_result() (conn_id mismatch).
+    if (client) {
+        // A suspended authenticate() is cancelled with its frame; its answer
+        // will find no waiter. One running right now (this is a send error
+        // inside it) is freed after the batch.
+        if (client->auth_task.pending() && !client->auth_wait) {
+            retired_auth_tasks.push_back(std::move(client->auth_task));
+        }
+        client->auth_task.reset();
+        client->auth_wait = nullptr;
+
+        if (client->user_id != NO_USER) {
+            const std::string name(users.name(client->user_id));
+            session_fds[client->user_id] = -1;
+            release_username(name);
+            presence_changed(name, -1);
+            if (cluster) cluster->presence(name, false);
+            users.release(client->user_id);
+        }
+
+        timers.cancel(client->idle_timer);
+        leave_all_channels(*client);
+        if (client->presence_sub) unsubscribe_presence(*client);
+
+        auto counter = client->local_peer ? connections_per_ip.end() : connections_per_ip.find(client->ip_key);
+        if (counter != connections_per_ip.end() && --counter->second == 0) {
+            connections_per_ip.erase(counter);
         }
-        clients.erase(it);
+        if (client->protocol == protocol::Version::V2) --v2_clients;
+        if (client->deflate) deflate_clients.fetch_sub(1, std::memory_order_relaxed);
+        release_memory(*client);
+        loop_stats.disconnected(reason);
+        loop_stats.connections.add(-1);
+        clients.erase(client_fd); // Recycled into the pool
     }
 }
 
@@ -257,16 +794,17 @@ void TcpServer::shutdownActiveClients()
     std::vector<int> fds_to_disconnect;
     fds_to_disconnect.reserve(clients.size());
 
-    for (const auto& [fd, client] : clients) {
-        fds_to_disconnect.push_back(fd);
-    }
+    clients.for_each([&](int fd, const Client&) { fds_to_disconnect.push_back(fd); });
 
     // 2. Safely tear them down one by one.
     for (int fd : fds_to_disconnect) {
-        disconnect_client(fd);
+        disconnect_client(fd, metrics::DisconnectReason::Shutdown);
     }
 
-    // 3. Clear the unique-username tracking set just in case.
+    // 3. Clear the unique-username tracking set just in case. In a group the
+    //    shard also holds names of other workers' sessions, which are all
+    //    being torn down at the same time.
+    for (const auto& [id, worker] : usernames) users.release(id);
     usernames.clear();
 }
 
@@ -285,186 +823,310 @@ void TcpServer::Shutdown()
 // Called whenever the listening socket reports EPOLLIN. Because the listener
 // is edge-triggered, we MUST accept() in a loop until EAGAIN, otherwise
 // pending connections could be silently missed.
-void TcpServer::handle_new_connection(Logger* logger)
+void TcpServer::handle_new_connection(int listen_fd, Logger* logger)
 {
     while (true)
     {
-        sockaddr_in client_addr{};
-        socklen_t   len = sizeof(client_addr);
+        sockaddr_storage client_addr{}; // Either family
+        socklen_t        len = sizeof(client_addr);
 
-        int new_fd = accept(server_fd, (sockaddr*)&client_addr, &len);
+        // accept4() hands the socket back non-blocking and close-on-exec,
+        // saving the two fcntl() calls per connection.
+        int new_fd = accept4(listen_fd, (sockaddr*)&client_addr, &len,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (new_fd < 0)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK) break; // Queue drained
             if (errno == EINTR) continue;                       // Retry
-            perror("accept");
+            perror("accept4");
             break;
         }
 
-        // Convert binary peer address to a printable string (thread-safe).
-        char ip_str[INET_ADDRSTRLEN] = {0};
-        inet_ntop(AF_INET, &client_addr.sin_addr, ip_str, sizeof(ip_str));
-        std::string new_ip = ip_str;
+        register_client(new_fd, client_addr, logger);
+    }
+}
 
-        // Per-IP connection cap (anti-flood): count existing fds from same host.
-        int ip_count = 0;
-        for (const auto& [fd, client] : clients) {
-            if (client.ip_address == new_ip) ip_count++;
+// register_client — admission + bookkeeping for one accepted socket, shared
+// by the epoll accept loop and io_uring accept completions. `new_fd` must
+// already be non-blocking. Rejected sockets are closed here.
+bool TcpServer::register_client(int new_fd, const sockaddr_storage& client_addr, Logger* logger)
+{
+    TRACE_1(accept, new_fd);
+
+    // The unix socket: the kernel says who the peer is, and only the uids
+    // of unix_socket_users get in. It is trusted after that, so no per-IP
+    // counting, and no TLS on a socket that never leaves the host.
+    const bool local = client_addr.ss_family == AF_UNIX;
+    const bool plaintext = !tls_context || local;
+    ucred peer{};
+    if (local) {
+        socklen_t len = sizeof(peer);
+        if (getsockopt(new_fd, SOL_SOCKET, SO_PEERCRED, &peer, &len) == -1 || !local_peers.count(peer.uid)) {
+            sendAll(new_fd, "Error: uid " + std::to_string(peer.uid) + " may not use this socket\n");
+            if (logger) {
+                logger->Write_log(Logger::Warn, Logger::Event{"connect_refused", new_fd}, "Local connection from uid ",
+                                  peer.uid, " (pid ", peer.pid, ") refused: not in unix_socket_users");
+            }
+            close(new_fd);
+            loop_stats.rejected.add();
+            return false;
         }
+    }
 
-        if (ip_count >= MAX_CONNECTIONS_PER_IP) {
-            // Reject politely, then close without ever registering the client.
-            sendAll(new_fd, "[ERROR]: Connection limit exceeded for this host IP\n");
-            close(new_fd);
-            continue;
+    // Per-IP connection cap (anti-flood): O(1) lookup of this host's
+    // live connection count, keyed by the binary address.
+    IpKey key = local ? IpKey{} : IpKey::from_sockaddr(reinterpret_cast<const sockaddr*>(&client_addr));
+    uint16_t uncounted = 0;
+    uint16_t& ip_count = local ? uncounted : connections_per_ip[key];
+
+    if (!local && ip_count >= max_connections_per_ip) {
+        // Reject politely (a TLS client couldn't read a plaintext line), then
+        // close without ever registering the client.
+        if (plaintext) sendAll(new_fd, "[ERROR]: Connection limit exceeded for this host IP\n");
+        close(new_fd);
+        loop_stats.rejected.add();
+        return false;
+    }
+    if (input_memory.exhausted()) {
+        // Every connection needs a read buffer; the budget has none left.
+        if (plaintext) sendAll(new_fd, "Error: server busy\n");
+        close(new_fd);
+        if (!local && ip_count == 0) connections_per_ip.erase(key);
+        loop_stats.memory_refused.add();
+        return false;
+    }
+    if (draining) {
+        // `drain on` from the admin channel: the existing sessions stay,
+        // new ones go to another node (or come back after `drain off`).
+        if (plaintext) sendAll(new_fd, "Error: server is draining, try again later\n");
+        close(new_fd);
+        if (!local && ip_count == 0) connections_per_ip.erase(key);
+        loop_stats.drain_refused.add();
+        return false;
+    }
+    if (overload_stage == 2) {
+        // Accepting only to say when to come back (see set_overload_control()).
+        if (plaintext) {
+            sendAll(new_fd, "Error: server busy, retry after " + std::to_string(overload_retry_after_s) + "s\n");
         }
+        close(new_fd);
+        if (!local && ip_count == 0) connections_per_ip.erase(key);
+        loop_stats.overload_refused.add();
+        return false;
+    }
+    ip_count++;
+    loop_stats.accepted.add();
+    loop_stats.connections.add(1);
+
+    // Build the per-client state in a (usually recycled) table slot; it
+    // keeps its address until disconnect, so the timer can link into it.
+    Client& stored = clients.insert(new_fd);
+    stored.read_buffer.use_chunks(recv_arena.get());
+    stored.fd      = new_fd;
+    stored.conn_id = next_conn_id++;
+    stored.ip_key  = key;
+    stored.port    = local ? 0
+                           : ntohs(client_addr.ss_family == AF_INET6 // Network → host byte order
+                                       ? reinterpret_cast<const sockaddr_in6&>(client_addr).sin6_port
+                                       : reinterpret_cast<const sockaddr_in&>(client_addr).sin_port);
+    stored.local_peer = local;
+    stored.peer_uid   = peer.uid;
+
+    // Arm the idle timeout.
+    stored.last_activity_ms = monotonic_ms();
+    stored.connected_ms = stored.last_activity_ms;
+    stored.idle_timer.owner = static_cast<uint64_t>(new_fd);
+    stored.idle_timer.kind  = IdleTimer;
+    if (idle_timeout_ms) timers.schedule(stored.idle_timer, idle_timeout_ms);
+    stored.msg_tokens.reset(stored.last_activity_ms, rate_message_burst);
+    stored.byte_tokens.reset(stored.last_activity_ms, rate_byte_burst);
+
+    // TLS listener: the handshake comes first; the client sends ClientHello.
+    if (!plaintext) {
+        stored.tls = tls_context->accept(new_fd);
+        if (!stored.tls) {
+            if (logger) logger->Write_log("TLS session setup failed: " + tls::last_error(), Logger::Error);
+            if (!uring) add_to_epoll(new_fd, EPOLLIN); // disconnect_client() deregisters it
+            disconnect_client(new_fd, metrics::DisconnectReason::TlsError);
+            return false;
+        }
+        stored.tls_handshaking = true;
+    }
 
-        set_NonBlocking(new_fd);
-        add_to_epoll(new_fd, EPOLLIN); // Level-triggered for clients (simpler framing)
+    // Start watching for input.
+    if (uring) {
+        if (stored.tls_handshaking) uring->prep_poll(new_fd, POLLIN, ring_tag(RingHandshake, stored));
+        else uring->prep_recv_multishot(new_fd, ring_tag(RingRecv, stored));
+    } else {
+        // Edge-triggered clients get write interest up front: EPOLLOUT then
+        // only fires when a full socket drains, and flushing never needs
+        // an EPOLL_CTL_MOD. handle_client_readable() always reads to EAGAIN.
+        add_to_epoll(new_fd, edge_triggered ? EPOLLIN | EPOLLOUT | EPOLLET : EPOLLIN);
+    }
 
-        // Build and store the per-client state.
-        Client c;
-        c.fd         = new_fd;
-        c.ip_address = new_ip;
-        c.port       = ntohs(client_addr.sin_port); // Network → host byte order
-        clients[new_fd] = std::move(c);
+    // Inherited from the listener; read back once to show what took effect.
+    if (!tuning_reported && !local && logger) {
+        tuning_reported = true;
+        logger->Write_log("Socket options on accepted sockets: " + SocketTuning::describe(new_fd, false),
+                          Logger::Info);
+    }
 
+    if (local) {
         if (logger) {
-            logger->Write_log(
-                "Fd: " + std::to_string(new_fd) + " New connection from " + new_ip + ":" + std::to_string(clients[new_fd].port),
-                Logger::Info);
+            logger->Write_log(Logger::Info, Logger::Event{"connect", new_fd}, "Fd: ", new_fd,
+                              " New local connection from uid ", peer.uid, " (pid ", peer.pid, ")");
         }
-        std::cout << "New connection from " << new_ip << ":" << std::to_string(clients[new_fd].port) << " (fd: " << new_fd << ")\n";
+        std::cout << "New local connection from uid " << peer.uid << " (fd: " << new_fd << ")\n";
+        if (capture && capture->active()) stored.capture_stream = capture->open_stream();
+        return true;
     }
-}
 
+    char new_ip[INET6_ADDRSTRLEN]; // Formatted for the logs only
+    key.format(new_ip);
+    const bool v6 = std::strchr(new_ip, ':') != nullptr; // Bracketed before the port
+    if (logger) {
+        logger->Write_log(Logger::Info, Logger::Event{"connect", new_fd, new_ip},
+                          "Fd: ", new_fd, " New connection from ", v6 ? "[" : "", new_ip, v6 ? "]:" : ":",
+                          stored.port);
+    }
+    std::cout << "New connection from " << (v6 ? "[" : "") << new_ip << (v6 ? "]:" : ":") << stored.port
+              << " (fd: " << new_fd << ")\n";
+    if (capture && capture->active()) stored.capture_stream = capture->open_stream();
+    return true;
+}
 
-// save_credentials (atomic write via temp file + rename)
-// Reads the existing JSON DB (tolerating corruption), appends a new user
-// record with a hashed password + UTC timestamp, then writes atomically
-// so a crash mid-write never corrupts the live file.
-bool TcpServer::save_credentials(const std::string& username,
-                                 const std::string& password,
-                                 const std::string& ip_addr)
+// advance_tls_handshake — one step of a non-blocking handshake, driven by
+// readiness (epoll events, or one-shot polls on the ring). Once it is done,
+// whatever the kernel took over (kTLS) no longer exists in userspace: with
+// both directions offloaded the SSL object is freed and the socket carries
+// plaintext, so writev(), io_uring and the handoff treat it like any other.
+bool TcpServer::advance_tls_handshake(int fd, Logger& log)
 {
-    using json = nlohmann::json;
-    json data;
-
-    // Load existing DB if present; tolerate corruption by resetting to {}.
-    std::ifstream infile(CREDENTIALS_PATH);
-    if (infile.is_open()) {
-        try {
-            infile >> data;
-        } catch (json::parse_error& e) {
-            std::cerr << "JSON parse error: " << e.what() << std::endl;
-            data = json::object();
+    Client& c = *clients.find(fd);
+    const tls::Io io = tls::handshake(c.tls);
+
+    if (io == tls::Io::WantRead || io == tls::Io::WantWrite) {
+        if (uring) {
+            uring->prep_poll(fd, io == tls::Io::WantRead ? POLLIN : POLLOUT, ring_tag(RingHandshake, c));
+        } else if (io == tls::Io::WantWrite) {
+            arm_epollout(c);
         }
-        infile.close();
+        return true;
     }
-
-    // Ensure the "users" array exists before appending.
-    if (!data.contains("users") || !data["users"].is_array()) {
-        data["users"] = json::array();
+    if (io != tls::Io::Ok) {
+        const std::string reason = tls::last_error();
+        log.Write_log("TLS handshake with fd=" + std::to_string(fd) + " failed: " +
+                      (reason.empty() ? "connection closed" : reason), Logger::Warn);
+        disconnect_client(fd, metrics::DisconnectReason::TlsError);
+        return false;
     }
 
-    // UTC timestamp for consistency across hosts/timezones.
-    auto now = std::chrono::system_clock::now();
-    std::time_t t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_struct{};
-    gmtime_r(&t, &tm_struct); // Thread-safe UTC conversion
-    std::ostringstream datetime_ss;
-    datetime_ss << std::put_time(&tm_struct, "%Y-%m-%dT%H:%M:%SZ"); // ISO-8601 UTC
-
-    // Build the new user record (password is hashed, never stored plain).
-    json user;
-    user["username"]   = username;
-    user["password"]   = hash_password(password);
-    user["IP_source"]  = ip_addr;
-    user["created_at"] = datetime_ss.str();
-
-    data["users"].push_back(user);
-
-    // Atomic: write to temp, then rename over the original (crash-safe).
-    const std::string tmp_path = std::string(CREDENTIALS_PATH) + ".tmp";
-    std::ofstream outfile(tmp_path, std::ios::trunc);
-    if (!outfile.is_open()) {
-        std::cerr << "Failed to open temp credentials file for writing" << std::endl;
+    c.tls_handshaking = false;
+    loop_stats.tls_handshakes.add();
+    const bool tx = tls::tx_offloaded(c.tls);
+    const bool rx = tls::rx_offloaded(c.tls);
+    if (tx) loop_stats.ktls_tx.add();
+    if (rx) loop_stats.ktls_rx.add();
+
+    const std::string offload = std::string(tx ? "kernel" : "userspace") + " TX, " +
+                                (rx ? "kernel" : "userspace") + " RX";
+    // The ring only reads and writes the socket itself.
+    if (!(tx && rx) && (uring || tls_context->ktls_required())) {
+        log.Write_log("TLS fd=" + std::to_string(fd) + ": " + offload + "; closing (" +
+                      (uring ? "io_uring needs" : "require_ktls asks for") + " kTLS both ways)",
+                      Logger::Warn);
+        disconnect_client(fd, metrics::DisconnectReason::TlsError);
         return false;
     }
-    outfile << data.dump(4); // Pretty-print with 4-space indent
-    outfile.flush();
-    outfile.close();
+    log.Write_log("TLS 1.3 established on fd=" + std::to_string(fd) + " (" + offload + ")", Logger::Info);
+
+    if (tx && rx) {
+        SSL_free(c.tls);
+        c.tls     = nullptr;
+        c.ktls_rx = true;
+    } else {
+        c.tls_user_tx = !tx;
+    }
 
-    // rename() is atomic on POSIX: reader never sees a half-written file.
-    if (std::rename(tmp_path.c_str(), CREDENTIALS_PATH) != 0) {
-        std::cerr << "Failed to rename temp credentials file: " << strerror(errno) << std::endl;
-        std::remove(tmp_path.c_str()); // Clean up the orphan temp on failure
-        return false;
+    // Output queued during the handshake goes out now.
+    if (uring) {
+        uring->prep_recv_multishot(fd, ring_tag(RingRecv, c));
+        if (!c.write_queue.empty() && !c.send_scheduled && c.sends_in_flight == 0) {
+            c.send_scheduled = true;
+            ring_send_ready.push_back(fd);
+        }
+    } else if (!c.write_queue.empty() && !c.flush_pending) {
+        c.flush_pending = true;
+        dirty_clients.push_back(fd);
     }
+    return true;
+}
+
+// save_credentials — hashes, then appends the user through the
+// CredentialStore (index + atomic on-disk write).
+bool TcpServer::save_credentials(const std::string& username,
+                                 const std::string& password,
+                                 const std::string& ip_addr)
+{
+    // Hash first: the expensive Argon2id step must not hold the store lock.
+    return persist_user(username, hash_password(password), ip_addr);
+}
+
+// persist_user — the I/O half of save_credentials, for callers that already
+// hold an Argon2id hash (the CryptoPool register flow).
+bool TcpServer::persist_user(const std::string& username,
+                             const std::string& password_hash,
+                             const std::string& ip_addr)
+{
+    if (!credentials().add(username, password_hash, ip_addr)) return false;
 
     std::cout << "Credentials saved for user: " << username << std::endl;
     return true;
 }
 
 // ============================================================================
-// username_exists_in_db — on-disk uniqueness check (covers users who
+// username_exists_in_db — persistent uniqueness check (covers users who
 // registered in a previous run and are not currently in the online set).
+// O(1) against the in-memory index; the file is not touched.
 // ============================================================================
 bool TcpServer::username_exists_in_db(const std::string& username)
 {
-    std::ifstream file(CREDENTIALS_PATH);
-    if (!file.is_open()) return false; // No DB yet → not taken
-
-    nlohmann::json data;
-    try {
-        file >> data;
-    } catch (nlohmann::json::parse_error&) {
-        return false; // Corrupt DB → treat as not found
-    }
-
-    if (!data.contains("users") || !data["users"].is_array()) return false;
-
-    // Linear scan; .value() avoids throwing on missing keys.
-    for (const auto& user : data["users"]) {
-        if (user.value("username", "") == username) return true;
-    }
-    return false;
+    return credentials().contains(username);
 }
 
 // ============================================================================
-// verify_credentials — loads the DB and checks the given plaintext password
-// against the stored Argon2id hash for a matching username.
+// verify_credentials — checks the given plaintext password against the
+// stored Argon2id hash for `username` (index lookup + inline verify).
 // ============================================================================
 bool TcpServer::verify_credentials(const std::string& username,
                                    const std::string& password)
 {
-    std::ifstream file(CREDENTIALS_PATH);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open credentials file\n";
-        return false;
-    }
+    std::string stored_hash;
+    return lookup_password_hash(username, stored_hash) &&
+           verify_password(password, stored_hash);
+}
 
-    nlohmann::json data;
-    try {
-        file >> data;
-    } catch (nlohmann::json::parse_error& e) {
-        std::cerr << "JSON parse error: " << e.what() << "\n";
-        return false;
-    }
+// ============================================================================
+// lookup_password_hash — index read only; the Argon2id verification of the
+// returned hash is left to the caller (normally a CryptoPool worker).
+// ============================================================================
+bool TcpServer::lookup_password_hash(const std::string& username, std::string& out)
+{
+    return credentials().find_hash(username, out);
+}
 
-    if (!data.contains("users") || !data["users"].is_array()) return false;
+// Store attached by main(), or a private one on CREDENTIALS_PATH loaded on
+// first use (keeps a bare TcpServer usable on its own).
+CredentialStore& TcpServer::credentials()
+{
+    if (store) return *store;
 
-    // Find the user, then verify the password against its Argon2id hash.
-    for (const auto& user : data["users"]) {
-        const std::string stored_username = user.value("username", "");
-        const std::string stored_hash     = user.value("password", "");
-        if (stored_username == username &&
-            !stored_hash.empty() &&
-            verify_password(password, stored_hash)) {
-            return true;
-        }
+    own_store = std::make_unique<CredentialStore>(CREDENTIALS_PATH);
+    if (!own_store->load()) {
+        std::cerr << "Credential DB unreadable; starting with an empty index\n";
     }
-    return false;
+    store = own_store.get();
+    return *store;
 }
 
 // process_message — handles exactly one complete (newline-terminated) record
@@ -472,132 +1134,1493 @@ bool TcpServer::verify_credentials(const std::string& username,
 // handling or, if the client is authenticated, broadcasts it as a chat message.
 // Returns false if the client got disconnected (caller must stop using fd);
 // currently always returns true because disconnects here are deferred.
-bool TcpServer::process_message(int fd, const std::string& raw, Logger& log)
+bool TcpServer::process_message(int fd, std::string_view raw, Logger& log)
 {
-    // Copy into the reusable C buffer for the legacy trim/parse utilities.
-    memset(buffer, 0, BUFFER_SIZE);
-    strncpy(buffer, raw.c_str(), BUFFER_SIZE - 1);
-    ssize_t n = static_cast<ssize_t>(strlen(buffer));
+    // Records were always capped at one scratch buffer's worth; keep that limit
+    // now that they are read straight out of the client's buffer.
+    if (raw.size() > BUFFER_SIZE - 1) raw = raw.substr(0, BUFFER_SIZE - 1);
 
-    n = trimBuffer(buffer, n);                 // Strip trailing newline/whitespace
-    if (isBufferEmpty(buffer, n)) return true; // Nothing to do
+    std::string_view text = trimBuffer(raw); // Strip trailing newline/whitespace
+    if (text.empty()) return true;           // Nothing to do
 
     temp_user_credentials temp;
 
     // parse_credentials returns true for /login and /register commands.
-    if (parse_credentials(buffer, temp))
+    if (parse_credentials(text, temp))
     {
-        // ---- REGISTER (cmd_type == 2) ----
-        if (temp.cmd_type == 2)
-        {
-            // Reject if online now OR already persisted on disk.
-            if (IsDuplicated_Username(temp.username) ||
-                username_exists_in_db(temp.username))
-            {
-                sendAll(fd, "Error: username already taken\n");
-                log.Write_log("Registration failed for " + temp.username +
-                              ": username already taken", Logger::Warn);
-                return true;
-            }
+        begin_auth(fd, std::move(temp), log);
+        return true;
+    }
 
-            // Persist before marking online (fail closed if write fails).
-            if (!save_credentials(temp.username, temp.password, clients[fd].ip_address)) {
-                sendAll(fd, "Error: could not save credentials\n");
-                log.Write_log("Persistence failure registering " + temp.username, Logger::Error);
-                return true;
-            }
+    // /join, /part, /channels, /resume (other slash lines stay chat text, as before)
+    if (text[0] == '/' && handle_command(fd, text, log)) return true;
 
-            clients[fd].username = temp.username; // Bind session to fd
-            usernames.insert(temp.username);      // Mark online
+    // ---- Regular chat message ----
+    broadcast_chat(fd, text, log);
+    return true;
+}
 
-            sendAll(fd, "Registered " + temp.username + "\n");
-            log.Write_log("New user registered: " + temp.username, Logger::Info);
+// process_frame — one complete v2 frame. The header already says what the
+// payload is, so chat text is relayed as is and credentials are two
+// length-delimited fields: nothing is scanned or trimmed.
+bool TcpServer::process_frame(int fd, const protocol::FrameHeader& header,
+                              std::string_view payload, Logger& log)
+{
+    switch (header.type)
+    {
+    case protocol::Register:
+    case protocol::Login:
+    {
+        std::string_view name, password;
+        if (!protocol::split_named(payload, name, password) || name.empty() || password.empty()) {
+            send_notice(fd, "Error: malformed credentials");
             return true;
         }
+        temp_user_credentials temp;
+        temp.cmd_type = header.type == protocol::Register ? 2 : 1;
+        temp.username.assign(name.data(), name.size());
+        temp.password.assign(password.data(), password.size());
+        begin_auth(fd, std::move(temp), log);
+        return true;
+    }
 
-        // ---- LOGIN (cmd_type == 1) ----
-        if (temp.cmd_type == 1)
-        {
+    case protocol::Chat:
+        // A newline would let the text forge extra lines for v1 recipients.
+        if (payload.empty() || std::memchr(payload.data(), '\n', payload.size())) {
+            send_notice(fd, "Error: invalid chat message");
+            return true;
+        }
+        broadcast_chat(fd, payload, log);
+        return true;
+
+    case protocol::Command:
+        if (!handle_command(fd, payload, log)) send_notice(fd, "Error: unknown command");
+        return true;
+
+    case protocol::Capabilities:
+    {
+        // Bits not offered in Hello are ignored; there is no reply.
+        Client& c = *clients.find(fd);
+        const bool want = !payload.empty() && (static_cast<uint8_t>(payload[0]) & protocol::CAP_DEFLATE) &&
+                          compress_offered.load(std::memory_order_relaxed);
+        if (want != c.deflate) deflate_clients.fetch_add(want ? 1 : -1, std::memory_order_relaxed);
+        c.deflate = want;
+        return true;
+    }
+
+    default:
+        send_notice(fd, "Error: unsupported frame type");
+        return true;
+    }
+}
+
+// /login (cmd_type 1), /register (cmd_type 2) or a verified /resume
+// (cmd_type 3): runs authenticate(), which keeps the attempt going across
+// its waits.
+void TcpServer::begin_auth(int fd, temp_user_credentials&& creds, Logger& log)
+{
+    if (creds.cmd_type < 1 || creds.cmd_type > 3) return; // Unknown cmd_type (4 is only set below)
+
+    // v2 frames carry the name with a one-byte length.
+    if (creds.username.size() > protocol::MAX_NAME) {
+        send_notice(fd, "Error: username too long");
+        return;
+    }
+    // A v2 frame carries any bytes: a newline or control byte in the name
+    // would forge lines for v1 readers of the history, notices and /who.
+    if (creds.cmd_type != 3 && !isValidUsername(creds.username)) {
+        send_notice(fd, "Error: usernames are printable ASCII without '|'");
+        return;
+    }
+
+    Client& c = *clients.find(fd);
+    if (c.auth_pending) {
+        send_notice(fd, "Error: authentication already in progress");
+        return;
+    }
+
+    // A local peer was vouched for by its uid at accept: it may take the
+    // account listed for that uid, and its password is never looked at.
+    if (c.local_peer && creds.cmd_type != 3) {
+        if (!creds.password.empty()) sodium_memzero(&creds.password[0], creds.password.size());
+        const auto peer = local_peers.find(c.peer_uid);
+        std::string refused;
+        if (creds.cmd_type == 2) {
+            refused = "Error: accounts of local peers are created with tcpserver-admin";
+        } else if (peer == local_peers.end() || peer->second != creds.username) {
+            refused = "Error: uid " + std::to_string(c.peer_uid) + " may not log in as " + creds.username;
+        } else if (!username_exists_in_db(creds.username)) {
+            refused = "Error: no account named " + creds.username;
+        }
+        if (!refused.empty()) {
+            loop_stats.auth_failed.add();
+            send_notice(fd, refused);
+            return;
+        }
+        creds.cmd_type = 4;
+    }
+
+    const uint64_t conn_id = c.conn_id;
+    c.auth_pending    = true;
+    c.auth_started_us = monotonic_us();
+    c.auth_task.reset(); // The previous attempt's finished frame
+    TRACE_2(auth_start, fd, creds.cmd_type);
+
+    // Runs up to its first wait (or to its end) before returning.
+    coro::Task task = authenticate(fd, std::move(creds), log);
+    Client* again = clients.find(fd);
+    if (again && again->conn_id == conn_id) again->auth_task = std::move(task);
+}
+
+// Each co_await is one wait that used to be a callback. `fd` is looked up
+// again after every wait and every call that sends: a task still running
+// means its client still exists (disconnect_client() cancels a suspended
+// one), but not that a reference taken before is still the one to use.
+coro::Task TcpServer::authenticate(int fd, temp_user_credentials creds, Logger& log)
+{
+    // The plaintext is wiped on every way out, a cancellation included.
+    struct Wipe {
+        std::string& password;
+        ~Wipe() { if (!password.empty()) sodium_memzero(&password[0], password.size()); }
+    } wipe{creds.password};
+
+    AuthWait wait;
+    const std::string& name = creds.username;
+
+    // Overloaded: no claim and no Argon2id yet (a /resume or a local peer
+    // costs neither).
+    if (overload_stage > 0 && creds.cmd_type < 3) {
+        Client& c = *clients.find(fd);
+        if (overload_stage == 2) {
+            refuse_auth(c);
+            co_return;
+        }
+        c.auth_deferred = true;
+        c.auth_wait     = &wait;
+        deferred_auths.push_back({fd, c.conn_id, loop_now_ms});
+        loop_stats.auth_deferred.add();
+        if (!(co_await wait).ok) { // Refused by process_overload()
+            refuse_auth(*clients.find(fd));
+            co_return;
+        }
+    }
+
+    // Claim the name in its shard: this is what keeps sessions unique
+    // across reactors.
+    clients.find(fd)->auth_wait = &wait;
+    claim_username(fd, name);
+    if (!(co_await wait).ok) {
+        Client& c = *clients.find(fd);
+        c.auth_pending = false;
+        record_auth(c, false);
+        if (creds.cmd_type == 2) {
+            send_notice(fd, "Error: username already taken");
+            log.Write_log("Registration failed for " + name + ": username already taken", Logger::Warn);
+        } else {
             // Prevent the same account being online twice.
-            if (IsDuplicated_Username(temp.username)) {
-                sendAll(fd, "Error: user already logged in\n");
-                log.Write_log("Duplicate login blocked for " + temp.username, Logger::Warn);
-                return true;
-            }
+            send_notice(fd, "Error: user already logged in");
+            char ip[INET6_ADDRSTRLEN];
+            Logger::Event event = client_event("duplicate_login", fd, ip);
+            event.username = name;
+            log.Write_log(Logger::Warn, event, "Duplicate login blocked for ", name);
+        }
+        co_return;
+    }
 
-            if (verify_credentials(temp.username, temp.password)) {
-                clients[fd].username = temp.username;
-                usernames.insert(temp.username);
-                sendAll(fd, "Login successful for " + temp.username + "\n");
-                log.Write_log("User logged in: " + temp.username, Logger::Info);
-            } else {
-                sendAll(fd, "Error: invalid username or password\n");
-            }
-            return true;
+    // A verified session token stands in for the password: no Argon2id.
+    if (creds.cmd_type == 3) {
+        clients.find(fd)->auth_pending = false;
+        loop_stats.sessions_resumed.add();
+        bind_session(fd, name, "Resumed session for " + name);
+        log.Write_log("Session resumed: " + name, Logger::Info);
+        co_return;
+    }
+
+    // So does the uid of a local peer (checked in begin_auth()).
+    if (creds.cmd_type == 4) {
+        Client& c = *clients.find(fd);
+        const uint32_t uid = c.peer_uid;
+        c.auth_pending = false;
+        loop_stats.local_logins.add();
+        bind_session(fd, name, "Login successful for " + name);
+        char ip[INET6_ADDRSTRLEN];
+        log.Write_log(Logger::Info, client_event("login", fd, ip), "Local peer uid ", uid, " logged in as ", name);
+        co_return;
+    }
+
+    // Credential step. The name is reserved, so no other session can race
+    // us here; only cheap checks run on the loop.
+    CryptoPool::Job job;
+    job.username = name;
+    job.password = creds.password;
+    job.reply    = &inbox();
+    job.fd       = fd;
+    job.conn_id  = clients.find(fd)->conn_id;
+
+    if (creds.cmd_type == 2) {
+        // ---- REGISTER: reject if already persisted on disk ----
+        job.kind = CryptoPool::Job::Hash;
+        if (username_exists_in_db(name)) {
+            Client& c = *clients.find(fd);
+            c.auth_pending = false;
+            record_auth(c, false);
+            send_notice(fd, "Error: username already taken");
+            log.Write_log("Registration failed for " + name + ": username already taken", Logger::Warn);
+            release_username(name);
+            co_return;
+        }
+    } else {
+        // ---- LOGIN: fetch the stored hash (unknown users fail the verify) ----
+        lookup_password_hash(name, job.stored_hash);
+        job.kind   = CryptoPool::Job::Verify;
+        job.rehash = rehash_on_login;
+    }
+
+    clients.find(fd)->auth_wait = &wait;
+    if (!crypto) {
+        // No pool attached: same flow, but the Argon2id call blocks the loop.
+        MailboxMessage result;
+        CryptoPool::execute(job, result);
+        resume_auth(fd, job.conn_id, {result.ok, std::move(result.password_hash)});
+    } else if (!crypto->submit(std::move(job))) {
+        Client& c = *clients.find(fd);
+        c.auth_wait    = nullptr;
+        c.auth_pending = false;
+        record_auth(c, false);
+        send_notice(fd, "Error: server busy, please retry later");
+        log.Write_log("Crypto pool saturated; auth rejected for " + name, Logger::Warn);
+        release_username(name);
+        co_return;
+    }
+    const AuthStep verdict = co_await wait;
+
+    // Everything from here is cheap: bind the session (and, for /register,
+    // persist the ready-made hash).
+    Client& c = *clients.find(fd);
+    c.auth_pending = false;
+
+    // ---- REGISTER (cmd_type == 2) ----
+    if (creds.cmd_type == 2) {
+        // Persist before marking online (fail closed if hashing/write fails).
+        if (!verdict.ok || !persist_user(name, verdict.password_hash, c.ip_key.to_string())) {
+            record_auth(c, false);
+            send_notice(fd, "Error: could not save credentials");
+            log.Write_log("Persistence failure registering " + name, Logger::Error);
+            release_username(name);
+            co_return;
         }
 
-        return true; // Parsed but unknown cmd_type
+        bind_session(fd, name, "Registered " + name);
+        char ip[INET6_ADDRSTRLEN];
+        log.Write_log(Logger::Info, client_event("register", fd, ip), "New user registered: ", name);
+        co_return;
     }
 
-    // ---- Regular chat message ----
+    // ---- LOGIN (cmd_type == 1) ----
+    if (!verdict.ok) {
+        record_auth(c, false);
+        send_notice(fd, "Error: invalid username or password");
+        release_username(name);
+        co_return;
+    }
+
+    bind_session(fd, name, "Login successful for " + name);
+    char ip[INET6_ADDRSTRLEN];
+    log.Write_log(Logger::Info, client_event("login", fd, ip), "User logged in: ", name);
+
+    // Inline, the upgrade to the current cost follows the login too.
+    if (!crypto && job.upgrade) {
+        std::unique_ptr<MailboxMessage> rehashed(CryptoPool::rehash(job));
+        if (rehashed) on_password_rehashed(*rehashed, log);
+    }
+}
+
+bool TcpServer::resume_auth(int fd, uint64_t conn_id, AuthStep step)
+{
+    Client* c = clients.find(fd);
+    if (!c || c->conn_id != conn_id || !c->auth_wait) return false;
+    std::exchange(c->auth_wait, nullptr)->complete(std::move(step));
+    return true;
+}
+
+// The token replaces the password proof; everything else (the shard claim
+// that keeps sessions unique, the account check) is the /login path.
+void TcpServer::resume_session(int fd, std::string_view token, Logger& log)
+{
+    if (clients.find(fd)->user_id != NO_USER) {
+        send_notice(fd, "Error: already logged in");
+        return;
+    }
+
+    temp_user_credentials temp;
+    temp.cmd_type = 3;
+    if (!sessions || !sessions->verify(token, unix_seconds(), temp.username) ||
+        temp.username.size() > protocol::MAX_NAME || !username_exists_in_db(temp.username)) {
+        loop_stats.auth_failed.add();
+        send_notice(fd, "Error: invalid or expired session token");
+        return;
+    }
+    begin_auth(fd, std::move(temp), log);
+}
+
+void TcpServer::bind_session(int fd, const std::string& name, std::string_view reply)
+{
+    Client& c = *clients.find(fd);
+    c.user_id = users.acquire(name);
+    index_session(c, fd);
+    presence_changed(name, 1);
+    if (cluster) cluster->presence(name, true);
+    join_channel(fd, DEFAULT_CHANNEL, false);
+    record_auth(c, true);
+    send_notice(fd, reply);
+
+    if (sessions && sessions->enabled()) {
+        send_notice(fd, std::string(protocol::SESSION_NOTICE) + sessions->issue(name, unix_seconds()));
+    }
+    replay_history(fd, DEFAULT_CHANNEL);
+}
+
+// Broadcast to the other members of the sender's current channel; each
+// encoding is built once and shared by reference across every queue —
+// locally and on the other reactors. DEFAULT_CHANNEL keeps the historical
+// "name: text" format.
+void TcpServer::broadcast_chat(int fd, std::string_view text, Logger& log)
+{
+    Client& sender = *clients.find(fd);
+
     // Require authentication before relaying anything.
-    if (clients[fd].username.empty())
+    if (sender.user_id == NO_USER)
+    {
+        send_notice(fd, "Error: please register or login first");
+        return;
+    }
+    if (sender.channels.empty())
     {
-        sendAll(fd, "Error: please register or login first\n");
+        send_notice(fd, "Error: you are not in any channel (/join #name)");
+        return;
+    }
+
+    const std::string_view name = users.name(sender.user_id);
+    const std::string  channel = sender.channels.back();
+
+    // Other reactors may have v2 clients even when this one has none, and
+    // a v2 client may log in later and get the history.
+    SharedPayload msg, frame, deflated;
+    encode_chat(channel, name, text, v2_clients || group || history.enabled(), msg, frame, deflated);
+
+    if (chat_log) {
+        if (chat_log->append(channel, name, text)) loop_stats.chat_log_appended.add();
+        else                                       loop_stats.chat_log_dropped.add();
+    }
+
+    loop_stats.messages_routed.add();
+    sender.messages_sent++;
+    broadcast_local(fd, channel, msg, frame, deflated, log);
+    if (group) group->broadcast(worker_id, channel, msg, frame, deflated);
+    if (cluster) cluster->relay(channel, name, text);
+}
+
+void TcpServer::encode_chat(const std::string& channel, std::string_view name, std::string_view text,
+                            bool with_frame, SharedPayload& line, SharedPayload& frame,
+                            SharedPayload& deflated)
+{
+    const bool plain = channel == DEFAULT_CHANNEL;
+
+    std::string out;
+    out.reserve(channel.size() + 3 + name.size() + 2 + text.size() + 1);
+    if (!plain) out.append("[").append(channel).append("] ");
+    out.append(name.data(), name.size()).append(": ").append(text.data(), text.size()).push_back('\n');
+    line = std::make_shared<const std::string>(std::move(out));
+
+    if (with_frame) {
+        frame = std::make_shared<const std::string>(
+            plain ? protocol::make_named_frame(protocol::Chat, name, text)
+                  : protocol::make_channel_frame(channel, name, text));
+
+        // Once for every compressing recipient, on any reactor or node link.
+        if (deflate_clients.load(std::memory_order_relaxed) > 0 && compress_offered.load(std::memory_order_relaxed) &&
+            frame->size() >= compress_min_bytes.load(std::memory_order_relaxed)) {
+            std::string packed = compression::compress_frame(*frame, compress_level.load(std::memory_order_relaxed));
+            if (!packed.empty()) deflated = std::make_shared<const std::string>(std::move(packed));
+        }
+    }
+}
+
+void TcpServer::set_compression(bool enabled, int min_bytes, int level)
+{
+    compress_offered.store(enabled, std::memory_order_relaxed);
+    compress_min_bytes.store(min_bytes > 0 ? size_t(min_bytes) : 0, std::memory_order_relaxed);
+    compress_level.store(level, std::memory_order_relaxed);
+}
+
+void TcpServer::set_memory_budgets(int input_mb, int output_mb)
+{
+    input_memory.set_limit(input_mb > 0 ? size_t(input_mb) << 20 : 0);
+    output_memory.set_limit(output_mb > 0 ? size_t(output_mb) << 20 : 0);
+}
+
+void TcpServer::set_recv_arena(int megabytes, bool huge_pages)
+{
+    recv_huge_pages = huge_pages;
+    recv_arena.reset();
+    if (megabytes <= 0) return;
+    try {
+        recv_arena = std::make_unique<RecvArena>(size_t(megabytes) << 20, huge_pages);
+    } catch (const std::exception& e) {
+        if (logger) logger->Write_log(std::string("Receive arena disabled: ") + e.what(), Logger::Warn);
+        return;
+    }
+    if (logger) {
+        logger->Write_log("Receive arena: up to " + std::to_string(megabytes) + " MiB of " +
+                              std::to_string(RecvArena::CHUNK_SIZE / 1024) + " KiB chunks on " +
+                              (recv_arena->huge_pages() ? "huge pages"
+                               : huge_pages             ? "regular pages (no huge pages reserved)"
+                                                        : "regular pages"),
+                          Logger::Info);
+    }
+}
+
+// ============================================================================
+// Channels
+// ============================================================================
+
+// Looks up "/cmd arg" and runs /join, /part, /channels, /history, /msg, /who or /resume.
+bool TcpServer::handle_command(int fd, std::string_view text, Logger& log)
+{
+    const commands::Match cmd = commands::lookup(text);
+    if (!cmd.entry || cmd.entry->where != commands::Server) return false;
+    std::string_view arg = trimBuffer(cmd.arg);
+
+    switch (cmd.id()) {
+    case commands::Register:
+    case commands::Login:
+        return false; // Malformed credentials (parse_credentials has seen the line): chat, as before
+    case commands::Resume:
+        resume_session(fd, arg, log);
+        return true;
+    default:
+        break;
+    }
+
+    if (clients.find(fd)->user_id == NO_USER) {
+        send_notice(fd, "Error: please register or login first");
+        return true;
+    }
+
+    switch (cmd.id()) {
+    case commands::Join:
+        if (arg.empty()) send_notice(fd, "Usage: /join #channel");
+        else             join_channel(fd, std::string(arg), true);
+        break;
+    case commands::Part:     part_channel(fd, std::string(arg)); break;
+    case commands::History:  send_log_history(fd, arg); break;
+    case commands::Msg:      send_direct(fd, arg, log); break;
+    case commands::Who:      send_presence(fd, arg); break;
+    default:                 send_channel_list(fd); break;
+    }
+    return true;
+}
+
+void TcpServer::join_channel(int fd, std::string name, bool announce)
+{
+    if (name[0] != '#') name.insert(name.begin(), '#');
+
+    bool valid = name.size() >= 2 && name.size() <= MAX_CHANNEL_NAME;
+    for (size_t i = 1; valid && i < name.size(); ++i) {
+        unsigned char ch = static_cast<unsigned char>(name[i]);
+        valid = std::isalnum(ch) || ch == '-' || ch == '_';
+    }
+    if (!valid) {
+        send_notice(fd, "Error: channel names are #, then up to " +
+                        std::to_string(MAX_CHANNEL_NAME - 1) + " letters, digits, '-' or '_'");
+        return;
+    }
+
+    Client& c = *clients.find(fd);
+    auto joined = std::find(c.channels.begin(), c.channels.end(), name);
+    if (joined != c.channels.end()) {
+        // Already a member: just make it the current channel.
+        const size_t i = static_cast<size_t>(joined - c.channels.begin());
+        const uint32_t slot = c.channel_slots[i];
+        c.channels.erase(joined);
+        c.channel_slots.erase(c.channel_slots.begin() + static_cast<std::ptrdiff_t>(i));
+        c.channels.push_back(name);
+        c.channel_slots.push_back(slot);
+        if (announce) send_notice(fd, "Now talking in " + name);
+        return;
+    }
+    if (c.channels.size() >= MAX_CHANNELS_PER_CLIENT) {
+        send_notice(fd, "Error: channel limit reached (" +
+                        std::to_string(MAX_CHANNELS_PER_CLIENT) + ")");
+        return;
+    }
+
+    std::vector<int>& members = channels[name].members;
+    c.channel_slots.push_back(static_cast<uint32_t>(members.size()));
+    members.push_back(fd);
+    c.channels.push_back(name);
+    if (group) group->channel_joined(name);
+    if (announce) {
+        send_notice(fd, "Joined " + name);
+        if (!history.global()) replay_history(fd, name); // Global: replayed at login
+    }
+}
+
+void TcpServer::part_channel(int fd, std::string name)
+{
+    Client& c = *clients.find(fd);
+    if (name.empty() && !c.channels.empty()) name = c.channels.back();
+    if (!name.empty() && name[0] != '#') name.insert(name.begin(), '#');
+
+    auto joined = std::find(c.channels.begin(), c.channels.end(), name);
+    if (name.empty() || joined == c.channels.end()) {
+        send_notice(fd, "Error: not in channel " + (name.empty() ? std::string("(none)") : name));
+        return;
+    }
+    leave_channel_at(c, static_cast<size_t>(joined - c.channels.begin()));
+
+    send_notice(fd, c.channels.empty() ? "Left " + name
+                                       : "Left " + name + ", now talking in " + c.channels.back());
+}
+
+void TcpServer::leave_all_channels(Client& c)
+{
+    while (!c.channels.empty()) leave_channel_at(c, c.channels.size() - 1);
+}
+
+void TcpServer::leave_channel_at(Client& c, size_t i)
+{
+    const std::string name = std::move(c.channels[i]);
+    const uint32_t slot    = c.channel_slots[i];
+    c.channels.erase(c.channels.begin() + static_cast<std::ptrdiff_t>(i));
+    c.channel_slots.erase(c.channel_slots.begin() + static_cast<std::ptrdiff_t>(i));
+
+    auto ch = channels.find(name);
+    if (ch != channels.end()) {
+        std::vector<int>& members = ch->second.members;
+        if (slot < members.size() && members[slot] == c.fd) {
+            // The last member takes the freed slot; its own record of the
+            // slot is found among its (at most MAX_CHANNELS_PER_CLIENT) channels.
+            const int moved = members.back();
+            members[slot]   = moved;
+            members.pop_back();
+            if (moved != c.fd) {
+                Client& m = *clients.find(moved);
+                auto at = std::find(m.channels.begin(), m.channels.end(), name);
+                m.channel_slots[static_cast<size_t>(at - m.channels.begin())] = slot;
+            }
+        }
+        if (members.empty()) channels.erase(ch);
+    }
+    if (group) group->channel_left(name);
+}
+
+// Network-wide counts from the group directory, or the local index.
+void TcpServer::send_channel_list(int fd)
+{
+    std::vector<std::pair<std::string, size_t>> list;
+    if (group) {
+        list = group->channel_list();
+    } else {
+        for (const auto& [name, ch] : channels) list.emplace_back(name, ch.members.size());
+        std::sort(list.begin(), list.end());
+    }
+
+    if (list.empty()) {
+        send_notice(fd, "Channels: none");
+        return;
+    }
+
+    std::string reply = "Channels:";
+    for (size_t i = 0; i < list.size(); ++i) {
+        reply.append(i ? ", " : " ").append(list[i].first)
+             .append(" (").append(std::to_string(list[i].second)).append(")");
+    }
+    send_notice(fd, reply);
+}
+
+// The records are formatted straight from the log's mapping into one
+// reply. The log reads only the index blocks whose channel filter may
+// hold the channel, up to its scan limit (ChatLog::Options::max_scan_bytes).
+void TcpServer::send_log_history(int fd, std::string_view arg)
+{
+    Client& c = *clients.find(fd);
+    if (!chat_log) {
+        send_notice(fd, "Error: this server keeps no chat log");
+        return;
+    }
+    if (c.channels.empty()) {
+        send_notice(fd, "Error: you are not in any channel (/join #name)");
+        return;
+    }
+
+    // "" | "<n>" | "since <unix seconds>"
+    auto parse_number = [](std::string_view s, uint64_t& out) {
+        if (s.empty() || s.size() > 15) return false;
+        out = 0;
+        for (char ch : s) {
+            if (ch < '0' || ch > '9') return false;
+            out = out * 10 + static_cast<uint64_t>(ch - '0');
+        }
         return true;
+    };
+    const bool since = arg.substr(0, 6) == "since ";
+    uint64_t n = since ? history_query_max : 20, since_s = 0;
+    if ((since && !parse_number(trimBuffer(arg.substr(6)), since_s)) ||
+        (!since && !arg.empty() && (!parse_number(arg, n) || n == 0))) {
+        send_notice(fd, "Usage: /history [count] | /history since <unix time>");
+        return;
+    }
+    n = std::min<uint64_t>(n, history_query_max);
+
+    const std::string& channel = c.channels.back();
+    const bool plain = channel == DEFAULT_CHANNEL;
+    const bool v2    = c.protocol == protocol::Version::V2;
+    std::string out;
+    auto format = [&](const ChatLog::Message& m) {
+        if (v2) {
+            out += plain ? protocol::make_named_frame(protocol::Chat, m.author, m.text)
+                         : protocol::make_channel_frame(channel, m.author, m.text);
+            return;
+        }
+        if (!plain) out.append("[").append(channel).append("] ");
+        out.append(m.author.data(), m.author.size()).append(": ");
+        out.append(m.text.data(), m.text.size()).push_back('\n');
+    };
+    const size_t found = since ? chat_log->since(channel, static_cast<int64_t>(since_s) * 1000, n, format)
+                               : chat_log->last(channel, n, format);
+
+    send_notice(fd, found == 0 ? "History of " + channel + ": no messages"
+                               : "History of " + channel + ": " + std::to_string(found) +
+                                     (found == 1 ? " message" : " messages"));
+    if (out.empty()) return;
+    if (v2 && c.deflate) send_frames(c, std::move(out));
+    else                 sendAll(fd, out);
+}
+
+// The entries are the payloads the original broadcast queued everywhere;
+// only the references are appended, and the next flush (or SEND batch)
+// writes them out with whatever else is queued.
+void TcpServer::replay_history(int fd, const std::string& channel)
+{
+    Client& c = *clients.find(fd);
+    const bool v2 = c.protocol == protocol::Version::V2;
+    uint64_t replayed = 0;
+
+    // Compressing client: the whole replay is packed into a few Compressed
+    // frames (runs of lines share one DEFLATE window) instead.
+    if (v2 && c.deflate) {
+        std::string frames;
+        history.replay(channel, [&](const MessageHistory::Entry& e) {
+            frames += *e.frame;
+            ++replayed;
+        });
+        if (!frames.empty()) send_frames(c, std::move(frames));
+        loop_stats.history_replayed.add(replayed);
+        return;
+    }
+
+    history.replay(channel, [&](const MessageHistory::Entry& e) {
+        if (uring) queue_ring_send(c, v2 ? e.frame : e.line);
+        else       queue_coalesced(c, v2 ? e.frame : e.line);
+        ++replayed;
+    });
+    loop_stats.history_replayed.add(replayed);
+}
+
+void TcpServer::send_frames(Client& c, std::string frames)
+{
+    std::string out;
+    out.reserve(frames.size());
+    const size_t saved = compression::append_frames(out, frames, compress_min_bytes.load(std::memory_order_relaxed),
+                                                    compress_level.load(std::memory_order_relaxed));
+    if (saved) {
+        loop_stats.deflated_frames.add();
+        loop_stats.deflate_saved_bytes.add(saved);
+    }
+    auto payload = std::make_shared<const std::string>(std::move(out));
+    if (uring) queue_ring_send(c, std::move(payload));
+    else       queue_coalesced(c, std::move(payload));
+}
+
+// Status and error replies, worded identically for both protocols.
+int TcpServer::send_notice(int fd, std::string_view text)
+{
+    Client* client = clients.find(fd);
+    if (client && client->protocol == protocol::Version::V2) {
+        return sendAll(fd, protocol::make_frame(protocol::Notice, text));
     }
 
-    // Broadcast to every OTHER client; collect failed fds for cleanup.
-    std::string msg = clients[fd].username + ": " + std::string(buffer) + "\n";
+    std::string line;
+    line.reserve(text.size() + 1);
+    line.append(text.data(), text.size()).push_back('\n');
+    return sendAll(fd, line);
+}
+
+// Fan-out to this reactor's clients; failed fds are torn down afterwards.
+void TcpServer::broadcast_local(int except_fd, const std::string& channel,
+                                const SharedPayload& line, const SharedPayload& frame,
+                                const SharedPayload& deflated, Logger& log)
+{
+    // Kept even without local members: someone may join later.
+    if (history.enabled() && frame) {
+        history.record(channel, line, frame);
+        loop_stats.history_bytes.set(static_cast<int64_t>(history.bytes()));
+    }
+
+    auto ch = channels.find(channel);
+    if (ch == channels.end()) return; // No local members
+
     std::vector<int> to_disconnect;
+    uint64_t recipients = 0, deflated_sent = 0;
 
-    for (auto& [client_fd, client_data] : clients)
+    for (int client_fd : ch->second.members)
     {
-        if (client_fd == fd) continue; // Don't echo back to sender
-        if (sendAll(client_fd, msg) == -1) {
+        if (client_fd == except_fd) continue; // Don't echo back to sender
+        Client* member = clients.find(client_fd);
+        if (!member) continue;
+        const bool v2 = member->protocol == protocol::Version::V2;
+        if (v2 && !frame) continue;            // Can't happen: frame built whenever v2_clients > 0
+        const bool packed = v2 && deflated && member->deflate;
+        if (sendAll(client_fd, packed ? deflated : v2 ? frame : line, true) == -1) {
             to_disconnect.push_back(client_fd); // Dead peer — clean up after loop
         }
+        ++recipients;
+        deflated_sent += packed;
     }
+    loop_stats.fanout.record(recipients);
+    if (deflated_sent) {
+        loop_stats.deflated_frames.add(deflated_sent);
+        loop_stats.deflate_saved_bytes.add(deflated_sent * (frame->size() - deflated->size()));
+    }
+
+    // Deferred teardown: avoids mutating the map mid-iteration.
+    for (int disc_fd : to_disconnect) {
+        char ip[INET6_ADDRSTRLEN];
+        log.Write_log(Logger::Warn, client_event("send_error", disc_fd, ip),
+                      "Disconnected client fd=", disc_fd, " due to send error");
+        disconnect_client(disc_fd, metrics::DisconnectReason::SendError);
+    }
+}
+
+// ============================================================================
+// Direct messages — /msg routed by username
+// ============================================================================
+
+void TcpServer::index_session(const Client& c, int fd)
+{
+    if (c.user_id >= session_fds.size()) session_fds.resize(c.user_id + 1, -1);
+    session_fds[c.user_id] = fd;
+}
+
+// The recipient's reactor is found without a broadcast: its own session
+// index first, then the shard that claimed the name (which recorded the
+// claiming worker), so a message takes at most two mailbox hops.
+void TcpServer::send_direct(int fd, std::string_view arg, Logger& log)
+{
+    const size_t space = arg.find(' ');
+    std::string_view text = space == std::string_view::npos ? std::string_view{} : trimBuffer(arg.substr(space + 1));
+    if (text.empty()) {
+        send_notice(fd, "Usage: /msg <user> <text>");
+        return;
+    }
+    // As for a v2 Chat frame: a v2 Command frame may hold a newline, which
+    // would forge extra lines for a v1 recipient.
+    if (std::memchr(text.data(), '\n', text.size())) {
+        send_notice(fd, "Error: invalid private message");
+        return;
+    }
+
+    Client& sender = *clients.find(fd);
+    const std::string to(arg.substr(0, space));
+    const std::string_view from = users.name(sender.user_id);
+    sender.messages_sent++;
+    if (deliver_direct(to, from, text, log)) return;
+
+    auto* msg          = new MailboxMessage;
+    msg->type          = MailboxMessage::DirectMessage;
+    msg->origin_worker = worker_id;
+    msg->origin_fd     = fd;
+    msg->conn_id       = sender.conn_id;
+    msg->username      = to;
+    msg->author.assign(from.data(), from.size());
+    msg->text.assign(text.data(), text.size());
+    route_direct(msg, log);
+}
+
+void TcpServer::route_direct(MailboxMessage* msg, Logger& log)
+{
+    if (deliver_direct(msg->username, msg->author, msg->text, log)) {
+        delete msg;
+        return;
+    }
+
+    // Not here and not the shard: ask it.
+    if (!msg->ok && group && group->owner_of(msg->username) != worker_id) {
+        group->post(group->owner_of(msg->username), msg);
+        return;
+    }
+
+    // The shard: forward once to the worker holding the session. A session
+    // still authenticating there isn't bound yet; it fails below instead of
+    // bouncing back.
+    if (!msg->ok) {
+        const UserId id = users.find(msg->username);
+        auto owner = id == NO_USER ? usernames.end() : usernames.find(id);
+        if (owner != usernames.end() && owner->second != worker_id) {
+            msg->ok = true;
+            group->post(owner->second, msg);
+            return;
+        }
+        // Another node (only for local senders: relayed ones were sent
+        // because their node saw the name here).
+        if (msg->origin_fd != -1 && cluster && cluster->online_elsewhere(msg->username)) {
+            cluster->relay("@" + msg->username, msg->author, msg->text);
+            delete msg;
+            return;
+        }
+    }
+
+    loop_stats.direct_failed.add();
+    if (msg->origin_fd == -1 || msg->origin_worker == worker_id) {
+        Client* sender = msg->origin_fd == -1 ? nullptr : clients.find(msg->origin_fd);
+        if (sender && sender->conn_id == msg->conn_id) {
+            send_notice(msg->origin_fd, "Error: " + msg->username + " is not online");
+        }
+        delete msg;
+        return;
+    }
+    msg->type = MailboxMessage::DirectFailed;
+    group->post(msg->origin_worker, msg);
+}
+
+bool TcpServer::deliver_direct(const std::string& name, std::string_view author, std::string_view text, Logger& log)
+{
+    const UserId id = users.find(name);
+    if (id == NO_USER || id >= session_fds.size() || session_fds[id] == -1) return false;
+
+    const int fd   = session_fds[id];
+    Client& target = *clients.find(fd);
+    std::string out;
+    if (target.protocol == protocol::Version::V2) {
+        out = protocol::make_named_frame(protocol::Private, author, text);
+    } else {
+        out.reserve(10 + author.size() + 2 + text.size() + 1);
+        out.append("[private] ").append(author.data(), author.size()).append(": ");
+        out.append(text.data(), text.size()).push_back('\n');
+    }
+    loop_stats.direct_delivered.add();
+    if (sendAll(fd, out) == -1) {
+        char ip[INET6_ADDRSTRLEN];
+        log.Write_log(Logger::Warn, client_event("send_error", fd, ip),
+                      "Disconnected client fd=", fd, " due to send error");
+        disconnect_client(fd, metrics::DisconnectReason::SendError);
+    }
+    return true;
+}
+
+// ============================================================================
+// Presence — /who snapshots and per-iteration deltas
+// ============================================================================
+
+namespace {
+
+// Presence lines stay well under a v2 frame: a long list or a login storm
+// goes out as several of them.
+constexpr size_t PRESENCE_CHUNK_BYTES = 4000;
+
+} // namespace
+
+void TcpServer::presence_changed(const std::string& name, int delta)
+{
+    presence_apply(name, delta);
+    if (group) (delta > 0 ? presence_joined : presence_left).push_back(name);
+}
+
+// Counts, not flags: a user moving from one reactor to another can be
+// seen joining on the second before leaving the first, and the count
+// simply goes through 2. Each peer's batches arrive in order, so it
+// never goes below 0 for long enough to be published.
+void TcpServer::presence_apply(const std::string& name, int delta)
+{
+    UserId id = users.find(name);
+    auto entry = id == NO_USER ? presence.end() : presence.find(id);
+    if (entry == presence.end()) {
+        id    = users.acquire(name);
+        entry = presence.emplace(id, PresenceEntry{}).first;
+    }
+    entry->second.sessions += delta;
+    if (!entry->second.touched) {
+        entry->second.touched = true;
+        presence_touched.push_back(id);
+    }
+}
+
+// "Online v<version> (<count>): name name ...", split over several lines
+// when long; every line repeats the header, so a client knows it has the
+// whole list once it counted <count> names. The deltas that follow are
+// numbered from <version> + 1.
+void TcpServer::send_presence(int fd, std::string_view arg)
+{
+    Client& c = *clients.find(fd);
+    if (arg == "off") {
+        if (c.presence_sub) unsubscribe_presence(c);
+        send_notice(fd, "Presence updates off");
+        return;
+    }
+    if (!arg.empty()) {
+        send_notice(fd, "Usage: /who [off]");
+        return;
+    }
+
+    // `announced`, not `sessions`: the state as of presence_version, which
+    // the deltas of this iteration haven't moved past yet.
+    std::vector<std::string_view> online;
+    online.reserve(presence.size());
+    for (const auto& [id, entry] : presence) {
+        if (entry.announced) online.push_back(users.name(id));
+    }
+    std::sort(online.begin(), online.end());
+
+    const std::string header =
+        "Online v" + std::to_string(presence_version) + " (" + std::to_string(online.size()) + "):";
+    std::string text = header;
+    for (std::string_view name : online) {
+        if (text.size() + 1 + name.size() > PRESENCE_CHUNK_BYTES && text.size() > header.size()) {
+            send_notice(fd, text);
+            text = header;
+        }
+        text.append(" ").append(name.data(), name.size());
+    }
+    send_notice(fd, text);
+
+    if (!c.presence_sub) {
+        c.presence_sub  = true;
+        c.presence_slot = static_cast<uint32_t>(presence_subscribers.size());
+        presence_subscribers.push_back(fd);
+    }
+}
+
+void TcpServer::unsubscribe_presence(Client& c)
+{
+    const int moved = presence_subscribers.back();
+    presence_subscribers[c.presence_slot] = moved;
+    presence_subscribers.pop_back();
+    if (moved != c.fd) clients.find(moved)->presence_slot = c.presence_slot;
+    c.presence_sub = false;
+}
+
+// "Presence v<version>: +joined -left ...". One version per line: a
+// client that sees a gap (or any line after reconnecting) sends /who
+// again and starts over from that snapshot.
+void TcpServer::process_presence(Logger& log)
+{
+    if (group && (!presence_joined.empty() || !presence_left.empty())) {
+        for (size_t worker = 0; worker < group->size(); ++worker) {
+            if (worker == worker_id) continue;
+            auto* msg          = new MailboxMessage;
+            msg->type          = MailboxMessage::PresenceDelta;
+            msg->origin_worker = worker_id;
+            msg->joined        = presence_joined;
+            msg->left          = presence_left;
+            group->post(worker, msg);
+        }
+        presence_joined.clear();
+        presence_left.clear();
+    }
+    if (presence_touched.empty()) return;
+
+    std::vector<std::string> deltas;
+    std::string text;
+    for (UserId id : presence_touched) {
+        auto entry = presence.find(id);
+        entry->second.touched = false;
+        const bool online     = entry->second.sessions > 0;
+        if (online != entry->second.announced) {
+            entry->second.announced = online;
+            if (!presence_subscribers.empty()) {
+                const std::string_view name = users.name(id);
+                if (text.size() + 2 + name.size() > PRESENCE_CHUNK_BYTES) {
+                    deltas.push_back(std::move(text));
+                    text.clear();
+                }
+                if (text.empty()) text = "Presence v";
+                text.append(online ? " +" : " -").append(name.data(), name.size());
+            } else if (deltas.empty()) {
+                deltas.emplace_back(); // Nobody listens: one version step, nothing built
+            }
+        }
+        if (!online && !entry->second.announced) {
+            presence.erase(entry);
+            users.release(id);
+        }
+    }
+    presence_touched.clear();
+    if (!text.empty()) deltas.push_back(std::move(text));
+
+    std::vector<int> to_disconnect;
+    for (std::string& delta : deltas) {
+        ++presence_version;
+        if (delta.empty()) continue;
+        delta.insert(10, std::to_string(presence_version) + ":");
+        const SharedPayload line  = std::make_shared<const std::string>(delta + "\n");
+        const SharedPayload frame = v2_clients ? std::make_shared<const std::string>(
+                                                     protocol::make_frame(protocol::Notice, delta))
+                                               : nullptr;
+        for (int fd : presence_subscribers) {
+            const bool v2 = clients.find(fd)->protocol == protocol::Version::V2;
+            if (sendAll(fd, v2 ? frame : line) == -1) to_disconnect.push_back(fd);
+        }
+        loop_stats.presence_deltas.add();
+    }
+
+    std::sort(to_disconnect.begin(), to_disconnect.end());
+    to_disconnect.erase(std::unique(to_disconnect.begin(), to_disconnect.end()), to_disconnect.end());
+    for (int fd : to_disconnect) {
+        char ip[INET6_ADDRSTRLEN];
+        log.Write_log(Logger::Warn, client_event("send_error", fd, ip),
+                      "Disconnected client fd=", fd, " due to send error");
+        disconnect_client(fd, metrics::DisconnectReason::SendError);
+    }
+}
+
+// ============================================================================
+// Username claims — session uniqueness across reactors
+// ============================================================================
+
+// Single reactor (or own shard): decide immediately via `usernames`.
+// Otherwise ask the owning worker; its ClaimResult lands in drain_mailbox().
+void TcpServer::claim_username(int fd, const std::string& name)
+{
+    const Client& c = *clients.find(fd);
+
+    if (cluster && cluster->online_elsewhere(name)) {
+        on_claim_result(fd, c.conn_id, name, false);
+        return;
+    }
+    if (!group || group->owner_of(name) == worker_id) {
+        bool ok = shard_claim(name, worker_id);
+        on_claim_result(fd, c.conn_id, name, ok);
+        return;
+    }
+
+    auto* msg          = new MailboxMessage;
+    msg->type          = MailboxMessage::ClaimUsername;
+    msg->origin_worker = worker_id;
+    msg->origin_fd     = fd;
+    msg->conn_id       = c.conn_id;
+    msg->username      = name;
+    group->post(group->owner_of(name), msg);
+}
+
+// Frees the shard entry for `name`, wherever that shard lives.
+void TcpServer::release_username(const std::string& name)
+{
+    if (!group || group->owner_of(name) == worker_id) {
+        shard_release(name);
+        return;
+    }
+
+    auto* msg          = new MailboxMessage;
+    msg->type          = MailboxMessage::ReleaseUsername;
+    msg->origin_worker = worker_id;
+    msg->username      = name;
+    group->post(group->owner_of(name), msg);
+}
+
+bool TcpServer::shard_claim(const std::string& name, size_t worker)
+{
+    UserId id = users.acquire(name);
+    if (usernames.emplace(id, worker).second) return true;
+    users.release(id); // Already online: drop the extra reference
+    return false;
+}
+
+void TcpServer::shard_release(const std::string& name)
+{
+    UserId id = users.find(name);
+    if (id != NO_USER && usernames.erase(id)) users.release(id);
+}
+
+// Hands the shard's decision to the waiting task. A stale answer (client
+// gone, fd reused) gives a granted claim straight back.
+void TcpServer::on_claim_result(int fd, uint64_t conn_id, const std::string& name, bool ok)
+{
+    if (!resume_auth(fd, conn_id, {ok, {}}) && ok) release_username(name);
+}
+
+void TcpServer::on_auth_complete(const MailboxMessage& msg)
+{
+    // A copy: the hash is the only big field, and the message is freed
+    // once drained.
+    if (!resume_auth(msg.origin_fd, msg.conn_id, {msg.ok, msg.password_hash})) {
+        release_username(msg.username); // Client left while hashing
+    }
+}
+
+// The session is already bound; this only touches the store. A failed
+// swap is not an error: the account was rehashed (or removed) meanwhile.
+void TcpServer::on_password_rehashed(const MailboxMessage& msg, Logger& log)
+{
+    if (!credentials().replace_hash(msg.username, msg.stored_hash, msg.password_hash)) return;
+    loop_stats.password_rehashes.add();
+    log.Write_log("Password of " + msg.username + " rehashed (" + password::describe_cost() + ")",
+                  Logger::Info);
+}
+
+// Closes one auth attempt in the metrics (latency since begin_auth()).
+void TcpServer::record_auth(const Client& c, bool ok)
+{
+    const uint64_t latency_us = monotonic_us() - c.auth_started_us;
+    loop_stats.auth_latency_us.record(latency_us);
+    (ok ? loop_stats.auth_ok : loop_stats.auth_failed).add();
+    TRACE_3(auth_done, c.fd, ok, latency_us);
+}
+
+// Handles everything other reactors posted since the last wake-up.
+void TcpServer::drain_mailbox(Logger& log)
+{
+    Mailbox& box = inbox();
+    box.begin_drain();
+
+    while (MailboxMessage* msg = box.pop())
+    {
+        switch (msg->type)
+        {
+            case MailboxMessage::Broadcast:
+                broadcast_local(-1, msg->channel, msg->payload, msg->frame, msg->deflated, log); // Sender lives elsewhere
+                break;
+
+            case MailboxMessage::ClaimUsername: {
+                // We own this shard: decide, then reuse the envelope as reply.
+                msg->ok   = shard_claim(msg->username, msg->origin_worker);
+                msg->type = MailboxMessage::ClaimResult;
+                size_t reply_to    = msg->origin_worker;
+                msg->origin_worker = worker_id;
+                group->post(reply_to, msg);
+                continue; // Ownership moved to the reply mailbox
+            }
+
+            case MailboxMessage::ClaimResult:
+                on_claim_result(msg->origin_fd, msg->conn_id, msg->username, msg->ok);
+                break;
+
+            case MailboxMessage::ReleaseUsername:
+                shard_release(msg->username);
+                break;
+
+            case MailboxMessage::AuthComplete:
+                on_auth_complete(*msg);
+                break;
+
+            case MailboxMessage::PasswordRehashed:
+                on_password_rehashed(*msg, log);
+                break;
+
+            case MailboxMessage::KickUser:
+                kick_user(msg->username, log);
+                break;
+
+            case MailboxMessage::DirectMessage:
+                route_direct(msg, log);
+                continue; // Forwarded or freed by route_direct()
+
+            case MailboxMessage::DirectFailed: {
+                Client* sender = clients.find(msg->origin_fd);
+                if (sender && sender->conn_id == msg->conn_id) {
+                    send_notice(msg->origin_fd, "Error: " + msg->username + " is not online");
+                }
+                break;
+            }
+
+            case MailboxMessage::AdminQuery:
+                answer_admin_query(*msg->query, log);
+                break;
+
+            case MailboxMessage::PresenceDelta:
+                for (const std::string& name : msg->joined) presence_apply(name, 1);
+                for (const std::string& name : msg->left) presence_apply(name, -1);
+                break;
+        }
+        delete msg;
+    }
+}
+
+// Everything is copied out here, on the loop thread; the AdminChannel
+// thread formats it. `limit` bounds the rows, so the cost of a listing is
+// one walk of `clients` plus a few strings per shown connection.
+void TcpServer::answer_admin_query(AdminQuery& q, Logger& log)
+{
+    AdminQuery::Part part;
+    part.reactor      = worker_id;
+    part.clients      = clients.size();
+    part.v2_clients   = v2_clients;
+    part.shard_names  = usernames.size();
+    part.queued_bytes = static_cast<size_t>(loop_stats.output_queue_bytes.value());
+    part.input_bytes  = static_cast<size_t>(loop_stats.input_buffer_bytes.value());
+    part.accepted     = loop_stats.accepted.value();
+    part.messages     = loop_stats.messages_routed.value();
+
+    const uint64_t now = monotonic_ms();
+    auto row = [&](int fd, const Client& c) {
+        AdminQuery::ClientRow r;
+        r.reactor      = worker_id;
+        r.fd           = fd;
+        r.peer         = c.local_peer ? "uid " + std::to_string(c.peer_uid)
+                                  : c.ip_key.to_string() + ":" + std::to_string(c.port);
+        if (c.user_id != NO_USER) r.user = users.name(c.user_id);
+        if (!c.channels.empty()) r.channel = c.channels.back();
+        r.protocol     = c.protocol == protocol::Version::V2 ? "v2"
+                       : c.protocol == protocol::Version::V1 ? "v1" : "?";
+        r.tls          = c.tls || c.ktls_rx;
+        r.connected_s  = (now - std::min(now, c.connected_ms)) / 1000;
+        r.idle_ms      = now - std::min(now, c.last_activity_ms);
+        r.queued_bytes = c.queued_bytes;
+        r.messages     = c.messages_sent;
+        return r;
+    };
+
+    switch (q.kind) {
+        case AdminQuery::Stats:
+            clients.for_each([&](int, const Client& c) {
+                if (c.user_id != NO_USER) part.sessions++;
+                if (c.auth_pending) part.pending_auth++;
+            });
+            break;
+
+        case AdminQuery::Clients:
+            clients.for_each([&](int fd, const Client& c) {
+                if (part.rows.size() < q.limit) part.rows.push_back(row(fd, c));
+            });
+            break;
+
+        case AdminQuery::TopSenders: {
+            std::vector<std::pair<uint64_t, int>> senders;
+            senders.reserve(clients.size());
+            clients.for_each([&](int fd, const Client& c) {
+                if (c.messages_sent) senders.emplace_back(c.messages_sent, fd);
+            });
+            const size_t n = std::min(q.limit, senders.size());
+            std::partial_sort(senders.begin(), senders.begin() + n, senders.end(),
+                              [](const auto& a, const auto& b) { return a.first > b.first; });
+            for (size_t i = 0; i < n; ++i) part.rows.push_back(row(senders[i].second, *clients.find(senders[i].second)));
+            break;
+        }
+
+        case AdminQuery::Ips:
+            part.ips.assign(connections_per_ip.begin(), connections_per_ip.end());
+            break;
+
+        case AdminQuery::Kick: {
+            const UserId id = users.find(q.user);
+            if (id != NO_USER && id < session_fds.size() && session_fds[id] != -1) {
+                const int victim = session_fds[id];
+                send_notice(victim, "Error: disconnected by an operator");
+                disconnect_client(victim, metrics::DisconnectReason::Kicked);
+                part.kicked = 1;
+            }
+            break;
+        }
+
+        case AdminQuery::Drain:
+            if (draining != q.drain) {
+                draining = q.drain;
+                log.Write_log(std::string("Reactor ") + std::to_string(worker_id) +
+                                  (draining ? ": draining, new connections are refused"
+                                            : ": accepting new connections again"),
+                              Logger::Info);
+            }
+            break;
+    }
+    part.draining = draining;
+    q.answer(std::move(part));
+}
+
+// The cluster settled a login race against this node: end the local
+// session of `name`, if it lives on this reactor.
+void TcpServer::kick_user(const std::string& name, Logger& log)
+{
+    const UserId id = users.find(name);
+    if (id == NO_USER || id >= session_fds.size() || session_fds[id] == -1) return;
+    const int victim = session_fds[id];
+
+    send_notice(victim, "Error: logged in on another server");
+    char ip[INET6_ADDRSTRLEN];
+    Logger::Event event = client_event("kick", victim, ip); // Before the client is gone
+    event.username = name; // users' copy may go with the session
+    disconnect_client(victim, metrics::DisconnectReason::LoggedInElsewhere);
+    log.Write_log(Logger::Warn, event, "Session of ", name, " ended: logged in on another node");
+}
+
+// Records which group this reactor belongs to; the mailbox eventfd is
+// registered with epoll in run().
+void TcpServer::attach_group(ReactorGroup* _group, size_t id)
+{
+    group     = _group;
+    worker_id = id;
+    if (group) group->attach(id, this);
+}
+
+// Milliseconds since an arbitrary epoch; never jumps with wall-clock changes.
+uint64_t TcpServer::monotonic_ms()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t TcpServer::monotonic_us()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t TcpServer::unix_seconds()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<seconds>(system_clock::now().time_since_epoch()).count());
+}
 
-    // Deferred teardown: avoids mutating the map mid-iteration.
-    for (int disc_fd : to_disconnect) {
-        log.Write_log("Disconnected client fd=" + std::to_string(disc_fd) +
-                      " due to send error", Logger::Warn);
-        disconnect_client(disc_fd);
+// Runs once per loop iteration. Only timers whose bucket is due are touched;
+// everything expired in this pass is handled as one batch.
+void TcpServer::process_timers(Logger& log)
+{
+    expired_timers.clear();
+    if (timers.advance(loop_now_ms, expired_timers) == 0) return;
+
+    // Owners are read while every expired timer is still alive: a handler
+    // below may disconnect (and so free) the client of a later entry. From
+    // then on a timer is only reached through its client, once the fd is
+    // known to still hold the same connection.
+    expired_clients.clear();
+    for (TimerWheel::Timer* t : expired_timers) {
+        const int fd = static_cast<int>(t->owner);
+        const Client* client = clients.find(fd);
+        if (client && &client->idle_timer == t) expired_clients.emplace_back(fd, client->conn_id);
     }
 
-    return true;
+    for (const auto& [fd, conn_id] : expired_clients) {
+        Client* client = clients.find(fd);
+        if (!client || client->conn_id != conn_id || client->idle_timer.armed()) continue; // Gone, or re-armed
+        TimerWheel::Timer& t = client->idle_timer;
+
+        if (t.kind == IdleTimer) {
+            if (idle_timeout_ms == 0) continue; // Disabled by a reload meanwhile
+            uint64_t idle = loop_now_ms - client->last_activity_ms;
+            if (idle < idle_timeout_ms) {
+                // Active since the timer was armed: push the deadline out.
+                timers.schedule(t, idle_timeout_ms - idle);
+                continue;
+            }
+
+            char ip[INET6_ADDRSTRLEN];
+            log.Write_log(Logger::Info, client_event("idle_timeout", fd, ip),
+                          "Idle timeout: disconnecting fd=", fd, " after ", idle / 1000, 's');
+            send_notice(fd, "[ERROR]: Disconnected after " + std::to_string(idle_timeout_ms / 1000) +
+                            "s of inactivity");
+            disconnect_client(fd, metrics::DisconnectReason::IdleTimeout);
+        }
+    }
 }
 
+
 // ============================================================================
 // run (Main Event Loop)
-// Loads config, spins up epoll, and processes events until
+// Spins up epoll (or io_uring) and processes events until
 // SERVER_IS_RUNNING is flipped false (typically by a signal handler).
+// Logs through the attached Logger — the one main() built from the config.
 // ============================================================================
 void TcpServer::run()
 {
-    // Load runtime config from disk; fatal if missing.
-    ServerConfig config;
-    if (!config.Load("/etc/tcpserver/Config_file.ini")) {
-        std::cerr << "Fatal: Failed to load configuration file." << std::endl;
-        exit(EXIT_FAILURE);
+    if (!logger) {
+        ServerConfig console_only;
+        console_only.Run_without_logging = true;
+        own_logger = std::make_unique<Logger>(console_only);
+        logger = own_logger.get();
+    }
+    Logger& log = *logger;
+
+    // The ring is created here, on the thread that will drive it.
+    if (backend == EventBackend::IoUring) {
+        try {
+            uring = std::make_unique<IoUring>(URING_ENTRIES, URING_BUFFERS, URING_BUFFER_SIZE, recv_huge_pages);
+        } catch (const std::exception& e) {
+            log.Write_log(std::string("io_uring unavailable (") + e.what() +
+                          "); falling back to epoll", Logger::Warn);
+        }
+    }
+
+    if (uring) run_uring(log);
+    else       run_epoll(log);
+
+    // Paused for a hot upgrade: the connections belong to the handoff now.
+    if (keep_clients.load() && !uring) {
+        log.Write_log("Event loop paused for handoff with " + std::to_string(clients.size()) +
+                      " clients", Logger::Info);
+        return;
+    }
+
+    // Loop exited (flag flipped by a signal). Teardown runs HERE, in normal
+    // context — safe to touch maps, close fds and log. The signal handler
+    // itself only set the atomic flag.
+    shutdownActiveClients();
+    if (uring) {
+        // Let the kernel finish (fail) the sends of the sockets just shut
+        // down before their payloads are freed; bounded so exit can't hang.
+        for (int i = 0; i < 20 && !orphaned_sends.empty(); ++i) {
+            if (!uring->submit_and_wait(50)) break;
+            uring->for_each_cqe([&](const io_uring_cqe& cqe) { handle_completion(cqe, log); });
+        }
+        uring.reset();
+        orphaned_sends.clear();
     }
+    if (logger) {
+        logger->Write_log("Event loop exited; active clients shut down.", Logger::Info);
+    }
+}
 
-    Logger log(config);   // Local logger bound to loaded config
+// run_epoll — readiness loop: epoll_wait() + accept/recv/writev per event.
+void TcpServer::run_epoll(Logger& log)
+{
     initialize_epoll();   // Arm the epoll instance
+    accept_paused  = false; // A fresh epoll instance watches the listener again
+    overload_stage = 0;
+
+    // Cross-reactor messages and CryptoPool results wake us through the
+    // mailbox eventfd.
+    const int mailbox_fd = inbox().fd();
+    add_to_epoll(mailbox_fd, EPOLLIN);
+    watch_existing_clients(log);
 
-    struct epoll_event events[MAX_EVENTS]; // Ready-events output array
+    std::vector<epoll_event> events(static_cast<size_t>(epoll_batch)); // Ready-events output array
+    uint64_t interrupted_late_us = 0; // Lateness of waits cut short by EINTR (SIGSTOP/SIGCONT...)
 
-    std::cout << "Server running with epoll...\n";
+    std::cout << "Server running with epoll (" << (edge_triggered ? "edge" : "level")
+              << "-triggered clients" << (coalesce_writes ? ", coalesced writes" : "") << ")...\n";
 
     while (SERVER_IS_RUNNING.load())  // atomic read each iteration
     {
+        poll_config(log);
+
         // Block up to 1000ms; timeout lets us re-check SERVER_IS_RUNNING
         // after a signal flipped the flag (handler does NOT touch fds/maps).
-        int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, 1000);
+        // Shorter when a client timer (or a throttled client's retry) is
+        // due sooner.
+        const int wait_ms            = loop_timeout_ms();
+        const uint64_t wait_start_us = monotonic_us();
+        int nfds = epoll_wait(epoll_fd, events.data(), epoll_batch, wait_ms);
+        TRACE_1(epoll_wake, nfds);
+        const uint64_t iteration_start_us = monotonic_us();
+        const uint64_t late_us = std::max<int64_t>(0, int64_t(iteration_start_us - wait_start_us) - wait_ms * 1000);
+        loop_now_ms = iteration_start_us / 1000;
 
         if (nfds < 0) {
-            if (errno == EINTR) continue; // Interrupted by signal — re-check flag
+            if (errno == EINTR) {         // Interrupted by signal — re-check flag
+                interrupted_late_us += late_us;
+                continue;
+            }
             if (logger) {
                 logger->Write_log("Epoll wait error: " + std::string(strerror(errno)), Logger::Error);
             } else {
@@ -605,84 +2628,997 @@ void TcpServer::run()
             }
             break; // Unrecoverable epoll error — exit the loop
         }
-        if (nfds == 0) continue; // Timeout, no events ready
+        // nfds == 0: timeout, no events ready — only timers to look at.
+        throttled_due.swap(throttled_clients); // Retried after this batch
+        backlog_due.swap(backlog_clients);     // Next turn after this batch
 
+        uint64_t batch_start_ms = loop_now_ms; // Coalesced writes wait at most the delay cap
         for (int i = 0; i < nfds; i++)
         {
+            // A long batch must not hold earlier replies back: flush early.
+            if (!dirty_clients.empty() && monotonic_ms() - batch_start_ms >= coalesce_max_delay_ms) {
+                flush_dirty_clients(log);
+                batch_start_ms = monotonic_ms();
+            }
+
             int fd = events[i].data.fd;
 
-            // New inbound connection ready on the listening socket.
-            if (fd == server_fd) {
-                handle_new_connection(logger);
+            // New inbound connection ready on a listening socket.
+            if (std::find(listen_fds.begin(), listen_fds.end(), fd) != listen_fds.end()) {
+                handle_new_connection(fd, logger);
                 continue;
             }
 
-            // --- Drain all available data for this client fd ---
-            // Level-triggered socket, but we still loop to consume everything
-            // currently buffered by the kernel before moving to the next fd.
-            bool disconnected = false;
-            while (true)
-            {
-                memset(buffer, 0, BUFFER_SIZE);
-                ssize_t n = recv(fd, buffer, BUFFER_SIZE - 1, 0);
+            // Other reactors / the CryptoPool posted messages for us.
+            if (fd == mailbox_fd) {
+                drain_mailbox(log);
+                continue;
+            }
 
-                if (n > 0) {
-                    // Append raw bytes to this client's private stream buffer;
-                    // framing (splitting on '\n') happens after the drain loop.
-                    clients[fd].read_buffer.append(buffer, n);
+            // --- Resume pending writes first (EPOLLOUT armed by sendAll) ---
+            if (events[i].events & EPOLLOUT) {
+                if (!flush_write_queue(fd)) {
+                    char ip[INET6_ADDRSTRLEN];
+                    log.Write_log(Logger::Warn, client_event("send_error", fd, ip),
+                                  "Disconnected client fd=", fd, " due to send error");
+                    disconnect_client(fd, metrics::DisconnectReason::SendError);
                     continue;
                 }
-
-                if (n == 0) {
-                    // Peer performed an orderly shutdown (EOF).
-                    log.Write_log("Client disconnected fd=" + std::to_string(fd), Logger::Info);
-                    disconnect_client(fd);
-                    disconnected = true;
-                    break;
+                // Writable only — nothing to read on this wakeup, unless a
+                // TLS handshake was waiting to write.
+                if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    const Client* c = clients.find(fd);
+                    if (!c || !c->tls_handshaking) continue;
                 }
+            }
+
+            handle_client_readable(fd, log);
+        }
+
+        process_backlog(log);
+        process_throttled(log);
+        process_timers(log);
+        process_presence(log);
+        process_overload(monotonic_us() - iteration_start_us, late_us + interrupted_late_us, log);
+        sample_tables();
+        retired_auth_tasks.clear();
+        interrupted_late_us = 0;
+        process_shed(log);
+        flush_dirty_clients(log); // One writev() run per client that got data
+        loop_stats.loop_iteration_us.record(monotonic_us() - iteration_start_us);
+    }
+}
 
-                // n < 0: recv error.
-                if (errno == EAGAIN || errno == EWOULDBLOCK) break; // No more data right now
-                if (errno == EINTR) continue;                        // Retry
-                perror("recv");
-                log.Write_log("Recv error on fd=" + std::to_string(fd) + ": " +
-                              strerror(errno), Logger::Error);
-                disconnect_client(fd);
-                disconnected = true;
+// Drains everything the kernel has buffered for `fd`, then frames it.
+// Reading stops at max_input_buffer: the buffer is framed, and reading goes
+// on if that made room. If it didn't, the client either waits for its turn
+// with complete records (reading pauses until continue_input()) or sends a
+// line longer than the limit (disconnected).
+void TcpServer::handle_client_readable(int fd, Logger& log)
+{
+    // Consume everything currently buffered by the kernel before moving to
+    // the next fd. Mandatory for edge-triggered sockets: stopping early
+    // would leave data behind that no further event announces.
+    Client* client = clients.find(fd);
+    if (!client) return; // Closed earlier in this batch (stale event)
+    Client& c = *client;
+    if (c.tls_handshaking) {
+        if (!advance_tls_handshake(fd, log) || c.tls_handshaking) return;
+        // Done: application data may already follow the client's Finished.
+    }
+    if (c.input_paused) return; // Waits for continue_input()
+    ReadBuffer& rb = c.read_buffer;
+    bool full = true;
+    while (full)
+    {
+        full = false;
+        while (true)
+        {
+            if (rb.size() >= max_input_buffer) {
+                full = true;
                 break;
             }
+            const size_t room = max_input_buffer - rb.size();
+
+            // Receive straight into the client's buffer (no scratch copy);
+            // framing happens after the drain loop. A v2 frame announces its
+            // size, so room for the whole rest of it is made in one go.
+            size_t want = BUFFER_SIZE;
+            protocol::FrameHeader header;
+            if (c.protocol == protocol::Version::V2 && protocol::decode_header(rb.view(), header)) {
+                size_t frame_size = protocol::HEADER_SIZE + header.length;
+                if (frame_size > rb.size() && frame_size - rb.size() > want) want = frame_size - rb.size();
+            }
+            if (want > room) want = room;
+            if (!input_growth_allowed(c, want)) {
+                char ip[INET6_ADDRSTRLEN];
+                log.Write_log(Logger::Warn, client_event("memory_pressure", fd, ip),
+                              "Memory pressure: disconnecting fd=", fd, " with ", rb.size(),
+                              " bytes of input buffered");
+                disconnect_client(fd, metrics::DisconnectReason::MemoryPressure);
+                return;
+            }
+            char* dst = rb.write_ptr(want);
+            const size_t space = rb.writable() < room ? rb.writable() : room;
+            ssize_t n;
+            if (c.tls) {
+                // No receive offload: records are decrypted here.
+                size_t got = 0;
+                const tls::Io io = tls::read(c.tls, dst, space, got);
+                const int read_errno = errno;
+                if (io == tls::Io::WantRead || io == tls::Io::WantWrite) break;
+                if (io == tls::Io::Failed) {
+                    const std::string reason = tls::last_error();
+                    if (reason.empty()) { // The socket itself failed (e.g. reset)
+                        log.Write_log("Recv error on fd=" + std::to_string(fd) + ": " + strerror(read_errno),
+                                      Logger::Error);
+                        disconnect_client(fd, metrics::DisconnectReason::RecvError);
+                    } else {
+                        log.Write_log("TLS error on fd=" + std::to_string(fd) + ": " + reason, Logger::Warn);
+                        disconnect_client(fd, metrics::DisconnectReason::TlsError);
+                    }
+                    return;
+                }
+                n = io == tls::Io::Ok ? static_cast<ssize_t>(got) : 0;
+            } else {
+                n = recv(fd, dst, space, 0);
+            }
+
+            if (n > 0) {
+                rb.commit(static_cast<size_t>(n));
+                c.last_activity_ms = loop_now_ms;
+                loop_stats.recv_bytes.add(static_cast<uint64_t>(n));
+                continue;
+            }
 
-            // Client was closed/disconnected above — skip framing/processing.
-            if (disconnected) continue;
+            if (n == 0) {
+                // Peer performed an orderly shutdown (EOF).
+                char ip[INET6_ADDRSTRLEN];
+                log.Write_log(Logger::Info, client_event("disconnect", fd, ip),
+                              "Client disconnected fd=", fd);
+                disconnect_client(fd, metrics::DisconnectReason::PeerClosed);
+                return;
+            }
 
-            auto it = clients.find(fd);
-            if (it == clients.end()) continue; // Safety: fd vanished mid-loop
+            // n < 0: recv error.
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break; // No more data right now
+            if (errno == EINTR) continue;                        // Retry
+            if (errno == EIO && c.ktls_rx) {
+                // A non-data TLS record, in practice the client's close_notify.
+                char ip[INET6_ADDRSTRLEN];
+                log.Write_log(Logger::Info, client_event("disconnect", fd, ip),
+                              "Client disconnected fd=", fd);
+                disconnect_client(fd, metrics::DisconnectReason::PeerClosed);
+                return;
+            }
+            perror("recv");
+            log.Write_log("Recv error on fd=" + std::to_string(fd) + ": " +
+                          strerror(errno), Logger::Error);
+            disconnect_client(fd, metrics::DisconnectReason::RecvError);
+            return;
+        }
 
-            // --- Message framing: extract every complete '\n'-terminated
-            // record currently sitting in this client's buffer, one at a time.
-            size_t newline_pos;
-            while ((newline_pos = it->second.read_buffer.find('\n')) != std::string::npos)
-            {
-                std::string complete = it->second.read_buffer.substr(0, newline_pos + 1);
-                it->second.read_buffer.erase(0, newline_pos + 1);
+        frame_client_input(fd, log);
+        if (!clients.find(fd)) return; // Disconnected while processing
+        if (!full || rb.size() < max_input_buffer) continue; // Room again: keep reading
 
-                if (!process_message(fd, complete, log)) {
-                    break; // Client got disconnected inside process_message
-                }
+        if (c.backlogged || c.rate_deferred) {
+            // Complete records wait for their turn: leave the rest in the
+            // kernel (flow control) until they had it.
+            c.input_paused = true;
+            loop_stats.input_paused.add();
+            if (!edge_triggered) modify_epoll(fd, c.epollout_armed ? uint32_t(EPOLLOUT) : 0u);
+            break;
+        }
+        log.Write_log("Input overflow on fd=" + std::to_string(fd) + ": no line end in " +
+                      std::to_string(rb.size()) + " bytes", Logger::Warn);
+        disconnect_client(fd, metrics::DisconnectReason::InputOverflow);
+        return;
+    }
+    settle_read_buffer(c);
+}
 
-                // Re-fetch iterator: process_message may have mutated `clients`
-                // (e.g., via disconnect_client on a broadcast failure).
-                it = clients.find(fd);
-                if (it == clients.end()) break;
+void TcpServer::continue_input(int fd, Logger& log)
+{
+    Client* client = clients.find(fd);
+    if (!client) return;
+    if (!client->input_paused || client->backlogged || client->rate_deferred) {
+        settle_read_buffer(*client);
+        return;
+    }
+    client->input_paused = false;
+    if (!edge_triggered) modify_epoll(fd, client->epollout_armed ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    handle_client_readable(fd, log); // Edge-triggered: no new edge announces what is waiting
+}
+
+// Message framing: extracts every complete record currently sitting in the
+// client's buffer, one at a time — '\n'-terminated lines for v1, whole
+// frames for v2. Each record is a view into the buffer, valid until the
+// next recv.
+void TcpServer::frame_client_input(int fd, Logger& log, bool retry)
+{
+    Client* client = clients.find(fd);
+    if (!client) return; // Safety: fd vanished mid-loop
+    if (client->backlogged) return; // Waits for its turn in process_backlog()
+
+    // The first bytes decide the protocol: only v2 clients start with NUL.
+    if (client->protocol == protocol::Version::Unknown) {
+        ReadBuffer& rb = client->read_buffer;
+        if (rb.empty()) return;
+
+        if (rb.view()[0] != protocol::PREAMBLE[0]) {
+            client->protocol = protocol::Version::V1;
+        } else {
+            bool complete = false;
+            if (protocol::preamble_mismatch(rb.view(), complete)) {
+                log.Write_log("Protocol error on fd=" + std::to_string(fd) +
+                              ": bad v2 preamble", Logger::Warn);
+                disconnect_client(fd, metrics::DisconnectReason::ProtocolError);
+                return;
             }
+            if (!complete) return; // Rest of the preamble still in flight
+
+            std::string_view preamble;
+            rb.take(protocol::PREAMBLE_SIZE, preamble);
+            if (client->capture_stream) capture->record(client->capture_stream, preamble, true);
+            client->protocol = protocol::Version::V2;
+            ++v2_clients;
+
+            // Version, then the capabilities a Capabilities frame may accept
+            const char hello[2] = {static_cast<char>(protocol::Version::V2),
+                                   static_cast<char>(compress_offered.load(std::memory_order_relaxed)
+                                                         ? protocol::CAP_DEFLATE : 0)};
+            sendAll(fd, protocol::make_frame(protocol::Hello, std::string_view(hello, sizeof(hello))));
         }
     }
 
-    // Loop exited (flag flipped by a signal). Teardown runs HERE, in normal
-    // context — safe to touch maps, close fds and log. The signal handler
-    // itself only set the atomic flag.
-    shutdownActiveClients();
-    if (logger) {
-        logger->Write_log("Event loop exited; active clients shut down.", Logger::Info);
+    // Records this call may process before the client goes to the back of
+    // the line (see set_record_budget()).
+    unsigned budget = record_budget;
+
+    if (client->protocol == protocol::Version::V2) {
+        while (true)
+        {
+            ReadBuffer& rb = client->read_buffer;
+            protocol::FrameHeader header;
+            if (!protocol::decode_header(rb.view(), header)) break;
+
+            if (header.length > protocol::MAX_PAYLOAD) {
+                log.Write_log("Protocol error on fd=" + std::to_string(fd) + ": " +
+                              std::to_string(header.length) + "-byte frame", Logger::Warn);
+                disconnect_client(fd, metrics::DisconnectReason::ProtocolError);
+                return;
+            }
+
+            const size_t frame_size = protocol::HEADER_SIZE + header.length;
+            if (rb.size() < frame_size) break;
+            if (budget == 0) {
+                schedule_backlog(*client);
+                return;
+            }
+
+            const Admission admission = admit_record(*client, frame_size, retry);
+            if (admission == Admission::Defer) return;
+
+            std::string_view frame;
+            rb.take(frame_size, frame);
+            if (client->capture_stream) capture->record(client->capture_stream, frame, true);
+            if (admission == Admission::Drop) continue;
+            --budget;
+
+            TRACE_2(message_start, fd, frame.size());
+            const bool alive = process_frame(fd, header, frame.substr(protocol::HEADER_SIZE), log);
+            TRACE_2(message_end, fd, frame.size());
+            if (!alive) break;
+
+            client = clients.find(fd);
+            if (!client) break;
+        }
+        return;
+    }
+
+    std::string_view complete;
+    while (client->read_buffer.peek_line(complete))
+    {
+        if (budget == 0) {
+            schedule_backlog(*client);
+            return;
+        }
+        const Admission admission = admit_record(*client, complete.size(), retry);
+        if (admission == Admission::Defer) return;
+
+        client->read_buffer.next_line(complete);
+        if (client->capture_stream) capture->record(client->capture_stream, complete, false);
+        if (admission == Admission::Drop) continue;
+        --budget;
+
+        TRACE_2(message_start, fd, complete.size());
+        const bool alive = process_message(fd, complete, log);
+        TRACE_2(message_end, fd, complete.size());
+        if (!alive) {
+            break; // Client got disconnected inside process_message
+        }
+
+        // Re-fetch iterator: process_message may have mutated `clients`
+        // (e.g., via disconnect_client on a broadcast failure).
+        client = clients.find(fd);
+        if (!client) break;
+    }
+}
+
+void TcpServer::set_rate_limits(int messages_per_sec, int bytes_per_sec, int burst_seconds)
+{
+    const uint64_t burst = burst_seconds > 0 ? uint64_t(burst_seconds) : 1;
+    rate_messages      = messages_per_sec > 0 ? uint64_t(messages_per_sec) : 0;
+    rate_bytes         = bytes_per_sec > 0 ? uint64_t(bytes_per_sec) : 0;
+    rate_message_burst = rate_messages * burst;
+    // Whatever the rate, the bucket must hold the largest possible frame.
+    rate_byte_burst    = std::max<uint64_t>(rate_bytes * burst, protocol::HEADER_SIZE + protocol::MAX_PAYLOAD);
+
+    // Retry once a record's worth of tokens has come back.
+    rate_retry_ms = rate_messages ? static_cast<int>(std::min<uint64_t>(1000 / rate_messages, MAX_RATE_RETRY_MS))
+                                  : MAX_RATE_RETRY_MS;
+    if (rate_retry_ms < 1) rate_retry_ms = 1;
+}
+
+void TcpServer::set_local_peers(const std::string& list)
+{
+    std::unordered_map<uint32_t, std::string> parsed;
+    std::string error;
+    if (!parse_local_peers(list, parsed, error)) {
+        if (logger) logger->Write_log("[NETWORK] unix_socket_users: " + error + ", keeping the previous list", Logger::Warn);
+        return;
+    }
+    local_peers = std::move(parsed);
+}
+
+bool TcpServer::parse_local_peers(const std::string& list, std::unordered_map<uint32_t, std::string>& out,
+                                  std::string& error)
+{
+    out.clear();
+    std::string_view rest(list);
+    while (!rest.empty()) {
+        const size_t comma = rest.find(',');
+        const std::string_view entry = trimBuffer(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+        if (entry.empty()) continue;
+
+        const size_t colon = entry.find(':');
+        const std::string who(trimBuffer(entry.substr(0, colon)));
+        const std::string account(colon == std::string_view::npos ? std::string_view{}
+                                                                  : trimBuffer(entry.substr(colon + 1)));
+        if (who.empty() || account.empty() || account.size() > protocol::MAX_NAME) {
+            error = "bad entry '" + std::string(entry) + "' (expected <uid or user>:<account>)";
+            return false;
+        }
+
+        uint32_t uid = 0;
+        if (who.find_first_not_of("0123456789") == std::string::npos && who.size() <= 9) {
+            uid = static_cast<uint32_t>(std::stoul(who));
+        } else {
+            passwd pw{}, *found = nullptr;
+            char buffer[4096];
+            if (getpwnam_r(who.c_str(), &pw, buffer, sizeof(buffer), &found) != 0 || !found) {
+                error = "no system user '" + who + "'";
+                return false;
+            }
+            uid = found->pw_uid;
+        }
+        if (!out.emplace(uid, account).second) {
+            error = "uid " + std::to_string(uid) + " listed twice";
+            return false;
+        }
+    }
+    return true;
+}
+
+// O(1): a lazy refill and two compares. Defer parks the client on
+// throttled_clients (once); its input stays in the read buffer, in order.
+TcpServer::Admission TcpServer::admit_record(Client& c, size_t bytes, bool retry)
+{
+    if (c.local_peer || (rate_messages == 0 && rate_bytes == 0)) return Admission::Process;
+
+    // A v1 line can exceed a bucket; it costs at most a full one.
+    const uint64_t cost = std::min<uint64_t>(bytes, rate_byte_burst);
+    c.msg_tokens.refill(loop_now_ms, rate_messages, rate_message_burst);
+    c.byte_tokens.refill(loop_now_ms, rate_bytes, rate_byte_burst);
+
+    const bool messages_ok = rate_messages == 0 || c.msg_tokens.has(1);
+    const bool bytes_ok    = rate_bytes == 0 || c.byte_tokens.has(cost);
+    if (messages_ok && bytes_ok) {
+        if (rate_messages) c.msg_tokens.take(1);
+        if (rate_bytes) c.byte_tokens.take(cost);
+        return Admission::Process;
+    }
+
+    if (retry) {
+        ++c.rate_dropped;
+        loop_stats.rate_dropped.add();
+        return Admission::Drop;
+    }
+    if (!c.rate_deferred) {
+        c.rate_deferred = true;
+        throttled_clients.push_back(c.fd);
+        loop_stats.rate_deferred.add();
+    }
+    return Admission::Defer;
+}
+
+void TcpServer::process_throttled(Logger& log)
+{
+    for (int fd : throttled_due) {
+        Client* client = clients.find(fd);
+        if (!client || !client->rate_deferred) continue; // Gone (or fd reused)
+        client->rate_deferred = false;
+
+        frame_client_input(fd, log, true);
+        continue_input(fd, log);
+
+        client = clients.find(fd);
+        if (!client || client->rate_dropped == 0) continue;
+        log.Write_log("Rate limit: dropped " + std::to_string(client->rate_dropped) +
+                      " record(s) from fd=" + std::to_string(fd), Logger::Warn);
+        send_notice(fd, "Error: rate limit exceeded, " + std::to_string(client->rate_dropped) +
+                        " message(s) dropped");
+        client->rate_dropped = 0;
+    }
+    throttled_due.clear();
+}
+
+void TcpServer::set_record_budget(int records)
+{
+    record_budget = records > 0 ? static_cast<unsigned>(records) : UINT_MAX;
+}
+
+void TcpServer::set_max_input_buffer(int bytes)
+{
+    const size_t frame = protocol::HEADER_SIZE + protocol::MAX_PAYLOAD;
+    max_input_buffer = bytes > 0 && size_t(bytes) > frame ? size_t(bytes) : frame;
+}
+
+void TcpServer::set_listen_backlog(int backlog)
+{
+    listen_backlog = backlog > 0 ? backlog : 1;
+    // Legal on a listening socket: only the queue length changes.
+    for (int fd : listen_fds) {
+        if (listen(fd, listen_backlog) == -1 && logger) {
+            logger->Write_log("listen() backlog update failed: " + std::string(strerror(errno)), Logger::Warn);
+        }
+    }
+}
+
+void TcpServer::set_socket_tuning(const SocketTuning& t)
+{
+    if (tuning_applied && t == socket_tuning) return; // Reload without changes
+    socket_tuning   = t;
+    tuning_applied  = true;
+    tuning_reported = false;
+
+    for (int fd : listen_fds) {
+        if (ListenEndpoint::family(fd) == AF_UNIX) continue; // TCP options only
+        for (const std::string& refused : t.apply(fd)) {
+            if (logger) logger->Write_log("Socket option not applied: " + refused, Logger::Warn);
+        }
+        if (logger) {
+            logger->Write_log("Socket options on listener " + ListenEndpoint::bound_name(fd) + ": " +
+                              SocketTuning::describe(fd, true), Logger::Info);
+        }
+    }
+}
+
+void TcpServer::set_history(int messages, int max_bytes, bool global)
+{
+    history.configure(messages > 0 ? size_t(messages) : 0, max_bytes > 0 ? size_t(max_bytes) : 0, global);
+    loop_stats.history_bytes.set(static_cast<int64_t>(history.bytes()));
+}
+
+void TcpServer::set_idle_timeout(int seconds)
+{
+    const uint64_t timeout = seconds > 0 ? uint64_t(seconds) * 1000 : 0;
+    if (timeout == idle_timeout_ms) return;
+    idle_timeout_ms = timeout;
+
+    // Connected clients (none before run()) follow the new value right away;
+    // a client already idle for longer is checked on the next tick.
+    clients.for_each([&](int, Client& c) {
+        if (timeout == 0) {
+            timers.cancel(c.idle_timer);
+            return;
+        }
+        const uint64_t idle = loop_now_ms - c.last_activity_ms;
+        timers.schedule(c.idle_timer, idle < timeout ? timeout - idle : 1);
+    });
+}
+
+void TcpServer::watch_existing_clients(Logger& log)
+{
+    std::vector<int> fds;
+    fds.reserve(clients.size());
+    clients.for_each([&](int fd, const Client&) { fds.push_back(fd); });
+
+    for (int fd : fds) {
+        Client& c = *clients.find(fd);
+        c.input_paused = false; // Registered afresh below
+        if (uring) {
+            uring->prep_recv_multishot(fd, ring_tag(RingRecv, c));
+            if (!c.write_queue.empty() && !c.send_scheduled) {
+                c.send_scheduled = true;
+                ring_send_ready.push_back(fd);
+            }
+        } else {
+            c.epollout_armed = false;
+            add_to_epoll(fd, edge_triggered ? EPOLLIN | EPOLLOUT | EPOLLET : EPOLLIN);
+            if (!flush_write_queue(fd)) {
+                disconnect_client(fd, metrics::DisconnectReason::SendError);
+                continue;
+            }
+            if (!c.write_queue.empty()) arm_epollout(c);
+        }
+        if (!c.read_buffer.empty()) frame_client_input(fd, log);
+    }
+}
+
+std::vector<handoff::ClientState> TcpServer::export_clients() const
+{
+    std::vector<handoff::ClientState> out;
+    out.reserve(clients.size());
+    size_t left_out = 0;
+    clients.for_each([&](int fd, const Client& c) {
+        if (c.tls) { // Its record state is in this process's OpenSSL
+            ++left_out;
+            return;
+        }
+        handoff::ClientState s;
+        s.fd       = fd;
+        s.protocol = static_cast<uint8_t>(c.protocol);
+        s.capabilities = c.deflate ? protocol::CAP_DEFLATE : 0;
+        s.unread   = std::string(c.read_buffer.view());
+        for (size_t i = 0; i < c.write_queue.size(); ++i) {
+            const size_t skip = i == 0 ? c.write_offset : 0;
+            const SharedPayload& p = c.write_queue[i].payload;
+            s.unsent.append(p->data() + skip, p->size() - skip);
+        }
+
+        if (c.auth_pending) {
+            // Its Argon2id result would come back to this process.
+            const std::string_view notice = "Error: server restarting, please try again";
+            if (c.protocol == protocol::Version::V2) {
+                s.unsent += protocol::make_frame(protocol::Notice, notice);
+            } else {
+                s.unsent.append(notice.data(), notice.size()).push_back('\n');
+            }
+        } else if (c.user_id != NO_USER) {
+            s.username = std::string(users.name(c.user_id));
+            s.channels = c.channels;
+        }
+        out.push_back(std::move(s));
+    });
+    if (left_out && logger) {
+        logger->Write_log("Hot upgrade: closing " + std::to_string(left_out) +
+                          " TLS connections not offloaded to the kernel", Logger::Warn);
+    }
+    return out;
+}
+
+// The process exits right after this, so only the sockets are let go of;
+// the name and channel indexes simply die with it.
+void TcpServer::release_clients()
+{
+    std::vector<int> fds;
+    fds.reserve(clients.size());
+    clients.for_each([&](int fd, const Client&) { fds.push_back(fd); });
+
+    for (int fd : fds) {
+        // The registration belongs to the shared open file: remove it
+        // explicitly, closing our fd alone wouldn't.
+        remove_from_epoll(fd);
+        Client& c = *clients.find(fd);
+        timers.cancel(c.idle_timer);
+        release_memory(c);
+        if (c.tls) SSL_free(c.tls); // Left out of the export: closing ends it
+        close(fd);
+        clients.erase(fd);
+    }
+    loop_stats.connections.add(-static_cast<int64_t>(fds.size()));
+    connections_per_ip.clear();
+}
+
+void TcpServer::adopt_client(handoff::ClientState&& state)
+{
+    const int fd = state.fd;
+    sockaddr_storage peer{};
+    socklen_t len = sizeof(peer);
+    getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &len);
+
+    Client& c = clients.insert(fd);
+    c.read_buffer.use_chunks(recv_arena.get());
+    c.fd       = fd;
+    c.conn_id  = next_conn_id++;
+    c.local_peer = peer.ss_family == AF_UNIX;
+    c.ip_key   = c.local_peer ? IpKey{} : IpKey::from_sockaddr(reinterpret_cast<const sockaddr*>(&peer));
+    c.port     = c.local_peer ? 0
+               : peer.ss_family == AF_INET6 ? ntohs(reinterpret_cast<sockaddr_in6*>(&peer)->sin6_port)
+                                            : ntohs(reinterpret_cast<sockaddr_in*>(&peer)->sin_port);
+    if (c.local_peer) {
+        ucred cred{};
+        socklen_t cred_len = sizeof(cred);
+        getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len);
+        c.peer_uid = cred.uid;
+    }
+    c.protocol = static_cast<protocol::Version>(state.protocol);
+    c.ktls_rx  = tls::kernel_tls(fd); // An offloaded TLS connection stays one
+    if (c.protocol == protocol::Version::V2) ++v2_clients;
+    c.deflate = (state.capabilities & protocol::CAP_DEFLATE) != 0;
+    if (c.deflate) deflate_clients.fetch_add(1, std::memory_order_relaxed);
+    if (!c.local_peer) ++connections_per_ip[c.ip_key]; // Admitted before: counted even over the cap
+    loop_stats.connections.add(1);
+
+    loop_now_ms = monotonic_ms(); // Time base of the queue entries below (no loop runs yet)
+    c.last_activity_ms = loop_now_ms;
+    c.connected_ms = loop_now_ms; // Not carried over: the age restarts at the upgrade
+    c.idle_timer.owner = static_cast<uint64_t>(fd);
+    c.idle_timer.kind  = IdleTimer;
+    if (idle_timeout_ms) timers.schedule(c.idle_timer, idle_timeout_ms);
+    c.msg_tokens.reset(c.last_activity_ms, rate_message_burst);
+    c.byte_tokens.reset(c.last_activity_ms, rate_byte_burst);
+
+    if (!state.unread.empty()) {
+        std::memcpy(c.read_buffer.write_ptr(state.unread.size()), state.unread.data(), state.unread.size());
+        c.read_buffer.commit(state.unread.size());
+        settle_read_buffer(c);
+    }
+    if (!state.unsent.empty()) {
+        push_output(c, std::make_shared<const std::string>(std::move(state.unsent)));
+    }
+
+    if (!state.username.empty()) {
+        c.user_id = users.acquire(state.username);
+        index_session(c, fd);
+        TcpServer* shard = group ? group->server(group->owner_of(state.username)) : this;
+        shard->shard_claim(state.username, worker_id); // No loop runs yet: direct access is safe
+        presence_changed(state.username, 1);
+        if (cluster) cluster->presence(state.username, true);
+        for (std::string& name : state.channels) join_channel(fd, std::move(name), false);
+    }
+}
+
+void TcpServer::poll_config(Logger& log)
+{
+    if (!live) return;
+    if (worker_id == 0) live->reload_if_requested(log);
+
+    const uint64_t generation = live->generation();
+    if (generation == config_generation) return;
+    config_generation = generation;
+    std::shared_ptr<const ServerConfig> cfg = live->snapshot();
+    apply_config(*cfg);
+
+    // One reactor is enough to hand the cluster its new peer list.
+    if (cluster && worker_id == 0) {
+        std::vector<Cluster::Peer> peers;
+        std::string error;
+        if (Cluster::parse_peers(cfg->clusterPeers, peers, error)) cluster->set_peers(std::move(peers));
+        else log.Write_log("Config reload: [CLUSTER] peers ignored: " + error, Logger::Error);
+    }
+}
+
+// The same setters main() calls at startup; restart-only settings are
+// already pinned to their old value in the snapshot.
+void TcpServer::apply_config(const ServerConfig& cfg)
+{
+    set_max_connections_per_ip(static_cast<uint16_t>(cfg.maxConnectionsPerIp));
+    set_local_peers(cfg.unixSocketUsers);
+    set_listen_backlog(cfg.maxConnections);
+    set_idle_timeout(cfg.timeout);
+    set_rate_limits(cfg.maxMessagesPerSec, cfg.maxBytesPerSec, cfg.rateLimitBurst);
+    set_record_budget(cfg.recordsPerIteration);
+    set_socket_tuning(SocketTuning::from_config(cfg));
+    set_history(cfg.historyMessages, cfg.historyMaxBytes, cfg.historyGlobal);
+    set_history_query_limit(cfg.chatLogQueryMax);
+    set_password_rehash(cfg.argon2Rehash);
+    set_compression(cfg.compression, cfg.compressionMinBytes, cfg.compressionLevel);
+    set_max_input_buffer(cfg.maxInputBuffer);
+    if (capture) capture->set_path(cfg.captureFile); // Once per process: later reactors see it unchanged
+    set_memory_budgets(cfg.inputMemoryBudgetMb, cfg.outputMemoryBudgetMb);
+    set_slow_consumer_policy(parse_slow_consumer_policy(cfg.slowConsumerPolicy), cfg.slowConsumerQueueBytes,
+                             cfg.slowConsumerMaxDelayMs);
+    set_overload_control(cfg.overloadLagMs, cfg.overloadRejectLagMs, cfg.overloadRetryAfterS);
+    coalesce_max_delay_ms = cfg.coalesceMaxDelayMs > 0 ? uint64_t(cfg.coalesceMaxDelayMs) : 0;
+}
+
+void TcpServer::schedule_backlog(Client& c)
+{
+    if (c.backlogged) return;
+    c.backlogged = true;
+    backlog_clients.push_back(c.fd);
+    loop_stats.budget_exhausted.add();
+}
+
+// One more budget for every client that ran out of it last iteration, in
+// the order they ran out; whoever still has input goes back on the list.
+void TcpServer::process_backlog(Logger& log)
+{
+    for (int fd : backlog_due) {
+        Client* client = clients.find(fd);
+        if (!client || !client->backlogged) continue; // Gone (or fd reused)
+        client->backlogged = false;
+        frame_client_input(fd, log);
+        continue_input(fd, log);
+    }
+    backlog_due.clear();
+}
+
+int TcpServer::loop_timeout_ms() const
+{
+    if (!backlog_clients.empty()) return 0; // Buffered input is waiting
+    int timeout = timers.next_timeout_ms(1000);
+    if (!throttled_clients.empty() && rate_retry_ms < timeout) timeout = rate_retry_ms;
+    // Overloaded or holding logins: re-measure often enough to notice the
+    // loop caught up even when no events arrive.
+    if ((overload_stage || !deferred_auths.empty()) && OVERLOAD_TICK_MS < timeout) timeout = OVERLOAD_TICK_MS;
+    return timeout;
+}
+
+// ============================================================================
+// io_uring backend ([NETWORK] io_backend = io_uring)
+// Completion loop: multishot accept on the listener, multishot recv per
+// client into the ring's provided buffers, a multishot poll on the mailbox
+// eventfd, and linked SENDs per client write queue. All SQEs queued while
+// handling one batch of completions are submitted by a single
+// io_uring_enter(), which also waits for the next batch.
+// ============================================================================
+
+// user_data layout: op (8 bits) | low 24 bits of conn_id | fd (32 bits).
+// The conn_id part lets stale completions of a reused fd be ignored.
+uint64_t TcpServer::ring_key(const Client& c)
+{
+    return ((c.conn_id & 0xFFFFFFull) << 32) | static_cast<uint32_t>(c.fd);
+}
+
+uint64_t TcpServer::ring_tag(RingOp op, const Client& c)
+{
+    return (static_cast<uint64_t>(op) << 56) | ring_key(c);
+}
+
+uint64_t TcpServer::accept_tag(size_t listener)
+{
+    return (static_cast<uint64_t>(RingAccept) << 56) | listener;
+}
+
+void TcpServer::run_uring(Logger& log)
+{
+    const int mailbox_fd = inbox().fd();
+    for (size_t i = 0; i < listen_fds.size(); ++i) {
+        uring->prep_accept_multishot(listen_fds[i], accept_tag(i));
+        accept_armed[i] = true;
+    }
+    accept_paused = false; // A previous run's pause died with its ring
+    overload_stage = 0;
+    uring->prep_poll_multishot(mailbox_fd, POLLIN, static_cast<uint64_t>(RingMailbox) << 56);
+    watch_existing_clients(log);
+
+    std::cout << "Server running with io_uring...\n";
+
+    while (SERVER_IS_RUNNING.load())
+    {
+        poll_config(log);
+        submit_ring_sends();
+
+        // Same 1000ms cap as the epoll loop, so a signal is noticed promptly.
+        const int wait_ms            = loop_timeout_ms();
+        const uint64_t wait_start_us = monotonic_us();
+        if (!uring->submit_and_wait(wait_ms)) {
+            log.Write_log("io_uring_enter error: " + std::string(strerror(errno)), Logger::Error);
+            break;
+        }
+        const uint64_t iteration_start_us = monotonic_us();
+        const uint64_t late_us = std::max<int64_t>(0, int64_t(iteration_start_us - wait_start_us) - wait_ms * 1000);
+        loop_now_ms = iteration_start_us / 1000;
+
+        throttled_due.swap(throttled_clients); // Retried after this batch
+        backlog_due.swap(backlog_clients);     // Next turn after this batch
+        uring->for_each_cqe([&](const io_uring_cqe& cqe) { handle_completion(cqe, log); });
+        process_backlog(log);
+        process_throttled(log);
+
+        process_timers(log);
+        process_presence(log);
+        process_overload(monotonic_us() - iteration_start_us, late_us, log);
+        sample_tables();
+        retired_auth_tasks.clear();
+        process_shed(log);
+        loop_stats.loop_iteration_us.record(monotonic_us() - iteration_start_us);
+    }
+}
+
+// Builds one linked SEND chain per client that has queued data and nothing
+// in flight. Chains cover up to MAX_LINKED_SENDS payloads; the next chain
+// starts when the last CQE of this one arrives.
+void TcpServer::submit_ring_sends()
+{
+    for (int fd : ring_send_ready) {
+        Client* client = clients.find(fd);
+        if (!client) continue;
+        Client& c = *client;
+        c.send_scheduled = false;
+        if (c.sends_in_flight > 0 || c.write_queue.empty() || c.tls_handshaking) continue;
+
+        size_t count = c.write_queue.size();
+        if (count > MAX_LINKED_SENDS) count = MAX_LINKED_SENDS;
+
+        const uint64_t tag = ring_tag(RingSend, c);
+        for (size_t i = 0; i < count; ++i) {
+            const SharedPayload& p = c.write_queue[i].payload;
+            size_t skip = (i == 0) ? c.write_offset : 0;
+            uring->prep_send(fd, p->data() + skip, p->size() - skip, tag, i + 1 < count);
+        }
+        c.sends_in_flight = static_cast<uint16_t>(count);
+    }
+    ring_send_ready.clear();
+}
+
+// Appends `payload` to the client's queue; it goes out with the next batch.
+void TcpServer::queue_ring_send(Client& c, SharedPayload payload, bool droppable)
+{
+    if (!push_output(c, std::move(payload), 0, droppable)) return;
+    if (!c.send_scheduled && c.sends_in_flight == 0) {
+        c.send_scheduled = true;
+        ring_send_ready.push_back(c.fd);
+    }
+}
+
+// Dispatches one completion by the op encoded in its user_data.
+void TcpServer::handle_completion(const io_uring_cqe& cqe, Logger& log)
+{
+    const RingOp op  = static_cast<RingOp>(cqe.user_data >> 56);
+    const uint64_t key = cqe.user_data & ((1ull << 56) - 1);
+    const int fd     = static_cast<int>(static_cast<uint32_t>(key));
+    const bool more  = IoUring::cqe_more(cqe);
+
+    switch (op)
+    {
+    case RingAccept: // `key` is the listener's index
+        if (cqe.res >= 0) {
+            sockaddr_storage client_addr{};
+            socklen_t len = sizeof(client_addr);
+            getpeername(cqe.res, reinterpret_cast<sockaddr*>(&client_addr), &len);
+            register_client(cqe.res, client_addr, logger);
+        } else if (cqe.res != -ECANCELED) {
+            log.Write_log("io_uring accept error: " + std::string(strerror(-cqe.res)), Logger::Warn);
+        }
+        if (!more && key < listen_fds.size()) {
+            accept_armed[key] = false;
+            if (SERVER_IS_RUNNING.load() && !accept_paused) {
+                uring->prep_accept_multishot(listen_fds[key], accept_tag(key));
+                accept_armed[key] = true;
+            }
+        }
+        return;
+
+    case RingCancel: // pause_accept(); the accept's own CQE says the rest
+        return;
+
+    case RingMailbox:
+        drain_mailbox(log);
+        if (!more && SERVER_IS_RUNNING.load()) {
+            uring->prep_poll_multishot(inbox().fd(), POLLIN, static_cast<uint64_t>(RingMailbox) << 56);
+        }
+        return;
+
+    case RingRecv: {
+        const int bid = IoUring::cqe_buffer(cqe);
+        Client* client = clients.find(fd);
+        const bool live = client && ring_key(*client) == key;
+
+        if (cqe.res > 0 && bid >= 0) {
+            if (live && !input_growth_allowed(*client, static_cast<size_t>(cqe.res))) {
+                uring->recycle_buffer(static_cast<uint16_t>(bid));
+                char ip[INET6_ADDRSTRLEN];
+                log.Write_log(Logger::Warn, client_event("memory_pressure", fd, ip),
+                              "Memory pressure: disconnecting fd=", fd, " with ",
+                              client->read_buffer.size(), " bytes of input buffered");
+                disconnect_client(fd, metrics::DisconnectReason::MemoryPressure);
+                return;
+            }
+            if (live) {
+                ReadBuffer& rb = client->read_buffer;
+                std::memcpy(rb.write_ptr(static_cast<size_t>(cqe.res)),
+                            uring->buffer(static_cast<uint16_t>(bid)), static_cast<size_t>(cqe.res));
+                rb.commit(static_cast<size_t>(cqe.res));
+                client->last_activity_ms = loop_now_ms;
+                loop_stats.recv_bytes.add(static_cast<uint64_t>(cqe.res));
+            }
+            uring->recycle_buffer(static_cast<uint16_t>(bid));
+        } else if (bid >= 0) {
+            uring->recycle_buffer(static_cast<uint16_t>(bid));
+        }
+        if (!live) return; // Completion of an already closed connection
+
+        if (cqe.res == 0) {
+            char ip[INET6_ADDRSTRLEN];
+            log.Write_log(Logger::Info, client_event("disconnect", fd, ip), "Client disconnected fd=", fd);
+            disconnect_client(fd, metrics::DisconnectReason::PeerClosed);
+            return;
+        }
+        if (cqe.res == -EIO && client->ktls_rx) { // close_notify (see handle_client_readable())
+            char ip[INET6_ADDRSTRLEN];
+            log.Write_log(Logger::Info, client_event("disconnect", fd, ip), "Client disconnected fd=", fd);
+            disconnect_client(fd, metrics::DisconnectReason::PeerClosed);
+            return;
+        }
+        if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            log.Write_log("Recv error on fd=" + std::to_string(fd) + ": " +
+                          strerror(-cqe.res), Logger::Error);
+            disconnect_client(fd, metrics::DisconnectReason::RecvError);
+            return;
+        }
+
+        // Multishot ended (e.g. the buffer ring ran dry): re-arm.
+        if (!more) uring->prep_recv_multishot(fd, ring_tag(RingRecv, *client));
+        if (cqe.res <= 0) return;
+        frame_client_input(fd, log);
+
+        // A multishot receive can't be paused: input past the limit (a line
+        // too long, or records arriving faster than their turns) closes it.
+        client = clients.find(fd);
+        if (!client) return;
+        if (client->read_buffer.size() > max_input_buffer) {
+            log.Write_log("Input overflow on fd=" + std::to_string(fd) + ": " +
+                          std::to_string(client->read_buffer.size()) + " bytes unprocessed", Logger::Warn);
+            disconnect_client(fd, metrics::DisconnectReason::InputOverflow);
+            return;
+        }
+        settle_read_buffer(*client);
+        return;
+    }
+
+    case RingHandshake: {
+        Client* client = clients.find(fd);
+        if (!client || ring_key(*client) != key || !client->tls_handshaking) return;
+        if (cqe.res < 0) {
+            log.Write_log("TLS handshake poll failed on fd=" + std::to_string(fd) + ": " +
+                          strerror(-cqe.res), Logger::Warn);
+            disconnect_client(fd, metrics::DisconnectReason::TlsError);
+            return;
+        }
+        advance_tls_handshake(fd, log);
+        return;
+    }
+
+    case RingSend: {
+        Client* client = clients.find(fd);
+        if (!client || ring_key(*client) != key) {
+            // Send of a disconnected client: release its parked payloads
+            // once the kernel has returned every SEND of the chain.
+            auto parked = orphaned_sends.find(key);
+            if (parked != orphaned_sends.end() && --parked->second.in_flight == 0) {
+                orphaned_sends.erase(parked);
+            }
+            return;
+        }
+
+        Client& c = *client;
+        if (c.sends_in_flight > 0) --c.sends_in_flight;
+
+        if (cqe.res > 0) {
+            retire_written(c, static_cast<size_t>(cqe.res));
+            loop_stats.send_bytes.add(static_cast<uint64_t>(cqe.res));
+        } else if (cqe.res < 0 && cqe.res != -ECANCELED) {
+            // -ECANCELED is a later link of a chain broken by a short send:
+            // nothing of it went out, it is simply resubmitted.
+            loop_stats.send_errors.add();
+            char ip[INET6_ADDRSTRLEN];
+            log.Write_log(Logger::Warn, client_event("send_error", fd, ip),
+                          "Disconnected client fd=", fd, " due to send error");
+            disconnect_client(fd, metrics::DisconnectReason::SendError);
+            return;
+        }
+
+        if (c.sends_in_flight == 0 && !c.write_queue.empty() && !c.send_scheduled) {
+            c.send_scheduled = true;
+            ring_send_ready.push_back(fd);
+        }
+        return;
     }
-}
\ No newline at end of file
+    }
+}
@@ -0,0 +1,131 @@
+#include "session_tokens.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <protocol.hpp>
+
+namespace {
+
+constexpr unsigned char TOKEN_VERSION = 1;
+constexpr size_t HEADER_BYTES = 1 + 8; // version + expiry
+
+// Whole-buffer read/write helpers for the key file.
+bool read_exact(int fd, unsigned char* out, size_t len)
+{
+    while (len) {
+        ssize_t n = ::read(fd, out, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        out += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_exact(int fd, const unsigned char* in, size_t len)
+{
+    while (len) {
+        ssize_t n = ::write(fd, in, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        in += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+bool SessionTokens::init(const std::string& key_path, uint32_t ttl_s, std::string& error)
+{
+    if (sodium_init() < 0) {
+        error = "libsodium initialization failed";
+        return false;
+    }
+    ttl = ttl_s;
+    crypto_auth_keygen(key); // Used as is unless a key file is readable/creatable
+    if (ttl == 0) return true;
+    if (key_path.empty()) {
+        error = "no session key file configured; tokens won't survive a restart";
+        return false;
+    }
+
+    int fd = ::open(key_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        const bool ok = read_exact(fd, key, sizeof(key));
+        ::close(fd);
+        if (ok) return true;
+        crypto_auth_keygen(key);
+        error = key_path + ": truncated session key; using a temporary one";
+        return false;
+    }
+    if (errno != ENOENT) {
+        error = key_path + ": " + strerror(errno) + "; using a temporary session key";
+        return false;
+    }
+
+    // First start: persist the fresh key (O_EXCL: never clobber a racing writer's).
+    fd = ::open(key_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        error = key_path + ": " + strerror(errno) + "; using a temporary session key";
+        return false;
+    }
+    const bool ok = write_exact(fd, key, sizeof(key)) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) {
+        ::unlink(key_path.c_str());
+        error = key_path + ": write failed; using a temporary session key";
+        return false;
+    }
+    return true;
+}
+
+std::string SessionTokens::issue(std::string_view username, uint64_t now_s) const
+{
+    const uint64_t expiry = now_s + ttl;
+
+    std::string raw;
+    raw.reserve(HEADER_BYTES + username.size() + crypto_auth_BYTES);
+    raw.push_back(static_cast<char>(TOKEN_VERSION));
+    for (int shift = 56; shift >= 0; shift -= 8) raw.push_back(static_cast<char>(expiry >> shift));
+    raw.append(username.data(), username.size());
+
+    unsigned char tag[crypto_auth_BYTES];
+    crypto_auth(tag, reinterpret_cast<const unsigned char*>(raw.data()), raw.size(), key);
+    raw.append(reinterpret_cast<const char*>(tag), sizeof(tag));
+
+    const int variant = sodium_base64_VARIANT_URLSAFE_NO_PADDING;
+    std::string token(sodium_base64_ENCODED_LEN(raw.size(), variant), '\0');
+    sodium_bin2base64(&token[0], token.size(),
+                      reinterpret_cast<const unsigned char*>(raw.data()), raw.size(), variant);
+    token.resize(std::strlen(token.c_str())); // Drop the encoder's NUL
+    return token;
+}
+
+bool SessionTokens::verify(std::string_view token, uint64_t now_s, std::string& username) const
+{
+    if (!enabled()) return false;
+
+    constexpr size_t MAX_RAW = HEADER_BYTES + protocol::MAX_NAME + crypto_auth_BYTES;
+    unsigned char raw[MAX_RAW];
+    size_t len = 0;
+    if (sodium_base642bin(raw, sizeof(raw), token.data(), token.size(), nullptr, &len, nullptr,
+                          sodium_base64_VARIANT_URLSAFE_NO_PADDING) != 0 ||
+        len < HEADER_BYTES + 1 + crypto_auth_BYTES || raw[0] != TOKEN_VERSION) {
+        return false;
+    }
+
+    const size_t signed_len = len - crypto_auth_BYTES;
+    if (crypto_auth_verify(raw + signed_len, raw, signed_len, key) != 0) return false;
+
+    uint64_t expiry = 0;
+    for (size_t i = 1; i < HEADER_BYTES; ++i) expiry = (expiry << 8) | raw[i];
+    if (now_s >= expiry) return false;
+
+    username.assign(reinterpret_cast<const char*>(raw + HEADER_BYTES), signed_len - HEADER_BYTES);
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sodium.h>
+
+// ============================================================================
+// SessionTokens — short-lived resume tokens, so a reconnect doesn't pay for
+// another Argon2id verify.
+//
+// After a successful /login, /register or /resume the server hands out
+//
+//   token = base64url( version | expiry (BE u64, unix s) | username | tag )
+//   tag   = crypto_auth(key, version | expiry | username)   (HMAC-SHA512-256)
+//
+// and `/resume <token>` checks it with one MAC (microseconds) instead of
+// crypto_pwhash_str_verify. Nothing is stored per token: the key is the
+// only state, kept in a 0600 file so tokens survive a restart. Deleting the
+// key file revokes every outstanding token on the next start. A token is
+// as good as the password until it expires, so keep the TTL short.
+//
+// Immutable after init(); shared read-only by every reactor.
+// ============================================================================
+class SessionTokens {
+public:
+    SessionTokens() = default;
+
+    SessionTokens(const SessionTokens&) = delete;
+    SessionTokens& operator=(const SessionTokens&) = delete;
+
+    ~SessionTokens() { sodium_memzero(key, sizeof(key)); }
+
+    // Reads the MAC key from `key_path`, creating it if missing. An empty
+    // path (or a key file that can't be created) uses a random key for this
+    // process only; `error` then says why. ttl_s = 0 disables the feature.
+    bool init(const std::string& key_path, uint32_t ttl_s, std::string& error);
+
+    bool enabled() const { return ttl > 0; }
+    uint32_t ttl_seconds() const { return ttl; }
+
+    // Token for `username`, valid for ttl_seconds() from `now_s`.
+    std::string issue(std::string_view username, uint64_t now_s) const;
+
+    // Checks the tag (constant time) and the expiry; on success copies the
+    // username the token was issued for into `username`.
+    bool verify(std::string_view token, uint64_t now_s, std::string& username) const;
+
+private:
+    unsigned char key[crypto_auth_KEYBYTES]{};
+    uint32_t ttl{0};
+};
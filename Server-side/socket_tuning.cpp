@@ -0,0 +1,53 @@
+#include "socket_tuning.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+void set(int fd, int level, int name, const char* label, int value, std::vector<std::string>& failed)
+{
+    if (setsockopt(fd, level, name, &value, sizeof(value)) == -1) {
+        failed.push_back(std::string(label) + ": " + strerror(errno));
+    }
+}
+
+void report(int fd, int level, int name, const char* label, std::string& out)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (!out.empty()) out.push_back(' ');
+    out.append(label).push_back('=');
+    if (getsockopt(fd, level, name, &value, &len) == -1) out.append("?");
+    else out.append(std::to_string(value));
+}
+
+} // namespace
+
+std::vector<std::string> SocketTuning::apply(int fd) const
+{
+    std::vector<std::string> failed;
+    set(fd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", nodelay ? 1 : 0, failed);
+    if (send_buffer > 0) set(fd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", send_buffer, failed);
+    if (recv_buffer > 0) set(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", recv_buffer, failed);
+    set(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, "TCP_DEFER_ACCEPT", defer_accept_s, failed);
+    set(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "TCP_NOTSENT_LOWAT", notsent_lowat, failed);
+    set(fd, SOL_SOCKET, SO_BUSY_POLL, "SO_BUSY_POLL", busy_poll_us, failed);
+    return failed;
+}
+
+std::string SocketTuning::describe(int fd, bool listener)
+{
+    std::string out;
+    report(fd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", out);
+    report(fd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", out);
+    report(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", out);
+    if (listener) report(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, "TCP_DEFER_ACCEPT", out);
+    report(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "TCP_NOTSENT_LOWAT", out);
+    report(fd, SOL_SOCKET, SO_BUSY_POLL, "SO_BUSY_POLL", out);
+    return out;
+}
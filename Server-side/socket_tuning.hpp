@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "common/config/Configuration.hpp"
+
+// ============================================================================
+// SocketTuning — the [NETWORK] socket profile for small, latency-sensitive
+// chat messages.
+//
+// Set on the listening socket. Linux copies socket options into every
+// socket accept() returns, so connections pay no extra syscalls for them.
+// What the kernel actually granted is read back with describe() and logged:
+// once for the listener, and once for the first accepted socket of each
+// reactor. This matters because SO_SNDBUF/SO_RCVBUF are doubled and capped
+// by net.core.[wr]mem_max, and SO_BUSY_POLL needs CAP_NET_ADMIN to go above
+// net.core.busy_read.
+// ============================================================================
+struct SocketTuning {
+    bool nodelay{true};    // TCP_NODELAY: replies aren't held back by Nagle
+    int send_buffer{0};    // SO_SNDBUF bytes (0 = kernel autotuning)
+    int recv_buffer{0};    // SO_RCVBUF bytes (0 = kernel autotuning)
+    int defer_accept_s{0}; // TCP_DEFER_ACCEPT: accept only once data arrived (0 = off)
+    int notsent_lowat{0};  // TCP_NOTSENT_LOWAT bytes (0 = net.ipv4.tcp_notsent_lowat)
+    int busy_poll_us{0};   // SO_BUSY_POLL microseconds (0 = off)
+
+    static SocketTuning from_config(const ServerConfig& cfg)
+    {
+        SocketTuning t;
+        t.nodelay        = cfg.tcpNoDelay;
+        t.send_buffer    = cfg.socketSendBuffer;
+        t.recv_buffer    = cfg.socketRecvBuffer;
+        t.defer_accept_s = cfg.tcpDeferAccept;
+        t.notsent_lowat  = cfg.tcpNotsentLowat;
+        t.busy_poll_us   = cfg.busyPollUs;
+        return t;
+    }
+
+    bool operator==(const SocketTuning& o) const
+    {
+        return nodelay == o.nodelay && send_buffer == o.send_buffer && recv_buffer == o.recv_buffer &&
+               defer_accept_s == o.defer_accept_s && notsent_lowat == o.notsent_lowat &&
+               busy_poll_us == o.busy_poll_us;
+    }
+    bool operator!=(const SocketTuning& o) const { return !(*this == o); }
+
+    // Sets the profile on listener `fd`. Buffer sizes are only set when
+    // non-zero (once set, the kernel stops autotuning them for good).
+    // Returns one "OPTION: reason" entry per option the kernel refused.
+    std::vector<std::string> apply(int fd) const;
+
+    // Effective values on `fd`, e.g. "TCP_NODELAY=1 SO_SNDBUF=46080 ...".
+    // TCP_DEFER_ACCEPT is only reported for listeners.
+    static std::string describe(int fd, bool listener);
+};
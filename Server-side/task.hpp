@@ -0,0 +1,107 @@
+#pragma once
+
+// std::coroutine_handle, std::suspend_always / std::suspend_never
+#include <coroutine>
+// std::terminate
+#include <exception>
+// std::exchange, std::move
+#include <utility>
+
+// ============================================================================
+// coro — the coroutines a reactor runs for one client.
+//
+// A handler that has to wait (for its username claim, for Argon2id on the
+// CryptoPool) is written as a coro::Task: straight-line code that
+// `co_await`s a Completion, instead of a chain of callbacks with the state
+// parked in the Client. The task starts running at once, on the calling
+// reactor, and runs until its first wait. The answer always comes back to
+// that reactor, as a mailbox message, or right away when the reactor
+// decides it itself. The reactor then calls complete(), which resumes the
+// task inline. So a task only ever runs on its own reactor's thread, and
+// it needs no locks.
+//
+// The Task is owned by whatever it serves, normally the Client. Destroying
+// a suspended Task cancels it: the frame goes away with its locals, and the
+// answer it waited for is recognized as stale when it arrives (conn_id), as
+// before. A task that is running can't be destroyed, which is why its
+// owner has to know whether it is suspended (see TcpServer::disconnect_client).
+// Exceptions end the process, as they would in a callback.
+// ============================================================================
+namespace coro {
+
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; } // The owner frees it
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { reset(); }
+
+    // Holds a frame that hasn't run to its end (suspended, or running now).
+    bool pending() const { return handle && !handle.done(); }
+
+    explicit operator bool() const { return static_cast<bool>(handle); }
+
+    // Frees the frame. Never call it from inside the task itself.
+    void reset()
+    {
+        if (handle) std::exchange(handle, {}).destroy();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle{};
+};
+
+// One answer a Task waits for. It lives in the task's frame, and whoever
+// delivers the answer calls complete(). That may happen before the task
+// gets to `co_await` (the reactor decided on the spot), and then the task
+// doesn't suspend at all.
+template <typename T>
+class Completion {
+public:
+    Completion() = default;
+    Completion(const Completion&) = delete;
+    Completion& operator=(const Completion&) = delete;
+
+    bool await_ready() const noexcept { return ready; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { waiter = h; }
+    T await_resume()
+    {
+        ready = false; // Reusable for the task's next wait
+        return std::move(value);
+    }
+
+    // Stores the answer and resumes the waiting task, which runs on the
+    // caller's thread until its next wait or its end.
+    void complete(T answer)
+    {
+        value = std::move(answer);
+        ready = true;
+        if (std::coroutine_handle<> h = std::exchange(waiter, {})) h.resume();
+    }
+
+private:
+    T value{};
+    bool ready{false};
+    std::coroutine_handle<> waiter{};
+};
+
+} // namespace coro
@@ -0,0 +1,129 @@
+#include "timer_wheel.hpp"
+
+TimerWheel::TimerWheel(uint32_t _tick_ms, uint64_t now_ms)
+    : tick_ms(_tick_ms ? _tick_ms : 1), origin_ms(now_ms), last_now_ms(now_ms)
+{
+}
+
+// Rounds up so a timer never fires early; one tick minimum so a timer
+// scheduled from a handler can't fire again in the same advance().
+void TimerWheel::schedule(Timer& t, uint64_t delay_ms)
+{
+    if (t.armed()) unlink(t);
+    else ++count;
+
+    uint64_t ticks = (delay_ms + tick_ms - 1) / tick_ms;
+    if (ticks == 0) ticks = 1;
+    t.expires = current + ticks;
+    insert(t);
+}
+
+void TimerWheel::cancel(Timer& t)
+{
+    if (!t.armed()) return;
+    unlink(t);
+    --count;
+}
+
+// Level = how far away the deadline is: level n holds deltas below
+// SLOTS^(n+1) ticks, bucketed by bits [n*SLOT_BITS, (n+1)*SLOT_BITS) of the
+// absolute expiry. Deadlines past the last level are clamped to its range.
+void TimerWheel::insert(Timer& t)
+{
+    uint64_t delta = t.expires > current ? t.expires - current : 0;
+
+    unsigned level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    if (level == LEVELS - 1) {
+        uint64_t max_delta = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+        if (delta > max_delta) t.expires = current + max_delta;
+    }
+
+    Timer*& head = wheel[level][(t.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    t.prev   = nullptr;
+    t.next   = head;
+    t.bucket = &head;
+    if (head) head->prev = &t;
+    head = &t;
+}
+
+void TimerWheel::unlink(Timer& t)
+{
+    if (t.prev) t.prev->next = t.next;
+    else        *t.bucket    = t.next;
+    if (t.next) t.next->prev = t.prev;
+    t.prev = t.next = nullptr;
+    t.bucket = nullptr;
+}
+
+// Called when `current` enters a new lap of `level`: that bucket's timers
+// are now close enough to be re-filed one or more levels down.
+void TimerWheel::cascade(unsigned level)
+{
+    Timer*& head = wheel[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    Timer* t = head;
+    head = nullptr;
+    while (t) {
+        Timer* next = t->next;
+        insert(*t);
+        t = next;
+    }
+}
+
+size_t TimerWheel::advance(uint64_t now_ms, std::vector<Timer*>& expired)
+{
+    if (now_ms > last_now_ms) last_now_ms = now_ms;
+    uint64_t target = (last_now_ms - origin_ms) / tick_ms;
+
+    // Nothing armed: just jump, there is nothing to cascade or fire.
+    if (count == 0) {
+        if (target > current) current = target;
+        return 0;
+    }
+
+    size_t fired = 0;
+    while (current < target) {
+        ++current;
+
+        // Higher levels first so their timers can land in lower buckets
+        // that are cascaded/fired right after.
+        for (unsigned level = LEVELS - 1; level > 0; --level) {
+            if ((current & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) == 0) cascade(level);
+        }
+
+        Timer*& head = wheel[0][current & (SLOTS - 1)];
+        while (Timer* t = head) {
+            unlink(*t);
+            --count;
+            expired.push_back(t);
+            ++fired;
+        }
+
+        if (count == 0) {
+            current = target;
+            break;
+        }
+    }
+    return fired;
+}
+
+// Looks one lap ahead on level 0 only; when that is empty we wake up at the
+// next lap boundary to cascade, which is still far cheaper than polling.
+int TimerWheel::next_timeout_ms(int cap_ms) const
+{
+    if (count == 0) return cap_ms;
+
+    uint64_t ticks = SLOTS - (current & (SLOTS - 1));
+    for (uint64_t d = 1; d < SLOTS; ++d) {
+        if (wheel[0][(current + d) & (SLOTS - 1)]) {
+            ticks = d;
+            break;
+        }
+    }
+
+    uint64_t due_ms = origin_ms + (current + ticks) * tick_ms;
+    uint64_t wait   = due_ms > last_now_ms ? due_ms - last_now_ms : 0;
+    return wait < static_cast<uint64_t>(cap_ms) ? static_cast<int>(wait) : cap_ms;
+}
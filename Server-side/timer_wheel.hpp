@@ -0,0 +1,94 @@
+#pragma once
+
+// uint64_t / uint32_t — tick counters and timer metadata
+#include <cstdint>
+// size_t
+#include <cstddef>
+// std::vector — batch of expired timers handed back by advance()
+#include <vector>
+
+// ============================================================================
+// TimerWheel — hierarchical hashed timing wheel (Varghese & Lauck) driving
+// per-connection deadlines from the reactor's epoll_wait() timeout.
+//
+// LEVELS wheels of SLOTS buckets each; level n buckets span SLOTS^n ticks.
+// schedule()/cancel() are O(1) (intrusive doubly-linked buckets, no
+// allocation); advance() only touches the buckets whose time has come and
+// cascades a higher-level bucket down once per lap, so nothing ever scans
+// the full set of connections.
+//
+// Timers are embedded in their owner (e.g. TcpServer::Client) and carry an
+// opaque `owner` id plus a `kind`, so one wheel can serve idle timeouts,
+// auth deadlines, heartbeats... The owner must cancel() before destroying
+// an armed timer. Single-threaded: owned by one reactor.
+// ============================================================================
+class TimerWheel {
+public:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS     = 1u << SLOT_BITS; // 64 buckets per level
+    static constexpr unsigned LEVELS    = 4;               // 64^4 ticks of range
+
+    // Intrusive timer node. Moving/copying yields an UNARMED timer with the
+    // same owner/kind (only legal while the source is unarmed itself).
+    struct Timer {
+        uint64_t owner{0};   // Caller's id for the timer (e.g. the client fd)
+        uint32_t kind{0};    // Caller-defined timer type
+        uint64_t expires{0}; // Absolute tick at which it fires
+
+        Timer() = default;
+        Timer(const Timer& other) : owner(other.owner), kind(other.kind) {}
+        Timer& operator=(const Timer& other)
+        {
+            owner = other.owner;
+            kind  = other.kind;
+            return *this;
+        }
+
+        bool armed() const { return bucket != nullptr; }
+
+    private:
+        friend class TimerWheel;
+        Timer*  prev{nullptr};
+        Timer*  next{nullptr};
+        Timer** bucket{nullptr}; // Head pointer of the bucket holding us
+    };
+
+    // `tick_ms` is the resolution; `now_ms` any monotonic millisecond clock.
+    TimerWheel(uint32_t tick_ms, uint64_t now_ms);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // (Re)arms `t` to fire `delay_ms` from the wheel's current time
+    // (rounded up to whole ticks, at least one tick).
+    void schedule(Timer& t, uint64_t delay_ms);
+
+    // Disarms `t`; no-op if it isn't armed.
+    void cancel(Timer& t);
+
+    // Moves the wheel to `now_ms` and appends every timer that expired on the
+    // way to `expired` (already disarmed, so handlers may re-schedule them).
+    // Returns how many were appended.
+    size_t advance(uint64_t now_ms, std::vector<Timer*>& expired);
+
+    // Milliseconds until the next possible expiry, capped at `cap_ms`
+    // (suitable as an epoll_wait() timeout).
+    int next_timeout_ms(int cap_ms) const;
+
+    // Number of armed timers.
+    size_t size() const { return count; }
+
+    uint32_t tick() const { return tick_ms; }
+
+private:
+    void insert(Timer& t);                   // Places t by its `expires`
+    static void unlink(Timer& t);
+    void cascade(unsigned level);            // Redistributes the current bucket of `level`
+
+    uint32_t tick_ms;
+    uint64_t origin_ms;                      // Clock value of tick 0
+    uint64_t last_now_ms;                    // Latest clock value seen by advance()
+    uint64_t current{0};                     // Ticks processed so far
+    size_t count{0};
+    Timer* wheel[LEVELS][SLOTS]{};           // Bucket heads
+};
@@ -0,0 +1,132 @@
+#include "tls.hpp"
+
+#include <openssl/err.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+TlsContext::TlsContext(const std::string& certificate, const std::string& private_key, bool ktls,
+                       bool _require_ktls)
+    : require_ktls(_require_ktls)
+{
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) throw std::runtime_error("SSL_CTX_new: " + tls::last_error());
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    // No tickets: a NewSessionTicket after the handshake would be the one
+    // record the kernel hasn't taken over yet.
+    SSL_CTX_set_num_tickets(ctx, 0);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    // A peer closing without close_notify is an ordinary disconnect here.
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+    if (ktls) SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    // Userspace writes resume from the write queue, whose front payload
+    // may be retried through a different pointer.
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+    // read_ahead stays off: receive offload only starts when OpenSSL holds
+    // no bytes past the handshake.
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, certificate.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, private_key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        const std::string reason = tls::last_error();
+        SSL_CTX_free(ctx);
+        throw std::runtime_error("TLS certificate " + certificate + " / key " + private_key + ": " + reason);
+    }
+}
+
+TlsContext::~TlsContext()
+{
+    SSL_CTX_free(ctx);
+}
+
+SSL* TlsContext::accept(int fd) const
+{
+    SSL* ssl = SSL_new(ctx);
+    if (!ssl) return nullptr;
+    if (SSL_set_fd(ssl, fd) != 1) { // BIO_NOCLOSE: the fd stays ours
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return ssl;
+}
+
+namespace tls {
+
+// Maps the outcome of an SSL_* call. The error queue is per thread and
+// shared by every connection of the reactor, so it is always left empty.
+static Io outcome(SSL* ssl, int ret)
+{
+    switch (SSL_get_error(ssl, ret)) {
+        case SSL_ERROR_NONE:        return Io::Ok;
+        case SSL_ERROR_WANT_READ:   return Io::WantRead;
+        case SSL_ERROR_WANT_WRITE:  return Io::WantWrite;
+        case SSL_ERROR_ZERO_RETURN: return Io::Closed;
+        case SSL_ERROR_SYSCALL:
+            if (errno == EINTR) return Io::WantRead;
+            ERR_clear_error();
+            return errno == 0 ? Io::Closed : Io::Failed;
+        default:
+            return Io::Failed;
+    }
+}
+
+Io handshake(SSL* ssl)
+{
+    ERR_clear_error();
+    return outcome(ssl, SSL_do_handshake(ssl));
+}
+
+Io read(SSL* ssl, char* dst, size_t len, size_t& done)
+{
+    ERR_clear_error();
+    done = 0;
+    return outcome(ssl, SSL_read_ex(ssl, dst, len, &done));
+}
+
+Io write(SSL* ssl, const char* src, size_t len, size_t& done)
+{
+    ERR_clear_error();
+    done = 0;
+    return outcome(ssl, SSL_write_ex(ssl, src, len, &done));
+}
+
+bool tx_offloaded(SSL* ssl)
+{
+    return BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+}
+
+bool rx_offloaded(SSL* ssl)
+{
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0;
+}
+
+bool kernel_tls(int fd)
+{
+#ifdef TCP_ULP
+    char name[16]{};
+    socklen_t len = sizeof(name) - 1;
+    return getsockopt(fd, IPPROTO_TCP, TCP_ULP, name, &len) == 0 && std::strcmp(name, "tls") == 0;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+std::string last_error()
+{
+    const unsigned long code = ERR_get_error();
+    ERR_clear_error();
+    if (code == 0) return "";
+    char text[256];
+    ERR_error_string_n(code, text, sizeof(text));
+    return text;
+}
+
+} // namespace tls
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <cstddef>
+#include <string>
+
+// ============================================================================
+// TLS on the chat listener ([TLS] in the config).
+//
+// Only the handshake is done in userspace: OpenSSL runs it non-blocking on
+// the event loop, and once the traffic keys exist it hands them to the
+// kernel (kTLS: the "tls" TCP ULP, TLS_TX / TLS_RX). From then on the
+// socket reads and writes plaintext and the kernel builds the records, so
+// everything after the handshake stays as it is: writev() of the shared
+// broadcast payloads, io_uring SENDs, and the hot-upgrade handoff (the
+// record state lives in the socket and travels with the fd).
+//
+// Offload is decided per direction and needs the tls kernel module and an
+// OpenSSL built with kTLS; receive offload of TLS 1.3 needs OpenSSL 3.2 or
+// later. A direction that isn't offloaded falls back to SSL_read() /
+// SSL_write() on the loop thread (epoll backend only), unless the listener
+// requires kTLS, in which case such connections are closed.
+// ============================================================================
+class TlsContext {
+public:
+    // Loads the PEM certificate chain and private key. TLS 1.3 only,
+    // without session tickets (nothing is sent after the handshake).
+    // Throws std::runtime_error with OpenSSL's reason on failure.
+    TlsContext(const std::string& certificate, const std::string& private_key, bool ktls,
+               bool require_ktls);
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    // Server-side session on accepted socket `fd`; nullptr on failure.
+    SSL* accept(int fd) const;
+
+    // [TLS] require_ktls: connections the kernel can't fully take over are
+    // closed after the handshake instead of staying in userspace.
+    bool ktls_required() const { return require_ktls; }
+
+private:
+    SSL_CTX* ctx{nullptr};
+    bool require_ktls{false};
+};
+
+namespace tls {
+
+// Result of one non-blocking OpenSSL call.
+enum class Io { Ok, WantRead, WantWrite, Closed, Failed };
+
+// Continues the handshake; Ok once it is complete.
+Io handshake(SSL* ssl);
+
+// SSL_read() / SSL_write() of at most `len` bytes; `done` is what moved.
+// Partial writes are enabled, so Ok may have written less than `len`.
+Io read(SSL* ssl, char* dst, size_t len, size_t& done);
+Io write(SSL* ssl, const char* src, size_t len, size_t& done);
+
+// Whether the kernel encrypts / decrypts records of this session.
+bool tx_offloaded(SSL* ssl);
+bool rx_offloaded(SSL* ssl);
+
+// Whether `fd` has the TLS ULP attached (an offloaded socket received in a
+// hot-upgrade handoff).
+bool kernel_tls(int fd);
+
+// The oldest queued OpenSSL error of this thread ("" if none); clears the queue.
+std::string last_error();
+
+} // namespace tls
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// ============================================================================
+// TokenBucket — O(1) rate limiter, refilled lazily from the loop clock.
+//
+// Tokens are kept in thousandths, so `rate` tokens per second is exactly
+// `rate` milli-tokens per elapsed millisecond: integer arithmetic, no drift,
+// no timer. The rate and capacity live with the caller (one configuration
+// for every connection of a reactor), the bucket only holds its fill level.
+// ============================================================================
+class TokenBucket {
+public:
+    // Full bucket as of `now_ms` (a new connection may burst right away).
+    void reset(uint64_t now_ms, uint64_t capacity) noexcept
+    {
+        milli   = capacity * 1000;
+        last_ms = now_ms;
+    }
+
+    // Adds what `rate` tokens/s earned since the last refill, up to `capacity`.
+    // A capacity shrunk by a reload also clamps what the bucket already holds.
+    void refill(uint64_t now_ms, uint64_t rate, uint64_t capacity) noexcept
+    {
+        const uint64_t max = capacity * 1000;
+        if (milli > max) milli = max;
+        if (now_ms > last_ms) {
+            const uint64_t add = (now_ms - last_ms) * rate;
+            milli   = (max - milli < add) ? max : milli + add;
+            last_ms = now_ms;
+        }
+    }
+
+    bool has(uint64_t n) const noexcept { return milli >= n * 1000; }
+    void take(uint64_t n) noexcept { milli -= n * 1000; }
+
+private:
+    uint64_t milli{0};   // Available tokens × 1000
+    uint64_t last_ms{0}; // Loop time of the last refill
+};
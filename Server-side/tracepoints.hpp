@@ -0,0 +1,37 @@
+#pragma once
+
+// ============================================================================
+// Static tracepoints (USDT, provider "tcpserver").
+//
+// With -DENABLE_USDT=ON and <sys/sdt.h> available (systemtap-sdt-dev), every
+// TRACE_* site compiles to a single nop plus an ELF note naming the probe and
+// where its arguments live; nothing runs until perf/bpftrace attach to it:
+//
+//   bpftrace -l 'usdt:/usr/bin/tcpserver/server:tcpserver:*'
+//   bpftrace -e 'usdt:./server:tcpserver:send_eagain { @stalls[arg0] = count(); }'
+//
+// Otherwise the macros expand to nothing and the arguments are not evaluated.
+//
+// Probes (arguments in order):
+//   epoll_wake     nfds                               epoll_wait() returned
+//   accept         fd                                 socket accepted, before admission
+//   message_start  fd, bytes                          one record handed to process_*
+//   message_end    fd, bytes                          ... and done with
+//   send_partial   fd, bytes_written, bytes_left      kernel took part of a write
+//   send_eagain    fd, bytes_written, bytes_left      socket buffer full, rest queued
+//   auth_start     fd, cmd (1 = login, 2 = register)
+//   auth_done      fd, ok, latency_us
+//   disconnect     fd, reason code, reason name       metrics::DisconnectReason
+// ============================================================================
+
+#ifdef TCPSERVER_USDT
+#include <sys/sdt.h>
+
+#define TRACE_1(name, a)          DTRACE_PROBE1(tcpserver, name, a)
+#define TRACE_2(name, a, b)       DTRACE_PROBE2(tcpserver, name, a, b)
+#define TRACE_3(name, a, b, c)    DTRACE_PROBE3(tcpserver, name, a, b, c)
+#else
+#define TRACE_1(name, a)          do {} while (0)
+#define TRACE_2(name, a, b)       do {} while (0)
+#define TRACE_3(name, a, b, c)    do {} while (0)
+#endif
@@ -0,0 +1,240 @@
+#include "traffic_capture.hpp"
+#include "common/capture_format.hpp"
+#include "common/commands.hpp"
+#include "common/protocol.hpp"
+#include "common/simd_scan.hpp"
+#include "common/Logger/logger.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int CAPTURE_FLUSH_MS = 100;                 // Max age of a queued record
+constexpr size_t CAPTURE_QUEUE_BYTES = 64u << 20;     // Queued past this → dropped
+
+uint64_t now_us()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t unix_ms()
+{
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+bool write_all(int fd, const std::string& bytes)
+{
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+        if (n > 0) { done += static_cast<size_t>(n); continue; }
+        if (n == -1 && errno == EINTR) continue;
+        return false;
+    }
+    return true;
+}
+
+// Masks what follows the command in a text line: the password after '|'
+// for /login and /register, the token for /resume. `from` is where the
+// command text starts in `out`. Leading whitespace is skipped as
+// process_message trims it, so "  /login bob|pw" is masked too.
+void mask_command(std::string& out, size_t from)
+{
+    from += simd_scan::skip_whitespace(out.data() + from, out.size() - from);
+    std::string_view text(out.data() + from, out.size() - from);
+    size_t end = text.size();
+    while (end > 0 && (text[end - 1] == '\n' || text[end - 1] == '\r')) --end;
+
+    size_t start = std::string_view::npos;
+    const commands::Match cmd = commands::lookup(text);
+    if (!cmd.has_arg) return;
+    if (cmd.id() == commands::Login || cmd.id() == commands::Register) {
+        const size_t bar = text.find('|');
+        if (bar != std::string_view::npos && bar < end) start = bar + 1;
+    } else if (cmd.id() == commands::Resume) {
+        start = static_cast<size_t>(cmd.arg.data() - text.data());
+    }
+    if (start == std::string_view::npos || start >= end) return;
+    std::memset(&out[from + start], capture_format::MASK, end - start);
+}
+
+} // namespace
+
+TrafficCapture::TrafficCapture(Logger* logger) : logger(logger)
+{
+    background = std::thread([this] { background_loop(); });
+}
+
+TrafficCapture::~TrafficCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (background.joinable()) background.join();
+
+    std::lock_guard<std::mutex> lock(file_mtx);
+    if (fd != -1) {
+        write_queued();
+        ::close(fd);
+    }
+}
+
+void TrafficCapture::set_path(const std::string& new_path)
+{
+    std::lock_guard<std::mutex> file_lock(file_mtx);
+    if (new_path == path) return;
+
+    if (fd != -1) {
+        write_queued();
+        ::close(fd);
+        fd = -1;
+        uint64_t total, lost;
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            total = records;
+            lost  = dropped;
+        }
+        if (logger) {
+            logger->Write_log("Traffic capture " + path + " stopped: " + std::to_string(total) +
+                              " records, " + std::to_string(lost) + " dropped", Logger::Info);
+        }
+    }
+
+    {
+        // Records of connections from the capture that ends are ignored from here on.
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        ++generation;
+        next_stream = 1;
+        records = dropped = 0;
+        queue.clear();
+        last_us = now_us();
+        running.store(false, std::memory_order_relaxed);
+    }
+    path = new_path;
+    if (path.empty()) return;
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1 || !write_all(fd, capture_format::header(unix_ms()))) {
+        if (logger) {
+            logger->Write_log("Traffic capture " + path + ": " + strerror(errno) + ", not capturing",
+                              Logger::Error);
+        }
+        if (fd != -1) ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        running.store(true, std::memory_order_relaxed);
+    }
+    if (logger) {
+        logger->Write_log("Traffic capture: recording connections accepted from now on into " + path,
+                          Logger::Info);
+    }
+}
+
+uint64_t TrafficCapture::open_stream()
+{
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    if (!running.load(std::memory_order_relaxed)) return 0;
+    const uint64_t stream = (generation << 32) | next_stream++;
+    append(capture_format::Open, stream, {});
+    return stream;
+}
+
+void TrafficCapture::record(uint64_t stream, std::string_view bytes, bool v2)
+{
+    if (stream == 0) return;
+    const std::string masked = mask_credentials(bytes, v2);
+
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    if ((stream >> 32) != generation || !running.load(std::memory_order_relaxed)) return;
+    append(capture_format::Data, stream, masked);
+}
+
+void TrafficCapture::close_stream(uint64_t stream)
+{
+    if (stream == 0) return;
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    if ((stream >> 32) != generation || !running.load(std::memory_order_relaxed)) return;
+    append(capture_format::Close, stream, {});
+}
+
+std::string TrafficCapture::mask_credentials(std::string_view bytes, bool v2)
+{
+    std::string out(bytes);
+    if (!v2) {
+        mask_command(out, 0);
+        return out;
+    }
+
+    protocol::FrameHeader header;
+    if (!protocol::decode_header(bytes, header)) return out; // The preamble
+    const size_t payload = protocol::HEADER_SIZE;
+    if (header.type == protocol::Register || header.type == protocol::Login) {
+        // name_len, name, password
+        if (out.size() <= payload) return out;
+        const size_t password = payload + 1 + static_cast<uint8_t>(out[payload]);
+        if (password < out.size()) std::memset(&out[password], capture_format::MASK, out.size() - password);
+    } else if (header.type == protocol::Command) {
+        mask_command(out, payload);
+    }
+    return out;
+}
+
+void TrafficCapture::append(uint8_t kind, uint64_t stream, std::string_view bytes)
+{
+    if (queue.size() + bytes.size() + 32 > CAPTURE_QUEUE_BYTES) {
+        ++dropped;
+        return;
+    }
+    const uint64_t now = now_us();
+    const uint64_t delta = now > last_us ? now - last_us : 0;
+    last_us = now > last_us ? now : last_us;
+
+    queue += static_cast<char>(kind);
+    capture_format::put_varint(queue, stream & 0xffffffffu);
+    capture_format::put_varint(queue, delta);
+    if (kind == capture_format::Data) {
+        capture_format::put_varint(queue, bytes.size());
+        queue.append(bytes.data(), bytes.size());
+    }
+    ++records;
+}
+
+void TrafficCapture::write_queued()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        if (queue.empty()) return;
+        spare.swap(queue);
+    }
+    if (fd != -1 && !write_all(fd, spare) && logger) {
+        logger->Write_log("Traffic capture " + path + ": write failed: " + strerror(errno), Logger::Warn);
+    }
+    spare.clear();
+}
+
+void TrafficCapture::background_loop()
+{
+    std::unique_lock<std::mutex> lock(queue_mtx);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(CAPTURE_FLUSH_MS));
+        if (stopping || queue.empty()) continue;
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> file_lock(file_mtx);
+            write_queued();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+class Logger;
+
+// ============================================================================
+// TrafficCapture — records what clients send, for `bench_client --replay`
+// ([ADMIN] capture_file, format in common/capture_format.hpp).
+//
+// Only connections accepted while a capture runs are recorded, from their
+// first byte, so every stream in the file can be replayed on its own. The
+// reactors hand over each record as they frame it, so TLS traffic is
+// captured decrypted, and timestamps are those of the framing (a record
+// held back by a rate limit gets the time it was let through). Passwords
+// of /login and /register (both protocols) and /resume tokens are masked
+// byte for byte before anything is queued: the sizes stay, the secrets
+// never reach the file.
+//
+// Appends copy into one queue under a mutex (like ChatLog); a background
+// thread writes it every CAPTURE_FLUSH_MS. Past CAPTURE_QUEUE_BYTES the
+// records are dropped and counted. Thread-safe.
+// ============================================================================
+class TrafficCapture {
+public:
+    explicit TrafficCapture(Logger* logger);
+
+    // Writes what is queued and closes the file.
+    ~TrafficCapture();
+
+    TrafficCapture(const TrafficCapture&) = delete;
+    TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+    // Starts a capture into `path` (truncated), or stops the current one
+    // with an empty path. Unchanged path: nothing happens. Called at start
+    // and by every reactor on reload.
+    void set_path(const std::string& path);
+
+    // One relaxed load: checked per connection at accept.
+    bool active() const { return running.load(std::memory_order_relaxed); }
+
+    // Stream id for a connection accepted now, or 0 if no capture runs.
+    uint64_t open_stream();
+
+    // One record framed from `stream` (v2: a whole frame or the preamble).
+    // Streams of an earlier capture are ignored.
+    void record(uint64_t stream, std::string_view bytes, bool v2);
+
+    // The connection of `stream` is gone.
+    void close_stream(uint64_t stream);
+
+    // Copies `bytes` with the credentials masked (see the class comment).
+    static std::string mask_credentials(std::string_view bytes, bool v2);
+
+private:
+    // Encodes one record into `queue` (caller holds queue_mtx).
+    void append(uint8_t kind, uint64_t stream, std::string_view bytes);
+
+    // Writes `queue` to the file (caller holds file_mtx, not queue_mtx).
+    void write_queued();
+
+    void background_loop();
+
+    Logger* logger{nullptr};         // Non-owning, may be null
+    std::atomic<bool> running{false};
+
+    std::mutex file_mtx;             // Guards fd, path, and serializes writers
+    int fd{-1};
+    std::string path;
+
+    std::mutex queue_mtx;            // Guards everything below
+    std::condition_variable wake;
+    std::string queue;               // Encoded records waiting for the writer
+    std::string spare;               // The writer's previous buffer (kept for its capacity)
+    uint64_t generation{0};          // Bumped by every capture started
+    uint64_t next_stream{1};         // Of the current capture
+    uint64_t last_us{0};             // Time of the last record queued
+    uint64_t records{0};             // Of the current capture
+    uint64_t dropped{0};
+    bool stopping{false};
+    std::thread background;
+};
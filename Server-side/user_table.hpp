@@ -0,0 +1,102 @@
+#pragma once
+
+// uint32_t — user ids
+#include <cstdint>
+// size_t
+#include <cstddef>
+// Stable storage for the interned strings
+#include <deque>
+// std::string — one allocation per interned name
+#include <string>
+// std::string_view — index keys pointing into the stored strings
+#include <string_view>
+// name → id index
+#include <unordered_map>
+// Free ids
+#include <vector>
+
+// Compact handle of an interned username; NO_USER means "not logged in".
+using UserId = uint32_t;
+constexpr UserId NO_USER = 0;
+
+// ============================================================================
+// UserTable — interned usernames, one entry per distinct name in use on
+// this reactor, addressed by a small UserId.
+//
+// Each name is stored once, as the chat prefix "name: " that every relayed
+// message starts with; name() is a view of the same bytes. Entries are
+// reference counted (the online shard and each local session hold one) and
+// their ids are recycled once the count drops to zero. Ids are local to a
+// reactor: cross-reactor messages still carry the name itself.
+// ============================================================================
+class UserTable {
+public:
+    // Id for `name`, interning it if needed; takes one reference.
+    UserId acquire(std::string_view name)
+    {
+        UserId id = find(name);
+        if (id != NO_USER) {
+            ++entry(id).refs;
+            return id;
+        }
+
+        if (!free_ids.empty()) {
+            id = free_ids.back();
+            free_ids.pop_back();
+        } else {
+            entries.emplace_back();
+            id = static_cast<UserId>(entries.size()); // Ids start at 1
+        }
+
+        Entry& e = entry(id);
+        e.prefix.assign(name.data(), name.size()).append(": ");
+        e.refs = 1;
+        index.emplace(this->name(id), id);
+        return id;
+    }
+
+    // Existing id of `name`, or NO_USER. Never interns.
+    UserId find(std::string_view name) const
+    {
+        auto it = index.find(name);
+        return it == index.end() ? NO_USER : it->second;
+    }
+
+    // Drops one reference; the last one frees the entry and its id.
+    void release(UserId id)
+    {
+        if (id == NO_USER || id > entries.size()) return;
+        Entry& e = entry(id);
+        if (e.refs == 0 || --e.refs > 0) return;
+
+        index.erase(name(id));
+        std::string().swap(e.prefix);
+        free_ids.push_back(id);
+    }
+
+    // The interned name (valid while the id holds a reference).
+    std::string_view name(UserId id) const
+    {
+        const std::string& p = entry(id).prefix;
+        return std::string_view(p.data(), p.size() - 2);
+    }
+
+    // "name: " — the precomputed start of a relayed v1 chat line.
+    const std::string& chat_prefix(UserId id) const { return entry(id).prefix; }
+
+    // Distinct names currently interned.
+    size_t size() const { return index.size(); }
+
+private:
+    struct Entry {
+        std::string prefix; // "name: "; empty while the id is free
+        uint32_t refs{0};
+    };
+
+    Entry&       entry(UserId id)       { return entries[id - 1]; }
+    const Entry& entry(UserId id) const { return entries[id - 1]; }
+
+    std::deque<Entry> entries;                         // Index id-1; never relocates strings
+    std::vector<UserId> free_ids;                      // Released ids, reused first
+    std::unordered_map<std::string_view, UserId> index; // Views into entries[].prefix
+};
@@ -0,0 +1,111 @@
+// Credential DB: the startup JSON load behind verify_credentials(), the
+// per-auth index lookup and the negative check for unknown names.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "Server-side/credential_store.hpp"
+
+namespace {
+
+// Temporary directory holding a credentials.json with `users` accounts.
+class CredentialFixture {
+public:
+    explicit CredentialFixture(size_t users)
+    {
+        char tmpl[] = "/tmp/tcpserver-bench-XXXXXX";
+        if (mkdtemp(tmpl)) dir = tmpl;
+        path = dir + "/credentials.json";
+
+        nlohmann::json data;
+        data["users"] = nlohmann::json::array();
+        for (size_t i = 0; i < users; ++i) {
+            data["users"].push_back({
+                {"username", "user" + std::to_string(i)},
+                // Realistic length for an encoded Argon2id string
+                {"password", "$argon2id$v=19$m=65536,t=2,p=1$c2FsdHNhbHRzYWx0c2FsdA$"
+                             "aGFzaGhhc2hoYXNoaGFzaGhhc2hoYXNoaGFzaGhhc2g"},
+                {"IP_source", "127.0.0.1"},
+                {"created_at", "2024-01-01T00:00:00Z"},
+            });
+        }
+        std::ofstream(path) << data.dump(4);
+    }
+
+    ~CredentialFixture()
+    {
+        std::remove((path + ".journal").c_str());
+        std::remove(path.c_str());
+        rmdir(dir.c_str());
+    }
+
+    bool ok() const { return !dir.empty(); }
+
+    std::string dir;
+    std::string path;
+};
+
+void BM_CredentialLoad(benchmark::State& state)
+{
+    const size_t users = static_cast<size_t>(state.range(0));
+    CredentialFixture fixture(users);
+    if (!fixture.ok()) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto store = std::make_unique<CredentialStore>(fixture.path);
+        benchmark::DoNotOptimize(store->load());
+        state.PauseTiming(); // Stopping the background thread isn't part of the load
+        store.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(users));
+}
+BENCHMARK(BM_CredentialLoad)->Arg(100)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+void BM_CredentialLookup(benchmark::State& state)
+{
+    const size_t users = static_cast<size_t>(state.range(0));
+    CredentialFixture fixture(users);
+    CredentialStore store(fixture.path);
+    if (!fixture.ok() || !store.load()) {
+        state.SkipWithError("credential fixture unreadable");
+        return;
+    }
+
+    std::string hash;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store.find_hash("user" + std::to_string(i++ % users), hash));
+    }
+}
+BENCHMARK(BM_CredentialLookup)->Arg(100)->Arg(10000);
+
+// /register of a fresh name: answered by the Bloom filter, not the index.
+void BM_CredentialMiss(benchmark::State& state)
+{
+    const size_t users = static_cast<size_t>(state.range(0));
+    CredentialFixture fixture(users);
+    CredentialStore store(fixture.path);
+    if (!fixture.ok() || !store.load()) {
+        state.SkipWithError("credential fixture unreadable");
+        return;
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store.contains("newuser" + std::to_string(i++)));
+    }
+}
+BENCHMARK(BM_CredentialMiss)->Arg(100)->Arg(10000);
+
+} // namespace
@@ -0,0 +1,128 @@
+// Hot input-handling helpers: auth parsing, whitespace trimming and the
+// per-record framing every client read goes through.
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/input.hpp"
+#include "common/protocol.hpp"
+#include "common/read_buffer.hpp"
+
+namespace {
+
+void BM_ParseCredentials_Login(benchmark::State& state)
+{
+    const std::string line = "/login alice|correct horse battery staple";
+    temp_user_credentials out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parse_credentials(std::string_view(line), out));
+        benchmark::DoNotOptimize(out.username.data());
+    }
+}
+BENCHMARK(BM_ParseCredentials_Login);
+
+void BM_ParseCredentials_Chat(benchmark::State& state)
+{
+    // The common case: an ordinary chat line that is not an auth command.
+    const std::string line = "hello everyone, how is it going today?";
+    temp_user_credentials out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parse_credentials(std::string_view(line), out));
+    }
+}
+BENCHMARK(BM_ParseCredentials_Chat);
+
+// Record of `length` bytes with a little surrounding whitespace.
+std::string padded_record(size_t length)
+{
+    return "  " + std::string(length, 'a') + " \r\n";
+}
+
+void BM_TrimBuffer_InPlace(benchmark::State& state)
+{
+    const std::string record = padded_record(static_cast<size_t>(state.range(0)));
+    std::vector<char> buf(record.size() + 1);
+    for (auto _ : state) {
+        std::copy(record.begin(), record.end(), buf.begin());
+        benchmark::DoNotOptimize(trimBuffer(buf.data(), static_cast<ssize_t>(record.size())));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(record.size()));
+}
+BENCHMARK(BM_TrimBuffer_InPlace)->Arg(16)->Arg(256)->Arg(4096);
+
+void BM_TrimBuffer_View(benchmark::State& state)
+{
+    const std::string record = padded_record(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(trimBuffer(std::string_view(record)));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(record.size()));
+}
+BENCHMARK(BM_TrimBuffer_View)->Arg(16)->Arg(256)->Arg(4096);
+
+void BM_IsBufferEmpty(benchmark::State& state)
+{
+    // Worst case: all whitespace, so every byte is scanned.
+    const std::string blank(static_cast<size_t>(state.range(0)), ' ');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(isBufferEmpty(std::string_view(blank)));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_IsBufferEmpty)->Arg(16)->Arg(256)->Arg(4096);
+
+// One recv() worth of newline-delimited records, drained the way the
+// reactor does it: append, then next_line() + trim until nothing is left.
+void BM_LineFraming(benchmark::State& state)
+{
+    const size_t records = static_cast<size_t>(state.range(0));
+    std::string batch;
+    for (size_t i = 0; i < records; ++i) batch += "message number " + std::to_string(i) + "\n";
+
+    ReadBuffer buffer(64 * 1024);
+    for (auto _ : state) {
+        char* dst = buffer.write_ptr(batch.size());
+        std::copy(batch.begin(), batch.end(), dst);
+        buffer.commit(batch.size());
+
+        std::string_view line;
+        while (buffer.next_line(line)) {
+            benchmark::DoNotOptimize(trimBuffer(line));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(records));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(batch.size()));
+}
+BENCHMARK(BM_LineFraming)->Arg(1)->Arg(16)->Arg(256);
+
+// Same for protocol v2 frames.
+void BM_FrameFraming(benchmark::State& state)
+{
+    const size_t records = static_cast<size_t>(state.range(0));
+    std::string batch;
+    for (size_t i = 0; i < records; ++i) {
+        batch += protocol::make_frame(protocol::Chat, "message number " + std::to_string(i));
+    }
+
+    ReadBuffer buffer(64 * 1024);
+    for (auto _ : state) {
+        char* dst = buffer.write_ptr(batch.size());
+        std::copy(batch.begin(), batch.end(), dst);
+        buffer.commit(batch.size());
+
+        protocol::FrameHeader h;
+        std::string_view frame;
+        while (protocol::decode_header(buffer.view(), h) &&
+               buffer.take(protocol::HEADER_SIZE + h.length, frame)) {
+            benchmark::DoNotOptimize(frame.data());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(records));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(batch.size()));
+}
+BENCHMARK(BM_FrameFraming)->Arg(1)->Arg(16)->Arg(256);
+
+} // namespace
@@ -0,0 +1,80 @@
+// Logger front end: what a reactor pays per Write_log(), with and without
+// the file sink, in async and synchronous mode.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <unistd.h>
+
+#include "common/Logger/logger.hpp"
+
+namespace {
+
+// Swallows the journald (stdout) sink so the report stays readable.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Redirects std::cout for the lifetime of the object.
+class MuteStdout {
+public:
+    MuteStdout() : saved(std::cout.rdbuf(&sink)) {}
+    ~MuteStdout() { std::cout.rdbuf(saved); }
+
+private:
+    NullBuffer sink;
+    std::streambuf* saved;
+};
+
+// range(0): 1 = file + journald, 0 = journald only. range(1): async writer.
+void BM_WriteLog(benchmark::State& state)
+{
+    char dir[] = "/tmp/tcpserver-bench-XXXXXX";
+    if (!mkdtemp(dir)) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+
+    ServerConfig config;
+    config.LogPath             = std::string(dir) + "/log.txt";
+    config.Run_without_logging = state.range(0) == 0;
+    config.logAsync            = state.range(1) != 0;
+
+    const std::string message = "Client 127.0.0.1:51234 authenticated as alice";
+    uint64_t dropped = 0;
+    {
+        MuteStdout mute; // Covers the writer thread's output too
+        Logger logger(config);
+        for (auto _ : state) {
+            logger.Write_log(message, Logger::Info);
+        }
+        logger.Shutdown(); // Drain inside the muted scope
+        dropped = logger.DroppedCount();
+    }
+    state.counters["dropped"] = static_cast<double>(dropped);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+
+    unlink(config.LogPath.c_str());
+    rmdir(dir);
+}
+BENCHMARK(BM_WriteLog)
+    ->ArgNames({"file", "async"})
+    ->Args({1, 1})
+    ->Args({1, 0})
+    ->Args({0, 1})
+    ->Args({0, 0});
+
+void BM_GetTime(benchmark::State& state)
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Logger::getTime());
+    }
+}
+BENCHMARK(BM_GetTime);
+
+} // namespace
@@ -0,0 +1,115 @@
+#include "journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace journal {
+
+namespace {
+
+// sendmmsg() batch: one entry per datagram, this many per syscall.
+constexpr size_t DATAGRAMS_PER_CALL = 64;
+
+// What journald's own clients ask for, so a burst doesn't block the writer
+// on a full socket buffer (best effort: capped by net.core.wmem_max).
+constexpr int SEND_BUFFER_BYTES = 8 * 1024 * 1024;
+
+} // namespace
+
+int connect_socket(const char* path)
+{
+    int sock = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock == -1) return -1;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (::connect(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1) {
+        ::close(sock);
+        return -1;
+    }
+
+    const int size = SEND_BUFFER_BYTES;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    return sock;
+}
+
+void Batch::field(std::string_view name, std::string_view value)
+{
+    bytes.append(name.data(), name.size());
+    if (value.find('\n') == std::string_view::npos) {
+        bytes += '=';
+        bytes.append(value.data(), value.size());
+    } else {
+        // Binary-safe form: name, newline, little-endian length, bytes.
+        bytes += '\n';
+        uint64_t length = value.size();
+        for (int i = 0; i < 8; ++i) bytes += static_cast<char>((length >> (8 * i)) & 0xff);
+        bytes.append(value.data(), value.size());
+    }
+    bytes += '\n';
+}
+
+void Batch::add(int priority, std::string_view message, const char* event, int fd,
+                std::string_view client_ip, std::string_view username)
+{
+    char digits[16];
+
+    field("MESSAGE", message);
+    const auto prio_end = std::to_chars(digits, digits + sizeof(digits), priority).ptr;
+    field("PRIORITY", std::string_view(digits, static_cast<size_t>(prio_end - digits)));
+    field("SYSLOG_IDENTIFIER", program_invocation_short_name);
+    if (event) field("EVENT", event);
+    if (fd >= 0) {
+        const auto fd_end = std::to_chars(digits, digits + sizeof(digits), fd).ptr;
+        field("FD", std::string_view(digits, static_cast<size_t>(fd_end - digits)));
+    }
+    if (!client_ip.empty()) field("CLIENT_IP", client_ip);
+    if (!username.empty()) field("USERNAME", username);
+    ends.push_back(bytes.size());
+}
+
+size_t Batch::send(int sock)
+{
+    size_t sent = 0;
+    size_t next = 0; // Index of the first entry not sent yet
+
+    while (next < ends.size()) {
+        iovec iov[DATAGRAMS_PER_CALL];
+        mmsghdr msgs[DATAGRAMS_PER_CALL];
+        const size_t count = std::min(DATAGRAMS_PER_CALL, ends.size() - next);
+        for (size_t i = 0; i < count; ++i) {
+            const size_t begin = next + i == 0 ? 0 : ends[next + i - 1];
+            iov[i].iov_base = bytes.data() + begin;
+            iov[i].iov_len  = ends[next + i] - begin;
+            msgs[i] = mmsghdr{};
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = ::sendmmsg(sock, msgs, static_cast<unsigned>(count), MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            next += static_cast<size_t>(n);
+            continue;
+        }
+        if (n == -1 && errno == EINTR) continue;
+        // The first datagram was refused (EMSGSIZE: larger than journald
+        // takes, or journald went away): skip it and go on with the rest.
+        if (n == -1 && errno == EMSGSIZE) {
+            ++next;
+            continue;
+        }
+        break;
+    }
+
+    clear();
+    return sent;
+}
+
+} // namespace journal
@@ -0,0 +1,58 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+// std::string — datagram bytes
+#include <string>
+// std::string_view — field values
+#include <string_view>
+// std::vector — entry boundaries
+#include <vector>
+
+// ============================================================================
+// journal — journald's native protocol, as sd_journal_sendv() speaks it,
+// without linking libsystemd.
+//
+// Every entry is one datagram on /run/systemd/journal/socket holding
+// "FIELD=value\n" lines (a value containing '\n' is sent as "FIELD\n",
+// its length as 64-bit little endian, the bytes and "\n"). journald indexes
+// every field, so `journalctl EVENT=disconnect CLIENT_IP=10.0.0.7` is a
+// lookup instead of a full-text search over MESSAGE.
+// ============================================================================
+namespace journal {
+
+constexpr const char* SOCKET_PATH = "/run/systemd/journal/socket";
+
+// A connected datagram socket to journald, or -1 if it isn't running
+// (not started by systemd, or a container without the socket).
+int connect_socket(const char* path = SOCKET_PATH);
+
+// Entries waiting to be sent. Appending keeps the buffers' capacity, so a
+// warm batch allocates nothing.
+class Batch {
+public:
+    // Appends one entry. MESSAGE, PRIORITY and SYSLOG_IDENTIFIER are always
+    // set; EVENT, FD, CLIENT_IP and USERNAME only when given (null / -1 /
+    // empty means absent).
+    void add(int priority, std::string_view message, const char* event, int fd,
+             std::string_view client_ip, std::string_view username);
+
+    bool empty() const { return ends.empty(); }
+    size_t entries() const { return ends.size(); }
+    size_t size() const { return bytes.size(); }
+
+    // Sends every entry on `sock` (sendmmsg(), many datagrams per call) and
+    // clears the batch. Entries journald refused are dropped, not retried.
+    // Returns how many were sent.
+    size_t send(int sock);
+
+    void clear() { bytes.clear(); ends.clear(); }
+
+private:
+    void field(std::string_view name, std::string_view value);
+
+    std::string bytes;         // Every entry, back to back
+    std::vector<size_t> ends;  // End offset of each entry in `bytes`
+};
+
+} // namespace journal
@@ -1,11 +1,19 @@
 #include "logger.hpp"
-#include <iomanip>
-#include <sstream>
 #include <ctime>
 #include <stdexcept>
 #include <iostream>
 #include <syslog.h>
 #include <unistd.h>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+
+// Serializes both sinks across threads (and across Logger instances, since
+// several reactors may each own one that shares stdout and the log file).
+static std::mutex sink_mutex;
 
 // ============================================================================
 // Constructor — copies config values, then tries to open the file sink
@@ -15,11 +23,14 @@ Logger::Logger(const ServerConfig& config)
     : logPath(config.LogPath),
       runWithoutLogging(config.Run_without_logging)
 {
+    setJournal(config.logJournalNative); // No other thread logs yet: no lock needed
+
     // Logging off → doesn't open the file, but journald (stdout) stays active.
     if (runWithoutLogging) {
         std::cout << "<" << LOG_INFO << ">[INFO]: file logging disabled, "
                      "journald only\n";
         std::cout.flush(); // Ensure the message reaches journald immediately
+        startWriter(config);
         return;
     }
 
@@ -32,36 +43,137 @@ Logger::Logger(const ServerConfig& config)
         sleep(1); // Wait 1s before retrying
     }
 
+    fileActive.store(LogFile.is_open(), std::memory_order_relaxed);
+
     // File failed after all retries: does NOT abort — degrades to journald-only.
     if (!LogFile.is_open()) {
         std::cout << "<" << LOG_WARNING << ">[WARN]: could not open log file: "
                   << logPath << " — continuing with journald only\n";
         std::cout.flush();
     }
+
+    startWriter(config);
 }
 
-// Formats the current local time as "YYYY-MM-DD HH:MM:SS+HHMM" (ISO-8601-like
-// with UTC offset). Uses localtime_r for thread-safety (vs. localtime()).
-std::string Logger::getTime() {
-    std::time_t now = std::time(nullptr);
+// Sizes the ring and starts the writer thread, unless async logging is off.
+void Logger::startWriter(const ServerConfig& config)
+{
+    if (!config.logAsync) return;
+
+    // Round the capacity up to a power of two so slot = pos & mask.
+    size_t capacity = 2;
+    while (capacity < static_cast<size_t>(config.logQueueSize)) capacity <<= 1;
+
+    ring.reset(new Record[capacity]);
+    ringMask = capacity - 1;
+    for (size_t i = 0; i < capacity; ++i) ring[i].seq.store(i, std::memory_order_relaxed);
+
+    blockOnOverflow = config.logOverflowBlock;
+    flushIntervalMs = config.logFlushMs > 0 ? config.logFlushMs : 1;
+    flushBytes      = config.logFlushBytes > 0 ? static_cast<size_t>(config.logFlushBytes) : 1;
+    outBatch.reserve(flushBytes);
+    fileBatch.reserve(flushBytes);
+
+    accepting.store(true, std::memory_order_release);
+    writer = std::thread([this] { writer_loop(); });
+}
+
+// One file sink at a time: the old file is closed (anything already batched
+// for it goes to the new one) and the new path opened once, without the
+// boot-time retries.
+void Logger::Reconfigure(const ServerConfig& config)
+{
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        if (config.LogPath != logPath || config.Run_without_logging != runWithoutLogging) {
+            if (LogFile.is_open()) LogFile.close();
+            logPath           = config.LogPath;
+            runWithoutLogging = config.Run_without_logging;
+            if (!runWithoutLogging) LogFile.open(logPath, std::ios::app);
+            fileActive.store(LogFile.is_open(), std::memory_order_relaxed);
+
+            if (!runWithoutLogging && !LogFile.is_open()) {
+                std::cout << "<" << LOG_WARNING << ">[WARN]: could not open log file: "
+                          << logPath << " — continuing with journald only\n";
+                std::cout.flush();
+            }
+        }
+        if (config.logJournalNative != journalNative) setJournal(config.logJournalNative);
+    }
+
+    blockOnOverflow.store(config.logOverflowBlock, std::memory_order_relaxed);
+    flushIntervalMs.store(config.logFlushMs > 0 ? config.logFlushMs : 1, std::memory_order_relaxed);
+    flushBytes.store(config.logFlushBytes > 0 ? static_cast<size_t>(config.logFlushBytes) : 1,
+                     std::memory_order_relaxed);
+}
+
+void Logger::setJournal(bool native) {
+    journalNative = native;
+    if (!native) {
+        if (journalFd != -1) ::close(journalFd);
+        journalFd = -1;
+    } else if (journalFd == -1) {
+        journalFd = journal::connect_socket();
+        if (journalFd == -1) {
+            std::cout << "<" << LOG_WARNING << ">[WARN]: journal_native: no journald socket at "
+                      << journal::SOCKET_PATH << " — logging to stdout\n";
+            std::cout.flush();
+        }
+    }
+    journalActive.store(journalFd != -1, std::memory_order_relaxed);
+}
+
+void Logger::sendJournal(journal::Batch& batch) {
+    const size_t entries = batch.entries();
+    if (journalFd == -1) {
+        batch.clear(); // Turned off by Reconfigure() after these were formatted
+        return;
+    }
+    if (batch.send(journalFd) < entries && (errno == ECONNREFUSED || errno == ENOTCONN)) {
+        // journald was restarted: its new socket needs a new connection.
+        ::close(journalFd);
+        journalFd = journal::connect_socket();
+        journalActive.store(journalFd != -1, std::memory_order_relaxed);
+    }
+}
+
+// Formats a time as "YYYY-MM-DD HH:MM:SS+HHMM" (ISO-8601-like with UTC
+// offset) into `out`. localtime_r for thread-safety (vs. localtime()).
+static void formatTime(std::time_t when, char* out, size_t size) {
     std::tm local_time;
-    localtime_r(&now, &local_time);
+    localtime_r(&when, &local_time);
+    if (std::strftime(out, size, "%Y-%m-%d %H:%M:%S%z", &local_time) == 0) out[0] = '\0';
+}
+
+// localtime_r() takes the timezone lock and strftime() walks the format on
+// every call; a log line only needs them when the second has changed.
+const char* Logger::cachedTime(std::time_t when) {
+    thread_local std::time_t second = -1;
+    thread_local char stamp[40];
+    if (when != second) {
+        formatTime(when, stamp, sizeof(stamp));
+        second = when;
+    }
+    return stamp;
+}
 
-    std::stringstream ss;
-    ss << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S%z"); // ISO-8601 + offset
-    return ss.str();
+// Current local time, same format as the file sink timestamps.
+std::string Logger::getTime() {
+    return cachedTime(std::time(nullptr));
 }
 
-// Closes the file sink cleanly, if it was open.
+// Drains the writer, then closes the file sink cleanly, if it was open.
 Logger::~Logger() {
+    Shutdown();
     if (LogFile.is_open())
         LogFile.close();
+    if (journalFd != -1) ::close(journalFd);
 }
 
 // journald (stdout) sink is considered always-on and independent of this flag;
 // this only reflects whether the file sink is currently open.
 bool Logger::IsFileLoggingActive() const {
-    return LogFile.is_open();
+    return fileActive.load(std::memory_order_relaxed);
 }
 
 // Translates our internal LogType into the matching syslog priority constant,
@@ -87,23 +199,228 @@ const char* Logger::prefix(LogType type) const {
 
 // Writes a single log entry to both sinks:
 //   1) stdout, prefixed with "<priority>" so journald assigns correct severity
-//      — always executed, regardless of file sink state.
+//      — always executed, regardless of file sink state (or journald's
+//      socket directly, with `event`'s fields, when journal_native is on).
 //   2) the log file, only if it's currently open — includes a timestamp since
 //      journald already timestamps entries on its own.
-void Logger::Write_log(const std::string& message, LogType type) {
+// Async mode hands the entry to the writer thread instead; the synchronous
+// path remains for async_logging=false and after Shutdown().
+void Logger::Write_log(std::string_view message, LogType type, const Event& event) {
+    if (ring) {
+        // inFlight is raised BEFORE checking `accepting`, so Shutdown() can
+        // wait for every producer that saw it true to finish publishing.
+        inFlight.fetch_add(1, std::memory_order_seq_cst);
+        if (accepting.load(std::memory_order_seq_cst)) {
+            enqueue(message, type, event);
+            inFlight.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        inFlight.fetch_sub(1, std::memory_order_release);
+    }
+
+    write_now(message, type, std::time(nullptr), event);
+}
+
+// Synchronous write of one entry (one flush per sink).
+void Logger::write_now(std::string_view message, LogType type, std::time_t when, const Event& event) {
+    std::lock_guard<std::mutex> lock(sink_mutex);
+
     // 1) journald — always
-    std::cout << "<" << syslogPriority(type) << ">"
-              << prefix(type) << ": " << message << "\n";
-    std::cout.flush(); // Avoid buffering delays for time-sensitive log lines
+    if (journalFd != -1) {
+        syncJournal.add(syslogPriority(type), message, event.name, event.fd, event.client_ip, event.username);
+        sendJournal(syncJournal);
+    } else {
+        std::cout << "<" << syslogPriority(type) << ">"
+                  << prefix(type) << ": " << message << "\n";
+        std::cout.flush(); // Avoid buffering delays for time-sensitive log lines
+    }
 
     // 2) file — only if open
     if (IsFileLoggingActive()) {
-        LogFile << getTime() << " " << prefix(type) << ": "
+        LogFile << cachedTime(when) << " " << prefix(type) << ": "
                 << message << std::endl; // std::endl flushes after each entry
     }
 }
 
-// Returns the log file path resolved from config at construction time.
+// Bounded MPMC enqueue (Vyukov). Producers race on enqueuePos with a CAS;
+// the winner owns the slot until it publishes seq = pos + 1.
+bool Logger::enqueue(std::string_view message, LogType type, const Event& event) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Record* slot;
+
+    while (true) {
+        slot = &ring[pos & ringMask];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // Ring full: the writer hasn't released this slot yet.
+            if (!blockOnOverflow.load(std::memory_order_relaxed)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed); // Lost the race; retry
+        }
+    }
+
+    slot->type = type;
+    slot->when = std::time(nullptr);
+    slot->message.assign(message); // Reuses the slot's capacity
+    slot->event = event.name;
+    slot->fd    = event.fd;
+    const size_t ip_len = std::min(event.client_ip.size(), sizeof(slot->clientIp) - 1);
+    std::memcpy(slot->clientIp, event.client_ip.data(), ip_len);
+    slot->clientIp[ip_len] = '\0';
+    slot->username.assign(event.username);
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // Only pay for the wake-up when the writer is actually asleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+    return true;
+}
+
+// Appends one formatted record to the pending batches.
+void Logger::append_record(LogType type, std::time_t when, std::string_view message, const Event& event) {
+    if (IsJournalActive()) {
+        journalBatch.add(syslogPriority(type), message, event.name, event.fd, event.client_ip, event.username);
+    } else {
+        outBatch += '<';
+        outBatch += static_cast<char>('0' + syslogPriority(type)); // LOG_EMERG..LOG_DEBUG: one digit
+        outBatch += '>';
+        outBatch += prefix(type);
+        outBatch += ": ";
+        outBatch += message;
+        outBatch += '\n';
+    }
+
+    if (IsFileLoggingActive()) {
+        fileBatch += cachedTime(when);
+        fileBatch += ' ';
+        fileBatch += prefix(type);
+        fileBatch += ": ";
+        fileBatch += message;
+        fileBatch += '\n';
+    }
+}
+
+// One write + one flush per sink for the whole batch.
+void Logger::flush_batches() {
+    if (outBatch.empty() && fileBatch.empty() && journalBatch.empty()) return;
+
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    if (!journalBatch.empty()) sendJournal(journalBatch);
+    if (!outBatch.empty()) {
+        std::cout.write(outBatch.data(), static_cast<std::streamsize>(outBatch.size()));
+        std::cout.flush();
+        outBatch.clear();
+    }
+    if (!fileBatch.empty()) {
+        if (LogFile.is_open()) { // Reconfigure() may have turned the file sink off
+            LogFile.write(fileBatch.data(), static_cast<std::streamsize>(fileBatch.size()));
+            LogFile.flush();
+        }
+        fileBatch.clear();
+    }
+}
+
+// Writer thread: drains whatever is published, then flushes when the batch
+// is big enough, old enough, or holds an Error. Sleeps only when idle.
+void Logger::writer_loop() {
+    using clock = std::chrono::steady_clock;
+    auto last_flush = clock::now();
+    bool urgent = false;
+
+    while (true) {
+        // Re-read each pass: Reconfigure() may change both.
+        const auto interval = std::chrono::milliseconds(flushIntervalMs.load(std::memory_order_relaxed));
+        const size_t batch_bytes = flushBytes.load(std::memory_order_relaxed);
+        size_t drained = 0;
+        while (true) {
+            Record& slot = ring[dequeuePos & ringMask];
+            if (slot.seq.load(std::memory_order_acquire) != dequeuePos + 1) break;
+
+            append_record(slot.type, slot.when, slot.message,
+                          Event{slot.event, slot.fd, slot.clientIp, slot.username});
+            if (slot.type == Error) urgent = true;
+            slot.message.clear();
+            slot.seq.store(dequeuePos + ringMask + 1, std::memory_order_release);
+            ++dequeuePos;
+            ++drained;
+
+            if (outBatch.size() + journalBatch.size() >= batch_bytes) {
+                flush_batches();
+                last_flush = clock::now();
+            }
+        }
+
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != droppedReported) {
+            append_record(Warn, std::time(nullptr),
+                          "Logger queue full: dropped " + std::to_string(lost - droppedReported) +
+                          " records (" + std::to_string(lost) + " total)", Event{"log_dropped"});
+            droppedReported = lost;
+        }
+
+        auto now = clock::now();
+        if (urgent || now - last_flush >= interval) {
+            flush_batches();
+            last_flush = now;
+            urgent = false;
+        }
+
+        if (drained > 0) continue;
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        if (stopWriter) {
+            lock.unlock();
+            // Shutdown() guarantees no producer is mid-publish any more, so one
+            // last pass picks up everything that is still queued.
+            if (ring[dequeuePos & ringMask].seq.load(std::memory_order_acquire) == dequeuePos + 1)
+                continue;
+            flush_batches();
+            return;
+        }
+
+        writerIdle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pending = ring[dequeuePos & ringMask].seq.load(std::memory_order_relaxed) == dequeuePos + 1;
+        if (!pending) {
+            // Unflushed records wake us at their deadline; otherwise sleep a full interval.
+            auto deadline = (outBatch.empty() && fileBatch.empty() && journalBatch.empty()) ? now + interval
+                                                                    : last_flush + interval;
+            wake.wait_until(lock, deadline);
+        }
+        writerIdle.store(false, std::memory_order_relaxed);
+    }
+}
+
+// Stops accepting, waits out producers that are mid-publish, then lets the
+// writer drain and flush the ring before joining it.
+void Logger::Shutdown() {
+    if (!ring || !accepting.exchange(false, std::memory_order_seq_cst)) return;
+
+    while (inFlight.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopWriter = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) writer.join();
+}
+
+// Returns the log file path currently in use.
 std::string Logger::getPath() const {
+    std::lock_guard<std::mutex> lock(sink_mutex);
     return logPath;
 }
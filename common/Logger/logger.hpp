@@ -1,15 +1,59 @@
 #pragma once
 
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
-#include "common/config/Configuration.hpp" // ServerConfig (LogPath, Run_without_logging)
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include "common/config/Configuration.hpp" // ServerConfig (LogPath, Run_without_logging, async knobs)
+#include "journal.hpp"
 
 // Logger — dual-sink logger: always writes to stdout (captured by
 // journald/systemd via the "<priority>" prefix convention), and optionally
 // mirrors to a log file. Degrades gracefully if the file sink fails to open.
+//
+// Async mode ([LOGS] async_logging, default on): Write_log() only copies the
+// message into a bounded lock-free ring and returns. A background thread
+// formats the records, batches them and writes/flushes each sink once per
+// batch (when log_flush_bytes accumulate, log_flush_ms elapse, or an Error
+// is logged). A full ring either drops the record or blocks the caller
+// (log_overflow), and drops are counted and reported in the log itself.
+// Shutdown() (also run by the destructor) drains and flushes everything.
+// Reconfigure() applies a reloaded config (SIGHUP) to the running logger.
+//
+// Hot paths log through the variadic Write_log(type, pieces...): the pieces
+// are appended into a thread-local buffer (integers via std::to_chars), so
+// once that buffer and the ring slots have grown no allocation happens, e.g.
+//   log.Write_log(Logger::Info, "Client disconnected fd=", fd);
+// Timestamps are formatted once per second per thread (see cachedTime()).
+//
+// Native journal ([LOGS] journal_native): instead of "<priority>" lines on
+// stdout, each entry goes to journald as one datagram of fields, with the
+// Event's EVENT=, FD=, CLIENT_IP= and USERNAME= next to MESSAGE=, so
+//   journalctl -u tcpserver EVENT=disconnect CLIENT_IP=10.0.0.7
+// is an indexed lookup. The writer sends a batch with a few sendmmsg()
+// calls; without journald (no socket) the stdout sink stays in use.
+// Structured fields of one entry (native journal sink only; the text sinks
+// log the message alone). Absent: null / -1 / empty. Logger::Event.
+struct LogEvent {
+    const char* name{nullptr};     // EVENT=, a string literal (kept by pointer)
+    int fd{-1};                    // FD=
+    std::string_view client_ip{};  // CLIENT_IP=
+    std::string_view username{};   // USERNAME=
+};
+
 class Logger {
 public:
-    // Builds the logger from config; opens the log file unless logging is off.
+    // Builds the logger from config; opens the log file unless logging is off
+    // and starts the writer thread in async mode.
     explicit Logger(const ServerConfig& config);
 
     // Severity levels, mapped to syslog priorities internally.
@@ -19,11 +63,51 @@ public:
         Error
     };
 
+    using Event = LogEvent;
+
     // True only if the log FILE sink is currently open (journald is independent).
     bool IsFileLoggingActive() const;   // renamed from: IsLoggingEnabled
 
     // Writes one entry to journald (always) and to the file (if open).
-    void Write_log(const std::string& message, LogType type);
+    // Async mode: enqueues it; safe to call from any thread.
+    void Write_log(std::string_view message, LogType type, const Event& event = Event{});
+
+    // Same, with the message concatenated from `pieces`: anything that
+    // converts to std::string_view, a char, or an integer.
+    template <typename... Pieces>
+    void Write_log(LogType type, const Pieces&... pieces)
+    {
+        std::string& line = scratch();
+        line.clear();
+        (append_piece(line, pieces), ...);
+        Write_log(std::string_view(line), type);
+    }
+
+    // Same, with the journal fields of `event`.
+    template <typename... Pieces>
+    void Write_log(LogType type, const Event& event, const Pieces&... pieces)
+    {
+        std::string& line = scratch();
+        line.clear();
+        (append_piece(line, pieces), ...);
+        Write_log(std::string_view(line), type, event);
+    }
+
+    // True while entries go to journald's native socket instead of stdout.
+    bool IsJournalActive() const { return journalActive.load(std::memory_order_relaxed); }
+
+    // Stops the writer thread after every queued record has been written and
+    // flushed. Later Write_log() calls write synchronously. Idempotent.
+    void Shutdown();
+
+    // Applies the [LOGS] settings that can change at runtime: LogPath and
+    // Run_Without_file_logging (the file sink is reopened if either
+    // changed), journal_native, log_overflow, log_flush_ms and log_flush_bytes. async_logging
+    // and log_queue_size need a restart. Safe while other threads log.
+    void Reconfigure(const ServerConfig& config);
+
+    // Records discarded because the ring was full (log_overflow=drop).
+    uint64_t DroppedCount() const { return dropped.load(std::memory_order_relaxed); }
 
     // Returns the configured log file path.
     std::string getPath() const;
@@ -33,14 +117,112 @@ public:
 
     ~Logger();
 
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
 private:
+    // One ring slot. `seq` implements the bounded MPMC handshake (Vyukov):
+    // seq == pos → free for the producer claiming pos; seq == pos + 1 → filled.
+    // `message` keeps its capacity between uses, so steady-state logging
+    // doesn't allocate.
+    struct Record {
+        std::atomic<size_t> seq{0};
+        LogType type{Info};
+        std::time_t when{0};
+        std::string message;
+        const char* event{nullptr}; // Event fields, copied (see Event)
+        int fd{-1};
+        char clientIp[48]{};
+        std::string username;
+    };
+
+    // The calling thread's formatting buffer (keeps its capacity).
+    static std::string& scratch()
+    {
+        thread_local std::string line = [] { std::string s; s.reserve(256); return s; }();
+        return line;
+    }
+
+    static void append_piece(std::string& out, std::string_view text) { out.append(text.data(), text.size()); }
+    static void append_piece(std::string& out, char c) { out += c; }
+
+    template <typename Int,
+              typename = std::enable_if_t<std::is_integral_v<Int> && !std::is_same_v<Int, bool> &&
+                                          !std::is_same_v<Int, char>>>
+    static void append_piece(std::string& out, Int value)
+    {
+        char digits[24];
+        const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        out.append(digits, static_cast<size_t>(end - digits));
+    }
+
+    // "YYYY-MM-DD HH:MM:SS+HHMM" for `when`, re-formatted only when the
+    // second changes (per thread, so no lock and no shared state).
+    static const char* cachedTime(std::time_t when);
+
     // Maps a LogType to its LOG_* syslog priority (for the journald prefix).
     int  syslogPriority(LogType type) const;
 
     // Maps a LogType to a human-readable text tag, e.g. "[WARN]".
     const char* prefix(LogType type) const;
 
-    std::ofstream LogFile;            // File sink (may stay closed)
-    std::string logPath;              // Target path from config
+    // Allocates the ring and spawns the writer if [LOGS] async_logging is on.
+    void startWriter(const ServerConfig& config);
+
+    // Synchronous path: formats and writes one entry to both sinks.
+    void write_now(std::string_view message, LogType type, std::time_t when, const Event& event);
+
+    // Claims a slot and copies the record in. False if dropped (ring full).
+    bool enqueue(std::string_view message, LogType type, const Event& event);
+
+    // Writer thread body: drain → format → batched write/flush.
+    void writer_loop();
+
+    // Formats one record into the pending stdout/file batches.
+    void append_record(LogType type, std::time_t when, std::string_view message, const Event& event);
+
+    // Writes the pending batches (one write + one flush per text sink).
+    void flush_batches();
+
+    // Connects to / disconnects from journald per journal_native. Caller
+    // holds sink_mutex.
+    void setJournal(bool native);
+
+    // Sends `batch` to journald; reconnects once if journald restarted (the
+    // entries of that attempt are lost). Caller holds sink_mutex.
+    void sendJournal(journal::Batch& batch);
+
+    std::ofstream LogFile;            // File sink (may stay closed; guarded by sink_mutex)
+    std::string logPath;              // Target path from config (guarded by sink_mutex)
     bool runWithoutLogging{false};    // true → skip file sink entirely
+    std::atomic<bool> fileActive{false}; // LogFile is open (readable without the lock)
+    bool journalNative{false};        // [LOGS] journal_native (guarded by sink_mutex)
+    int journalFd{-1};                // journald socket, -1 → stdout sink (guarded by sink_mutex)
+    std::atomic<bool> journalActive{false}; // journalFd != -1 (readable without the lock)
+    journal::Batch syncJournal;       // Synchronous path's entry (guarded by sink_mutex)
+
+    // ---- async mode ----
+    std::atomic<bool> blockOnOverflow{false}; // log_overflow=block → wait instead of dropping
+    std::atomic<int> flushIntervalMs{100};    // Max age of a buffered, unflushed record
+    std::atomic<size_t> flushBytes{64 * 1024}; // Batch size that forces a write
+
+    std::unique_ptr<Record[]> ring;   // null → synchronous mode
+    size_t ringMask{0};               // capacity - 1 (capacity is a power of two)
+    alignas(64) std::atomic<size_t> enqueuePos{0}; // Next slot producers claim
+    size_t dequeuePos{0};             // Writer-thread only
+
+    std::atomic<bool> accepting{false};    // Producers may use the ring
+    std::atomic<int> inFlight{0};          // Producers between check and publish
+    std::atomic<uint64_t> dropped{0};      // See DroppedCount()
+    uint64_t droppedReported{0};           // Writer-thread only
+
+    std::mutex wakeMutex;                  // Pairs with `wake`
+    std::condition_variable wake;          // Idle writer sleeps here
+    std::atomic<bool> writerIdle{false};   // Producers notify only when set
+    bool stopWriter{false};                // Guarded by wakeMutex
+    std::thread writer;
+
+    std::string outBatch;                  // Pending stdout bytes (writer only)
+    std::string fileBatch;                 // Pending file bytes (writer only)
+    journal::Batch journalBatch;           // Pending journald entries (writer only)
 };
@@ -0,0 +1,126 @@
+#pragma once
+
+// uint8_t / uint64_t
+#include <cstdint>
+// size_t
+#include <cstddef>
+// memcmp()
+#include <cstring>
+// std::string — encoded records
+#include <string>
+// std::string_view — decoded payloads (views into the file)
+#include <string_view>
+
+// ============================================================================
+// capture_format — the traffic capture file ([ADMIN] capture_file), written
+// by the server's TrafficCapture and replayed by `bench_client --replay`.
+//
+//   header  MAGIC (8 bytes), start time: unix ms as 8 bytes little endian
+//   record  kind (1 byte), stream (varint), microseconds since the previous
+//           record (varint), and for Data: length (varint) and the bytes
+//
+// A stream is one connection, numbered from 1 in accept order. Its Data
+// records are the complete records the server framed from it — v1 lines
+// with their '\n', or the v2 preamble and whole frames — in order, with
+// credentials masked (see TrafficCapture). Varints are LEB128, so a busy
+// chat costs a few bytes of overhead per message.
+// ============================================================================
+namespace capture_format {
+
+constexpr char   MAGIC[8]    = {'T', 'C', 'P', 'C', 'A', 'P', '1', '\n'};
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 8;
+
+// Byte that replaces every byte of a password or session token.
+constexpr char MASK = '*';
+
+enum Kind : uint8_t {
+    Open  = 1, // Connection accepted
+    Data  = 2, // One inbound record
+    Close = 3  // Connection gone (either side)
+};
+
+inline void put_varint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// Reads a varint at `pos`; false (pos unchanged) if truncated.
+inline bool get_varint(std::string_view in, size_t& pos, uint64_t& value)
+{
+    uint64_t result = 0;
+    size_t at = pos;
+    for (int shift = 0; shift < 64 && at < in.size(); shift += 7) {
+        const auto byte = static_cast<uint8_t>(in[at++]);
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = result;
+            pos   = at;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string header(uint64_t unix_ms)
+{
+    std::string out(MAGIC, sizeof(MAGIC));
+    for (int i = 0; i < 8; ++i) out += static_cast<char>((unix_ms >> (8 * i)) & 0xff);
+    return out;
+}
+
+// One decoded record; `data` points into the buffer given to Reader.
+struct Record {
+    Kind kind{Open};
+    uint64_t stream{0};
+    uint64_t delta_us{0};
+    std::string_view data{};
+};
+
+// Walks a whole capture held in memory (e.g. mmap'd).
+class Reader {
+public:
+    // False if `file` doesn't start with a capture header.
+    bool open(std::string_view file)
+    {
+        if (file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) return false;
+        in = file;
+        pos = HEADER_SIZE;
+        start_ms = 0;
+        for (int i = 7; i >= 0; --i) start_ms = (start_ms << 8) | static_cast<uint8_t>(file[sizeof(MAGIC) + i]);
+        return true;
+    }
+
+    // The next record; false at the end (a final record cut short by a
+    // crash counts as the end).
+    bool next(Record& r)
+    {
+        size_t at = pos;
+        if (at >= in.size()) return false;
+        const auto kind = static_cast<uint8_t>(in[at++]);
+        if (kind < Open || kind > Close) return false;
+        r.kind = static_cast<Kind>(kind);
+        if (!get_varint(in, at, r.stream) || !get_varint(in, at, r.delta_us)) return false;
+        r.data = {};
+        if (r.kind == Data) {
+            uint64_t length = 0;
+            if (!get_varint(in, at, length) || length > in.size() - at) return false;
+            r.data = in.substr(at, static_cast<size_t>(length));
+            at += static_cast<size_t>(length);
+        }
+        pos = at;
+        return true;
+    }
+
+    uint64_t start_unix_ms() const { return start_ms; }
+
+private:
+    std::string_view in{};
+    size_t pos{0};
+    uint64_t start_ms{0};
+};
+
+} // namespace capture_format
@@ -0,0 +1,162 @@
+#pragma once
+
+// uint8_t / uint32_t
+#include <cstdint>
+// size_t
+#include <cstddef>
+// std::array — the slot table built at compile time
+#include <array>
+// std::string_view — lines are looked up in place
+#include <string_view>
+
+// ============================================================================
+// commands — the slash commands, shared by the server and the clients.
+//
+// A line "/word rest" is recognized by hashing "word" into a slot table
+// built at compile time: one short hash over the word, one compare with the
+// entry found there, no copy and no allocation, however many commands the
+// table holds. The hash seed is searched by the compiler too, and a
+// static_assert fails the build if no seed gives every command its own
+// slot, so adding an entry to COMMANDS is all a new command needs here.
+//
+// `where` says who executes the command: the server (the client just
+// forwards it) or the interactive client itself. The callers switch on the
+// Id to reach their handler.
+// ============================================================================
+namespace commands {
+
+enum Id : uint8_t {
+    None = 0, // Not a known command (or not a slash line at all)
+    Register,
+    Login,
+    Resume,
+    Join,
+    Part,
+    Channels,
+    History,
+    Msg,
+    Who,
+    Clear,
+    Exit,
+    Help
+};
+
+enum Where : uint8_t {
+    Server = 1, // Run by the server; the client forwards the line
+    Client = 2  // Run by the interactive client, never sent
+};
+
+struct Entry {
+    std::string_view word; // Without the '/'
+    Id id;
+    Where where;
+};
+
+inline constexpr Entry COMMANDS[] = {
+    {"register", Register, Server},
+    {"login",    Login,    Server},
+    {"resume",   Resume,   Server},
+    {"join",     Join,     Server},
+    {"part",     Part,     Server},
+    {"channels", Channels, Server},
+    {"history",  History,  Server},
+    {"msg",      Msg,      Server},
+    {"who",      Who,      Server},
+    {"clear",    Clear,    Client},
+    {"exit",     Exit,     Client},
+    {"help",     Help,     Client},
+};
+
+inline constexpr size_t COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+inline constexpr size_t SLOTS = 32; // Power of two, comfortably above COUNT
+
+// FNV-1a over the word, from `seed`.
+constexpr uint32_t hash(std::string_view word, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (char ch : word) {
+        h ^= static_cast<uint8_t>(ch);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+namespace detail {
+
+constexpr bool collision_free(uint32_t seed)
+{
+    bool used[SLOTS] = {};
+    for (const Entry& e : COMMANDS) {
+        const size_t slot = hash(e.word, seed) & (SLOTS - 1);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t find_seed()
+{
+    for (uint32_t seed = 0; seed < 4096; ++seed) {
+        if (collision_free(seed)) return seed;
+    }
+    return UINT32_MAX;
+}
+
+inline constexpr uint32_t SEED = find_seed();
+static_assert(SEED != UINT32_MAX, "commands: no hash seed separates every command, raise SLOTS");
+
+// Slot → index into COMMANDS + 1 (0 = empty).
+constexpr std::array<uint8_t, SLOTS> build_slots()
+{
+    std::array<uint8_t, SLOTS> slots{};
+    for (size_t i = 0; i < COUNT; ++i) {
+        slots[hash(COMMANDS[i].word, SEED) & (SLOTS - 1)] = static_cast<uint8_t>(i + 1);
+    }
+    return slots;
+}
+
+inline constexpr std::array<uint8_t, SLOTS> SLOT_TABLE = build_slots();
+
+} // namespace detail
+
+// What lookup() found in a line.
+struct Match {
+    const Entry* entry{nullptr}; // Null: not a known command
+    Id which{None};              // entry->id, kept apart so no pointer test is needed
+    std::string_view arg{};      // Everything after the first space (untrimmed)
+    bool has_arg{false};         // A space followed the word (arg may still be empty)
+
+    constexpr Id id() const { return which; }
+};
+
+// Index of the word alone ("join", no '/') in COMMANDS, or COUNT.
+constexpr size_t find(std::string_view word)
+{
+    if (word.empty()) return COUNT;
+    const uint8_t index = detail::SLOT_TABLE[hash(word, detail::SEED) & (SLOTS - 1)];
+    if (index == 0 || COMMANDS[index - 1].word != word) return COUNT;
+    return index - 1u;
+}
+
+// Splits "/word rest" at its first space and looks up the word. A line
+// that doesn't start with '/' is never a command.
+constexpr Match lookup(std::string_view line)
+{
+    Match m;
+    if (line.empty() || line[0] != '/') return m;
+    const size_t space = line.find(' ');
+    const size_t index = find(line.substr(1, space == std::string_view::npos ? std::string_view::npos : space - 1));
+    if (index == COUNT) return m;
+    m.entry = &COMMANDS[index];
+    m.which = COMMANDS[index].id;
+    if (space != std::string_view::npos) {
+        m.arg     = line.substr(space + 1);
+        m.has_arg = true;
+    }
+    return m;
+}
+
+static_assert(lookup("/join #x").id() == Join && lookup("/join #x").arg == "#x", "commands: lookup");
+static_assert(lookup("/joint").id() == None && lookup("join").id() == None, "commands: lookup");
+
+} // namespace commands
@@ -0,0 +1,156 @@
+#include "compression.hpp"
+
+#include <zlib.h>
+
+#include "protocol.hpp"
+
+namespace compression {
+
+namespace {
+
+// One stream per direction and thread; deflateReset()/inflateReset()
+// between calls keep the allocations. Level changes go through
+// deflateParams() on the reset stream.
+struct Deflater {
+    z_stream zs{};
+    bool ready{false};
+    int level{0};
+
+    bool begin(int want)
+    {
+        if (!ready) {
+            if (deflateInit2(&zs, want, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+            ready = true;
+            level = want;
+            return true;
+        }
+        deflateReset(&zs);
+        if (want != level) {
+            if (deflateParams(&zs, want, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+            level = want;
+        }
+        return true;
+    }
+
+    ~Deflater()
+    {
+        if (ready) deflateEnd(&zs);
+    }
+};
+
+struct Inflater {
+    z_stream zs{};
+    bool ready{false};
+
+    bool begin()
+    {
+        if (!ready) {
+            if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) return false;
+            ready = true;
+            return true;
+        }
+        return inflateReset(&zs) == Z_OK;
+    }
+
+    ~Inflater()
+    {
+        if (ready) inflateEnd(&zs);
+    }
+};
+
+thread_local Deflater deflater;
+thread_local Inflater inflater;
+
+int clamp_level(int level)
+{
+    return level < MIN_LEVEL ? MIN_LEVEL : level > MAX_LEVEL ? MAX_LEVEL : level;
+}
+
+} // namespace
+
+bool deflate(std::string_view in, std::string& out, int level)
+{
+    Deflater& d = deflater;
+    if (!d.begin(clamp_level(level))) return false;
+
+    const size_t start = out.size();
+    out.resize(start + deflateBound(&d.zs, static_cast<uLong>(in.size())));
+    d.zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    d.zs.avail_in  = static_cast<uInt>(in.size());
+    d.zs.next_out  = reinterpret_cast<Bytef*>(&out[start]);
+    d.zs.avail_out = static_cast<uInt>(out.size() - start);
+
+    // deflateBound() leaves room for all of it: one call finishes.
+    if (::deflate(&d.zs, Z_FINISH) != Z_STREAM_END) {
+        out.resize(start);
+        return false;
+    }
+    out.resize(out.size() - d.zs.avail_out);
+    return true;
+}
+
+bool inflate(std::string_view in, std::string& out, size_t max_out)
+{
+    Inflater& f = inflater;
+    if (!f.begin()) return false;
+
+    const size_t start = out.size();
+    out.resize(start + max_out);
+    f.zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    f.zs.avail_in  = static_cast<uInt>(in.size());
+    f.zs.next_out  = reinterpret_cast<Bytef*>(&out[start]);
+    f.zs.avail_out = static_cast<uInt>(max_out);
+
+    // Anything but a whole stream ending within max_out bytes (truncated,
+    // corrupt, or a bomb) is refused.
+    if (::inflate(&f.zs, Z_FINISH) != Z_STREAM_END || f.zs.avail_in != 0) {
+        out.resize(start);
+        return false;
+    }
+    out.resize(out.size() - f.zs.avail_out);
+    return true;
+}
+
+std::string compress_frame(std::string_view frame, int level)
+{
+    std::string out(protocol::HEADER_SIZE, '\0');
+    if (!deflate(frame, out, level)) return {};
+
+    const size_t length = out.size() - protocol::HEADER_SIZE;
+    if (length > protocol::MAX_PAYLOAD || out.size() >= frame.size()) return {};
+
+    std::string header;
+    protocol::append_header(header, protocol::Compressed, length);
+    out.replace(0, protocol::HEADER_SIZE, header);
+    return out;
+}
+
+size_t append_frames(std::string& out, std::string_view frames, size_t min_bytes, int level)
+{
+    size_t saved = 0;
+    while (!frames.empty()) {
+        // The longest run of whole frames that fits MAX_INFLATED (a lone
+        // frame always does).
+        size_t run = 0;
+        protocol::FrameHeader header;
+        while (run < frames.size() && protocol::decode_header(frames.substr(run), header)) {
+            const size_t next = run + protocol::HEADER_SIZE + header.length;
+            if (next > frames.size() || (run && next > protocol::MAX_INFLATED)) break;
+            run = next;
+        }
+        if (run == 0) run = frames.size(); // Malformed tail: passed on untouched
+
+        const std::string_view chunk = frames.substr(0, run);
+        std::string packed = chunk.size() >= min_bytes ? compress_frame(chunk, level) : std::string();
+        if (packed.empty()) {
+            out.append(chunk.data(), chunk.size());
+        } else {
+            saved += chunk.size() - packed.size();
+            out += packed;
+        }
+        frames.remove_prefix(run);
+    }
+    return saved;
+}
+
+} // namespace compression
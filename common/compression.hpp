@@ -0,0 +1,46 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+// std::string — compressed output
+#include <string>
+// std::string_view — input frames
+#include <string_view>
+
+// ============================================================================
+// compression — protocol v2 Compressed frames (CAP_DEFLATE).
+//
+// A Compressed frame's payload is raw DEFLATE (RFC 1951, no zlib header)
+// of one or more complete frames, at most protocol::MAX_INFLATED bytes of
+// them. Every frame is compressed on its own, without a window carried over
+// from the previous one (like permessage-deflate's no_context_takeover):
+// the server deflates a broadcast once and sends the same bytes to every
+// client that negotiated compression.
+//
+// Each thread keeps one deflate and one inflate stream, reset per call, so
+// nothing is allocated in zlib after the first use.
+// ============================================================================
+namespace compression {
+
+// Levels accepted by deflate(): 1 (fastest) ... 9 (smallest).
+constexpr int MIN_LEVEL = 1;
+constexpr int MAX_LEVEL = 9;
+
+// Appends raw DEFLATE of `in` to `out`. False (out unchanged) on failure.
+bool deflate(std::string_view in, std::string& out, int level);
+
+// Appends what `in` inflates to, if that is a complete stream of at most
+// `max_out` bytes; false otherwise (out unchanged).
+bool inflate(std::string_view in, std::string& out, size_t max_out);
+
+// `frame` (one complete frame) as a Compressed frame, or empty if that
+// wouldn't be smaller.
+std::string compress_frame(std::string_view frame, int level);
+
+// Appends `frames` (complete frames, back to back) to `out`, packing runs
+// of them into Compressed frames. A run is cut at MAX_INFLATED bytes; one
+// shorter than `min_bytes`, or that deflate doesn't shrink, is appended as
+// is. Returns the bytes saved.
+size_t append_frames(std::string& out, std::string_view frames, size_t min_bytes, int level);
+
+} // namespace compression
@@ -9,11 +9,88 @@ struct ServerConfig {
     std::string address;       // Bind/listen IP address
     std::string LogPath;       // Destination file for log output
     std::string DatabasePath;  // Path to the credentials JSON store
+    std::string databaseFormat{"json"}; // "json" or "binary" (mmap'd records + hash index)
+    std::string binaryDatabasePath; // Binary store; seeded from DatabasePath when missing
+    int journalFsyncMs{50};    // Credential journal group-commit interval (ms)
+    int journalCompactRecords{1000}; // Journal length that triggers a snapshot
     std::string PidFilePath;   // PID file path (daemon tracking)
     int port;                  // Listen port
-    int maxConnections;        // listen() backlog / global cap
+    int maxConnections;        // listen() backlog
     int timeout;               // Connection idle timeout (seconds)
+    int maxConnectionsPerIp{5}; // Anti-flood cap on sockets per peer address (per reactor)
+    std::string unixSocket{""}; // AF_UNIX listener path for same-host bridges ("" = none)
+    std::string unixSocketUsers{""}; // "uid:name, ...": who may log in as whom on it (SO_PEERCRED)
+    std::string ioBackend{"epoll"}; // Event loop backend: "epoll" or "io_uring"
+    bool edgeTriggered{true};  // EPOLLET client sockets (epoll backend)
+    int epollBatchSize{256};   // Max events per epoll_wait() call
+    bool writeCoalescing{true}; // Flush client writes once per epoll batch
+    int coalesceMaxDelayMs{2}; // Longest a coalesced write may wait (ms)
+    bool tcpCork{false};       // TCP_CORK around coalesced flushes
+    bool tcpNoDelay{true};     // TCP_NODELAY on client sockets
+    int socketSendBuffer{0};   // SO_SNDBUF bytes (0 = kernel autotuning)
+    int socketRecvBuffer{0};   // SO_RCVBUF bytes (0 = kernel autotuning)
+    int tcpDeferAccept{0};     // TCP_DEFER_ACCEPT seconds (0 = off)
+    int tcpNotsentLowat{0};    // TCP_NOTSENT_LOWAT bytes (0 = system default)
+    int busyPollUs{0};         // SO_BUSY_POLL microseconds (0 = off)
+    int maxMessagesPerSec{100}; // Per-connection inbound records/s (0 = unlimited)
+    int maxBytesPerSec{65536}; // Per-connection inbound bytes/s (0 = unlimited)
+    int rateLimitBurst{2};     // Seconds of either rate a client may send back to back
+    int recordsPerIteration{32}; // Records handled per client per loop iteration (0 = unlimited)
+    bool compression{true};    // Offer v2 Compressed frames (CAP_DEFLATE) in the handshake
+    int compressionMinBytes{512}; // Smaller frames (and batches) are sent as is
+    int compressionLevel{1};   // DEFLATE level, 1 (fastest) ... 9
+    int maxInputBuffer{65536}; // Unframed bytes buffered per connection (longest v1 line)
+    int inputMemoryBudgetMb{256}; // Read buffers of all connections (0 = unlimited)
+    int outputMemoryBudgetMb{512}; // Write queues of all connections (0 = unlimited)
+    int recvArenaMb{64};       // Receive chunks per reactor (0 = per-client heap buffers)
+    bool recvHugePages{true};  // Back them (and the io_uring buffers) with 2 MiB huge pages
+    std::string slowConsumerPolicy{"coalesce"}; // "disconnect", "drop" or "coalesce"
+    int slowConsumerQueueBytes{1048576}; // Queued bytes that make a client a slow consumer (0 = no limit)
+    int slowConsumerMaxDelayMs{30000}; // ... or age of its oldest queued byte (0 = no limit)
+    int overloadLagMs{100};     // Loop lag that pauses accept and defers logins (0 = no overload control)
+    int overloadRejectLagMs{500}; // ... that rejects them with a retry-after instead
+    int overloadRetryAfterS{5}; // Retry-after sent with those rejections
+    int workerThreads{1};      // Reactor count (>1 → SO_REUSEPORT multi-reactor mode)
+    int cryptoThreads{2};      // Argon2id worker pool size
+    int cryptoQueueLimit{256}; // Max auth jobs waiting for the pool (backpressure)
+    int argon2TargetMs{50};    // Calibrated Argon2id time per hash (0 = libsodium's interactive preset)
+    int argon2MemoryMb{64};    // Argon2id memory per hash, at most
+    int argon2Opslimit{0};     // Fixed passes instead of calibrating (0 = calibrate)
+    bool argon2Rehash{true};   // Re-hash at the current cost after a successful login
+    std::string reactorCpus;   // Cores for the reactors, e.g. "0-3" (empty = unpinned)
+    std::string cryptoCpus;    // Cores for the crypto workers (empty = unpinned)
+    bool incomingCpu{false};   // SO_INCOMING_CPU on each reactor's listener (needs reactorCpus)
+    int sessionTokenTtl{900};  // /resume token lifetime in seconds (0 = no tokens)
+    std::string sessionKeyPath; // MAC key for session tokens (created on first start)
     bool Run_without_logging{false}; // true → skip file logging (journald only)
+    bool logAsync{true};       // Log through the background writer thread
+    int logQueueSize{8192};    // Async ring capacity (records, rounded up to a power of two)
+    bool logOverflowBlock{false}; // Full ring: true → caller waits, false → record dropped
+    int logFlushMs{100};       // Max delay before queued log lines hit the sinks
+    int logFlushBytes{65536};  // Batch size that forces an early write
+    bool logJournalNative{false}; // journald's native socket (structured fields) instead of stdout
+    int metricsPort{9464};     // Loopback Prometheus endpoint (0 = disabled)
+    std::string adminSocket;   // Unix socket for operator commands (empty = disabled)
+    std::string captureFile;   // Inbound traffic capture for bench_client --replay (empty = off)
+    int historyMessages{50};   // Messages kept per channel for replay (0 = no history)
+    int historyMaxBytes{1048576}; // Payload bytes all history rings may reference
+    bool historyGlobal{false}; // One ring for every channel instead of one per channel
+    std::string chatLogDir{"/var/lib/tcpserver/chatlog"}; // On-disk chat log ("" = none)
+    int chatLogSegmentBytes{16777216}; // Size of each log segment file
+    int chatLogSegments{32};   // Segments kept (0 = all)
+    int chatLogIndexBytes{4096}; // Log bytes per sparse index entry
+    int chatLogFlushMs{50};    // Max time a message waits for the disk
+    int chatLogScanBytes{4194304}; // Most record bytes one /history reads
+    int chatLogQueryMax{200};  // Most messages one /history returns
+    int clusterNodeId{0};      // This node's id in the cluster (0 = not clustered)
+    std::string clusterListen{"0.0.0.0:9700"}; // host:port for peer links
+    std::string clusterPeers;  // "<id>@<host>:<port>, ..." — the other nodes
+    std::string clusterSecret; // Shared by every node; authenticates the links
+    bool tlsEnabled{false};    // TLS 1.3 on the chat listener
+    std::string tlsCertificate; // PEM certificate chain
+    std::string tlsPrivateKey; // PEM private key
+    bool ktls{true};           // Hand record encryption to the kernel after the handshake
+    bool requireKtls{false};   // Close connections the kernel can't fully take over
 
     // Parses `file`; returns false if the .ini can't be loaded.
     // Every GetValue call supplies a default, so missing keys are non-fatal.
@@ -36,6 +113,136 @@ struct ServerConfig {
         timeout =
             (int)ini.GetLongValue("NETWORK", "connection_timeout", 150);
 
+        maxConnectionsPerIp =
+            (int)ini.GetLongValue("NETWORK", "max_connections_per_ip", 5);
+        if (maxConnectionsPerIp < 1) maxConnectionsPerIp = 1;
+        if (maxConnectionsPerIp > 65535) maxConnectionsPerIp = 65535;
+
+        unixSocket =
+            ini.GetValue("NETWORK", "unix_socket", "");
+
+        unixSocketUsers =
+            ini.GetValue("NETWORK", "unix_socket_users", "");
+
+        ioBackend =
+            ini.GetValue("NETWORK", "io_backend", "epoll");
+
+        edgeTriggered =
+            (bool)ini.GetBoolValue("NETWORK", "edge_triggered", true);
+
+        epollBatchSize =
+            (int)ini.GetLongValue("NETWORK", "epoll_batch_size", 256);
+        if (epollBatchSize < 1) epollBatchSize = 1;
+        if (epollBatchSize > 65536) epollBatchSize = 65536;
+
+        writeCoalescing =
+            (bool)ini.GetBoolValue("NETWORK", "write_coalescing", true);
+
+        coalesceMaxDelayMs =
+            (int)ini.GetLongValue("NETWORK", "write_coalescing_max_delay_ms", 2);
+        if (coalesceMaxDelayMs < 0) coalesceMaxDelayMs = 0;
+
+        tcpCork =
+            (bool)ini.GetBoolValue("NETWORK", "tcp_cork", false);
+
+        maxMessagesPerSec =
+            (int)ini.GetLongValue("NETWORK", "max_messages_per_sec", 100);
+        if (maxMessagesPerSec < 0) maxMessagesPerSec = 0;
+
+        maxBytesPerSec =
+            (int)ini.GetLongValue("NETWORK", "max_bytes_per_sec", 65536);
+        if (maxBytesPerSec < 0) maxBytesPerSec = 0;
+
+        rateLimitBurst =
+            (int)ini.GetLongValue("NETWORK", "rate_limit_burst", 2);
+        if (rateLimitBurst < 1) rateLimitBurst = 1;
+
+        recordsPerIteration =
+            (int)ini.GetLongValue("NETWORK", "records_per_iteration", 32);
+        if (recordsPerIteration < 0) recordsPerIteration = 0;
+
+        compression =
+            (bool)ini.GetBoolValue("NETWORK", "compression", true);
+
+        compressionMinBytes =
+            (int)ini.GetLongValue("NETWORK", "compression_min_bytes", 512);
+        if (compressionMinBytes < 0) compressionMinBytes = 0;
+
+        compressionLevel =
+            (int)ini.GetLongValue("NETWORK", "compression_level", 1);
+        if (compressionLevel < 1) compressionLevel = 1;
+        if (compressionLevel > 9) compressionLevel = 9;
+
+        maxInputBuffer =
+            (int)ini.GetLongValue("NETWORK", "max_input_buffer", 65536);
+
+        inputMemoryBudgetMb =
+            (int)ini.GetLongValue("NETWORK", "input_memory_budget_mb", 256);
+        if (inputMemoryBudgetMb < 0) inputMemoryBudgetMb = 0;
+
+        outputMemoryBudgetMb =
+            (int)ini.GetLongValue("NETWORK", "output_memory_budget_mb", 512);
+        if (outputMemoryBudgetMb < 0) outputMemoryBudgetMb = 0;
+
+        recvArenaMb =
+            (int)ini.GetLongValue("NETWORK", "recv_arena_mb", 64);
+        if (recvArenaMb < 0) recvArenaMb = 0;
+
+        recvHugePages =
+            (bool)ini.GetBoolValue("NETWORK", "recv_huge_pages", true);
+
+        slowConsumerPolicy =
+            ini.GetValue("NETWORK", "slow_consumer_policy", "coalesce");
+        if (slowConsumerPolicy != "disconnect" && slowConsumerPolicy != "drop") slowConsumerPolicy = "coalesce";
+
+        slowConsumerQueueBytes =
+            (int)ini.GetLongValue("NETWORK", "slow_consumer_queue_bytes", 1048576);
+        if (slowConsumerQueueBytes < 0) slowConsumerQueueBytes = 0;
+
+        slowConsumerMaxDelayMs =
+            (int)ini.GetLongValue("NETWORK", "slow_consumer_max_delay_ms", 30000);
+        if (slowConsumerMaxDelayMs < 0) slowConsumerMaxDelayMs = 0;
+
+        overloadLagMs =
+            (int)ini.GetLongValue("NETWORK", "overload_lag_ms", 100);
+        if (overloadLagMs < 0) overloadLagMs = 0;
+
+        overloadRejectLagMs =
+            (int)ini.GetLongValue("NETWORK", "overload_reject_lag_ms", 500);
+        if (overloadRejectLagMs < overloadLagMs) overloadRejectLagMs = overloadLagMs;
+
+        overloadRetryAfterS =
+            (int)ini.GetLongValue("NETWORK", "overload_retry_after_s", 5);
+        if (overloadRetryAfterS < 1) overloadRetryAfterS = 1;
+        if (overloadRetryAfterS > 3600) overloadRetryAfterS = 3600;
+
+        tcpNoDelay =
+            (bool)ini.GetBoolValue("NETWORK", "tcp_nodelay", true);
+
+        socketSendBuffer =
+            (int)ini.GetLongValue("NETWORK", "socket_send_buffer", 0);
+        if (socketSendBuffer < 0) socketSendBuffer = 0;
+
+        socketRecvBuffer =
+            (int)ini.GetLongValue("NETWORK", "socket_recv_buffer", 0);
+        if (socketRecvBuffer < 0) socketRecvBuffer = 0;
+
+        tcpDeferAccept =
+            (int)ini.GetLongValue("NETWORK", "tcp_defer_accept", 0);
+        if (tcpDeferAccept < 0) tcpDeferAccept = 0;
+
+        tcpNotsentLowat =
+            (int)ini.GetLongValue("NETWORK", "tcp_notsent_lowat", 0);
+        if (tcpNotsentLowat < 0) tcpNotsentLowat = 0;
+
+        busyPollUs =
+            (int)ini.GetLongValue("NETWORK", "busy_poll_us", 0);
+        if (busyPollUs < 0) busyPollUs = 0;
+
+        workerThreads =
+            (int)ini.GetLongValue("NETWORK", "worker_threads", 1);
+        if (workerThreads < 1) workerThreads = 1; // 0/negative → classic single loop
+
         // ---- [LOGS] ----
         LogPath =
             ini.GetValue("LOGS", "LogPath", "/var/log/tcpserver/log.txt");
@@ -44,6 +251,137 @@ struct ServerConfig {
         DatabasePath =
             ini.GetValue("DATABASE", "DatabasePath", "/var/lib/tcpserver/credentials.json");
 
+        databaseFormat =
+            ini.GetValue("DATABASE", "format", "json");
+
+        binaryDatabasePath =
+            ini.GetValue("DATABASE", "BinaryDatabasePath", "/var/lib/tcpserver/credentials.db");
+
+        journalFsyncMs =
+            (int)ini.GetLongValue("DATABASE", "journal_fsync_ms", 50);
+
+        journalCompactRecords =
+            (int)ini.GetLongValue("DATABASE", "journal_compact_records", 1000);
+
+        // ---- [PROCESS] ----
+        cryptoThreads =
+            (int)ini.GetLongValue("PROCESS", "crypto_threads", 2);
+        if (cryptoThreads < 1) cryptoThreads = 1;
+
+        cryptoQueueLimit =
+            (int)ini.GetLongValue("PROCESS", "crypto_queue_limit", 256);
+        if (cryptoQueueLimit < 1) cryptoQueueLimit = 1;
+
+        argon2TargetMs =
+            (int)ini.GetLongValue("PROCESS", "argon2_target_ms", 50);
+        if (argon2TargetMs < 0) argon2TargetMs = 0;
+
+        argon2MemoryMb =
+            (int)ini.GetLongValue("PROCESS", "argon2_memory_mb", 64);
+        if (argon2MemoryMb < 8) argon2MemoryMb = 8;
+        if (argon2MemoryMb > 4096) argon2MemoryMb = 4096;
+
+        argon2Opslimit =
+            (int)ini.GetLongValue("PROCESS", "argon2_opslimit", 0);
+        if (argon2Opslimit < 0) argon2Opslimit = 0;
+
+        argon2Rehash =
+            (bool)ini.GetBoolValue("PROCESS", "argon2_rehash", true);
+
+        reactorCpus =
+            ini.GetValue("PROCESS", "reactor_cpus", "");
+
+        cryptoCpus =
+            ini.GetValue("PROCESS", "crypto_cpus", "");
+
+        incomingCpu =
+            (bool)ini.GetBoolValue("PROCESS", "incoming_cpu", false);
+
+        sessionTokenTtl =
+            (int)ini.GetLongValue("PROCESS", "session_token_ttl", 900);
+        if (sessionTokenTtl < 0) sessionTokenTtl = 0;
+
+        sessionKeyPath =
+            ini.GetValue("PROCESS", "session_key_path", "/var/lib/tcpserver/session.key");
+
+        // ---- [ADMIN] ----
+        metricsPort =
+            (int)ini.GetLongValue("ADMIN", "metrics_port", 9464);
+        if (metricsPort < 0 || metricsPort > 65535) metricsPort = 0;
+        adminSocket =
+            ini.GetValue("ADMIN", "admin_socket", "/run/tcpserver/admin.sock");
+        captureFile =
+            ini.GetValue("ADMIN", "capture_file", "");
+
+        // ---- [HISTORY] ----
+        historyMessages =
+            (int)ini.GetLongValue("HISTORY", "messages", 50);
+        if (historyMessages < 0) historyMessages = 0;
+
+        historyMaxBytes =
+            (int)ini.GetLongValue("HISTORY", "max_bytes", 1048576);
+        if (historyMaxBytes < 0) historyMaxBytes = 0;
+
+        historyGlobal =
+            std::string(ini.GetValue("HISTORY", "scope", "channel")) == "global";
+
+        chatLogDir =
+            ini.GetValue("HISTORY", "log_dir", "/var/lib/tcpserver/chatlog");
+
+        chatLogSegmentBytes =
+            (int)ini.GetLongValue("HISTORY", "log_segment_bytes", 16777216);
+        if (chatLogSegmentBytes < (1 << 20)) chatLogSegmentBytes = 1 << 20;
+
+        chatLogSegments =
+            (int)ini.GetLongValue("HISTORY", "log_segments", 32);
+        if (chatLogSegments < 0) chatLogSegments = 0;
+
+        chatLogIndexBytes =
+            (int)ini.GetLongValue("HISTORY", "log_index_bytes", 4096);
+        if (chatLogIndexBytes < 256) chatLogIndexBytes = 256;
+
+        chatLogFlushMs =
+            (int)ini.GetLongValue("HISTORY", "log_flush_ms", 50);
+        if (chatLogFlushMs < 1) chatLogFlushMs = 1;
+
+        chatLogScanBytes =
+            (int)ini.GetLongValue("HISTORY", "log_query_scan_bytes", 4194304);
+        if (chatLogScanBytes < 65536) chatLogScanBytes = 65536;
+
+        chatLogQueryMax =
+            (int)ini.GetLongValue("HISTORY", "log_query_max", 200);
+        if (chatLogQueryMax < 1) chatLogQueryMax = 1;
+
+        // ---- [CLUSTER] ----
+        clusterNodeId =
+            (int)ini.GetLongValue("CLUSTER", "node_id", 0);
+        if (clusterNodeId < 0) clusterNodeId = 0;
+
+        clusterListen =
+            ini.GetValue("CLUSTER", "listen", "0.0.0.0:9700");
+
+        clusterPeers =
+            ini.GetValue("CLUSTER", "peers", "");
+
+        clusterSecret =
+            ini.GetValue("CLUSTER", "secret", "");
+
+        // ---- [TLS] ----
+        tlsEnabled =
+            (bool)ini.GetBoolValue("TLS", "enabled", false);
+
+        tlsCertificate =
+            ini.GetValue("TLS", "certificate", "/etc/tcpserver/tls/server.crt");
+
+        tlsPrivateKey =
+            ini.GetValue("TLS", "private_key", "/etc/tcpserver/tls/server.key");
+
+        ktls =
+            (bool)ini.GetBoolValue("TLS", "ktls", true);
+
+        requireKtls =
+            (bool)ini.GetBoolValue("TLS", "require_ktls", false);
+
         // ---- [PID] ----
         PidFilePath =
             ini.GetValue("PID", "PidFilePath", "/run/tcpserver/server.pid");
@@ -52,6 +390,27 @@ struct ServerConfig {
         Run_without_logging =
             (bool)ini.GetBoolValue("LOGS", "Run_Without_logging", false);
 
+        logAsync =
+            (bool)ini.GetBoolValue("LOGS", "async_logging", true);
+
+        logQueueSize =
+            (int)ini.GetLongValue("LOGS", "log_queue_size", 8192);
+        if (logQueueSize < 2) logQueueSize = 2;
+
+        logOverflowBlock =
+            std::string(ini.GetValue("LOGS", "log_overflow", "drop")) == "block";
+
+        logFlushMs =
+            (int)ini.GetLongValue("LOGS", "log_flush_ms", 100);
+        if (logFlushMs < 1) logFlushMs = 1;
+
+        logFlushBytes =
+            (int)ini.GetLongValue("LOGS", "log_flush_bytes", 65536);
+        if (logFlushBytes < 1) logFlushBytes = 1;
+
+        logJournalNative =
+            (bool)ini.GetBoolValue("LOGS", "journal_native", false);
+
         return true;
     }
 };
@@ -4,7 +4,10 @@
 #include <regex>
 #include <cctype>
 #include <cstring>
+#include <string_view>
 #include <termios.h>
+#include "simd_scan.hpp" // Vectorised whitespace / printable scans
+#include "commands.hpp"  // Slash-command table (parse_credentials)
 
 #pragma once
 
@@ -370,28 +373,20 @@ inline ssize_t trimBuffer(char* buffer, ssize_t length)
     if (length <= 0) return 0;
     
     // Find first non-whitespace character
-    ssize_t start = 0;
-    while (start < length && std::isspace(static_cast<unsigned char>(buffer[start])))
-    {
-        start++;
-    }
+    size_t start = simd_scan::skip_whitespace(buffer, static_cast<size_t>(length));
     
     // Buffer contains only whitespace
-    if (start == length)
+    if (start == static_cast<size_t>(length))
     {
         buffer[0] = '\0';
         return 0;
     }
     
-    // Find last non-whitespace character
-    ssize_t end = length - 1;
-    while (end > start && std::isspace(static_cast<unsigned char>(buffer[end])))
-    {
-        end--;
-    }
+    // Find last non-whitespace character (exclusive end)
+    size_t end = simd_scan::rskip_whitespace(buffer, static_cast<size_t>(length));
     
-    // Calculate new length (inclusive range)
-    ssize_t new_length = end - start + 1;
+    // Calculate new length
+    ssize_t new_length = static_cast<ssize_t>(end - start);
     
     // Shift trimmed content to beginning if necessary
     if (start > 0)
@@ -415,15 +410,34 @@ inline bool isBufferEmpty(const char* buffer, ssize_t length)
 {
     if (length <= 0) return true;
     
-    // Check each character - if any is non-whitespace, buffer is not empty
-    for (ssize_t i = 0; i < length; i++)
-    {
-        if (!std::isspace(static_cast<unsigned char>(buffer[i])))
-        {
-            return false;
-        }
-    }
-    return true;
+    // Any non-whitespace byte means the buffer is not empty
+    return simd_scan::skip_whitespace(buffer, static_cast<size_t>(length)) ==
+           static_cast<size_t>(length);
+}
+
+/**
+ * Trims leading/trailing whitespace from a view without touching the bytes.
+ * View counterpart of trimBuffer() for records framed in place.
+ * @param view The text to trim
+ * @return Sub-view without surrounding whitespace (empty if all whitespace)
+ */
+inline std::string_view trimBuffer(std::string_view view)
+{
+    size_t start = simd_scan::skip_whitespace(view.data(), view.size());
+    if (start == view.size()) return std::string_view{};
+
+    size_t end = simd_scan::rskip_whitespace(view.data(), view.size());
+    return view.substr(start, end - start);
+}
+
+/**
+ * Checks if a view is empty or contains only whitespace.
+ * @param view The text to check
+ * @return true if empty or all whitespace, false otherwise
+ */
+inline bool isBufferEmpty(std::string_view view)
+{
+    return simd_scan::skip_whitespace(view.data(), view.size()) == view.size();
 }
 
 /**
@@ -457,14 +471,21 @@ inline bool isBufferPrintable(const char* buffer, ssize_t length)
 {
     if (length <= 0) return false;
     
-    for (ssize_t i = 0; i < length; i++)
-    {
-        if (!std::isprint(static_cast<unsigned char>(buffer[i])))
-        {
-            return false;
-        }
-    }
-    return true;
+    return simd_scan::find_nonprintable(buffer, static_cast<size_t>(length)) ==
+           static_cast<size_t>(length);
+}
+
+/**
+ * Checks a username for /register and /login (v1 line or v2 frame).
+ * Names are echoed inside text lines (history, notices, presence), so only
+ * printable ASCII is allowed, and no '|', the credential separator.
+ * @param name The username, already trimmed
+ * @return true if the name can be stored and shown as is
+ */
+inline bool isValidUsername(std::string_view name)
+{
+    return isBufferPrintable(name.data(), static_cast<ssize_t>(name.size())) &&
+           name.find('|') == std::string_view::npos;
 }
 
 /**
@@ -687,9 +708,9 @@ inline bool bufferContains(const char* buffer, ssize_t length, const char* subst
 {
     if (length <= 0) return false;
     
-    // Convert to string for easier substring search
-    std::string buf_str(buffer, length);
-    return buf_str.find(substring) != std::string::npos;
+    // Search the bytes in place (no temporary std::string)
+    return std::string_view(buffer, static_cast<size_t>(length)).find(substring) !=
+           std::string_view::npos;
 }
 
 /**
@@ -725,7 +746,7 @@ inline bool parse_username(const char* buffer, char* out_name, size_t out_size)
 struct temp_user_credentials {
     std::string username;
     std::string password;
-    int cmd_type{0}; // 1 = login, 2 = register
+    int cmd_type{0}; // 1 = login, 2 = register, 3 = resume (session token, no password), 4 = local peer (SO_PEERCRED, no password)
 };
 
 /**
@@ -735,42 +756,46 @@ struct temp_user_credentials {
  * 
  * @return true if buffer matched a valid auth command
  */
-inline bool parse_credentials(const char* buffer, temp_user_credentials& out)
+inline bool parse_credentials(std::string_view input, temp_user_credentials& out)
 {
-    std::string input(buffer);
-
-    // Determine command type
-    if (input.rfind("/register ", 0) == 0) {
-        out.cmd_type = 2; // register
-        input = input.substr(10); // len of "/register "
-    } else if (input.rfind("/login ", 0) == 0) {
-        out.cmd_type = 1; // login
-        input = input.substr(7); // len of "/login "
-    } else {
+    // Determine command type (one table lookup, see commands.hpp)
+    const commands::Match cmd = commands::lookup(input);
+    if (!cmd.has_arg || (cmd.id() != commands::Register && cmd.id() != commands::Login)) {
         return false;
     }
+    out.cmd_type = cmd.id() == commands::Register ? 2 : 1;
+    input = cmd.arg;
 
     // Find delimiter '|'
     size_t delim = input.find('|');
-    if (delim == std::string::npos || delim == 0 || delim == input.size() - 1) {
+    if (delim == std::string_view::npos || delim == 0 || delim == input.size() - 1) {
         return false;
     }
 
-    out.username = input.substr(0, delim);
-    out.password = input.substr(delim + 1);
-
-    // Trim whitespace
-    auto trim = [](std::string& s) {
-        s.erase(0, s.find_first_not_of(" \t\r\n"));
-        s.erase(s.find_last_not_of(" \t\r\n") + 1);
+    // Trim whitespace on the views; only the final fields are copied out
+    auto trim = [](std::string_view s) {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos) return std::string_view{};
+        return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
     };
 
-    trim(out.username);
-    trim(out.password);
+    std::string_view username = trim(input.substr(0, delim));
+    std::string_view password = trim(input.substr(delim + 1));
+
+    out.username.assign(username.data(), username.size());
+    out.password.assign(password.data(), password.size());
 
     return !out.username.empty() && !out.password.empty();
 }
 
+/**
+ * NUL-terminated overload, kept for callers that still hold C strings.
+ */
+inline bool parse_credentials(const char* buffer, temp_user_credentials& out)
+{
+    return parse_credentials(std::string_view(buffer), out);
+}
+
 // ============================================================================
 // EXAMPLE USAGE IN SERVER
 // ============================================================================
@@ -0,0 +1,163 @@
+#pragma once
+
+// uint8_t / uint16_t — header fields
+#include <cstdint>
+// size_t
+#include <cstddef>
+// memcmp(), memchr()
+#include <cstring>
+// std::string — encoded frames
+#include <string>
+// std::string_view — zero-copy views of received frames
+#include <string_view>
+
+// ============================================================================
+// Wire protocol.
+//
+// v1 (default): newline-delimited text lines ("/login user|pass\n", chat
+// text, server replies).
+//
+// v2 (opt-in): the client opens the connection with PREAMBLE, then both
+// sides exchange length-prefixed frames:
+//
+//     +--------+--------+-----------------+----------------------+
+//     | type   | flags  | length (BE u16) | payload (length B)   |
+//     +--------+--------+-----------------+----------------------+
+//
+// The server acknowledges with a Hello frame (version byte, then the
+// capabilities it offers); the client may answer with a Capabilities frame
+// naming those it wants. PREAMBLE starts with a NUL
+// byte, which no v1 client ever sends, so the server picks the protocol
+// from the first byte of the connection and v1 clients are unaffected.
+// Payloads are never scanned for delimiters: the receiver knows exactly how
+// many bytes to read and can route a frame without parsing it.
+// ============================================================================
+namespace protocol {
+
+enum class Version : uint8_t {
+    Unknown = 0, // Nothing received yet
+    V1      = 1, // Newline-delimited text
+    V2      = 2  // Length-prefixed frames
+};
+
+constexpr char   PREAMBLE[4]   = {'\0', 'T', 'C', '2'}; // Client → server, once
+constexpr size_t PREAMBLE_SIZE = sizeof(PREAMBLE);
+constexpr size_t HEADER_SIZE   = 4;
+constexpr size_t MAX_PAYLOAD   = 16384; // Larger frames are a protocol error
+constexpr size_t MAX_NAME      = 255;   // Usernames travel with a 1-byte length
+
+enum FrameType : uint8_t {
+    Hello       = 1, // Server → client: v2 accepted. Payload: version byte
+    Register    = 2, // Client → server. Payload: name_len, name, password
+    Login       = 3, // Client → server. Payload: name_len, name, password
+    Chat        = 4, // Client → server: text. Server → client: name_len, name, text
+    Notice      = 5, // Server → client: one status/error line (no newline)
+    Command     = 6, // Client → server: one slash command ("/join #room")
+    ChannelChat = 7, // Server → client: chan_len, channel, name_len, name, text
+    Private     = 8, // Server → client: name_len, name, text (a /msg to this client)
+    Compressed  = 9, // Server → client: raw DEFLATE of one or more complete frames (CAP_DEFLATE)
+    Capabilities = 10 // Client → server, after Hello: the CAP_* bits it accepts
+};
+
+// Capability bits (Hello byte 1 and the Capabilities payload).
+constexpr uint8_t CAP_DEFLATE = 0x01; // Compressed frames, see compression.hpp
+
+// Most bytes a Compressed frame may inflate to: the frames it packs, whole.
+constexpr size_t MAX_INFLATED = HEADER_SIZE + MAX_PAYLOAD;
+
+// No flags are defined yet; receivers ignore unknown bits.
+constexpr uint8_t FLAG_NONE = 0;
+
+// Notice text announcing a session token ("Session <token>", both
+// protocols). Clients keep the token for "/resume <token>" on reconnect
+// instead of showing the line.
+constexpr std::string_view SESSION_NOTICE = "Session ";
+
+struct FrameHeader {
+    uint8_t  type{0};
+    uint8_t  flags{0};
+    uint16_t length{0}; // Payload bytes following the header
+};
+
+// Decodes the header at the front of `in` (needs HEADER_SIZE bytes).
+inline bool decode_header(std::string_view in, FrameHeader& out)
+{
+    if (in.size() < HEADER_SIZE) return false;
+    const auto* b = reinterpret_cast<const unsigned char*>(in.data());
+    out.type   = b[0];
+    out.flags  = b[1];
+    out.length = static_cast<uint16_t>((b[2] << 8) | b[3]);
+    return true;
+}
+
+// Appends a header for a `length`-byte payload to `out`.
+inline void append_header(std::string& out, uint8_t type, size_t length, uint8_t flags = FLAG_NONE)
+{
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    out.push_back(static_cast<char>((length >> 8) & 0xFF));
+    out.push_back(static_cast<char>(length & 0xFF));
+}
+
+// One frame carrying `payload` as is.
+inline std::string make_frame(uint8_t type, std::string_view payload)
+{
+    std::string out;
+    out.reserve(HEADER_SIZE + payload.size());
+    append_header(out, type, payload.size());
+    out.append(payload.data(), payload.size());
+    return out;
+}
+
+// One frame whose payload is a length-prefixed `name` followed by `rest`
+// (Register/Login credentials, server-side Chat). `name` must not exceed
+// MAX_NAME bytes.
+inline std::string make_named_frame(uint8_t type, std::string_view name, std::string_view rest)
+{
+    std::string out;
+    out.reserve(HEADER_SIZE + 1 + name.size() + rest.size());
+    append_header(out, type, 1 + name.size() + rest.size());
+    out.push_back(static_cast<char>(name.size()));
+    out.append(name.data(), name.size());
+    out.append(rest.data(), rest.size());
+    return out;
+}
+
+// ChannelChat frame: two length-prefixed fields (`channel`, `name`) then
+// `text`. Both fields must not exceed MAX_NAME bytes.
+inline std::string make_channel_frame(std::string_view channel, std::string_view name,
+                                      std::string_view text)
+{
+    std::string out;
+    size_t length = 1 + channel.size() + 1 + name.size() + text.size();
+    out.reserve(HEADER_SIZE + length);
+    append_header(out, ChannelChat, length);
+    out.push_back(static_cast<char>(channel.size()));
+    out.append(channel.data(), channel.size());
+    out.push_back(static_cast<char>(name.size()));
+    out.append(name.data(), name.size());
+    out.append(text.data(), text.size());
+    return out;
+}
+
+// Splits a named payload back into its two parts.
+inline bool split_named(std::string_view payload, std::string_view& name, std::string_view& rest)
+{
+    if (payload.empty()) return false;
+    size_t len = static_cast<unsigned char>(payload[0]);
+    if (payload.size() < 1 + len) return false;
+    name = payload.substr(1, len);
+    rest = payload.substr(1 + len);
+    return true;
+}
+
+// True if `in` (the first bytes of a connection) can't be PREAMBLE;
+// `complete` tells whether enough bytes arrived to be sure it is.
+inline bool preamble_mismatch(std::string_view in, bool& complete)
+{
+    size_t n = in.size() < PREAMBLE_SIZE ? in.size() : PREAMBLE_SIZE;
+    complete = in.size() >= PREAMBLE_SIZE;
+    return std::memcmp(in.data(), PREAMBLE, n) != 0;
+}
+
+} // namespace protocol
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>      // memchr, memmove, memcpy
+#include <string_view>
+#include <vector>
+
+// ============================================================================
+// ReadBuffer — per-connection contiguous receive buffer with in-place framing.
+//
+// recv() writes straight into the free tail (write_ptr/commit), and
+// next_line() hands out std::string_view records pointing into the buffer —
+// no substr/erase, no per-message allocation (take() does the same for
+// length-prefixed v2 frames). Consumed bytes are reclaimed lazily: the
+// unread remainder is moved to the front only when the tail runs out of
+// room, so pipelined input costs O(n) overall instead of O(n²).
+// The newline scan resumes where the previous one stopped, so a record that
+// trickles in over many reads is scanned once.
+//
+// With use_chunks(), an empty buffer owns no memory: the first write_ptr()
+// borrows a fixed-size chunk from a ChunkSource, and only input that
+// outgrows the chunk moves to a heap allocation of its own.
+//
+// Views returned by next_line()/take()/view() stay valid until the next write_ptr().
+// ============================================================================
+
+// Fixed-size chunks that ReadBuffers borrow as storage (see use_chunks()).
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+
+    // A chunk of chunk_size() bytes, or null when none is left.
+    virtual char* lease() = 0;
+    virtual void give_back(char* chunk) = 0;
+
+    size_t chunk_size() const { return chunk_bytes; }
+
+protected:
+    explicit ChunkSource(size_t chunk) : chunk_bytes(chunk) {}
+
+private:
+    size_t chunk_bytes;
+};
+
+class ReadBuffer {
+public:
+    explicit ReadBuffer(size_t initial_capacity = 0) { buf.reserve(initial_capacity); }
+    ~ReadBuffer() { return_chunk(); }
+
+    // A borrowed chunk has exactly one owner.
+    ReadBuffer(ReadBuffer&& o) noexcept
+        : buf(std::move(o.buf)), source(o.source), chunk(o.chunk), head(o.head), tail(o.tail), scan(o.scan)
+    {
+        o.chunk = nullptr;
+        o.head = o.tail = o.scan = 0;
+    }
+    ReadBuffer& operator=(ReadBuffer&& o) noexcept
+    {
+        if (this != &o) {
+            return_chunk();
+            buf    = std::move(o.buf);
+            source = o.source;
+            chunk  = o.chunk;
+            head   = o.head;
+            tail   = o.tail;
+            scan   = o.scan;
+            o.chunk = nullptr;
+            o.head = o.tail = o.scan = 0;
+        }
+        return *this;
+    }
+
+    // Borrow storage from `chunks` (null: always the heap) whenever the
+    // buffer has none. Takes effect at the next allocation; `chunks` must
+    // outlive the buffer.
+    void use_chunks(ChunkSource* chunks) { source = chunks; }
+
+    // Returns a pointer to at least `min_space` writable bytes at the tail,
+    // compacting (or growing) first if needed. Follow with commit(n).
+    char* write_ptr(size_t min_space)
+    {
+        if (storage() - tail < min_space) {
+            compact();
+            if (storage() - tail < min_space) grow(tail + min_space);
+        }
+        return data() + tail;
+    }
+
+    // Bytes available at write_ptr() without further growth.
+    size_t writable() const { return storage() - tail; }
+
+    // Whether write_ptr(min_space) can do without allocating (compacting
+    // is enough).
+    bool fits(size_t min_space) const { return storage() - (tail - head) >= min_space; }
+
+    // Marks `n` bytes written at write_ptr() as received data.
+    void commit(size_t n) { tail += n; }
+
+    // Extracts the next '\n'-terminated record (newline included) into `out`.
+    // Returns false when no complete record is buffered yet.
+    bool next_line(std::string_view& out)
+    {
+        const char* base = data();
+        const void* nl   = std::memchr(base + scan, '\n', tail - scan);
+        if (!nl) {
+            scan = tail; // Next call only looks at newly committed bytes
+            return false;
+        }
+
+        size_t end = static_cast<size_t>(static_cast<const char*>(nl) - base) + 1;
+        out  = std::string_view(base + head, end - head);
+        head = scan = end;
+        if (head == tail) head = tail = scan = 0; // Fully drained: rewind for free
+        return true;
+    }
+
+    // Like next_line(), but leaves the record in the buffer: the following
+    // next_line() returns the same one.
+    bool peek_line(std::string_view& out)
+    {
+        const char* base = data();
+        const void* nl   = std::memchr(base + scan, '\n', tail - scan);
+        if (!nl) {
+            scan = tail;
+            return false;
+        }
+        size_t end = static_cast<size_t>(static_cast<const char*>(nl) - base) + 1;
+        out = std::string_view(base + head, end - head);
+        return true;
+    }
+
+    // Extracts exactly `n` bytes (a length-prefixed frame) into `out`.
+    // Returns false while fewer are buffered.
+    bool take(size_t n, std::string_view& out)
+    {
+        if (tail - head < n) return false;
+        out  = std::string_view(data() + head, n);
+        head += n;
+        if (scan < head) scan = head;
+        if (head == tail) head = tail = scan = 0;
+        return true;
+    }
+
+    // Unconsumed bytes (a partial record, when framing is up to date).
+    std::string_view view() const { return std::string_view(data() + head, tail - head); }
+    size_t size()  const { return tail - head; }
+    bool   empty() const { return head == tail; }
+
+    // Drops everything buffered (keeps the allocation for reuse).
+    void clear() { head = tail = scan = 0; }
+
+    // Bytes currently reserved by the buffer.
+    size_t capacity() const { return storage(); }
+
+    // The storage is a chunk borrowed from the ChunkSource.
+    bool borrowed() const { return chunk != nullptr; }
+
+    // Returns the allocation (to the heap or the ChunkSource) if the
+    // buffer is empty.
+    void release_if_empty()
+    {
+        if (empty()) {
+            clear();
+            return_chunk();
+            std::vector<char>().swap(buf);
+        }
+    }
+
+private:
+    char* data() { return chunk ? chunk : buf.data(); }
+    const char* data() const { return chunk ? chunk : buf.data(); }
+    size_t storage() const { return chunk ? source->chunk_size() : buf.size(); }
+
+    // Makes the storage hold at least `n` bytes, with [0, tail) kept: a
+    // chunk if it is big enough, otherwise the heap.
+    void grow(size_t n)
+    {
+        if (!chunk && buf.empty() && source && n <= source->chunk_size()) {
+            chunk = source->lease();
+            if (chunk) {
+                // Nothing to move: an allocation-less buffer is empty.
+                head = tail = scan = 0;
+                return;
+            }
+        }
+        if (chunk) {
+            buf.resize(n);
+            std::memcpy(buf.data(), chunk, tail);
+            return_chunk();
+            return;
+        }
+        buf.resize(n);
+    }
+
+    void return_chunk()
+    {
+        if (chunk) source->give_back(chunk);
+        chunk = nullptr;
+    }
+
+    // Moves the unread remainder to the front of the storage.
+    void compact()
+    {
+        if (head == 0) return;
+        size_t remaining = tail - head;
+        if (remaining) std::memmove(data(), data() + head, remaining);
+        scan -= head;
+        tail  = remaining;
+        head  = 0;
+    }
+
+    std::vector<char> buf; // Heap storage, unless a chunk is borrowed; [head, tail) holds unread bytes
+    ChunkSource* source{nullptr};
+    char* chunk{nullptr};  // Borrowed from `source` (buf is empty meanwhile)
+    size_t head{0};        // First unconsumed byte
+    size_t tail{0};        // One past the last received byte
+    size_t scan{0};        // Newline search resumes here (head <= scan <= tail)
+};
@@ -0,0 +1,214 @@
+#include "simd_scan.hpp"
+
+#include <cstdint>
+
+#ifdef SIMD_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace simd_scan {
+
+// ============================================================================
+// Scalar reference
+// ============================================================================
+namespace scalar {
+
+static inline bool is_space(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_print(unsigned char c)
+{
+    return c >= 0x20 && c <= 0x7E;
+}
+
+size_t find_nonprintable(const char* data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (!is_print(static_cast<unsigned char>(data[i]))) return i;
+    }
+    return len;
+}
+
+size_t skip_whitespace(const char* data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && is_space(static_cast<unsigned char>(data[i]))) ++i;
+    return i;
+}
+
+size_t rskip_whitespace(const char* data, size_t len)
+{
+    while (len > 0 && is_space(static_cast<unsigned char>(data[len - 1]))) --len;
+    return len;
+}
+
+} // namespace scalar
+
+#ifdef SIMD_SCAN_X86
+
+// ============================================================================
+// SSE2 (baseline on x86-64). Unsigned range checks use the
+// "min(x, limit) == x" idiom since SSE2 only compares signed bytes.
+// ============================================================================
+
+// Mask of bytes in [0x20, 0x7E].
+static inline __m128i printable_sse2(__m128i v)
+{
+    const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(0x20));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(0x5E)), d);
+}
+
+// Mask of ' ' and '\t'...'\r'.
+static inline __m128i space_sse2(__m128i v)
+{
+    const __m128i d    = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8('\r' - '\t')), d);
+    return _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+namespace sse2 {
+
+size_t find_nonprintable(const char* data, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned bad = ~static_cast<unsigned>(_mm_movemask_epi8(printable_sse2(v))) & 0xFFFFu;
+        if (bad) return i + static_cast<size_t>(__builtin_ctz(bad));
+    }
+    return i + scalar::find_nonprintable(data + i, len - i);
+}
+
+size_t skip_whitespace(const char* data, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned text = ~static_cast<unsigned>(_mm_movemask_epi8(space_sse2(v))) & 0xFFFFu;
+        if (text) return i + static_cast<size_t>(__builtin_ctz(text));
+    }
+    return i + scalar::skip_whitespace(data + i, len - i);
+}
+
+size_t rskip_whitespace(const char* data, size_t len)
+{
+    while (len >= 16) {
+        __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + len - 16));
+        unsigned text = ~static_cast<unsigned>(_mm_movemask_epi8(space_sse2(v))) & 0xFFFFu;
+        if (text) return len - 16 + (32 - static_cast<size_t>(__builtin_clz(text)));
+        len -= 16;
+    }
+    return scalar::rskip_whitespace(data, len);
+}
+
+} // namespace sse2
+
+// ============================================================================
+// AVX2 — compiled for the instruction set via target attributes, only ever
+// called after avx2_supported() (see pick()).
+// ============================================================================
+
+__attribute__((target("avx2")))
+static inline __m256i printable_avx2(__m256i v)
+{
+    const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(0x20));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(0x5E)), d);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i space_avx2(__m256i v)
+{
+    const __m256i d    = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    const __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8('\r' - '\t')), d);
+    return _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+namespace avx2 {
+
+__attribute__((target("avx2")))
+size_t find_nonprintable(const char* data, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t bad = ~static_cast<uint32_t>(_mm256_movemask_epi8(printable_avx2(v)));
+        if (bad) return i + static_cast<size_t>(__builtin_ctz(bad));
+    }
+    return i + sse2::find_nonprintable(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+size_t skip_whitespace(const char* data, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t text = ~static_cast<uint32_t>(_mm256_movemask_epi8(space_avx2(v)));
+        if (text) return i + static_cast<size_t>(__builtin_ctz(text));
+    }
+    return i + sse2::skip_whitespace(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+size_t rskip_whitespace(const char* data, size_t len)
+{
+    while (len >= 32) {
+        __m256i v     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len - 32));
+        uint32_t text = ~static_cast<uint32_t>(_mm256_movemask_epi8(space_avx2(v)));
+        if (text) return len - 32 + (32 - static_cast<size_t>(__builtin_clz(text)));
+        len -= 32;
+    }
+    return sse2::rskip_whitespace(data, len);
+}
+
+} // namespace avx2
+
+bool avx2_supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // SIMD_SCAN_X86
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+namespace {
+
+struct Kernels {
+    size_t (*find_nonprintable)(const char*, size_t);
+    size_t (*skip_whitespace)(const char*, size_t);
+    size_t (*rskip_whitespace)(const char*, size_t);
+    const char* name;
+};
+
+Kernels pick()
+{
+#ifdef SIMD_SCAN_X86
+    if (avx2_supported()) {
+        return {avx2::find_nonprintable, avx2::skip_whitespace, avx2::rskip_whitespace, "avx2"};
+    }
+    return {sse2::find_nonprintable, sse2::skip_whitespace, sse2::rskip_whitespace, "sse2"};
+#else
+    return {scalar::find_nonprintable, scalar::skip_whitespace, scalar::rskip_whitespace, "scalar"};
+#endif
+}
+
+// Resolved once; thread-safe static initialisation.
+const Kernels& kernels()
+{
+    static const Kernels k = pick();
+    return k;
+}
+
+} // namespace
+
+size_t find_nonprintable(const char* data, size_t len) { return kernels().find_nonprintable(data, len); }
+size_t skip_whitespace(const char* data, size_t len)   { return kernels().skip_whitespace(data, len); }
+size_t rskip_whitespace(const char* data, size_t len)  { return kernels().rskip_whitespace(data, len); }
+const char* active_kernel()                            { return kernels().name; }
+
+} // namespace simd_scan
@@ -0,0 +1,67 @@
+#pragma once
+
+// size_t
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SIMD_SCAN_X86 1
+#endif
+
+// ============================================================================
+// simd_scan — byte-classification kernels for received text.
+//
+// Each entry point is dispatched once, at first use, to the widest
+// implementation the CPU supports: AVX2 (32 bytes per step), SSE2 (16, the
+// x86-64 baseline) or plain scalar code on other architectures. All
+// versions return identical results; the vector loops finish their tail
+// with the scalar reference in `simd_scan::scalar`.
+//
+// Classes use C-locale semantics (what std::isspace/std::isprint give in a
+// process that never calls setlocale):
+//   whitespace = ' ', '\t', '\n', '\v', '\f', '\r'
+//   printable  = 0x20 ... 0x7E
+//
+// The newline search of the framing loop is not here: ReadBuffer uses
+// memchr(), which glibc already dispatches to SSE2/AVX2/EVEX code.
+// ============================================================================
+namespace simd_scan {
+
+// Index of the first byte that is not printable ASCII, or `len` if none.
+size_t find_nonprintable(const char* data, size_t len);
+
+// Index of the first non-whitespace byte, or `len` if all whitespace.
+size_t skip_whitespace(const char* data, size_t len);
+
+// Length of `data` once trailing whitespace is dropped (0 if all whitespace).
+size_t rskip_whitespace(const char* data, size_t len);
+
+// Name of the implementation in use: "avx2", "sse2" or "scalar".
+const char* active_kernel();
+
+// Reference implementations (also the tails of the vector loops).
+namespace scalar {
+size_t find_nonprintable(const char* data, size_t len);
+size_t skip_whitespace(const char* data, size_t len);
+size_t rskip_whitespace(const char* data, size_t len);
+} // namespace scalar
+
+#ifdef SIMD_SCAN_X86
+// The vector versions, called directly only by tests/simd_scan_test.cpp to
+// compare them with the scalar reference. avx2:: must not be called unless
+// avx2_supported().
+namespace sse2 {
+size_t find_nonprintable(const char* data, size_t len);
+size_t skip_whitespace(const char* data, size_t len);
+size_t rskip_whitespace(const char* data, size_t len);
+} // namespace sse2
+
+namespace avx2 {
+size_t find_nonprintable(const char* data, size_t len);
+size_t skip_whitespace(const char* data, size_t len);
+size_t rskip_whitespace(const char* data, size_t len);
+} // namespace avx2
+
+bool avx2_supported();
+#endif
+
+} // namespace simd_scan
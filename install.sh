@@ -63,6 +63,7 @@ BIN_DIR="/usr/bin/tcpserver"
 
 CONFIG_FILE="$CONFIG_DIR/Config_file.ini"
 SERVICE_FILE="/etc/systemd/system/tcpserver.service"
+SOCKET_FILE="/etc/systemd/system/tcpserver.socket"
 DB_FILE="$DATA_DIR/credentials.json"
 LOG_FILE="$LOG_DIR/log.txt"
 
@@ -93,6 +94,8 @@ case "$PKG" in
         build-essential cmake git pkg-config \
         autoconf automake libtool \
         libsodium-dev \
+        libssl-dev \
+        zlib1g-dev \
         nlohmann-json3-dev \
         acl
     ;;
@@ -102,6 +105,8 @@ case "$PKG" in
         cmake git pkgconf-pkg-config \
         autoconf automake libtool \
         libsodium-devel \
+        openssl-devel \
+        zlib-devel \
         json-devel \
         acl
     ;;
@@ -110,6 +115,8 @@ case "$PKG" in
         base-devel cmake git pkgconf \
         autoconf automake libtool \
         libsodium \
+        openssl \
+        zlib \
         nlohmann-json \
         acl
     ;;
@@ -163,6 +170,8 @@ log_info "Installing binaries..."
 if [ "$BUILD_SERVER" = "ON" ]; then
     [ -f build/server ] || { log_error "Missing build/server"; exit 1; }
     install -m 755 -o root -g root build/server "$BIN_DIR/server"
+    install -m 755 -o root -g root build/tcpserver-credentials "$BIN_DIR/tcpserver-credentials"
+    install -m 755 -o root -g root build/tcpserver-admin "$BIN_DIR/tcpserver-admin"
 fi
 if [ "$BUILD_CLIENT" = "ON" ]; then
     [ -f build/client ] || { log_error "Missing build/client"; exit 1; }
@@ -208,6 +217,8 @@ if [ "$BUILD_SERVER" = "ON" ]; then
     log_info "Installing service..."
     [ -f "./common/service/tcpserver.service" ] || { log_error "Missing tcpserver.service"; exit 1; }
     install -m 644 -o root -g root ./common/service/tcpserver.service "$SERVICE_FILE"
+    # Socket activation is opt-in (systemctl enable --now tcpserver.socket).
+    install -m 644 -o root -g root ./common/service/tcpserver.socket "$SOCKET_FILE"
 
     systemctl daemon-reload
     systemctl enable --now tcpserver.service
@@ -229,4 +240,6 @@ fi
 log_info "Installation completed."
 printf "Artifacts:\n"
 [ "$BUILD_SERVER" = "ON" ] && printf "  %s/server\n" "$BIN_DIR"
+[ "$BUILD_SERVER" = "ON" ] && printf "  %s/tcpserver-credentials\n" "$BIN_DIR"
+[ "$BUILD_SERVER" = "ON" ] && printf "  %s/tcpserver-admin\n" "$BIN_DIR"
 [ "$BUILD_CLIENT" = "ON" ] && printf "  %s/client\n" "$BIN_DIR"
@@ -0,0 +1,128 @@
+// The simd_scan kernels against their scalar reference: every variant the
+// CPU can run (SSE2, AVX2, and the dispatched entry points) must return
+// exactly what simd_scan::scalar returns, for every length and position the
+// vector loops and their tails split differently.
+
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/simd_scan.hpp"
+
+namespace {
+
+using Scan = size_t (*)(const char*, size_t);
+
+struct Variant {
+    const char* name;
+    Scan find_nonprintable;
+    Scan skip_whitespace;
+    Scan rskip_whitespace;
+};
+
+std::vector<Variant> variants()
+{
+    std::vector<Variant> out;
+    out.push_back({"dispatched", simd_scan::find_nonprintable, simd_scan::skip_whitespace,
+                   simd_scan::rskip_whitespace});
+#ifdef SIMD_SCAN_X86
+    out.push_back({"sse2", simd_scan::sse2::find_nonprintable, simd_scan::sse2::skip_whitespace,
+                   simd_scan::sse2::rskip_whitespace});
+    if (simd_scan::avx2_supported()) {
+        out.push_back({"avx2", simd_scan::avx2::find_nonprintable, simd_scan::avx2::skip_whitespace,
+                       simd_scan::avx2::rskip_whitespace});
+    }
+#endif
+    return out;
+}
+
+// Bytes on either side of every class boundary, and the whole high half.
+std::vector<unsigned char> edge_bytes()
+{
+    std::vector<unsigned char> out = {0x00, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x1F, 0x20, 0x7E, 0x7F};
+    for (int b = 0x80; b <= 0xFF; ++b) out.push_back(static_cast<unsigned char>(b));
+    return out;
+}
+
+// Runs every variant over data[0, len) and compares it with the reference.
+void expect_match(const std::vector<Variant>& all, const char* data, size_t len)
+{
+    const size_t printable = simd_scan::scalar::find_nonprintable(data, len);
+    const size_t leading   = simd_scan::scalar::skip_whitespace(data, len);
+    const size_t trimmed   = simd_scan::scalar::rskip_whitespace(data, len);
+    for (const Variant& v : all) {
+        ASSERT_EQ(v.find_nonprintable(data, len), printable) << v.name << " len " << len;
+        ASSERT_EQ(v.skip_whitespace(data, len), leading) << v.name << " len " << len;
+        ASSERT_EQ(v.rskip_whitespace(data, len), trimmed) << v.name << " len " << len;
+    }
+}
+
+} // namespace
+
+// The reference itself follows the C-locale classes it documents.
+TEST(SimdScan, ScalarMatchesCLocale)
+{
+    for (int b = 0; b <= 0xFF; ++b) {
+        const char c = static_cast<char>(b);
+        EXPECT_EQ(simd_scan::scalar::find_nonprintable(&c, 1), std::isprint(b) ? 1u : 0u) << "byte " << b;
+        EXPECT_EQ(simd_scan::scalar::skip_whitespace(&c, 1), std::isspace(b) ? 1u : 0u) << "byte " << b;
+        EXPECT_EQ(simd_scan::scalar::rskip_whitespace(&c, 1), std::isspace(b) ? 0u : 1u) << "byte " << b;
+    }
+}
+
+// One edge byte at every position of every length 0-100, in a run of
+// printable text and in a run of whitespace, so each kernel's answer falls
+// in the vector body, at a block boundary and in the scalar tail.
+TEST(SimdScan, EdgeBytesAtEveryPosition)
+{
+    const std::vector<Variant> all = variants();
+    const std::vector<unsigned char> bytes = edge_bytes();
+    std::string buffer;
+    for (char filler : {'a', ' ', '\t'}) {
+        for (size_t len = 0; len <= 100; ++len) {
+            buffer.assign(len, filler);
+            expect_match(all, buffer.data(), len);
+            for (size_t pos = 0; pos < len; ++pos) {
+                for (unsigned char b : bytes) {
+                    buffer[pos] = static_cast<char>(b);
+                    expect_match(all, buffer.data(), len);
+                }
+                buffer[pos] = filler;
+            }
+        }
+    }
+}
+
+// Random mixes of whitespace, text and control/high bytes, at every start
+// alignment, so unaligned loads are covered too.
+TEST(SimdScan, RandomInputs)
+{
+    const std::vector<Variant> all = variants();
+    const std::vector<unsigned char> bytes = edge_bytes();
+    std::mt19937 rng(20261014);
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<size_t> length(0, 300);
+    std::uniform_int_distribution<size_t> edge(0, bytes.size() - 1);
+    std::uniform_int_distribution<int> text(0x20, 0x7E);
+    const char spaces[] = " \t\n\v\f\r";
+    std::uniform_int_distribution<int> space(0, 5);
+
+    std::string buffer;
+    for (int round = 0; round < 20000; ++round) {
+        const size_t offset = static_cast<size_t>(round % 32);
+        const size_t len    = length(rng);
+        buffer.assign(offset + len, 'x');
+        // Mostly text or whitespace, so the answers land all over the buffer
+        for (size_t i = offset; i < buffer.size(); ++i) {
+            const int k = kind(rng);
+            if (k < 5) buffer[i] = static_cast<char>(text(rng));
+            else if (k < 9) buffer[i] = spaces[space(rng)];
+            else buffer[i] = static_cast<char>(bytes[edge(rng)]);
+        }
+        expect_match(all, buffer.data() + offset, len);
+    }
+}
@@ -37,6 +37,7 @@ DATA_DIR="/var/lib/tcpserver"
 LOG_DIR="/var/log/tcpserver"
 BIN_DIR="/usr/bin/tcpserver"
 SERVICE_FILE="/etc/systemd/system/tcpserver.service"
+SOCKET_FILE="/etc/systemd/system/tcpserver.socket"
 
 # ============================================================
 # Stop & disable service
@@ -45,9 +46,10 @@ if command -v systemctl >/dev/null 2>&1; then
     if systemctl list-unit-files | grep -q '^tcpserver\.service'; then
         log_info "Stopping service..."
         systemctl disable --now tcpserver.service 2>/dev/null || true
+        systemctl disable --now tcpserver.socket 2>/dev/null || true
     fi
     if [ -f "$SERVICE_FILE" ]; then
-        rm -f "$SERVICE_FILE"
+        rm -f "$SERVICE_FILE" "$SOCKET_FILE"
         systemctl daemon-reload
         systemctl reset-failed tcpserver.service 2>/dev/null || true
         log_info "Service unit removed."